@@ -27,6 +27,8 @@ protected:
 	void ShowCommonImGuiWindow();
 	void ToggleCursorMode();
 	void DebugDrawLights();
+	LightConstants const& GetLightConstants() const { return m_lightConstants; }
+	int GetDebugInt() const { return m_debugInt; }
 
 private:
 	void ShowLightControlWindow(bool* pOpen);
@@ -63,6 +63,9 @@ struct FullScreenQuadWithDepthResources
 	uint32_t textureIndex = 0;
 	uint32_t depthTexIndex = 0;
 	uint32_t samplerIndex = 0;
+	uint32_t renderWidth = 0; // texels of the textures holding the image, from the top left. 0: all of them
+	uint32_t renderHeight = 0;
+	uint32_t useEdgeAwareUpscale = 0; // taps across a depth edge are left out of the bilinear filter
 };
 
 struct TriplanarRenderResources
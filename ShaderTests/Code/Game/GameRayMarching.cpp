@@ -1,59 +1,43 @@
 #include "Game/GameRayMarching.hpp"
 
 #include "Game/SpectatorCamera.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
 #include "Engine/Core/Clock.hpp"
 #include "Engine/Core/DebugRender.hpp"
 #include "Engine/Core/VertexUtils.hpp"
 #include "Engine/Core/Vertex_PCUTBN.hpp"
 #include "Engine/Math/RandomNumberGenerator.hpp"
 #include "Engine/Math/MathUtils.hpp"
+#include "Engine/Math/AABB3.hpp"
 #include "Engine/Math/Mat44.hpp"
 #include "Engine/Math/Vec3.hpp"
 #include "Engine/Renderer/Renderer.hpp"
 #include "Engine/Renderer/Buffer.hpp"
+#include "Engine/Renderer/IndexBuffer.hpp"
 #include "Engine/Renderer/Texture.hpp"
+#include "Engine/Renderer/VertexBuffer.hpp"
 #include "Engine/Window/Window.hpp"
 
 
 #include "ThirdParty/imgui/imgui.h"
 
-
-SdfShape SdfShape::MakeSphere(Vec3 center, float radius, Rgba8 color /*= Rgba8::OPAQUE_WHITE*/)
-{
-	SdfShape result;
-
-	result.m_type = SDF_SPHERE;
-	result.m_data0 = Vec4(center.x, center.y, center.z, radius);
-	color.GetAsFloats(result.m_color);
-
-	return result;
-}
-
-//-----------------------------------------------------------------------------------------------
-
-SdfShape GRMO_Sphere::GetShape() const
-{
-	SdfShape result = SdfShape::MakeSphere(m_position, m_radius, m_color);
-	result.m_triAlbedoTexID = m_triAlbedoTexID;
-	result.m_triMRTexID = m_triMRTexID;
-	result.m_triNormalTexID = m_triNormalTexID;
-	result.m_triOcclusionTexID = m_triOcclusionTexID;
-	result.m_triEmissiveTexID = m_triEmissiveTexID;
-
-	return result;
-}
-
-
+#include <algorithm>
+#include <cfloat>
 
 
 //-----------------------------------------------------------------------------------------------
 
 static constexpr int INITIAL_SPHERE_COUNT = 2;
-static constexpr float MIN_OBJECT_SPEED = 0.5f;
-static constexpr float MAX_OBJECT_SPEED = 1.5f;
-static constexpr float MIN_SPHERE_RADIUS = 0.5f;
-static constexpr float MAX_SPHERE_RADIUS = 1.5f;
-static constexpr float ACTIVITY_BOX_RADIUS = 5.f;
+static constexpr float CSG_CUTTER_DEGREES_PER_SECOND = 20.f;
+static constexpr float CSG_CUTTER_HALF_EXTENT = 0.5f * ACTIVITY_BOX_RADIUS;
+static constexpr int TEST_MODEL_BAKE_RESOLUTION = 64;
+static constexpr char const* TEST_MODEL_BRICK_FILE = "SdfBakedTestModel.sdfb"; // next to the exe
+static constexpr int BRICK_STREAM_CAPACITY = 256;
+static constexpr int BRICK_STREAM_LOADS_PER_FRAME = 32;
+static constexpr float BRICK_STREAM_RADIUS = 2.f;
+static constexpr int SPAWN_NUM_CANDIDATES = 64;
+static constexpr float HALF_GEOMETRY_MOVE_SLACK = 0.01f; // float16 rounding of a center inside the box plus radius, in both frames
 
 
 //-----------------------------------------------------------------------------------------------
@@ -103,6 +87,9 @@ GameRayMarching::GameRayMarching()
 	m_triOcclusionTexs[2] = g_theRenderer->CreateOrGetTextureFromFile("Data/Images/wispy-grass-meadow/wispy-grass-meadow_arm.png");
 	m_triEmissiveTexs[2] = nullptr;
 
+	CreateMaterialBuffer();
+	BakeTestModel();
+
 	Reset();
 }
 
@@ -112,16 +99,22 @@ GameRayMarching::~GameRayMarching()
 	m_spectator = nullptr;
 
 	DestroyRayMarchingConstants();
-	DestroyShapeBuffer();
+	DestroyShapeBuffers();
+	DestroyMaterialBuffer();
+	DestroyTileBuffers();
+	DestroyBrickBuffers();
+	DestroyCsgProgramBuffer();
+	DestroyCsgGridSampleBuffer();
 	DestroyDstTexture();
 	DestroyDepthTexture();
-
-	for (auto* shape : m_shapes)
-	{
-		delete shape;
-	}
-	m_shapes.clear();
-
+	DestroyConeDepthTexture();
+	DestroyTemporalStartTexture();
+	DestroyDeferredShadingTextures();
+	DestroyCostTextures();
+	DestroyMeshBuffers();
+
+	delete m_jobPool;
+	m_jobPool = nullptr;
 }
 
 void GameRayMarching::Update()
@@ -141,11 +134,39 @@ void GameRayMarching::Update()
 
 
 	m_spectator->Update();
+	UpdateBrickStreaming();
 
 	float deltaSeconds = (float)m_clock->GetDeltaSeconds();
 
 	UpdateShapes(deltaSeconds);
+	if (m_currentRayMarchingConstants.useCsgProgram)
+	{
+		// The cutter's corners move fastest, at its half diagonal times the angular speed
+		m_csgCutterDegrees += CSG_CUTTER_DEGREES_PER_SECOND * deltaSeconds;
+		float cornerMove = sqrtf(3.f) * CSG_CUTTER_HALF_EXTENT * CSG_CUTTER_DEGREES_PER_SECOND * (3.14159265f / 180.f) * deltaSeconds;
+		m_maxShapeMove = std::max(m_maxShapeMove, cornerMove);
+		if (deltaSeconds > 0.f)
+		{
+			m_dirtyTiles.Invalidate(); // the cutter is not one of the shapes it compares
+		}
+	}
+
+	if (m_isRecordingCameraPath)
+	{
+		SdfCameraPathFrame frame;
+		frame.m_deltaSeconds = deltaSeconds;
+		frame.m_view = GetSdfView();
+		m_cameraPath.push_back(frame);
+	}
 
+	if (m_useDynamicResolution)
+	{
+		m_dynamicResolution.Update(1000.f * (float)Clock::GetSystemClock().GetDeltaSeconds());
+	}
+	if (m_comboInt == 1)
+	{
+		UpdateMeshes();
+	}
 	UpdateRayMarching();
 }
 
@@ -174,17 +195,14 @@ void GameRayMarching::Render() const
 
 void GameRayMarching::Reset()
 {
-
-	for (auto* shape : m_shapes)
-	{
-		delete shape;
-	}
-	m_shapes.clear();
+	m_shapeSimulation.Clear();
+	m_areStreamMaterialsStale = true;
 
 	for (int i = 0; i < INITIAL_SPHERE_COUNT; ++i)
 	{
 		SpawnSphere();
 	}
+	m_isTemporalHistoryValid = false;
 }
 
 void GameRayMarching::OnWindowResized()
@@ -194,84 +212,96 @@ void GameRayMarching::OnWindowResized()
 
 void GameRayMarching::UpdateShapes(float deltaSeconds)
 {
+	// Without a BVH the streams keep the simulation order, so it writes the upload layout itself and
+	// UpdateRayMarching only uploads it. The BVH reorders the shapes and packs its own streams.
+	bool isHalf = (m_currentRayMarchingConstants.halfPrecisionGeometry != 0);
+	bool isDirectStreams = (m_currentRayMarchingConstants.useBvh == 0);
+	m_maxShapeMove = m_shapeSimulation.Update(deltaSeconds, GetJobPool(), isDirectStreams ? &m_shapeStreams : nullptr, isHalf, m_areStreamMaterialsStale);
+	if (isDirectStreams)
+	{
+		m_areStreamMaterialsStale = false;
+	}
+}
 
-	for (auto shape : m_shapes)
+JobPool* GameRayMarching::GetJobPool()
+{
+	if (m_jobPool == nullptr)
 	{
-		shape->m_position += deltaSeconds * shape->m_velocity;
+		m_jobPool = new JobPool();
+	}
+	return m_jobPool;
+}
 
-		// Bounce with Walls
-		if (shape->m_position.x > ACTIVITY_BOX_RADIUS)
-		{
-			shape->m_position.x = ACTIVITY_BOX_RADIUS;
+void GameRayMarching::UpdateMeshes()
+{
+	int numOfShapes = m_shapeSimulation.GetNumShapes();
+	m_meshGeometry.resize(numOfShapes);
+	for (int i = 0; i < numOfShapes; ++i)
+	{
+		Vec3 position = m_shapeSimulation.GetPosition(i);
+		m_meshGeometry[i] = Vec4(position.x, position.y, position.z, m_shapeSimulation.GetRadius(i));
+	}
+	m_chunkMesher.Update(m_meshGeometry, m_currentRayMarchingConstants.toleranceK, GetJobPool());
 
-			if (shape->m_velocity.x > 0.f)
-			{
-				shape->m_velocity.x *= -1.f;
-			}
-		}
+	// A rebuild can change the chunk count and re-meshes every chunk. Buffers are only ever added: the frames in flight
+	// may still draw the ones past a smaller count, so they wait unused for a later rebuild and go in Shutdown.
+	int numOfChunks = (int)m_chunkMesher.GetChunks().size();
+	if ((int)m_meshChunkVertexBuffers.size() < numOfChunks)
+	{
+		m_meshChunkVertexBuffers.resize(numOfChunks, nullptr);
+		m_meshChunkIndexBuffers.resize(numOfChunks, nullptr);
+	}
+	m_meshChunkIndexCounts.resize(numOfChunks, 0);
 
-		if (shape->m_position.x < -ACTIVITY_BOX_RADIUS)
+	std::vector<Vertex_PCUTBN> verts;
+	for (int chunkIndex : m_chunkMesher.GetRemeshedChunks())
+	{
+		SdfMeshChunk const& chunk = m_chunkMesher.GetChunks()[chunkIndex];
+		m_meshChunkIndexCounts[chunkIndex] = (int)chunk.m_indices.size();
+		if (chunk.m_indices.empty())
 		{
-			shape->m_position.x = -ACTIVITY_BOX_RADIUS;
-
-			if (shape->m_velocity.x < 0.f)
-			{
-				shape->m_velocity.x *= -1.f;
-			}
+			continue;
 		}
 
-		if (shape->m_position.y > ACTIVITY_BOX_RADIUS)
+		verts.resize(chunk.m_vertices.size());
+		for (size_t i = 0; i < chunk.m_vertices.size(); ++i)
 		{
-			shape->m_position.y = ACTIVITY_BOX_RADIUS;
-
-			if (shape->m_velocity.y > 0.f)
-			{
-				shape->m_velocity.y *= -1.f;
-			}
+			verts[i] = Vertex_PCUTBN();
+			verts[i].m_position = chunk.m_vertices[i].m_position;
+			verts[i].m_color = Rgba8::OPAQUE_WHITE;
+			verts[i].m_normal = chunk.m_vertices[i].m_normal;
 		}
-
-		if (shape->m_position.y < -ACTIVITY_BOX_RADIUS)
+		if (m_meshChunkVertexBuffers[chunkIndex] == nullptr)
 		{
-			shape->m_position.y = -ACTIVITY_BOX_RADIUS;
-
-			if (shape->m_velocity.y < 0.f)
-			{
-				shape->m_velocity.y *= -1.f;
-			}
-		}
-
-		if (shape->m_position.z > ACTIVITY_BOX_RADIUS)
-		{
-			shape->m_position.z = ACTIVITY_BOX_RADIUS;
-
-			if (shape->m_velocity.z > 0.f)
-			{
-				shape->m_velocity.z *= -1.f;
-			}
-		}
-
-		if (shape->m_position.z < -ACTIVITY_BOX_RADIUS)
-		{
-			shape->m_position.z = -ACTIVITY_BOX_RADIUS;
-
-			if (shape->m_velocity.z < 0.f)
-			{
-				shape->m_velocity.z *= -1.f;
-			}
+			m_meshChunkVertexBuffers[chunkIndex] = g_theRenderer->CreateVertexBuffer(1 * sizeof(Vertex_PCUTBN), sizeof(Vertex_PCUTBN));
+			m_meshChunkIndexBuffers[chunkIndex] = g_theRenderer->CreateIndexBuffer(1 * sizeof(unsigned int));
 		}
+		VertexBuffer* vertexBuffer = m_meshChunkVertexBuffers[chunkIndex];
+		IndexBuffer* indexBuffer = m_meshChunkIndexBuffers[chunkIndex];
+		g_theRenderer->CopyCPUToGPU(verts.data(), static_cast<unsigned int>(verts.size()) * vertexBuffer->GetStride(), vertexBuffer);
+		g_theRenderer->CopyCPUToGPU(chunk.m_indices.data(), static_cast<unsigned int>(chunk.m_indices.size()) * indexBuffer->GetStride(), indexBuffer);
 	}
 }
 
-void GameRayMarching::RenderMeshes() const
+void GameRayMarching::DestroyMeshBuffers()
 {
-	std::vector<Vertex_PCUTBN> diffuseVerts;
-	std::vector<unsigned int> diffuseIndices;
-
-	for (GRMO_Sphere const* shape : m_shapes)
+	for (VertexBuffer*& vertexBuffer : m_meshChunkVertexBuffers)
+	{
+		delete vertexBuffer;
+		vertexBuffer = nullptr;
+	}
+	for (IndexBuffer*& indexBuffer : m_meshChunkIndexBuffers)
 	{
-		AddVertsForSphere3D(diffuseVerts, diffuseIndices, shape->m_position, shape->m_radius);
+		delete indexBuffer;
+		indexBuffer = nullptr;
 	}
+	m_meshChunkVertexBuffers.clear();
+	m_meshChunkIndexBuffers.clear();
+	m_meshChunkIndexCounts.clear();
+}
 
+void GameRayMarching::RenderMeshes() const
+{
 	DiffuseRenderResources resources;
 	resources.diffuseTextureIndex = g_theRenderer->GetSrvIndexFromLoadedTexture(nullptr);
 	resources.diffuseSamplerIndex = g_theRenderer->GetDefaultSamplerIndex(SamplerMode::POINT_WARP);
@@ -287,7 +317,13 @@ void GameRayMarching::RenderMeshes() const
 	g_theRenderer->SetDepthMode(DepthMode::READ_WRITE_LESS_EQUAL);
 	g_theRenderer->SetRenderTargetFormats();
 
-	g_theRenderer->DrawIndexedVertexArray(diffuseVerts, diffuseIndices);
+	for (int chunkIndex = 0; chunkIndex < (int)m_meshChunkIndexCounts.size(); ++chunkIndex)
+	{
+		if (m_meshChunkIndexCounts[chunkIndex] > 0)
+		{
+			g_theRenderer->DrawIndexedVertexBuffer(m_meshChunkVertexBuffers[chunkIndex], m_meshChunkIndexBuffers[chunkIndex], m_meshChunkIndexCounts[chunkIndex]);
+		}
+	}
 }
 
 void GameRayMarching::RenderFullScreenQuad() const
@@ -310,12 +346,14 @@ void GameRayMarching::RenderFullScreenQuad() const
 
 void GameRayMarching::UpdateRayMarching()
 {
-	int numOfShapes = (int)m_shapes.size();
+	int numOfShapes = m_shapeSimulation.GetNumShapes();
+	bool isHalf = (m_currentRayMarchingConstants.halfPrecisionGeometry != 0);
 
-	if (m_shapeBuffer == nullptr || m_shapeBuffer->GetSize() < numOfShapes * sizeof(SdfShape))
-	{
-		ResizeShapeBuffer(numOfShapes);
-	}
+	// Switching the geometry precision recreates its slots as they come round, no-op otherwise
+	m_shapeGeometryRing.SetDevice(&m_shapeGeometryDevice, SdfShapeStreams::GetGeometryStride(isHalf));
+	m_shapeMaterialRing.SetDevice(&m_shapeMaterialDevice, sizeof(SdfShapeMaterial));
+	m_bvhRing.SetDevice(&m_bvhDevice, sizeof(SdfBvhNode));
+	m_tileListRing.SetDevice(&m_tileListDevice, sizeof(uint32_t));
 
 	IntVec2 desiredDimensions = Window::s_mainWindow->GetClientDimensions();
 	if (m_rayMarchingDstTexture == nullptr || m_rayMarchingDstTexture->GetDimensions() != desiredDimensions)
@@ -328,29 +366,236 @@ void GameRayMarching::UpdateRayMarching()
 		ResizeDepthTexture(desiredDimensions);
 	}
 
-	// Get Data
-	std::vector<SdfShape> shapeData;
-	shapeData.reserve(numOfShapes);
-	for (int i = 0; i < numOfShapes; ++i)
+	IntVec2 coneDimensions = SdfCpuRayMarcher::GetConeDepthDimensions(desiredDimensions);
+	if (m_currentRayMarchingConstants.useConeDepthPrepass && (m_coneDepthTexture == nullptr || m_coneDepthTexture->GetDimensions() != coneDimensions))
+	{
+		ResizeConeDepthTexture(coneDimensions);
+	}
+
+	if (m_currentRayMarchingConstants.useTemporalReprojection && (m_temporalStartTexture == nullptr || m_temporalStartTexture->GetDimensions() != desiredDimensions))
+	{
+		ResizeTemporalStartTexture(desiredDimensions);
+	}
+
+	if (m_currentRayMarchingConstants.useDeferredShading && (m_gbufferTexture == nullptr || m_gbufferTexture->GetDimensions() != desiredDimensions))
+	{
+		ResizeDeferredShadingTextures(desiredDimensions);
+	}
+
+	// Textures above are window sized, everything below works on the marched part of them
+	m_renderDimensions = m_useDynamicResolution ? SdfDynamicResolution::GetBucketDimensions(m_dynamicResolution.GetBucket(), desiredDimensions) : desiredDimensions;
+
+	// Get Data, the shape list is only needed to build a BVH or a CSG tree from, or to find the dirty tiles with
+	if (m_currentRayMarchingConstants.useBvh || m_currentRayMarchingConstants.useCsgProgram || m_useIncrementalRender)
 	{
-		shapeData.push_back(m_shapes[i]->GetShape());
+		m_shapeSimulation.GetShapes(m_frameShapes);
 	}
 
-	g_theRenderer->UpdateBuffer(*m_shapeBuffer, shapeData.size() * sizeof(SdfShape), shapeData.data());
+	// Shapes only move a little per frame: refit, and rebuild now and then so the tree stays tight
+	bool isStreamReordered = true;
+	if (m_currentRayMarchingConstants.useBvh)
+	{
+		bool isRefit = (m_bvh.GetNumShapes() == numOfShapes) && (m_framesSinceBvhBuild < SDF_BVH_REBUILD_INTERVAL);
+		m_bvh.UpdateShapeStreams(m_frameShapes, m_currentRayMarchingConstants.toleranceK, isHalf, isRefit, m_shapeStreams);
+		m_framesSinceBvhBuild = isRefit ? m_framesSinceBvhBuild + 1 : 0;
+		isStreamReordered = !isRefit;
+		m_areStreamMaterialsStale = true;
+	}
+	else
+	{
+		m_bvh.Clear(); // streams written by UpdateShapes
+		isStreamReordered = false;
+	}
+
+	// Every ring uploads once per frame, so they all move to the same slot
+	std::vector<SdfBvhNode> const& nodes = m_bvh.GetNodes();
+	m_shapeGeometryRing.Upload(m_shapeStreams.GetGeometryData(isHalf), numOfShapes);
+	m_shapeMaterialRing.Upload(m_shapeStreams.m_shapeMaterials.data(), numOfShapes);
+	m_bvhRing.Upload(nodes.data(), (int)nodes.size());
 	
+	// Bin the uploaded streams (BVH order or not) into the dispatch's thread group tiles
+	if (m_currentRayMarchingConstants.useTileBinning)
+	{
+		m_tileBinning.Build(GetSdfView(), m_renderDimensions, m_shapeStreams, isHalf, m_currentRayMarchingConstants.toleranceK);
+
+		std::vector<SdfTileRange> const& tileRanges = m_tileBinning.GetTileRanges();
+		std::vector<uint32_t> const& tileShapeIndices = m_tileBinning.GetShapeIndices();
+		if (m_tileRangeBuffer == nullptr || m_tileRangeCapacity < (int)tileRanges.size() || m_tileShapeIndexCapacity < (int)tileShapeIndices.size())
+		{
+			ResizeTileBuffers((int)tileRanges.size(), (int)tileShapeIndices.size());
+		}
+		g_theRenderer->UpdateBuffer(*m_tileRangeBuffer, tileRanges.size() * sizeof(SdfTileRange), tileRanges.data());
+		if (!tileShapeIndices.empty())
+		{
+			g_theRenderer->UpdateBuffer(*m_tileShapeIndexBuffer, tileShapeIndices.size() * sizeof(uint32_t), tileShapeIndices.data());
+		}
+		m_currentRayMarchingConstants.numOfTilesX = m_tileBinning.GetNumTiles().x;
+	}
+
+	// Same streams and view: the tiles no shape can reach are filled instead of marched
+	if (m_currentRayMarchingConstants.useTileClassification)
+	{
+		m_tileClassification.Classify(GetSdfView(), m_renderDimensions, m_shapeStreams, isHalf, m_currentRayMarchingConstants);
+	}
+
+	if (m_currentRayMarchingConstants.useBrickMap)
+	{
+		UpdateBrickMap(isStreamReordered);
+	}
+	else
+	{
+		m_brickMap.Clear();
+	}
+
+	// A failed compile leaves the toggle alone and blends the shapes, which is another field
+	bool wasCsgProgramValid = m_isCsgProgramValid;
+	m_isCsgProgramValid = false;
+	if (m_currentRayMarchingConstants.useCsgProgram)
+	{
+		UpdateCsgProgram();
+	}
+	if (m_isCsgProgramValid != wasCsgProgramValid)
+	{
+		m_isTemporalHistoryValid = false;
+		m_dirtyTiles.Invalidate();
+	}
+
 	m_currentRayMarchingConstants.numOfShapes = numOfShapes;
-	m_currentRayMarchingConstants.screenWidth = desiredDimensions.x;
-	m_currentRayMarchingConstants.screenHeight = desiredDimensions.y;
+	m_currentRayMarchingConstants.numOfBvhNodes = (int)m_bvh.GetNodes().size();
+	m_currentRayMarchingConstants.screenWidth = m_renderDimensions.x;
+	m_currentRayMarchingConstants.screenHeight = m_renderDimensions.y;
+
+	// Against the frame the output texture holds. Mesh Mode does not march, so the frame after it has nothing to keep.
+	if (!m_useIncrementalRender || m_comboInt != 0)
+	{
+		m_dirtyTiles.Invalidate();
+	}
+	SdfTileClassification const* classification = m_currentRayMarchingConstants.useTileClassification ? &m_tileClassification : nullptr;
+	std::vector<uint32_t> const* streamOrder = m_currentRayMarchingConstants.useBvh ? &m_bvh.GetShapeOrder() : nullptr;
+	m_dirtyTiles.Update(GetSdfView(), m_renderDimensions, m_frameShapes, streamOrder, m_currentRayMarchingConstants, GetLightConstants(), GetDebugInt(), classification);
+
+	// The tile list the march covers: the dirty tiles of a partial frame, or every classified one
+	if (m_dirtyTiles.GetState() == SdfDirtyState::PARTIAL)
+	{
+		std::vector<uint32_t> const& tileList = m_dirtyTiles.GetTileList();
+		m_tileListRing.Upload(tileList.data(), (int)tileList.size());
+		m_currentRayMarchingConstants.numOccupiedTiles = m_dirtyTiles.GetNumMarchTiles();
+		m_currentRayMarchingConstants.numBackgroundTiles = m_dirtyTiles.GetNumFillTiles();
+	}
+	else if (classification)
+	{
+		std::vector<uint32_t> const& tileList = m_tileClassification.GetTileList();
+		m_tileListRing.Upload(tileList.data(), (int)tileList.size());
+		m_currentRayMarchingConstants.numOccupiedTiles = m_tileClassification.GetNumOccupiedTiles();
+		m_currentRayMarchingConstants.numBackgroundTiles = m_tileClassification.GetNumBackgroundTiles();
+	}
 
-	g_theRenderer->UpdateBuffer(*m_rayMarchingConstantBuffer, sizeof(SdfRayMarchingConstants), &m_currentRayMarchingConstants);
+	// The depth texture still holds the last ray marched frame, unless it was resized or rendered at another bucket since
+	SdfCpuView view = GetSdfView();
+	SdfRayMarchingConstants& constants = m_currentRayMarchingConstants;
+	constants.hasTemporalHistory = (m_isTemporalHistoryValid && m_temporalHistoryDimensions == m_renderDimensions) ? 1 : 0;
+	constants.temporalMaxShapeMove = m_maxShapeMove + (isHalf ? HALF_GEOMETRY_MOVE_SLACK : 0.f);
+	constants.cameraForward = view.m_forward;
+	constants.cameraLeft = view.m_left;
+	constants.cameraUp = view.m_up;
+	constants.tanHalfFovY = TanDegrees(0.5f * view.m_fovDegrees);
+	constants.tanHalfFovX = constants.tanHalfFovY * view.m_aspect;
+	constants.prevCameraPosition = m_temporalHistoryView.m_position;
+	constants.prevCameraForward = m_temporalHistoryView.m_forward;
+	constants.prevCameraLeft = m_temporalHistoryView.m_left;
+	constants.prevCameraUp = m_temporalHistoryView.m_up;
+	constants.prevCameraNear = m_temporalHistoryView.m_near;
+	constants.prevCameraFar = m_temporalHistoryView.m_far;
+	constants.prevTanHalfFovY = TanDegrees(0.5f * m_temporalHistoryView.m_fovDegrees);
+	constants.prevTanHalfFovX = constants.prevTanHalfFovY * m_temporalHistoryView.m_aspect;
+
+	m_temporalHistoryView = view;
+	m_temporalHistoryDimensions = m_renderDimensions;
+	m_isTemporalHistoryValid = (m_comboInt == 0); // Render marches this frame
+
+	UpdateCostCounters(desiredDimensions);
+
+	// The shader walks any tile list through the classification path, the toggles themselves stay the user's
+	SdfRayMarchingConstants uploadedConstants = m_currentRayMarchingConstants;
+	if (m_dirtyTiles.GetState() == SdfDirtyState::PARTIAL)
+	{
+		uploadedConstants.useTileClassification = 1;
+	}
+	if (!m_isCsgProgramValid)
+	{
+		uploadedConstants.useCsgProgram = 0;
+	}
+	g_theRenderer->UpdateBuffer(*m_rayMarchingConstantBuffer, sizeof(SdfRayMarchingConstants), &uploadedConstants);
 }
 
 void GameRayMarching::RenderRayMarching() const
 {
+	// Nothing changed since the frame in the output texture
+	if (m_dirtyTiles.GetState() != SdfDirtyState::CLEAN)
+	{
+		DispatchRayMarching();
+	}
+
+	// Draw full screen quad with depth
+	g_theRenderer->TransitionToPixelShaderResource(*m_rayMarchingDstTexture);
+	g_theRenderer->TransitionToPixelShaderResource(*m_rayMarchingDepthTexture);
+
+	FullScreenQuadWithDepthResources fullScreenQuadWithDepthRes;
+	fullScreenQuadWithDepthRes.textureIndex = m_rayMarchingSRV.m_index;
+	fullScreenQuadWithDepthRes.depthTexIndex = m_rayMarchingDepthSRV.m_index;
+	fullScreenQuadWithDepthRes.samplerIndex = g_theRenderer->GetDefaultSamplerIndex(SamplerMode::BILINEAR_CLAMP);
+	if (m_useDynamicResolution)
+	{
+		fullScreenQuadWithDepthRes.renderWidth = (uint32_t)m_renderDimensions.x;
+		fullScreenQuadWithDepthRes.renderHeight = (uint32_t)m_renderDimensions.y;
+		fullScreenQuadWithDepthRes.useEdgeAwareUpscale = m_useEdgeAwareUpscale ? 1 : 0;
+	}
+
+	g_theRenderer->SetGraphicsBindlessResources(sizeof(FullScreenQuadWithDepthResources), &fullScreenQuadWithDepthRes);
+
+	g_theRenderer->BindShader(m_fullScreenQuadWithDepthShader);
+	g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
+	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
+	g_theRenderer->SetDepthMode(DepthMode::READ_WRITE_LESS_EQUAL);
+	g_theRenderer->SetRenderTargetFormats();
+
+	g_theRenderer->DrawProcedural(6);
+}
+
+void GameRayMarching::DispatchRayMarching() const
+{
+	const bool isPartial = (m_dirtyTiles.GetState() == SdfDirtyState::PARTIAL);
+	const bool useTileList = isPartial || (m_currentRayMarchingConstants.useTileClassification != 0);
+
 	g_theRenderer->TransitionToUnorderedAccess(*m_rayMarchingDstTexture);
 	g_theRenderer->TransitionToUnorderedAccess(*m_rayMarchingDepthTexture);
 	g_theRenderer->TransitionToGenericRead(*m_rayMarchingConstantBuffer);
-	g_theRenderer->TransitionToGenericRead(*m_shapeBuffer);
+	g_theRenderer->TransitionToGenericRead(*m_shapeGeometryDevice.GetBuffer(m_shapeGeometryRing.GetCurrentSlot()));
+	g_theRenderer->TransitionToGenericRead(*m_shapeMaterialDevice.GetBuffer(m_shapeMaterialRing.GetCurrentSlot()));
+	g_theRenderer->TransitionToGenericRead(*m_materialBuffer);
+	g_theRenderer->TransitionToGenericRead(*m_bvhDevice.GetBuffer(m_bvhRing.GetCurrentSlot()));
+	if (m_currentRayMarchingConstants.useTileBinning)
+	{
+		g_theRenderer->TransitionToGenericRead(*m_tileRangeBuffer);
+		g_theRenderer->TransitionToGenericRead(*m_tileShapeIndexBuffer);
+	}
+	if (m_currentRayMarchingConstants.useBrickMap)
+	{
+		g_theRenderer->TransitionToGenericRead(*m_brickBuffer);
+		g_theRenderer->TransitionToGenericRead(*m_brickSampleBuffer);
+	}
+	if (m_isCsgProgramValid)
+	{
+		g_theRenderer->TransitionToGenericRead(*m_csgProgramBuffer);
+		if (m_csgGridSampleBuffer)
+		{
+			g_theRenderer->TransitionToGenericRead(*m_csgGridSampleBuffer);
+		}
+	}
+	if (useTileList)
+	{
+		g_theRenderer->TransitionToGenericRead(*m_tileListDevice.GetBuffer(m_tileListRing.GetCurrentSlot()));
+	}
 
 
 	SdfRayMarchingResources rayMarchingRes;
@@ -360,55 +605,448 @@ void GameRayMarching::RenderRayMarching() const
 	rayMarchingRes.lightConstantsIndex = g_theRenderer->GetCurrentLightConstantsIndex();
 	rayMarchingRes.perFrameConstantsIndex = g_theRenderer->GetCurrentPerFrameConstantsIndex();
 
-	rayMarchingRes.inputSdfShapesIndex = m_shapeBufferSRV.m_index;
+	rayMarchingRes.inputSdfGeometryIndex = m_shapeGeometryDevice.GetSRV(m_shapeGeometryRing.GetCurrentSlot()).m_index;
+	rayMarchingRes.inputSdfShapeMaterialsIndex = m_shapeMaterialDevice.GetSRV(m_shapeMaterialRing.GetCurrentSlot()).m_index;
+	rayMarchingRes.inputSdfMaterialsIndex = m_materialBufferSRV.m_index;
+	rayMarchingRes.inputSdfBvhIndex = m_bvhDevice.GetSRV(m_bvhRing.GetCurrentSlot()).m_index;
+	rayMarchingRes.inputTileRangesIndex = m_tileRangeBufferSRV.m_index;
+	rayMarchingRes.inputTileShapeIndicesIndex = m_tileShapeIndexBufferSRV.m_index;
+	rayMarchingRes.inputBricksIndex = m_brickBufferSRV.m_index;
+	rayMarchingRes.inputBrickSamplesIndex = m_brickSampleBufferSRV.m_index;
+	rayMarchingRes.inputCsgProgramIndex = m_csgProgramSRV.m_index;
+	rayMarchingRes.inputCsgGridSamplesIndex = m_csgGridSampleSRV.m_index;
+	if (useTileList)
+	{
+		rayMarchingRes.inputTileListIndex = m_tileListDevice.GetSRV(m_tileListRing.GetCurrentSlot()).m_index;
+	}
 	rayMarchingRes.outputTextureIndex = m_rayMarchingUAV.m_index;
 	rayMarchingRes.outputDepthIndex = m_rayMarchingDepthUAV.m_index;
 	rayMarchingRes.rayMarchingConstantsIndex = m_rayMarchingConstantBufferCBV.m_index;
 
+	if (m_currentRayMarchingConstants.useConeDepthPrepass)
+	{
+		g_theRenderer->TransitionToUnorderedAccess(*m_coneDepthTexture);
+		rayMarchingRes.coneDepthIndex = m_coneDepthUAV.m_index;
+
+		SdfRayMarchingResources coneRes = rayMarchingRes;
+		coneRes.prePass = SDF_PREPASS_CONE_DEPTH;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &coneRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(m_coneDepthTexture->GetDimensions().x, m_coneDepthTexture->GetDimensions().y, 8, 8);
+
+		// Round trip through a read state so the cone writes land before the full-res pass reads them
+		g_theRenderer->TransitionToPixelShaderResource(*m_coneDepthTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_coneDepthTexture);
+	}
+
+	if (m_currentRayMarchingConstants.useTemporalReprojection)
+	{
+		g_theRenderer->TransitionToUnorderedAccess(*m_temporalStartTexture);
+		rayMarchingRes.temporalStartIndex = m_temporalStartUAV.m_index;
+	}
+	if (m_currentRayMarchingConstants.useTemporalReprojection && m_currentRayMarchingConstants.hasTemporalHistory)
+	{
+		IntVec2 temporalDimensions = m_temporalStartTexture->GetDimensions();
+		SdfRayMarchingResources temporalRes = rayMarchingRes;
+		temporalRes.prePass = SDF_PREPASS_TEMPORAL_CLEAR;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &temporalRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(temporalDimensions.x, temporalDimensions.y, 8, 8);
+
+		g_theRenderer->TransitionToPixelShaderResource(*m_temporalStartTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_temporalStartTexture);
+
+		// Reads last frame's depth, so it runs before the march overwrites it
+		temporalRes.prePass = SDF_PREPASS_TEMPORAL_SCATTER;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &temporalRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(temporalDimensions.x, temporalDimensions.y, 8, 8);
+
+		g_theRenderer->TransitionToPixelShaderResource(*m_temporalStartTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_temporalStartTexture);
+		g_theRenderer->TransitionToPixelShaderResource(*m_rayMarchingDepthTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_rayMarchingDepthTexture);
+	}
+
+	if (m_currentRayMarchingConstants.useCostCounters)
+	{
+		g_theRenderer->TransitionToUnorderedAccess(*m_costCountersTexture);
+		rayMarchingRes.costCountersIndex = m_costCountersUAV.m_index;
+	}
+
+	if (m_currentRayMarchingConstants.useDeferredShading)
+	{
+		g_theRenderer->TransitionToUnorderedAccess(*m_gbufferTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_gbufferShapesTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_shadeBinsTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_shadePixelsTexture);
+		rayMarchingRes.gbufferIndex = m_gbufferUAV.m_index;
+		rayMarchingRes.gbufferShapesIndex = m_gbufferShapesUAV.m_index;
+		rayMarchingRes.shadeBinsIndex = m_shadeBinsUAV.m_index;
+		rayMarchingRes.shadePixelsIndex = m_shadePixelsUAV.m_index;
+
+		SdfRayMarchingResources clearRes = rayMarchingRes;
+		clearRes.prePass = SDF_PREPASS_SHADE_CLEAR;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &clearRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(SDF_SHADE_BINS, 2, 8, 8);
+
+		// The march counts into the cleared bins
+		g_theRenderer->TransitionToPixelShaderResource(*m_shadeBinsTexture);
+		g_theRenderer->TransitionToUnorderedAccess(*m_shadeBinsTexture);
+	}
+
 	g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &rayMarchingRes);
 
 	g_theRenderer->BindComputeShader(m_rayMarchingShader);
-	g_theRenderer->Dispatch2D(m_rayMarchingDstTexture->GetWidth(), m_rayMarchingDstTexture->GetWidth(), 8, 8); // need to be same in HLSL, may be larger
+	if (useTileList)
+	{
+		// A group per listed tile; the fill writes the background tiles what a miss writes, both sized on the CPU
+		SdfDispatchArguments marchArguments = isPartial ? SdfTileClassification::GetListArguments(m_dirtyTiles.GetNumMarchTiles()) : m_tileClassification.GetMarchArguments();
+		if (marchArguments.m_threadGroupCountX > 0)
+		{
+			g_theRenderer->Dispatch2D(marchArguments.m_threadGroupCountX * 8, marchArguments.m_threadGroupCountY * 8, 8, 8);
+		}
 
+		SdfDispatchArguments fillArguments = isPartial ? SdfTileClassification::GetListArguments(m_dirtyTiles.GetNumFillTiles()) : m_tileClassification.GetFillArguments();
+		if (fillArguments.m_threadGroupCountX > 0)
+		{
+			SdfRayMarchingResources fillRes = rayMarchingRes;
+			fillRes.prePass = SDF_PREPASS_BACKGROUND_FILL;
+			g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &fillRes);
+			g_theRenderer->BindComputeShader(m_rayMarchingShader);
+			g_theRenderer->Dispatch2D(fillArguments.m_threadGroupCountX * 8, fillArguments.m_threadGroupCountY * 8, 8, 8);
+		}
+	}
+	else
+	{
+		g_theRenderer->Dispatch2D(m_renderDimensions.x, m_renderDimensions.y, 8, 8); // need to be same in HLSL, the shader skips the pixels past the edge
+	}
 
-	//-----------------------------------------------------------------------------------------------
-	// Draw full screen quad with depth
-	g_theRenderer->TransitionToPixelShaderResource(*m_rayMarchingDstTexture);
-	g_theRenderer->TransitionToPixelShaderResource(*m_rayMarchingDepthTexture);
+	if (m_currentRayMarchingConstants.useDeferredShading)
+	{
+		// Every pass reads what the one before wrote, so each is followed by a round trip through a read state
+		auto roundTrip = [](Texture* texture)
+		{
+			g_theRenderer->TransitionToPixelShaderResource(*texture);
+			g_theRenderer->TransitionToUnorderedAccess(*texture);
+		};
+		roundTrip(m_gbufferTexture);
+		roundTrip(m_gbufferShapesTexture);
+		roundTrip(m_shadeBinsTexture);
+
+		// Coarse shading counts the shaded hits once the whole G-buffer is written
+		const bool useShadingRate = (m_currentRayMarchingConstants.shadingRate > 1);
+		SdfRayMarchingResources shadeRes = rayMarchingRes;
+		if (useShadingRate)
+		{
+			shadeRes.prePass = SDF_PREPASS_SHADE_COUNT;
+			g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &shadeRes);
+			g_theRenderer->BindComputeShader(m_rayMarchingShader);
+			g_theRenderer->Dispatch2D(m_renderDimensions.x, m_renderDimensions.y, 8, 8);
+			roundTrip(m_shadeBinsTexture);
+		}
 
-	FullScreenQuadWithDepthResources fullScreenQuadWithDepthRes;
-	fullScreenQuadWithDepthRes.textureIndex = m_rayMarchingSRV.m_index;
-	fullScreenQuadWithDepthRes.depthTexIndex = m_rayMarchingDepthSRV.m_index;
-	fullScreenQuadWithDepthRes.samplerIndex = g_theRenderer->GetDefaultSamplerIndex(SamplerMode::BILINEAR_CLAMP);
+		shadeRes.prePass = SDF_PREPASS_SHADE_PREFIX;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &shadeRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(8, 8, 8, 8); // one group, a thread per bin
+		roundTrip(m_shadeBinsTexture);
+
+		shadeRes.prePass = SDF_PREPASS_SHADE_SCATTER;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &shadeRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(m_renderDimensions.x, m_renderDimensions.y, 8, 8);
+		roundTrip(m_shadeBinsTexture);
+		roundTrip(m_shadePixelsTexture);
+
+		// The shaded color and the material count go over what the march wrote for the same pixels
+		roundTrip(m_rayMarchingDstTexture);
+		if (m_currentRayMarchingConstants.useCostCounters)
+		{
+			roundTrip(m_costCountersTexture);
+		}
 
-	g_theRenderer->SetGraphicsBindlessResources(sizeof(FullScreenQuadWithDepthResources), &fullScreenQuadWithDepthRes);
+		// As many slots as pixels, the shader skips the ones past the hit count
+		shadeRes.prePass = SDF_PREPASS_SHADE;
+		g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &shadeRes);
+		g_theRenderer->BindComputeShader(m_rayMarchingShader);
+		g_theRenderer->Dispatch2D(m_renderDimensions.x, m_renderDimensions.y, 8, 8);
 
-	g_theRenderer->BindShader(m_fullScreenQuadWithDepthShader);
-	g_theRenderer->SetBlendMode(BlendMode::OPAQUE);
-	g_theRenderer->SetRasterizerMode(RasterizerMode::SOLID_CULL_BACK);
-	g_theRenderer->SetDepthMode(DepthMode::READ_WRITE_LESS_EQUAL);
-	g_theRenderer->SetRenderTargetFormats();
+		// The reused pixels read the color ShadePass wrote for their block
+		if (useShadingRate)
+		{
+			roundTrip(m_rayMarchingDstTexture);
+			shadeRes.prePass = SDF_PREPASS_SHADE_RESOLVE;
+			g_theRenderer->SetComputeBindlessResources(sizeof(SdfRayMarchingResources), &shadeRes);
+			g_theRenderer->BindComputeShader(m_rayMarchingShader);
+			g_theRenderer->Dispatch2D(m_renderDimensions.x, m_renderDimensions.y, 8, 8);
+		}
+	}
+}
 
-	g_theRenderer->DrawProcedural(6);
+void GameRayMarching::DestroyShapeBuffers()
+{
+	m_shapeGeometryRing.Shutdown();
+	m_shapeMaterialRing.Shutdown();
+	m_bvhRing.Shutdown();
+	m_tileListRing.Shutdown();
+}
 
+void GameRayMarching::CreateMaterialBuffer()
+{
+	m_materials.resize(NUM_TRIPLANAR_TEX);
+	for (int matID = 0; matID < NUM_TRIPLANAR_TEX; ++matID)
+	{
+		SdfMaterial& material = m_materials[matID];
+		material.m_triAlbedoTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triAlbedoTexs[matID], DefaultTexture::CheckerboardMagentaBlack2D);
+		material.m_triMRTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triMRTexs[matID], DefaultTexture::DefaultOcclusionRoughnessMetalnessMap);
+		material.m_triNormalTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triNormalTexs[matID], DefaultTexture::DefaultNormalMap);
+		material.m_triOcclusionTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triOcclusionTexs[matID], DefaultTexture::DefaultOcclusionRoughnessMetalnessMap);
+		material.m_triEmissiveTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triEmissiveTexs[matID], DefaultTexture::BlackOpaque2D);
+	}
+
+	BufferInit initData;
+	initData.m_size = m_materials.size() * sizeof(SdfMaterial);
+	m_materialBuffer = g_theRenderer->CreateBuffer(initData);
+	m_materialBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_materialBuffer, sizeof(SdfMaterial), (int)m_materials.size());
 
+	g_theRenderer->UpdateBuffer(*m_materialBuffer, m_materials.size() * sizeof(SdfMaterial), m_materials.data());
 }
 
-void GameRayMarching::ResizeShapeBuffer(int numOfShapes)
+void GameRayMarching::DestroyMaterialBuffer()
 {
-	DestroyShapeBuffer();
-	// If the buffer is nullptr or the size is not enough, create a new one
-	BufferInit initData;
-	initData.m_size = numOfShapes * sizeof(SdfShape);
-	m_shapeBuffer = g_theRenderer->CreateBuffer(initData);
+	g_theRenderer->DestroyBuffer(m_materialBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_materialBufferSRV);
+}
 
-	m_shapeBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_shapeBuffer, sizeof(SdfShape), numOfShapes);
+void GameRayMarching::ResizeTileBuffers(int numOfTiles, int numOfTileShapeIndices)
+{
+	DestroyTileBuffers();
+	// Index count changes with the view every frame, leave room so the buffer is not recreated each time
+	m_tileRangeCapacity = numOfTiles;
+	m_tileShapeIndexCapacity = (numOfTileShapeIndices > 0) ? numOfTileShapeIndices * 2 : 1;
+
+	BufferInit rangeInit;
+	rangeInit.m_size = m_tileRangeCapacity * sizeof(SdfTileRange);
+	m_tileRangeBuffer = g_theRenderer->CreateBuffer(rangeInit);
+	m_tileRangeBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_tileRangeBuffer, sizeof(SdfTileRange), m_tileRangeCapacity);
+
+	BufferInit indexInit;
+	indexInit.m_size = m_tileShapeIndexCapacity * sizeof(uint32_t);
+	m_tileShapeIndexBuffer = g_theRenderer->CreateBuffer(indexInit);
+	m_tileShapeIndexBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_tileShapeIndexBuffer, sizeof(uint32_t), m_tileShapeIndexCapacity);
 }
 
-void GameRayMarching::DestroyShapeBuffer()
+void GameRayMarching::UpdateCsgProgram()
 {
-	g_theRenderer->DestroyBuffer(m_shapeBuffer);
-	g_theRenderer->EnqueueDeferredRelease(m_shapeBufferSRV);
+	m_csgTree.Clear();
+	int spheres = SDF_CSG_NO_NODE;
+	if (m_isBakedModelInCsg && !m_bakedGrids.empty())
+	{
+		std::vector<SdfShape> csgShapes = m_frameShapes;
+		csgShapes.push_back(m_bakedModelShape);
+		spheres = m_csgTree.AddShapes(csgShapes, m_currentRayMarchingConstants.toleranceK, &m_bakedGrids);
+	}
+	else
+	{
+		spheres = m_csgTree.AddShapes(m_frameShapes, m_currentRayMarchingConstants.toleranceK);
+	}
+	int cutter = m_csgTree.AddBox(Vec3(), Vec3(CSG_CUTTER_HALF_EXTENT, CSG_CUTTER_HALF_EXTENT, CSG_CUTTER_HALF_EXTENT));
+	int rotatedCutter = m_csgTree.AddTransform(cutter, SdfCsgTransform::MakeFromAxisAngle(Vec3(1.f, 1.f, 1.f), m_csgCutterDegrees, Vec3()));
+	int root = (spheres == SDF_CSG_NO_NODE) ? rotatedCutter : m_csgTree.AddSubtraction(spheres, rotatedCutter);
+
+	// Too deep for the shader's stack: blend the shapes this frame
+	if (!CompileSdfCsg(m_csgTree, root, SdfCsgCompileOptions(), m_csgProgram))
+	{
+		return;
+	}
+	m_isCsgProgramValid = true;
+
+	std::vector<SdfCsgInstruction> const& instructions = m_csgProgram.m_instructions;
+	if (m_csgProgramBuffer == nullptr || m_csgProgramCapacity < (int)instructions.size())
+	{
+		ResizeCsgProgramBuffer((int)instructions.size());
+	}
+	g_theRenderer->UpdateBuffer(*m_csgProgramBuffer, instructions.size() * sizeof(SdfCsgInstruction), instructions.data());
+	m_currentRayMarchingConstants.numCsgInstructions = (int)instructions.size();
+
+	// Only the one baked grid ever goes in, its samples are uploaded once
+	std::vector<float> const& gridSamples = m_csgProgram.m_gridSamples;
+	if (!gridSamples.empty() && m_csgGridSampleCount != (int)gridSamples.size())
+	{
+		ResizeCsgGridSampleBuffer((int)gridSamples.size());
+		g_theRenderer->UpdateBuffer(*m_csgGridSampleBuffer, gridSamples.size() * sizeof(float), gridSamples.data());
+	}
+}
+
+void GameRayMarching::ResizeCsgProgramBuffer(int numOfInstructions)
+{
+	DestroyCsgProgramBuffer();
+	// Grows with the shape count, leave room so spawning does not recreate it every time
+	m_csgProgramCapacity = numOfInstructions * 2;
+
+	BufferInit programInit;
+	programInit.m_size = m_csgProgramCapacity * sizeof(SdfCsgInstruction);
+	m_csgProgramBuffer = g_theRenderer->CreateBuffer(programInit);
+	m_csgProgramSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_csgProgramBuffer, sizeof(SdfCsgInstruction), m_csgProgramCapacity);
+}
+
+void GameRayMarching::DestroyCsgProgramBuffer()
+{
+	g_theRenderer->DestroyBuffer(m_csgProgramBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_csgProgramSRV);
+	m_csgProgramCapacity = 0;
+}
+
+void GameRayMarching::BakeTestModel()
+{
+	// Same model as GamePBR and GameTriplanarMapping
+	std::vector<Vertex_PCUTBN> verts;
+	std::vector<unsigned int> indexes;
+	AddVertsForSphere3D(verts, indexes, Vec3(0.f, 0.f, 2.f), 1.f);
+	AddVertsForAABB3D(verts, indexes, AABB3(Vec3(2.f, 2.f, 0.f), Vec3(3.f, 3.f, 1.f)));
+
+	std::vector<Vec3> positions;
+	positions.reserve(verts.size());
+	for (Vertex_PCUTBN const& vert : verts)
+	{
+		positions.push_back(vert.m_position);
+	}
+
+	SdfBakeOptions options;
+	options.m_resolution = TEST_MODEL_BAKE_RESOLUTION;
+	m_bakedGrids.resize(1);
+	if (!BakeSdfMesh(positions, indexes, options, GetJobPool(), m_bakedGrids[0], &m_bakeStats))
+	{
+		m_bakedGrids.clear();
+		return;
+	}
+	// Mesh bounds (-1, -1, 0) to (3, 3, 3), centered on the activity box
+	m_bakedModelShape = SdfShape::MakeBakedGrid(Vec3(-1.f, -1.f, -1.5f), 1.f, 0);
+
+	// A file from an earlier run is fine too if it cannot be rewritten
+	WriteSdfBrickFile(TEST_MODEL_BRICK_FILE, m_bakedGrids[0], SdfBrickFileOptions(), &m_bakedModelFileStats);
+	if (m_bakedModelFile.Open(TEST_MODEL_BRICK_FILE) && m_bakedModelView.Open(m_bakedModelFile.GetData(), m_bakedModelFile.GetNumBytes()))
+	{
+		m_bakedModelStreamer.Init(&m_bakedModelView, BRICK_STREAM_CAPACITY);
+	}
+}
+
+void GameRayMarching::UpdateBrickStreaming()
+{
+	if (!m_bakedModelView.IsOpen())
+	{
+		return;
+	}
+	// The file is in mesh units
+	float scale = m_bakedModelShape.m_data0.w;
+	Vec3 modelPosition(m_bakedModelShape.m_data0.x, m_bakedModelShape.m_data0.y, m_bakedModelShape.m_data0.z);
+	m_bakedModelStreamer.Update((m_spectator->m_position - modelPosition) / scale, BRICK_STREAM_RADIUS / scale, BRICK_STREAM_LOADS_PER_FRAME);
+}
+
+void GameRayMarching::ResizeCsgGridSampleBuffer(int numOfSamples)
+{
+	DestroyCsgGridSampleBuffer();
+	m_csgGridSampleCount = numOfSamples;
+
+	BufferInit sampleInit;
+	sampleInit.m_size = numOfSamples * sizeof(float);
+	m_csgGridSampleBuffer = g_theRenderer->CreateBuffer(sampleInit);
+	m_csgGridSampleSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_csgGridSampleBuffer, sizeof(float), numOfSamples);
+}
+
+void GameRayMarching::DestroyCsgGridSampleBuffer()
+{
+	g_theRenderer->DestroyBuffer(m_csgGridSampleBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_csgGridSampleSRV);
+	m_csgGridSampleCount = 0;
+}
+
+void GameRayMarching::UpdateBrickMap(bool isStreamReordered)
+{
+	// Diffed against the geometry of the last bake, so moves from UpdateShapes only mark the bricks around them
+	bool isHalf = (m_currentRayMarchingConstants.halfPrecisionGeometry != 0);
+	int numOfShapes = m_shapeStreams.GetNumShapes();
+	m_brickMapGeometry.resize(numOfShapes);
+	for (int i = 0; i < numOfShapes; ++i)
+	{
+		m_brickMapGeometry[i] = m_shapeStreams.GetGeometry(i, isHalf);
+	}
+
+	// The shader's SdfMap without BVH or tiles. Both give the same field or above it, so the bound still holds.
+	float toleranceK = m_currentRayMarchingConstants.toleranceK;
+	std::vector<Vec4> const& geometry = m_brickMapGeometry;
+	auto sdfMap = [&geometry, toleranceK](Vec3 const& p)
+	{
+		float res = SDF_INFINITY_DIST;
+		for (Vec4 const& shapeGeometry : geometry)
+		{
+			res = SminCubic(res, SdfValueFromGeometry(p, shapeGeometry), toleranceK);
+		}
+		return res;
+	};
+
+	bool isBvhOrder = (m_currentRayMarchingConstants.useBvh != 0);
+	m_brickMap.Update(m_brickMapGeometry, toleranceK, sdfMap, GetJobPool(), isStreamReordered || (isBvhOrder != m_wasBrickMapBvhOrder));
+	m_wasBrickMapBvhOrder = isBvhOrder;
+
+	std::vector<SdfBrick> const& bricks = m_brickMap.GetBricks();
+	std::vector<float> const& samples = m_brickMap.GetSamples();
+	if (m_brickBuffer == nullptr || m_brickCapacity < (int)bricks.size() || m_brickSampleCapacity < (int)samples.size())
+	{
+		ResizeBrickBuffers((int)bricks.size(), (int)samples.size());
+	}
+	g_theRenderer->UpdateBuffer(*m_brickBuffer, bricks.size() * sizeof(SdfBrick), bricks.data());
+	if (!samples.empty())
+	{
+		g_theRenderer->UpdateBuffer(*m_brickSampleBuffer, samples.size() * sizeof(float), samples.data());
+	}
+
+	m_currentRayMarchingConstants.brickGridSize = m_brickMap.GetGridSize();
+	m_currentRayMarchingConstants.brickOdometer = m_brickMap.GetOdometer();
+	m_currentRayMarchingConstants.brickBlendLowering = m_brickMap.GetBlendLowering();
+	m_currentRayMarchingConstants.brickMapOrigin = m_brickMap.GetOrigin();
+	m_currentRayMarchingConstants.shapeBoundsMin = m_brickMap.GetShapeBoundsMin();
+	m_currentRayMarchingConstants.shapeBoundsMax = m_brickMap.GetShapeBoundsMax();
+}
+
+void GameRayMarching::ResizeBrickBuffers(int numOfBricks, int numOfBrickSamples)
+{
+	DestroyBrickBuffers();
+
+	m_brickCapacity = numOfBricks;
+	m_brickSampleCapacity = (numOfBrickSamples > 0) ? numOfBrickSamples * 2 : 1;
+
+	BufferInit brickInit;
+	brickInit.m_size = m_brickCapacity * sizeof(SdfBrick);
+	m_brickBuffer = g_theRenderer->CreateBuffer(brickInit);
+	m_brickBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_brickBuffer, sizeof(SdfBrick), m_brickCapacity);
+
+	BufferInit sampleInit;
+	sampleInit.m_size = m_brickSampleCapacity * sizeof(float);
+	m_brickSampleBuffer = g_theRenderer->CreateBuffer(sampleInit);
+	m_brickSampleBufferSRV = g_theRenderer->AllocateStructuredBufferSRV(*m_brickSampleBuffer, sizeof(float), m_brickSampleCapacity);
+}
+
+void GameRayMarching::DestroyBrickBuffers()
+{
+	g_theRenderer->DestroyBuffer(m_brickBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_brickBufferSRV);
+	g_theRenderer->DestroyBuffer(m_brickSampleBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_brickSampleBufferSRV);
+	m_brickCapacity = 0;
+	m_brickSampleCapacity = 0;
+}
+
+void GameRayMarching::DestroyTileBuffers()
+{
+	g_theRenderer->DestroyBuffer(m_tileRangeBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_tileRangeBufferSRV);
+	g_theRenderer->DestroyBuffer(m_tileShapeIndexBuffer);
+	g_theRenderer->EnqueueDeferredRelease(m_tileShapeIndexBufferSRV);
+	m_tileRangeCapacity = 0;
+	m_tileShapeIndexCapacity = 0;
 }
 
 void GameRayMarching::ResizeDstTexture(IntVec2 dimensions)
@@ -423,6 +1061,7 @@ void GameRayMarching::ResizeDstTexture(IntVec2 dimensions)
 	initData.m_allowUAV = true;
 	
 	m_rayMarchingDstTexture = g_theRenderer->CreateTexture(initData);
+	m_dirtyTiles.Invalidate(); // nothing to keep
 
 	m_rayMarchingUAV = g_theRenderer->AllocateUAV(*m_rayMarchingDstTexture);
 	m_rayMarchingSRV = g_theRenderer->AllocateSRV(*m_rayMarchingDstTexture);
@@ -447,6 +1086,7 @@ void GameRayMarching::ResizeDepthTexture(IntVec2 dimensions)
 	initData.m_allowUAV = true;
 
 	m_rayMarchingDepthTexture = g_theRenderer->CreateTexture(initData);
+	m_dirtyTiles.Invalidate();
 
 	m_rayMarchingDepthUAV = g_theRenderer->AllocateUAV(*m_rayMarchingDepthTexture);
 	m_rayMarchingDepthSRV = g_theRenderer->AllocateSRV(*m_rayMarchingDepthTexture);
@@ -459,6 +1099,134 @@ void GameRayMarching::DestroyDepthTexture()
 	g_theRenderer->EnqueueDeferredRelease(m_rayMarchingDepthSRV);
 }
 
+void GameRayMarching::ResizeConeDepthTexture(IntVec2 dimensions)
+{
+	DestroyConeDepthTexture();
+
+	// Same format as the depth texture, but holds view distances
+	TextureInit initData;
+	initData.m_width = dimensions.x;
+	initData.m_height = dimensions.y;
+	initData.m_format = DXGI_FORMAT_R32_FLOAT;
+	initData.m_allowUAV = true;
+
+	m_coneDepthTexture = g_theRenderer->CreateTexture(initData);
+
+	m_coneDepthUAV = g_theRenderer->AllocateUAV(*m_coneDepthTexture);
+}
+
+void GameRayMarching::DestroyConeDepthTexture()
+{
+	g_theRenderer->DestroyTexture(m_coneDepthTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_coneDepthUAV);
+}
+
+void GameRayMarching::ResizeTemporalStartTexture(IntVec2 dimensions)
+{
+	DestroyTemporalStartTexture();
+
+	// uint for InterlockedMin, holds asuint of view distances
+	TextureInit initData;
+	initData.m_width = dimensions.x;
+	initData.m_height = dimensions.y;
+	initData.m_format = DXGI_FORMAT_R32_UINT;
+	initData.m_allowUAV = true;
+
+	m_temporalStartTexture = g_theRenderer->CreateTexture(initData);
+
+	m_temporalStartUAV = g_theRenderer->AllocateUAV(*m_temporalStartTexture);
+}
+
+void GameRayMarching::DestroyTemporalStartTexture()
+{
+	g_theRenderer->DestroyTexture(m_temporalStartTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_temporalStartUAV);
+}
+
+void GameRayMarching::ResizeDeferredShadingTextures(IntVec2 dimensions)
+{
+	DestroyDeferredShadingTextures();
+
+	TextureInit gbufferInit;
+	gbufferInit.m_width = dimensions.x;
+	gbufferInit.m_height = dimensions.y;
+	gbufferInit.m_format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+	gbufferInit.m_allowUAV = true;
+
+	m_gbufferTexture = g_theRenderer->CreateTexture(gbufferInit);
+	m_gbufferUAV = g_theRenderer->AllocateUAV(*m_gbufferTexture);
+
+	TextureInit shapesInit = gbufferInit;
+	shapesInit.m_format = DXGI_FORMAT_R32G32B32A32_UINT;
+
+	m_gbufferShapesTexture = g_theRenderer->CreateTexture(shapesInit);
+	m_gbufferShapesUAV = g_theRenderer->AllocateUAV(*m_gbufferShapesTexture);
+
+	TextureInit binsInit;
+	binsInit.m_width = SDF_SHADE_BINS;
+	binsInit.m_height = 2;
+	binsInit.m_format = DXGI_FORMAT_R32_UINT;
+	binsInit.m_allowUAV = true;
+
+	m_shadeBinsTexture = g_theRenderer->CreateTexture(binsInit);
+	m_shadeBinsUAV = g_theRenderer->AllocateUAV(*m_shadeBinsTexture);
+
+	// Slots are laid out row major at the marched width, which never exceeds the window's
+	TextureInit pixelsInit = gbufferInit;
+	pixelsInit.m_format = DXGI_FORMAT_R32_UINT;
+
+	m_shadePixelsTexture = g_theRenderer->CreateTexture(pixelsInit);
+	m_shadePixelsUAV = g_theRenderer->AllocateUAV(*m_shadePixelsTexture);
+}
+
+void GameRayMarching::DestroyDeferredShadingTextures()
+{
+	g_theRenderer->DestroyTexture(m_gbufferTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_gbufferUAV);
+	g_theRenderer->DestroyTexture(m_gbufferShapesTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_gbufferShapesUAV);
+	g_theRenderer->DestroyTexture(m_shadeBinsTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_shadeBinsUAV);
+	g_theRenderer->DestroyTexture(m_shadePixelsTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_shadePixelsUAV);
+}
+
+void GameRayMarching::UpdateCostCounters(IntVec2 dimensions)
+{
+	SdfRayMarchingConstants& constants = m_currentRayMarchingConstants;
+	constants.costHistogramBinWidth = SdfCostStats::GetHistogramBinWidth(constants.maxSteps);
+	if (!constants.useCostCounters)
+	{
+		m_hasCostStats = false;
+		return;
+	}
+
+	if (m_costCountersTexture == nullptr || m_costCountersTexture->GetDimensions() != dimensions)
+	{
+		ResizeCostTextures(dimensions);
+	}
+}
+
+void GameRayMarching::ResizeCostTextures(IntVec2 dimensions)
+{
+	DestroyCostTextures();
+
+	TextureInit countersInit;
+	countersInit.m_width = dimensions.x;
+	countersInit.m_height = dimensions.y;
+	countersInit.m_format = DXGI_FORMAT_R32G32B32A32_UINT;
+	countersInit.m_allowUAV = true;
+
+	m_costCountersTexture = g_theRenderer->CreateTexture(countersInit);
+	m_costCountersUAV = g_theRenderer->AllocateUAV(*m_costCountersTexture);
+}
+
+void GameRayMarching::DestroyCostTextures()
+{
+	g_theRenderer->DestroyTexture(m_costCountersTexture);
+	g_theRenderer->EnqueueDeferredRelease(m_costCountersUAV);
+}
+
 void GameRayMarching::CreateRayMarchingConstants()
 {
 
@@ -487,16 +1255,270 @@ void GameRayMarching::ShowGameModeImGuiWindow()
 		}
 		if (ImGui::Button("Add a sphere"))
 		{
-			SpawnSphere();
+			SpawnSphere(true);
+		}
+		if (ImGui::Button("Pick Under Crosshair"))
+		{
+			PickUnderCrosshair();
+		}
+		if (m_hasPickedCrosshair)
+		{
+			if (m_crosshairHit.IsHit())
+			{
+				ImGui::Text("Crosshair: sphere %d at %.2f", m_crosshairHit.m_shapeIndex, m_crosshairHit.m_distance);
+			}
+			else
+			{
+				ImGui::Text("Crosshair: nothing");
+			}
+		}
+		bool isCollisionEnabled = m_shapeSimulation.IsCollisionEnabled();
+		if (ImGui::Checkbox("Sphere Collisions", &isCollisionEnabled))
+		{
+			m_shapeSimulation.SetCollisionEnabled(isCollisionEnabled);
+		}
+		if (isCollisionEnabled)
+		{
+			SdfSpatialGrid const& grid = m_shapeSimulation.GetGrid();
+			ImGui::Text("Contacts: %d, grid %d cells of %.2f", m_shapeSimulation.GetNumContacts(), grid.GetNumCells(), grid.GetCellSize());
+		}
+		if (ImGui::DragFloat("Tolerance", &m_currentRayMarchingConstants.toleranceK, 0.01f, 0.1f, 2.f))
+		{
+			m_isTemporalHistoryValid = false; // the blend moves every surface
+		}
+
+		bool isBvhEnabled = (m_currentRayMarchingConstants.useBvh != 0);
+		if (ImGui::Checkbox("Use BVH", &isBvhEnabled))
+		{
+			m_currentRayMarchingConstants.useBvh = isBvhEnabled ? 1 : 0;
+		}
+		ImGui::Text("BVH: %d nodes, depth %d", (int)m_bvh.GetNodes().size(), m_bvh.GetDepth());
+
+		bool isOverRelaxationEnabled = (m_currentRayMarchingConstants.useOverRelaxation != 0);
+		if (ImGui::Checkbox("Over-relaxed Sphere Tracing", &isOverRelaxationEnabled))
+		{
+			m_currentRayMarchingConstants.useOverRelaxation = isOverRelaxationEnabled ? 1 : 0;
+		}
+		if (isOverRelaxationEnabled)
+		{
+			ImGui::SliderFloat("Omega", &m_currentRayMarchingConstants.overRelaxationOmega, 1.f, 2.f);
+		}
+
+		bool isAnalyticNormalsEnabled = (m_currentRayMarchingConstants.useAnalyticNormals != 0);
+		if (ImGui::Checkbox("Analytic Normals", &isAnalyticNormalsEnabled))
+		{
+			m_currentRayMarchingConstants.useAnalyticNormals = isAnalyticNormalsEnabled ? 1 : 0;
+		}
+
+		bool isCsgProgramEnabled = (m_currentRayMarchingConstants.useCsgProgram != 0);
+		if (ImGui::Checkbox("CSG Program", &isCsgProgramEnabled))
+		{
+			m_currentRayMarchingConstants.useCsgProgram = isCsgProgramEnabled ? 1 : 0;
+			m_isTemporalHistoryValid = false; // another field
+		}
+		if (isCsgProgramEnabled)
+		{
+			if (m_isCsgProgramValid)
+			{
+				ImGui::Text("CSG: %d nodes, %d instructions (%d skips), stack %d", m_csgProgram.m_numTreeNodes, m_csgProgram.GetNumInstructions(),
+					m_csgProgram.m_numSkipInstructions, m_csgProgram.m_maxStackDepth);
+			}
+			else
+			{
+				ImGui::Text("CSG: compile failed (too deep for the shader's stack), blending the shapes");
+			}
+			if (!m_bakedGrids.empty())
+			{
+				if (ImGui::Checkbox("Baked Test Model", &m_isBakedModelInCsg))
+				{
+					m_isTemporalHistoryValid = false;
+					m_dirtyTiles.Invalidate();
+				}
+				SdfBakedGrid const& grid = m_bakedGrids[0];
+				ImGui::Text("Baked: %d triangles to %dx%dx%d in %.1f ms", m_bakeStats.m_numTriangles, grid.m_numSamplesX, grid.m_numSamplesY, grid.m_numSamplesZ,
+					m_bakeStats.m_totalMilliseconds);
+			}
+			if (m_bakedModelView.IsOpen())
+			{
+				SdfBrickStreamerStats const& streamStats = m_bakedModelStreamer.GetStats();
+				ImGui::Text("Brick file: %d of %d bricks, %.0f KB (%.0f KB raw)", m_bakedModelView.GetHeader().m_numStoredBricks, m_bakedModelView.GetHeader().GetNumBricks(),
+					m_bakedModelFile.GetNumBytes() / 1024.0, m_bakedModelFileStats.m_numDenseBytes / 1024.0);
+				ImGui::Text("Streamed near camera: %d wanted, %d resident, %d loaded, %d missing", streamStats.m_numWantedBricks, streamStats.m_numResidentBricks,
+					streamStats.m_numLoadedBricks, streamStats.m_numMissingBricks);
+			}
+		}
+
+		bool isDeferredShadingEnabled = (m_currentRayMarchingConstants.useDeferredShading != 0);
+		if (ImGui::Checkbox("Deferred Shading", &isDeferredShadingEnabled))
+		{
+			m_currentRayMarchingConstants.useDeferredShading = isDeferredShadingEnabled ? 1 : 0;
+		}
+		if (isDeferredShadingEnabled)
+		{
+			// 1, 2 or 4: the block stays inside a thread group tile
+			const char* shadingRateItems[] = { "1x1", "2x2", "4x4" };
+			int shadingRateItem = (m_currentRayMarchingConstants.shadingRate >= 4) ? 2 : m_currentRayMarchingConstants.shadingRate - 1;
+			if (ImGui::Combo("Shading Rate", &shadingRateItem, shadingRateItems, IM_ARRAYSIZE(shadingRateItems)))
+			{
+				m_currentRayMarchingConstants.shadingRate = 1 << shadingRateItem;
+			}
+			if (m_currentRayMarchingConstants.shadingRate > 1)
+			{
+				ImGui::SliderFloat("Edge Depth Tolerance", &m_currentRayMarchingConstants.shadingDepthTolerance, 0.001f, 0.1f, "%.4f", ImGuiSliderFlags_Logarithmic);
+				ImGui::SliderFloat("Edge Normal Threshold", &m_currentRayMarchingConstants.shadingNormalThreshold, 0.5f, 1.f);
+			}
+		}
+
+		bool isTopKEnabled = (m_currentRayMarchingConstants.useTopKMaterials != 0);
+		if (ImGui::Checkbox(Stringf("Top-%d Material Blending", SDF_TOPK_MATERIALS).c_str(), &isTopKEnabled))
+		{
+			m_currentRayMarchingConstants.useTopKMaterials = isTopKEnabled ? 1 : 0;
+		}
+		if (isTopKEnabled)
+		{
+			ImGui::SliderFloat("Min Weight", &m_currentRayMarchingConstants.topKMinWeight, 0.f, 0.5f);
+		}
+
+		bool isTileBinningEnabled = (m_currentRayMarchingConstants.useTileBinning != 0);
+		if (ImGui::Checkbox("Tile Binning", &isTileBinningEnabled))
+		{
+			m_currentRayMarchingConstants.useTileBinning = isTileBinningEnabled ? 1 : 0;
+		}
+		if (isTileBinningEnabled)
+		{
+			SdfTileBinningStats binningStats = m_tileBinning.GetStats();
+			ImGui::Text("Shapes per tile: avg %.1f, max %d (%d tiles over groupshared)", binningStats.m_averageShapesPerTile,
+				binningStats.m_maxShapesPerTile, binningStats.m_numTilesOverGroupShared);
+		}
+
+		bool isTileClassificationEnabled = (m_currentRayMarchingConstants.useTileClassification != 0);
+		if (ImGui::Checkbox("Tile Classification", &isTileClassificationEnabled))
+		{
+			m_currentRayMarchingConstants.useTileClassification = isTileClassificationEnabled ? 1 : 0;
+		}
+		if (isTileClassificationEnabled)
+		{
+			ImGui::Text("Background tiles skipped: %d of %d (%.1f%%)", m_tileClassification.GetNumBackgroundTiles(),
+				m_tileClassification.GetNumTiles().x * m_tileClassification.GetNumTiles().y, 100.f * m_tileClassification.GetSkippedFraction());
+		}
+
+		ImGui::Checkbox("Incremental Re-render", &m_useIncrementalRender);
+		if (m_useIncrementalRender)
+		{
+			static char const* const s_dirtyStateNames[] = { "clean", "partial", "full" };
+			int numPixels = m_renderDimensions.x * m_renderDimensions.y;
+			ImGui::Text("Frame: %s, %d shapes changed", s_dirtyStateNames[(int)m_dirtyTiles.GetState()], m_dirtyTiles.GetNumMovedShapes());
+			ImGui::Text("Re-marched: %d px (%.1f%%)", m_dirtyTiles.GetNumMarchedPixels(), (numPixels > 0) ? 100.f * m_dirtyTiles.GetNumMarchedPixels() / numPixels : 0.f);
+		}
+
+		bool isConeDepthEnabled = (m_currentRayMarchingConstants.useConeDepthPrepass != 0);
+		if (ImGui::Checkbox("Cone Depth Pre-pass", &isConeDepthEnabled))
+		{
+			m_currentRayMarchingConstants.useConeDepthPrepass = isConeDepthEnabled ? 1 : 0;
+		}
+
+		bool isTemporalEnabled = (m_currentRayMarchingConstants.useTemporalReprojection != 0);
+		if (ImGui::Checkbox("Temporal Reprojection", &isTemporalEnabled))
+		{
+			m_currentRayMarchingConstants.useTemporalReprojection = isTemporalEnabled ? 1 : 0;
+		}
+		if (isTemporalEnabled)
+		{
+			ImGui::Text("History: %s, max shape move %.4f", m_currentRayMarchingConstants.hasTemporalHistory ? "valid" : "none", m_maxShapeMove);
+		}
+		if (ImGui::Button(m_isRecordingCameraPath ? "Stop Recording Camera Path" : "Record Camera Path"))
+		{
+			if (m_isRecordingCameraPath)
+			{
+				WriteSdfCameraPath("SdfCameraPath.txt", m_cameraPath);
+				DebuggerPrintf("Camera path: %d frames written to SdfCameraPath.txt\n", (int)m_cameraPath.size());
+			}
+			m_cameraPath.clear();
+			m_isRecordingCameraPath = !m_isRecordingCameraPath;
+		}
+
+		bool isCostCountersEnabled = (m_currentRayMarchingConstants.useCostCounters != 0);
+		if (ImGui::Checkbox("Cost Counters", &isCostCountersEnabled))
+		{
+			m_currentRayMarchingConstants.useCostCounters = isCostCountersEnabled ? 1 : 0;
+		}
+		if (isCostCountersEnabled && ImGui::Button("Measure on CPU"))
+		{
+			MeasureCpuCostStats();
+		}
+		if (isCostCountersEnabled && m_hasCostStats)
+		{
+			ImGui::Text("CPU reference at %dx%d", m_costStatsDimensions.x, m_costStatsDimensions.y);
+			ImGui::Text("Per pixel: %.2f steps, %.2f SdfMap calls, %.3f material evaluations", m_costStats.GetStepsPerPixel(),
+				m_costStats.GetSdfMapCallsPerPixel(), m_costStats.GetMaterialEvaluationsPerPixel());
+			ImGui::Text("Steps: p50 %d, p90 %d, p99 %d, max %d (max SdfMap calls %d)", m_costStats.GetStepPercentile(0.5f),
+				m_costStats.GetStepPercentile(0.9f), m_costStats.GetStepPercentile(0.99f), m_costStats.m_maxSteps, m_costStats.m_maxSdfMapCalls);
+
+			float histogram[SDF_COST_HISTOGRAM_BINS];
+			for (int bin = 0; bin < SDF_COST_HISTOGRAM_BINS; ++bin)
+			{
+				histogram[bin] = (float)m_costStats.m_stepHistogram[bin];
+			}
+			std::string histogramLabel = Stringf("%d steps per bar", m_costStats.m_histogramBinWidth);
+			ImGui::PlotHistogram("Steps", histogram, SDF_COST_HISTOGRAM_BINS, 0, histogramLabel.c_str(), 0.f, FLT_MAX, ImVec2(0.f, 60.f));
+		}
+		ImGui::Text("Heatmaps: debug int %d steps, %d SdfMap calls, %d material evaluations", SDF_COST_HEATMAP_STEPS,
+			SDF_COST_HEATMAP_SDF_MAP_CALLS, SDF_COST_HEATMAP_MATERIAL_EVALUATIONS);
+
+		bool isBrickMapEnabled = (m_currentRayMarchingConstants.useBrickMap != 0);
+		if (ImGui::Checkbox("Brick Map Cache", &isBrickMapEnabled))
+		{
+			m_currentRayMarchingConstants.useBrickMap = isBrickMapEnabled ? 1 : 0;
+		}
+		if (isBrickMapEnabled)
+		{
+			SdfBrickMapStats brickStats = m_brickMap.GetStats();
+			ImGui::Text("Bricks: %d / %d sampled, %.0f KB (dense %.0f KB)", brickStats.m_numAllocatedBricks, brickStats.m_numBricks,
+				(double)brickStats.m_numBytes / 1024.0, (double)brickStats.m_numDenseBytes / 1024.0);
+			ImGui::Text("Rebaked: %d dirty, %d sampled, %.2f ms", brickStats.m_numDirtyBricks, brickStats.m_numSampledBricks, brickStats.m_bakeMilliseconds);
+		}
+
+		if (ImGui::Checkbox("Dynamic Resolution", &m_useDynamicResolution))
+		{
+			m_dynamicResolution.Reset();
+		}
+		if (m_useDynamicResolution)
+		{
+			SdfDynamicResolutionConfig resolutionConfig = m_dynamicResolution.GetConfig();
+			if (ImGui::SliderFloat("Frame Budget (ms)", &resolutionConfig.m_budgetMilliseconds, 4.f, 50.f))
+			{
+				m_dynamicResolution.SetConfig(resolutionConfig);
+			}
+			ImGui::Checkbox("Edge-aware Upscale", &m_useEdgeAwareUpscale);
+			ImGui::Text("Scale %.3f, bucket %.3f (%dx%d), %.2f ms smoothed, %d changes", m_dynamicResolution.GetScale(), m_dynamicResolution.GetBucketScale(),
+				m_renderDimensions.x, m_renderDimensions.y, m_dynamicResolution.GetSmoothedMilliseconds(), m_dynamicResolution.GetNumBucketChanges());
+		}
+
+		bool isHalfGeometry = (m_currentRayMarchingConstants.halfPrecisionGeometry != 0);
+		if (ImGui::Checkbox("Half Precision Geometry", &isHalfGeometry))
+		{
+			m_currentRayMarchingConstants.halfPrecisionGeometry = isHalfGeometry ? 1 : 0;
+			m_isTemporalHistoryValid = false;
 		}
-		ImGui::DragFloat("Tolerance", &m_currentRayMarchingConstants.toleranceK, 0.01f, 0.1f, 2.f);
 
 		const char* items[] = { "Ray Marching Mode", "Mesh Mode" };
 
 		ImGui::Combo("combo", &m_comboInt, items, IM_ARRAYSIZE(items));
+		if (m_comboInt == 1)
+		{
+			SdfMesherStats meshStats = m_chunkMesher.GetStats();
+			ImGui::Text("Mesh: %d triangles in %d chunks", meshStats.m_numTriangles, meshStats.m_numChunks);
+			ImGui::Text("Re-meshed: %d sampled, %d meshed, %.2f + %.2f ms", meshStats.m_numSampledChunks, meshStats.m_numMeshedChunks,
+				meshStats.m_sampleMilliseconds, meshStats.m_meshMilliseconds);
+		}
 
 		ImGui::SliderFloat("UV Scale", &m_currentRayMarchingConstants.triplanarUVScale, 0.1f, 10.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
 		ImGui::SliderFloat("Blend Sharpness", &m_currentRayMarchingConstants.triplanarBlendSharpness, 0.1f, 10.0f, "%.4f", ImGuiSliderFlags_Logarithmic);
+
+		if (ImGui::Button("Capture CPU Reference"))
+		{
+			CaptureCpuReference();
+		}
 	}
 
 	ImGui::End();
@@ -504,32 +1526,154 @@ void GameRayMarching::ShowGameModeImGuiWindow()
 
 }
 
-void GameRayMarching::SpawnSphere()
+void GameRayMarching::SpawnSphere(bool isPlacedInFreeSpace /*= false*/)
 {
 	RandomNumberGenerator rng;
 
-	GRMO_Sphere* newSphere = new GRMO_Sphere();
-
 	Vec3 velocity = Vec3(rng.RollRandomFloatInRange(MIN_OBJECT_SPEED, MAX_OBJECT_SPEED),
 		rng.RollRandomFloatInRange(MIN_OBJECT_SPEED, MAX_OBJECT_SPEED),
 		rng.RollRandomFloatInRange(MIN_OBJECT_SPEED, MAX_OBJECT_SPEED));
 	Vec3 signVelocity = Vec3(rng.RollRandomWithProbability(0.5f) ? 1.f : -1.f,
 		rng.RollRandomWithProbability(0.5f) ? 1.f : -1.f,
 		rng.RollRandomWithProbability(0.5f) ? 1.f : -1.f);
-	newSphere->m_velocity = velocity * signVelocity;
 
-	newSphere->m_radius = rng.RollRandomFloatInRange(MIN_SPHERE_RADIUS, MAX_SPHERE_RADIUS);
+	float radius = rng.RollRandomFloatInRange(MIN_SPHERE_RADIUS, MAX_SPHERE_RADIUS);
 
-	const int matID = rng.RollRandomIntInRange(0, NUM_TRIPLANAR_TEX - 1);
+	uint16_t materialID = (uint16_t)rng.RollRandomIntInRange(0, NUM_TRIPLANAR_TEX - 1);
 
-	newSphere->m_triAlbedoTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triAlbedoTexs[matID], DefaultTexture::CheckerboardMagentaBlack2D);
-	newSphere->m_triMRTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triMRTexs[matID], DefaultTexture::DefaultOcclusionRoughnessMetalnessMap);
-	newSphere->m_triNormalTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triNormalTexs[matID], DefaultTexture::DefaultNormalMap);
-	newSphere->m_triOcclusionTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triOcclusionTexs[matID], DefaultTexture::DefaultOcclusionRoughnessMetalnessMap);
-	newSphere->m_triEmissiveTexID = g_theRenderer->GetSrvIndexFromLoadedTexture(m_triEmissiveTexs[matID], DefaultTexture::BlackOpaque2D);
+	Rgba8 color = Rgba8::MakeFromZeroToOne(rng.RollRandomFloatZeroToOne());
+
+	// The center of the box when every spot is taken
+	Vec3 position;
+	if (isPlacedInFreeSpace)
+	{
+		UpdateSceneQuery();
+		std::vector<SdfOverlapQuery> candidates(SPAWN_NUM_CANDIDATES);
+		for (SdfOverlapQuery& candidate : candidates)
+		{
+			float range = ACTIVITY_BOX_RADIUS - radius;
+			candidate.m_center = Vec3(rng.RollRandomFloatInRange(-range, range), rng.RollRandomFloatInRange(-range, range), rng.RollRandomFloatInRange(-range, range));
+			candidate.m_radius = radius;
+		}
+		std::vector<SdfOverlapResult> results;
+		m_sceneQuery.Overlap(candidates, results);
+		for (int candidateIndex = 0; candidateIndex < SPAWN_NUM_CANDIDATES; ++candidateIndex)
+		{
+			if (!results[candidateIndex].m_isOverlapping)
+			{
+				position = candidates[candidateIndex].m_center;
+				break;
+			}
+		}
+	}
 
-	newSphere->m_color = Rgba8::MakeFromZeroToOne(rng.RollRandomFloatZeroToOne());
+	m_shapeSimulation.AddSphere(position, velocity * signVelocity, radius, color, materialID);
+	m_areStreamMaterialsStale = true;
+	m_isTemporalHistoryValid = false; // it appears out of nowhere
+}
 
-	m_shapes.push_back(newSphere);
+void GameRayMarching::PickUnderCrosshair()
+{
+	UpdateSceneQuery();
+	SdfCpuView view = GetSdfView();
+	SdfRayQuery ray;
+	ray.m_origin = view.m_position;
+	ray.m_direction = view.m_forward;
+
+	std::vector<SdfRayQueryHit> hits;
+	m_sceneQuery.Raycast(std::vector<SdfRayQuery>(1, ray), hits);
+	m_crosshairHit = hits[0];
+	m_hasPickedCrosshair = true;
 }
 
+void GameRayMarching::UpdateSceneQuery()
+{
+	std::vector<SdfShape> shapes;
+	m_shapeSimulation.GetShapes(shapes);
+	m_sceneQuery.SetScene(shapes, m_currentRayMarchingConstants);
+}
+
+void GameRayMarching::CaptureCpuReference() const
+{
+	SdfCpuRayMarcher marcher;
+	std::vector<SdfShape> shapeData;
+	SetUpCpuReference(marcher, shapeData);
+
+	SdfCpuView view = GetSdfView();
+
+	JobPool jobPool;
+	SdfCpuImage image;
+	IntVec2 dimensions = Window::s_mainWindow->GetClientDimensions();
+	SdfCpuFrameStats stats = marcher.RenderFrame(view, dimensions, image, &jobPool);
+
+	image.WriteColorPPM("SdfCpuReference.ppm");
+	image.WriteDepthPFM("SdfCpuReference.pfm");
+	DebuggerPrintf("CPU reference: %d shapes, %.2f ms, %.3f Mrays/s\n", (int)shapeData.size(), stats.m_milliseconds, stats.GetRaysPerSecond() * 1e-6);
+
+	SdfCostStats costStats = SdfCostStats::FromImage(image, m_currentRayMarchingConstants.maxSteps);
+	DebuggerPrintf("CPU reference cost per pixel: %.2f steps, %.2f SdfMap calls, %.3f material evaluations, steps p99 %d\n",
+		costStats.GetStepsPerPixel(), costStats.GetSdfMapCallsPerPixel(), costStats.GetMaterialEvaluationsPerPixel(), costStats.GetStepPercentile(0.99f));
+}
+
+void GameRayMarching::MeasureCpuCostStats()
+{
+	SdfCpuRayMarcher marcher;
+	std::vector<SdfShape> shapeData;
+	SetUpCpuReference(marcher, shapeData);
+
+	// Same view and scene, fewer rays: the per-pixel averages and percentiles hardly move
+	JobPool jobPool;
+	SdfCpuImage image;
+	m_costStatsDimensions = IntVec2(std::max(m_renderDimensions.x / 4, 1), std::max(m_renderDimensions.y / 4, 1));
+	marcher.RenderFrame(GetSdfView(), m_costStatsDimensions, image, &jobPool);
+	m_costStats = SdfCostStats::FromImage(image, m_currentRayMarchingConstants.maxSteps);
+	m_hasCostStats = true;
+}
+
+void GameRayMarching::SetUpCpuReference(SdfCpuRayMarcher& marcher, std::vector<SdfShape>& out_shapes) const
+{
+	m_shapeSimulation.GetShapes(out_shapes);
+
+	// What the shader was given this frame, a CSG program that failed to compile included
+	SdfRayMarchingConstants constants = m_currentRayMarchingConstants;
+	constants.useCsgProgram = m_isCsgProgramValid ? constants.useCsgProgram : 0;
+
+	marcher.SetScene(out_shapes, constants, &m_bvh);
+	marcher.SetMaterials(m_materials);
+	marcher.SetLightConstants(GetLightConstants());
+	marcher.SetDebugInt(GetDebugInt());
+	marcher.SetCsgProgram(&m_csgProgram);
+}
+
+SdfCpuView GameRayMarching::GetSdfView() const
+{
+	SdfCpuView view;
+	view.m_position = m_spectator->m_position;
+	m_spectator->m_orientation.GetAsVectors_IFwd_JLeft_KUp(view.m_forward, view.m_left, view.m_up);
+	view.m_aspect = Window::s_mainWindow->GetAspectRatio();
+	return view;
+}
+
+//-----------------------------------------------------------------------------------------------
+void SdfRendererUploadDevice::CreateSlotBuffer(int slot, size_t stride, int numElements)
+{
+	BufferInit slotInit;
+	slotInit.m_size = numElements * stride;
+	m_buffers[slot] = g_theRenderer->CreateBuffer(slotInit);
+	m_srvs[slot] = g_theRenderer->AllocateStructuredBufferSRV(*m_buffers[slot], (unsigned int)stride, numElements);
+}
+
+void SdfRendererUploadDevice::DestroySlotBuffer(int slot)
+{
+	g_theRenderer->DestroyBuffer(m_buffers[slot]);
+	g_theRenderer->EnqueueDeferredRelease(m_srvs[slot]);
+}
+
+size_t SdfRendererUploadDevice::WriteSlotBuffer(int slot, void const* data, size_t numBytes, std::vector<SdfUploadRange> const& ranges)
+{
+	// UpdateBuffer writes from the start of the buffer: the ranges go up as the one prefix that ends with the last
+	UNUSED(numBytes);
+	size_t prefixBytes = ranges.back().m_byteOffset + ranges.back().m_numBytes;
+	g_theRenderer->UpdateBuffer(*m_buffers[slot], prefixBytes, data);
+	return prefixBytes;
+}
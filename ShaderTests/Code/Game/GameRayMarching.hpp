@@ -1,5 +1,22 @@
 #pragma once
 #include "Game/Game.hpp"
+#include "Game/SdfBrickFile.hpp"
+#include "Game/SdfBrickMap.hpp"
+#include "Game/SdfBvh.hpp"
+#include "Game/SdfChunkMesher.hpp"
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfCostCounters.hpp"
+#include "Game/SdfCsg.hpp"
+#include "Game/SdfDeferredShading.hpp"
+#include "Game/SdfDirtyTiles.hpp"
+#include "Game/SdfDynamicResolution.hpp"
+#include "Game/SdfMeshBaker.hpp"
+#include "Game/SdfSceneQuery.hpp"
+#include "Game/SdfShapeSimulation.hpp"
+#include "Game/SdfTemporalReprojection.hpp"
+#include "Game/SdfTileBinning.hpp"
+#include "Game/SdfTileClassification.hpp"
+#include "Game/SdfUploadRing.hpp"
 #include "Engine/Math/Vec3.hpp"
 #include "Engine/Math/Vec4.hpp"
 #include "Engine/Renderer/RendererCommon.hpp"
@@ -14,93 +31,28 @@ https://iquilezles.org/articles/normalsSDF/
 
 
 
-constexpr int NUM_TRIPLANAR_TEX = 3;
-
-
-// 
-// Notes: must be same as the struct in hlsl
-struct SdfShape
-{
-	// Type: Sphere Only
-	// Color: 
-	// Bool Operation: Union Only
-	// Orientation(Quaternion): Spheres do not need this
-
-	enum
-	{
-		SDF_SPHERE = 0,
-	};
-
-
-	int m_type = 0;
-	int m_padding0 = 0;
-	int m_padding1 = 0;
-	uint32_t m_triAlbedoTexID = INVALID_INDEX_U32;
-
-	uint32_t m_triMRTexID = INVALID_INDEX_U32;
-	uint32_t m_triNormalTexID = INVALID_INDEX_U32;
-	uint32_t m_triOcclusionTexID = INVALID_INDEX_U32;
-	uint32_t m_triEmissiveTexID = INVALID_INDEX_U32;
-
-	float m_color[4];
-	Vec4 m_data0; // center.xyz + radius
+class IndexBuffer;
+class VertexBuffer;
 
-	static SdfShape MakeSphere(Vec3 center, float radius, Rgba8 color = Rgba8::OPAQUE_WHITE);
-
-};
-
-
-struct SdfRayMarchingResources
-{
-	uint32_t engineConstantsIndex = INVALID_INDEX_U32;
-	uint32_t cameraConstantsIndex = INVALID_INDEX_U32;
-	uint32_t modelConstantsIndex = INVALID_INDEX_U32;
-	uint32_t lightConstantsIndex = INVALID_INDEX_U32;
-	uint32_t perFrameConstantsIndex = INVALID_INDEX_U32;
-
-	uint32_t inputSdfShapesIndex = INVALID_INDEX_U32; // StructuredBuffer<SdfShape>
-	uint32_t outputTextureIndex = INVALID_INDEX_U32; // RWTexture2D<float4>
-	uint32_t outputDepthIndex = INVALID_INDEX_U32; // RWTexture2D<float>
-	uint32_t rayMarchingConstantsIndex = INVALID_INDEX_U32;
-};
-
-struct SdfRayMarchingConstants
-{
-	int maxSteps = 100;
-	float minHitDistance = 0.001f;
-	float maxTraceDistance = 1000.f;
-	float toleranceK = 0.5f;
-
-	int numOfShapes = 0;
-	int screenWidth = 0;
-	int screenHeight = 0;
-	float padding;
-
-	float triplanarUVScale = 1.f;
-	float triplanarBlendSharpness = 1.f;
-	float padding1;
-	float padding2;
-};
+constexpr int NUM_TRIPLANAR_TEX = 3;
+constexpr int SDF_BVH_REBUILD_INTERVAL = 16; // frames between full rebuilds, refit in between
 
 
-class GRMO_Sphere
+//-----------------------------------------------------------------------------------------------
+// SdfUploadRing slots as structured buffers, with a view each
+class SdfRendererUploadDevice : public SdfUploadDevice
 {
 public:
-	SdfShape GetShape() const;
-
-public:
-	Vec3 m_position;
-	Vec3 m_velocity; // wandering inside of box, flip velocity when going outside
-	Rgba8 m_color = Rgba8::OPAQUE_WHITE;
+	void CreateSlotBuffer(int slot, size_t stride, int numElements) override;
+	void DestroySlotBuffer(int slot) override;
+	size_t WriteSlotBuffer(int slot, void const* data, size_t numBytes, std::vector<SdfUploadRange> const& ranges) override;
 
-	uint32_t m_triAlbedoTexID = INVALID_INDEX_U32;
-	uint32_t m_triMRTexID = INVALID_INDEX_U32;
-	uint32_t m_triNormalTexID = INVALID_INDEX_U32;
-	uint32_t m_triOcclusionTexID = INVALID_INDEX_U32;
-	uint32_t m_triEmissiveTexID = INVALID_INDEX_U32;
-
-	float m_radius = 0.f;
+	Buffer* GetBuffer(int slot) const { return m_buffers[slot]; }
+	DescriptorHandle const& GetSRV(int slot) const { return m_srvs[slot]; }
 
+private:
+	Buffer* m_buffers[SDF_UPLOAD_RING_SLOTS] = {};
+	DescriptorHandle m_srvs[SDF_UPLOAD_RING_SLOTS];
 };
 
 
@@ -119,14 +71,35 @@ private:
 
 private:
 	void UpdateShapes(float deltaSeconds);
-	void RenderMeshes() const; // only for test
+	JobPool* GetJobPool();
+	void UpdateMeshes();
+	void DestroyMeshBuffers(); // Shutdown only, a frame in flight may still draw them
+	void RenderMeshes() const;
 	void RenderFullScreenQuad() const; // only for test
 
 	void UpdateRayMarching(); // try not to change the shape list after it
 	void RenderRayMarching() const;
+	void DispatchRayMarching() const; // the compute passes, skipped when nothing changed
+
+	void DestroyShapeBuffers();
+
+	void CreateMaterialBuffer();
+	void DestroyMaterialBuffer();
 
-	void ResizeShapeBuffer(int numOfShapes);
-	void DestroyShapeBuffer();
+	void ResizeTileBuffers(int numOfTiles, int numOfTileShapeIndices);
+	void DestroyTileBuffers();
+
+	void UpdateCsgProgram();
+	void ResizeCsgProgramBuffer(int numOfInstructions);
+	void DestroyCsgProgramBuffer();
+	void BakeTestModel();
+	void UpdateBrickStreaming();
+	void ResizeCsgGridSampleBuffer(int numOfSamples);
+	void DestroyCsgGridSampleBuffer();
+
+	void UpdateBrickMap(bool isStreamReordered);
+	void ResizeBrickBuffers(int numOfBricks, int numOfBrickSamples);
+	void DestroyBrickBuffers();
 
 	void ResizeDstTexture(IntVec2 dimensions);
 	void DestroyDstTexture();
@@ -134,6 +107,19 @@ private:
 	void ResizeDepthTexture(IntVec2 dimensions);
 	void DestroyDepthTexture();
 
+	void ResizeConeDepthTexture(IntVec2 dimensions);
+	void DestroyConeDepthTexture();
+
+	void ResizeTemporalStartTexture(IntVec2 dimensions);
+	void DestroyTemporalStartTexture();
+
+	void ResizeDeferredShadingTextures(IntVec2 dimensions);
+	void DestroyDeferredShadingTextures();
+
+	void UpdateCostCounters(IntVec2 dimensions);
+	void ResizeCostTextures(IntVec2 dimensions);
+	void DestroyCostTextures();
+
 	void CreateRayMarchingConstants();
 	void DestroyRayMarchingConstants();
 
@@ -143,13 +129,104 @@ private:
 	int m_comboInt = 0;
 
 private:
-	void SpawnSphere();
+	void SpawnSphere(bool isPlacedInFreeSpace = false); // free space: the first of a few random spots that overlaps no shape
+	void PickUnderCrosshair();
+	void UpdateSceneQuery(); // the current shapes, for the gameplay queries
+	void CaptureCpuReference() const; // CPU reference of the current frame, written next to the exe
+	void MeasureCpuCostStats(); // cost counters of the current frame from the CPU reference, at a quarter of the resolution
+	void SetUpCpuReference(SdfCpuRayMarcher& marcher, std::vector<SdfShape>& out_shapes) const;
+	SdfCpuView GetSdfView() const; // the spectator camera, as the compute shader sees it
 
 private:
-	std::vector<GRMO_Sphere*> m_shapes;
-
-	Buffer* m_shapeBuffer = nullptr; // Structured Buffer
-	DescriptorHandle m_shapeBufferSRV;
+	// Spheres wandering inside of the activity box, material ids index into m_materials
+	SdfShapeSimulation m_shapeSimulation;
+	JobPool* m_jobPool = nullptr; // shape simulation and brick map bakes, created on first use
+
+	// Shape streams, see SdfShapeStreams. Without a BVH UpdateShapes writes them in place, in simulation order.
+	std::vector<SdfShape> m_frameShapes; // only filled for the BVH and the CSG tree
+	SdfShapeStreams m_shapeStreams;
+	bool m_areStreamMaterialsStale = true; // spawned, reset, or reordered by the BVH since the simulation last wrote them
+
+	// One buffer per frame in flight, grown geometrically, only the blocks that changed are uploaded
+	SdfRendererUploadDevice m_shapeGeometryDevice; // hot: SdfMap
+	SdfUploadRing m_shapeGeometryRing;
+	SdfRendererUploadDevice m_shapeMaterialDevice; // cold: shading only
+	SdfUploadRing m_shapeMaterialRing;
+
+	// Shape order of the streams when useBvh is set
+	SdfBvh m_bvh;
+	int m_framesSinceBvhBuild = 0;
+	SdfRendererUploadDevice m_bvhDevice; // next to the shape buffers, empty without the BVH
+	SdfUploadRing m_bvhRing;
+
+	// Per-tile shape lists when useTileBinning is set, rebuilt every frame on the CPU
+	SdfTileBinning m_tileBinning;
+	Buffer* m_tileRangeBuffer = nullptr; // Structured Buffer, SdfTileRange per tile
+	DescriptorHandle m_tileRangeBufferSRV;
+	int m_tileRangeCapacity = 0;
+	Buffer* m_tileShapeIndexBuffer = nullptr; // Structured Buffer, uint
+	DescriptorHandle m_tileShapeIndexBufferSRV;
+	int m_tileShapeIndexCapacity = 0;
+
+	// Occupied tiles then background ones when useTileClassification is set, the march only covers the former
+	SdfTileClassification m_tileClassification;
+	SdfRendererUploadDevice m_tileListDevice;
+	SdfUploadRing m_tileListRing;
+
+	// Incremental re-render: the output texture is kept, a frame re-marches the dirty tiles through the tile list or nothing
+	SdfDirtyTiles m_dirtyTiles;
+	bool m_useIncrementalRender = true;
+
+	// Baked distance cache when useBrickMap is set, dirty bricks are rebaked on the CPU every frame
+	SdfBrickMap m_brickMap;
+	std::vector<Vec4> m_brickMapGeometry; // decoded geometry stream, what the shader sees
+	bool m_wasBrickMapBvhOrder = false;
+	Buffer* m_brickBuffer = nullptr; // Structured Buffer, SdfBrick
+	DescriptorHandle m_brickBufferSRV;
+	int m_brickCapacity = 0;
+	Buffer* m_brickSampleBuffer = nullptr; // Structured Buffer, float
+	DescriptorHandle m_brickSampleBufferSRV;
+	int m_brickSampleCapacity = 0;
+
+	// Mesh Mode: the isosurface in chunks, each with its own vertex and index buffer, rewritten only when re-meshed
+	SdfChunkMesher m_chunkMesher;
+	std::vector<Vec4> m_meshGeometry; // simulation order
+	std::vector<VertexBuffer*> m_meshChunkVertexBuffers; // at least one per chunk, freed only in Shutdown
+	std::vector<IndexBuffer*> m_meshChunkIndexBuffers;
+	std::vector<int> m_meshChunkIndexCounts; // one per chunk, what RenderMeshes draws
+
+	// CSG program when useCsgProgram is set: the spheres' smooth union minus a rotating box, recompiled every frame
+	SdfCsgTree m_csgTree;
+	SdfCsgProgram m_csgProgram;
+	float m_csgCutterDegrees = 0.f;
+	bool m_isCsgProgramValid = false; // compiled this frame, the shader blends the shapes when it is not
+	Buffer* m_csgProgramBuffer = nullptr; // Structured Buffer, SdfCsgInstruction
+	DescriptorHandle m_csgProgramSRV;
+	int m_csgProgramCapacity = 0;
+
+	// The PBR / triplanar test model baked once to a grid, unioned into the CSG program as an SDF_BAKED_GRID shape
+	std::vector<SdfBakedGrid> m_bakedGrids;
+	SdfBakeStats m_bakeStats;
+	SdfShape m_bakedModelShape;
+	bool m_isBakedModelInCsg = true;
+	Buffer* m_csgGridSampleBuffer = nullptr; // Structured Buffer, float, SdfCsgProgram::m_gridSamples
+	DescriptorHandle m_csgGridSampleSRV;
+	int m_csgGridSampleCount = 0; // uploaded, the samples never change after the bake
+
+	// The baked model written as a sparse brick file, mapped back and streamed around the camera
+	SdfMappedFile m_bakedModelFile;
+	SdfBrickFileView m_bakedModelView;
+	SdfBrickStreamer m_bakedModelStreamer;
+	SdfBrickFileStats m_bakedModelFileStats;
+
+	// Gameplay queries against the field the shader draws, set up on demand
+	SdfSceneQuery m_sceneQuery;
+	SdfRayQueryHit m_crosshairHit;
+	bool m_hasPickedCrosshair = false;
+
+	std::vector<SdfMaterial> m_materials; // one per triplanar texture set, uploaded once
+	Buffer* m_materialBuffer = nullptr;
+	DescriptorHandle m_materialBufferSRV;
 
 	// Methods to use:
 	// CreateBuffer
@@ -168,6 +245,44 @@ private:
 	DescriptorHandle m_rayMarchingDepthUAV;
 	DescriptorHandle m_rayMarchingDepthSRV;
 
+	Texture* m_coneDepthTexture = nullptr; // quarter-res start distances, written and read by the compute shader
+	DescriptorHandle m_coneDepthUAV;
+
+	// Temporal reprojection: the depth texture is kept across frames and splatted into this one before the march
+	Texture* m_temporalStartTexture = nullptr; // nearest reprojected distance per pixel, as uint bits
+	DescriptorHandle m_temporalStartUAV;
+	SdfCpuView m_temporalHistoryView; // the camera the depth texture was rendered from
+	IntVec2 m_temporalHistoryDimensions;
+	bool m_isTemporalHistoryValid = false; // cleared whenever the scene changes by more than the shapes moving
+	float m_maxShapeMove = 0.f; // this frame, max speed * delta seconds
+	bool m_isRecordingCameraPath = false;
+	std::vector<SdfCameraPathFrame> m_cameraPath; // written to SdfCameraPath.txt for -sdfbench -camerapath
+
+	// Deferred shading: the march writes the G-buffer, the SHADE passes sort its hits by material set and shade them
+	Texture* m_gbufferTexture = nullptr; // float4 normal + hit distance
+	DescriptorHandle m_gbufferUAV;
+	Texture* m_gbufferShapesTexture = nullptr; // uint4 shapes to blend
+	DescriptorHandle m_gbufferShapesUAV;
+	Texture* m_shadeBinsTexture = nullptr; // SDF_SHADE_BINS x 2 uint, counts and offsets
+	DescriptorHandle m_shadeBinsUAV;
+	Texture* m_shadePixelsTexture = nullptr; // packed pixel coordinates in bin order
+	DescriptorHandle m_shadePixelsUAV;
+
+	// Cost counters: the march writes per-pixel counts for the heatmaps. The Engine has no GPU readback, so the stats
+	// shown come from the CPU reference of the same frame.
+	Texture* m_costCountersTexture = nullptr; // uint4 per pixel, see SdfCostCounters.hpp
+	DescriptorHandle m_costCountersUAV;
+	SdfCostStats m_costStats; // last MeasureCpuCostStats
+	IntVec2 m_costStatsDimensions;
+	bool m_hasCostStats = false;
+
+	// Dynamic resolution: the compute textures keep the window size and the march fills the top left m_renderDimensions,
+	// so the controller moving between buckets never reallocates them. FullScreenQuadWithDepth upscales.
+	SdfDynamicResolution m_dynamicResolution;
+	bool m_useDynamicResolution = false;
+	bool m_useEdgeAwareUpscale = true;
+	IntVec2 m_renderDimensions;
+
 	// Update it every frame
 	SdfRayMarchingConstants m_currentRayMarchingConstants;
 	Buffer* m_rayMarchingConstantBuffer = nullptr;
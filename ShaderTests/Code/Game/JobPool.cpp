@@ -0,0 +1,108 @@
+#include "Game/JobPool.hpp"
+
+
+JobPool::JobPool(int numWorkerThreads /*= -1*/)
+{
+	if (numWorkerThreads < 0)
+	{
+		numWorkerThreads = (int)std::thread::hardware_concurrency() - 1;
+	}
+	if (numWorkerThreads < 0)
+	{
+		numWorkerThreads = 0;
+	}
+
+	m_workers.reserve(numWorkerThreads);
+	for (int i = 0; i < numWorkerThreads; ++i)
+	{
+		m_workers.emplace_back(&JobPool::WorkerMain, this);
+	}
+}
+
+JobPool::~JobPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_isQuitting = true;
+	}
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+	m_workers.clear();
+}
+
+void JobPool::ParallelFor(int numItems, std::function<void(int itemIndex)> const& job)
+{
+	if (numItems <= 0)
+	{
+		return;
+	}
+
+	if (m_workers.empty() || numItems == 1)
+	{
+		for (int i = 0; i < numItems; ++i)
+		{
+			job(i);
+		}
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_currentJob = &job;
+		m_numItems = numItems;
+		m_nextItem = 0;
+		m_numBusyWorkers = (int)m_workers.size();
+		++m_generation;
+	}
+	m_wakeCondition.notify_all();
+
+	RunItems(job, numItems);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_numBusyWorkers == 0; });
+	m_currentJob = nullptr;
+}
+
+void JobPool::WorkerMain()
+{
+	uint64_t seenGeneration = 0;
+	for (;;)
+	{
+		std::function<void(int)> const* job = nullptr;
+		int numItems = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wakeCondition.wait(lock, [this, seenGeneration]() { return m_isQuitting || m_generation != seenGeneration; });
+			if (m_isQuitting)
+			{
+				return;
+			}
+			seenGeneration = m_generation;
+			job = m_currentJob;
+			numItems = m_numItems;
+		}
+
+		RunItems(*job, numItems);
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			--m_numBusyWorkers;
+			if (m_numBusyWorkers == 0)
+			{
+				m_doneCondition.notify_one();
+			}
+		}
+	}
+}
+
+void JobPool::RunItems(std::function<void(int)> const& job, int numItems)
+{
+	for (int item = m_nextItem.fetch_add(1); item < numItems; item = m_nextItem.fetch_add(1))
+	{
+		job(item);
+	}
+}
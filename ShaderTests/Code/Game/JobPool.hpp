@@ -0,0 +1,41 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//-----------------------------------------------------------------------------------------------
+// Minimal fork-join pool for the CPU SDF code paths.
+// ParallelFor hands out item indices through an atomic counter, the calling thread helps,
+// and the call returns once every item has finished. One ParallelFor at a time per pool.
+//-----------------------------------------------------------------------------------------------
+class JobPool
+{
+public:
+	explicit JobPool(int numWorkerThreads = -1); // -1: hardware concurrency minus the calling thread
+	~JobPool();
+
+	int GetNumThreads() const { return (int)m_workers.size() + 1; }
+
+	void ParallelFor(int numItems, std::function<void(int itemIndex)> const& job);
+
+private:
+	void WorkerMain();
+	void RunItems(std::function<void(int)> const& job, int numItems);
+
+private:
+	std::vector<std::thread> m_workers;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeCondition;
+	std::condition_variable m_doneCondition;
+
+	std::function<void(int)> const* m_currentJob = nullptr;
+	int m_numItems = 0;
+	std::atomic<int> m_nextItem = 0;
+	int m_numBusyWorkers = 0;
+	uint64_t m_generation = 0;
+	bool m_isQuitting = false;
+};
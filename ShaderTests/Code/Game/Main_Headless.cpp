@@ -0,0 +1,28 @@
+//-----------------------------------------------------------------------------------------------
+// Console entry point for build agents without a GPU or a window (Linux included).
+// Only needs the CPU SDF files and Engine math; built by ShaderTests/CMakeLists.txt, excluded from the Windows game build.
+//
+//	cd Run && ShaderTests_Headless -golden=Data/Golden/Sdf
+//
+#include "Game/SdfBenchmark.hpp"
+
+#include <cstdio>
+#include <string>
+
+
+//-----------------------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+	std::string commandLine = "-sdfbench";
+	for (int i = 1; i < argc; ++i)
+	{
+		commandLine += " ";
+		commandLine += argv[i];
+	}
+
+	std::string report;
+	bool succeeded = RunSdfBenchmarks(ParseSdfBenchmarkCommandLine(commandLine), report);
+	fputs(report.c_str(), stdout);
+
+	return succeeded ? 0 : 1;
+}
@@ -1,5 +1,6 @@
 #include "Game/App.hpp"
 #include "Game/GameCommon.hpp"
+#include "Game/SdfBenchmark.hpp"
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
 
@@ -7,7 +8,15 @@
 int WINAPI WinMain(HINSTANCE applicationInstanceHandle, HINSTANCE, LPSTR commandLineString, int)
 {
 	UNUSED(applicationInstanceHandle);
-	UNUSED(commandLineString);
+
+	// CPU only, never creates the window or the renderer
+	if (IsSdfBenchmarkCommandLine(commandLineString))
+	{
+		std::string report;
+		bool succeeded = RunSdfBenchmarks(ParseSdfBenchmarkCommandLine(commandLineString), report);
+		DebuggerPrintf("%s", report.c_str());
+		return succeeded ? 0 : 1;
+	}
 
 	g_theApp = new App();
 	g_theApp->Startup();
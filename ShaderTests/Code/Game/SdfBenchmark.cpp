@@ -0,0 +1,3623 @@
+#include "Game/SdfBenchmark.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfBrickFile.hpp"
+#include "Game/SdfBrickMap.hpp"
+#include "Game/SdfBvh.hpp"
+#include "Game/SdfChunkMesher.hpp"
+#include "Game/SdfCostCounters.hpp"
+#include "Game/SdfCpuPacketMarcher.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Game/SdfCsg.hpp"
+#include "Game/SdfDeferredShading.hpp"
+#include "Game/SdfDirtyTiles.hpp"
+#include "Game/SdfDynamicResolution.hpp"
+#include "Game/SdfMeshBaker.hpp"
+#include "Game/SdfSceneQuery.hpp"
+#include "Game/SdfShapeSimulation.hpp"
+#include "Game/SdfSimd.hpp"
+#include "Game/SdfSpatialGrid.hpp"
+#include "Game/SdfTemporalReprojection.hpp"
+#include "Game/SdfTileBinning.hpp"
+#include "Game/SdfTileClassification.hpp"
+#include "Game/SdfUploadRing.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <array>
+#include <cfloat>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <sstream>
+
+
+//-----------------------------------------------------------------------------------------------
+// xorshift32, so benchmark scenes are identical on every platform and compiler
+static uint32_t NextRandomUint(uint32_t& state)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+static float NextRandomFloatInRange(uint32_t& state, float minValue, float maxValue)
+{
+	float zeroToOne = (float)(NextRandomUint(state) >> 8) * (1.f / 16777216.f);
+	return minValue + (maxValue - minValue) * zeroToOne;
+}
+
+static bool GetArgValue(std::string const& commandLine, char const* argName, std::string& out_value)
+{
+	std::istringstream stream(commandLine);
+	std::string token;
+	std::string prefix = std::string(argName) + "=";
+	while (stream >> token)
+	{
+		if (token.compare(0, prefix.size(), prefix) == 0)
+		{
+			out_value = token.substr(prefix.size());
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool HasArg(std::string const& commandLine, char const* argName)
+{
+	std::istringstream stream(commandLine);
+	std::string token;
+	while (stream >> token)
+	{
+		if (token == argName)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+static std::vector<int> ParseIntList(std::string const& commaSeparated)
+{
+	std::vector<int> values;
+	std::istringstream stream(commaSeparated);
+	std::string value;
+	while (std::getline(stream, value, ','))
+	{
+		values.push_back(atoi(value.c_str()));
+	}
+	return values;
+}
+
+template<typename T_Marcher>
+static SdfCpuFrameStats RenderBestOf(T_Marcher const& marcher, SdfCpuView const& view, SdfBenchmarkConfig const& config, JobPool& jobPool, SdfCpuImage& out_image)
+{
+	SdfCpuFrameStats bestStats;
+	for (int frame = 0; frame < config.m_numFrames; ++frame)
+	{
+		SdfCpuFrameStats stats = marcher.RenderFrame(view, config.m_resolution, out_image, &jobPool);
+		if (frame == 0 || stats.m_milliseconds < bestStats.m_milliseconds)
+		{
+			bestStats = stats;
+		}
+	}
+	return bestStats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsSdfBenchmarkCommandLine(std::string const& commandLine)
+{
+	return HasArg(commandLine, "-sdfbench");
+}
+
+SdfBenchmarkConfig ParseSdfBenchmarkCommandLine(std::string const& commandLine)
+{
+	SdfBenchmarkConfig config;
+	std::string value;
+
+	if (GetArgValue(commandLine, "-width", value))
+	{
+		config.m_resolution.x = atoi(value.c_str());
+	}
+	if (GetArgValue(commandLine, "-height", value))
+	{
+		config.m_resolution.y = atoi(value.c_str());
+	}
+	if (GetArgValue(commandLine, "-frames", value))
+	{
+		config.m_numFrames = atoi(value.c_str());
+	}
+	if (GetArgValue(commandLine, "-threads", value))
+	{
+		config.m_numThreads = atoi(value.c_str());
+	}
+	if (GetArgValue(commandLine, "-shapes", value))
+	{
+		config.m_shapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-packetshapes", value))
+	{
+		config.m_packetShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-layoutshapes", value))
+	{
+		config.m_layoutShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-bvhshapes", value))
+	{
+		config.m_bvhShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-binshapes", value))
+	{
+		config.m_binningShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-brickshapes", value))
+	{
+		config.m_brickShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-coneshapes", value))
+	{
+		config.m_coneShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-temporalshapes", value))
+	{
+		config.m_temporalShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-camerapath", value))
+	{
+		config.m_cameraPathFile = value;
+	}
+	if (GetArgValue(commandLine, "-relaxshapes", value))
+	{
+		config.m_relaxationShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-topkshapes", value))
+	{
+		config.m_topKShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-normalshapes", value))
+	{
+		config.m_normalShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-deferredshapes", value))
+	{
+		config.m_deferredShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-shadingrateshapes", value))
+	{
+		config.m_shadingRateShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-csgnodes", value))
+	{
+		config.m_csgNodeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-simshapes", value))
+	{
+		config.m_simulationShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-collideshapes", value))
+	{
+		config.m_collisionShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-uploadshapes", value))
+	{
+		config.m_uploadShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-classifyshapes", value))
+	{
+		config.m_classificationShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-meshshapes", value))
+	{
+		config.m_meshShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-bakeresolutions", value))
+	{
+		config.m_bakeResolutions = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-brickfileresolutions", value))
+	{
+		config.m_brickFileResolutions = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-queryshapes", value))
+	{
+		config.m_queryShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-dirtyshapes", value))
+	{
+		config.m_dirtyShapeCounts = ParseIntList(value);
+	}
+	if (GetArgValue(commandLine, "-out", value))
+	{
+		config.m_outputFolder = value;
+	}
+	if (GetArgValue(commandLine, "-golden", value))
+	{
+		config.m_goldenFolder = value;
+	}
+	config.m_updateGolden = HasArg(commandLine, "-updategolden");
+
+	return config;
+}
+
+std::vector<SdfShape> MakeSdfBenchmarkShapes(int numShapes, uint32_t seed)
+{
+	uint32_t state = (seed != 0) ? seed : 1;
+
+	std::vector<SdfShape> shapes;
+	shapes.reserve(numShapes);
+	for (int i = 0; i < numShapes; ++i)
+	{
+		Vec3 center;
+		center.x = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+		center.y = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+		center.z = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+		float radius = NextRandomFloatInRange(state, MIN_SPHERE_RADIUS, MAX_SPHERE_RADIUS);
+
+		Rgba8 color;
+		color.r = (unsigned char)(NextRandomUint(state) & 0xFF);
+		color.g = (unsigned char)(NextRandomUint(state) & 0xFF);
+		color.b = (unsigned char)(NextRandomUint(state) & 0xFF);
+
+		shapes.push_back(SdfShape::MakeSphere(center, radius, color));
+	}
+	return shapes;
+}
+
+SdfCpuView MakeSdfBenchmarkView(IntVec2 const& resolution)
+{
+	SdfCpuView view;
+	view.m_position = Vec3(-3.f * ACTIVITY_BOX_RADIUS, 0.f, 0.f);
+	view.m_aspect = (float)resolution.x / (float)resolution.y;
+	return view;
+}
+
+LightConstants MakeSdfBenchmarkLightConstants()
+{
+	LightConstants lightConstants;
+	lightConstants.m_sunColor[0] = 1.f;
+	lightConstants.m_sunColor[1] = 1.f;
+	lightConstants.m_sunColor[2] = 1.f;
+	lightConstants.m_sunColor[3] = 0.7f;
+	lightConstants.m_sunNormal = Vec3(1.f, 2.f, -1.f).GetNormalized();
+
+	lightConstants.m_numLights = 3;
+
+	Light pointLight;
+	pointLight.SetColor(0.f, 1.f, 1.f, 0.8f);
+	pointLight.m_worldPosition = Vec3(4.f, 4.f, 2.f);
+	pointLight.m_innerRadius = 4.f;
+	pointLight.m_outerRadius = 6.f;
+	lightConstants.m_lights[0] = pointLight;
+
+	Light spotLight1;
+	spotLight1.SetColor(1.f, 1.f, 0.f, 0.7f);
+	spotLight1.m_worldPosition = Vec3(4.f, -1.62f, 4.516f);
+	spotLight1.m_spotForwardNormal = Vec3(0.f, 1.f, -1.f).GetNormalized();
+	spotLight1.m_innerRadius = 5.f;
+	spotLight1.m_outerRadius = 10.f;
+	spotLight1.m_innerDotThreshold = 0.9f;
+	spotLight1.m_outerDotThreshold = 0.7f;
+	lightConstants.m_lights[1] = spotLight1;
+
+	Light spotLight2;
+	spotLight2.SetColor(0.514f, 0.2706f, 1.f, 0.7f);
+	spotLight2.m_worldPosition = Vec3(4.f, 9.57f, 4.516f);
+	spotLight2.m_spotForwardNormal = Vec3(0.f, -1.f, -1.f).GetNormalized();
+	spotLight2.m_innerRadius = 5.f;
+	spotLight2.m_outerRadius = 10.f;
+	spotLight2.m_innerDotThreshold = 0.9f;
+	spotLight2.m_outerDotThreshold = 0.7f;
+	lightConstants.m_lights[2] = spotLight2;
+
+	return lightConstants;
+}
+
+//-----------------------------------------------------------------------------------------------
+// Also writes the per-pixel cost counters of every scene to SdfCostCounters.csv, one row per shape count, for CI to track
+static bool RunReferenceBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+
+	out_report += Stringf("CPU reference ray marcher: %dx%d, %d frames, %d threads\n",
+		config.m_resolution.x, config.m_resolution.y, config.m_numFrames, jobPool.GetNumThreads());
+	out_report += "  shapes |  ms/frame |   Mrays/s | steps/ray | sdf evals/ray | sdf maps/ray | materials/ray | steps p50/p90/p99/max\n";
+
+	std::string costCsv = "shapes,width,height,pixels,steps,sdf_map_calls,material_evaluations,steps_p50,steps_p90,steps_p99,steps_max,sdf_map_calls_max\n";
+	for (int numShapes : config.m_shapeCounts)
+	{
+		SdfRayMarchingConstants constants;
+		SdfCpuRayMarcher marcher;
+		marcher.SetScene(MakeSdfBenchmarkShapes(numShapes, 1234u), constants);
+		marcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		SdfCpuImage image;
+		SdfCpuFrameStats bestStats = RenderBestOf(marcher, view, config, jobPool, image);
+		SdfCostStats costStats = SdfCostStats::FromImage(image, constants.maxSteps);
+
+		double numRays = (double)bestStats.m_numRays;
+		out_report += Stringf("  %6d | %9.3f | %9.3f | %9.2f | %13.1f | %12.2f | %13.2f | %d/%d/%d/%d\n", numShapes, bestStats.m_milliseconds,
+			bestStats.GetRaysPerSecond() * 1e-6, (double)bestStats.m_counters.m_numSteps / numRays,
+			(double)bestStats.m_counters.m_numSdfEvaluations / numRays, costStats.GetSdfMapCallsPerPixel(), costStats.GetMaterialEvaluationsPerPixel(),
+			costStats.GetStepPercentile(0.5f), costStats.GetStepPercentile(0.9f), costStats.GetStepPercentile(0.99f), costStats.m_maxSteps);
+		costCsv += Stringf("%d,%d,%d,%d,%lld,%lld,%lld,%d,%d,%d,%d,%d\n", numShapes, config.m_resolution.x, config.m_resolution.y, costStats.m_numPixels,
+			(long long)costStats.m_numSteps, (long long)costStats.m_numSdfMapCalls, (long long)costStats.m_numMaterialEvaluations,
+			costStats.GetStepPercentile(0.5f), costStats.GetStepPercentile(0.9f), costStats.GetStepPercentile(0.99f), costStats.m_maxSteps, costStats.m_maxSdfMapCalls);
+
+		std::string imageName = Stringf("Sdf_%dx%d_%d", config.m_resolution.x, config.m_resolution.y, numShapes);
+		if (!config.m_outputFolder.empty())
+		{
+			succeeded &= image.WriteColorPPM(config.m_outputFolder + "/" + imageName + ".ppm");
+			succeeded &= image.WriteDepthPFM(config.m_outputFolder + "/" + imageName + ".pfm");
+		}
+
+		if (config.m_goldenFolder.empty())
+		{
+			continue;
+		}
+
+		std::string goldenPath = config.m_goldenFolder + "/" + imageName;
+		if (config.m_updateGolden)
+		{
+			succeeded &= image.WriteColorPPM(goldenPath + ".ppm");
+			succeeded &= image.WriteDepthPFM(goldenPath + ".pfm");
+			out_report += Stringf("    golden updated: %s\n", goldenPath.c_str());
+			continue;
+		}
+
+		SdfCpuImage golden;
+		if (!golden.ReadColorPPM(goldenPath + ".ppm") || !golden.ReadDepthPFM(goldenPath + ".pfm"))
+		{
+			out_report += Stringf("    golden MISSING: %s\n", goldenPath.c_str());
+			succeeded = false;
+			continue;
+		}
+
+		SdfImageDiff diff = CompareSdfImages(image, golden);
+		bool isMatch = (diff.m_numPixelsOverTolerance == 0);
+		out_report += Stringf("    golden %s: max color error %.0f, mean %.3f, max depth error %g, %d pixels over tolerance\n",
+			isMatch ? "ok" : "FAILED", diff.m_maxColorError, diff.m_meanColorError, diff.m_maxDepthError, diff.m_numPixelsOverTolerance);
+		succeeded &= isMatch;
+	}
+
+	if (!config.m_outputFolder.empty())
+	{
+		FILE* csvFile = fopen((config.m_outputFolder + "/SdfCostCounters.csv").c_str(), "w");
+		succeeded &= (csvFile != nullptr);
+		if (csvFile)
+		{
+			fputs(costCsv.c_str(), csvFile);
+			fclose(csvFile);
+		}
+	}
+	return succeeded;
+}
+
+// Scalar RayMarch against SdfCpuPacketMarcher; the packet images must match the scalar image
+static bool RunPacketBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr int PACKET_SIZES[] = { 4, 8, 16 };
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+
+	out_report += Stringf("\nRay packets (%d-wide %s): %dx%d, %d frames, %d threads\n", SDF_SIMD_WIDTH,
+#if defined(SDF_SIMD_AVX2)
+		"AVX2",
+#elif defined(SDF_SIMD_SSE2)
+		"SSE2",
+#else
+		"scalar",
+#endif
+		config.m_resolution.x, config.m_resolution.y, config.m_numFrames, jobPool.GetNumThreads());
+	out_report += "  shapes | packet |  ms/frame | speedup | sdf evals/ray | culled | max color error\n";
+
+	// Packets cull shapes on their own, compare them against the scalar loop over every shape
+	SdfRayMarchingConstants constants;
+	constants.useBvh = 0;
+
+	for (int numShapes : config.m_packetShapeCounts)
+	{
+		SdfCpuRayMarcher marcher;
+		marcher.SetScene(MakeSdfBenchmarkShapes(numShapes, 1234u), constants);
+		marcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		SdfCpuImage scalarImage;
+		SdfCpuFrameStats scalarStats = RenderBestOf(marcher, view, config, jobPool, scalarImage);
+		double numRays = (double)scalarStats.m_numRays;
+		out_report += Stringf("  %6d | scalar | %9.3f | %6.2fx | %13.1f | %5.1f%% | %15s\n", numShapes, scalarStats.m_milliseconds,
+			1.0, (double)scalarStats.m_counters.m_numSdfEvaluations / numRays, 0.0, "-");
+
+		for (int packetSize : PACKET_SIZES)
+		{
+			SdfCpuPacketMarcher packetMarcher(marcher, packetSize);
+			SdfCpuImage packetImage;
+			SdfCpuFrameStats packetStats = RenderBestOf(packetMarcher, view, config, jobPool, packetImage);
+
+			SdfCpuRayCounters const& counters = packetStats.m_counters;
+			double numShapeTests = (double)(counters.m_numSdfEvaluations + counters.m_numShapesCulled);
+			double culledPercent = (numShapeTests > 0.0) ? 100.0 * (double)counters.m_numShapesCulled / numShapeTests : 0.0;
+
+			SdfImageDiff diff = CompareSdfImages(packetImage, scalarImage);
+			bool isMatch = (diff.m_numPixelsOverTolerance == 0);
+			succeeded &= isMatch;
+
+			out_report += Stringf("  %6d | %6d | %9.3f | %6.2fx | %13.1f | %5.1f%% | %9.0f %s\n", numShapes, packetSize, packetStats.m_milliseconds,
+				scalarStats.m_milliseconds / packetStats.m_milliseconds, (double)counters.m_numSdfEvaluations / numRays, culledPercent,
+				diff.m_maxColorError, isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+// The single 64 byte SdfShape the GPU buffer used before the geometry / material split
+struct SdfLegacyShape
+{
+	int m_type = 0;
+	int m_padding0 = 0;
+	int m_padding1 = 0;
+	uint32_t m_triAlbedoTexID = INVALID_INDEX_U32;
+
+	uint32_t m_triMRTexID = INVALID_INDEX_U32;
+	uint32_t m_triNormalTexID = INVALID_INDEX_U32;
+	uint32_t m_triOcclusionTexID = INVALID_INDEX_U32;
+	uint32_t m_triEmissiveTexID = INVALID_INDEX_U32;
+
+	float m_color[4] = {};
+	Vec4 m_data0;
+};
+
+static constexpr int LAYOUT_NUM_POINTS = 16;
+static constexpr size_t CACHE_LINE_SIZE = 64;
+
+template<typename T_GetGeometry>
+static double TimeSdfMapSweep(int numShapes, std::vector<Vec3> const& points, float toleranceK, T_GetGeometry const& getGeometry, float& out_checksum)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	for (Vec3 const& p : points)
+	{
+		float res = SDF_INFINITY_DIST;
+		for (int i = 0; i < numShapes; ++i)
+		{
+			res = SminCubic(res, SdfValueFromGeometry(p, getGeometry(i)), toleranceK);
+		}
+		out_checksum += res;
+	}
+	auto endTime = std::chrono::steady_clock::now();
+	double numEvaluations = (double)numShapes * (double)points.size();
+	return std::chrono::duration<double, std::nano>(endTime - startTime).count() / numEvaluations;
+}
+
+// Hot loop cost of each shape buffer layout, plus the image error of the float16 geometry stream
+static bool RunShapeLayoutBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	out_report += Stringf("\nShape buffer layout: SdfMap over %d points, %zu byte cache lines\n", LAYOUT_NUM_POINTS, CACHE_LINE_SIZE);
+	out_report += "   shapes | layout            | bytes/shape | lines/eval | ns/eval\n";
+
+	const float toleranceK = SdfRayMarchingConstants().toleranceK;
+	for (int numShapes : config.m_layoutShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		std::vector<Vec3> points;
+		for (SdfShape const& shape : MakeSdfBenchmarkShapes(LAYOUT_NUM_POINTS, 99u))
+		{
+			points.push_back(Vec3(shape.m_data0.x, shape.m_data0.y, shape.m_data0.z));
+		}
+
+		std::vector<SdfLegacyShape> legacyShapes(numShapes);
+		for (int i = 0; i < numShapes; ++i)
+		{
+			legacyShapes[i].m_data0 = shapes[i].m_data0;
+			shapes[i].m_color.GetAsFloats(legacyShapes[i].m_color);
+		}
+		SdfShapeStreams streams;
+		streams.SetShapes(shapes);
+
+		// Each evaluation streams one shape, so a line serves CACHE_LINE_SIZE / stride evaluations
+		float checksum = 0.f;
+		struct LayoutResult { char const* m_name; size_t m_stride; double m_nsPerEval; };
+		LayoutResult results[] =
+		{
+			{ "SdfShape (before)", sizeof(SdfLegacyShape), TimeSdfMapSweep(numShapes, points, toleranceK, [&](int i) { return legacyShapes[i].m_data0; }, checksum) },
+			{ "geometry float32", sizeof(SdfShapeGeometry), TimeSdfMapSweep(numShapes, points, toleranceK, [&](int i) { return streams.m_geometry[i].m_data0; }, checksum) },
+			{ "geometry float16", sizeof(SdfShapeGeometryHalf), TimeSdfMapSweep(numShapes, points, toleranceK, [&](int i) { return streams.GetGeometry(i, true); }, checksum) },
+		};
+		for (LayoutResult const& result : results)
+		{
+			out_report += Stringf("  %7d | %-17s | %11zu | %10.4f | %7.2f\n", numShapes, result.m_name, result.m_stride,
+				(double)result.m_stride / (double)CACHE_LINE_SIZE, result.m_nsPerEval);
+		}
+		if (checksum == 0.f)
+		{
+			out_report += "    (empty sweep)\n";
+		}
+	}
+	out_report += Stringf("  material stream: %zu bytes/shape + %zu bytes/material, read only near a hit\n", sizeof(SdfShapeMaterial), sizeof(SdfMaterial));
+
+	// float16 geometry against float32 geometry, same shape order on both sides
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	SdfRayMarchingConstants floatConstants;
+	floatConstants.useBvh = 0;
+	SdfRayMarchingConstants halfConstants = floatConstants;
+	halfConstants.halfPrecisionGeometry = 1;
+
+	std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(64, 1234u);
+	SdfCpuRayMarcher floatMarcher;
+	floatMarcher.SetScene(shapes, floatConstants);
+	floatMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+	SdfCpuRayMarcher halfMarcher;
+	halfMarcher.SetScene(shapes, halfConstants);
+	halfMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+	SdfCpuImage floatImage;
+	SdfCpuImage halfImage;
+	floatMarcher.RenderFrame(view, config.m_resolution, floatImage, &jobPool);
+	halfMarcher.RenderFrame(view, config.m_resolution, halfImage, &jobPool);
+	SdfImageDiff diff = CompareSdfImages(halfImage, floatImage);
+	out_report += Stringf("  float16 geometry, 64 shapes: max color error %.0f, mean %.3f, max depth error %g, %d pixels over tolerance\n",
+		diff.m_maxColorError, diff.m_meanColorError, diff.m_maxDepthError, diff.m_numPixelsOverTolerance);
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------------------------
+static double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+// Brute force over the same stream order as the BVH leaves, the order the shader sees
+static std::vector<SdfShape> GetShapesInBvhOrder(std::vector<SdfShape> const& shapes, SdfBvh const& bvh)
+{
+	std::vector<SdfShape> orderedShapes;
+	orderedShapes.reserve(shapes.size());
+	for (uint32_t shapeIndex : bvh.GetShapeOrder())
+	{
+		orderedShapes.push_back(shapes[shapeIndex]);
+	}
+	return orderedShapes;
+}
+
+// Build / refit cost at large counts, SdfMap cost with and without the BVH, and the image against brute force
+static bool RunBvhBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr int NUM_QUERY_POINTS = 256;
+	static constexpr int MAX_BRUTE_FORCE_SHAPES = 25000;
+	bool succeeded = true;
+
+	SdfRayMarchingConstants bvhConstants;
+	bvhConstants.useBvh = 1;
+	SdfRayMarchingConstants bruteConstants;
+	bruteConstants.useBvh = 0;
+
+	out_report += Stringf("\nBVH (leaf size %d, bounds inflated by 6k = %.2f): %d SdfMap queries in the activity box\n",
+		SDF_BVH_MAX_LEAF_SIZE, SdfBvh::GetInfluenceRadius(bvhConstants.toleranceK), NUM_QUERY_POINTS);
+	out_report += "   shapes | build ms | refit ms | depth | nodes/map | shapes/map | us/map bvh | us/map all | max |bvh-all|\n";
+
+	for (int numShapes : config.m_bvhShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		std::vector<Vec4> geometry;
+		geometry.reserve(shapes.size());
+		for (SdfShape const& shape : shapes)
+		{
+			geometry.push_back(shape.m_data0);
+		}
+
+		SdfBvh bvh;
+		double buildMilliseconds = 0.0;
+		double refitMilliseconds = 0.0;
+		for (int frame = 0; frame < config.m_numFrames; ++frame)
+		{
+			auto buildStart = std::chrono::steady_clock::now();
+			bvh.Build(geometry, bvhConstants.toleranceK);
+			double buildTime = GetMillisecondsSince(buildStart);
+
+			auto refitStart = std::chrono::steady_clock::now();
+			bvh.Refit(geometry, bvhConstants.toleranceK);
+			double refitTime = GetMillisecondsSince(refitStart);
+
+			buildMilliseconds = (frame == 0) ? buildTime : fmin(buildMilliseconds, buildTime);
+			refitMilliseconds = (frame == 0) ? refitTime : fmin(refitMilliseconds, refitTime);
+		}
+
+		SdfCpuRayMarcher bvhMarcher;
+		bvhMarcher.SetScene(shapes, bvhConstants);
+		SdfCpuRayMarcher bruteMarcher;
+		bruteMarcher.SetScene(GetShapesInBvhOrder(shapes, bvhMarcher.GetBvh()), bruteConstants);
+
+		uint32_t state = 77u;
+		std::vector<Vec3> points;
+		for (int i = 0; i < NUM_QUERY_POINTS; ++i)
+		{
+			float range = ACTIVITY_BOX_RADIUS + MAX_SPHERE_RADIUS;
+			points.push_back(Vec3(NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range)));
+		}
+
+		SdfCpuRayCounters counters;
+		std::vector<float> bvhResults;
+		auto bvhStart = std::chrono::steady_clock::now();
+		for (Vec3 const& p : points)
+		{
+			bvhResults.push_back(bvhMarcher.SdfMap(p, &counters));
+		}
+		double bvhMicroseconds = GetMillisecondsSince(bvhStart) * 1000.0 / NUM_QUERY_POINTS;
+
+		double bruteMicroseconds = 0.0;
+		float maxError = 0.f;
+		if (numShapes <= MAX_BRUTE_FORCE_SHAPES)
+		{
+			auto bruteStart = std::chrono::steady_clock::now();
+			for (int i = 0; i < NUM_QUERY_POINTS; ++i)
+			{
+				maxError = fmaxf(maxError, fabsf(bruteMarcher.SdfMap(points[i]) - bvhResults[i]));
+			}
+			bruteMicroseconds = GetMillisecondsSince(bruteStart) * 1000.0 / NUM_QUERY_POINTS;
+		}
+
+		out_report += Stringf("  %7d | %8.3f | %8.3f | %5d | %9.1f | %10.1f | %10.3f | %10s | %s\n", numShapes, buildMilliseconds, refitMilliseconds,
+			bvh.GetDepth(), (double)counters.m_numBvhNodesVisited / NUM_QUERY_POINTS, (double)counters.m_numSdfEvaluations / NUM_QUERY_POINTS,
+			bvhMicroseconds, (numShapes <= MAX_BRUTE_FORCE_SHAPES) ? Stringf("%.3f", bruteMicroseconds).c_str() : "-",
+			(numShapes <= MAX_BRUTE_FORCE_SHAPES) ? Stringf("%g", maxError).c_str() : "-");
+	}
+
+	// Whole frames: the BVH must not change the image
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	out_report += "  frames   shapes | ms bvh    | ms all    | sdf evals/ray bvh | sdf evals/ray all | max color error\n";
+	for (int numShapes : config.m_packetShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher bvhMarcher;
+		bvhMarcher.SetScene(shapes, bvhConstants);
+		bvhMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuRayMarcher bruteMarcher;
+		bruteMarcher.SetScene(GetShapesInBvhOrder(shapes, bvhMarcher.GetBvh()), bruteConstants);
+		bruteMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		SdfCpuImage bvhImage;
+		SdfCpuImage bruteImage;
+		SdfCpuFrameStats bvhStats = bvhMarcher.RenderFrame(view, config.m_resolution, bvhImage, &jobPool);
+		SdfCpuFrameStats bruteStats = bruteMarcher.RenderFrame(view, config.m_resolution, bruteImage, &jobPool);
+
+		SdfImageDiff diff = CompareSdfImages(bvhImage, bruteImage);
+		bool isMatch = (diff.m_numPixelsOverTolerance == 0);
+		succeeded &= isMatch;
+
+		double numRays = (double)bvhStats.m_numRays;
+		out_report += Stringf("          %7d | %9.3f | %9.3f | %17.1f | %17.1f | %9.0f %s\n", numShapes, bvhStats.m_milliseconds, bruteStats.m_milliseconds,
+			(double)bvhStats.m_counters.m_numSdfEvaluations / numRays, (double)bruteStats.m_counters.m_numSdfEvaluations / numRays,
+			diff.m_maxColorError, isMatch ? "ok" : "FAILED");
+	}
+	return succeeded;
+}
+
+// Binning cost and tile lists against the per-pixel brute force, from outside and from inside the shapes,
+// then whole frames with and without the per-tile lists
+static bool RunTileBinningBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr int MAX_FRAME_SHAPES = 1024;
+	// Surfaces and their blends are exact, but away from them the binned field is larger than the full one,
+	// so rays sample different points: silhouette rays passing about minHitDistance from a sphere can flip hit / miss
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001;
+	bool succeeded = true;
+
+	SdfRayMarchingConstants allConstants;
+	allConstants.useBvh = 0;
+	SdfRayMarchingConstants binnedConstants = allConstants;
+	binnedConstants.useTileBinning = 1;
+
+	SdfCpuView outsideView = MakeSdfBenchmarkView(config.m_resolution);
+	SdfCpuView insideView = outsideView;
+	insideView.m_position = Vec3(0.5f, -0.5f, 0.25f);
+	insideView.m_forward = Vec3(1.f, 1.f, 0.f).GetNormalized();
+	insideView.m_left = Vec3(-1.f, 1.f, 0.f).GetNormalized();
+
+	IntVec2 numTiles = IntVec2((config.m_resolution.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE, (config.m_resolution.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE);
+	out_report += Stringf("\nTile binning (%dx%d tiles, spheres inflated by 6k + %.2f, %d shapes fit in groupshared)\n",
+		numTiles.x, numTiles.y, SDF_TILE_BINNING_MARGIN, SDF_TILE_MAX_GROUPSHARED_SHAPES);
+	out_report += "   shapes | view    | bin ms | brute ms | avg/tile | max/tile | tiles over gs | binned/needed | missing\n";
+
+	for (int numShapes : config.m_binningShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfShapeStreams streams;
+		streams.SetShapes(shapes);
+
+		for (int viewIndex = 0; viewIndex < 2; ++viewIndex)
+		{
+			SdfCpuView const& view = (viewIndex == 0) ? outsideView : insideView;
+
+			SdfTileBinning binning;
+			double binMilliseconds = 0.0;
+			for (int frame = 0; frame < config.m_numFrames; ++frame)
+			{
+				auto binStart = std::chrono::steady_clock::now();
+				binning.Build(view, config.m_resolution, streams, false, allConstants.toleranceK);
+				double binTime = GetMillisecondsSince(binStart);
+				binMilliseconds = (frame == 0) ? binTime : fmin(binMilliseconds, binTime);
+			}
+
+			SdfTileBinning bruteForce;
+			auto bruteStart = std::chrono::steady_clock::now();
+			bruteForce.BuildBruteForce(view, config.m_resolution, streams, false, allConstants.toleranceK);
+			double bruteMilliseconds = GetMillisecondsSince(bruteStart);
+
+			int numMissing = binning.CountMissingPairs(bruteForce);
+			succeeded &= (numMissing == 0);
+
+			SdfTileBinningStats stats = binning.GetStats();
+			SdfTileBinningStats bruteStats = bruteForce.GetStats();
+			out_report += Stringf("  %7d | %-7s | %6.3f | %8.1f | %8.1f | %8d | %13d | %13.2f | %d %s\n", numShapes, (viewIndex == 0) ? "outside" : "inside",
+				binMilliseconds, bruteMilliseconds, stats.m_averageShapesPerTile, stats.m_maxShapesPerTile, stats.m_numTilesOverGroupShared,
+				(bruteStats.m_numIndices > 0) ? (double)stats.m_numIndices / (double)bruteStats.m_numIndices : 1.0,
+				numMissing, (numMissing == 0) ? "ok" : "FAILED");
+		}
+	}
+
+	out_report += "  frames   shapes | view    | ms binned | ms all    | sdf evals/ray binned | sdf evals/ray all | max color error | pixels over\n";
+	for (int numShapes : config.m_binningShapeCounts)
+	{
+		if (numShapes > MAX_FRAME_SHAPES)
+		{
+			continue;
+		}
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher binnedMarcher;
+		binnedMarcher.SetScene(shapes, binnedConstants);
+		binnedMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuRayMarcher allMarcher;
+		allMarcher.SetScene(shapes, allConstants);
+		allMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		for (int viewIndex = 0; viewIndex < 2; ++viewIndex)
+		{
+			SdfCpuView const& view = (viewIndex == 0) ? outsideView : insideView;
+
+			SdfCpuImage binnedImage;
+			SdfCpuImage allImage;
+			SdfCpuFrameStats binnedStats = RenderBestOf(binnedMarcher, view, config, jobPool, binnedImage);
+			SdfCpuFrameStats allStats = RenderBestOf(allMarcher, view, config, jobPool, allImage);
+
+			SdfImageDiff diff = CompareSdfImages(binnedImage, allImage);
+			double numRays = (double)binnedStats.m_numRays;
+			bool isMatch = ((double)diff.m_numPixelsOverTolerance <= MAX_FRACTION_PIXELS_OVER * numRays);
+			succeeded &= isMatch;
+
+			out_report += Stringf("          %7d | %-7s | %9.3f | %9.3f | %20.1f | %17.1f | %15.0f | %d %s\n", numShapes, (viewIndex == 0) ? "outside" : "inside",
+				binnedStats.m_milliseconds, allStats.m_milliseconds,
+				(double)binnedStats.m_counters.m_numSdfEvaluations / numRays, (double)allStats.m_counters.m_numSdfEvaluations / numRays,
+				diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+// Counts points where the brick map bound is above the exact field, must be 0
+static int CountBrickMapViolations(SdfBrickMap const& brickMap, SdfCpuRayMarcher const& marcher, int numPoints, uint32_t seed, double& out_meanGap)
+{
+	uint32_t state = seed;
+	int numViolations = 0;
+	double gapSum = 0.0;
+	for (int i = 0; i < numPoints; ++i)
+	{
+		float range = ACTIVITY_BOX_RADIUS * 2.f;
+		Vec3 p = Vec3(NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range));
+		float exact = marcher.SdfMap(p);
+		float bound = brickMap.GetLowerBound(p);
+		if (bound > exact + 1e-5f)
+		{
+			++numViolations;
+		}
+		gapSum += (double)(exact - bound);
+	}
+	out_meanGap = gapSum / (double)numPoints;
+	return numViolations;
+}
+
+// Full bake, then a few frames where some of the spheres move at full speed and only dirty bricks are rebaked.
+// The BVH is refit between frames like the game does, so the stream order and the baked geometry stay in step.
+// The bound is checked against SdfMap after the moves, then frames are marched with and without it.
+static bool RunBrickMapBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr int NUM_MOVE_FRAMES = 16;
+	static constexpr float MOVE_DELTA_SECONDS = 1.f / 60.f;
+	static constexpr int NUM_CHECK_POINTS = 4096;
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001; // same reason as the tile binning frames
+	static constexpr float MOVING_FRACTIONS[] = { 0.1f, 1.f };
+	bool succeeded = true;
+
+	SdfRayMarchingConstants exactConstants;
+	SdfRayMarchingConstants cachedConstants = exactConstants;
+	cachedConstants.useBrickMap = 1;
+
+	out_report += Stringf("\nBrick map (%d^3 voxels of %.3f per brick, samples below %.2f, narrow band %.2f, rebake after %.2f slack)\n",
+		SDF_BRICK_SIZE, SDF_BRICK_VOXEL_SIZE, SDF_BRICK_FAR_DISTANCE, SDF_BRICK_NARROW_BAND, SDF_BRICK_MAX_SLACK);
+	out_report += "   shapes | moving | full bake ms | bricks sampled/total | KB sparse | KB dense | dirty/frame | rebake ms/frame | violations | mean gap\n";
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	std::string frameReport = "  frames   shapes | moving | ms cached | ms exact  | sdf evals/ray cached | sdf evals/ray exact | cached steps/ray | max color error | pixels over\n";
+
+	for (int numShapes : config.m_brickShapeCounts)
+	{
+		for (float movingFraction : MOVING_FRACTIONS)
+		{
+			std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+			SdfBvh bvh;
+			SdfShapeStreams streams;
+			bvh.UpdateShapeStreams(shapes, exactConstants.toleranceK, false, false, streams);
+
+			SdfCpuRayMarcher marcher;
+			marcher.SetScene(shapes, exactConstants, &bvh);
+			auto sdfMap = [&marcher](Vec3 const& p) { return marcher.SdfMap(p); };
+
+			std::vector<Vec4> geometry(numShapes);
+			auto readGeometry = [&]()
+			{
+				for (int i = 0; i < numShapes; ++i)
+				{
+					geometry[i] = marcher.GetShapeStreams().GetGeometry(i, false);
+				}
+			};
+			readGeometry();
+
+			SdfBrickMap brickMap;
+			brickMap.Update(geometry, exactConstants.toleranceK, sdfMap, &jobPool);
+			SdfBrickMapStats bakeStats = brickMap.GetStats();
+
+			// Same motion as GameRayMarching::UpdateShapes, deterministic velocities
+			uint32_t state = 99u;
+			int numMoving = (int)ceilf(movingFraction * (float)numShapes);
+			std::vector<Vec3> velocities;
+			for (int i = 0; i < numMoving; ++i)
+			{
+				velocities.push_back(Vec3(NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED),
+					NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED)));
+			}
+
+			double dirtySum = 0.0;
+			double rebakeMilliseconds = 0.0;
+			for (int frame = 0; frame < NUM_MOVE_FRAMES; ++frame)
+			{
+				for (int i = 0; i < numMoving; ++i)
+				{
+					Vec4& shapeGeometry = shapes[i].m_data0;
+					shapeGeometry.x = GetClamped(shapeGeometry.x + velocities[i].x * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+					shapeGeometry.y = GetClamped(shapeGeometry.y + velocities[i].y * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+					shapeGeometry.z = GetClamped(shapeGeometry.z + velocities[i].z * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+				}
+				bvh.UpdateShapeStreams(shapes, exactConstants.toleranceK, false, true, streams);
+				marcher.SetScene(shapes, exactConstants, &bvh);
+				readGeometry();
+				brickMap.Update(geometry, exactConstants.toleranceK, sdfMap, &jobPool);
+				dirtySum += brickMap.GetStats().m_numDirtyBricks;
+				rebakeMilliseconds += brickMap.GetStats().m_bakeMilliseconds;
+			}
+
+			double meanGap = 0.0;
+			int numViolations = CountBrickMapViolations(brickMap, marcher, NUM_CHECK_POINTS, 5u, meanGap);
+			succeeded &= (numViolations == 0);
+
+			out_report += Stringf("  %7d | %5.0f%% | %12.2f | %9d/%-10d | %9.0f | %8.0f | %11.1f | %15.3f | %10d | %.3f %s\n", numShapes, movingFraction * 100.f,
+				bakeStats.m_bakeMilliseconds, bakeStats.m_numAllocatedBricks, bakeStats.m_numBricks, (double)bakeStats.m_numBytes / 1024.0,
+				(double)bakeStats.m_numDenseBytes / 1024.0, dirtySum / NUM_MOVE_FRAMES, rebakeMilliseconds / NUM_MOVE_FRAMES, numViolations, meanGap,
+				(numViolations == 0) ? "ok" : "FAILED");
+
+			// Frames over the moved scene
+			SdfCpuRayMarcher exactMarcher;
+			exactMarcher.SetScene(shapes, exactConstants, &bvh);
+			exactMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+			SdfCpuRayMarcher cachedMarcher;
+			cachedMarcher.SetScene(shapes, cachedConstants, &bvh);
+			cachedMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+			cachedMarcher.SetBrickMap(&brickMap);
+
+			SdfCpuImage cachedImage;
+			SdfCpuImage exactImage;
+			SdfCpuFrameStats cachedStats = RenderBestOf(cachedMarcher, view, config, jobPool, cachedImage);
+			SdfCpuFrameStats exactStats = RenderBestOf(exactMarcher, view, config, jobPool, exactImage);
+
+			SdfImageDiff diff = CompareSdfImages(cachedImage, exactImage);
+			double numRays = (double)cachedStats.m_numRays;
+			bool isMatch = ((double)diff.m_numPixelsOverTolerance <= MAX_FRACTION_PIXELS_OVER * numRays);
+			succeeded &= isMatch;
+
+			frameReport += Stringf("          %7d | %5.0f%% | %9.3f | %9.3f | %20.1f | %19.1f | %16.1f | %15.0f | %d %s\n", numShapes, movingFraction * 100.f,
+				cachedStats.m_milliseconds, exactStats.m_milliseconds,
+				(double)cachedStats.m_counters.m_numSdfEvaluations / numRays, (double)exactStats.m_counters.m_numSdfEvaluations / numRays,
+				(double)cachedStats.m_counters.m_numBrickMapSteps / numRays, diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+		}
+	}
+	out_report += frameReport;
+	return succeeded;
+}
+
+// Per-pixel steps with and without the cone depth pre-pass, split into hit and sky pixels.
+// Every cone start must be at or before the distance the plain march hits at, for each pixel of its block.
+static bool RunConeDepthBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001; // the march samples other points, same as the tile binning frames
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	IntVec2 const& dimensions = config.m_resolution;
+	IntVec2 coneDimensions = SdfCpuRayMarcher::GetConeDepthDimensions(dimensions);
+
+	SdfRayMarchingConstants plainConstants;
+	SdfRayMarchingConstants coneConstants = plainConstants;
+	coneConstants.useConeDepthPrepass = 1;
+
+	out_report += Stringf("\nCone depth pre-pass (%dx%d cones of %dx%d pixels): %dx%d, steps per full-res pixel\n", coneDimensions.x, coneDimensions.y,
+		SDF_CONE_PREPASS_FACTOR, SDF_CONE_PREPASS_FACTOR, dimensions.x, dimensions.y);
+	out_report += "   shapes | ms plain  | ms cone   | hit plain | hit cone | sky plain | sky cone | cone steps | fewer/more pixels | late starts | max color error | pixels over\n";
+
+	for (int numShapes : config.m_coneShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher plainMarcher;
+		plainMarcher.SetScene(shapes, plainConstants);
+		plainMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuRayMarcher coneMarcher;
+		coneMarcher.SetScene(shapes, coneConstants, &plainMarcher.GetBvh());
+		coneMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		SdfCpuImage plainImage;
+		SdfCpuImage coneImage;
+		SdfCpuFrameStats plainStats = RenderBestOf(plainMarcher, view, config, jobPool, plainImage);
+		SdfCpuFrameStats coneStats = RenderBestOf(coneMarcher, view, config, jobPool, coneImage);
+
+		// Hit distances of the plain march against the cone starts
+		std::vector<float> coneStartDistances;
+		coneMarcher.RenderConeDepth(view, dimensions, coneStartDistances, &jobPool);
+		std::vector<float> hitDistances(plainImage.m_colors.size());
+		RunSdfCpuTiles(dimensions, &jobPool, [&](IntVec2 const& tileCoords, SdfCpuRayCounters&)
+		{
+			int endX = (tileCoords.x + 1) * SDF_TILE_SIZE < dimensions.x ? (tileCoords.x + 1) * SDF_TILE_SIZE : dimensions.x;
+			int endY = (tileCoords.y + 1) * SDF_TILE_SIZE < dimensions.y ? (tileCoords.y + 1) * SDF_TILE_SIZE : dimensions.y;
+			for (int y = tileCoords.y * SDF_TILE_SIZE; y < endY; ++y)
+			{
+				for (int x = tileCoords.x * SDF_TILE_SIZE; x < endX; ++x)
+				{
+					hitDistances[y * dimensions.x + x] = plainMarcher.RayMarch(view.m_position, view.GetRayDirection(x, y, dimensions)).w;
+				}
+			}
+		});
+
+		int64_t hitSteps[2] = {};
+		int64_t skySteps[2] = {};
+		int numHitPixels = 0;
+		int numFewerPixels = 0;
+		int numMorePixels = 0;
+		int numLateStarts = 0;
+		for (int y = 0; y < dimensions.y; ++y)
+		{
+			for (int x = 0; x < dimensions.x; ++x)
+			{
+				int pixelIndex = y * dimensions.x + x;
+				int plainSteps = plainImage.m_stepCounts[pixelIndex];
+				int coneSteps = coneImage.m_stepCounts[pixelIndex];
+				bool isHit = (hitDistances[pixelIndex] < SDF_INFINITY_DIST);
+				int64_t* steps = isHit ? hitSteps : skySteps;
+				steps[0] += plainSteps;
+				steps[1] += coneSteps;
+				numHitPixels += isHit ? 1 : 0;
+				numFewerPixels += (coneSteps < plainSteps) ? 1 : 0;
+				numMorePixels += (coneSteps > plainSteps) ? 1 : 0;
+
+				float startDistance = coneStartDistances[(y / SDF_CONE_PREPASS_FACTOR) * coneDimensions.x + x / SDF_CONE_PREPASS_FACTOR];
+				numLateStarts += (isHit && startDistance > hitDistances[pixelIndex]) ? 1 : 0;
+			}
+		}
+		int numSkyPixels = dimensions.x * dimensions.y - numHitPixels;
+
+		SdfImageDiff diff = CompareSdfImages(coneImage, plainImage);
+		double numRays = (double)coneStats.m_numRays;
+		bool isMatch = (numLateStarts == 0) && ((double)diff.m_numPixelsOverTolerance <= MAX_FRACTION_PIXELS_OVER * numRays);
+		succeeded &= isMatch;
+
+		out_report += Stringf("  %7d | %9.3f | %9.3f | %9.2f | %8.2f | %9.2f | %8.2f | %10.2f | %8d/%-8d | %11d | %15.0f | %d %s\n", numShapes,
+			plainStats.m_milliseconds, coneStats.m_milliseconds,
+			(double)hitSteps[0] / (double)std::max(numHitPixels, 1), (double)hitSteps[1] / (double)std::max(numHitPixels, 1),
+			(double)skySteps[0] / (double)std::max(numSkyPixels, 1), (double)skySteps[1] / (double)std::max(numSkyPixels, 1),
+			(double)coneStats.m_counters.m_numConeSteps / numRays, numFewerPixels, numMorePixels, numLateStarts,
+			diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+	}
+	return succeeded;
+}
+
+// Slow orbit around the activity box with a little dolly, the camera speed the game mostly sees
+static std::vector<SdfCameraPathFrame> MakeSdfBenchmarkCameraPath(IntVec2 const& resolution)
+{
+	static constexpr int NUM_FRAMES = 24;
+	static constexpr float DELTA_SECONDS = 1.f / 60.f;
+	static constexpr float DEGREES_PER_SECOND = 12.f;
+	static constexpr float DOLLY_PER_SECOND = 1.5f;
+
+	std::vector<SdfCameraPathFrame> frames;
+	for (int frameIndex = 0; frameIndex < NUM_FRAMES; ++frameIndex)
+	{
+		float seconds = (float)frameIndex * DELTA_SECONDS;
+		float yawDegrees = DEGREES_PER_SECOND * seconds;
+		float distance = 3.f * ACTIVITY_BOX_RADIUS - DOLLY_PER_SECOND * seconds;
+
+		SdfCameraPathFrame frame;
+		frame.m_deltaSeconds = DELTA_SECONDS;
+		frame.m_view = MakeSdfBenchmarkView(resolution);
+		frame.m_view.m_forward = Vec3(CosDegrees(yawDegrees), SinDegrees(yawDegrees), 0.f);
+		frame.m_view.m_left = Vec3(-SinDegrees(yawDegrees), CosDegrees(yawDegrees), 0.f);
+		frame.m_view.m_position = frame.m_view.m_forward * -distance;
+		frames.push_back(frame);
+	}
+	return frames;
+}
+
+// Every variant renders the path in order and keeps its own history, like the game does.
+// Shapes move at game speeds and bounce off the box, so the margin is exercised. The reprojected start of
+// every pixel must be at or before the distance the plain march hits at, and the images must match it.
+static bool RunTemporalBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001; // the march samples other points, same as the tile binning frames
+	bool succeeded = true;
+
+	IntVec2 const& dimensions = config.m_resolution;
+	std::vector<SdfCameraPathFrame> path;
+	if (config.m_cameraPathFile.empty() || !ReadSdfCameraPath(config.m_cameraPathFile, path))
+	{
+		path = MakeSdfBenchmarkCameraPath(dimensions);
+	}
+	for (SdfCameraPathFrame& frame : path)
+	{
+		frame.m_view.m_aspect = (float)dimensions.x / (float)dimensions.y;
+	}
+
+	SdfRayMarchingConstants variantConstants[4];
+	variantConstants[1].useTemporalReprojection = 1;
+	variantConstants[2].useConeDepthPrepass = 1;
+	variantConstants[3].useConeDepthPrepass = 1;
+	variantConstants[3].useTemporalReprojection = 1;
+	char const* variantNames[4] = { "plain", "temporal", "cone", "cone+temporal" };
+
+	out_report += Stringf("\nTemporal reprojection (%d frames of %s, %dx%d, %.1f%% depth slack, %d-%d pixel dilation): per frame after the first\n",
+		(int)path.size(), config.m_cameraPathFile.empty() ? "built-in orbit" : config.m_cameraPathFile.c_str(), dimensions.x, dimensions.y,
+		SDF_TEMPORAL_DEPTH_SLACK * 100.f, SDF_TEMPORAL_DILATION, SDF_TEMPORAL_MAX_DILATION);
+	out_report += "   shapes | variant       | ms        | steps/px | hit steps/px | hinted px | fallbacks | late starts | max color error | pixels over\n";
+
+	for (int numShapes : config.m_temporalShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		uint32_t state = 99u;
+		std::vector<Vec3> velocities;
+		for (int i = 0; i < numShapes; ++i)
+		{
+			Vec3 velocity(NextRandomFloatInRange(state, MIN_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, MIN_OBJECT_SPEED, MAX_OBJECT_SPEED),
+				NextRandomFloatInRange(state, MIN_OBJECT_SPEED, MAX_OBJECT_SPEED));
+			velocity.x *= (NextRandomUint(state) & 1) ? 1.f : -1.f;
+			velocity.y *= (NextRandomUint(state) & 1) ? 1.f : -1.f;
+			velocity.z *= (NextRandomUint(state) & 1) ? 1.f : -1.f;
+			velocities.push_back(velocity);
+		}
+
+		SdfTemporalHistory histories[4];
+		bool hasHistory[4] = {};
+		double milliseconds[4] = {};
+		SdfCpuRayCounters counters[4];
+		int numLateStarts[4] = {};
+		int numPixelsOver[4] = {};
+		float maxColorError[4] = {};
+		int64_t numHintedPixels[4] = {};
+		int64_t numHitSteps[4] = {};
+		int64_t numHitPixels = 0;
+		int64_t numRays = 0;
+		for (int frameIndex = 0; frameIndex < (int)path.size(); ++frameIndex)
+		{
+			SdfCameraPathFrame const& frame = path[frameIndex];
+			float maxShapeMove = 0.f;
+			if (frameIndex > 0)
+			{
+				// Same as GameRayMarching::UpdateShapes
+				for (int i = 0; i < numShapes; ++i)
+				{
+					Vec4& geometry = shapes[i].m_data0;
+					float* position[3] = { &geometry.x, &geometry.y, &geometry.z };
+					float* velocity[3] = { &velocities[i].x, &velocities[i].y, &velocities[i].z };
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						*position[axis] += *velocity[axis] * frame.m_deltaSeconds;
+						if (*position[axis] > ACTIVITY_BOX_RADIUS || *position[axis] < -ACTIVITY_BOX_RADIUS)
+						{
+							*position[axis] = GetClamped(*position[axis], -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+							*velocity[axis] *= -1.f;
+						}
+					}
+					maxShapeMove = std::max(maxShapeMove, velocities[i].GetLength() * frame.m_deltaSeconds);
+				}
+			}
+
+			SdfCpuImage images[4];
+			SdfCpuRayMarcher marchers[4];
+			SdfBvh const* bvh = nullptr;
+			for (int variant = 0; variant < 4; ++variant)
+			{
+				histories[variant].m_maxShapeMove = maxShapeMove;
+				marchers[variant].SetScene(shapes, variantConstants[variant], bvh);
+				marchers[variant].SetLightConstants(MakeSdfBenchmarkLightConstants());
+				marchers[variant].SetTemporalHistory(hasHistory[variant] ? &histories[variant] : nullptr);
+				bvh = &marchers[0].GetBvh();
+
+				SdfCpuFrameStats stats = marchers[variant].RenderFrame(frame.m_view, dimensions, images[variant], &jobPool);
+				if (frameIndex > 0)
+				{
+					milliseconds[variant] += stats.m_milliseconds;
+					counters[variant].Add(stats.m_counters);
+					numRays += (variant == 0) ? stats.m_numRays : 0;
+				}
+			}
+
+			for (int pixelIndex = 0; pixelIndex < (int)images[0].m_depths.size() && frameIndex > 0; ++pixelIndex)
+			{
+				if (images[0].m_depths[pixelIndex] < 1.f)
+				{
+					++numHitPixels;
+					for (int variant = 0; variant < 4; ++variant)
+					{
+						numHitSteps[variant] += images[variant].m_stepCounts[pixelIndex];
+					}
+				}
+			}
+
+			for (int variant = 1; variant < 4 && frameIndex > 0; ++variant)
+			{
+				SdfImageDiff diff = CompareSdfImages(images[variant], images[0]);
+				numPixelsOver[variant] += diff.m_numPixelsOverTolerance;
+				maxColorError[variant] = std::max(maxColorError[variant], diff.m_maxColorError);
+				if (!variantConstants[variant].useTemporalReprojection)
+				{
+					continue;
+				}
+
+				// The start each pixel took, against the plain hit distance
+				SdfTemporalReprojection reprojection;
+				reprojection.Build(histories[variant], frame.m_view, dimensions);
+				std::vector<float> coneStartDistances;
+				if (variantConstants[variant].useConeDepthPrepass)
+				{
+					marchers[variant].RenderConeDepth(frame.m_view, dimensions, coneStartDistances, &jobPool);
+				}
+				int numConesX = SdfCpuRayMarcher::GetConeDepthDimensions(dimensions).x;
+				for (int y = 0; y < dimensions.y; ++y)
+				{
+					for (int x = 0; x < dimensions.x; ++x)
+					{
+						Vec3 rayFwdNormal = frame.m_view.GetRayDirection(x, y, dimensions);
+						float safeStart = coneStartDistances.empty() ? 0.f : coneStartDistances[(y / SDF_CONE_PREPASS_FACTOR) * numConesX + x / SDF_CONE_PREPASS_FACTOR];
+						float hintDistance = reprojection.GetHintDistance(IntVec2(x, y));
+						float startDistance = marchers[variant].ValidateTemporalStart(frame.m_view.m_position, rayFwdNormal, safeStart, hintDistance);
+						numHintedPixels[variant] += (hintDistance > 0.f) ? 1 : 0;
+
+						float plainDepth = images[0].m_depths[y * dimensions.x + x];
+						if (plainDepth < 1.f)
+						{
+							float hitDistance = frame.m_view.GetViewZ(plainDepth) / DotProduct3D(rayFwdNormal, frame.m_view.m_forward);
+							numLateStarts[variant] += (startDistance > hitDistance * 1.0001f) ? 1 : 0;
+						}
+					}
+				}
+			}
+
+			for (int variant = 0; variant < 4; ++variant)
+			{
+				histories[variant].m_view = frame.m_view;
+				histories[variant].m_dimensions = dimensions;
+				histories[variant].m_depths = images[variant].m_depths;
+				hasHistory[variant] = true;
+			}
+		}
+
+		double numFrames = (double)std::max((int)path.size() - 1, 1);
+		double numPixels = (double)std::max(numRays, (int64_t)1);
+		for (int variant = 0; variant < 4; ++variant)
+		{
+			SdfCpuRayCounters const& variantCounters = counters[variant];
+			int64_t numSteps = variantCounters.m_numSteps + variantCounters.m_numConeSteps + variantCounters.m_numTemporalStarts + variantCounters.m_numTemporalFallbacks;
+			int64_t numValidated = variantCounters.m_numTemporalStarts + variantCounters.m_numTemporalFallbacks;
+			bool isMatch = (numLateStarts[variant] == 0) && ((double)numPixelsOver[variant] <= MAX_FRACTION_PIXELS_OVER * numPixels);
+			succeeded &= isMatch;
+
+			out_report += Stringf("  %7d | %-13s | %9.3f | %8.2f | %12.2f | %8.1f%% | %8.2f%% | %11d | %15.0f | %d %s\n", numShapes, variantNames[variant],
+				milliseconds[variant] / numFrames, (double)numSteps / numPixels, (double)numHitSteps[variant] / (double)std::max(numHitPixels, (int64_t)1),
+				100.0 * (double)numHintedPixels[variant] / numPixels,
+				100.0 * (double)variantCounters.m_numTemporalFallbacks / (double)std::max(numValidated, (int64_t)1), numLateStarts[variant],
+				maxColorError[variant], numPixelsOver[variant], isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+// Over-relaxed stepping at a few omegas against the plain stepper on the same scene.
+// The fallback rate is the share of rays whose spheres stopped overlapping at least once and stepped back to plain steps.
+static bool RunOverRelaxationBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001; // the march samples other points, same as the tile binning frames
+	static constexpr float OMEGAS[] = { 1.2f, 1.4f, 1.6f, 1.8f };
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	SdfRayMarchingConstants plainConstants;
+
+	out_report += Stringf("\nOver-relaxed sphere tracing: %dx%d, against plain steps\n", config.m_resolution.x, config.m_resolution.y);
+	out_report += "   shapes | omega | ms        | steps/px | hit steps/px | sky steps/px | fallback rays | max color error | pixels over\n";
+
+	for (int numShapes : config.m_relaxationShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher plainMarcher;
+		plainMarcher.SetScene(shapes, plainConstants);
+		plainMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuImage plainImage;
+		SdfCpuFrameStats plainStats = RenderBestOf(plainMarcher, view, config, jobPool, plainImage);
+
+		auto addRow = [&](float omega, SdfCpuFrameStats const& stats, SdfCpuImage const& image, SdfImageDiff const& diff, bool isMatch)
+		{
+			int64_t stepSums[2] = {};
+			int numHitPixels = 0;
+			for (size_t pixelIndex = 0; pixelIndex < plainImage.m_depths.size(); ++pixelIndex)
+			{
+				bool isHit = (plainImage.m_depths[pixelIndex] < 1.f);
+				stepSums[isHit ? 0 : 1] += image.m_stepCounts[pixelIndex];
+				numHitPixels += isHit ? 1 : 0;
+			}
+			int numSkyPixels = (int)plainImage.m_depths.size() - numHitPixels;
+			double numRays = (double)stats.m_numRays;
+			out_report += Stringf("  %7d | %5.2f | %9.3f | %8.2f | %12.2f | %12.2f | %12.2f%% | %15.0f | %d %s\n", numShapes, omega, stats.m_milliseconds,
+				(double)stats.m_counters.m_numSteps / numRays, (double)stepSums[0] / (double)std::max(numHitPixels, 1),
+				(double)stepSums[1] / (double)std::max(numSkyPixels, 1), 100.0 * (double)stats.m_counters.m_numRelaxationFallbacks / numRays,
+				diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+		};
+		addRow(1.f, plainStats, plainImage, SdfImageDiff(), true);
+
+		for (float omega : OMEGAS)
+		{
+			SdfRayMarchingConstants relaxedConstants = plainConstants;
+			relaxedConstants.useOverRelaxation = 1;
+			relaxedConstants.overRelaxationOmega = omega;
+			SdfCpuRayMarcher relaxedMarcher;
+			relaxedMarcher.SetScene(shapes, relaxedConstants, &plainMarcher.GetBvh());
+			relaxedMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+			SdfCpuImage relaxedImage;
+			SdfCpuFrameStats relaxedStats = RenderBestOf(relaxedMarcher, view, config, jobPool, relaxedImage);
+			SdfImageDiff diff = CompareSdfImages(relaxedImage, plainImage);
+			bool isMatch = ((double)diff.m_numPixelsOverTolerance <= MAX_FRACTION_PIXELS_OVER * (double)relaxedStats.m_numRays);
+			succeeded &= isMatch;
+			addRow(omega, relaxedStats, relaxedImage, diff, isMatch);
+		}
+	}
+	return succeeded;
+}
+
+// Top-K material blending at every K against blending all shapes within 3k, on the same march.
+// Only the fetch counts are checked: the error is the price of K and is reported for choosing it.
+static bool RunTopKMaterialsBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	SdfRayMarchingConstants fullConstants;
+
+	out_report += Stringf("\nTop-K material blending: %dx%d, min weight %.2f, against full blending\n", config.m_resolution.x, config.m_resolution.y,
+		fullConstants.topKMinWeight);
+	out_report += "   shapes | K    | ms        | candidates/hit px | materials/hit px | fetches/hit px | fetches saved | max color error | mean color error | pixels over\n";
+
+	for (int numShapes : config.m_topKShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher fullMarcher;
+		fullMarcher.SetScene(shapes, fullConstants);
+		fullMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuImage fullImage;
+		SdfCpuFrameStats fullStats = RenderBestOf(fullMarcher, view, config, jobPool, fullImage);
+
+		int numHitPixels = 0;
+		for (float depth : fullImage.m_depths)
+		{
+			numHitPixels += (depth < 1.f) ? 1 : 0;
+		}
+		double numHitRays = (double)std::max(numHitPixels, 1); // materials are only sampled on hits
+
+		auto addRow = [&](char const* kText, SdfCpuFrameStats const& stats, SdfImageDiff const& diff, bool isMatch)
+		{
+			SdfCpuRayCounters const& counters = stats.m_counters;
+			double fetchesSaved = 1.0 - (double)counters.m_numMaterialEvaluations / (double)std::max(fullStats.m_counters.m_numMaterialEvaluations, (int64_t)1);
+			out_report += Stringf("  %7d | %-4s | %9.3f | %17.2f | %16.2f | %14.1f | %12.1f%% | %15.0f | %16.3f | %d %s\n", numShapes, kText, stats.m_milliseconds,
+				(double)counters.m_numMaterialCandidates / numHitRays, (double)counters.m_numMaterialEvaluations / numHitRays,
+				(double)(counters.m_numMaterialEvaluations * SDF_TRIPLANAR_FETCHES_PER_MATERIAL) / numHitRays, 100.0 * fetchesSaved,
+				diff.m_maxColorError, diff.m_meanColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+		};
+		addRow("all", fullStats, SdfImageDiff(), true);
+
+		SdfRayMarchingConstants topKConstants = fullConstants;
+		topKConstants.useTopKMaterials = 1;
+		for (int topK = 1; topK <= SDF_TOPK_MAX_MATERIALS; ++topK)
+		{
+			SdfCpuRayMarcher topKMarcher;
+			topKMarcher.SetScene(shapes, topKConstants, &fullMarcher.GetBvh());
+			topKMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+			topKMarcher.SetTopKMaterials(topK);
+
+			SdfCpuImage topKImage;
+			SdfCpuFrameStats topKStats = RenderBestOf(topKMarcher, view, config, jobPool, topKImage);
+			SdfImageDiff diff = CompareSdfImages(topKImage, fullImage);
+
+			// Same march, so the same candidates; never more than K of them sampled per pixel
+			bool isMatch = (topKStats.m_counters.m_numMaterialCandidates == fullStats.m_counters.m_numMaterialCandidates);
+			isMatch &= (topKStats.m_counters.m_numMaterialEvaluations <= fullStats.m_counters.m_numMaterialEvaluations);
+			for (int materialCount : topKImage.m_materialCounts)
+			{
+				isMatch &= (materialCount <= topK);
+			}
+			succeeded &= isMatch;
+			addRow(Stringf("%d", topK).c_str(), topKStats, diff, isMatch);
+		}
+	}
+	return succeeded;
+}
+
+// SdfMapGradient against central differences of SdfMap at points pulled toward the surface, then frames shaded with
+// analytic normals against SdfNormalTetra ones. Inside a blend the gradient can get short, so the angle is only
+// checked at the points that reached the surface, where normals are taken.
+static bool RunAnalyticNormalBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	static constexpr int NUM_POINTS = 4096;
+	static constexpr float FINITE_DIFFERENCE_STEP = 1e-3f;
+	static constexpr float MAX_GRADIENT_ERROR = 2e-3f; // float central differences of distances up to ~10
+	static constexpr float MAX_ANGLE_DEGREES = 0.5f; // at surface points, where the gradient is about unit length
+	static constexpr float SURFACE_DISTANCE = 1e-3f;
+	static constexpr double MAX_FRACTION_PIXELS_OVER = 0.001;
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	SdfRayMarchingConstants tetraConstants;
+	tetraConstants.useAnalyticNormals = 0;
+	SdfRayMarchingConstants analyticConstants = tetraConstants;
+	analyticConstants.useAnalyticNormals = 1;
+
+	out_report += Stringf("\nAnalytic normals: %d points pulled to the surface, against central differences (step %g), %dx%d frames against SdfNormalTetra\n",
+		NUM_POINTS, FINITE_DIFFERENCE_STEP, config.m_resolution.x, config.m_resolution.y);
+	out_report += "   shapes | surface points | max value error | max gradient error | max angle deg | ms tetra  | ms analytic | sdf maps/hit px tetra | analytic | max color error | pixels over\n";
+
+	for (int numShapes : config.m_normalShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		SdfCpuRayMarcher tetraMarcher;
+		tetraMarcher.SetScene(shapes, tetraConstants);
+		tetraMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuRayMarcher analyticMarcher;
+		analyticMarcher.SetScene(shapes, analyticConstants, &tetraMarcher.GetBvh());
+		analyticMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+		float maxValueError = 0.f;
+		float maxGradientError = 0.f;
+		float maxAngleDegrees = 0.f;
+		int numSurfacePoints = 0;
+		uint32_t state = 99u;
+		for (int pointIndex = 0; pointIndex < NUM_POINTS; ++pointIndex)
+		{
+			Vec3 p;
+			p.x = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+			p.y = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+			p.z = NextRandomFloatInRange(state, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+			for (int iteration = 0; iteration < 8; ++iteration)
+			{
+				SdfDistanceGradient pull = analyticMarcher.SdfMapGradient(p);
+				if (pull.m_gradient.GetLengthSquared() > 1e-6f)
+				{
+					p -= pull.m_gradient.GetNormalized() * pull.m_distance;
+				}
+			}
+
+			SdfDistanceGradient analytic = analyticMarcher.SdfMapGradient(p);
+			constexpr float h = FINITE_DIFFERENCE_STEP;
+			Vec3 const dx = Vec3(h, 0.f, 0.f);
+			Vec3 const dy = Vec3(0.f, h, 0.f);
+			Vec3 const dz = Vec3(0.f, 0.f, h);
+			Vec3 finiteDifference = Vec3(analyticMarcher.SdfMap(p + dx) - analyticMarcher.SdfMap(p - dx),
+				analyticMarcher.SdfMap(p + dy) - analyticMarcher.SdfMap(p - dy),
+				analyticMarcher.SdfMap(p + dz) - analyticMarcher.SdfMap(p - dz)) / (2.f * h);
+
+			maxValueError = std::max(maxValueError, fabsf(analytic.m_distance - analyticMarcher.SdfMap(p)));
+			maxGradientError = std::max(maxGradientError, (analytic.m_gradient - finiteDifference).GetLength());
+			if (fabsf(analytic.m_distance) > SURFACE_DISTANCE)
+			{
+				continue;
+			}
+			++numSurfacePoints;
+			float cosAngle = std::min(DotProduct3D(analytic.m_gradient.GetNormalized(), finiteDifference.GetNormalized()), 1.f);
+			maxAngleDegrees = std::max(maxAngleDegrees, acosf(cosAngle) * (180.f / 3.14159265f));
+		}
+
+		SdfCpuImage tetraImage;
+		SdfCpuFrameStats tetraStats = RenderBestOf(tetraMarcher, view, config, jobPool, tetraImage);
+		SdfCpuImage analyticImage;
+		SdfCpuFrameStats analyticStats = RenderBestOf(analyticMarcher, view, config, jobPool, analyticImage);
+		SdfImageDiff diff = CompareSdfImages(analyticImage, tetraImage);
+
+		// Normal cost only: the march is the same, so the difference in SdfMap calls is the tetrahedron's
+		int numHitPixels = 0;
+		for (float depth : tetraImage.m_depths)
+		{
+			numHitPixels += (depth < 1.f) ? 1 : 0;
+		}
+		double numHitRays = (double)std::max(numHitPixels, 1);
+		int64_t numMarchMapCalls = analyticStats.m_counters.m_numSdfMapCalls - numHitPixels;
+
+		bool isMatch = (maxGradientError <= MAX_GRADIENT_ERROR) && (maxAngleDegrees <= MAX_ANGLE_DEGREES) && (maxValueError <= 1e-5f);
+		isMatch &= ((double)diff.m_numPixelsOverTolerance <= MAX_FRACTION_PIXELS_OVER * (double)analyticStats.m_numRays);
+		succeeded &= isMatch;
+		out_report += Stringf("  %7d | %14d | %15g | %18g | %13.3f | %9.3f | %11.3f | %21.2f | %8.2f | %15.0f | %d %s\n", numShapes, numSurfacePoints, maxValueError, maxGradientError,
+			maxAngleDegrees, tetraStats.m_milliseconds, analyticStats.m_milliseconds,
+			(double)(tetraStats.m_counters.m_numSdfMapCalls - numMarchMapCalls) / numHitRays,
+			(double)(analyticStats.m_counters.m_numSdfMapCalls - numMarchMapCalls) / numHitRays,
+			diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+	}
+	return succeeded;
+}
+
+// SdfDynamicResolution on synthetic frame times: ms = fixed + perPixel * scale^2, times a noise factor.
+// Checks it settles on the largest bucket within budget, stays there, and follows load changes both ways.
+// Deferred shading against the fused march: the same shapes at the same points with the same weights, so every pixel,
+// depth and per-pixel cost must come out identical, for plain blending, tile lists, top-K and the material heatmap.
+static bool RunDeferredShadingBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+
+	out_report += Stringf("\nDeferred shading: %dx%d, march + G-buffer, then shading sorted into %d material-set bins, against the fused march\n",
+		config.m_resolution.x, config.m_resolution.y, SDF_SHADE_BINS);
+	out_report += "   shapes | variant  | fused ms  | deferred ms | march ms  | shade ms  | hit px | bins | overflow px | max color error | max depth error | cost diffs\n";
+
+	struct Variant
+	{
+		char const* m_name;
+		int m_useTileBinning;
+		int m_useTopKMaterials;
+		int m_debugInt;
+	};
+	Variant const variants[] =
+	{
+		{ "full", 0, 0, 0 },
+		{ "tiles", 1, 0, 0 },
+		{ "top-k", 0, 1, 0 },
+		{ "heatmap", 0, 0, SDF_COST_HEATMAP_MATERIAL_EVALUATIONS },
+	};
+
+	for (int numShapes : config.m_deferredShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		for (Variant const& variant : variants)
+		{
+			SdfRayMarchingConstants fusedConstants;
+			fusedConstants.useTileBinning = variant.m_useTileBinning;
+			fusedConstants.useTopKMaterials = variant.m_useTopKMaterials;
+			SdfCpuRayMarcher fusedMarcher;
+			fusedMarcher.SetScene(shapes, fusedConstants);
+			fusedMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+			fusedMarcher.SetDebugInt(variant.m_debugInt);
+			SdfCpuImage fusedImage;
+			SdfCpuFrameStats fusedStats = RenderBestOf(fusedMarcher, view, config, jobPool, fusedImage);
+
+			SdfRayMarchingConstants deferredConstants = fusedConstants;
+			deferredConstants.useDeferredShading = 1;
+			SdfCpuRayMarcher deferredMarcher;
+			deferredMarcher.SetScene(shapes, deferredConstants, &fusedMarcher.GetBvh());
+			deferredMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+			deferredMarcher.SetDebugInt(variant.m_debugInt);
+
+			SdfCpuImage deferredImage;
+			SdfCpuFrameStats deferredStats;
+			SdfDeferredShadingStats deferredPasses;
+			for (int frame = 0; frame < config.m_numFrames; ++frame)
+			{
+				SdfDeferredShadingStats passes;
+				SdfCpuFrameStats stats = deferredMarcher.RenderFrame(view, config.m_resolution, deferredImage, &jobPool, &passes);
+				if (frame == 0 || stats.m_milliseconds < deferredStats.m_milliseconds)
+				{
+					deferredStats = stats;
+					deferredPasses = passes;
+				}
+			}
+
+			SdfImageDiff diff = CompareSdfImages(deferredImage, fusedImage, 0.f, 0.f);
+			int numCostDiffs = 0;
+			for (size_t pixelIndex = 0; pixelIndex < fusedImage.m_colors.size(); ++pixelIndex)
+			{
+				bool isSameCost = (deferredImage.m_stepCounts[pixelIndex] == fusedImage.m_stepCounts[pixelIndex]);
+				isSameCost &= (deferredImage.m_sdfMapCounts[pixelIndex] == fusedImage.m_sdfMapCounts[pixelIndex]);
+				isSameCost &= (deferredImage.m_materialCounts[pixelIndex] == fusedImage.m_materialCounts[pixelIndex]);
+				numCostDiffs += isSameCost ? 0 : 1;
+			}
+			bool isMatch = (diff.m_maxColorError == 0.f && diff.m_maxDepthError == 0.f && numCostDiffs == 0);
+			succeeded &= isMatch;
+
+			out_report += Stringf("  %7d | %-8s | %9.3f | %11.3f | %9.3f | %9.3f | %6d | %4d | %11d | %15.0f | %15.2g | %d %s\n", numShapes, variant.m_name,
+				fusedStats.m_milliseconds, deferredStats.m_milliseconds, deferredPasses.m_marchStats.m_milliseconds, deferredPasses.m_shadeStats.m_milliseconds,
+				deferredPasses.m_shadeStats.m_numRays, deferredPasses.m_numShadeBinsUsed, deferredPasses.m_numOverflowPixels,
+				diff.m_maxColorError, diff.m_maxDepthError, numCostDiffs, isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int CSG_POINT_BUDGET = 4000000; // node evaluations per tree walk sweep
+static constexpr float CSG_VALUE_TOLERANCE = 1e-3f; // baked transforms round differently than the walk
+
+// About numNodes nodes, spatially coherent like a modelled scene: unions split their region in two along its longest
+// axis, subtractions and intersections cut a smaller box of theirs, and every tenth node or so is a transform.
+static int MakeSdfBenchmarkCsgNode(SdfCsgTree& tree, int numNodes, Vec3 const& regionMin, Vec3 const& regionMax, uint32_t& state)
+{
+	Vec3 extents = regionMax - regionMin;
+	Vec3 center = (regionMin + regionMax) * 0.5f;
+	float roll = NextRandomFloatInRange(state, 0.f, 1.f);
+	if (numNodes >= 2 && roll < 0.1f)
+	{
+		// Rotate and scale about the region center, so the subtree stays where it was put
+		Vec3 axis(NextRandomFloatInRange(state, -1.f, 1.f), NextRandomFloatInRange(state, -1.f, 1.f), NextRandomFloatInRange(state, -1.f, 1.f));
+		float degrees = NextRandomFloatInRange(state, 0.f, 360.f);
+		float scale = NextRandomFloatInRange(state, 0.8f, 1.2f);
+		SdfCsgTransform toLocal;
+		toLocal.m_translation = -center;
+		int child = tree.AddTransform(MakeSdfBenchmarkCsgNode(tree, numNodes - 1, regionMin, regionMax, state), toLocal);
+		return tree.AddTransform(child, SdfCsgTransform::MakeFromAxisAngle(axis + Vec3(0.f, 0.f, 0.01f), degrees, center, scale));
+	}
+	if (numNodes < 3)
+	{
+		float size = 0.5f * std::min(extents.x, std::min(extents.y, extents.z));
+		Vec3 position(NextRandomFloatInRange(state, regionMin.x, regionMax.x), NextRandomFloatInRange(state, regionMin.y, regionMax.y),
+			NextRandomFloatInRange(state, regionMin.z, regionMax.z));
+		position = (position + center) * 0.5f;
+		if (NextRandomFloatInRange(state, 0.f, 1.f) < 0.7f)
+		{
+			return tree.AddSphere(position, NextRandomFloatInRange(state, 0.5f, 1.f) * size);
+		}
+		return tree.AddBox(position, Vec3(NextRandomFloatInRange(state, 0.3f, 1.f), NextRandomFloatInRange(state, 0.3f, 1.f), NextRandomFloatInRange(state, 0.3f, 1.f)) * size);
+	}
+
+	int numChildNodes = numNodes - 1;
+	int numNodesA = std::clamp((int)((float)numChildNodes * NextRandomFloatInRange(state, 0.3f, 0.7f)), 1, numChildNodes - 1);
+	float opRoll = NextRandomFloatInRange(state, 0.f, 1.f);
+	if (opRoll < 0.7f)
+	{
+		Vec3 splitMax = regionMax;
+		Vec3 splitMin = regionMin;
+		if (extents.x >= extents.y && extents.x >= extents.z)
+		{
+			splitMax.x = splitMin.x = center.x;
+		}
+		else if (extents.y >= extents.z)
+		{
+			splitMax.y = splitMin.y = center.y;
+		}
+		else
+		{
+			splitMax.z = splitMin.z = center.z;
+		}
+		int childA = MakeSdfBenchmarkCsgNode(tree, numNodesA, regionMin, splitMax, state);
+		int childB = MakeSdfBenchmarkCsgNode(tree, numChildNodes - numNodesA, splitMin, regionMax, state);
+		return (opRoll < 0.35f) ? tree.AddUnion(childA, childB) : tree.AddSmoothUnion(childA, childB, NextRandomFloatInRange(state, 0.05f, 0.3f));
+	}
+	// The cut lands anywhere in the region, sometimes clear of what it cuts, which the compiler folds away
+	Vec3 cutCenter = center + Vec3(NextRandomFloatInRange(state, -0.4f, 0.4f) * extents.x, NextRandomFloatInRange(state, -0.4f, 0.4f) * extents.y,
+		NextRandomFloatInRange(state, -0.4f, 0.4f) * extents.z);
+	int childA = MakeSdfBenchmarkCsgNode(tree, numNodesA, regionMin, regionMax, state);
+	int childB = MakeSdfBenchmarkCsgNode(tree, numChildNodes - numNodesA, cutCenter - extents * 0.2f, cutCenter + extents * 0.2f, state);
+	return (opRoll < 0.9f) ? tree.AddSubtraction(childA, childB) : tree.AddIntersection(childA, childB);
+}
+
+// Interpreter throughput of the compiled program against walking the tree, per stage of the compiler
+// Deferred frames at a shading rate of 2 and 4 against shading every hit. The depths must not change, and every pixel
+// must be the same to the bit as shaded per pixel, or as the first pixel of its block (itself always shaded per pixel)
+static bool RunShadingRateBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_shadingRateShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	SdfRayMarchingConstants defaultConstants;
+	out_report += Stringf("\nShading rate: deferred, one shading per block on a smooth surface (depth step <= %.3f relative, normal dot >= %.2f), against every hit shaded\n",
+		defaultConstants.shadingDepthTolerance, defaultConstants.shadingNormalThreshold);
+	out_report += "   shapes | rate | hit px | shaded px | reused | materials saved | shade ms (1x1) | frame ms (1x1)    | mean color error | max color error | px over 2 | contents\n";
+
+	for (int numShapes : config.m_shadingRateShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+
+		SdfRayMarchingConstants pixelConstants;
+		pixelConstants.useDeferredShading = 1;
+		SdfCpuRayMarcher pixelMarcher;
+		pixelMarcher.SetScene(shapes, pixelConstants);
+		pixelMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+		SdfCpuImage pixelImage;
+		SdfDeferredShadingStats pixelPasses;
+		SdfCpuFrameStats pixelStats = pixelMarcher.RenderFrame(view, config.m_resolution, pixelImage, &jobPool, &pixelPasses);
+
+		for (int shadingRate = 2; shadingRate <= SDF_SHADING_RATE_MAX; shadingRate *= 2)
+		{
+			SdfRayMarchingConstants coarseConstants = pixelConstants;
+			coarseConstants.shadingRate = shadingRate;
+			SdfCpuRayMarcher coarseMarcher;
+			coarseMarcher.SetScene(shapes, coarseConstants, &pixelMarcher.GetBvh());
+			coarseMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+			SdfCpuImage coarseImage;
+			SdfCpuFrameStats coarseStats;
+			SdfDeferredShadingStats coarsePasses;
+			for (int frame = 0; frame < config.m_numFrames; ++frame)
+			{
+				SdfDeferredShadingStats passes;
+				SdfCpuFrameStats stats = coarseMarcher.RenderFrame(view, config.m_resolution, coarseImage, &jobPool, &passes);
+				if (frame == 0 || stats.m_milliseconds < coarseStats.m_milliseconds)
+				{
+					coarseStats = stats;
+					coarsePasses = passes;
+				}
+			}
+
+			SdfImageDiff diff = CompareSdfImages(coarseImage, pixelImage);
+			int numCopied = 0;
+			int numWrongPixels = 0;
+			for (int y = 0; y < config.m_resolution.y; ++y)
+			{
+				for (int x = 0; x < config.m_resolution.x; ++x)
+				{
+					int pixelIndex = y * config.m_resolution.x + x;
+					int anchorIndex = (y / shadingRate) * shadingRate * config.m_resolution.x + (x / shadingRate) * shadingRate;
+					if (coarseImage.m_colors[pixelIndex] == pixelImage.m_colors[pixelIndex])
+					{
+						continue;
+					}
+					bool isCopied = (coarseImage.m_colors[pixelIndex] == pixelImage.m_colors[anchorIndex]);
+					++(isCopied ? numCopied : numWrongPixels);
+				}
+			}
+			int numHits = pixelPasses.m_shadeStats.m_numRays;
+			bool isMatch = (diff.m_maxDepthError == 0.f) && (numWrongPixels == 0) && (numCopied <= coarsePasses.m_numReusedPixels);
+			isMatch &= (coarsePasses.m_shadeStats.m_numRays + coarsePasses.m_numReusedPixels == numHits);
+			succeeded &= isMatch;
+
+			int64_t pixelMaterials = pixelStats.m_counters.m_numMaterialEvaluations;
+			int64_t coarseMaterials = coarseStats.m_counters.m_numMaterialEvaluations;
+			out_report += Stringf("  %7d | %dx%d  | %6d | %9d | %5.1f%% | %14.1f%% | %6.3f (%6.3f) | %8.3f (%8.3f) | %16.2f | %15.0f | %9d | %s\n", numShapes,
+				shadingRate, shadingRate, numHits, coarsePasses.m_shadeStats.m_numRays, (numHits > 0) ? 100.0 * coarsePasses.m_numReusedPixels / numHits : 0.0,
+				(pixelMaterials > 0) ? 100.0 * (double)(pixelMaterials - coarseMaterials) / (double)pixelMaterials : 0.0,
+				coarsePasses.m_shadeStats.m_milliseconds, pixelPasses.m_shadeStats.m_milliseconds, coarseStats.m_milliseconds, pixelStats.m_milliseconds,
+				diff.m_meanColorError, diff.m_maxColorError, diff.m_numPixelsOverTolerance, isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+static bool RunCsgBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	bool succeeded = true;
+	if (config.m_csgNodeCounts.empty())
+	{
+		return succeeded;
+	}
+
+	out_report += "\nCSG programs: random trees in the activity box, one thread, points spread over the box\n";
+	out_report += "    nodes | variant         | instructions | skips | stack | compile ms | Mpoints/s | ops/point | skips/point | max value diff | sign diffs\n";
+
+	SdfCsgCompileOptions rawOptions;
+	rawOptions.m_foldConstants = false;
+	rawOptions.m_useBoundPruning = false;
+	SdfCsgCompileOptions foldedOptions;
+	foldedOptions.m_useBoundPruning = false;
+	SdfCsgCompileOptions prunedOptions;
+
+	for (int numNodes : config.m_csgNodeCounts)
+	{
+		SdfCsgTree tree;
+		uint32_t state = 1234u + (uint32_t)numNodes;
+		Vec3 boxMax(ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+		int root = MakeSdfBenchmarkCsgNode(tree, std::max(numNodes, 1), -boxMax, boxMax, state);
+
+		int numPoints = std::clamp(CSG_POINT_BUDGET / std::max(numNodes, 1), 256, 16384);
+		std::vector<Vec3> points(numPoints);
+		for (Vec3& point : points)
+		{
+			point = Vec3(NextRandomFloatInRange(state, -1.2f, 1.2f), NextRandomFloatInRange(state, -1.2f, 1.2f), NextRandomFloatInRange(state, -1.2f, 1.2f)) * ACTIVITY_BOX_RADIUS;
+		}
+
+		// Tree walk, the reference for every program
+		std::vector<float> treeValues(numPoints);
+		auto walkStartTime = std::chrono::steady_clock::now();
+		for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+		{
+			treeValues[pointIndex] = tree.Evaluate(root, points[pointIndex]);
+		}
+		double walkMilliseconds = GetMillisecondsSince(walkStartTime);
+		out_report += Stringf("  %7d | %-15s | %12s | %5s | %5s | %10s | %9.3f | %9d | %11s | %14s | %s\n", numNodes, "tree walk", "-", "-", "-", "-",
+			(double)numPoints / (walkMilliseconds * 1000.0), tree.GetNumNodes(), "-", "-", "-");
+
+		struct Variant { char const* m_name; SdfCsgCompileOptions const* m_options; };
+		Variant const variants[] =
+		{
+			{ "program", &rawOptions },
+			{ "folded", &foldedOptions },
+			{ "folded + pruned", &prunedOptions },
+		};
+		std::vector<float> foldedValues;
+		for (Variant const& variant : variants)
+		{
+			SdfCsgProgram program;
+			auto compileStartTime = std::chrono::steady_clock::now();
+			bool isCompiled = CompileSdfCsg(tree, root, *variant.m_options, program);
+			double compileMilliseconds = GetMillisecondsSince(compileStartTime);
+			if (!isCompiled)
+			{
+				out_report += Stringf("  %7d | %-15s | stack over %d, not compiled FAILED\n", numNodes, variant.m_name, SDF_CSG_STACK_SIZE);
+				succeeded = false;
+				continue;
+			}
+
+			std::vector<float> values(numPoints);
+			SdfCsgCounters counters;
+			auto runStartTime = std::chrono::steady_clock::now();
+			for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+			{
+				values[pointIndex] = EvaluateSdfCsgProgram(program.m_instructions, points[pointIndex], &counters);
+			}
+			double runMilliseconds = GetMillisecondsSince(runStartTime);
+
+			// The raw program only bakes the transforms: same values up to rounding. Folding keeps the signs, and pruning
+			// must give back exactly what the folded program does.
+			bool isPruned = variant.m_options->m_useBoundPruning;
+			bool isFolded = variant.m_options->m_foldConstants;
+			float maxValueDiff = 0.f;
+			int numSignDiffs = 0;
+			for (int pointIndex = 0; pointIndex < numPoints; ++pointIndex)
+			{
+				float reference = isPruned ? foldedValues[pointIndex] : treeValues[pointIndex];
+				maxValueDiff = std::max(maxValueDiff, fabsf(values[pointIndex] - reference));
+				bool isClearOfSurface = fabsf(treeValues[pointIndex]) > CSG_VALUE_TOLERANCE;
+				numSignDiffs += (isClearOfSurface && ((values[pointIndex] < 0.f) != (treeValues[pointIndex] < 0.f))) ? 1 : 0;
+			}
+			bool isMatch = (numSignDiffs == 0) && (isPruned ? (maxValueDiff == 0.f) : (isFolded || maxValueDiff <= CSG_VALUE_TOLERANCE));
+			succeeded &= isMatch;
+			if (isFolded && !isPruned)
+			{
+				foldedValues = values;
+			}
+
+			out_report += Stringf("  %7d | %-15s | %12d | %5d | %5d | %10.3f | %9.3f | %9.1f | %11.1f | %14.3g | %d %s\n", numNodes, variant.m_name,
+				program.GetNumInstructions(), program.m_numSkipInstructions, program.m_maxStackDepth, compileMilliseconds,
+				(double)numPoints / (runMilliseconds * 1000.0), (double)counters.m_numInstructions / (double)numPoints,
+				(double)counters.m_numSkips / (double)numPoints, maxValueDiff, numSignDiffs, isMatch ? "ok" : "FAILED");
+		}
+	}
+
+	// The blended spheres as a program: a chain of smooth unions in stream order does what SdfMapAll does, to the bit.
+	// Both sides take tetrahedron normals, the program has no gradient.
+	SdfCpuView view = MakeSdfBenchmarkView(config.m_resolution);
+	std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(128, 1234u);
+	SdfRayMarchingConstants blendConstants;
+	blendConstants.useBvh = 0;
+	blendConstants.useAnalyticNormals = 0;
+	SdfCpuRayMarcher blendMarcher;
+	blendMarcher.SetScene(shapes, blendConstants);
+	blendMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+	SdfCpuImage blendImage;
+	SdfCpuFrameStats blendStats = RenderBestOf(blendMarcher, view, config, jobPool, blendImage);
+
+	SdfCsgTree chainTree;
+	int chain = chainTree.AddSphere(Vec3(shapes[0].m_data0.x, shapes[0].m_data0.y, shapes[0].m_data0.z), shapes[0].m_data0.w);
+	for (size_t shapeIndex = 1; shapeIndex < shapes.size(); ++shapeIndex)
+	{
+		Vec4 const& geometry = shapes[shapeIndex].m_data0;
+		chain = chainTree.AddSmoothUnion(chain, chainTree.AddSphere(Vec3(geometry.x, geometry.y, geometry.z), geometry.w), blendConstants.toleranceK);
+	}
+	SdfCsgProgram chainProgram;
+	CompileSdfCsg(chainTree, chain, SdfCsgCompileOptions(), chainProgram);
+	SdfRayMarchingConstants csgConstants = blendConstants;
+	csgConstants.useCsgProgram = 1;
+	csgConstants.numCsgInstructions = chainProgram.GetNumInstructions();
+	SdfCpuRayMarcher csgMarcher;
+	csgMarcher.SetScene(shapes, csgConstants);
+	csgMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+	csgMarcher.SetCsgProgram(&chainProgram);
+	SdfCpuImage csgImage;
+	SdfCpuFrameStats csgStats = RenderBestOf(csgMarcher, view, config, jobPool, csgImage);
+
+	SdfImageDiff diff = CompareSdfImages(csgImage, blendImage, 0.f, 0.f);
+	bool isMatch = (diff.m_maxColorError == 0.f && diff.m_maxDepthError == 0.f);
+	succeeded &= isMatch;
+	out_report += Stringf("  128 blended spheres as a program, %dx%d: blend %.3f ms, program %.3f ms (%d instructions); max color error %.0f, max depth error %g %s\n",
+		config.m_resolution.x, config.m_resolution.y, blendStats.m_milliseconds, csgStats.m_milliseconds, chainProgram.GetNumInstructions(),
+		diff.m_maxColorError, diff.m_maxDepthError, isMatch ? "ok" : "FAILED");
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int SIMULATION_NUM_FRAMES = 20;
+static constexpr float SIMULATION_DELTA_SECONDS = 0.1f; // coarse, so a good share of the shapes bounce during the run
+
+// GameRayMarching's spheres before SdfShapeSimulation: an object per sphere behind a pointer
+struct SdfLegacySphere
+{
+	Vec3 m_position;
+	Vec3 m_velocity;
+	Rgba8 m_color = Rgba8::OPAQUE_WHITE;
+	uint16_t m_materialID = 0;
+	float m_radius = 0.f;
+};
+
+// The old GameRayMarching::UpdateShapes, then the SdfShape copy and repack of UpdateRayMarching
+static float UpdateLegacySpheres(std::vector<SdfLegacySphere*> const& spheres, float deltaSeconds, std::vector<SdfShape>& frameShapes, SdfShapeStreams& streams)
+{
+	float maxShapeMove = 0.f;
+	for (SdfLegacySphere const* sphere : spheres)
+	{
+		maxShapeMove = std::max(maxShapeMove, sphere->m_velocity.GetLength() * deltaSeconds);
+	}
+	for (SdfLegacySphere* sphere : spheres)
+	{
+		float* position[3] = { &sphere->m_position.x, &sphere->m_position.y, &sphere->m_position.z };
+		float* velocity[3] = { &sphere->m_velocity.x, &sphere->m_velocity.y, &sphere->m_velocity.z };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			*position[axis] += deltaSeconds * *velocity[axis];
+			if (*position[axis] > ACTIVITY_BOX_RADIUS)
+			{
+				*position[axis] = ACTIVITY_BOX_RADIUS;
+				if (*velocity[axis] > 0.f)
+				{
+					*velocity[axis] *= -1.f;
+				}
+			}
+			if (*position[axis] < -ACTIVITY_BOX_RADIUS)
+			{
+				*position[axis] = -ACTIVITY_BOX_RADIUS;
+				if (*velocity[axis] < 0.f)
+				{
+					*velocity[axis] *= -1.f;
+				}
+			}
+		}
+	}
+
+	frameShapes.clear();
+	for (SdfLegacySphere const* sphere : spheres)
+	{
+		frameShapes.push_back(SdfShape::MakeSphere(sphere->m_position, sphere->m_radius, sphere->m_color, sphere->m_materialID));
+	}
+	streams.SetShapes(frameShapes);
+	return maxShapeMove;
+}
+
+// Per frame: move every shape and write the shape streams the renderer uploads
+static bool RunShapeSimulationBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_simulationShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	out_report += Stringf("\nShape simulation: %d frames of %.2f s, move + bounce + shape streams, SIMD width %d, %d threads\n", SIMULATION_NUM_FRAMES,
+		SIMULATION_DELTA_SECONDS, SDF_SIMD_WIDTH, jobPool.GetNumThreads());
+	out_report += "   shapes | layout                        | ms/frame | Mshapes/s | speedup | streams\n";
+
+	for (int numShapes : config.m_simulationShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		uint32_t state = 4321u;
+		std::vector<Vec3> velocities(numShapes);
+		for (Vec3& velocity : velocities)
+		{
+			velocity = Vec3(NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED),
+				NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED));
+		}
+
+		// Before: the reference every other layout must match bit for bit
+		std::vector<SdfLegacySphere*> legacySpheres;
+		for (int i = 0; i < numShapes; ++i)
+		{
+			SdfLegacySphere* sphere = new SdfLegacySphere();
+			sphere->m_position = Vec3(shapes[i].m_data0.x, shapes[i].m_data0.y, shapes[i].m_data0.z);
+			sphere->m_velocity = velocities[i];
+			sphere->m_radius = shapes[i].m_data0.w;
+			sphere->m_color = shapes[i].m_color;
+			legacySpheres.push_back(sphere);
+		}
+		std::vector<SdfShape> frameShapes;
+		SdfShapeStreams legacyStreams;
+		float legacyMaxMove = 0.f;
+		auto startTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < SIMULATION_NUM_FRAMES; ++frame)
+		{
+			legacyMaxMove = std::max(legacyMaxMove, UpdateLegacySpheres(legacySpheres, SIMULATION_DELTA_SECONDS, frameShapes, legacyStreams));
+		}
+		double legacyMilliseconds = GetMillisecondsSince(startTime) / SIMULATION_NUM_FRAMES;
+		for (SdfLegacySphere* sphere : legacySpheres)
+		{
+			delete sphere;
+		}
+		out_report += Stringf("  %7d | %-29s | %8.3f | %9.1f | %6.1fx | reference\n", numShapes, "pointers + SdfShape (before)", legacyMilliseconds,
+			(double)numShapes / (legacyMilliseconds * 1e3), 1.0);
+
+		struct Variant { char const* m_name; bool m_isParallel; bool m_isHalfPrecision; bool m_writeStreams; };
+		static constexpr Variant VARIANTS[] = {
+			{ "SoA SIMD, 1 thread", false, false, true },
+			{ "SoA SIMD, job pool", true, false, true },
+			{ "SoA SIMD, job pool, float16", true, true, true },
+			{ "SoA SIMD, job pool, move only", true, false, false },
+		};
+		for (Variant const& variant : VARIANTS)
+		{
+			SdfShapeSimulation simulation;
+			simulation.Reserve(numShapes);
+			for (int i = 0; i < numShapes; ++i)
+			{
+				Vec3 center(shapes[i].m_data0.x, shapes[i].m_data0.y, shapes[i].m_data0.z);
+				simulation.AddSphere(center, velocities[i], shapes[i].m_data0.w, shapes[i].m_color, shapes[i].m_materialID);
+			}
+
+			// The materials only go to the streams on the first frame, like in GameRayMarching
+			SdfShapeStreams streams;
+			float maxMove = 0.f;
+			startTime = std::chrono::steady_clock::now();
+			for (int frame = 0; frame < SIMULATION_NUM_FRAMES; ++frame)
+			{
+				maxMove = std::max(maxMove, simulation.Update(SIMULATION_DELTA_SECONDS, variant.m_isParallel ? &jobPool : nullptr, variant.m_writeStreams ? &streams : nullptr,
+					variant.m_isHalfPrecision, frame == 0));
+			}
+			double milliseconds = GetMillisecondsSince(startTime) / SIMULATION_NUM_FRAMES;
+			if (!variant.m_writeStreams)
+			{
+				simulation.Update(0.f, nullptr, &streams);
+			}
+
+			// Same operations in the same order, so the streams are identical; the max move only differs by the sqrt rounding
+			bool isMatch = (streams.GetNumShapes() == numShapes);
+			isMatch = isMatch && (memcmp(streams.m_geometry.data(), legacyStreams.m_geometry.data(), numShapes * sizeof(SdfShapeGeometry)) == 0);
+			isMatch = isMatch && (memcmp(streams.m_shapeMaterials.data(), legacyStreams.m_shapeMaterials.data(), numShapes * sizeof(SdfShapeMaterial)) == 0);
+			if (variant.m_isHalfPrecision)
+			{
+				isMatch = isMatch && (memcmp(streams.m_geometryHalf.data(), legacyStreams.m_geometryHalf.data(), numShapes * sizeof(SdfShapeGeometryHalf)) == 0);
+			}
+			isMatch = isMatch && (fabsf(maxMove - legacyMaxMove) <= 1e-5f * legacyMaxMove);
+			succeeded &= isMatch;
+
+			out_report += Stringf("  %7d | %-29s | %8.3f | %9.1f | %6.1fx | %s\n", numShapes, variant.m_name, milliseconds, (double)numShapes / (milliseconds * 1e3),
+				legacyMilliseconds / milliseconds, isMatch ? "ok" : "FAILED");
+		}
+	}
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int COLLISION_NUM_FRAMES = 10;
+static constexpr float COLLISION_DELTA_SECONDS = 1.f / 30.f;
+static constexpr int COLLISION_CROWD_SHAPES = 16; // radii shrink with the count, to keep the crowding of this many full-size spheres
+static constexpr int COLLISION_NUM_SAMPLES = 1000; // shapes whose contacts are checked against every other shape
+static constexpr int GRID_NUM_QUERY_POINTS = 256;
+
+// Broadphase build, collision step, thread-count independence, and the grid as an SDF query structure
+static bool RunCollisionBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_collisionShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+	float toleranceK = SdfRayMarchingConstants().toleranceK;
+
+	out_report += Stringf("\nSphere collisions: spatial grid broadphase, %d frames of %.3f s, radii scaled to the crowding of %d full-size spheres\n",
+		COLLISION_NUM_FRAMES, COLLISION_DELTA_SECONDS, COLLISION_CROWD_SHAPES);
+	out_report += "   shapes | radius scale |  cells | build ms | walls ms/frame | collide ms/frame | contacts first/last | sample pairs | 1 thread = pool\n";
+	std::string queryReport = Stringf("  grid SDF queries after the last frame (refit, %d random points, k = %.2f) against every shape in grid order\n", GRID_NUM_QUERY_POINTS, toleranceK);
+	queryReport += "   shapes | max drift | grid ns/query | brute ns/query | shapes/query | max error\n";
+
+	for (int numShapes : config.m_collisionShapeCounts)
+	{
+		float radiusScale = std::min(1.f, cbrtf((float)COLLISION_CROWD_SHAPES / (float)numShapes));
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		uint32_t state = 4321u;
+		std::vector<Vec3> velocities(numShapes);
+		for (Vec3& velocity : velocities)
+		{
+			velocity = Vec3(NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED),
+				NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED));
+		}
+		auto makeSimulation = [&](SdfShapeSimulation& out_simulation, bool isCollisionEnabled)
+		{
+			out_simulation.Reserve(numShapes);
+			for (int i = 0; i < numShapes; ++i)
+			{
+				Vec3 center(shapes[i].m_data0.x, shapes[i].m_data0.y, shapes[i].m_data0.z);
+				out_simulation.AddSphere(center, velocities[i], shapes[i].m_data0.w * radiusScale, shapes[i].m_color);
+			}
+			out_simulation.SetCollisionEnabled(isCollisionEnabled);
+		};
+
+		// Broadphase alone, over the starting positions
+		std::vector<float> positionX(numShapes);
+		std::vector<float> positionY(numShapes);
+		std::vector<float> positionZ(numShapes);
+		std::vector<float> radii(numShapes);
+		for (int i = 0; i < numShapes; ++i)
+		{
+			positionX[i] = shapes[i].m_data0.x;
+			positionY[i] = shapes[i].m_data0.y;
+			positionZ[i] = shapes[i].m_data0.z;
+			radii[i] = shapes[i].m_data0.w * radiusScale;
+		}
+		SdfSpatialGrid grid;
+		double buildMilliseconds = DBL_MAX;
+		for (int repeat = 0; repeat < COLLISION_NUM_FRAMES; ++repeat)
+		{
+			auto startTime = std::chrono::steady_clock::now();
+			grid.Build(positionX.data(), positionY.data(), positionZ.data(), radii.data(), numShapes, 0.f, &jobPool);
+			buildMilliseconds = std::min(buildMilliseconds, GetMillisecondsSince(startTime));
+		}
+
+		// Every overlap of the sampled shapes must be among the grid's candidates
+		bool isMatch = true;
+		int numSamplePairs = 0;
+		int sampleStride = std::max(numShapes / COLLISION_NUM_SAMPLES, 1);
+		for (int i = 0; i < numShapes; i += sampleStride)
+		{
+			Vec3 center(positionX[i], positionY[i], positionZ[i]);
+			int numBruteContacts = 0;
+			for (int j = 0; j < numShapes; ++j)
+			{
+				float contactDistance = radii[i] + radii[j];
+				if (j != i && (Vec3(positionX[j], positionY[j], positionZ[j]) - center).GetLengthSquared() < contactDistance * contactDistance)
+				{
+					++numBruteContacts;
+				}
+			}
+			int numGridContacts = 0;
+			grid.ForEachCandidate(center, radii[i], [&](uint32_t slot)
+			{
+				Vec4 const& other = grid.GetSortedGeometry()[slot];
+				float contactDistance = radii[i] + other.w;
+				if ((int)grid.GetShapeOrder()[slot] != i && (Vec3(other.x, other.y, other.z) - center).GetLengthSquared() < contactDistance * contactDistance)
+				{
+					++numGridContacts;
+				}
+			});
+			isMatch &= (numGridContacts == numBruteContacts);
+			numSamplePairs += numBruteContacts;
+		}
+
+		// Walls only against collisions, then the same run on the calling thread alone must end in the same bytes
+		SdfShapeSimulation wallSimulation;
+		makeSimulation(wallSimulation, false);
+		SdfShapeStreams wallStreams;
+		auto startTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < COLLISION_NUM_FRAMES; ++frame)
+		{
+			wallSimulation.Update(COLLISION_DELTA_SECONDS, &jobPool, &wallStreams, false, frame == 0);
+		}
+		double wallMilliseconds = GetMillisecondsSince(startTime) / COLLISION_NUM_FRAMES;
+
+		SdfShapeSimulation simulation;
+		makeSimulation(simulation, true);
+		SdfShapeStreams streams;
+		int firstContacts = 0;
+		float maxMove = 0.f;
+		startTime = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < COLLISION_NUM_FRAMES; ++frame)
+		{
+			maxMove = std::max(maxMove, simulation.Update(COLLISION_DELTA_SECONDS, &jobPool, &streams, false, frame == 0));
+			firstContacts = (frame == 0) ? simulation.GetNumContacts() : firstContacts;
+		}
+		double collisionMilliseconds = GetMillisecondsSince(startTime) / COLLISION_NUM_FRAMES;
+
+		SdfShapeSimulation serialSimulation;
+		makeSimulation(serialSimulation, true);
+		SdfShapeStreams serialStreams;
+		float serialMaxMove = 0.f;
+		for (int frame = 0; frame < COLLISION_NUM_FRAMES; ++frame)
+		{
+			serialMaxMove = std::max(serialMaxMove, serialSimulation.Update(COLLISION_DELTA_SECONDS, nullptr, &serialStreams, false, frame == 0));
+		}
+		bool isDeterministic = (memcmp(streams.m_geometry.data(), serialStreams.m_geometry.data(), numShapes * sizeof(SdfShapeGeometry)) == 0)
+			&& (simulation.GetNumContacts() == serialSimulation.GetNumContacts()) && (maxMove == serialMaxMove);
+		isMatch &= isDeterministic;
+		succeeded &= isMatch;
+
+		out_report += Stringf("  %7d | %12.3f | %6d | %8.3f | %14.3f | %16.3f | %9d/%-9d | %12d | %s\n", numShapes, radiusScale, grid.GetNumCells(), buildMilliseconds,
+			wallMilliseconds, collisionMilliseconds, firstContacts, simulation.GetNumContacts(), numSamplePairs, isMatch ? "ok" : "FAILED");
+
+		// The refit grid of the last frame as an SDF query structure, against the plain loop over the same shape order
+		SdfSpatialGrid const& frameGrid = simulation.GetGrid();
+		std::vector<Vec4> const& sortedGeometry = frameGrid.GetSortedGeometry();
+		std::vector<Vec3> points;
+		for (SdfShape const& shape : MakeSdfBenchmarkShapes(GRID_NUM_QUERY_POINTS, 99u))
+		{
+			points.push_back(Vec3(shape.m_data0.x, shape.m_data0.y, shape.m_data0.z));
+		}
+		std::vector<float> gridValues(points.size());
+		int numShapesVisited = 0;
+		startTime = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			gridValues[i] = frameGrid.SdfMap(points[i], toleranceK, &numShapesVisited);
+		}
+		double gridNanoseconds = GetMillisecondsSince(startTime) * 1e6 / (double)points.size();
+
+		float maxError = 0.f;
+		startTime = std::chrono::steady_clock::now();
+		for (size_t i = 0; i < points.size(); ++i)
+		{
+			float res = SDF_INFINITY_DIST;
+			for (Vec4 const& geometry : sortedGeometry)
+			{
+				res = SminCubic(res, SdfValueFromGeometry(points[i], geometry), toleranceK);
+			}
+			maxError = std::max(maxError, fabsf(res - gridValues[i]));
+		}
+		double bruteNanoseconds = GetMillisecondsSince(startTime) * 1e6 / (double)points.size();
+
+		// smin is not associative: a shape the final value ignores may still have blended in before the closer ones came
+		// up in the loop, and shifted the blends after it. That is less than one blend deep, k / 6.
+		bool isQueryMatch = (maxError <= toleranceK / 6.f);
+		succeeded &= isQueryMatch;
+		queryReport += Stringf("  %7d | %9.4f | %13.0f | %14.0f | %12.1f | %9.2e %s\n", numShapes, frameGrid.GetMaxDrift(), gridNanoseconds, bruteNanoseconds,
+			(double)numShapesVisited / (double)points.size(), maxError, isQueryMatch ? "ok" : "FAILED");
+	}
+	out_report += queryReport;
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+// The renderer side of SdfUploadRing as plain memory: copies exactly the ranges, and flags any write out of a buffer.
+// Also counts what SdfRendererUploadDevice sends for the same ranges: UpdateBuffer has no offset, so the game writes
+// the prefix up to the end of the last range.
+class SdfMockUploadDevice : public SdfUploadDevice
+{
+public:
+	void CreateSlotBuffer(int slot, size_t stride, int numElements) override
+	{
+		m_slotData[slot].assign(stride * numElements, 0xCD); // not zero, so a block that is never written shows
+	}
+
+	void DestroySlotBuffer(int slot) override
+	{
+		m_slotData[slot].clear();
+	}
+
+	size_t WriteSlotBuffer(int slot, void const* data, size_t numBytes, std::vector<SdfUploadRange> const& ranges) override
+	{
+		size_t numBytesWritten = 0;
+		for (SdfUploadRange const& range : ranges)
+		{
+			size_t rangeEnd = range.m_byteOffset + range.m_numBytes;
+			if (rangeEnd > numBytes || rangeEnd > m_slotData[slot].size())
+			{
+				m_isOutOfBounds = true;
+				continue;
+			}
+			memcpy(m_slotData[slot].data() + range.m_byteOffset, (uint8_t const*)data + range.m_byteOffset, range.m_numBytes);
+			numBytesWritten += range.m_numBytes;
+		}
+		if (!ranges.empty())
+		{
+			m_numPrefixBytes += ranges.back().m_byteOffset + ranges.back().m_numBytes;
+		}
+		return numBytesWritten;
+	}
+
+public:
+	std::vector<uint8_t> m_slotData[SDF_UPLOAD_RING_SLOTS];
+	bool m_isOutOfBounds = false;
+	uint64_t m_numPrefixBytes = 0; // what the game's device would have sent
+};
+
+
+struct SdfUploadFrame
+{
+	void const* m_data = nullptr;
+	int m_numElements = 0;
+	size_t m_stride = 0;
+};
+
+
+static constexpr int UPLOAD_NUM_FRAMES = 60;
+static constexpr float UPLOAD_MOVED_FRACTION = 0.01f;
+
+// Spawning, sparse and full moves, a precision switch and static materials, through the ring on a mock device.
+// Every frame the slot must hold exactly that frame's data, and must not be one of the frames still in flight.
+static bool RunUploadRingBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_uploadShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	out_report += Stringf("\nUpload ring: %d slots, %d byte blocks, %d frames per scenario, against one exact-size buffer uploaded whole every frame\n",
+		SDF_UPLOAD_RING_SLOTS, (int)SDF_UPLOAD_BLOCK_BYTES, UPLOAD_NUM_FRAMES);
+	out_report += "  MB uploaded: the ranges alone, and the prefix up to the last range that the game's device writes (UpdateBuffer has no offset)\n";
+	out_report += "  scenario          |  shapes | allocations (exact) | MB requested | MB uploaded ranges | MB uploaded prefix (game) | ranges/frame | ms/frame | contents\n";
+
+	auto runScenario = [&](char const* name, int numShapes, std::function<SdfUploadFrame(int frame)> const& makeFrame)
+	{
+		SdfMockUploadDevice device;
+		SdfUploadRing ring;
+		int exactAllocations = 0;
+		int exactCapacity = 0;
+		size_t exactStride = 0;
+		bool isMatch = true;
+		int lastSlot = -1;
+		double uploadMilliseconds = 0.0;
+		for (int frame = 0; frame < UPLOAD_NUM_FRAMES; ++frame)
+		{
+			SdfUploadFrame uploadFrame = makeFrame(frame);
+			if (uploadFrame.m_numElements > exactCapacity || uploadFrame.m_stride != exactStride)
+			{
+				++exactAllocations;
+				exactCapacity = uploadFrame.m_numElements;
+				exactStride = uploadFrame.m_stride;
+			}
+
+			auto startTime = std::chrono::steady_clock::now();
+			ring.SetDevice(&device, uploadFrame.m_stride);
+			int slot = ring.Upload(uploadFrame.m_data, uploadFrame.m_numElements);
+			uploadMilliseconds += GetMillisecondsSince(startTime);
+
+			size_t numBytes = uploadFrame.m_numElements * uploadFrame.m_stride;
+			isMatch &= (slot != lastSlot) && (device.m_slotData[slot].size() >= numBytes) && (memcmp(device.m_slotData[slot].data(), uploadFrame.m_data, numBytes) == 0);
+			lastSlot = slot;
+		}
+		isMatch &= !device.m_isOutOfBounds;
+		succeeded &= isMatch;
+		ring.Shutdown();
+
+		SdfUploadCounters const& counters = ring.GetCounters();
+		out_report += Stringf("  %-17s | %7d | %7d (%9d) | %12.3f | %18.3f | %25.3f | %12.1f | %8.3f | %s\n", name, numShapes, counters.m_numAllocations, exactAllocations,
+			(double)counters.m_numBytesRequested / (1024.0 * 1024.0), (double)counters.m_numBytesUploaded / (1024.0 * 1024.0),
+			(double)device.m_numPrefixBytes / (1024.0 * 1024.0), (double)counters.m_numRanges / UPLOAD_NUM_FRAMES, uploadMilliseconds / UPLOAD_NUM_FRAMES, isMatch ? "ok" : "FAILED");
+	};
+
+	for (int numShapes : config.m_uploadShapeCounts)
+	{
+		SdfShapeStreams startStreams;
+		startStreams.SetShapes(MakeSdfBenchmarkShapes(numShapes + UPLOAD_NUM_FRAMES, 1234u));
+		std::vector<SdfShapeGeometry> allGeometry = startStreams.m_geometry;
+		startStreams.m_geometry.resize(numShapes);
+		startStreams.m_shapeMaterials.resize(numShapes);
+
+		// One shape more every frame, the way SpawnSphere adds them
+		std::vector<SdfShapeGeometry> geometry;
+		runScenario("spawn 1 per frame", numShapes, [&](int frame)
+		{
+			geometry.assign(allGeometry.begin(), allGeometry.begin() + numShapes + frame + 1);
+			return SdfUploadFrame{ geometry.data(), (int)geometry.size(), sizeof(SdfShapeGeometry) };
+		});
+
+		// A few shapes move, scattered over the buffer
+		geometry = startStreams.m_geometry;
+		uint32_t state = 4321u;
+		runScenario("move 1%", numShapes, [&](int frame)
+		{
+			int numMoved = std::max((int)(UPLOAD_MOVED_FRACTION * (float)numShapes), 1);
+			for (int moved = 0; moved < numMoved; ++moved)
+			{
+				int shapeIndex = std::min((int)NextRandomFloatInRange(state, 0.f, (float)numShapes), numShapes - 1);
+				geometry[shapeIndex].m_data0.x += (frame & 1) ? 0.01f : -0.01f;
+			}
+			return SdfUploadFrame{ geometry.data(), numShapes, sizeof(SdfShapeGeometry) };
+		});
+
+		// Every shape moves, and halfway through the game switches to float16 geometry
+		for (int pass = 0; pass < 2; ++pass)
+		{
+			SdfShapeSimulation simulation;
+			state = 4321u;
+			for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+			{
+				Vec4 const& data0 = startStreams.m_geometry[shapeIndex].m_data0;
+				Vec3 velocity(NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED),
+					NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED));
+				simulation.AddSphere(Vec3(data0.x, data0.y, data0.z), velocity, data0.w);
+			}
+			SdfShapeStreams streams;
+			bool isPrecisionSwitch = (pass == 1);
+			runScenario(isPrecisionSwitch ? "move all, to half" : "move all", numShapes, [&](int frame)
+			{
+				bool isHalf = isPrecisionSwitch && (frame >= UPLOAD_NUM_FRAMES / 2);
+				simulation.Update(1.f / 60.f, &jobPool, &streams, isHalf);
+				return SdfUploadFrame{ streams.GetGeometryData(isHalf), numShapes, SdfShapeStreams::GetGeometryStride(isHalf) };
+			});
+		}
+
+		// The material stream only changes with spawns, its upload should stop once every slot has it
+		runScenario("static materials", numShapes, [&](int frame)
+		{
+			UNUSED(frame);
+			return SdfUploadFrame{ startStreams.m_shapeMaterials.data(), numShapes, sizeof(SdfShapeMaterial) };
+		});
+	}
+	return succeeded;
+}
+
+// Every tile listed once, occupied ones first in row order, and dispatch arguments covering each part of the list
+static bool IsTileListValid(SdfTileClassification const& classification)
+{
+	IntVec2 numTiles = classification.GetNumTiles();
+	std::vector<uint32_t> const& tileList = classification.GetTileList();
+	if ((int)tileList.size() != numTiles.x * numTiles.y)
+	{
+		return false;
+	}
+	std::vector<uint8_t> isListed(tileList.size(), 0);
+	int lastIndex[2] = { -1, -1 };
+	for (int slot = 0; slot < (int)tileList.size(); ++slot)
+	{
+		IntVec2 tileCoords = SdfTileClassification::UnpackTileCoords(tileList[slot]);
+		if (tileCoords.x >= numTiles.x || tileCoords.y >= numTiles.y)
+		{
+			return false;
+		}
+		int tileIndex = tileCoords.y * numTiles.x + tileCoords.x;
+		bool isOccupiedSlot = (slot < classification.GetNumOccupiedTiles());
+		if (isListed[tileIndex] || classification.IsTileOccupied(tileCoords) != isOccupiedSlot || tileIndex <= lastIndex[isOccupiedSlot])
+		{
+			return false;
+		}
+		isListed[tileIndex] = 1;
+		lastIndex[isOccupiedSlot] = tileIndex;
+	}
+
+	SdfDispatchArguments arguments[2] = { classification.GetMarchArguments(), classification.GetFillArguments() };
+	int numListed[2] = { classification.GetNumOccupiedTiles(), classification.GetNumBackgroundTiles() };
+	for (int part = 0; part < 2; ++part)
+	{
+		int numGroups = (int)(arguments[part].m_threadGroupCountX * arguments[part].m_threadGroupCountY * arguments[part].m_threadGroupCountZ);
+		if (numGroups < numListed[part] || numGroups >= numListed[part] + SDF_TILE_LIST_ROW_GROUPS)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// The march over the occupied tiles plus the fill of the others against marching every tile. A background tile is
+// one no ray of which can hit, so the two images must be the same to the bit, fused and deferred.
+static bool RunTileClassificationBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_classificationShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	// Dispatch sizing, up to a 16K screen
+	bool areArgumentsValid = true;
+	for (int numListedTiles : { 0, 1, SDF_TILE_LIST_ROW_GROUPS, SDF_TILE_LIST_ROW_GROUPS + 1, 2048 * 1024 })
+	{
+		SdfDispatchArguments arguments = SdfTileClassification::GetListArguments(numListedTiles);
+		int numGroups = (int)(arguments.m_threadGroupCountX * arguments.m_threadGroupCountY);
+		areArgumentsValid &= (numGroups >= numListedTiles) && (numGroups < numListedTiles + SDF_TILE_LIST_ROW_GROUPS);
+		areArgumentsValid &= (arguments.m_threadGroupCountX <= 65535) && (arguments.m_threadGroupCountY <= 65535) && (arguments.m_threadGroupCountZ == 1);
+	}
+	succeeded &= areArgumentsValid;
+
+	SdfRayMarchingConstants allConstants;
+	SdfRayMarchingConstants classifiedConstants = allConstants;
+	classifiedConstants.useTileClassification = 1;
+
+	SdfCpuView outsideView = MakeSdfBenchmarkView(config.m_resolution);
+	SdfCpuView insideView = outsideView;
+	insideView.m_position = Vec3(0.5f, -0.5f, 0.25f);
+	insideView.m_forward = Vec3(1.f, 1.f, 0.f).GetNormalized();
+	insideView.m_left = Vec3(-1.f, 1.f, 0.f).GetNormalized();
+
+	IntVec2 numTiles = IntVec2((config.m_resolution.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE, (config.m_resolution.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE);
+	out_report += Stringf("\nTile classification (%dx%d tiles, spheres inflated by 6k + minHitDistance + %.2f, dispatch rows of %d groups: %s)\n",
+		numTiles.x, numTiles.y, SDF_TILE_BINNING_MARGIN, SDF_TILE_LIST_ROW_GROUPS, areArgumentsValid ? "ok" : "FAILED");
+	out_report += "   shapes | view    | pass     | skipped | classify ms | ms classified | ms all    | sdf evals/ray classified | sdf evals/ray all | max color error | max depth error | contents\n";
+
+	for (int numShapes : config.m_classificationShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		for (int viewIndex = 0; viewIndex < 2; ++viewIndex)
+		{
+			SdfCpuView const& view = (viewIndex == 0) ? outsideView : insideView;
+			for (int pass = 0; pass < 2; ++pass)
+			{
+				allConstants.useDeferredShading = pass;
+				classifiedConstants.useDeferredShading = pass;
+				SdfCpuRayMarcher classifiedMarcher;
+				classifiedMarcher.SetScene(shapes, classifiedConstants);
+				classifiedMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+				SdfCpuRayMarcher allMarcher;
+				allMarcher.SetScene(shapes, allConstants);
+				allMarcher.SetLightConstants(MakeSdfBenchmarkLightConstants());
+
+				// The marcher classifies the stream order it marches, the BVH leaf order
+				SdfTileClassification classification;
+				auto classifyStart = std::chrono::steady_clock::now();
+				classification.Classify(view, config.m_resolution, classifiedMarcher.GetShapeStreams(), classifiedMarcher.IsHalfPrecisionGeometry(), classifiedConstants);
+				double classifyMilliseconds = GetMillisecondsSince(classifyStart);
+				bool isMatch = IsTileListValid(classification);
+
+				SdfCpuImage classifiedImage;
+				SdfCpuImage allImage;
+				SdfCpuFrameStats classifiedStats = RenderBestOf(classifiedMarcher, view, config, jobPool, classifiedImage);
+				SdfCpuFrameStats allStats = RenderBestOf(allMarcher, view, config, jobPool, allImage);
+
+				SdfImageDiff diff = CompareSdfImages(classifiedImage, allImage, 0.f, 0.f);
+				isMatch &= (diff.m_numPixelsOverTolerance == 0) && (classifiedImage.m_colors == allImage.m_colors);
+				succeeded &= isMatch;
+
+				double numRays = (double)allStats.m_numRays;
+				out_report += Stringf("  %7d | %-7s | %-8s | %6.1f%% | %11.3f | %13.3f | %9.3f | %24.1f | %17.1f | %15.0f | %15.2g | %s\n", numShapes,
+					(viewIndex == 0) ? "outside" : "inside", (pass == 0) ? "fused" : "deferred", 100.0 * classification.GetSkippedFraction(), classifyMilliseconds,
+					classifiedStats.m_milliseconds, allStats.m_milliseconds,
+					(double)classifiedStats.m_counters.m_numSdfEvaluations / numRays, (double)allStats.m_counters.m_numSdfEvaluations / numRays,
+					diff.m_maxColorError, diff.m_maxDepthError, isMatch ? "ok" : "FAILED");
+			}
+		}
+	}
+	return succeeded;
+}
+
+static bool AreSdfMeshesEqual(SdfChunkMesher const& a, SdfChunkMesher const& b)
+{
+	std::vector<SdfMeshChunk> const& chunksA = a.GetChunks();
+	std::vector<SdfMeshChunk> const& chunksB = b.GetChunks();
+	if (chunksA.size() != chunksB.size())
+	{
+		return false;
+	}
+	for (size_t chunkIndex = 0; chunkIndex < chunksA.size(); ++chunkIndex)
+	{
+		SdfMeshChunk const& chunkA = chunksA[chunkIndex];
+		SdfMeshChunk const& chunkB = chunksB[chunkIndex];
+		if (chunkA.m_indices != chunkB.m_indices || chunkA.m_vertices.size() != chunkB.m_vertices.size())
+		{
+			return false;
+		}
+		if (!chunkA.m_vertices.empty() && memcmp(chunkA.m_vertices.data(), chunkB.m_vertices.data(), chunkA.m_vertices.size() * sizeof(SdfMeshVertex)) != 0)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+// Welds the chunk meshes by exact position and counts the edges a->b not matched by as many b->a: zero for a closed,
+// consistently wound surface, cracks along the chunk seams would show up here
+static int CountUnmatchedMeshEdges(SdfChunkMesher const& mesher)
+{
+	std::map<std::array<uint32_t, 3>, int> weldedVertices;
+	std::map<std::pair<int, int>, int> directedEdges;
+	for (SdfMeshChunk const& chunk : mesher.GetChunks())
+	{
+		std::vector<int> welded(chunk.m_vertices.size());
+		for (size_t vertexIndex = 0; vertexIndex < chunk.m_vertices.size(); ++vertexIndex)
+		{
+			std::array<uint32_t, 3> key;
+			memcpy(key.data(), &chunk.m_vertices[vertexIndex].m_position, sizeof(key));
+			welded[vertexIndex] = weldedVertices.emplace(key, (int)weldedVertices.size()).first->second;
+		}
+		for (size_t i = 0; i + 2 < chunk.m_indices.size(); i += 3)
+		{
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				int from = welded[chunk.m_indices[i + corner]];
+				int to = welded[chunk.m_indices[i + (corner + 1) % 3]];
+				if (from != to)
+				{
+					++directedEdges[std::make_pair(from, to)];
+				}
+			}
+		}
+	}
+	int numUnmatched = 0;
+	for (auto const& edge : directedEdges)
+	{
+		auto reverse = directedEdges.find(std::make_pair(edge.first.second, edge.first.first));
+		if (reverse == directedEdges.end() || reverse->second != edge.second)
+		{
+			++numUnmatched;
+		}
+	}
+	return numUnmatched;
+}
+
+// Surface nets over the chunked grid: a full mesh on one thread and on the job pool, then frames moving 1, 10% and all
+// of the shapes, where only the chunks they touch are resampled and re-meshed. Both full meshes and the incremental one
+// must equal a rebuild chunk for chunk, the welded mesh must be closed and consistently wound, and the vertices lie
+// within a cell of the surface of the exact field (every shape, index order).
+static bool RunChunkMesherBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_meshShapeCounts.empty())
+	{
+		return true;
+	}
+	static constexpr int NUM_MOVE_FRAMES = 8;
+	static constexpr float MOVE_DELTA_SECONDS = 1.f / 60.f;
+	static constexpr float MOVING_FRACTIONS[] = { 0.f, 0.1f, 1.f }; // 0: a single shape
+	bool succeeded = true;
+
+	SdfRayMarchingConstants constants;
+	float toleranceK = constants.toleranceK;
+
+	out_report += Stringf("\nChunked surface nets (cells of %.3f, chunks of %d^3 cells, %d threads)\n", SDF_MESH_CELL_SIZE, SDF_MESH_CHUNK_CELLS, jobPool.GetNumThreads());
+	out_report += "   shapes | chunks | triangles | vertices | ms 1 thread | ms pool   | chunks/s pool | Mtris/s pool | max field error | mean field error | unmatched edges\n";
+	std::string frameReport = "  frames   shapes | moving | sampled/frame | meshed/frame | ms/frame | chunks/s | Mtris/s | matches rebuild\n";
+
+	for (int numShapes : config.m_meshShapeCounts)
+	{
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		std::vector<Vec4> geometry(numShapes);
+		for (int i = 0; i < numShapes; ++i)
+		{
+			geometry[i] = shapes[i].m_data0;
+		}
+
+		SdfChunkMesher serialMesher;
+		serialMesher.Update(geometry, toleranceK, nullptr);
+		SdfMesherStats serialStats = serialMesher.GetStats();
+		SdfChunkMesher mesher;
+		mesher.Update(geometry, toleranceK, &jobPool);
+		SdfMesherStats stats = mesher.GetStats();
+		double serialMilliseconds = serialStats.m_sampleMilliseconds + serialStats.m_meshMilliseconds;
+		double poolMilliseconds = stats.m_sampleMilliseconds + stats.m_meshMilliseconds;
+
+		float maxFieldError = 0.f;
+		double fieldErrorSum = 0.0;
+		for (SdfMeshChunk const& chunk : mesher.GetChunks())
+		{
+			for (SdfMeshVertex const& vertex : chunk.m_vertices)
+			{
+				float res = SDF_INFINITY_DIST;
+				for (Vec4 const& shapeGeometry : geometry)
+				{
+					res = SminCubic(res, SdfValueFromGeometry(vertex.m_position, shapeGeometry), toleranceK);
+				}
+				maxFieldError = fmaxf(maxFieldError, fabsf(res));
+				fieldErrorSum += fabsf(res);
+			}
+		}
+		int numUnmatchedEdges = CountUnmatchedMeshEdges(mesher);
+		bool isValid = AreSdfMeshesEqual(mesher, serialMesher) && (numUnmatchedEdges == 0) && (maxFieldError <= SDF_MESH_CELL_SIZE) && (stats.m_numTriangles > 0);
+		succeeded &= isValid;
+
+		out_report += Stringf("  %7d | %6d | %9d | %8d | %11.2f | %9.2f | %13.0f | %12.2f | %15.4f | %16.4f | %d %s\n", numShapes, stats.m_numChunks,
+			stats.m_numTriangles, stats.m_numVertices, serialMilliseconds, poolMilliseconds, 1000.0 * stats.m_numMeshedChunks / poolMilliseconds,
+			1e-3 * stats.m_numMeshedTriangles / poolMilliseconds, maxFieldError, fieldErrorSum / std::max(stats.m_numVertices, 1), numUnmatchedEdges,
+			isValid ? "ok" : "FAILED");
+
+		for (float movingFraction : MOVING_FRACTIONS)
+		{
+			SdfChunkMesher incrementalMesher = mesher;
+			std::vector<Vec4> movedGeometry = geometry;
+			uint32_t state = 99u;
+			int numMoving = std::max((int)ceilf(movingFraction * (float)numShapes), 1);
+			std::vector<Vec3> velocities;
+			for (int i = 0; i < numMoving; ++i)
+			{
+				velocities.push_back(Vec3(NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED),
+					NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED), NextRandomFloatInRange(state, -MAX_OBJECT_SPEED, MAX_OBJECT_SPEED)));
+			}
+
+			double sampledSum = 0.0;
+			double meshedSum = 0.0;
+			double meshedTriangleSum = 0.0;
+			double milliseconds = 0.0;
+			for (int frame = 0; frame < NUM_MOVE_FRAMES; ++frame)
+			{
+				for (int i = 0; i < numMoving; ++i)
+				{
+					Vec4& shapeGeometry = movedGeometry[i];
+					shapeGeometry.x = GetClamped(shapeGeometry.x + velocities[i].x * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+					shapeGeometry.y = GetClamped(shapeGeometry.y + velocities[i].y * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+					shapeGeometry.z = GetClamped(shapeGeometry.z + velocities[i].z * MOVE_DELTA_SECONDS, -ACTIVITY_BOX_RADIUS, ACTIVITY_BOX_RADIUS);
+				}
+				incrementalMesher.Update(movedGeometry, toleranceK, &jobPool);
+				SdfMesherStats const& frameStats = incrementalMesher.GetStats();
+				sampledSum += frameStats.m_numSampledChunks;
+				meshedSum += frameStats.m_numMeshedChunks;
+				meshedTriangleSum += frameStats.m_numMeshedTriangles;
+				milliseconds += frameStats.m_sampleMilliseconds + frameStats.m_meshMilliseconds;
+			}
+
+			SdfChunkMesher rebuiltMesher;
+			rebuiltMesher.Update(movedGeometry, toleranceK, &jobPool);
+			bool isMatch = AreSdfMeshesEqual(incrementalMesher, rebuiltMesher);
+			succeeded &= isMatch;
+
+			frameReport += Stringf("          %7d | %6s | %13.1f | %12.1f | %8.2f | %8.0f | %7.2f | %s\n", numShapes,
+				(movingFraction == 0.f) ? "1" : Stringf("%.0f%%", movingFraction * 100.f).c_str(), sampledSum / NUM_MOVE_FRAMES, meshedSum / NUM_MOVE_FRAMES,
+				milliseconds / NUM_MOVE_FRAMES, 1000.0 * meshedSum / milliseconds, 1e-3 * meshedTriangleSum / milliseconds, isMatch ? "ok" : "FAILED");
+		}
+	}
+	out_report += frameReport;
+	return succeeded;
+}
+
+// The PBR / triplanar test model, sphere at (0, 0, 2) of radius 1 plus the box (2, 2, 0) to (3, 3, 1), as one closed
+// indexed mesh: a UV sphere of BAKE_SPHERE_SLICES x BAKE_SPHERE_STACKS and the box's 12 triangles
+static constexpr int BAKE_SPHERE_SLICES = 32;
+static constexpr int BAKE_SPHERE_STACKS = 16;
+static constexpr int BAKE_NUM_QUERY_POINTS = 2000;
+static constexpr int BAKE_MAX_WINDING_RESOLUTION = 64; // every triangle at every sample
+static constexpr int BAKE_NUM_CSG_POINTS = 20000;
+
+static void MakeSdfBenchmarkTestMesh(std::vector<Vec3>& out_positions, std::vector<unsigned int>& out_indices)
+{
+	const Vec3 sphereCenter(0.f, 0.f, 2.f);
+	out_positions.push_back(sphereCenter + Vec3(0.f, 0.f, 1.f));
+	for (int stack = 1; stack < BAKE_SPHERE_STACKS; ++stack)
+	{
+		float theta = 3.14159265f * (float)stack / (float)BAKE_SPHERE_STACKS;
+		for (int slice = 0; slice < BAKE_SPHERE_SLICES; ++slice)
+		{
+			float phi = 6.28318531f * (float)slice / (float)BAKE_SPHERE_SLICES;
+			out_positions.push_back(sphereCenter + Vec3(sinf(theta) * cosf(phi), sinf(theta) * sinf(phi), cosf(theta)));
+		}
+	}
+	out_positions.push_back(sphereCenter - Vec3(0.f, 0.f, 1.f));
+	auto ring = [](int stack, int slice) { return (unsigned int)(1 + (stack - 1) * BAKE_SPHERE_SLICES + slice % BAKE_SPHERE_SLICES); };
+	unsigned int bottom = (unsigned int)out_positions.size() - 1;
+	for (int slice = 0; slice < BAKE_SPHERE_SLICES; ++slice)
+	{
+		out_indices.insert(out_indices.end(), { 0u, ring(1, slice), ring(1, slice + 1) });
+		for (int stack = 1; stack + 1 < BAKE_SPHERE_STACKS; ++stack)
+		{
+			out_indices.insert(out_indices.end(), { ring(stack, slice), ring(stack + 1, slice), ring(stack + 1, slice + 1) });
+			out_indices.insert(out_indices.end(), { ring(stack, slice), ring(stack + 1, slice + 1), ring(stack, slice + 1) });
+		}
+		out_indices.insert(out_indices.end(), { ring(BAKE_SPHERE_STACKS - 1, slice), bottom, ring(BAKE_SPHERE_STACKS - 1, slice + 1) });
+	}
+
+	// Corner i has x from bit 0, y from bit 1, z from bit 2
+	unsigned int first = (unsigned int)out_positions.size();
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		out_positions.push_back(Vec3((corner & 1) ? 3.f : 2.f, (corner & 2) ? 3.f : 2.f, (corner & 4) ? 1.f : 0.f));
+	}
+	static constexpr unsigned int BOX_QUADS[6][4] = { { 0, 2, 3, 1 }, { 4, 5, 7, 6 }, { 0, 1, 5, 4 }, { 2, 6, 7, 3 }, { 0, 4, 6, 2 }, { 1, 3, 7, 5 } };
+	for (auto const& quad : BOX_QUADS)
+	{
+		out_indices.insert(out_indices.end(), { first + quad[0], first + quad[1], first + quad[2], first + quad[0], first + quad[2], first + quad[3] });
+	}
+}
+
+static float GetSdfBenchmarkTestModelDistance(Vec3 const& p)
+{
+	Vec3 q = Vec3(fabsf(p.x - 2.5f), fabsf(p.y - 2.5f), fabsf(p.z - 0.5f)) - Vec3(0.5f, 0.5f, 0.5f);
+	float box = Vec3(std::max(q.x, 0.f), std::max(q.y, 0.f), std::max(q.z, 0.f)).GetLength() + std::min(std::max(q.x, std::max(q.y, q.z)), 0.f);
+	return std::min((p - Vec3(0.f, 0.f, 2.f)).GetLength() - 1.f, box);
+}
+
+// Mesh-to-SDF bakes of the test model at each resolution: exact distances on one thread and on the job pool, jump
+// flooding on the pool, and the winding number sign at the smaller sizes. Checks: the BVH's closest triangle against
+// every triangle, one thread against the pool bit for bit, every exact sample against the analytic sphere and box
+// (within the sphere's faceting), jump flooding never below the exact distance and with the same sign, winding number
+// against ray parity signs, and the CSG program's GRID instruction against the tree's SdfBakedGrid::Sample.
+static bool RunMeshBakerBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_bakeResolutions.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	std::vector<Vec3> positions;
+	std::vector<unsigned int> indices;
+	MakeSdfBenchmarkTestMesh(positions, indices);
+	int numTriangles = (int)indices.size() / 3;
+	float facetingError = 1.f - cosf(3.14159265f / (float)BAKE_SPHERE_STACKS); // chord sag, the stacks are the coarser
+
+	// Closest triangle by the BVH against every triangle, the same distance function so they must be equal
+	SdfTriangleBvh bvh;
+	bvh.Build(positions, indices);
+	uint32_t state = 4321u;
+	int numBvhMismatches = 0;
+	int64_t numBvhTests = 0;
+	for (int pointIndex = 0; pointIndex < BAKE_NUM_QUERY_POINTS; ++pointIndex)
+	{
+		Vec3 p(NextRandomFloatInRange(state, -3.f, 5.f), NextRandomFloatInRange(state, -3.f, 5.f), NextRandomFloatInRange(state, -2.f, 5.f));
+		int triangle = -1;
+		float distance = bvh.FindClosestTriangle(p, triangle, FLT_MAX, &numBvhTests);
+		float bruteDistance = FLT_MAX;
+		for (int i = 0; i < numTriangles; ++i)
+		{
+			bruteDistance = std::min(bruteDistance, bvh.GetDistanceToTriangle(p, i));
+		}
+		numBvhMismatches += (triangle < 0 || distance != bruteDistance) ? 1 : 0;
+	}
+	succeeded &= (numBvhMismatches == 0);
+
+	out_report += Stringf("\nMesh-to-SDF bake (test model: %d triangles, %d BVH nodes, closest triangle against brute force: %d tests/query, %d mismatches %s; %d threads)\n",
+		numTriangles, (int)bvh.GetNodes().size(), (int)(numBvhTests / BAKE_NUM_QUERY_POINTS), numBvhMismatches, (numBvhMismatches == 0) ? "ok" : "FAILED",
+		jobPool.GetNumThreads());
+	out_report += "  resolution | samples   | ms 1 thread | ms pool  | tests/sample | ms pool JFA | tests/sample JFA | JFA exact | JFA max error | ms winding | sign diffs | max model error | contents\n";
+
+	for (int resolution : config.m_bakeResolutions)
+	{
+		SdfBakeOptions options;
+		options.m_resolution = resolution;
+		SdfBakedGrid serialGrid;
+		SdfBakeStats serialStats;
+		SdfBakedGrid grid;
+		SdfBakeStats stats;
+		bool isValid = BakeSdfMesh(positions, indices, options, nullptr, serialGrid, &serialStats);
+		isValid &= BakeSdfMesh(positions, indices, options, &jobPool, grid, &stats);
+		if (!isValid)
+		{
+			out_report += Stringf("  %10d | bake failed FAILED\n", resolution);
+			succeeded = false;
+			continue;
+		}
+		isValid &= (serialGrid.m_samples == grid.m_samples);
+
+		// Samples are exact distances to the facets, the analytic model differs by the faceting at most
+		float maxModelError = 0.f;
+		for (int z = 0; z < grid.m_numSamplesZ; ++z)
+		{
+			for (int y = 0; y < grid.m_numSamplesY; ++y)
+			{
+				for (int x = 0; x < grid.m_numSamplesX; ++x)
+				{
+					Vec3 p = grid.m_origin + Vec3((float)x, (float)y, (float)z) * grid.m_voxelSize;
+					maxModelError = std::max(maxModelError, fabsf(grid.GetSample(x, y, z) - GetSdfBenchmarkTestModelDistance(p)));
+				}
+			}
+		}
+		isValid &= (maxModelError <= facetingError + 1e-4f);
+
+		SdfBakeOptions jumpFloodOptions = options;
+		jumpFloodOptions.m_distanceMode = SdfBakeDistanceMode::JUMP_FLOOD;
+		SdfBakedGrid jumpFloodGrid;
+		SdfBakeStats jumpFloodStats;
+		isValid &= BakeSdfMesh(positions, indices, jumpFloodOptions, &jobPool, jumpFloodGrid, &jumpFloodStats);
+		int numExact = 0;
+		float maxJumpFloodError = 0.f;
+		bool isJumpFloodValid = (jumpFloodGrid.m_samples.size() == grid.m_samples.size());
+		for (size_t sampleIndex = 0; isJumpFloodValid && sampleIndex < grid.m_samples.size(); ++sampleIndex)
+		{
+			float exact = grid.m_samples[sampleIndex];
+			float flooded = jumpFloodGrid.m_samples[sampleIndex];
+			isJumpFloodValid &= ((exact < 0.f) == (flooded < 0.f)) && (fabsf(flooded) >= fabsf(exact)); // same sign pass
+			numExact += (flooded == exact) ? 1 : 0;
+			maxJumpFloodError = std::max(maxJumpFloodError, fabsf(flooded) - fabsf(exact));
+		}
+		isValid &= isJumpFloodValid;
+
+		std::string windingText = "-";
+		std::string signDiffText = "-";
+		if (resolution <= BAKE_MAX_WINDING_RESOLUTION)
+		{
+			SdfBakeOptions windingOptions = options;
+			windingOptions.m_signMode = SdfBakeSignMode::WINDING_NUMBER;
+			SdfBakedGrid windingGrid;
+			SdfBakeStats windingStats;
+			isValid &= BakeSdfMesh(positions, indices, windingOptions, &jobPool, windingGrid, &windingStats);
+			// Samples on a face, the box's are on grid planes, can take either sign
+			int numSignDiffs = 0;
+			for (size_t sampleIndex = 0; sampleIndex < grid.m_samples.size() && sampleIndex < windingGrid.m_samples.size(); ++sampleIndex)
+			{
+				bool isClearOfSurface = fabsf(grid.m_samples[sampleIndex]) > 1e-4f * grid.m_voxelSize;
+				numSignDiffs += (isClearOfSurface && (grid.m_samples[sampleIndex] < 0.f) != (windingGrid.m_samples[sampleIndex] < 0.f)) ? 1 : 0;
+			}
+			isValid &= (numSignDiffs == 0);
+			windingText = Stringf("%.2f", windingStats.m_signMilliseconds);
+			signDiffText = Stringf("%d", numSignDiffs);
+		}
+		succeeded &= isValid;
+
+		out_report += Stringf("  %10d | %9d | %11.2f | %8.2f | %12.1f | %11.2f | %16.1f | %8.1f%% | %13.4f | %10s | %10s | %15.4f | %s\n", resolution,
+			stats.m_numSamples, serialStats.m_totalMilliseconds, stats.m_totalMilliseconds, (double)stats.m_numTriangleTests / stats.m_numSamples,
+			jumpFloodStats.m_totalMilliseconds, (double)jumpFloodStats.m_numTriangleTests / stats.m_numSamples, 100.0 * numExact / stats.m_numSamples,
+			maxJumpFloodError, windingText.c_str(), signDiffText.c_str(), maxModelError, isValid ? "ok" : "FAILED");
+	}
+
+	// The first resolution's grid in a CSG program, twice under different transforms: one copy of the samples, and
+	// GRID instructions that match the tree walk
+	SdfBakeOptions csgOptions;
+	csgOptions.m_resolution = config.m_bakeResolutions[0];
+	SdfBakedGrid csgGrid;
+	BakeSdfMesh(positions, indices, csgOptions, &jobPool, csgGrid);
+	SdfCsgTree tree;
+	int model = tree.AddBakedGrid(&csgGrid, Vec3(-1.f, -1.f, -1.5f));
+	int turnedModel = tree.AddTransform(tree.AddBakedGrid(&csgGrid, Vec3(), 0.5f), SdfCsgTransform::MakeFromAxisAngle(Vec3(1.f, 2.f, 3.f), 40.f, Vec3(1.f, -2.f, 0.f), 1.5f));
+	int root = tree.AddSubtraction(tree.AddSmoothUnion(model, turnedModel, 0.25f), tree.AddSphere(Vec3(0.f, 0.f, 0.5f), 0.75f));
+	SdfCsgProgram program;
+	bool isCsgValid = CompileSdfCsg(tree, root, SdfCsgCompileOptions(), program) && (program.m_gridSamples.size() == csgGrid.m_samples.size());
+	float maxValueDiff = 0.f;
+	for (int pointIndex = 0; isCsgValid && pointIndex < BAKE_NUM_CSG_POINTS; ++pointIndex)
+	{
+		Vec3 p(NextRandomFloatInRange(state, -6.f, 6.f), NextRandomFloatInRange(state, -6.f, 6.f), NextRandomFloatInRange(state, -6.f, 6.f));
+		maxValueDiff = std::max(maxValueDiff, fabsf(EvaluateSdfCsgProgram(program.m_instructions, p, nullptr, &program.m_gridSamples) - tree.Evaluate(root, p)));
+	}
+	isCsgValid &= (maxValueDiff <= CSG_VALUE_TOLERANCE);
+	succeeded &= isCsgValid;
+	out_report += Stringf("  CSG program, the %d grid used twice: %d instructions, %d grid samples, max difference to the tree %.2g %s\n", csgOptions.m_resolution,
+		program.GetNumInstructions(), (int)program.m_gridSamples.size(), maxValueDiff, isCsgValid ? "ok" : "FAILED");
+	return succeeded;
+}
+
+// Blended spheres over the activity box as a dense grid, the volume the brick file benchmark encodes
+static constexpr int BRICK_FILE_NUM_SHAPES = 16;
+static constexpr int BRICK_FILE_LOAD_REPEATS = 3;
+static constexpr int BRICK_FILE_PATH_FRAMES = 60;
+static constexpr float BRICK_FILE_STREAM_RADIUS = 2.f;
+static constexpr int BRICK_FILE_STREAM_CAPACITY = 256; // small enough that the path evicts at the finer resolutions
+static constexpr int BRICK_FILE_STREAM_LOADS = 128; // per update
+static constexpr int BRICK_FILE_NUM_STREAM_POINTS = 2000;
+
+static void MakeSdfBenchmarkDenseGrid(int resolution, JobPool& jobPool, SdfBakedGrid& out_grid)
+{
+	std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(BRICK_FILE_NUM_SHAPES, 1234u);
+	float toleranceK = SdfRayMarchingConstants().toleranceK;
+	float halfExtent = ACTIVITY_BOX_RADIUS + 1.f;
+	out_grid.m_origin = Vec3(-halfExtent, -halfExtent, -halfExtent);
+	out_grid.m_voxelSize = 2.f * halfExtent / (float)(resolution - 1);
+	out_grid.m_numSamplesX = resolution;
+	out_grid.m_numSamplesY = resolution;
+	out_grid.m_numSamplesZ = resolution;
+	out_grid.m_samples.resize((size_t)resolution * resolution * resolution);
+	jobPool.ParallelFor(resolution, [&](int z)
+	{
+		for (int y = 0; y < resolution; ++y)
+		{
+			for (int x = 0; x < resolution; ++x)
+			{
+				Vec3 p = out_grid.m_origin + Vec3((float)x, (float)y, (float)z) * out_grid.m_voxelSize;
+				float res = SDF_INFINITY_DIST;
+				for (SdfShape const& shape : shapes)
+				{
+					res = SminCubic(res, SdfValueFromGeometry(p, shape.m_data0), toleranceK);
+				}
+				out_grid.m_samples[((size_t)z * resolution + y) * resolution + x] = res;
+			}
+		}
+	});
+}
+
+static bool ReadSdfBenchmarkFile(std::string const& filePath, void* out_data, size_t numBytes)
+{
+	FILE* file = fopen(filePath.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	size_t numRead = fread(out_data, 1, numBytes, file);
+	fclose(file);
+	return numRead == numBytes;
+}
+
+// Sparse narrow-band brick files of dense grids: encoded size against raw floats, every sample decoded within half its
+// brick's quantization step of the grid clamped to the band (and exactly +-band in the empty bricks), load times of
+// the raw floats against reading or mapping the brick file (warm file cache, best of BRICK_FILE_LOAD_REPEATS), and
+// the streamer along a camera path through the volume. After a last unbounded update every point within the radius
+// must sample from the pool exactly as from the file.
+static bool RunBrickFileBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_brickFileResolutions.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+	SdfBrickFileOptions options;
+
+	out_report += Stringf("\nSparse brick files (%d blended spheres, bricks of %d^3 voxels, band %.1f voxels, 8-bit samples, %d threads)\n", BRICK_FILE_NUM_SHAPES,
+		SDF_BRICK_SIZE, options.m_bandVoxels, jobPool.GetNumThreads());
+	out_report += "  resolution | stored bricks | raw MB   | file MB | ratio | encode ms | max error/step | violations | ms read raw | ms read file | ms map file | contents\n";
+	std::string streamReport = Stringf("  streaming, radius %.1f, %d slots, %d loads/update, %d frames through the volume:\n", BRICK_FILE_STREAM_RADIUS,
+		BRICK_FILE_STREAM_CAPACITY, BRICK_FILE_STREAM_LOADS, BRICK_FILE_PATH_FRAMES);
+	streamReport += "  resolution | wanted/frame | loads/frame | evictions/frame | KB/frame | max missing | resident | ms/update | pool matches file\n";
+
+	for (int resolution : config.m_brickFileResolutions)
+	{
+		SdfBakedGrid grid;
+		MakeSdfBenchmarkDenseGrid(resolution, jobPool, grid);
+		std::vector<uint8_t> bytes;
+		SdfBrickFileStats stats;
+		SdfBrickFileView view;
+		bool isValid = EncodeSdfBrickFile(grid, options, bytes, &stats) && view.Open(bytes.data(), bytes.size());
+		if (!isValid)
+		{
+			out_report += Stringf("  %10d | encode failed FAILED\n", resolution);
+			succeeded = false;
+			continue;
+		}
+
+		// Round trip at every sample, against the bound of the brick GetSample reads
+		SdfBrickFileHeader const& header = view.GetHeader();
+		float band = header.m_bandDistance;
+		int numViolations = 0;
+		float maxErrorPerStep = 0.f;
+		for (int z = 0; z < grid.m_numSamplesZ; ++z)
+		{
+			for (int y = 0; y < grid.m_numSamplesY; ++y)
+			{
+				for (int x = 0; x < grid.m_numSamplesX; ++x)
+				{
+					uint32_t entry = view.GetBrickEntry(view.GetBrickIndex(std::min(x / SDF_BRICK_SIZE, header.m_numBricksX - 1),
+						std::min(y / SDF_BRICK_SIZE, header.m_numBricksY - 1), std::min(z / SDF_BRICK_SIZE, header.m_numBricksZ - 1)));
+					float step = (entry < header.m_numStoredBricks) ? view.GetRecord(entry).m_step : 0.f;
+					float error = fabsf(view.GetSample(x, y, z) - GetClamped(grid.GetSample(x, y, z), -band, band));
+					numViolations += (error > 0.5f * step * 1.001f + 1e-6f * band) ? 1 : 0;
+					maxErrorPerStep = (step > 0.f) ? std::max(maxErrorPerStep, error / step) : maxErrorPerStep;
+				}
+			}
+		}
+		isValid &= (numViolations == 0);
+
+		// Load times: the raw floats and the brick file read whole, and the brick file mapped and opened in place
+		double rawMilliseconds = -1.0;
+		double readMilliseconds = -1.0;
+		double mapMilliseconds = -1.0;
+		if (!config.m_outputFolder.empty())
+		{
+			std::string rawPath = Stringf("%s/SdfBrickFile_%d.raw", config.m_outputFolder.c_str(), resolution);
+			std::string brickPath = Stringf("%s/SdfBrickFile_%d.sdfb", config.m_outputFolder.c_str(), resolution);
+			FILE* rawFile = fopen(rawPath.c_str(), "wb");
+			bool isWritten = rawFile && fwrite(grid.m_samples.data(), sizeof(float), grid.m_samples.size(), rawFile) == grid.m_samples.size();
+			if (rawFile)
+			{
+				fclose(rawFile);
+			}
+			isWritten &= WriteSdfBrickFile(brickPath, grid, options);
+			isValid &= isWritten;
+			for (int repeat = 0; isWritten && repeat < BRICK_FILE_LOAD_REPEATS; ++repeat)
+			{
+				auto rawStart = std::chrono::steady_clock::now();
+				std::vector<float> rawSamples(grid.m_samples.size());
+				isValid &= ReadSdfBenchmarkFile(rawPath, rawSamples.data(), rawSamples.size() * sizeof(float));
+				double milliseconds = GetMillisecondsSince(rawStart);
+				rawMilliseconds = (repeat == 0) ? milliseconds : std::min(rawMilliseconds, milliseconds);
+
+				auto readStart = std::chrono::steady_clock::now();
+				std::vector<uint8_t> readBytes(bytes.size());
+				SdfBrickFileView readView;
+				isValid &= ReadSdfBenchmarkFile(brickPath, readBytes.data(), readBytes.size()) && readView.Open(readBytes.data(), readBytes.size());
+				milliseconds = GetMillisecondsSince(readStart);
+				readMilliseconds = (repeat == 0) ? milliseconds : std::min(readMilliseconds, milliseconds);
+
+				auto mapStart = std::chrono::steady_clock::now();
+				SdfMappedFile mappedFile;
+				SdfBrickFileView mappedView;
+				isValid &= mappedFile.Open(brickPath) && mappedView.Open(mappedFile.GetData(), mappedFile.GetNumBytes());
+				milliseconds = GetMillisecondsSince(mapStart);
+				mapMilliseconds = (repeat == 0) ? milliseconds : std::min(mapMilliseconds, milliseconds);
+				isValid &= (mappedFile.GetNumBytes() == bytes.size()) && memcmp(mappedFile.GetData(), bytes.data(), bytes.size()) == 0;
+			}
+		}
+
+		// Streaming along the diagonal, then one unbounded update at the end
+		SdfBrickStreamer streamer;
+		streamer.Init(&view, BRICK_FILE_STREAM_CAPACITY);
+		Vec3 pathStart = grid.m_origin * 0.8f;
+		Vec3 pathEnd = grid.GetBoundsMax() * 0.8f;
+		double wantedSum = 0.0;
+		double loadedSum = 0.0;
+		double evictedSum = 0.0;
+		double loadedBytesSum = 0.0;
+		double streamMilliseconds = 0.0;
+		int maxMissing = 0;
+		for (int frame = 0; frame < BRICK_FILE_PATH_FRAMES; ++frame)
+		{
+			Vec3 position = pathStart + (pathEnd - pathStart) * ((float)frame / (float)(BRICK_FILE_PATH_FRAMES - 1));
+			streamer.Update(position, BRICK_FILE_STREAM_RADIUS, BRICK_FILE_STREAM_LOADS);
+			SdfBrickStreamerStats const& streamStats = streamer.GetStats();
+			wantedSum += streamStats.m_numWantedBricks;
+			loadedSum += streamStats.m_numLoadedBricks;
+			evictedSum += streamStats.m_numEvictedBricks;
+			loadedBytesSum += (double)streamStats.m_numLoadedBytes;
+			streamMilliseconds += streamStats.m_updateMilliseconds;
+			maxMissing = std::max(maxMissing, streamStats.m_numMissingBricks);
+		}
+		streamer.Update(pathEnd, BRICK_FILE_STREAM_RADIUS, BRICK_FILE_STREAM_CAPACITY);
+		bool isStreamMatch = (streamer.GetStats().m_numMissingBricks == 0);
+		uint32_t state = 777u;
+		for (int pointIndex = 0; isStreamMatch && pointIndex < BRICK_FILE_NUM_STREAM_POINTS; ++pointIndex)
+		{
+			Vec3 offset(NextRandomFloatInRange(state, -1.f, 1.f), NextRandomFloatInRange(state, -1.f, 1.f), NextRandomFloatInRange(state, -1.f, 1.f));
+			Vec3 p = pathEnd + offset * (BRICK_FILE_STREAM_RADIUS / sqrtf(3.f));
+			float streamedDistance = 0.f;
+			isStreamMatch &= streamer.TrySample(p, streamedDistance) && (streamedDistance == view.Sample(p));
+		}
+		isValid &= isStreamMatch;
+		succeeded &= isValid;
+
+		out_report += Stringf("  %10d | %6d/%6d | %8.2f | %7.2f | %4.1fx | %9.2f | %14.3f | %10d | %11.2f | %12.2f | %11.3f | %s\n", resolution, stats.m_numStoredBricks,
+			stats.m_numBricks, stats.m_numDenseBytes / (1024.0 * 1024.0), stats.m_numBytes / (1024.0 * 1024.0), (double)stats.m_numDenseBytes / stats.m_numBytes,
+			stats.m_encodeMilliseconds, maxErrorPerStep, numViolations, rawMilliseconds, readMilliseconds, mapMilliseconds, isValid ? "ok" : "FAILED");
+		streamReport += Stringf("  %10d | %12.1f | %11.1f | %15.1f | %8.1f | %11d | %8d | %9.3f | %s\n", resolution, wantedSum / BRICK_FILE_PATH_FRAMES,
+			loadedSum / BRICK_FILE_PATH_FRAMES, evictedSum / BRICK_FILE_PATH_FRAMES, loadedBytesSum / (1024.0 * BRICK_FILE_PATH_FRAMES), maxMissing, streamer.GetStats().m_numResidentBricks,
+			streamMilliseconds / BRICK_FILE_PATH_FRAMES, isStreamMatch ? "ok" : "FAILED");
+	}
+	out_report += streamReport;
+	return succeeded;
+}
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int QUERY_RAY_GRID_SIZE = 256; // rays from the benchmark camera, one per pixel
+static constexpr int QUERY_NUM_POINTS = 65536; // closest points and overlaps, random in the activity box
+static constexpr int QUERY_NUM_SHAPE_CHECKS = 1000; // hits whose nearest shape is checked against every shape
+static constexpr float QUERY_SHAPES_PER_BOX = 16.f; // the scene spreads out with the count, to keep this density
+// The lanes round like the scalar calls, bit for bit unless the compiler contracts the scalar math into FMAs. Those
+// ulps move a march by up to a hit distance, flip the odd grazing ray, and the finite difference normals by ~1e-3.
+static constexpr float QUERY_DISTANCE_TOLERANCE = 1e-5f; // relative, SdfMap at the query points
+static constexpr float QUERY_NORMAL_TOLERANCE = 1e-2f;
+static constexpr int QUERY_MAX_FLIPS_PER_MILLION = 1000;
+
+
+// FindClosestPoints one point at a time on the scalar calls, the taps of SdfNormalTetra
+static Vec3 ProjectSdfBenchmarkPoint(SdfCpuRayMarcher const& scene, Vec3 const& p, float& out_distance)
+{
+	constexpr float h = 0.0001f;
+	Vec3 const taps[4] = { Vec3(1.f, -1.f, -1.f), Vec3(-1.f, -1.f, 1.f), Vec3(-1.f, 1.f, -1.f), Vec3(1.f, 1.f, 1.f) };
+	float minHitDistance = scene.GetConstants().minHitDistance;
+	out_distance = scene.SdfMap(p);
+	Vec3 point = p;
+	float distance = out_distance;
+	for (int step = 0; step < SDF_QUERY_PROJECTION_STEPS && distance < SDF_INFINITY_DIST && fabsf(distance) >= minHitDistance; ++step)
+	{
+		Vec3 gradient = taps[0] * scene.SdfMap(point + taps[0] * h) + taps[1] * scene.SdfMap(point + taps[1] * h) + taps[2] * scene.SdfMap(point + taps[2] * h) +
+			taps[3] * scene.SdfMap(point + taps[3] * h);
+		point -= gradient.GetNormalized() * (distance / fmaxf(gradient.GetLength() / (4.f * h), SDF_QUERY_MIN_GRADIENT_LENGTH));
+		distance = scene.SdfMap(point);
+	}
+	return point;
+}
+
+static int FindSdfBenchmarkNearestShape(std::vector<SdfShape> const& shapes, Vec3 const& p, float& out_distance)
+{
+	int nearestShape = -1;
+	out_distance = SDF_INFINITY_DIST;
+	for (int shapeIndex = 0; shapeIndex < (int)shapes.size(); ++shapeIndex)
+	{
+		Vec4 const& geometry = shapes[shapeIndex].m_data0;
+		float distance = SdSphere(p, Vec3(geometry.x, geometry.y, geometry.z), geometry.w);
+		if (distance < out_distance)
+		{
+			out_distance = distance;
+			nearestShape = shapeIndex;
+		}
+	}
+	return nearestShape;
+}
+
+// Raycasts, closest points and overlaps: scalar calls one query at a time, then the batch on one thread and on the pool.
+// Every batched result is checked against its scalar call.
+static bool RunSceneQueryBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_queryShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	SdfCpuView view = MakeSdfBenchmarkView(IntVec2(QUERY_RAY_GRID_SIZE, QUERY_RAY_GRID_SIZE));
+	out_report += Stringf("\nBatched scene queries (%d-lane packets, jobs of %d, %d threads): %dx%d camera rays, %d closest points, %d sphere overlaps\n",
+		SDF_SIMD_WIDTH, SDF_QUERY_JOB_SIZE, jobPool.GetNumThreads(), QUERY_RAY_GRID_SIZE, QUERY_RAY_GRID_SIZE, QUERY_NUM_POINTS, QUERY_NUM_POINTS);
+	out_report += "   shapes | query   | Mq/s scalar | Mq/s batch | Mq/s pool | nodes/packet map | result | max |batch-scalar| | check\n";
+
+	for (int numShapes : config.m_queryShapeCounts)
+	{
+		float spread = cbrtf(fmaxf((float)numShapes / QUERY_SHAPES_PER_BOX, 1.f));
+		std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+		for (SdfShape& shape : shapes)
+		{
+			shape.m_data0.x *= spread;
+			shape.m_data0.y *= spread;
+			shape.m_data0.z *= spread;
+		}
+		SdfRayMarchingConstants constants;
+		SdfSceneQuery query;
+		auto setStart = std::chrono::steady_clock::now();
+		query.SetScene(shapes, constants);
+		double setMilliseconds = GetMillisecondsSince(setStart);
+		SdfCpuRayMarcher const& scene = query.GetScene();
+
+		auto addRow = [&](char const* queryName, double scalarMilliseconds, SdfSceneQueryStats const& batchStats, SdfSceneQueryStats const& poolStats,
+			std::string const& result, float maxError, bool isMatch)
+		{
+			succeeded &= isMatch;
+			double numQueries = (double)poolStats.m_numQueries;
+			out_report += Stringf("  %7d | %-7s | %11.3f | %10.3f | %9.3f | %16.1f | %s | %20g | %s\n", numShapes, queryName, numQueries / (scalarMilliseconds * 1000.0),
+				batchStats.GetQueriesPerSecond() * 1e-6, poolStats.GetQueriesPerSecond() * 1e-6, (double)poolStats.m_numNodesVisited / (double)poolStats.m_numPacketMaps,
+				result.c_str(), maxError, isMatch ? "ok" : "FAILED");
+		};
+
+		// Raycasts: RayMarch, its normal and the nearest shape
+		std::vector<SdfRayQuery> rays;
+		for (int y = 0; y < QUERY_RAY_GRID_SIZE; ++y)
+		{
+			for (int x = 0; x < QUERY_RAY_GRID_SIZE; ++x)
+			{
+				SdfRayQuery ray;
+				ray.m_origin = view.m_position * spread;
+				ray.m_direction = view.GetRayDirection(x, y, IntVec2(QUERY_RAY_GRID_SIZE, QUERY_RAY_GRID_SIZE));
+				rays.push_back(ray);
+			}
+		}
+		std::vector<SdfRayQueryHit> scalarHits(rays.size());
+		auto scalarStart = std::chrono::steady_clock::now();
+		for (size_t rayIndex = 0; rayIndex < rays.size(); ++rayIndex)
+		{
+			float distance = scene.RayMarch(rays[rayIndex].m_origin, rays[rayIndex].m_direction, nullptr, nullptr, 0.f, false).w;
+			if (distance < SDF_INFINITY_DIST)
+			{
+				SdfRayQueryHit& hit = scalarHits[rayIndex];
+				hit.m_distance = distance;
+				hit.m_position = rays[rayIndex].m_origin + rays[rayIndex].m_direction * distance;
+				hit.m_normal = scene.SdfNormalTetra(hit.m_position);
+				hit.m_shapeIndex = query.FindNearestShape(hit.m_position);
+			}
+		}
+		double scalarMilliseconds = GetMillisecondsSince(scalarStart);
+		std::vector<SdfRayQueryHit> hits;
+		SdfSceneQueryStats batchStats = query.Raycast(rays, hits, nullptr);
+		SdfSceneQueryStats poolStats = query.Raycast(rays, hits, &jobPool);
+
+		int numHits = 0;
+		int numHitMismatches = 0;
+		int numShapeMismatches = 0;
+		int numShapeChecks = 0;
+		float maxError = 0.f;
+		bool isMatch = true;
+		for (size_t rayIndex = 0; rayIndex < rays.size(); ++rayIndex)
+		{
+			SdfRayQueryHit const& hit = hits[rayIndex];
+			SdfRayQueryHit const& scalarHit = scalarHits[rayIndex];
+			if (hit.IsHit() != scalarHit.IsHit())
+			{
+				++numHitMismatches;
+				continue;
+			}
+			if (!hit.IsHit())
+			{
+				continue;
+			}
+			++numHits;
+			maxError = fmaxf(maxError, fabsf(hit.m_distance - scalarHit.m_distance));
+			isMatch &= (hit.m_normal - scalarHit.m_normal).GetLength() <= QUERY_NORMAL_TOLERANCE;
+			numShapeMismatches += (hit.m_shapeIndex != scalarHit.m_shapeIndex) ? 1 : 0;
+
+			// The BVH walk against every shape, ties aside
+			if (numShapeChecks < QUERY_NUM_SHAPE_CHECKS)
+			{
+				++numShapeChecks;
+				float nearestDistance = 0.f;
+				int nearestShape = FindSdfBenchmarkNearestShape(shapes, hit.m_position, nearestDistance);
+				Vec4 const& geometry = shapes[hit.m_shapeIndex].m_data0;
+				isMatch &= (nearestShape == hit.m_shapeIndex) || (SdSphere(hit.m_position, Vec3(geometry.x, geometry.y, geometry.z), geometry.w) == nearestDistance);
+			}
+		}
+		isMatch &= ((int64_t)numHitMismatches * 1000000 <= (int64_t)rays.size() * QUERY_MAX_FLIPS_PER_MILLION) && (maxError <= constants.minHitDistance * 2.f);
+		addRow("ray", scalarMilliseconds, batchStats, poolStats, Stringf("%5.1f%% hit, %.1f steps, %d flips, %d other shapes", 100.0 * numHits / rays.size(),
+			(double)poolStats.m_numRaySteps / rays.size(), numHitMismatches, numShapeMismatches), maxError, isMatch);
+
+		// Closest points, from the whole activity box
+		uint32_t state = 99u;
+		float range = (ACTIVITY_BOX_RADIUS + MAX_SPHERE_RADIUS) * spread;
+		std::vector<Vec3> points;
+		for (int pointIndex = 0; pointIndex < QUERY_NUM_POINTS; ++pointIndex)
+		{
+			points.push_back(Vec3(NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range), NextRandomFloatInRange(state, -range, range)));
+		}
+		std::vector<Vec3> scalarPoints(points.size());
+		std::vector<float> scalarDistances(points.size());
+		scalarStart = std::chrono::steady_clock::now();
+		for (size_t pointIndex = 0; pointIndex < points.size(); ++pointIndex)
+		{
+			scalarPoints[pointIndex] = ProjectSdfBenchmarkPoint(scene, points[pointIndex], scalarDistances[pointIndex]);
+		}
+		scalarMilliseconds = GetMillisecondsSince(scalarStart);
+		std::vector<SdfClosestPointResult> closestPoints;
+		batchStats = query.FindClosestPoints(points, closestPoints, nullptr);
+		poolStats = query.FindClosestPoints(points, closestPoints, &jobPool);
+
+		// The distances as the scalar ones, and as many points on the surface
+		maxError = 0.f;
+		isMatch = true;
+		int numOnSurface = 0;
+		int numScalarOnSurface = 0;
+		for (size_t pointIndex = 0; pointIndex < points.size(); ++pointIndex)
+		{
+			SdfClosestPointResult const& result = closestPoints[pointIndex];
+			numOnSurface += (fabsf(scene.SdfMap(result.m_closestPoint)) < constants.minHitDistance) ? 1 : 0;
+			numScalarOnSurface += (fabsf(scene.SdfMap(scalarPoints[pointIndex])) < constants.minHitDistance) ? 1 : 0;
+			isMatch &= fabsf(result.m_distance - scalarDistances[pointIndex]) <= QUERY_DISTANCE_TOLERANCE * fmaxf(fabsf(scalarDistances[pointIndex]), 1.f);
+			maxError = fmaxf(maxError, (result.m_closestPoint - scalarPoints[pointIndex]).GetLength());
+		}
+		isMatch &= (int64_t)abs(numOnSurface - numScalarOnSurface) * 1000000 <= (int64_t)points.size() * QUERY_MAX_FLIPS_PER_MILLION;
+		addRow("closest", scalarMilliseconds, batchStats, poolStats, Stringf("%5.1f%% on the surface (scalar %5.1f%%)", 100.0 * numOnSurface / points.size(),
+			100.0 * numScalarOnSurface / points.size()), maxError, isMatch);
+
+		// Overlaps, spawn-sized spheres
+		std::vector<SdfOverlapQuery> overlaps;
+		for (Vec3 const& point : points)
+		{
+			SdfOverlapQuery overlap;
+			overlap.m_center = point;
+			overlap.m_radius = NextRandomFloatInRange(state, MIN_SPHERE_RADIUS, MAX_SPHERE_RADIUS);
+			overlaps.push_back(overlap);
+		}
+		std::vector<uint8_t> scalarOverlaps(overlaps.size());
+		scalarStart = std::chrono::steady_clock::now();
+		for (size_t overlapIndex = 0; overlapIndex < overlaps.size(); ++overlapIndex)
+		{
+			scalarOverlaps[overlapIndex] = (scene.SdfMap(overlaps[overlapIndex].m_center) < overlaps[overlapIndex].m_radius) ? 1 : 0;
+		}
+		scalarMilliseconds = GetMillisecondsSince(scalarStart);
+		std::vector<SdfOverlapResult> overlapResults;
+		batchStats = query.Overlap(overlaps, overlapResults, nullptr);
+		poolStats = query.Overlap(overlaps, overlapResults, &jobPool);
+
+		int numOverlapping = 0;
+		int numOverlapMismatches = 0;
+		for (size_t overlapIndex = 0; overlapIndex < overlaps.size(); ++overlapIndex)
+		{
+			numOverlapping += overlapResults[overlapIndex].m_isOverlapping ? 1 : 0;
+			numOverlapMismatches += (overlapResults[overlapIndex].m_isOverlapping != (scalarOverlaps[overlapIndex] != 0)) ? 1 : 0;
+		}
+		addRow("overlap", scalarMilliseconds, batchStats, poolStats, Stringf("%5.1f%% overlapping, %d flips", 100.0 * numOverlapping / overlaps.size(), numOverlapMismatches),
+			0.f, numOverlapMismatches == 0);
+		out_report += Stringf("  %7d | scene set up (BVH build) in %.2f ms\n", numShapes, setMilliseconds);
+	}
+	return succeeded;
+}
+
+static constexpr float DIRTY_SHAPE_MOVE = 0.25f; // per axis, each moved shape each frame
+static constexpr int DIRTY_MANY_MOVED_SHAPES = 8;
+
+// Pixels outside every dirty tile whose ray comes within the hit radius of a changed shape, as it was or as it is. The
+// radius is without the binning margin, which only covers rounding, so the region must hold every one of them.
+static int CountUncoveredDirtyPixels(SdfDirtyTiles const& dirtyTiles, SdfCpuView const& view, IntVec2 const& dimensions, std::vector<Vec4> const& changedGeometry,
+	SdfRayMarchingConstants const& constants)
+{
+	int numUncovered = 0;
+	for (int y = 0; y < dimensions.y; ++y)
+	{
+		for (int x = 0; x < dimensions.x; ++x)
+		{
+			if (dirtyTiles.IsTileDirty(IntVec2(x / SDF_TILE_SIZE, y / SDF_TILE_SIZE)))
+			{
+				continue;
+			}
+			Vec3 direction = view.GetRayDirection(x, y, dimensions);
+			for (Vec4 const& geometry : changedGeometry)
+			{
+				Vec3 toCenter = Vec3(geometry.x, geometry.y, geometry.z) - view.m_position;
+				float t = std::max(DotProduct3D(toCenter, direction), 0.f);
+				if ((toCenter - direction * t).GetLength() < SdfTileClassification::GetHitRadius(geometry.w, constants) - SDF_TILE_BINNING_MARGIN)
+				{
+					++numUncovered;
+					break;
+				}
+			}
+		}
+	}
+	return numUncovered;
+}
+
+// Incremental re-render over a scripted run: each frame marches its dirty tiles into the image the frames before left,
+// and a full render of the same frame is the reference. The dirty region is checked on its own, every ray coming within
+// the hit radius of a changed shape must be in it; then the image: the dirty tiles are the full render's to the bit, the
+// others may only differ by the march tolerance (a moved shape changing the steps of a ray that hits something else).
+// The BVH is refit while the count holds, as GameRayMarching does; adding or removing a shape rebuilds it, a new blend
+// order, so those frames are full with the BVH and partial in scene order.
+static bool RunDirtyTileBenchmark(SdfBenchmarkConfig const& config, JobPool& jobPool, std::string& out_report)
+{
+	if (config.m_dirtyShapeCounts.empty())
+	{
+		return true;
+	}
+	bool succeeded = true;
+
+	enum DirtyFrame
+	{
+		FIRST, PAUSED, ONE_MOVED, MANY_MOVED, ADDED, REMOVED, CAMERA, LIGHTS, SETTINGS, PAUSED_AGAIN, NUM_DIRTY_FRAMES
+	};
+	static constexpr char const* FRAME_NAMES[NUM_DIRTY_FRAMES] = {
+		"first", "paused", "one moved", "8 moved", "added", "removed", "camera", "lights", "settings", "paused"
+	};
+	static constexpr SdfDirtyState EXPECTED_STATES[NUM_DIRTY_FRAMES] = {
+		SdfDirtyState::FULL, SdfDirtyState::CLEAN, SdfDirtyState::PARTIAL, SdfDirtyState::PARTIAL, SdfDirtyState::PARTIAL,
+		SdfDirtyState::PARTIAL, SdfDirtyState::FULL, SdfDirtyState::FULL, SdfDirtyState::FULL, SdfDirtyState::CLEAN
+	};
+	static constexpr char const* STATE_NAMES[] = { "clean", "partial", "full" };
+	static constexpr char const* PASS_NAMES[] = { "bvh", "bvh tiled", "scene tiled" };
+
+	IntVec2 const& resolution = config.m_resolution;
+	int numPixels = resolution.x * resolution.y;
+	out_report += Stringf("\nIncremental re-render (dirty tiles of the changed shapes' old and new bounds, %dx%d, shapes moved by up to %.2f per axis)\n",
+		resolution.x, resolution.y, DIRTY_SHAPE_MOVE);
+	out_report += "   shapes | pass        | frame     | state   | changed | dirty tiles | px marched       | ms incremental | ms full   | uncovered px | px changed outside | max color error outside | contents\n";
+
+	for (int numShapes : config.m_dirtyShapeCounts)
+	{
+		for (int pass = 0; pass < 3; ++pass)
+		{
+			// Tiled: binned and classified, the dirty background tiles are filled
+			SdfRayMarchingConstants constants;
+			constants.useBvh = (pass < 2) ? 1 : 0;
+			constants.useTileBinning = (pass > 0) ? 1 : 0;
+			constants.useTileClassification = (pass > 0) ? 1 : 0;
+			SdfBvh bvh;
+			SdfShapeStreams bvhStreams;
+			std::vector<SdfShape> shapes = MakeSdfBenchmarkShapes(numShapes, 1234u);
+			SdfCpuView view = MakeSdfBenchmarkView(resolution);
+			LightConstants lightConstants = MakeSdfBenchmarkLightConstants();
+			uint32_t state = 4321u;
+
+			SdfDirtyTiles dirtyTiles;
+			SdfCpuImage image; // the output texture, kept across frames
+			for (int frame = 0; frame < NUM_DIRTY_FRAMES; ++frame)
+			{
+				std::vector<Vec4> changedGeometry;
+				auto moveShape = [&](int shapeIndex)
+				{
+					Vec4& data0 = shapes[shapeIndex].m_data0;
+					changedGeometry.push_back(data0);
+					data0.x += NextRandomFloatInRange(state, -DIRTY_SHAPE_MOVE, DIRTY_SHAPE_MOVE);
+					data0.y += NextRandomFloatInRange(state, -DIRTY_SHAPE_MOVE, DIRTY_SHAPE_MOVE);
+					data0.z += NextRandomFloatInRange(state, -DIRTY_SHAPE_MOVE, DIRTY_SHAPE_MOVE);
+					changedGeometry.push_back(data0);
+				};
+				if (frame == ONE_MOVED)
+				{
+					moveShape((int)(NextRandomUint(state) % (uint32_t)numShapes));
+				}
+				else if (frame == MANY_MOVED)
+				{
+					// Spread out, so no shape moves twice
+					int numMoved = std::min(DIRTY_MANY_MOVED_SHAPES, numShapes);
+					int firstShape = (int)(NextRandomUint(state) % (uint32_t)numShapes);
+					for (int moved = 0; moved < numMoved; ++moved)
+					{
+						moveShape((firstShape + moved * (numShapes / numMoved)) % numShapes);
+					}
+				}
+				else if (frame == ADDED)
+				{
+					shapes.push_back(MakeSdfBenchmarkShapes(1, 99u)[0]);
+					changedGeometry.push_back(shapes.back().m_data0);
+				}
+				else if (frame == REMOVED)
+				{
+					changedGeometry.push_back(shapes.back().m_data0);
+					shapes.pop_back();
+				}
+				else if (frame == CAMERA)
+				{
+					view.m_position.y += 0.1f;
+				}
+				else if (frame == LIGHTS)
+				{
+					lightConstants.m_sunColor[3] = 0.5f;
+				}
+				else if (frame == SETTINGS)
+				{
+					constants.maxSteps += 1;
+				}
+
+				SdfCpuRayMarcher marcher;
+				if (constants.useBvh)
+				{
+					bool isRefit = (frame > 0) && (bvh.GetNumShapes() == (int)shapes.size());
+					bvh.UpdateShapeStreams(shapes, constants.toleranceK, constants.halfPrecisionGeometry != 0, isRefit, bvhStreams);
+				}
+				marcher.SetScene(shapes, constants, &bvh);
+				marcher.SetLightConstants(lightConstants);
+				SdfTileClassification classification;
+				if (constants.useTileClassification)
+				{
+					classification.Classify(view, resolution, marcher.GetShapeStreams(), marcher.IsHalfPrecisionGeometry(), constants);
+				}
+				dirtyTiles.Update(view, resolution, shapes, constants.useBvh ? &bvh.GetShapeOrder() : nullptr, constants, lightConstants, 0,
+					constants.useTileClassification ? &classification : nullptr);
+
+				SdfCpuFrameStats incrementalStats;
+				if (dirtyTiles.GetState() == SdfDirtyState::FULL)
+				{
+					incrementalStats = marcher.RenderFrame(view, resolution, image, &jobPool);
+				}
+				else if (dirtyTiles.GetState() == SdfDirtyState::PARTIAL)
+				{
+					incrementalStats = marcher.RenderTiles(view, dirtyTiles.GetTileList(), dirtyTiles.GetNumMarchTiles(), image, &jobPool);
+				}
+				SdfCpuImage fullImage;
+				SdfCpuFrameStats fullStats = marcher.RenderFrame(view, resolution, fullImage, &jobPool);
+
+				bool isFull = (dirtyTiles.GetState() == SdfDirtyState::FULL);
+				int numUncovered = isFull ? 0 : CountUncoveredDirtyPixels(dirtyTiles, view, resolution, changedGeometry, constants);
+				bool areDirtyTilesExact = true;
+				int numChangedOutside = 0;
+				float maxColorErrorOutside = 0.f;
+				for (int pixelIndex = 0; pixelIndex < numPixels; ++pixelIndex)
+				{
+					IntVec2 tileCoords((pixelIndex % resolution.x) / SDF_TILE_SIZE, (pixelIndex / resolution.x) / SDF_TILE_SIZE);
+					bool isSame = (image.m_colors[pixelIndex] == fullImage.m_colors[pixelIndex]) && (image.m_depths[pixelIndex] == fullImage.m_depths[pixelIndex]);
+					if (isFull || dirtyTiles.IsTileDirty(tileCoords))
+					{
+						areDirtyTilesExact &= isSame;
+						continue;
+					}
+					if (!isSame)
+					{
+						++numChangedOutside;
+						Vec3 error = (image.m_colors[pixelIndex] - fullImage.m_colors[pixelIndex]) * 255.f;
+						maxColorErrorOutside = std::max(maxColorErrorOutside, std::max(fabsf(error.x), std::max(fabsf(error.y), fabsf(error.z))));
+					}
+				}
+				SdfImageDiff diff = CompareSdfImages(image, fullImage);
+				int numChanged = (int)changedGeometry.size() / ((frame == ONE_MOVED || frame == MANY_MOVED) ? 2 : 1);
+				bool isRebuilt = constants.useBvh && (frame == ADDED || frame == REMOVED);
+				SdfDirtyState expectedState = isRebuilt ? SdfDirtyState::FULL : EXPECTED_STATES[frame];
+				bool isMatch = (dirtyTiles.GetState() == expectedState) && (numUncovered == 0) && areDirtyTilesExact && (diff.m_numPixelsOverTolerance == 0);
+				isMatch &= (dirtyTiles.GetNumMovedShapes() == numChanged) || isFull;
+				isMatch &= (dirtyTiles.GetState() != SdfDirtyState::CLEAN) || (dirtyTiles.GetNumMarchedPixels() == 0);
+				isMatch &= !isFull || (dirtyTiles.GetNumMarchedPixels() == numPixels);
+				succeeded &= isMatch;
+
+				out_report += Stringf("  %7d | %-11s | %-9s | %-7s | %7d | %11d | %7d (%5.1f%%) | %14.3f | %9.3f | %12d | %18d | %23.1f | %s\n", numShapes,
+					PASS_NAMES[pass], FRAME_NAMES[frame], STATE_NAMES[(int)dirtyTiles.GetState()], isFull ? 0 : dirtyTiles.GetNumMovedShapes(),
+					dirtyTiles.GetNumDirtyTiles(), dirtyTiles.GetNumMarchedPixels(), 100.0 * (double)dirtyTiles.GetNumMarchedPixels() / (double)numPixels,
+					incrementalStats.m_milliseconds, fullStats.m_milliseconds, numUncovered, numChangedOutside, maxColorErrorOutside, isMatch ? "ok" : "FAILED");
+			}
+		}
+	}
+	return succeeded;
+}
+
+static bool RunDynamicResolutionBenchmark(std::string& out_report)
+{
+	struct Scenario
+	{
+		char const* m_name;
+		float m_fixedMilliseconds;
+		float m_fullResMilliseconds[3]; // march cost at scale 1, for frames 0-299, 300-599, 600-899
+		float m_noise; // uniform +-, relative
+		int m_maxBucketChanges; // more means the size flickers
+	};
+	static constexpr Scenario SCENARIOS[] = {
+		{ "under budget", 2.f, { 8.f, 8.f, 8.f }, 0.f, 0 },
+		{ "over budget", 3.f, { 25.f, 25.f, 25.f }, 0.f, 3 }, // 1 to 0.625 in steps of the gain, never back up
+		{ "load steps", 2.f, { 10.f, 40.f, 10.f }, 0.f, 8 },
+		{ "noisy", 3.f, { 25.f, 25.f, 25.f }, 0.25f, 8 },
+	};
+	static constexpr int NUM_PHASES = 3;
+	static constexpr int FRAMES_PER_PHASE = 300;
+	static constexpr int SETTLE_FRAMES = 60; // after each load change
+	bool succeeded = true;
+
+	SdfDynamicResolutionConfig controllerConfig;
+	float budget = controllerConfig.m_budgetMilliseconds;
+	float overBudget = budget * (1.f + controllerConfig.m_deadBand);
+	out_report += Stringf("\nDynamic resolution controller: synthetic frame times, %.1f ms budget, %d buckets %.3f-%.3f\n", budget,
+		SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS, SDF_DYNAMIC_RESOLUTION_MIN_SCALE, SDF_DYNAMIC_RESOLUTION_MAX_SCALE);
+	out_report += "  scenario     | frames | bucket changes | phase end scale / best | settled frames over budget | mean ms | result\n";
+
+	for (Scenario const& scenario : SCENARIOS)
+	{
+		SdfDynamicResolution controller;
+		controller.SetConfig(controllerConfig);
+		uint32_t noiseState = 777u;
+
+		bool isMatch = true;
+		int numSettledOver = 0;
+		double sumMilliseconds = 0.0;
+		std::string phaseScales;
+		for (int phase = 0; phase < NUM_PHASES; ++phase)
+		{
+			float fullResMilliseconds = scenario.m_fullResMilliseconds[phase];
+			for (int frame = 0; frame < FRAMES_PER_PHASE; ++frame)
+			{
+				float scale = controller.GetBucketScale();
+				float noise = 1.f + NextRandomFloatInRange(noiseState, -scenario.m_noise, scenario.m_noise);
+				float milliseconds = (scenario.m_fixedMilliseconds + fullResMilliseconds * scale * scale) * noise;
+				sumMilliseconds += milliseconds;
+				if (frame >= SETTLE_FRAMES && milliseconds / noise > overBudget)
+				{
+					++numSettledOver;
+				}
+				controller.Update(milliseconds);
+			}
+
+			// Largest bucket whose noise-free time is within the dead band, the lowest one when none is
+			int bestBucket = 0;
+			for (int bucket = 0; bucket < SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS; ++bucket)
+			{
+				float bucketScale = SdfDynamicResolution::GetBucketScale(bucket);
+				if (scenario.m_fixedMilliseconds + fullResMilliseconds * bucketScale * bucketScale <= overBudget)
+				{
+					bestBucket = bucket;
+				}
+			}
+			// Noise may cost one bucket of headroom
+			int minBucket = (scenario.m_noise > 0.f) ? bestBucket - 1 : bestBucket;
+			isMatch &= (controller.GetBucket() >= minBucket && controller.GetBucket() <= bestBucket);
+			phaseScales += Stringf("%s%.3f/%.3f", phase > 0 ? " " : "", controller.GetBucketScale(), SdfDynamicResolution::GetBucketScale(bestBucket));
+		}
+		isMatch &= (numSettledOver == 0 || scenario.m_noise > 0.f);
+		isMatch &= (controller.GetNumBucketChanges() <= scenario.m_maxBucketChanges);
+		succeeded &= isMatch;
+
+		int numFrames = NUM_PHASES * FRAMES_PER_PHASE;
+		out_report += Stringf("  %-12s | %6d | %14d | %s | %26d | %7.2f | %s\n", scenario.m_name, numFrames, controller.GetNumBucketChanges(),
+			phaseScales.c_str(), numSettledOver, sumMilliseconds / (double)numFrames, isMatch ? "ok" : "FAILED");
+	}
+	return succeeded;
+}
+
+bool RunSdfBenchmarks(SdfBenchmarkConfig const& config, std::string& out_report)
+{
+	std::error_code errorCode;
+	if (!config.m_outputFolder.empty())
+	{
+		std::filesystem::create_directories(config.m_outputFolder, errorCode);
+	}
+	if (!config.m_goldenFolder.empty() && config.m_updateGolden)
+	{
+		std::filesystem::create_directories(config.m_goldenFolder, errorCode);
+	}
+	else if (!config.m_goldenFolder.empty() && !std::filesystem::is_directory(config.m_goldenFolder, errorCode))
+	{
+		// A wrong working directory would otherwise compare against nothing
+		out_report += Stringf("Golden folder MISSING: %s (run from Run/, or write it with -updategolden)\n", config.m_goldenFolder.c_str());
+		return false;
+	}
+
+	JobPool jobPool(config.m_numThreads < 0 ? -1 : config.m_numThreads - 1);
+
+	bool succeeded = true;
+	succeeded &= RunReferenceBenchmark(config, jobPool, out_report);
+	succeeded &= RunPacketBenchmark(config, jobPool, out_report);
+	succeeded &= RunShapeLayoutBenchmark(config, jobPool, out_report);
+	succeeded &= RunBvhBenchmark(config, jobPool, out_report);
+	succeeded &= RunTileBinningBenchmark(config, jobPool, out_report);
+	succeeded &= RunBrickMapBenchmark(config, jobPool, out_report);
+	succeeded &= RunConeDepthBenchmark(config, jobPool, out_report);
+	succeeded &= RunTemporalBenchmark(config, jobPool, out_report);
+	succeeded &= RunOverRelaxationBenchmark(config, jobPool, out_report);
+	succeeded &= RunTopKMaterialsBenchmark(config, jobPool, out_report);
+	succeeded &= RunAnalyticNormalBenchmark(config, jobPool, out_report);
+	succeeded &= RunDeferredShadingBenchmark(config, jobPool, out_report);
+	succeeded &= RunShadingRateBenchmark(config, jobPool, out_report);
+	succeeded &= RunCsgBenchmark(config, jobPool, out_report);
+	succeeded &= RunShapeSimulationBenchmark(config, jobPool, out_report);
+	succeeded &= RunCollisionBenchmark(config, jobPool, out_report);
+	succeeded &= RunUploadRingBenchmark(config, jobPool, out_report);
+	succeeded &= RunTileClassificationBenchmark(config, jobPool, out_report);
+	succeeded &= RunChunkMesherBenchmark(config, jobPool, out_report);
+	succeeded &= RunMeshBakerBenchmark(config, jobPool, out_report);
+	succeeded &= RunBrickFileBenchmark(config, jobPool, out_report);
+	succeeded &= RunSceneQueryBenchmark(config, jobPool, out_report);
+	succeeded &= RunDirtyTileBenchmark(config, jobPool, out_report);
+	succeeded &= RunDynamicResolutionBenchmark(out_report);
+
+	if (!config.m_outputFolder.empty())
+	{
+		FILE* reportFile = fopen((config.m_outputFolder + "/SdfBenchmarkReport.txt").c_str(), "w");
+		if (reportFile)
+		{
+			fputs(out_report.c_str(), reportFile);
+			fclose(reportFile);
+		}
+	}
+	return succeeded;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/IntVec2.hpp"
+
+#include <string>
+#include <vector>
+
+/*
+Headless benchmarks and golden images for the CPU SDF paths.
+Command line (Main_Windows / Main_Headless):
+	-sdfbench [-width=320] [-height=160] [-frames=5] [-threads=N] [-shapes=2,8,32,128]
+	          [-packetshapes=2,64,1024] [-layoutshapes=1024,262144] [-bvhshapes=10000,25000,50000,100000]
+	          [-binshapes=64,1024,10000] [-brickshapes=16,64,256] [-coneshapes=8,128,1024]
+	          [-temporalshapes=16,128] [-camerapath=SdfCameraPath.txt] [-relaxshapes=8,128,1024] [-topkshapes=128,1024]
+	          [-normalshapes=8,128,1024] [-deferredshapes=8,128,1024] [-shadingrateshapes=8,128,1024]
+	          [-csgnodes=10,100,1000,10000]
+	          [-simshapes=1000,100000,1000000] [-collideshapes=1000,10000,100000] [-uploadshapes=1000,100000]
+	          [-classifyshapes=8,128,1024] [-meshshapes=16,64,128] [-bakeresolutions=32,64,128]
+	          [-brickfileresolutions=64,128,256] [-queryshapes=1000,10000] [-dirtyshapes=16,128,1024]
+	          [-out=SdfBenchmark] [-golden=Data/Golden/Sdf] [-updategolden]
+*/
+
+//-----------------------------------------------------------------------------------------------
+struct SdfBenchmarkConfig
+{
+	IntVec2 m_resolution = IntVec2(320, 160);
+	std::vector<int> m_shapeCounts = { 2, 8, 32, 128 };
+	std::vector<int> m_packetShapeCounts = { 2, 64, 1024 }; // scalar vs ray packets, empty to skip
+	std::vector<int> m_layoutShapeCounts = { 1024, 262144 }; // SdfMap over each shape buffer layout, empty to skip
+	std::vector<int> m_bvhShapeCounts = { 10000, 25000, 50000, 100000 }; // BVH build, refit and query, empty to skip
+	std::vector<int> m_binningShapeCounts = { 64, 1024, 10000 }; // screen-tile binning against brute force, empty to skip
+	std::vector<int> m_brickShapeCounts = { 16, 64, 256 }; // brick map bake, dirty rebake and frames, empty to skip
+	std::vector<int> m_coneShapeCounts = { 8, 128, 1024 }; // cone depth pre-pass against marching from the camera, empty to skip
+	std::vector<int> m_temporalShapeCounts = { 16, 128 }; // temporal reprojection over a camera path, empty to skip
+	std::string m_cameraPathFile; // recorded in GameRayMarching, a built-in slow orbit when empty
+	std::vector<int> m_relaxationShapeCounts = { 8, 128, 1024 }; // over-relaxed sphere tracing against plain steps, empty to skip
+	std::vector<int> m_topKShapeCounts = { 128, 1024 }; // top-K material blending against blending every shape, empty to skip
+	std::vector<int> m_normalShapeCounts = { 8, 128, 1024 }; // analytic gradient against finite differences and tetrahedron normals, empty to skip
+	std::vector<int> m_deferredShapeCounts = { 8, 128, 1024 }; // deferred shading against the fused march, empty to skip
+	std::vector<int> m_shadingRateShapeCounts = { 8, 128, 1024 }; // deferred shading at 2x2 and 4x4 blocks against every pixel, empty to skip
+	std::vector<int> m_csgNodeCounts = { 10, 100, 1000, 10000 }; // CSG tree walk against the compiled program, empty to skip
+	std::vector<int> m_simulationShapeCounts = { 1000, 100000, 1000000 }; // SoA shape simulation against per-sphere objects, empty to skip
+	std::vector<int> m_collisionShapeCounts = { 1000, 10000, 100000 }; // sphere collisions and grid SDF queries against brute force, empty to skip
+	std::vector<int> m_uploadShapeCounts = { 1000, 100000 }; // upload ring on a mock device against whole-buffer uploads, empty to skip
+	std::vector<int> m_classificationShapeCounts = { 8, 128, 1024 }; // occupied-tile march and background fill against every tile, empty to skip
+	std::vector<int> m_meshShapeCounts = { 16, 64, 128 }; // chunked surface nets, full and incremental, empty to skip
+	std::vector<int> m_bakeResolutions = { 32, 64, 128 }; // mesh-to-SDF bake of the test model, exact and jump flooded, empty to skip
+	std::vector<int> m_brickFileResolutions = { 64, 128, 256 }; // sparse brick file round trip, loads and streaming, empty to skip
+	std::vector<int> m_queryShapeCounts = { 1000, 10000 }; // batched scene queries against the scalar SdfMap, empty to skip
+	std::vector<int> m_dirtyShapeCounts = { 16, 128, 1024 }; // incremental re-render of the dirty tiles against full frames, empty to skip
+	int m_numFrames = 5;
+	int m_numThreads = -1; // -1: hardware concurrency
+	std::string m_outputFolder = "SdfBenchmark";
+	std::string m_goldenFolder;
+	bool m_updateGolden = false;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+bool IsSdfBenchmarkCommandLine(std::string const& commandLine);
+SdfBenchmarkConfig ParseSdfBenchmarkCommandLine(std::string const& commandLine);
+
+// Deterministic across platforms: spheres inside the activity box, same ranges as GameRayMarching::SpawnSphere
+std::vector<SdfShape> MakeSdfBenchmarkShapes(int numShapes, uint32_t seed);
+SdfCpuView MakeSdfBenchmarkView(IntVec2 const& resolution);
+LightConstants MakeSdfBenchmarkLightConstants(); // same as Game::ResetLighting
+
+// Returns false when a golden image comparison failed or an output could not be written
+bool RunSdfBenchmarks(SdfBenchmarkConfig const& config, std::string& out_report);
@@ -0,0 +1,479 @@
+#include "Game/SdfBrickFile.hpp"
+#include "Game/SdfMeshBaker.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static_assert(sizeof(SdfBrickFileHeader) == 64, "SdfBrickFileHeader is read in place");
+static_assert(sizeof(SdfBrickFileRecord) == 16, "SdfBrickFileRecord is read in place");
+
+
+//-----------------------------------------------------------------------------------------------
+static size_t AlignUp(size_t numBytes)
+{
+	return (numBytes + SDF_BRICK_FILE_ALIGNMENT - 1) & ~(SDF_BRICK_FILE_ALIGNMENT - 1);
+}
+
+static int GetBrickSampleIndex(int x, int y, int z)
+{
+	return (z * SDF_BRICK_SAMPLES_PER_EDGE + y) * SDF_BRICK_SAMPLES_PER_EDGE + x;
+}
+
+static float DecodeBrickSample(uint32_t entry, SdfBrickFileRecord const* records, uint8_t const* samples, float bandDistance, int sampleIndex)
+{
+	if (entry == SDF_BRICK_FILE_OUTSIDE)
+	{
+		return bandDistance;
+	}
+	if (entry == SDF_BRICK_FILE_INSIDE)
+	{
+		return -bandDistance;
+	}
+	SdfBrickFileRecord const& record = records[entry];
+	return record.m_minDistance + (float)samples[entry * SDF_BRICK_FILE_BRICK_BYTES + sampleIndex] * record.m_step;
+}
+
+// Shared by the view and the streamer's pool, which differ only in where the table points. False on a brick that is
+// stored but not resident.
+static bool SampleBrickTable(SdfBrickFileHeader const& header, uint32_t const* table, SdfBrickFileRecord const* records, uint8_t const* samples,
+	Vec3 const& p, float& out_distance)
+{
+	const int brickSize = (int)header.m_brickSize;
+	Vec3 coords = (p - header.m_origin) / header.m_voxelSize;
+	Vec3 clamped(GetClamped(coords.x, 0.f, (float)(header.m_numBricksX * brickSize)), GetClamped(coords.y, 0.f, (float)(header.m_numBricksY * brickSize)),
+		GetClamped(coords.z, 0.f, (float)(header.m_numBricksZ * brickSize)));
+	float outside = (coords - clamped).GetLength();
+
+	int brickX = std::min((int)clamped.x / brickSize, header.m_numBricksX - 1);
+	int brickY = std::min((int)clamped.y / brickSize, header.m_numBricksY - 1);
+	int brickZ = std::min((int)clamped.z / brickSize, header.m_numBricksZ - 1);
+	uint32_t entry = table[(brickZ * header.m_numBricksY + brickY) * header.m_numBricksX + brickX];
+	if (entry == SDF_BRICK_FILE_NOT_RESIDENT)
+	{
+		return false;
+	}
+
+	Vec3 local = clamped - Vec3((float)(brickX * brickSize), (float)(brickY * brickSize), (float)(brickZ * brickSize));
+	int x = std::min((int)local.x, brickSize - 1);
+	int y = std::min((int)local.y, brickSize - 1);
+	int z = std::min((int)local.z, brickSize - 1);
+	float fx = local.x - (float)x;
+	float fy = local.y - (float)y;
+	float fz = local.z - (float)z;
+	auto corner = [&](int dx, int dy, int dz) { return DecodeBrickSample(entry, records, samples, header.m_bandDistance, GetBrickSampleIndex(x + dx, y + dy, z + dz)); };
+	float s00 = corner(0, 0, 0) + (corner(1, 0, 0) - corner(0, 0, 0)) * fx;
+	float s10 = corner(0, 1, 0) + (corner(1, 1, 0) - corner(0, 1, 0)) * fx;
+	float s01 = corner(0, 0, 1) + (corner(1, 0, 1) - corner(0, 0, 1)) * fx;
+	float s11 = corner(0, 1, 1) + (corner(1, 1, 1) - corner(0, 1, 1)) * fx;
+	float s0 = s00 + (s10 - s00) * fy;
+	float s1 = s01 + (s11 - s01) * fy;
+	out_distance = s0 + (s1 - s0) * fz + outside * header.m_voxelSize;
+	return true;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool EncodeSdfBrickFile(SdfBakedGrid const& grid, SdfBrickFileOptions const& options, std::vector<uint8_t>& out_bytes, SdfBrickFileStats* out_stats /*= nullptr*/)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	out_bytes.clear();
+	if (grid.m_numSamplesX < 2 || grid.m_numSamplesY < 2 || grid.m_numSamplesZ < 2 || options.m_bandVoxels < 1.f)
+	{
+		return false;
+	}
+
+	SdfBrickFileHeader header;
+	header.m_numBricksX = (grid.m_numSamplesX - 1 + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+	header.m_numBricksY = (grid.m_numSamplesY - 1 + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+	header.m_numBricksZ = (grid.m_numSamplesZ - 1 + SDF_BRICK_SIZE - 1) / SDF_BRICK_SIZE;
+	header.m_bandDistance = options.m_bandVoxels * grid.m_voxelSize;
+	header.m_origin = grid.m_origin;
+	header.m_voxelSize = grid.m_voxelSize;
+	const int numBricks = header.GetNumBricks();
+	const float band = header.m_bandDistance;
+
+	// Corners past the last sample repeat it
+	auto gatherBrick = [&](int brickIndex, float* out_samples)
+	{
+		int brickX = brickIndex % header.m_numBricksX;
+		int brickY = (brickIndex / header.m_numBricksX) % header.m_numBricksY;
+		int brickZ = brickIndex / (header.m_numBricksX * header.m_numBricksY);
+		for (int z = 0; z < SDF_BRICK_SAMPLES_PER_EDGE; ++z)
+		{
+			int sampleZ = std::min(brickZ * SDF_BRICK_SIZE + z, grid.m_numSamplesZ - 1);
+			for (int y = 0; y < SDF_BRICK_SAMPLES_PER_EDGE; ++y)
+			{
+				int sampleY = std::min(brickY * SDF_BRICK_SIZE + y, grid.m_numSamplesY - 1);
+				for (int x = 0; x < SDF_BRICK_SAMPLES_PER_EDGE; ++x)
+				{
+					int sampleX = std::min(brickX * SDF_BRICK_SIZE + x, grid.m_numSamplesX - 1);
+					out_samples[GetBrickSampleIndex(x, y, z)] = grid.GetSample(sampleX, sampleY, sampleZ);
+				}
+			}
+		}
+	};
+
+	// Bricks with a sample inside the band get a slot, in brick order
+	std::vector<uint32_t> table(numBricks);
+	std::vector<float> brickSamples(SDF_BRICK_NUM_SAMPLES);
+	uint32_t numStored = 0;
+	for (int brickIndex = 0; brickIndex < numBricks; ++brickIndex)
+	{
+		gatherBrick(brickIndex, brickSamples.data());
+		bool isInBand = false;
+		for (float sample : brickSamples)
+		{
+			isInBand |= (fabsf(sample) < band);
+		}
+		table[brickIndex] = isInBand ? numStored++ : ((brickSamples[0] < 0.f) ? SDF_BRICK_FILE_INSIDE : SDF_BRICK_FILE_OUTSIDE);
+	}
+	header.m_numStoredBricks = numStored;
+	header.m_tableOffset = (uint32_t)AlignUp(sizeof(SdfBrickFileHeader));
+	header.m_recordOffset = (uint32_t)AlignUp(header.m_tableOffset + (size_t)numBricks * sizeof(uint32_t));
+	header.m_sampleOffset = AlignUp(header.m_recordOffset + (size_t)numStored * sizeof(SdfBrickFileRecord));
+	out_bytes.assign(header.m_sampleOffset + (size_t)numStored * SDF_BRICK_FILE_BRICK_BYTES, 0);
+	memcpy(out_bytes.data(), &header, sizeof(header));
+	memcpy(out_bytes.data() + header.m_tableOffset, table.data(), table.size() * sizeof(uint32_t));
+
+	// Quantize each stored brick between its own clamped min and max
+	SdfBrickFileRecord* records = reinterpret_cast<SdfBrickFileRecord*>(out_bytes.data() + header.m_recordOffset);
+	uint8_t* samples = out_bytes.data() + header.m_sampleOffset;
+	float maxStep = 0.f;
+	for (int brickIndex = 0; brickIndex < numBricks; ++brickIndex)
+	{
+		uint32_t slot = table[brickIndex];
+		if (slot >= numStored)
+		{
+			continue;
+		}
+		gatherBrick(brickIndex, brickSamples.data());
+		float minDistance = band;
+		float maxDistance = -band;
+		for (float& sample : brickSamples)
+		{
+			sample = GetClamped(sample, -band, band);
+			minDistance = fminf(minDistance, sample);
+			maxDistance = fmaxf(maxDistance, sample);
+		}
+		SdfBrickFileRecord& record = records[slot];
+		record.m_brickX = (uint16_t)(brickIndex % header.m_numBricksX);
+		record.m_brickY = (uint16_t)((brickIndex / header.m_numBricksX) % header.m_numBricksY);
+		record.m_brickZ = (uint16_t)(brickIndex / (header.m_numBricksX * header.m_numBricksY));
+		record.m_minDistance = minDistance;
+		record.m_step = (maxDistance - minDistance) / 255.f;
+		maxStep = fmaxf(maxStep, record.m_step);
+
+		uint8_t* brickBytes = samples + slot * SDF_BRICK_FILE_BRICK_BYTES;
+		for (int i = 0; i < SDF_BRICK_NUM_SAMPLES; ++i)
+		{
+			float level = (record.m_step > 0.f) ? (brickSamples[i] - minDistance) / record.m_step : 0.f;
+			brickBytes[i] = (uint8_t)GetClamped(level + 0.5f, 0.f, 255.f);
+		}
+	}
+
+	if (out_stats)
+	{
+		out_stats->m_numBricks = numBricks;
+		out_stats->m_numStoredBricks = (int)numStored;
+		out_stats->m_numBytes = out_bytes.size();
+		out_stats->m_numDenseBytes = grid.m_samples.size() * sizeof(float);
+		out_stats->m_maxStep = maxStep;
+		out_stats->m_encodeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+	return true;
+}
+
+bool WriteSdfBrickFile(std::string const& filePath, SdfBakedGrid const& grid, SdfBrickFileOptions const& options, SdfBrickFileStats* out_stats /*= nullptr*/)
+{
+	std::vector<uint8_t> bytes;
+	if (!EncodeSdfBrickFile(grid, options, bytes, out_stats))
+	{
+		return false;
+	}
+	FILE* file = fopen(filePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+	size_t numWritten = fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+	return numWritten == bytes.size();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool SdfBrickFileView::Open(void const* data, size_t numBytes)
+{
+	Close();
+	if (data == nullptr || numBytes < sizeof(SdfBrickFileHeader))
+	{
+		return false;
+	}
+	SdfBrickFileHeader const* header = static_cast<SdfBrickFileHeader const*>(data);
+	if (header->m_magic != SDF_BRICK_FILE_MAGIC || header->m_version != SDF_BRICK_FILE_VERSION || header->m_brickSize != (uint32_t)SDF_BRICK_SIZE ||
+		header->m_numBricksX < 1 || header->m_numBricksY < 1 || header->m_numBricksZ < 1 || !(header->m_voxelSize > 0.f))
+	{
+		return false;
+	}
+
+	size_t numBricks = (size_t)header->m_numBricksX * header->m_numBricksY * header->m_numBricksZ;
+	if (header->m_tableOffset < sizeof(SdfBrickFileHeader) || header->m_tableOffset % SDF_BRICK_FILE_ALIGNMENT != 0 ||
+		header->m_recordOffset < header->m_tableOffset + numBricks * sizeof(uint32_t) || header->m_recordOffset % SDF_BRICK_FILE_ALIGNMENT != 0 ||
+		header->m_sampleOffset < header->m_recordOffset + (size_t)header->m_numStoredBricks * sizeof(SdfBrickFileRecord) ||
+		header->m_sampleOffset % SDF_BRICK_FILE_ALIGNMENT != 0 || numBytes < header->m_sampleOffset + (size_t)header->m_numStoredBricks * SDF_BRICK_FILE_BRICK_BYTES)
+	{
+		return false;
+	}
+	uint8_t const* bytes = static_cast<uint8_t const*>(data);
+	uint32_t const* table = reinterpret_cast<uint32_t const*>(bytes + header->m_tableOffset);
+	for (size_t brickIndex = 0; brickIndex < numBricks; ++brickIndex)
+	{
+		if (table[brickIndex] >= header->m_numStoredBricks && table[brickIndex] != SDF_BRICK_FILE_OUTSIDE && table[brickIndex] != SDF_BRICK_FILE_INSIDE)
+		{
+			return false;
+		}
+	}
+
+	m_header = header;
+	m_table = table;
+	m_records = reinterpret_cast<SdfBrickFileRecord const*>(bytes + header->m_recordOffset);
+	m_samples = bytes + header->m_sampleOffset;
+	return true;
+}
+
+void SdfBrickFileView::Close()
+{
+	m_header = nullptr;
+	m_table = nullptr;
+	m_records = nullptr;
+	m_samples = nullptr;
+}
+
+float SdfBrickFileView::GetSample(int x, int y, int z) const
+{
+	int brickX = std::min(x / SDF_BRICK_SIZE, m_header->m_numBricksX - 1);
+	int brickY = std::min(y / SDF_BRICK_SIZE, m_header->m_numBricksY - 1);
+	int brickZ = std::min(z / SDF_BRICK_SIZE, m_header->m_numBricksZ - 1);
+	int sampleIndex = GetBrickSampleIndex(x - brickX * SDF_BRICK_SIZE, y - brickY * SDF_BRICK_SIZE, z - brickZ * SDF_BRICK_SIZE);
+	return DecodeBrickSample(m_table[GetBrickIndex(brickX, brickY, brickZ)], m_records, m_samples, m_header->m_bandDistance, sampleIndex);
+}
+
+float SdfBrickFileView::Sample(Vec3 const& p) const
+{
+	float distance = 0.f;
+	SampleBrickTable(*m_header, m_table, m_records, m_samples, p, distance);
+	return distance;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool SdfMappedFile::Open(std::string const& filePath)
+{
+	Close();
+#if defined(_WIN32)
+	HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER fileSize;
+	HANDLE mapping = (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart > 0) ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+	void const* data = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+	if (data == nullptr)
+	{
+		if (mapping)
+		{
+			CloseHandle(mapping);
+		}
+		CloseHandle(file);
+		return false;
+	}
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_numBytes = (size_t)fileSize.QuadPart;
+#else
+	int file = open(filePath.c_str(), O_RDONLY);
+	if (file < 0)
+	{
+		return false;
+	}
+	struct stat fileStat;
+	void* data = (fstat(file, &fileStat) == 0 && fileStat.st_size > 0) ? mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0) : MAP_FAILED;
+	close(file); // the mapping keeps the file
+	if (data == MAP_FAILED)
+	{
+		return false;
+	}
+	m_numBytes = (size_t)fileStat.st_size;
+#endif
+	m_data = data;
+	return true;
+}
+
+void SdfMappedFile::Close()
+{
+	if (m_data == nullptr)
+	{
+		return;
+	}
+#if defined(_WIN32)
+	UnmapViewOfFile(m_data);
+	CloseHandle(m_mappingHandle);
+	CloseHandle(m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	munmap(const_cast<void*>(m_data), m_numBytes);
+#endif
+	m_data = nullptr;
+	m_numBytes = 0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfBrickStreamer::Init(SdfBrickFileView const* view, int capacity)
+{
+	m_view = view;
+	m_stats = SdfBrickStreamerStats();
+	m_loadedSlots.clear();
+	int numBricks = view->GetHeader().GetNumBricks();
+	m_table.resize(numBricks);
+	for (int brickIndex = 0; brickIndex < numBricks; ++brickIndex)
+	{
+		uint32_t entry = view->GetBrickEntry(brickIndex);
+		m_table[brickIndex] = (entry == SDF_BRICK_FILE_OUTSIDE || entry == SDF_BRICK_FILE_INSIDE) ? entry : SDF_BRICK_FILE_NOT_RESIDENT;
+	}
+	m_records.assign(capacity, SdfBrickFileRecord());
+	m_samples.assign((size_t)capacity * SDF_BRICK_FILE_BRICK_BYTES, 0);
+	m_slotBricks.assign(capacity, -1);
+	m_freeSlots.resize(capacity);
+	for (int slot = 0; slot < capacity; ++slot)
+	{
+		m_freeSlots[slot] = capacity - 1 - slot; // the lowest slots go first
+	}
+}
+
+float SdfBrickStreamer::GetDistanceToBrick(Vec3 const& position, int brickIndex) const
+{
+	SdfBrickFileHeader const& header = m_view->GetHeader();
+	float extent = header.GetBrickExtent();
+	int brickX = brickIndex % header.m_numBricksX;
+	int brickY = (brickIndex / header.m_numBricksX) % header.m_numBricksY;
+	int brickZ = brickIndex / (header.m_numBricksX * header.m_numBricksY);
+	Vec3 boxMin = header.m_origin + Vec3((float)brickX, (float)brickY, (float)brickZ) * extent;
+	float dx = fmaxf(fmaxf(boxMin.x - position.x, position.x - (boxMin.x + extent)), 0.f);
+	float dy = fmaxf(fmaxf(boxMin.y - position.y, position.y - (boxMin.y + extent)), 0.f);
+	float dz = fmaxf(fmaxf(boxMin.z - position.z, position.z - (boxMin.z + extent)), 0.f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+void SdfBrickStreamer::Update(Vec3 const& position, float radius, int maxLoads)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	m_loadedSlots.clear();
+	m_stats.m_numLoadedBricks = 0;
+	m_stats.m_numEvictedBricks = 0;
+	m_stats.m_numLoadedBytes = 0;
+	if (m_view == nullptr || !m_view->IsOpen())
+	{
+		return;
+	}
+
+	// Stored bricks within the radius, nearest first
+	SdfBrickFileHeader const& header = m_view->GetHeader();
+	std::vector<std::pair<float, int>> wanted;
+	for (uint32_t slot = 0; slot < header.m_numStoredBricks; ++slot)
+	{
+		SdfBrickFileRecord const& record = m_view->GetRecord(slot);
+		int brickIndex = m_view->GetBrickIndex(record.m_brickX, record.m_brickY, record.m_brickZ);
+		float distance = GetDistanceToBrick(position, brickIndex);
+		if (distance <= radius)
+		{
+			wanted.push_back(std::make_pair(distance, brickIndex));
+		}
+	}
+	std::sort(wanted.begin(), wanted.end());
+
+	// Residents farthest first, the eviction order
+	std::vector<std::pair<float, int>> residents;
+	for (int slot = 0; slot < GetCapacity(); ++slot)
+	{
+		if (m_slotBricks[slot] >= 0)
+		{
+			residents.push_back(std::make_pair(GetDistanceToBrick(position, m_slotBricks[slot]), slot));
+		}
+	}
+	std::sort(residents.begin(), residents.end(), [](std::pair<float, int> const& a, std::pair<float, int> const& b) { return a.first > b.first; });
+	size_t nextEviction = 0;
+
+	for (std::pair<float, int> const& candidate : wanted)
+	{
+		int brickIndex = candidate.second;
+		if (m_table[brickIndex] != SDF_BRICK_FILE_NOT_RESIDENT)
+		{
+			continue;
+		}
+		if (m_stats.m_numLoadedBricks >= maxLoads)
+		{
+			break;
+		}
+		int slot = -1;
+		if (!m_freeSlots.empty())
+		{
+			slot = m_freeSlots.back();
+			m_freeSlots.pop_back();
+		}
+		else if (nextEviction < residents.size() && residents[nextEviction].first > candidate.first)
+		{
+			slot = residents[nextEviction++].second;
+			m_table[m_slotBricks[slot]] = SDF_BRICK_FILE_NOT_RESIDENT;
+			++m_stats.m_numEvictedBricks;
+		}
+		else
+		{
+			break; // full of nearer bricks
+		}
+
+		// The file's bytes as they are, what an upload from the mapped file would copy
+		uint32_t fileSlot = m_view->GetBrickEntry(brickIndex);
+		m_records[slot] = m_view->GetRecord(fileSlot);
+		memcpy(&m_samples[(size_t)slot * SDF_BRICK_FILE_BRICK_BYTES], m_view->GetBrickSamples(fileSlot), SDF_BRICK_FILE_BRICK_BYTES);
+		m_table[brickIndex] = (uint32_t)slot;
+		m_slotBricks[slot] = brickIndex;
+		m_loadedSlots.push_back(slot);
+		++m_stats.m_numLoadedBricks;
+		m_stats.m_numLoadedBytes += sizeof(SdfBrickFileRecord) + SDF_BRICK_FILE_BRICK_BYTES;
+	}
+
+	m_stats.m_numWantedBricks = (int)wanted.size();
+	m_stats.m_numMissingBricks = 0;
+	for (std::pair<float, int> const& candidate : wanted)
+	{
+		m_stats.m_numMissingBricks += (m_table[candidate.second] == SDF_BRICK_FILE_NOT_RESIDENT) ? 1 : 0;
+	}
+	m_stats.m_numResidentBricks = GetCapacity() - (int)m_freeSlots.size();
+	m_stats.m_updateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+bool SdfBrickStreamer::TrySample(Vec3 const& p, float& out_distance) const
+{
+	if (m_view == nullptr || !m_view->IsOpen())
+	{
+		return false;
+	}
+	return SampleBrickTable(m_view->GetHeader(), m_table.data(), m_records.data(), m_samples.data(), p, out_distance);
+}
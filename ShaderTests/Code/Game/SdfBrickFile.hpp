@@ -0,0 +1,186 @@
+#pragma once
+#include "Game/SdfBrickMap.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct SdfBakedGrid;
+
+/*
+Sparse narrow-band distance volumes on disk (.sdfb), for baked grids (SdfMeshBaker.hpp) too big to keep dense.
+The grid is cut into SDF_BRICK_SIZE^3-voxel bricks holding their (SDF_BRICK_SIZE + 1)^3 corner samples, like
+SdfBrickMap. Only bricks with a sample within the band of the surface are stored, as 8-bit distances quantized between
+the brick's own min and max; the others are one table entry saying inside or outside. Distances are clamped to the
+band first, so a stored sample is off by half its brick's step at most, and everything past the band reads as +-band.
+A surface point is within half a voxel diagonal of a sample, so a band of at least a voxel never drops a brick the
+surface passes through.
+Layout, little endian, every section 64-byte aligned so a mapped file is read and uploaded in place:
+	SdfBrickFileHeader
+	brick table    uint32 per brick, x fastest: slot of the stored brick, SDF_BRICK_FILE_OUTSIDE or SDF_BRICK_FILE_INSIDE
+	records        SdfBrickFileRecord per slot
+	samples        SDF_BRICK_FILE_BRICK_BYTES per slot, x fastest, padded to 4 bytes (a ByteAddressBuffer load)
+SdfBrickFileView reads a file in memory, SdfMappedFile maps one. SdfBrickStreamer keeps the stored bricks around a
+point resident in a fixed pool laid out the same way, copying each brick's record and bytes straight from the view.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr uint32_t SDF_BRICK_FILE_MAGIC = 0x42464453u; // "SDFB"
+constexpr uint32_t SDF_BRICK_FILE_VERSION = 1;
+constexpr uint32_t SDF_BRICK_FILE_OUTSIDE = 0xFFFFFFFFu;
+constexpr uint32_t SDF_BRICK_FILE_INSIDE = 0xFFFFFFFEu;
+constexpr uint32_t SDF_BRICK_FILE_NOT_RESIDENT = 0xFFFFFFFDu; // SdfBrickStreamer: stored, not loaded yet
+constexpr size_t SDF_BRICK_FILE_ALIGNMENT = 64;
+constexpr size_t SDF_BRICK_FILE_BRICK_BYTES = (SDF_BRICK_NUM_SAMPLES + 3) & ~3;
+
+
+// Notes: 64 bytes, read in place from the file
+struct SdfBrickFileHeader
+{
+	uint32_t m_magic = SDF_BRICK_FILE_MAGIC;
+	uint32_t m_version = SDF_BRICK_FILE_VERSION;
+	uint32_t m_brickSize = SDF_BRICK_SIZE;
+	uint32_t m_numStoredBricks = 0;
+	int32_t m_numBricksX = 0;
+	int32_t m_numBricksY = 0;
+	int32_t m_numBricksZ = 0;
+	float m_bandDistance = 0.f;
+	Vec3 m_origin; // the first sample
+	float m_voxelSize = 0.f;
+	uint32_t m_tableOffset = 0;
+	uint32_t m_recordOffset = 0;
+	uint64_t m_sampleOffset = 0;
+
+	int GetNumBricks() const { return m_numBricksX * m_numBricksY * m_numBricksZ; }
+	float GetBrickExtent() const { return m_voxelSize * (float)m_brickSize; }
+};
+
+// Notes: 16 bytes, a StructuredBuffer element as is
+struct SdfBrickFileRecord
+{
+	uint16_t m_brickX = 0;
+	uint16_t m_brickY = 0;
+	uint16_t m_brickZ = 0;
+	uint16_t m_padding = 0;
+	float m_minDistance = 0.f; // distance = m_minDistance + byte * m_step
+	float m_step = 0.f;
+};
+
+
+struct SdfBrickFileOptions
+{
+	float m_bandVoxels = 2.f; // band half-width in voxels, at least 1
+};
+
+struct SdfBrickFileStats
+{
+	int m_numBricks = 0;
+	int m_numStoredBricks = 0;
+	size_t m_numBytes = 0;
+	size_t m_numDenseBytes = 0; // the grid as raw floats
+	float m_maxStep = 0.f; // coarsest quantization step of a stored brick
+	double m_encodeMilliseconds = 0.0;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// False when the grid has fewer than two samples along an axis or the options are out of range
+bool EncodeSdfBrickFile(SdfBakedGrid const& grid, SdfBrickFileOptions const& options, std::vector<uint8_t>& out_bytes, SdfBrickFileStats* out_stats = nullptr);
+bool WriteSdfBrickFile(std::string const& filePath, SdfBakedGrid const& grid, SdfBrickFileOptions const& options, SdfBrickFileStats* out_stats = nullptr);
+
+
+//-----------------------------------------------------------------------------------------------
+// Zero-copy reader over file bytes that outlive it, e.g. an SdfMappedFile
+class SdfBrickFileView
+{
+public:
+	bool Open(void const* data, size_t numBytes); // false when the header or the section sizes do not check out
+	void Close();
+
+	bool IsOpen() const { return m_header != nullptr; }
+	SdfBrickFileHeader const& GetHeader() const { return *m_header; }
+	uint32_t GetBrickEntry(int brickIndex) const { return m_table[brickIndex]; }
+	int GetBrickIndex(int brickX, int brickY, int brickZ) const { return (brickZ * m_header->m_numBricksY + brickY) * m_header->m_numBricksX + brickX; }
+	SdfBrickFileRecord const& GetRecord(uint32_t slot) const { return m_records[slot]; }
+	uint8_t const* GetBrickSamples(uint32_t slot) const { return m_samples + slot * SDF_BRICK_FILE_BRICK_BYTES; }
+
+	// Same field as the grid that was encoded: trilinear inside it, clamped to its box outside
+	float GetSample(int x, int y, int z) const;
+	float Sample(Vec3 const& p) const;
+
+private:
+	SdfBrickFileHeader const* m_header = nullptr;
+	uint32_t const* m_table = nullptr;
+	SdfBrickFileRecord const* m_records = nullptr;
+	uint8_t const* m_samples = nullptr;
+};
+
+
+// Read-only mapping of a whole file, pages are read from disk on first touch
+class SdfMappedFile
+{
+public:
+	SdfMappedFile() = default;
+	SdfMappedFile(SdfMappedFile const&) = delete;
+	SdfMappedFile& operator=(SdfMappedFile const&) = delete;
+	~SdfMappedFile() { Close(); }
+
+	bool Open(std::string const& filePath);
+	void Close();
+
+	void const* GetData() const { return m_data; }
+	size_t GetNumBytes() const { return m_numBytes; }
+
+private:
+	void const* m_data = nullptr;
+	size_t m_numBytes = 0;
+	void* m_fileHandle = nullptr; // Windows: file and mapping handles
+	void* m_mappingHandle = nullptr;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfBrickStreamerStats
+{
+	int m_numWantedBricks = 0; // stored bricks within the radius, last update
+	int m_numResidentBricks = 0;
+	int m_numLoadedBricks = 0; // last update
+	int m_numEvictedBricks = 0; // last update
+	int m_numMissingBricks = 0; // wanted and not resident after the last update
+	size_t m_numLoadedBytes = 0; // last update
+	double m_updateMilliseconds = 0.0;
+};
+
+// Fixed pool of stored bricks around a point, nearest first, at most maxLoads copied per update. When the pool is
+// full the resident brick farthest from the point makes room, if it is farther than the one to load.
+class SdfBrickStreamer
+{
+public:
+	void Init(SdfBrickFileView const* view, int capacity);
+	void Update(Vec3 const& position, float radius, int maxLoads);
+
+	int GetCapacity() const { return (int)m_slotBricks.size(); }
+	SdfBrickStreamerStats const& GetStats() const { return m_stats; }
+	// Same layout as the file's table, records and samples, for an upload of the loaded slots
+	std::vector<uint32_t> const& GetBrickTable() const { return m_table; }
+	std::vector<SdfBrickFileRecord> const& GetRecords() const { return m_records; }
+	std::vector<uint8_t> const& GetSamples() const { return m_samples; }
+	std::vector<int> const& GetLoadedSlots() const { return m_loadedSlots; } // last update
+
+	// False where the brick is stored but not resident
+	bool TrySample(Vec3 const& p, float& out_distance) const;
+
+private:
+	float GetDistanceToBrick(Vec3 const& position, int brickIndex) const;
+
+private:
+	SdfBrickFileView const* m_view = nullptr;
+	std::vector<uint32_t> m_table;
+	std::vector<SdfBrickFileRecord> m_records;
+	std::vector<uint8_t> m_samples;
+	std::vector<int> m_slotBricks; // brick index per slot, -1 when free
+	std::vector<int> m_freeSlots;
+	std::vector<int> m_loadedSlots;
+	SdfBrickStreamerStats m_stats;
+};
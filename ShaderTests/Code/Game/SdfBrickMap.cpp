@@ -0,0 +1,308 @@
+#include "Game/SdfBrickMap.hpp"
+#include "Game/JobPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr float NO_SHAPE_DISTANCE = 1e30f;
+static constexpr int MAX_BLEND_LOWERING_SHAPES = 4096; // past this the bound is simply 6k
+
+
+static void RunBrickJobs(int numItems, JobPool* jobPool, std::function<void(int itemIndex)> const& job)
+{
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numItems, job);
+		return;
+	}
+	for (int itemIndex = 0; itemIndex < numItems; ++itemIndex)
+	{
+		job(itemIndex);
+	}
+}
+
+static float GetDistanceToBox(Vec3 const& p, Vec3 const& boxMins, Vec3 const& boxMaxs)
+{
+	float dx = fmaxf(fmaxf(boxMins.x - p.x, p.x - boxMaxs.x), 0.f);
+	float dy = fmaxf(fmaxf(boxMins.y - p.y, p.y - boxMaxs.y), 0.f);
+	float dz = fmaxf(fmaxf(boxMins.z - p.z, p.z - boxMaxs.z), 0.f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfBrickMap::Update(std::vector<Vec4> const& geometry, float toleranceK, SdfMapFunc const& sdfMap, JobPool* jobPool, bool isFullBake /*= false*/)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	int numShapes = (int)geometry.size();
+	bool isRebuild = isFullBake || m_bricks.empty() || (numShapes != (int)m_bakedGeometry.size()) || (toleranceK != m_toleranceK);
+
+	m_dirtyBricks.clear();
+	if (isRebuild)
+	{
+		// Covers every point within SDF_BRICK_FAR_DISTANCE of a shape in the activity box
+		float halfExtent = ceilf((ACTIVITY_BOX_RADIUS + MAX_SPHERE_RADIUS + SDF_BRICK_FAR_DISTANCE) / SDF_BRICK_EXTENT) * SDF_BRICK_EXTENT;
+		m_gridSize = (int)(2.f * halfExtent / SDF_BRICK_EXTENT + 0.5f);
+		m_origin = Vec3(-halfExtent, -halfExtent, -halfExtent);
+		m_toleranceK = toleranceK;
+		m_blendLowering = GetBlendLowering(numShapes, toleranceK);
+		m_odometer = 0.f;
+
+		int numBricks = m_gridSize * m_gridSize * m_gridSize;
+		m_bricks.assign(numBricks, SdfBrick());
+		m_samples.clear();
+		m_freeSampleOffsets.clear();
+		m_isDirty.assign(numBricks, 1);
+		for (int brickIndex = 0; brickIndex < numBricks; ++brickIndex)
+		{
+			m_dirtyBricks.push_back(brickIndex);
+		}
+	}
+	else
+	{
+		// Every shape moved by at most maxMove, so every baked distance dropped by at most maxMove
+		float maxMove = 0.f;
+		for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+		{
+			Vec4 const& oldGeometry = m_bakedGeometry[shapeIndex];
+			Vec4 const& newGeometry = geometry[shapeIndex];
+			float move = (Vec3(newGeometry.x, newGeometry.y, newGeometry.z) - Vec3(oldGeometry.x, oldGeometry.y, oldGeometry.z)).GetLength() + fabsf(newGeometry.w - oldGeometry.w);
+			if (move > 0.f)
+			{
+				maxMove = fmaxf(maxMove, move);
+				MarkBricksNearSphere(oldGeometry);
+				MarkBricksNearSphere(newGeometry);
+			}
+		}
+		m_odometer += maxMove;
+
+		for (int brickIndex = 0; brickIndex < (int)m_bricks.size(); ++brickIndex)
+		{
+			if (!m_isDirty[brickIndex] && m_odometer - m_bricks[brickIndex].m_bakeOdometer > SDF_BRICK_MAX_SLACK)
+			{
+				m_isDirty[brickIndex] = 1;
+				m_dirtyBricks.push_back(brickIndex);
+			}
+		}
+	}
+
+	m_shapeBoundsMin = Vec3(NO_SHAPE_DISTANCE, NO_SHAPE_DISTANCE, NO_SHAPE_DISTANCE);
+	m_shapeBoundsMax = Vec3(-NO_SHAPE_DISTANCE, -NO_SHAPE_DISTANCE, -NO_SHAPE_DISTANCE);
+	for (Vec4 const& shapeGeometry : geometry)
+	{
+		m_shapeBoundsMin = Vec3(fminf(m_shapeBoundsMin.x, shapeGeometry.x - shapeGeometry.w), fminf(m_shapeBoundsMin.y, shapeGeometry.y - shapeGeometry.w), fminf(m_shapeBoundsMin.z, shapeGeometry.z - shapeGeometry.w));
+		m_shapeBoundsMax = Vec3(fmaxf(m_shapeBoundsMax.x, shapeGeometry.x + shapeGeometry.w), fmaxf(m_shapeBoundsMax.y, shapeGeometry.y + shapeGeometry.w), fmaxf(m_shapeBoundsMax.z, shapeGeometry.z + shapeGeometry.w));
+	}
+	m_bakedGeometry = geometry;
+
+	BakeDirtyBricks(geometry, sdfMap, jobPool);
+
+	m_stats.m_numBricks = (int)m_bricks.size();
+	m_stats.m_numAllocatedBricks = (int)(m_samples.size() / SDF_BRICK_NUM_SAMPLES - m_freeSampleOffsets.size());
+	m_stats.m_numBytes = m_bricks.size() * sizeof(SdfBrick) + m_samples.size() * sizeof(float);
+	m_stats.m_numDenseBytes = m_bricks.size() * (sizeof(SdfBrick) + SDF_BRICK_NUM_SAMPLES * sizeof(float));
+	m_stats.m_bakeMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void SdfBrickMap::Clear()
+{
+	m_gridSize = 0;
+	m_odometer = 0.f;
+	m_bricks.clear();
+	m_samples.clear();
+	m_freeSampleOffsets.clear();
+	m_bakedGeometry.clear();
+	m_isDirty.clear();
+	m_dirtyBricks.clear();
+	m_stats = SdfBrickMapStats();
+}
+
+float SdfBrickMap::GetLowerBound(Vec3 const& p) const
+{
+	if (m_bricks.empty())
+	{
+		return 0.f;
+	}
+
+	// Every shape is inside the shape bounds, this also covers p outside the grid
+	float bound = GetDistanceToBox(p, m_shapeBoundsMin, m_shapeBoundsMax) - m_blendLowering;
+
+	Vec3 gridPos = (p - m_origin) / SDF_BRICK_EXTENT;
+	int brickX = (int)floorf(gridPos.x);
+	int brickY = (int)floorf(gridPos.y);
+	int brickZ = (int)floorf(gridPos.z);
+	if (brickX < 0 || brickY < 0 || brickZ < 0 || brickX >= m_gridSize || brickY >= m_gridSize || brickZ >= m_gridSize)
+	{
+		return bound;
+	}
+
+	int brickIndex = (brickZ * m_gridSize + brickY) * m_gridSize + brickX;
+	SdfBrick const& brick = m_bricks[brickIndex];
+	float slack = m_odometer - brick.m_bakeOdometer;
+	if (brick.m_sampleOffset == SDF_BRICK_EMPTY)
+	{
+		return fmaxf(bound, brick.m_coarseDistance - slack);
+	}
+
+	// Voxel corners: F(p) >= F(corner) - |p - corner|, keep the best of the eight
+	Vec3 brickMins = GetBrickMins(brickIndex);
+	Vec3 voxelPos = (p - brickMins) / SDF_BRICK_VOXEL_SIZE;
+	int voxelX = std::min(std::max((int)voxelPos.x, 0), SDF_BRICK_SIZE - 1);
+	int voxelY = std::min(std::max((int)voxelPos.y, 0), SDF_BRICK_SIZE - 1);
+	int voxelZ = std::min(std::max((int)voxelPos.z, 0), SDF_BRICK_SIZE - 1);
+
+	float const* samples = &m_samples[brick.m_sampleOffset];
+	float sampledBound = -NO_SHAPE_DISTANCE;
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		int x = voxelX + (corner & 1);
+		int y = voxelY + ((corner >> 1) & 1);
+		int z = voxelZ + (corner >> 2);
+		Vec3 cornerPos = brickMins + Vec3((float)x, (float)y, (float)z) * SDF_BRICK_VOXEL_SIZE;
+		float value = samples[(z * SDF_BRICK_SAMPLES_PER_EDGE + y) * SDF_BRICK_SAMPLES_PER_EDGE + x];
+		sampledBound = fmaxf(sampledBound, value - (p - cornerPos).GetLength());
+	}
+	return fmaxf(bound, sampledBound - slack);
+}
+
+float SdfBrickMap::GetBlendLowering(int numShapes, float toleranceK)
+{
+	if (numShapes > MAX_BLEND_LOWERING_SHAPES)
+	{
+		return 6.f * toleranceK;
+	}
+
+	// Worst case is every shape at the same distance: smin(x, x) repeatedly, with k = 1 then scaled
+	float res = 0.f;
+	for (int i = 1; i < numShapes; ++i)
+	{
+		float h = fmaxf(6.f - fabsf(res), 0.f) / 6.f;
+		res = fminf(res, 0.f) - h * h * h;
+	}
+	return -res * toleranceK;
+}
+
+void SdfBrickMap::MarkBricksNearSphere(Vec4 const& geometry)
+{
+	// Bricks the sphere surface can come within SDF_BRICK_FAR_DISTANCE of. This only keeps them fresh:
+	// every other brick stays a valid bound through the odometer slack and is rebaked once too stale.
+	float reach = geometry.w + SDF_BRICK_FAR_DISTANCE;
+	int minX = std::max((int)floorf((geometry.x - reach - m_origin.x) / SDF_BRICK_EXTENT), 0);
+	int minY = std::max((int)floorf((geometry.y - reach - m_origin.y) / SDF_BRICK_EXTENT), 0);
+	int minZ = std::max((int)floorf((geometry.z - reach - m_origin.z) / SDF_BRICK_EXTENT), 0);
+	int maxX = std::min((int)floorf((geometry.x + reach - m_origin.x) / SDF_BRICK_EXTENT), m_gridSize - 1);
+	int maxY = std::min((int)floorf((geometry.y + reach - m_origin.y) / SDF_BRICK_EXTENT), m_gridSize - 1);
+	int maxZ = std::min((int)floorf((geometry.z + reach - m_origin.z) / SDF_BRICK_EXTENT), m_gridSize - 1);
+
+	for (int z = minZ; z <= maxZ; ++z)
+	{
+		for (int y = minY; y <= maxY; ++y)
+		{
+			for (int x = minX; x <= maxX; ++x)
+			{
+				int brickIndex = (z * m_gridSize + y) * m_gridSize + x;
+				if (!m_isDirty[brickIndex])
+				{
+					m_isDirty[brickIndex] = 1;
+					m_dirtyBricks.push_back(brickIndex);
+				}
+			}
+		}
+	}
+}
+
+void SdfBrickMap::BakeDirtyBricks(std::vector<Vec4> const& geometry, SdfMapFunc const& sdfMap, JobPool* jobPool)
+{
+	int numDirty = (int)m_dirtyBricks.size();
+	std::vector<float> coarseDistances(numDirty);
+	RunBrickJobs(numDirty, jobPool, [&](int i)
+	{
+		coarseDistances[i] = GetCoarseDistance(m_dirtyBricks[i], geometry, sdfMap);
+	});
+
+	// Sample slots are handed out serially, then filled in parallel
+	std::vector<int> sampledBricks;
+	for (int i = 0; i < numDirty; ++i)
+	{
+		int brickIndex = m_dirtyBricks[i];
+		SdfBrick& brick = m_bricks[brickIndex];
+		bool isNearSurface = (coarseDistances[i] < SDF_BRICK_FAR_DISTANCE);
+		if (isNearSurface && brick.m_sampleOffset == SDF_BRICK_EMPTY)
+		{
+			if (!m_freeSampleOffsets.empty())
+			{
+				brick.m_sampleOffset = m_freeSampleOffsets.back();
+				m_freeSampleOffsets.pop_back();
+			}
+			else
+			{
+				brick.m_sampleOffset = (uint32_t)m_samples.size();
+				m_samples.resize(m_samples.size() + SDF_BRICK_NUM_SAMPLES);
+			}
+		}
+		else if (!isNearSurface && brick.m_sampleOffset != SDF_BRICK_EMPTY)
+		{
+			m_freeSampleOffsets.push_back(brick.m_sampleOffset);
+			brick.m_sampleOffset = SDF_BRICK_EMPTY;
+		}
+
+		brick.m_coarseDistance = coarseDistances[i];
+		brick.m_bakeOdometer = m_odometer;
+		m_isDirty[brickIndex] = 0;
+		if (isNearSurface)
+		{
+			sampledBricks.push_back(brickIndex);
+		}
+	}
+
+	RunBrickJobs((int)sampledBricks.size(), jobPool, [&](int i)
+	{
+		int brickIndex = sampledBricks[i];
+		Vec3 brickMins = GetBrickMins(brickIndex);
+		float* samples = &m_samples[m_bricks[brickIndex].m_sampleOffset];
+		for (int z = 0; z < SDF_BRICK_SAMPLES_PER_EDGE; ++z)
+		{
+			for (int y = 0; y < SDF_BRICK_SAMPLES_PER_EDGE; ++y)
+			{
+				for (int x = 0; x < SDF_BRICK_SAMPLES_PER_EDGE; ++x)
+				{
+					Vec3 samplePos = brickMins + Vec3((float)x, (float)y, (float)z) * SDF_BRICK_VOXEL_SIZE;
+					samples[(z * SDF_BRICK_SAMPLES_PER_EDGE + y) * SDF_BRICK_SAMPLES_PER_EDGE + x] = sdfMap(samplePos);
+				}
+			}
+		}
+	});
+
+	m_stats.m_numDirtyBricks = numDirty;
+	m_stats.m_numSampledBricks = (int)sampledBricks.size();
+	m_dirtyBricks.clear();
+}
+
+float SdfBrickMap::GetCoarseDistance(int brickIndex, std::vector<Vec4> const& geometry, SdfMapFunc const& sdfMap) const
+{
+	// Nearest sphere surface from anywhere in the brick, lowered by the worst smin blend
+	Vec3 brickMins = GetBrickMins(brickIndex);
+	Vec3 brickMaxs = brickMins + Vec3(SDF_BRICK_EXTENT, SDF_BRICK_EXTENT, SDF_BRICK_EXTENT);
+	float nearest = NO_SHAPE_DISTANCE;
+	for (Vec4 const& shapeGeometry : geometry)
+	{
+		nearest = fminf(nearest, GetDistanceToBox(Vec3(shapeGeometry.x, shapeGeometry.y, shapeGeometry.z), brickMins, brickMaxs) - shapeGeometry.w);
+	}
+
+	// The exact field at the center minus the half diagonal is usually tighter inside the blend
+	static constexpr float HALF_DIAGONAL = 0.8660254f * SDF_BRICK_EXTENT;
+	Vec3 brickCenter = brickMins + Vec3(0.5f * SDF_BRICK_EXTENT, 0.5f * SDF_BRICK_EXTENT, 0.5f * SDF_BRICK_EXTENT);
+	return fmaxf(nearest - m_blendLowering, sdfMap(brickCenter) - HALF_DIAGONAL);
+}
+
+Vec3 SdfBrickMap::GetBrickMins(int brickIndex) const
+{
+	int x = brickIndex % m_gridSize;
+	int y = (brickIndex / m_gridSize) % m_gridSize;
+	int z = brickIndex / (m_gridSize * m_gridSize);
+	return m_origin + Vec3((float)x, (float)y, (float)z) * SDF_BRICK_EXTENT;
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <functional>
+#include <vector>
+
+/*
+Sparse brick map of baked SdfMap distances over the activity box, a far-field cache for the marcher.
+Bricks are SDF_BRICK_SIZE^3 voxels and store (SDF_BRICK_SIZE + 1)^3 corner samples. Only bricks that can hold
+a distance below SDF_BRICK_FAR_DISTANCE get samples, the rest keep a single lower bound.
+
+GetLowerBound never exceeds SdfMap:
+	the field is 1-Lipschitz in p, so  F(p) >= F(corner) - |p - corner|  for every corner of the voxel
+	and 1-Lipschitz in the shape positions, so a brick baked while the shapes have since moved by at most s
+	is still a bound after subtracting s. m_odometer sums the largest per-shape move of every update.
+The marcher steps by the bound far from surfaces and switches to the exact SdfMap in the narrow band.
+*/
+
+class JobPool;
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_BRICK_SIZE = 8; // SDF_BRICK_SIZE in SdfRayMarching.hlsl
+constexpr int SDF_BRICK_SAMPLES_PER_EDGE = SDF_BRICK_SIZE + 1;
+constexpr int SDF_BRICK_NUM_SAMPLES = SDF_BRICK_SAMPLES_PER_EDGE * SDF_BRICK_SAMPLES_PER_EDGE * SDF_BRICK_SAMPLES_PER_EDGE;
+constexpr float SDF_BRICK_VOXEL_SIZE = 0.125f; // SDF_BRICK_VOXEL_SIZE in SdfRayMarching.hlsl
+constexpr float SDF_BRICK_EXTENT = SDF_BRICK_SIZE * SDF_BRICK_VOXEL_SIZE;
+constexpr float SDF_BRICK_FAR_DISTANCE = 1.f; // bricks whose bound is above this store no samples
+constexpr float SDF_BRICK_NARROW_BAND = 0.1f; // the marcher uses the exact SdfMap below this bound
+constexpr float SDF_BRICK_MAX_SLACK = 0.25f; // bricks that went staler than this are rebaked
+constexpr uint32_t SDF_BRICK_EMPTY = 0xFFFFFFFFu;
+
+
+// Notes: must be same as the struct in hlsl
+struct SdfBrick
+{
+	uint32_t m_sampleOffset = SDF_BRICK_EMPTY; // into the sample buffer, SDF_BRICK_EMPTY: coarse bound only
+	float m_coarseDistance = 0.f; // lower bound over the whole brick at bake time
+	float m_bakeOdometer = 0.f; // SdfBrickMap odometer when baked
+	float m_padding = 0.f;
+};
+
+
+struct SdfBrickMapStats
+{
+	int m_numBricks = 0;
+	int m_numAllocatedBricks = 0;
+	int m_numDirtyBricks = 0; // last update
+	int m_numSampledBricks = 0; // last update, bricks that evaluated SdfMap at their samples
+	double m_bakeMilliseconds = 0.0; // last update
+	size_t m_numBytes = 0; // brick table + allocated samples
+	size_t m_numDenseBytes = 0; // the same grid with every brick sampled
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfBrickMap
+{
+public:
+	using SdfMapFunc = std::function<float(Vec3 const& p)>;
+
+	// geometry: center.xyz + radius in stream order, sdfMap: the exact field the marcher uses.
+	// The first call, a new shape count, toleranceK or a reordered stream (isFullBake) bakes everything.
+	// Otherwise bricks around the previous and current sphere of every moved shape are rebaked, plus the stale ones.
+	void Update(std::vector<Vec4> const& geometry, float toleranceK, SdfMapFunc const& sdfMap, JobPool* jobPool, bool isFullBake = false);
+	void Clear();
+
+	float GetLowerBound(Vec3 const& p) const; // <= SdfMap(p)
+
+	bool IsEmpty() const { return m_bricks.empty(); }
+	int GetGridSize() const { return m_gridSize; } // bricks per axis
+	Vec3 const& GetOrigin() const { return m_origin; }
+	float GetOdometer() const { return m_odometer; }
+	float GetBlendLowering() const { return m_blendLowering; }
+	Vec3 const& GetShapeBoundsMin() const { return m_shapeBoundsMin; }
+	Vec3 const& GetShapeBoundsMax() const { return m_shapeBoundsMax; }
+	std::vector<SdfBrick> const& GetBricks() const { return m_bricks; }
+	std::vector<float> const& GetSamples() const { return m_samples; }
+	SdfBrickMapStats const& GetStats() const { return m_stats; }
+
+	// How far the sminCubic chain of numShapes shapes can drop below the nearest one, at most 6k
+	static float GetBlendLowering(int numShapes, float toleranceK);
+
+private:
+	void MarkBricksNearSphere(Vec4 const& geometry);
+	void BakeDirtyBricks(std::vector<Vec4> const& geometry, SdfMapFunc const& sdfMap, JobPool* jobPool);
+	float GetCoarseDistance(int brickIndex, std::vector<Vec4> const& geometry, SdfMapFunc const& sdfMap) const;
+	Vec3 GetBrickMins(int brickIndex) const;
+
+private:
+	int m_gridSize = 0;
+	Vec3 m_origin;
+	float m_toleranceK = 0.f;
+	float m_blendLowering = 0.f;
+	float m_odometer = 0.f;
+	Vec3 m_shapeBoundsMin;
+	Vec3 m_shapeBoundsMax;
+
+	std::vector<SdfBrick> m_bricks; // x fastest
+	std::vector<float> m_samples; // SDF_BRICK_NUM_SAMPLES per allocated brick, x fastest
+	std::vector<uint32_t> m_freeSampleOffsets;
+
+	std::vector<Vec4> m_bakedGeometry; // geometry of the previous update, for the dirty regions
+	std::vector<uint8_t> m_isDirty;
+	std::vector<int> m_dirtyBricks;
+
+	SdfBrickMapStats m_stats;
+};
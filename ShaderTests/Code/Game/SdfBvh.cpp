@@ -0,0 +1,200 @@
+#include "Game/SdfBvh.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+float SdfBvhNode::GetDistanceSquared(Vec3 const& p) const
+{
+	float dx = fmaxf(fmaxf(m_boundsMin.x - p.x, p.x - m_boundsMax.x), 0.f);
+	float dy = fmaxf(fmaxf(m_boundsMin.y - p.y, p.y - m_boundsMax.y), 0.f);
+	float dz = fmaxf(fmaxf(m_boundsMin.z - p.z, p.z - m_boundsMax.z), 0.f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfBvh::Build(std::vector<Vec4> const& shapeGeometry, float toleranceK)
+{
+	Clear();
+
+	int numShapes = (int)shapeGeometry.size();
+	if (numShapes == 0)
+	{
+		return;
+	}
+
+	m_shapeOrder.resize(numShapes);
+	for (int i = 0; i < numShapes; ++i)
+	{
+		m_shapeOrder[i] = (uint32_t)i;
+	}
+	m_nodes.reserve(2 * numShapes);
+
+	const float inflation = GetInfluenceRadius(toleranceK);
+
+	struct BuildTask
+	{
+		uint32_t m_nodeIndex;
+		int m_depth;
+	};
+	std::vector<BuildTask> tasks;
+
+	SdfBvhNode root;
+	root.m_leftOrFirst = 0;
+	root.m_count = (uint32_t)numShapes;
+	m_nodes.push_back(root);
+	tasks.push_back({ 0, 1 });
+
+	while (!tasks.empty())
+	{
+		BuildTask task = tasks.back();
+		tasks.pop_back();
+
+		SdfBvhNode& node = m_nodes[task.m_nodeIndex];
+		m_depth = std::max(m_depth, task.m_depth);
+
+		// Median splits halve the count, so the depth stays near log2(n / leaf size) and always fits the stack
+		if ((int)node.m_count <= SDF_BVH_MAX_LEAF_SIZE || task.m_depth >= SDF_BVH_STACK_SIZE - 1)
+		{
+			ComputeLeafBounds(node, shapeGeometry, inflation);
+			continue;
+		}
+
+		// Split at the median centroid along the longest centroid axis
+		uint32_t first = node.m_leftOrFirst;
+		uint32_t count = node.m_count;
+		Vec3 centroidMin = Vec3(1e30f, 1e30f, 1e30f);
+		Vec3 centroidMax = Vec3(-1e30f, -1e30f, -1e30f);
+		for (uint32_t i = first; i < first + count; ++i)
+		{
+			Vec4 const& geometry = shapeGeometry[m_shapeOrder[i]];
+			centroidMin = Vec3(fminf(centroidMin.x, geometry.x), fminf(centroidMin.y, geometry.y), fminf(centroidMin.z, geometry.z));
+			centroidMax = Vec3(fmaxf(centroidMax.x, geometry.x), fmaxf(centroidMax.y, geometry.y), fmaxf(centroidMax.z, geometry.z));
+		}
+		Vec3 extent = centroidMax - centroidMin;
+		int axis = (extent.x >= extent.y && extent.x >= extent.z) ? 0 : ((extent.y >= extent.z) ? 1 : 2);
+
+		uint32_t half = count / 2;
+		auto begin = m_shapeOrder.begin() + first;
+		std::nth_element(begin, begin + half, begin + count, [&](uint32_t a, uint32_t b)
+		{
+			float ca = (axis == 0) ? shapeGeometry[a].x : ((axis == 1) ? shapeGeometry[a].y : shapeGeometry[a].z);
+			float cb = (axis == 0) ? shapeGeometry[b].x : ((axis == 1) ? shapeGeometry[b].y : shapeGeometry[b].z);
+			return (ca < cb) || (ca == cb && a < b); // ties by index keep the build deterministic
+		});
+
+		uint32_t leftIndex = (uint32_t)m_nodes.size();
+		node.m_leftOrFirst = leftIndex;
+		node.m_count = 0;
+
+		SdfBvhNode left;
+		left.m_leftOrFirst = first;
+		left.m_count = half;
+		SdfBvhNode right;
+		right.m_leftOrFirst = first + half;
+		right.m_count = count - half;
+		m_nodes.push_back(left); // node reference is invalid from here
+		m_nodes.push_back(right);
+
+		tasks.push_back({ leftIndex + 1, task.m_depth + 1 });
+		tasks.push_back({ leftIndex, task.m_depth + 1 });
+	}
+
+	// Interior bounds from the children
+	for (int nodeIndex = (int)m_nodes.size() - 1; nodeIndex >= 0; --nodeIndex)
+	{
+		SdfBvhNode& node = m_nodes[nodeIndex];
+		if (!node.IsLeaf())
+		{
+			MergeChildBounds(node);
+		}
+	}
+}
+
+void SdfBvh::Refit(std::vector<Vec4> const& shapeGeometry, float toleranceK)
+{
+	if (shapeGeometry.size() != m_shapeOrder.size())
+	{
+		Build(shapeGeometry, toleranceK);
+		return;
+	}
+
+	const float inflation = GetInfluenceRadius(toleranceK);
+	for (int nodeIndex = (int)m_nodes.size() - 1; nodeIndex >= 0; --nodeIndex)
+	{
+		SdfBvhNode& node = m_nodes[nodeIndex];
+		if (node.IsLeaf())
+		{
+			ComputeLeafBounds(node, shapeGeometry, inflation);
+			continue;
+		}
+		MergeChildBounds(node);
+	}
+}
+
+void SdfBvh::UpdateShapeStreams(std::vector<SdfShape> const& shapes, float toleranceK, bool isHalfPrecision, bool isRefit, SdfShapeStreams& out_streams)
+{
+	// Bound the geometry the shader will actually read
+	m_geometryScratch.resize(shapes.size());
+	for (size_t i = 0; i < shapes.size(); ++i)
+	{
+		Vec4 const& geometry = shapes[i].m_data0;
+		if (isHalfPrecision)
+		{
+			m_geometryScratch[i] = Vec4(HalfToFloat(FloatToHalf(geometry.x)), HalfToFloat(FloatToHalf(geometry.y)),
+				HalfToFloat(FloatToHalf(geometry.z)), HalfToFloat(FloatToHalf(geometry.w)));
+		}
+		else
+		{
+			m_geometryScratch[i] = geometry;
+		}
+	}
+
+	if (isRefit)
+	{
+		Refit(m_geometryScratch, toleranceK);
+	}
+	else
+	{
+		Build(m_geometryScratch, toleranceK);
+	}
+
+	out_streams.Clear();
+	out_streams.Reserve((int)shapes.size());
+	for (uint32_t shapeIndex : m_shapeOrder)
+	{
+		out_streams.AddShape(shapes[shapeIndex]);
+	}
+}
+
+void SdfBvh::Clear()
+{
+	m_nodes.clear();
+	m_shapeOrder.clear();
+	m_depth = 0;
+}
+
+void SdfBvh::ComputeLeafBounds(SdfBvhNode& node, std::vector<Vec4> const& shapeGeometry, float inflation) const
+{
+	Vec3 boundsMin = Vec3(1e30f, 1e30f, 1e30f);
+	Vec3 boundsMax = Vec3(-1e30f, -1e30f, -1e30f);
+	for (uint32_t i = node.m_leftOrFirst; i < node.m_leftOrFirst + node.m_count; ++i)
+	{
+		Vec4 const& geometry = shapeGeometry[m_shapeOrder[i]];
+		float extent = geometry.w + inflation;
+		boundsMin = Vec3(fminf(boundsMin.x, geometry.x - extent), fminf(boundsMin.y, geometry.y - extent), fminf(boundsMin.z, geometry.z - extent));
+		boundsMax = Vec3(fmaxf(boundsMax.x, geometry.x + extent), fmaxf(boundsMax.y, geometry.y + extent), fmaxf(boundsMax.z, geometry.z + extent));
+	}
+	node.m_boundsMin = boundsMin;
+	node.m_boundsMax = boundsMax;
+}
+
+void SdfBvh::MergeChildBounds(SdfBvhNode& node) const
+{
+	SdfBvhNode const& left = m_nodes[node.m_leftOrFirst];
+	SdfBvhNode const& right = m_nodes[node.m_leftOrFirst + 1];
+	node.m_boundsMin = Vec3(fminf(left.m_boundsMin.x, right.m_boundsMin.x), fminf(left.m_boundsMin.y, right.m_boundsMin.y), fminf(left.m_boundsMin.z, right.m_boundsMin.z));
+	node.m_boundsMax = Vec3(fmaxf(left.m_boundsMax.x, right.m_boundsMax.x), fmaxf(left.m_boundsMax.y, right.m_boundsMax.y), fmaxf(left.m_boundsMax.z, right.m_boundsMax.z));
+}
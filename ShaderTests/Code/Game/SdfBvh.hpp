@@ -0,0 +1,64 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <vector>
+
+/*
+BVH over the SDF spheres, rebuilt or refit every frame after GameRayMarching::UpdateShapes.
+Every bound is the sphere AABB inflated by the sminCubic blend width (toleranceK * 6), so
+	distance(p, node) >= res  =>  every shape d in the node has d >= res + 6k  =>  sminCubic(res, d, k) == res
+and SdfMap can skip the node without changing its result. Shapes are uploaded in leaf order,
+so a leaf is a contiguous range of the shape streams.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_BVH_MAX_LEAF_SIZE = 4;
+constexpr int SDF_BVH_STACK_SIZE = 32; // SDF_BVH_STACK_SIZE in SdfRayMarching.hlsl, Build keeps the depth below it
+
+
+// Notes: must be same as the struct in hlsl
+struct SdfBvhNode
+{
+	Vec3 m_boundsMin;
+	uint32_t m_leftOrFirst = 0; // interior: left child, right child is +1. leaf: first shape
+	Vec3 m_boundsMax;
+	uint32_t m_count = 0; // 0 for interior nodes
+
+	bool IsLeaf() const { return m_count > 0; }
+	float GetDistanceSquared(Vec3 const& p) const; // 0 inside
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfBvh
+{
+public:
+	// shapeGeometry: center.xyz + radius, in scene order
+	void Build(std::vector<Vec4> const& shapeGeometry, float toleranceK);
+	// Keeps the tree and the shape order, only recomputes bounds. shapeGeometry in scene order, same count as Build.
+	void Refit(std::vector<Vec4> const& shapeGeometry, float toleranceK);
+	// Builds (or refits) over the geometry as uploaded, float16 when isHalfPrecision, then packs out_streams in leaf order
+	void UpdateShapeStreams(std::vector<SdfShape> const& shapes, float toleranceK, bool isHalfPrecision, bool isRefit, SdfShapeStreams& out_streams);
+	void Clear();
+
+	bool IsEmpty() const { return m_nodes.empty(); }
+	int GetNumShapes() const { return (int)m_shapeOrder.size(); }
+	int GetDepth() const { return m_depth; }
+
+	std::vector<SdfBvhNode> const& GetNodes() const { return m_nodes; }
+	// Leaf order: stream slot i holds scene shape m_shapeOrder[i]
+	std::vector<uint32_t> const& GetShapeOrder() const { return m_shapeOrder; }
+
+	static float GetInfluenceRadius(float toleranceK) { return toleranceK * 6.f; }
+
+private:
+	void ComputeLeafBounds(SdfBvhNode& node, std::vector<Vec4> const& shapeGeometry, float inflation) const;
+	void MergeChildBounds(SdfBvhNode& node) const;
+
+private:
+	std::vector<SdfBvhNode> m_nodes; // root first, children always after their parent
+	std::vector<uint32_t> m_shapeOrder;
+	int m_depth = 0;
+	std::vector<Vec4> m_geometryScratch;
+};
@@ -0,0 +1,373 @@
+#include "Game/SdfChunkMesher.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int CELL_SLOTS_PER_AXIS = SDF_MESH_CHUNK_CELLS + 1; // the owned cells and the layer before them
+
+// Cell corners are numbered x | y << 1 | z << 2, the 12 edges as corner pairs
+static constexpr int CELL_EDGES[12][2] = {
+	{ 0, 1 }, { 2, 3 }, { 4, 5 }, { 6, 7 },
+	{ 0, 2 }, { 1, 3 }, { 4, 6 }, { 5, 7 },
+	{ 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 },
+};
+
+
+static void RunMeshJobs(int numItems, JobPool* jobPool, std::function<void(int itemIndex)> const& job)
+{
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numItems, job);
+		return;
+	}
+	for (int itemIndex = 0; itemIndex < numItems; ++itemIndex)
+	{
+		job(itemIndex);
+	}
+}
+
+static float GetDistanceToBox(Vec3 const& p, Vec3 const& boxMins, Vec3 const& boxMaxs)
+{
+	float dx = fmaxf(fmaxf(boxMins.x - p.x, p.x - boxMaxs.x), 0.f);
+	float dy = fmaxf(fmaxf(boxMins.y - p.y, p.y - boxMaxs.y), 0.f);
+	float dz = fmaxf(fmaxf(boxMins.z - p.z, p.z - boxMaxs.z), 0.f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+static double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfChunkMesher::Update(std::vector<Vec4> const& geometry, float toleranceK, JobPool* jobPool, bool isFullRemesh /*= false*/)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	int numShapes = (int)geometry.size();
+	int numMeshedShapes = (int)m_meshedGeometry.size();
+	bool isRebuild = isFullRemesh || m_chunks.empty() || (numShapes < numMeshedShapes) || (toleranceK != m_toleranceK);
+
+	m_dirtyChunks.clear();
+	if (isRebuild)
+	{
+		// Covers every point within reach of a shape in the activity box
+		m_toleranceK = toleranceK;
+		float halfExtent = ceilf(GetShapeReach(ACTIVITY_BOX_RADIUS + MAX_SPHERE_RADIUS) / SDF_MESH_CHUNK_EXTENT) * SDF_MESH_CHUNK_EXTENT;
+		m_numChunksPerAxis = (int)(2.f * halfExtent / SDF_MESH_CHUNK_EXTENT + 0.5f);
+		m_numPointsPerAxis = GetNumCellsPerAxis() + 1;
+		m_origin = Vec3(-halfExtent, -halfExtent, -halfExtent);
+
+		int numChunks = m_numChunksPerAxis * m_numChunksPerAxis * m_numChunksPerAxis;
+		m_samples.assign((size_t)m_numPointsPerAxis * m_numPointsPerAxis * m_numPointsPerAxis, SDF_INFINITY_DIST);
+		m_chunks.assign(numChunks, SdfMeshChunk());
+		m_isDirty.assign(numChunks, 1);
+		for (int chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
+		{
+			m_dirtyChunks.push_back(chunkIndex);
+		}
+	}
+	else
+	{
+		for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+		{
+			if (shapeIndex >= numMeshedShapes)
+			{
+				MarkChunksNearSphere(geometry[shapeIndex]);
+				continue;
+			}
+			Vec4 const& oldGeometry = m_meshedGeometry[shapeIndex];
+			Vec4 const& newGeometry = geometry[shapeIndex];
+			if (oldGeometry.x != newGeometry.x || oldGeometry.y != newGeometry.y || oldGeometry.z != newGeometry.z || oldGeometry.w != newGeometry.w)
+			{
+				MarkChunksNearSphere(oldGeometry);
+				MarkChunksNearSphere(newGeometry);
+			}
+		}
+	}
+	m_meshedGeometry = geometry;
+
+	int numDirty = (int)m_dirtyChunks.size();
+	RunMeshJobs(numDirty, jobPool, [&](int i)
+	{
+		SampleChunk(m_dirtyChunks[i], geometry);
+	});
+	m_stats.m_sampleMilliseconds = GetMillisecondsSince(startTime);
+
+	// A chunk reads the samples of its 26 neighbours on its borders
+	auto meshStartTime = std::chrono::steady_clock::now();
+	int numChunksPerAxis = m_numChunksPerAxis;
+	m_isRemeshed.assign(m_chunks.size(), 0);
+	m_remeshedChunks.clear();
+	for (int chunkIndex : m_dirtyChunks)
+	{
+		int chunkX = chunkIndex % numChunksPerAxis;
+		int chunkY = (chunkIndex / numChunksPerAxis) % numChunksPerAxis;
+		int chunkZ = chunkIndex / (numChunksPerAxis * numChunksPerAxis);
+		for (int z = std::max(chunkZ - 1, 0); z <= std::min(chunkZ + 1, numChunksPerAxis - 1); ++z)
+		{
+			for (int y = std::max(chunkY - 1, 0); y <= std::min(chunkY + 1, numChunksPerAxis - 1); ++y)
+			{
+				for (int x = std::max(chunkX - 1, 0); x <= std::min(chunkX + 1, numChunksPerAxis - 1); ++x)
+				{
+					int neighborIndex = (z * numChunksPerAxis + y) * numChunksPerAxis + x;
+					if (!m_isRemeshed[neighborIndex])
+					{
+						m_isRemeshed[neighborIndex] = 1;
+						m_remeshedChunks.push_back(neighborIndex);
+					}
+				}
+			}
+		}
+		m_isDirty[chunkIndex] = 0;
+	}
+	std::sort(m_remeshedChunks.begin(), m_remeshedChunks.end());
+
+	RunMeshJobs((int)m_remeshedChunks.size(), jobPool, [&](int i)
+	{
+		MeshChunk(m_remeshedChunks[i]);
+	});
+	m_stats.m_meshMilliseconds = GetMillisecondsSince(meshStartTime);
+
+	m_stats.m_numChunks = (int)m_chunks.size();
+	m_stats.m_numSampledChunks = numDirty;
+	m_stats.m_numMeshedChunks = (int)m_remeshedChunks.size();
+	m_stats.m_numMeshedTriangles = 0;
+	for (int chunkIndex : m_remeshedChunks)
+	{
+		m_stats.m_numMeshedTriangles += (int)m_chunks[chunkIndex].m_indices.size() / 3;
+	}
+	m_stats.m_numVertices = 0;
+	m_stats.m_numTriangles = 0;
+	for (SdfMeshChunk const& chunk : m_chunks)
+	{
+		m_stats.m_numVertices += (int)chunk.m_vertices.size();
+		m_stats.m_numTriangles += (int)chunk.m_indices.size() / 3;
+	}
+}
+
+void SdfChunkMesher::Clear()
+{
+	m_numChunksPerAxis = 0;
+	m_numPointsPerAxis = 0;
+	m_samples.clear();
+	m_chunks.clear();
+	m_meshedGeometry.clear();
+	m_isDirty.clear();
+	m_dirtyChunks.clear();
+	m_isRemeshed.clear();
+	m_remeshedChunks.clear();
+	m_stats = SdfMesherStats();
+}
+
+void SdfChunkMesher::MarkChunksNearSphere(Vec4 const& geometry)
+{
+	// The same test SampleChunk builds its shape list with, so a chunk left alone keeps its list
+	Vec3 center(geometry.x, geometry.y, geometry.z);
+	float reach = GetShapeReach(geometry.w);
+	int minCoords[3];
+	int maxCoords[3];
+	float centerCoords[3] = { center.x - m_origin.x, center.y - m_origin.y, center.z - m_origin.z };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		minCoords[axis] = std::max((int)floorf((centerCoords[axis] - reach) / SDF_MESH_CHUNK_EXTENT) - 1, 0);
+		maxCoords[axis] = std::min((int)floorf((centerCoords[axis] + reach) / SDF_MESH_CHUNK_EXTENT), m_numChunksPerAxis - 1);
+	}
+	for (int z = minCoords[2]; z <= maxCoords[2]; ++z)
+	{
+		for (int y = minCoords[1]; y <= maxCoords[1]; ++y)
+		{
+			for (int x = minCoords[0]; x <= maxCoords[0]; ++x)
+			{
+				int chunkIndex = (z * m_numChunksPerAxis + y) * m_numChunksPerAxis + x;
+				if (m_isDirty[chunkIndex])
+				{
+					continue;
+				}
+				Vec3 chunkMins;
+				Vec3 chunkMaxs;
+				GetChunkBounds(chunkIndex, chunkMins, chunkMaxs);
+				if (GetDistanceToBox(center, chunkMins, chunkMaxs) <= reach)
+				{
+					m_isDirty[chunkIndex] = 1;
+					m_dirtyChunks.push_back(chunkIndex);
+				}
+			}
+		}
+	}
+}
+
+void SdfChunkMesher::SampleChunk(int chunkIndex, std::vector<Vec4> const& geometry)
+{
+	SdfMeshChunk& chunk = m_chunks[chunkIndex];
+	Vec3 chunkMins;
+	Vec3 chunkMaxs;
+	GetChunkBounds(chunkIndex, chunkMins, chunkMaxs);
+	chunk.m_shapes.clear();
+	for (int shapeIndex = 0; shapeIndex < (int)geometry.size(); ++shapeIndex)
+	{
+		Vec4 const& shapeGeometry = geometry[shapeIndex];
+		if (GetDistanceToBox(Vec3(shapeGeometry.x, shapeGeometry.y, shapeGeometry.z), chunkMins, chunkMaxs) <= GetShapeReach(shapeGeometry.w))
+		{
+			chunk.m_shapes.push_back(shapeIndex);
+		}
+	}
+
+	// The chunk owns its first SDF_MESH_CHUNK_CELLS points per axis, the last chunk the closing one too
+	int numCells = GetNumCellsPerAxis();
+	int beginX = (chunkIndex % m_numChunksPerAxis) * SDF_MESH_CHUNK_CELLS;
+	int beginY = ((chunkIndex / m_numChunksPerAxis) % m_numChunksPerAxis) * SDF_MESH_CHUNK_CELLS;
+	int beginZ = (chunkIndex / (m_numChunksPerAxis * m_numChunksPerAxis)) * SDF_MESH_CHUNK_CELLS;
+	int endX = (beginX + SDF_MESH_CHUNK_CELLS == numCells) ? numCells + 1 : beginX + SDF_MESH_CHUNK_CELLS;
+	int endY = (beginY + SDF_MESH_CHUNK_CELLS == numCells) ? numCells + 1 : beginY + SDF_MESH_CHUNK_CELLS;
+	int endZ = (beginZ + SDF_MESH_CHUNK_CELLS == numCells) ? numCells + 1 : beginZ + SDF_MESH_CHUNK_CELLS;
+	float toleranceK = m_toleranceK;
+	for (int z = beginZ; z < endZ; ++z)
+	{
+		for (int y = beginY; y < endY; ++y)
+		{
+			float* rowSamples = &m_samples[((size_t)z * m_numPointsPerAxis + y) * m_numPointsPerAxis];
+			for (int x = beginX; x < endX; ++x)
+			{
+				Vec3 p = m_origin + Vec3((float)x * SDF_MESH_CELL_SIZE, (float)y * SDF_MESH_CELL_SIZE, (float)z * SDF_MESH_CELL_SIZE);
+				float res = SDF_INFINITY_DIST;
+				for (int shapeIndex : chunk.m_shapes)
+				{
+					res = SminCubic(res, SdfValueFromGeometry(p, geometry[shapeIndex]), toleranceK);
+				}
+				rowSamples[x] = res;
+			}
+		}
+	}
+}
+
+void SdfChunkMesher::MeshChunk(int chunkIndex)
+{
+	SdfMeshChunk& chunk = m_chunks[chunkIndex];
+	chunk.m_vertices.clear();
+	chunk.m_indices.clear();
+
+	int numCells = GetNumCellsPerAxis();
+	int begin[3] = {
+		(chunkIndex % m_numChunksPerAxis) * SDF_MESH_CHUNK_CELLS,
+		((chunkIndex / m_numChunksPerAxis) % m_numChunksPerAxis) * SDF_MESH_CHUNK_CELLS,
+		(chunkIndex / (m_numChunksPerAxis * m_numChunksPerAxis)) * SDF_MESH_CHUNK_CELLS,
+	};
+
+	// One vertex per cell with a sign change, made the first time a quad of this chunk uses it
+	std::vector<int> cellVertices(CELL_SLOTS_PER_AXIS * CELL_SLOTS_PER_AXIS * CELL_SLOTS_PER_AXIS, -1);
+	auto getCellVertex = [&](int const* cell) -> uint32_t
+	{
+		int slot = ((cell[2] - begin[2] + 1) * CELL_SLOTS_PER_AXIS + (cell[1] - begin[1] + 1)) * CELL_SLOTS_PER_AXIS + (cell[0] - begin[0] + 1);
+		if (cellVertices[slot] >= 0)
+		{
+			return (uint32_t)cellVertices[slot];
+		}
+
+		float corners[8];
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			corners[corner] = GetSample(cell[0] + (corner & 1), cell[1] + ((corner >> 1) & 1), cell[2] + (corner >> 2));
+		}
+		Vec3 crossingSum;
+		int numCrossings = 0;
+		for (int edge = 0; edge < 12; ++edge)
+		{
+			int cornerA = CELL_EDGES[edge][0];
+			int cornerB = CELL_EDGES[edge][1];
+			float a = corners[cornerA];
+			float b = corners[cornerB];
+			if ((a < 0.f) == (b < 0.f))
+			{
+				continue;
+			}
+			float t = a / (a - b);
+			Vec3 pointA((float)(cornerA & 1), (float)((cornerA >> 1) & 1), (float)(cornerA >> 2));
+			Vec3 pointB((float)(cornerB & 1), (float)((cornerB >> 1) & 1), (float)(cornerB >> 2));
+			crossingSum += pointA + (pointB - pointA) * t;
+			++numCrossings;
+		}
+		Vec3 cellPoint = crossingSum / (float)numCrossings;
+
+		// Sum of the differences along the four cell edges of each axis
+		Vec3 gradient(
+			(corners[1] - corners[0]) + (corners[3] - corners[2]) + (corners[5] - corners[4]) + (corners[7] - corners[6]),
+			(corners[2] - corners[0]) + (corners[3] - corners[1]) + (corners[6] - corners[4]) + (corners[7] - corners[5]),
+			(corners[4] - corners[0]) + (corners[5] - corners[1]) + (corners[6] - corners[2]) + (corners[7] - corners[3]));
+
+		SdfMeshVertex vertex;
+		vertex.m_position = m_origin + Vec3(((float)cell[0] + cellPoint.x) * SDF_MESH_CELL_SIZE, ((float)cell[1] + cellPoint.y) * SDF_MESH_CELL_SIZE, ((float)cell[2] + cellPoint.z) * SDF_MESH_CELL_SIZE);
+		float gradientLength = gradient.GetLength();
+		vertex.m_normal = (gradientLength > 0.f) ? gradient / gradientLength : Vec3(0.f, 0.f, 1.f);
+		cellVertices[slot] = (int)chunk.m_vertices.size();
+		chunk.m_vertices.push_back(vertex);
+		return (uint32_t)cellVertices[slot];
+	};
+
+	// Every grid edge starting at an owned point gets a quad over its four cells when the field changes sign along it
+	for (int z = begin[2]; z < begin[2] + SDF_MESH_CHUNK_CELLS; ++z)
+	{
+		for (int y = begin[1]; y < begin[1] + SDF_MESH_CHUNK_CELLS; ++y)
+		{
+			for (int x = begin[0]; x < begin[0] + SDF_MESH_CHUNK_CELLS; ++x)
+			{
+				int point[3] = { x, y, z };
+				bool isInside = (GetSample(x, y, z) < 0.f);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					int endPoint[3] = { x, y, z };
+					++endPoint[axis];
+					if (endPoint[axis] > numCells || (GetSample(endPoint[0], endPoint[1], endPoint[2]) < 0.f) == isInside)
+					{
+						continue;
+					}
+					// (axis, u, v) is right-handed, so the cells in this order go counter-clockwise around +axis
+					int u = (axis + 1) % 3;
+					int v = (axis + 2) % 3;
+					if (point[u] == 0 || point[v] == 0 || point[u] == numCells || point[v] == numCells)
+					{
+						continue;
+					}
+					int cells[4][3];
+					for (int corner = 0; corner < 4; ++corner)
+					{
+						cells[corner][0] = x;
+						cells[corner][1] = y;
+						cells[corner][2] = z;
+					}
+					--cells[0][u]; --cells[0][v];
+					--cells[1][v];
+					--cells[3][u];
+					uint32_t quad[4];
+					for (int corner = 0; corner < 4; ++corner)
+					{
+						quad[corner] = getCellVertex(cells[corner]);
+					}
+					// Turned around when the outside lies towards -axis
+					if (!isInside)
+					{
+						std::swap(quad[1], quad[3]);
+					}
+					chunk.m_indices.insert(chunk.m_indices.end(), { quad[0], quad[1], quad[2], quad[0], quad[2], quad[3] });
+				}
+			}
+		}
+	}
+}
+
+void SdfChunkMesher::GetChunkBounds(int chunkIndex, Vec3& out_mins, Vec3& out_maxs) const
+{
+	// Over the owned points and the next chunk's first ones, which also covers the closing points of the last chunk
+	int chunkX = chunkIndex % m_numChunksPerAxis;
+	int chunkY = (chunkIndex / m_numChunksPerAxis) % m_numChunksPerAxis;
+	int chunkZ = chunkIndex / (m_numChunksPerAxis * m_numChunksPerAxis);
+	out_mins = m_origin + Vec3((float)chunkX, (float)chunkY, (float)chunkZ) * SDF_MESH_CHUNK_EXTENT;
+	out_maxs = out_mins + Vec3(SDF_MESH_CHUNK_EXTENT, SDF_MESH_CHUNK_EXTENT, SDF_MESH_CHUNK_EXTENT);
+}
@@ -0,0 +1,102 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+/*
+Isosurface of the smooth-unioned spheres for Mesh Mode, extracted with surface nets (the dual contouring variant
+that puts each vertex at the mean of its cell's edge crossings) over a grid of SDF_MESH_CELL_SIZE cells around the
+activity box, cut into chunks of SDF_MESH_CHUNK_CELLS^3 cells.
+Each chunk samples the grid points it owns with its own shape list, the spheres whose inflated bounds touch it, in
+shape index order: radius + 6k, the widest a cubic smooth union reaches, plus two cells. The field changes at a point
+only when its chunk's list or a listed sphere does, so after an update only the chunks near the previous and current
+sphere of every moved shape are resampled, and re-sampling a chunk gives the samples a full rebuild would.
+A chunk meshes the edges starting at its points and reads the cells one layer past them, so it is re-meshed when it
+or a neighbour was resampled. Vertices of a cell shared by two chunks come from the same samples and are bit-exact,
+the chunk meshes meet without cracks. Triangles wind counter-clockwise seen from outside, normals are the sampled
+gradient.
+Both passes run one chunk per job on a JobPool.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_MESH_CHUNK_CELLS = 16;
+constexpr float SDF_MESH_CELL_SIZE = 0.125f; // SDF_BRICK_VOXEL_SIZE
+constexpr float SDF_MESH_CHUNK_EXTENT = SDF_MESH_CHUNK_CELLS * SDF_MESH_CELL_SIZE;
+
+
+struct SdfMeshVertex
+{
+	Vec3 m_position;
+	Vec3 m_normal;
+};
+
+
+struct SdfMeshChunk
+{
+	std::vector<SdfMeshVertex> m_vertices;
+	std::vector<uint32_t> m_indices; // into m_vertices, three per triangle
+	std::vector<int> m_shapes; // shape indices within reach, ascending
+};
+
+
+struct SdfMesherStats
+{
+	int m_numChunks = 0;
+	int m_numSampledChunks = 0; // last update
+	int m_numMeshedChunks = 0; // last update
+	int m_numMeshedTriangles = 0; // last update, in the re-meshed chunks
+	int m_numVertices = 0;
+	int m_numTriangles = 0;
+	double m_sampleMilliseconds = 0.0; // last update
+	double m_meshMilliseconds = 0.0; // last update
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfChunkMesher
+{
+public:
+	// geometry: center.xyz + radius in shape index order, new shapes appended.
+	// The first call, fewer shapes, a new toleranceK or isFullRemesh rebuilds every chunk.
+	void Update(std::vector<Vec4> const& geometry, float toleranceK, JobPool* jobPool, bool isFullRemesh = false);
+	void Clear();
+
+	bool IsEmpty() const { return m_chunks.empty(); }
+	int GetNumChunksPerAxis() const { return m_numChunksPerAxis; }
+	int GetNumCellsPerAxis() const { return m_numChunksPerAxis * SDF_MESH_CHUNK_CELLS; }
+	Vec3 const& GetOrigin() const { return m_origin; }
+	std::vector<SdfMeshChunk> const& GetChunks() const { return m_chunks; }
+	std::vector<int> const& GetRemeshedChunks() const { return m_remeshedChunks; } // last update, ascending
+	SdfMesherStats const& GetStats() const { return m_stats; }
+
+	float GetShapeReach(float radius) const { return radius + 6.f * m_toleranceK + 2.f * SDF_MESH_CELL_SIZE; }
+
+private:
+	void MarkChunksNearSphere(Vec4 const& geometry);
+	void SampleChunk(int chunkIndex, std::vector<Vec4> const& geometry);
+	void MeshChunk(int chunkIndex);
+	void GetChunkBounds(int chunkIndex, Vec3& out_mins, Vec3& out_maxs) const;
+	float GetSample(int x, int y, int z) const { return m_samples[((size_t)z * m_numPointsPerAxis + y) * m_numPointsPerAxis + x]; }
+
+private:
+	int m_numChunksPerAxis = 0;
+	int m_numPointsPerAxis = 0; // cells + 1
+	Vec3 m_origin;
+	float m_toleranceK = 0.f;
+
+	std::vector<float> m_samples; // every grid point, x fastest
+	std::vector<SdfMeshChunk> m_chunks; // x fastest
+
+	std::vector<Vec4> m_meshedGeometry; // geometry of the previous update, for the dirty chunks
+	std::vector<uint8_t> m_isDirty;
+	std::vector<int> m_dirtyChunks;
+	std::vector<uint8_t> m_isRemeshed;
+	std::vector<int> m_remeshedChunks;
+
+	SdfMesherStats m_stats;
+};
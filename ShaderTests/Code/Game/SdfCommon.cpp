@@ -0,0 +1,192 @@
+#include "Game/SdfCommon.hpp"
+
+#include <cstring>
+
+
+SdfShape SdfShape::MakeSphere(Vec3 center, float radius, Rgba8 color /*= Rgba8::OPAQUE_WHITE*/, uint16_t materialID /*= 0*/)
+{
+	SdfShape result;
+
+	result.m_type = SDF_SPHERE;
+	result.m_materialID = materialID;
+	result.m_data0 = Vec4(center.x, center.y, center.z, radius);
+	result.m_color = color;
+
+	return result;
+}
+
+SdfShape SdfShape::MakeBakedGrid(Vec3 position, float scale, uint16_t gridIndex, Rgba8 color /*= Rgba8::OPAQUE_WHITE*/, uint16_t materialID /*= 0*/)
+{
+	SdfShape result;
+
+	result.m_type = SDF_BAKED_GRID;
+	result.m_materialID = materialID;
+	result.m_data0 = Vec4(position.x, position.y, position.z, scale);
+	result.m_gridIndex = gridIndex;
+	result.m_color = color;
+
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfShapeStreams::Clear()
+{
+	m_geometry.clear();
+	m_geometryHalf.clear();
+	m_shapeMaterials.clear();
+}
+
+void SdfShapeStreams::Reserve(int numShapes)
+{
+	m_geometry.reserve(numShapes);
+	m_geometryHalf.reserve(numShapes);
+	m_shapeMaterials.reserve(numShapes);
+}
+
+void SdfShapeStreams::AddShape(SdfShape const& shape)
+{
+	SdfShapeGeometry geometry;
+	geometry.m_data0 = shape.m_data0;
+	m_geometry.push_back(geometry);
+
+	SdfShapeGeometryHalf geometryHalf;
+	geometryHalf.m_data0[0] = FloatToHalf(shape.m_data0.x);
+	geometryHalf.m_data0[1] = FloatToHalf(shape.m_data0.y);
+	geometryHalf.m_data0[2] = FloatToHalf(shape.m_data0.z);
+	geometryHalf.m_data0[3] = FloatToHalf(shape.m_data0.w);
+	m_geometryHalf.push_back(geometryHalf);
+
+	SdfShapeMaterial material;
+	material.m_type = shape.m_type;
+	material.m_materialID = shape.m_materialID;
+	material.m_color = (uint32_t)shape.m_color.r | ((uint32_t)shape.m_color.g << 8) | ((uint32_t)shape.m_color.b << 16) | ((uint32_t)shape.m_color.a << 24);
+	m_shapeMaterials.push_back(material);
+}
+
+void SdfShapeStreams::SetShapes(std::vector<SdfShape> const& shapes)
+{
+	Clear();
+	Reserve((int)shapes.size());
+	for (SdfShape const& shape : shapes)
+	{
+		AddShape(shape);
+	}
+}
+
+Vec4 SdfShapeStreams::GetGeometry(int shapeIndex, bool isHalfPrecision) const
+{
+	if (isHalfPrecision)
+	{
+		uint16_t const* data0 = m_geometryHalf[shapeIndex].m_data0;
+		return Vec4(HalfToFloat(data0[0]), HalfToFloat(data0[1]), HalfToFloat(data0[2]), HalfToFloat(data0[3]));
+	}
+	return m_geometry[shapeIndex].m_data0;
+}
+
+Rgba8 SdfShapeStreams::GetColor(int shapeIndex) const
+{
+	uint32_t color = m_shapeMaterials[shapeIndex].m_color;
+	return Rgba8((unsigned char)(color & 0xFF), (unsigned char)((color >> 8) & 0xFF), (unsigned char)((color >> 16) & 0xFF), (unsigned char)(color >> 24));
+}
+
+void const* SdfShapeStreams::GetGeometryData(bool isHalfPrecision) const
+{
+	if (isHalfPrecision)
+	{
+		return m_geometryHalf.data();
+	}
+	return m_geometry.data();
+}
+
+size_t SdfShapeStreams::GetGeometryStride(bool isHalfPrecision)
+{
+	return isHalfPrecision ? sizeof(SdfShapeGeometryHalf) : sizeof(SdfShapeGeometry);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+uint16_t FloatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t exponent = (bits >> 23) & 0xFFu;
+	uint32_t mantissa = bits & 0x7FFFFFu;
+
+	// Inf / NaN
+	if (exponent == 0xFFu)
+	{
+		return (uint16_t)(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+	}
+
+	int halfExponent = (int)exponent - 127 + 15;
+	if (halfExponent >= 31)
+	{
+		return (uint16_t)(sign | 0x7C00u);
+	}
+
+	if (halfExponent <= 0)
+	{
+		// Subnormal half, or zero
+		if (halfExponent < -10)
+		{
+			return (uint16_t)sign;
+		}
+		mantissa |= 0x800000u;
+		uint32_t shift = (uint32_t)(14 - halfExponent);
+		uint32_t halfMantissa = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1u);
+		uint32_t halfway = 1u << (shift - 1u);
+		if (remainder > halfway || (remainder == halfway && (halfMantissa & 1u)))
+		{
+			++halfMantissa;
+		}
+		return (uint16_t)(sign | halfMantissa);
+	}
+
+	uint32_t half = sign | ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+	uint32_t remainder = mantissa & 0x1FFFu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+	{
+		++half; // may carry into the exponent, which is still correct
+	}
+	return (uint16_t)half;
+}
+
+float HalfToFloat(uint16_t value)
+{
+	uint32_t sign = ((uint32_t)value & 0x8000u) << 16;
+	uint32_t exponent = ((uint32_t)value >> 10) & 0x1Fu;
+	uint32_t mantissa = (uint32_t)value & 0x3FFu;
+
+	uint32_t bits;
+	if (exponent == 0x1Fu)
+	{
+		bits = sign | 0x7F800000u | (mantissa << 13);
+	}
+	else if (exponent != 0)
+	{
+		bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+	}
+	else if (mantissa == 0)
+	{
+		bits = sign;
+	}
+	else
+	{
+		// Subnormal half -> normal float
+		exponent = 127 - 15 + 1;
+		while ((mantissa & 0x400u) == 0)
+		{
+			mantissa <<= 1;
+			--exponent;
+		}
+		bits = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+	}
+
+	float result;
+	memcpy(&result, &bits, sizeof(result));
+	return result;
+}
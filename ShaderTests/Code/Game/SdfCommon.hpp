@@ -0,0 +1,241 @@
+#pragma once
+#include "Engine/Core/EngineCommon.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+#include "Engine/Renderer/RendererCommon.hpp"
+
+#include <vector>
+
+//-----------------------------------------------------------------------------------------------
+// Data shared by the GPU ray marcher (SdfRayMarching.hlsl) and the CPU reference.
+// Only depends on Engine math and RendererCommon types so the CPU paths can be built headless.
+//-----------------------------------------------------------------------------------------------
+
+// Scene limits shared by GameRayMarching and the headless benchmarks
+constexpr float MIN_OBJECT_SPEED = 0.5f;
+constexpr float MAX_OBJECT_SPEED = 1.5f;
+constexpr float MIN_SPHERE_RADIUS = 0.5f;
+constexpr float MAX_SPHERE_RADIUS = 1.5f;
+constexpr float ACTIVITY_BOX_RADIUS = 5.f;
+
+
+// Authoring description of a shape. Not uploaded as is: SdfShapeStreams packs it into the
+// GPU layout below, so SdfMap only strides over the geometry it needs.
+struct SdfShape
+{
+	// Type: Sphere, or a baked mesh (SdfMeshBaker.hpp) that only SdfCsgTree::AddShapes places, the streams take spheres
+	// Color: 
+	// Bool Operation: Union Only, SdfCsgTree (SdfCsg.hpp) has the others
+	// Orientation(Quaternion): Spheres do not need this
+
+	enum
+	{
+		SDF_SPHERE = 0,
+		SDF_BAKED_GRID = 1,
+	};
+
+
+	uint16_t m_type = SDF_SPHERE;
+	uint16_t m_materialID = 0; // index into the SdfMaterial table
+	Rgba8 m_color = Rgba8::OPAQUE_WHITE;
+	Vec4 m_data0; // center.xyz + radius; baked grid: mesh origin position.xyz + scale
+	uint16_t m_gridIndex = 0; // baked grid: index into the grids given to SdfCsgTree::AddShapes
+
+	static SdfShape MakeSphere(Vec3 center, float radius, Rgba8 color = Rgba8::OPAQUE_WHITE, uint16_t materialID = 0);
+	static SdfShape MakeBakedGrid(Vec3 position, float scale, uint16_t gridIndex, Rgba8 color = Rgba8::OPAQUE_WHITE, uint16_t materialID = 0);
+
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Notes: the structs below must be same as the structs in hlsl
+//
+// Hot stream, the only data SdfMap reads. Spheres only: other shape types get a stream of their own.
+struct SdfShapeGeometry
+{
+	Vec4 m_data0; // center.xyz + radius
+};
+
+// Same as SdfShapeGeometry in float16 (f16tof32 in hlsl), used when halfPrecisionGeometry is set
+struct SdfShapeGeometryHalf
+{
+	uint16_t m_data0[4]; // center.xyz + radius
+};
+
+// Cold stream, only read when shading a hit
+struct SdfShapeMaterial
+{
+	uint16_t m_type = SdfShape::SDF_SPHERE;
+	uint16_t m_materialID = 0;
+	uint32_t m_color = 0xFFFFFFFF; // RGBA8, r in the lowest byte
+};
+
+// Shared by every shape with the same m_materialID
+struct SdfMaterial
+{
+	uint32_t m_triAlbedoTexID = INVALID_INDEX_U32;
+	uint32_t m_triMRTexID = INVALID_INDEX_U32;
+	uint32_t m_triNormalTexID = INVALID_INDEX_U32;
+	uint32_t m_triOcclusionTexID = INVALID_INDEX_U32;
+
+	uint32_t m_triEmissiveTexID = INVALID_INDEX_U32;
+	uint32_t m_padding0 = 0;
+	uint32_t m_padding1 = 0;
+	uint32_t m_padding2 = 0;
+};
+
+
+// CPU side of the three shape buffers. Both geometry streams are kept so the precision can be
+// switched without repacking; only the one selected by halfPrecisionGeometry is uploaded.
+struct SdfShapeStreams
+{
+	std::vector<SdfShapeGeometry> m_geometry;
+	std::vector<SdfShapeGeometryHalf> m_geometryHalf;
+	std::vector<SdfShapeMaterial> m_shapeMaterials;
+
+	void Clear();
+	void Reserve(int numShapes);
+	void AddShape(SdfShape const& shape);
+	void SetShapes(std::vector<SdfShape> const& shapes);
+
+	int GetNumShapes() const { return (int)m_geometry.size(); }
+	Vec4 GetGeometry(int shapeIndex, bool isHalfPrecision) const; // decoded center.xyz + radius
+	Rgba8 GetColor(int shapeIndex) const;
+
+	void const* GetGeometryData(bool isHalfPrecision) const;
+	static size_t GetGeometryStride(bool isHalfPrecision);
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// IEEE float16, round to nearest even like f32tof16
+uint16_t FloatToHalf(float value);
+float HalfToFloat(uint16_t value);
+
+
+// What a dispatch of SdfRayMarching.hlsl computes, SdfRayMarchingResources::prePass
+constexpr uint32_t SDF_PREPASS_NONE = 0; // full-res march
+constexpr uint32_t SDF_PREPASS_CONE_DEPTH = 1; // writes coneDepthIndex
+constexpr uint32_t SDF_PREPASS_TEMPORAL_CLEAR = 2; // resets temporalStartIndex
+constexpr uint32_t SDF_PREPASS_TEMPORAL_SCATTER = 3; // splats the previous frame's outputDepthIndex into temporalStartIndex
+constexpr uint32_t SDF_PREPASS_COST_CLEAR = 4; // resets costStatsIndex before the march
+constexpr uint32_t SDF_PREPASS_COST_REDUCE = 5; // step histogram and totals of costCountersIndex into costStatsIndex, after the last pass
+constexpr uint32_t SDF_PREPASS_SHADE_CLEAR = 6; // resets shadeBinsIndex before the deferred march counts into it
+constexpr uint32_t SDF_PREPASS_SHADE_PREFIX = 7; // bin counts of shadeBinsIndex into bin offsets, one thread group
+constexpr uint32_t SDF_PREPASS_SHADE_SCATTER = 8; // hit pixels into shadePixelsIndex, grouped by bin
+constexpr uint32_t SDF_PREPASS_SHADE = 9; // materials and lighting of the G-buffer, one thread per shadePixelsIndex slot
+constexpr uint32_t SDF_PREPASS_BACKGROUND_FILL = 10; // what a miss writes, over the background tiles of inputTileListIndex
+constexpr uint32_t SDF_PREPASS_SHADE_COUNT = 11; // hits shaded at shadingRate into shadeBinsIndex, the march counts them otherwise
+constexpr uint32_t SDF_PREPASS_SHADE_RESOLVE = 12; // the pixels reusing their block's shading copy it
+
+struct SdfRayMarchingResources
+{
+	uint32_t engineConstantsIndex = INVALID_INDEX_U32;
+	uint32_t cameraConstantsIndex = INVALID_INDEX_U32;
+	uint32_t modelConstantsIndex = INVALID_INDEX_U32;
+	uint32_t lightConstantsIndex = INVALID_INDEX_U32;
+	uint32_t perFrameConstantsIndex = INVALID_INDEX_U32;
+
+	uint32_t inputSdfGeometryIndex = INVALID_INDEX_U32; // StructuredBuffer<float4> or StructuredBuffer<uint2> (half)
+	uint32_t outputTextureIndex = INVALID_INDEX_U32; // RWTexture2D<float4>
+	uint32_t outputDepthIndex = INVALID_INDEX_U32; // RWTexture2D<float>
+	uint32_t rayMarchingConstantsIndex = INVALID_INDEX_U32;
+	uint32_t inputSdfShapeMaterialsIndex = INVALID_INDEX_U32; // StructuredBuffer<uint2>
+	uint32_t inputSdfMaterialsIndex = INVALID_INDEX_U32; // StructuredBuffer<SdfMaterial>
+	uint32_t inputSdfBvhIndex = INVALID_INDEX_U32; // StructuredBuffer<SdfBvhNode>
+	uint32_t inputTileRangesIndex = INVALID_INDEX_U32; // StructuredBuffer<uint2> offset + count per tile
+	uint32_t inputTileShapeIndicesIndex = INVALID_INDEX_U32; // StructuredBuffer<uint>
+	uint32_t inputBricksIndex = INVALID_INDEX_U32; // StructuredBuffer<SdfBrick>
+	uint32_t inputBrickSamplesIndex = INVALID_INDEX_U32; // StructuredBuffer<float>
+	uint32_t coneDepthIndex = INVALID_INDEX_U32; // RWTexture2D<float> quarter-res start distances
+	uint32_t temporalStartIndex = INVALID_INDEX_U32; // RWTexture2D<uint> nearest reprojected distance per pixel
+	uint32_t costCountersIndex = INVALID_INDEX_U32; // RWTexture2D<uint4> per-pixel cost, see SdfCostCounters.hpp
+	uint32_t costStatsIndex = INVALID_INDEX_U32; // RWTexture2D<uint> SDF_COST_STATS_SIZE x 1
+	uint32_t gbufferIndex = INVALID_INDEX_U32; // RWTexture2D<float4> normal.xyz + hit distance, see SdfDeferredShading.hpp
+	uint32_t gbufferShapesIndex = INVALID_INDEX_U32; // RWTexture2D<uint4> shapes to blend
+	uint32_t shadeBinsIndex = INVALID_INDEX_U32; // RWTexture2D<uint> SDF_SHADE_BINS x 2: counts, then offsets / scatter cursors
+	uint32_t shadePixelsIndex = INVALID_INDEX_U32; // RWTexture2D<uint> screen sized, x | y << 16 of the hits in bin order
+	uint32_t inputCsgProgramIndex = INVALID_INDEX_U32; // StructuredBuffer<SdfCsgInstruction>
+	uint32_t inputTileListIndex = INVALID_INDEX_U32; // StructuredBuffer<uint> x | y << 16, occupied tiles then background tiles
+	uint32_t inputCsgGridSamplesIndex = INVALID_INDEX_U32; // StructuredBuffer<float> baked grids of the CSG program, SdfCsgProgram::m_gridSamples
+	uint32_t prePass = SDF_PREPASS_NONE;
+};
+
+struct SdfRayMarchingConstants
+{
+	int maxSteps = 100;
+	float minHitDistance = 0.001f;
+	float maxTraceDistance = 1000.f;
+	float toleranceK = 0.5f;
+
+	int numOfShapes = 0;
+	int screenWidth = 0;
+	int screenHeight = 0;
+	int halfPrecisionGeometry = 0; // geometry stream is SdfShapeGeometryHalf
+
+	float triplanarUVScale = 1.f;
+	float triplanarBlendSharpness = 1.f;
+	int useBvh = 1; // SdfMap and GetWeightedSurfaceData traverse the SdfBvhNode buffer instead of every shape
+	int numOfBvhNodes = 0;
+
+	int useTileBinning = 0; // SdfMap and GetWeightedSurfaceData only visit the shapes binned to the thread group's tile
+	int numOfTilesX = 0;
+	int useConeDepthPrepass = 0; // ComputeMain starts each ray at the distance of the quarter-res cone pre-pass
+	int padding1 = 0;
+
+	int useBrickMap = 0; // RayMarch steps on the SdfBrickMap bound far from surfaces
+	int brickGridSize = 0;
+	float brickOdometer = 0.f;
+	float brickBlendLowering = 0.f;
+
+	Vec3 brickMapOrigin;
+	float padding2 = 0.f;
+
+	Vec3 shapeBoundsMin; // every sphere is inside, bounds rays outside the brick grid
+	float padding3 = 0.f;
+
+	Vec3 shapeBoundsMax;
+	float padding4 = 0.f;
+
+	int useTemporalReprojection = 0; // ComputeMain starts rays at the previous frame's depth, reprojected and validated
+	int hasTemporalHistory = 0; // the depth texture still holds the previous frame, seen from the prevCamera below
+	float temporalMaxShapeMove = 0.f; // largest shape move since the previous frame
+	float padding5 = 0.f;
+
+	Vec3 cameraForward;
+	float tanHalfFovX = 0.f;
+	Vec3 cameraLeft;
+	float tanHalfFovY = 0.f;
+	Vec3 cameraUp;
+	float padding6 = 0.f;
+
+	Vec3 prevCameraPosition;
+	float prevCameraNear = 0.f;
+	Vec3 prevCameraForward;
+	float prevCameraFar = 0.f;
+	Vec3 prevCameraLeft;
+	float prevTanHalfFovX = 0.f;
+	Vec3 prevCameraUp;
+	float prevTanHalfFovY = 0.f;
+
+	int useOverRelaxation = 0; // RayMarch steps overRelaxationOmega * distance, plain steps while the spheres stop overlapping
+	float overRelaxationOmega = 1.6f;
+	int useCostCounters = 0; // the march writes costCountersIndex, reduced into costStatsIndex
+	int costHistogramBinWidth = 1; // SdfCostStats::GetHistogramBinWidth(maxSteps)
+
+	int useTopKMaterials = 0; // GetWeightedSurfaceData samples only the SDF_TOPK_MATERIALS heaviest shapes within 3k
+	float topKMinWeight = 0.05f; // share of the kept weight under which a shape is dropped before the blend
+	int useAnalyticNormals = 1; // hit normals from SdfMapGradient in one scene pass, SdfNormalTetra (4 passes) otherwise
+	int useDeferredShading = 0; // the march writes the G-buffer textures, the SHADE passes sort the hits by material set and shade them
+
+	int useCsgProgram = 0; // SdfMap runs the CSG program of inputCsgProgramIndex (SdfCsg.hpp) instead of blending the shapes, which only shade
+	int numCsgInstructions = 0;
+	int useTileClassification = 0; // the march only covers the occupied tiles of inputTileListIndex (SdfTileClassification.hpp), BACKGROUND_FILL the rest
+	int numOccupiedTiles = 0; // the tile list's first ones, the background tiles follow
+
+	int numBackgroundTiles = 0;
+	int shadingRate = 1; // deferred only: shading blocks of shadingRate^2 pixels, see GetSdfShadingSource in SdfDeferredShading.hpp
+	float shadingDepthTolerance = 0.01f; // relative hit distance change within a block that still reuses its shading
+	float shadingNormalThreshold = 0.95f; // smallest normal dot product within a block that still reuses its shading
+};
@@ -0,0 +1,75 @@
+#include "Game/SdfCostCounters.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfCostStats::AddPixel(int numSteps, int numSdfMapCalls, int numMaterialEvaluations)
+{
+	int bin = std::min(numSteps / m_histogramBinWidth, SDF_COST_HISTOGRAM_BINS - 1);
+	++m_stepHistogram[bin];
+	++m_numPixels;
+	m_numSteps += numSteps;
+	m_numSdfMapCalls += numSdfMapCalls;
+	m_numMaterialEvaluations += numMaterialEvaluations;
+	m_maxSteps = std::max(m_maxSteps, numSteps);
+	m_maxSdfMapCalls = std::max(m_maxSdfMapCalls, numSdfMapCalls);
+}
+
+int SdfCostStats::GetStepPercentile(float fraction) const
+{
+	int64_t target = (int64_t)((double)fraction * (double)m_numPixels);
+	int64_t numPixelsBelow = 0;
+	for (int bin = 0; bin < SDF_COST_HISTOGRAM_BINS; ++bin)
+	{
+		numPixelsBelow += m_stepHistogram[bin];
+		if (numPixelsBelow > target)
+		{
+			return std::min((bin + 1) * m_histogramBinWidth - 1, m_maxSteps);
+		}
+	}
+	return m_maxSteps;
+}
+
+int SdfCostStats::GetHistogramBinWidth(int maxSteps)
+{
+	return std::max((maxSteps + SDF_COST_HISTOGRAM_BINS) / SDF_COST_HISTOGRAM_BINS, 1);
+}
+
+SdfCostStats SdfCostStats::FromImage(SdfCpuImage const& image, int maxSteps)
+{
+	SdfCostStats stats;
+	stats.m_histogramBinWidth = GetHistogramBinWidth(maxSteps);
+	for (size_t pixelIndex = 0; pixelIndex < image.m_stepCounts.size(); ++pixelIndex)
+	{
+		stats.AddPixel(image.m_stepCounts[pixelIndex], image.m_sdfMapCounts[pixelIndex], image.m_materialCounts[pixelIndex]);
+	}
+	return stats;
+}
+
+SdfCostStats SdfCostStats::FromGpuStats(uint32_t const* stats, int maxSteps)
+{
+	SdfCostStats result;
+	result.m_histogramBinWidth = GetHistogramBinWidth(maxSteps);
+	for (int bin = 0; bin < SDF_COST_HISTOGRAM_BINS; ++bin)
+	{
+		result.m_stepHistogram[bin] = (int)stats[bin];
+	}
+	result.m_numPixels = (int)stats[SDF_COST_STAT_NUM_PIXELS];
+	result.m_numSteps = stats[SDF_COST_STAT_NUM_STEPS];
+	result.m_numSdfMapCalls = stats[SDF_COST_STAT_NUM_SDF_MAP_CALLS];
+	result.m_numMaterialEvaluations = stats[SDF_COST_STAT_NUM_MATERIAL_EVALUATIONS];
+	result.m_maxSteps = (int)stats[SDF_COST_STAT_MAX_STEPS];
+	result.m_maxSdfMapCalls = (int)stats[SDF_COST_STAT_MAX_SDF_MAP_CALLS];
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vec3 GetSdfCostHeatmapColor(int count, int maxCount)
+{
+	float t = std::min((float)count / (float)std::max(maxCount, 1), 1.f);
+	auto ramp = [](float x) { return std::min(std::max(1.5f - fabsf(x), 0.f), 1.f); };
+	return Vec3(ramp(4.f * t - 3.f), ramp(4.f * t - 2.f), ramp(4.f * t - 1.f));
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <cstdint>
+
+/*
+Per-pixel cost of the marcher: RayMarch steps, SdfMap calls and material evaluations (shapes close enough to a hit
+for GetWeightedSurfaceData to sample their textures). The compute shader counts them per thread and, when
+useCostCounters is set, writes them to a uint4 texture for the heatmaps. CostReducePass folds that into
+SDF_COST_STATS_SIZE uints, a step histogram and the totals (FromGpuStats), but the Engine has no GPU readback yet, so
+the game does not dispatch it. SdfCpuImage keeps the same counts per pixel and SdfCostStats::FromImage reduces them
+the same way: the game's stats and the benchmark's come from the CPU reference.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_COST_HISTOGRAM_BINS = 32; // SDF_COST_HISTOGRAM_BINS in SdfRayMarching.hlsl
+constexpr int SDF_COST_STATS_SIZE = 64; // SDF_COST_STATS_SIZE in SdfRayMarching.hlsl, uints in the stats texture: one 256 byte row
+// Stats texture layout after the histogram bins, same as SDF_COST_STAT_* in SdfRayMarching.hlsl
+constexpr int SDF_COST_STAT_NUM_PIXELS = 32;
+constexpr int SDF_COST_STAT_NUM_STEPS = 33;
+constexpr int SDF_COST_STAT_NUM_SDF_MAP_CALLS = 34;
+constexpr int SDF_COST_STAT_NUM_MATERIAL_EVALUATIONS = 35;
+constexpr int SDF_COST_STAT_MAX_STEPS = 36;
+constexpr int SDF_COST_STAT_MAX_SDF_MAP_CALLS = 37;
+
+// Heatmap debug views, chosen with the debug int like the surface views 1-4
+constexpr int SDF_COST_HEATMAP_STEPS = 5; // scaled to maxSteps
+constexpr int SDF_COST_HEATMAP_SDF_MAP_CALLS = 6; // scaled to maxSteps
+constexpr int SDF_COST_HEATMAP_MATERIAL_EVALUATIONS = 7; // scaled to SDF_COST_HEATMAP_MAX_MATERIALS
+constexpr int SDF_COST_HEATMAP_MAX_MATERIALS = 8;
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfCostStats
+{
+	int m_numPixels = 0;
+	int64_t m_numSteps = 0;
+	int64_t m_numSdfMapCalls = 0;
+	int64_t m_numMaterialEvaluations = 0;
+	int m_maxSteps = 0;
+	int m_maxSdfMapCalls = 0;
+	int m_histogramBinWidth = 1; // steps per bin, the last bin also holds everything above
+	int m_stepHistogram[SDF_COST_HISTOGRAM_BINS] = {};
+
+	void AddPixel(int numSteps, int numSdfMapCalls, int numMaterialEvaluations); // same as CostReducePass
+	int GetStepPercentile(float fraction) const; // upper edge of the bin holding it, in steps
+	double GetStepsPerPixel() const { return (double)m_numSteps / (double)(m_numPixels > 0 ? m_numPixels : 1); }
+	double GetSdfMapCallsPerPixel() const { return (double)m_numSdfMapCalls / (double)(m_numPixels > 0 ? m_numPixels : 1); }
+	double GetMaterialEvaluationsPerPixel() const { return (double)m_numMaterialEvaluations / (double)(m_numPixels > 0 ? m_numPixels : 1); }
+
+	// Bins cover 0 to maxSteps, the same width the shader gets in costHistogramBinWidth
+	static int GetHistogramBinWidth(int maxSteps);
+	static SdfCostStats FromImage(SdfCpuImage const& image, int maxSteps);
+	static SdfCostStats FromGpuStats(uint32_t const* stats, int maxSteps); // SDF_COST_STATS_SIZE uints of the stats texture
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Blue to red, same as GetCostHeatmapColor in SdfRayMarching.hlsl
+Vec3 GetSdfCostHeatmapColor(int count, int maxCount);
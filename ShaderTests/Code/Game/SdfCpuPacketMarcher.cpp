@@ -0,0 +1,258 @@
+#include "Game/SdfCpuPacketMarcher.hpp"
+#include "Game/SdfSimd.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+// Packet storage is padded to whole SIMD registers; lanes past numRays start retired
+static constexpr int MAX_PACKET_LANES = ((SDF_MAX_PACKET_SIZE + SDF_SIMD_WIDTH - 1) / SDF_SIMD_WIDTH) * SDF_SIMD_WIDTH;
+static constexpr int MAX_PACKET_CHUNKS = MAX_PACKET_LANES / SDF_SIMD_WIDTH;
+
+// res is only trusted for culling once every lane has seen a real shape
+static constexpr float CULL_RES_LIMIT = 1e30f;
+// Covers the rounding of the scalar bound test
+static constexpr float CULL_EPSILON = 1e-4f;
+
+
+//-----------------------------------------------------------------------------------------------
+SdfCpuPacketMarcher::SdfCpuPacketMarcher(SdfCpuRayMarcher const& scene, int packetSize)
+	: m_scene(scene)
+	, m_packetSize(GetClamped(packetSize, 1, SDF_MAX_PACKET_SIZE))
+{
+	m_packetDimensions.x = (m_packetSize >= 8) ? 4 : ((m_packetSize >= 2) ? 2 : 1);
+	m_packetDimensions.y = m_packetSize / m_packetDimensions.x;
+
+	SdfShapeStreams const& streams = m_scene.GetShapeStreams();
+	const bool isHalfPrecision = m_scene.IsHalfPrecisionGeometry();
+	for (int shapeIndex = 0; shapeIndex < streams.GetNumShapes(); ++shapeIndex)
+	{
+		Vec4 geometry = streams.GetGeometry(shapeIndex, isHalfPrecision);
+		m_centerX.push_back(geometry.x);
+		m_centerY.push_back(geometry.y);
+		m_centerZ.push_back(geometry.z);
+		m_radius.push_back(geometry.w);
+	}
+}
+
+void SdfCpuPacketMarcher::MarchPacket(Vec3 const* rayStartPositions, Vec3 const* rayFwdNormals, int numRays, float* out_distances, SdfCpuRayCounters& counters) const
+{
+	SdfRayMarchingConstants const& constants = m_scene.GetConstants();
+	const int maxSteps = constants.maxSteps;
+	const float minHitDistance = constants.minHitDistance;
+	const float maxTraceDistance = constants.maxTraceDistance;
+	const float toleranceK = constants.toleranceK;
+	const float cullMargin = 6.f * toleranceK + CULL_EPSILON;
+	const int numShapes = (int)m_radius.size();
+
+	alignas(32) float posX[MAX_PACKET_LANES];
+	alignas(32) float posY[MAX_PACKET_LANES];
+	alignas(32) float posZ[MAX_PACKET_LANES];
+	alignas(32) float res[MAX_PACKET_LANES];
+	alignas(32) float activeMask[MAX_PACKET_LANES];
+	float distTraveled[MAX_PACKET_LANES];
+	bool isActive[MAX_PACKET_LANES];
+
+	for (int lane = 0; lane < MAX_PACKET_LANES; ++lane)
+	{
+		isActive[lane] = (lane < numRays);
+		distTraveled[lane] = 0.f;
+		posX[lane] = posY[lane] = posZ[lane] = 0.f;
+	}
+
+	int numChunks = (numRays + SDF_SIMD_WIDTH - 1) / SDF_SIMD_WIDTH;
+	int numActive = numRays;
+
+	for (int step = 0; step < maxSteps && numActive > 0; ++step)
+	{
+		counters.m_numSteps += numActive;
+
+		// Sample positions and a bounding sphere of the active lanes
+		Vec3 boundsCenter;
+		for (int lane = 0; lane < numRays; ++lane)
+		{
+			activeMask[lane] = isActive[lane] ? 1.f : 0.f;
+			if (!isActive[lane])
+			{
+				continue;
+			}
+			Vec3 currPos = rayStartPositions[lane] + rayFwdNormals[lane] * distTraveled[lane];
+			posX[lane] = currPos.x;
+			posY[lane] = currPos.y;
+			posZ[lane] = currPos.z;
+			boundsCenter += currPos;
+		}
+		boundsCenter /= (float)numActive;
+
+		float boundsRadiusSquared = 0.f;
+		for (int lane = 0; lane < numRays; ++lane)
+		{
+			if (isActive[lane])
+			{
+				Vec3 offset = Vec3(posX[lane], posY[lane], posZ[lane]) - boundsCenter;
+				boundsRadiusSquared = fmaxf(boundsRadiusSquared, offset.GetLengthSquared());
+			}
+		}
+		float boundsRadius = sqrtf(boundsRadiusSquared);
+
+		SimdFloat chunkActive[MAX_PACKET_CHUNKS];
+		int chunkBits[MAX_PACKET_CHUNKS];
+		for (int chunk = 0; chunk < numChunks; ++chunk)
+		{
+			chunkActive[chunk] = SimdGreater(SimdLoad(&activeMask[chunk * SDF_SIMD_WIDTH]), SimdSet1(0.5f));
+			chunkBits[chunk] = SimdMoveMask(chunkActive[chunk]);
+			SimdStore(&res[chunk * SDF_SIMD_WIDTH], SimdSet1(SDF_INFINITY_DIST));
+		}
+
+		// SdfMap for every lane at once
+		float maxRes = SDF_INFINITY_DIST;
+		for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+		{
+			float centerX = m_centerX[shapeIndex];
+			float centerY = m_centerY[shapeIndex];
+			float centerZ = m_centerZ[shapeIndex];
+			float radius = m_radius[shapeIndex];
+
+			if (maxRes < CULL_RES_LIMIT)
+			{
+				Vec3 toShape = Vec3(centerX, centerY, centerZ) - boundsCenter;
+				float lowerBound = toShape.GetLength() - boundsRadius - radius;
+				if (lowerBound >= maxRes + cullMargin)
+				{
+					counters.m_numShapesCulled += numActive;
+					continue;
+				}
+			}
+
+			SimdFloat simdCenterX = SimdSet1(centerX);
+			SimdFloat simdCenterY = SimdSet1(centerY);
+			SimdFloat simdCenterZ = SimdSet1(centerZ);
+			SimdFloat simdRadius = SimdSet1(radius);
+			SimdFloat simdMaxRes = SimdSet1(-SDF_INFINITY_DIST);
+
+			for (int chunk = 0; chunk < numChunks; ++chunk)
+			{
+				if (chunkBits[chunk] == 0)
+				{
+					continue;
+				}
+				int laneOffset = chunk * SDF_SIMD_WIDTH;
+				SimdFloat dx = SimdLoad(&posX[laneOffset]) - simdCenterX;
+				SimdFloat dy = SimdLoad(&posY[laneOffset]) - simdCenterY;
+				SimdFloat dz = SimdLoad(&posZ[laneOffset]) - simdCenterZ;
+				SimdFloat d = SimdSqrt(dx * dx + dy * dy + dz * dz) - simdRadius;
+
+				SimdFloat chunkRes = SimdSminCubic(SimdLoad(&res[laneOffset]), d, toleranceK);
+				SimdStore(&res[laneOffset], chunkRes);
+				simdMaxRes = SimdMax(simdMaxRes, SimdSelect(chunkActive[chunk], chunkRes, SimdSet1(-SDF_INFINITY_DIST)));
+			}
+			counters.m_numSdfEvaluations += numActive;
+
+			alignas(32) float laneMaxRes[SDF_SIMD_WIDTH];
+			SimdStore(laneMaxRes, simdMaxRes);
+			maxRes = laneMaxRes[0];
+			for (int lane = 1; lane < SDF_SIMD_WIDTH; ++lane)
+			{
+				maxRes = fmaxf(maxRes, laneMaxRes[lane]);
+			}
+		}
+
+		// Retire lanes independently
+		for (int lane = 0; lane < numRays; ++lane)
+		{
+			if (!isActive[lane])
+			{
+				continue;
+			}
+
+			float distToClosest = res[lane];
+			if (distToClosest < minHitDistance)
+			{
+				out_distances[lane] = distTraveled[lane];
+				isActive[lane] = false;
+				--numActive;
+			}
+			else if (distToClosest > maxTraceDistance)
+			{
+				out_distances[lane] = SDF_INFINITY_DIST;
+				isActive[lane] = false;
+				--numActive;
+			}
+			else
+			{
+				distTraveled[lane] += distToClosest;
+			}
+		}
+	}
+
+	// Out of steps
+	for (int lane = 0; lane < numRays; ++lane)
+	{
+		if (isActive[lane])
+		{
+			out_distances[lane] = SDF_INFINITY_DIST;
+		}
+	}
+}
+
+SdfCpuFrameStats SdfCpuPacketMarcher::RenderFrame(SdfCpuView const& view, IntVec2 const& dimensions, SdfCpuImage& out_image, JobPool* jobPool) const
+{
+	if (out_image.m_dimensions != dimensions)
+	{
+		out_image.Resize(dimensions);
+	}
+
+	return RunSdfCpuTiles(dimensions, jobPool, [&](IntVec2 const& tileCoords, SdfCpuRayCounters& counters)
+	{
+		RenderTile(view, tileCoords, out_image, counters);
+	});
+}
+
+void SdfCpuPacketMarcher::RenderTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, SdfCpuRayCounters& counters) const
+{
+	IntVec2 const& dimensions = out_image.m_dimensions;
+	int tileStartX = tileCoords.x * SDF_TILE_SIZE;
+	int tileStartY = tileCoords.y * SDF_TILE_SIZE;
+
+	Vec3 rayStartPositions[SDF_MAX_PACKET_SIZE];
+	Vec3 rayFwdNormals[SDF_MAX_PACKET_SIZE];
+	int pixelIndices[SDF_MAX_PACKET_SIZE];
+	float distances[SDF_MAX_PACKET_SIZE];
+
+	for (int packetY = 0; packetY < SDF_TILE_SIZE; packetY += m_packetDimensions.y)
+	{
+		for (int packetX = 0; packetX < SDF_TILE_SIZE; packetX += m_packetDimensions.x)
+		{
+			int numRays = 0;
+			for (int y = tileStartY + packetY; y < tileStartY + packetY + m_packetDimensions.y && y < dimensions.y; ++y)
+			{
+				for (int x = tileStartX + packetX; x < tileStartX + packetX + m_packetDimensions.x && x < dimensions.x; ++x)
+				{
+					rayStartPositions[numRays] = view.m_position;
+					rayFwdNormals[numRays] = view.GetRayDirection(x, y, dimensions);
+					pixelIndices[numRays] = y * dimensions.x + x;
+					++numRays;
+				}
+			}
+			if (numRays == 0)
+			{
+				continue;
+			}
+
+			MarchPacket(rayStartPositions, rayFwdNormals, numRays, distances, counters);
+
+			for (int ray = 0; ray < numRays; ++ray)
+			{
+				Vec3 color = SdfCpuRayMarcher::GetMissingColor();
+				if (distances[ray] < SDF_INFINITY_DIST)
+				{
+					Vec3 hitPos = rayStartPositions[ray] + rayFwdNormals[ray] * distances[ray];
+					color = m_scene.ShadeHit(hitPos, rayStartPositions[ray], &counters);
+				}
+				out_image.m_colors[pixelIndices[ray]] = color;
+				out_image.m_depths[pixelIndices[ray]] = view.GetDepth(rayStartPositions[ray] + rayFwdNormals[ray] * distances[ray]);
+			}
+		}
+	}
+}
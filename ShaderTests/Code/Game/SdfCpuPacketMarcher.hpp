@@ -0,0 +1,44 @@
+#pragma once
+#include "Game/SdfCpuRayMarcher.hpp"
+
+#include <vector>
+
+/*
+Ray-packet version of SdfCpuRayMarcher::RayMarch.
+A packet marches 4, 8 or 16 rays of one tile together: SdfMap is evaluated for all lanes with SdfSimd,
+lanes retire independently on hit or miss, and a shape is skipped for the whole packet when a bounding
+sphere around the lanes proves it cannot change the smooth union of any lane:
+	sminCubic(res, d, k) == res  whenever  d >= res + 6k
+Hits are shaded with the scalar code, so images match the scalar path.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_MAX_PACKET_SIZE = 16;
+
+
+class SdfCpuPacketMarcher
+{
+public:
+	SdfCpuPacketMarcher(SdfCpuRayMarcher const& scene, int packetSize);
+
+	int GetPacketSize() const { return m_packetSize; }
+
+	// out_distances: distance traveled to the hit, SDF_INFINITY_DIST on a miss
+	void MarchPacket(Vec3 const* rayStartPositions, Vec3 const* rayFwdNormals, int numRays, float* out_distances, SdfCpuRayCounters& counters) const;
+
+	SdfCpuFrameStats RenderFrame(SdfCpuView const& view, IntVec2 const& dimensions, SdfCpuImage& out_image, JobPool* jobPool) const;
+
+private:
+	void RenderTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, SdfCpuRayCounters& counters) const;
+
+private:
+	SdfCpuRayMarcher const& m_scene;
+	int m_packetSize = 8;
+	IntVec2 m_packetDimensions; // pixel footprint of a packet inside a tile
+
+	// Geometry stream as SoA, so one shape broadcasts against a full register of lanes
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+};
@@ -0,0 +1,1737 @@
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfBrickMap.hpp"
+#include "Game/SdfCostCounters.hpp"
+#include "Game/SdfCsg.hpp"
+#include "Game/SdfDeferredShading.hpp"
+#include "Game/SdfTemporalReprojection.hpp"
+#include "Game/SdfTileBinning.hpp"
+#include "Game/SdfTileClassification.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+
+
+//-----------------------------------------------------------------------------------------------
+// HLSL intrinsics used by SdfRayMarching.hlsl and its includes
+//-----------------------------------------------------------------------------------------------
+static float Saturate(float value)
+{
+	return GetClampedZeroToOne(value);
+}
+
+static float Sign(float value)
+{
+	return (value > 0.f) ? 1.f : ((value < 0.f) ? -1.f : 0.f);
+}
+
+static Vec3 Lerp(Vec3 const& a, Vec3 const& b, float t)
+{
+	return a + (b - a) * t;
+}
+
+static Vec4 LerpVec4(Vec4 const& a, Vec4 const& b, float t)
+{
+	return Vec4(a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t);
+}
+
+static Vec4 WeightedSumVec4(Vec4 const& a, Vec4 const& b, Vec4 const& c, Vec3 const& weights)
+{
+	return Vec4(a.x * weights.x + b.x * weights.y + c.x * weights.z,
+		a.y * weights.x + b.y * weights.y + c.y * weights.z,
+		a.z * weights.x + b.z * weights.y + c.z * weights.z,
+		a.w * weights.x + b.w * weights.y + c.w * weights.z);
+}
+
+static Vec3 SaturateVec3(Vec3 const& v)
+{
+	return Vec3(Saturate(v.x), Saturate(v.y), Saturate(v.z));
+}
+
+static Vec3 PowVec3(Vec3 const& v, float exponent)
+{
+	return Vec3(powf(v.x, exponent), powf(v.y, exponent), powf(v.z, exponent));
+}
+
+static Vec3 EncodeXYZToRGB(Vec3 const& v)
+{
+	return (v + Vec3(1.f, 1.f, 1.f)) * 0.5f;
+}
+
+static Vec3 DecodeRGBToXYZ(Vec3 const& color)
+{
+	return color * 2.f - Vec3(1.f, 1.f, 1.f);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// TriplanarUtils.hlsli
+//-----------------------------------------------------------------------------------------------
+static Vec4 SampleOrDefault(SdfCpuTexture const* tex, Vec4 const& defaultTexel, Vec2 const& uv)
+{
+	return tex ? tex->SampleLinearWrap(uv) : defaultTexel;
+}
+
+static Vec3 GetTriplanarWeights(Vec3 const& normal, float sharpness)
+{
+	Vec3 blend = Vec3(powf(fabsf(normal.x), sharpness), powf(fabsf(normal.y), sharpness), powf(fabsf(normal.z), sharpness));
+	float sum = blend.x + blend.y + blend.z + 0.00001f;
+	return blend / sum;
+}
+
+static void GetTriplanarUVs(Vec3 const& worldPos, Vec3 const& worldNormal, float uvScale, Vec2& out_uvX, Vec2& out_uvY, Vec2& out_uvZ)
+{
+	out_uvX = Vec2(worldPos.y, worldPos.z) * (1.f / uvScale);
+	out_uvY = Vec2(worldPos.x, worldPos.z) * (1.f / uvScale);
+	out_uvZ = Vec2(worldPos.x, worldPos.y) * (1.f / uvScale);
+
+	out_uvX.x *= Sign(worldNormal.x);
+	out_uvY.x *= -Sign(worldNormal.y);
+	out_uvZ.x *= Sign(worldNormal.z);
+}
+
+static Vec4 SampleTriplanar(Vec3 const& worldPos, Vec3 const& worldNormal, float uvScale, float sharpness,
+	SdfCpuTexture const* tex, Vec4 const& defaultTexel)
+{
+	Vec3 weights = GetTriplanarWeights(worldNormal, sharpness);
+
+	Vec2 uvX, uvY, uvZ;
+	GetTriplanarUVs(worldPos, worldNormal, uvScale, uvX, uvY, uvZ);
+
+	Vec4 colorX = SampleOrDefault(tex, defaultTexel, uvX);
+	Vec4 colorY = SampleOrDefault(tex, defaultTexel, uvY);
+	Vec4 colorZ = SampleOrDefault(tex, defaultTexel, uvZ);
+
+	return WeightedSumVec4(colorX, colorY, colorZ, weights);
+}
+
+static Vec3 SampleTriplanarNormal(Vec3 const& worldPos, Vec3 const& worldNormal, float uvScale, float sharpness,
+	SdfCpuTexture const* tex, Vec4 const& defaultTexel)
+{
+	Vec3 weights = GetTriplanarWeights(worldNormal, sharpness);
+
+	Vec2 uvX, uvY, uvZ;
+	GetTriplanarUVs(worldPos, worldNormal, uvScale, uvX, uvY, uvZ);
+
+	Vec4 texelX = SampleOrDefault(tex, defaultTexel, uvX);
+	Vec4 texelY = SampleOrDefault(tex, defaultTexel, uvY);
+	Vec4 texelZ = SampleOrDefault(tex, defaultTexel, uvZ);
+
+	Vec3 tnormalX = DecodeRGBToXYZ(Vec3(texelX.x, texelX.y, texelX.z));
+	Vec3 tnormalY = DecodeRGBToXYZ(Vec3(texelY.x, texelY.y, texelY.z));
+	Vec3 tnormalZ = DecodeRGBToXYZ(Vec3(texelZ.x, texelZ.y, texelZ.z));
+
+	tnormalX.x *= Sign(worldNormal.x);
+	tnormalY.x *= -Sign(worldNormal.y);
+	tnormalZ.x *= Sign(worldNormal.z);
+
+	// Whiteout blend
+	tnormalX = Vec3(tnormalX.x + worldNormal.y, tnormalX.y + worldNormal.z, fabsf(tnormalX.z) * worldNormal.x);
+	tnormalY = Vec3(tnormalY.x + worldNormal.x, tnormalY.y + worldNormal.z, fabsf(tnormalY.z) * worldNormal.y);
+	tnormalZ = Vec3(tnormalZ.x + worldNormal.x, tnormalZ.y + worldNormal.y, fabsf(tnormalZ.z) * worldNormal.z);
+
+	Vec3 result = Vec3(tnormalX.z, tnormalX.x, tnormalX.y) * weights.x +
+		Vec3(tnormalY.x, tnormalY.z, tnormalY.y) * weights.y +
+		tnormalZ * weights.z;
+
+	return result.GetNormalized();
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// Lighting.hlsli / ToneMapping.hlsli
+//-----------------------------------------------------------------------------------------------
+static float D_GGX(float NdotH, float roughness)
+{
+	float a2 = roughness * roughness;
+	float f = (NdotH * NdotH) * (a2 - 1.f) + 1.f;
+	return a2 / (3.14159265359f * f * f);
+}
+
+static float GGX(float NdotX, float k)
+{
+	float denominator = NdotX * (1.f - k) + k;
+	return NdotX / ((denominator > 1e-5f) ? denominator : 1e-5f);
+}
+
+static float G_Smith(float NdotV, float NdotL, float roughness)
+{
+	float r = roughness + 1.f;
+	float k = (r * r) / 8.f;
+	return GGX(NdotL, k) * GGX(NdotV, k);
+}
+
+static Vec3 F_Schlick(float VdotH, Vec3 const& f0)
+{
+	float f = powf(Saturate(1.f - VdotH), 5.f);
+	return f0 + (Vec3(1.f, 1.f, 1.f) - f0) * f;
+}
+
+static Vec3 PBRLighting(SdfSurfaceData const& surf, Vec3 const& lightDir, Vec3 const& viewDir, Vec3 const& lightColor, float lightAtten)
+{
+	Vec3 N = surf.m_normal.GetNormalized();
+	Vec3 V = viewDir.GetNormalized();
+	Vec3 L = lightDir.GetNormalized();
+	Vec3 H = (V + L).GetNormalized();
+
+	float NdotL = Saturate(DotProduct3D(N, L));
+	float NdotV = Saturate(DotProduct3D(N, V));
+	float NdotH = Saturate(DotProduct3D(N, H));
+	float VdotH = Saturate(DotProduct3D(V, H));
+
+	Vec3 F0 = Lerp(Vec3(0.04f, 0.04f, 0.04f), surf.m_albedo, surf.m_metallic);
+
+	float D = D_GGX(NdotH, surf.m_roughness);
+	float G = G_Smith(NdotV, NdotL, surf.m_roughness);
+	Vec3 F = F_Schlick(VdotH, F0);
+
+	Vec3 kD = (Vec3(1.f, 1.f, 1.f) - F) * (1.f - surf.m_metallic);
+	Vec3 diffuse = kD * surf.m_albedo / 3.14159265359f;
+
+	Vec3 numerator = F * (D * G);
+	float denominator = 4.f * NdotV * NdotL + 0.0001f;
+	Vec3 specular = numerator / denominator;
+
+	Vec3 radiance = lightColor * lightAtten;
+	return (diffuse + specular) * radiance * NdotL;
+}
+
+// CALC_TOTAL_PBR_LIGHT
+static Vec3 CalcTotalPBRLight(LightConstants const& lightConstants, SdfSurfaceData const& surf, Vec3 const& worldPos, Vec3 const& cameraWorldPos)
+{
+	Vec3 totalLight;
+	Vec3 viewDir = (cameraWorldPos - worldPos).GetNormalized();
+
+	// Sunlight
+	{
+		Vec3 sunDir = -lightConstants.m_sunNormal;
+		Vec3 sunColor = Vec3(lightConstants.m_sunColor[0], lightConstants.m_sunColor[1], lightConstants.m_sunColor[2]);
+		float sunAtten = lightConstants.m_sunColor[3];
+		totalLight += PBRLighting(surf, sunDir, viewDir, sunColor, sunAtten);
+	}
+
+	// Point & Spot Lights
+	for (int lightIndex = 0; lightIndex < lightConstants.m_numLights; ++lightIndex)
+	{
+		Light const& light = lightConstants.m_lights[lightIndex];
+		Vec3 lightColor = Vec3(light.m_color[0], light.m_color[1], light.m_color[2]);
+		float lightStrength = light.m_color[3];
+
+		Vec3 L = (light.m_worldPosition - worldPos).GetNormalized();
+		float dist = (light.m_worldPosition - worldPos).GetLength();
+
+		float fallOff = Saturate(RangeMap(dist, light.m_innerRadius, light.m_outerRadius, 1.f, 0.f));
+		fallOff = SmoothStep3(fallOff);
+
+		float penumbra = Saturate(RangeMap(DotProduct3D(-L, light.m_spotForwardNormal), light.m_innerDotThreshold, light.m_outerDotThreshold, 1.f, 0.f));
+		penumbra = SmoothStep3(penumbra);
+
+		float atten = fallOff * penumbra * lightStrength;
+		totalLight += PBRLighting(surf, L, viewDir, lightColor, atten);
+	}
+	return totalLight;
+}
+
+static Vec3 ACESFilm(Vec3 const& x)
+{
+	constexpr float a = 2.51f;
+	constexpr float b = 0.03f;
+	constexpr float c = 2.43f;
+	constexpr float d = 0.59f;
+	constexpr float e = 0.14f;
+	Vec3 numerator = x * (x * a + Vec3(b, b, b));
+	Vec3 denominator = x * (x * c + Vec3(d, d, d)) + Vec3(e, e, e);
+	return SaturateVec3(Vec3(numerator.x / denominator.x, numerator.y / denominator.y, numerator.z / denominator.z));
+}
+
+// DEFINE_TOPN_INDICES_UNORDERED_FUNC in Algorithm.hlsli
+template <int ARRAY_SIZE, int TOPN>
+static void GetTopNIndicesUnordered(float const data[ARRAY_SIZE], int indices[TOPN])
+{
+	float topValues[TOPN];
+	int topIndices[TOPN];
+	for (int i = 0; i < TOPN; ++i)
+	{
+		topValues[i] = data[i];
+		topIndices[i] = i;
+	}
+	for (int i = TOPN; i < ARRAY_SIZE; ++i)
+	{
+		float minValue = topValues[0];
+		int minIndex = 0;
+		for (int j = 1; j < TOPN; ++j)
+		{
+			if (topValues[j] < minValue)
+			{
+				minValue = topValues[j];
+				minIndex = j;
+			}
+		}
+		if (data[i] > minValue)
+		{
+			topValues[minIndex] = data[i];
+			topIndices[minIndex] = i;
+		}
+	}
+	for (int i = 0; i < TOPN; ++i)
+	{
+		indices[i] = topIndices[i];
+	}
+}
+
+// The shader compiles a single K in, the CPU side picks the specialization at run time
+static void GetTopKCandidateIndices(int topK, float const weights[SDF_TOPK_CANDIDATES], int indices[SDF_TOPK_MAX_MATERIALS])
+{
+	switch (topK)
+	{
+	case 1: GetTopNIndicesUnordered<SDF_TOPK_CANDIDATES, 1>(weights, indices); break;
+	case 2: GetTopNIndicesUnordered<SDF_TOPK_CANDIDATES, 2>(weights, indices); break;
+	case 3: GetTopNIndicesUnordered<SDF_TOPK_CANDIDATES, 3>(weights, indices); break;
+	default: GetTopNIndicesUnordered<SDF_TOPK_CANDIDATES, 4>(weights, indices); break;
+	}
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vec4 SdfCpuTexture::SampleLinearWrap(Vec2 const& uv) const
+{
+	if (m_texels.empty())
+	{
+		return Vec4(1.f, 1.f, 1.f, 1.f);
+	}
+
+	float x = uv.x * (float)m_width - 0.5f;
+	float y = uv.y * (float)m_height - 0.5f;
+	float floorX = floorf(x);
+	float floorY = floorf(y);
+	float fracX = x - floorX;
+	float fracY = y - floorY;
+
+	int x0 = (int)floorX % m_width;
+	int y0 = (int)floorY % m_height;
+	x0 = (x0 < 0) ? x0 + m_width : x0;
+	y0 = (y0 < 0) ? y0 + m_height : y0;
+	int x1 = (x0 + 1) % m_width;
+	int y1 = (y0 + 1) % m_height;
+
+	Vec4 const& t00 = m_texels[y0 * m_width + x0];
+	Vec4 const& t10 = m_texels[y0 * m_width + x1];
+	Vec4 const& t01 = m_texels[y1 * m_width + x0];
+	Vec4 const& t11 = m_texels[y1 * m_width + x1];
+
+	Vec4 top = LerpVec4(t00, t10, fracX);
+	Vec4 bottom = LerpVec4(t01, t11, fracX);
+	return LerpVec4(top, bottom, fracY);
+}
+
+SdfCpuTexture const* SdfCpuTextureTable::Find(uint32_t srvIndex) const
+{
+	auto found = m_textures.find(srvIndex);
+	return (found != m_textures.end()) ? found->second : nullptr;
+}
+
+//-----------------------------------------------------------------------------------------------
+Vec3 SdfCpuView::GetRayDirection(int pixelX, int pixelY, IntVec2 const& dimensions) const
+{
+	// Same as ComputeMain: the ray passes through the top-left corner of the pixel on the far plane
+	float u = (float)pixelX / (float)dimensions.x;
+	float v = (float)pixelY / (float)dimensions.y;
+	float ndcX = u * 2.f - 1.f;
+	float ndcY = 1.f - v * 2.f;
+
+	float tanHalfFovY = TanDegrees(0.5f * m_fovDegrees);
+	float tanHalfFovX = tanHalfFovY * m_aspect;
+
+	Vec3 farPlaneOffset = m_forward - m_left * (ndcX * tanHalfFovX) + m_up * (ndcY * tanHalfFovY);
+	return farPlaneOffset.GetNormalized();
+}
+
+void SdfCpuView::GetConeRay(IntVec2 const& conePixel, IntVec2 const& dimensions, Vec3& out_coneAxis, float& out_tanHalfAngle) const
+{
+	// Same as GetConeRay in SdfRayMarching.hlsl.
+	// The rays of a pixel rect hit the far plane inside the rect of its corner rays, and the set of directions
+	// within an angle of the axis meets that plane in a convex region, so the widest corner bounds the block.
+	int minX = conePixel.x * SDF_CONE_PREPASS_FACTOR;
+	int minY = conePixel.y * SDF_CONE_PREPASS_FACTOR;
+	int maxX = (minX + SDF_CONE_PREPASS_FACTOR - 1 < dimensions.x - 1) ? minX + SDF_CONE_PREPASS_FACTOR - 1 : dimensions.x - 1;
+	int maxY = (minY + SDF_CONE_PREPASS_FACTOR - 1 < dimensions.y - 1) ? minY + SDF_CONE_PREPASS_FACTOR - 1 : dimensions.y - 1;
+
+	Vec3 corners[4] = { GetRayDirection(minX, minY, dimensions), GetRayDirection(maxX, minY, dimensions),
+		GetRayDirection(minX, maxY, dimensions), GetRayDirection(maxX, maxY, dimensions) };
+	out_coneAxis = (corners[0] + corners[1] + corners[2] + corners[3]).GetNormalized();
+
+	// tan from the cross product, 1 - cos^2 loses most of its bits for narrow cones
+	out_tanHalfAngle = 0.f;
+	for (Vec3 const& corner : corners)
+	{
+		float tanAngle = CrossProduct3D(out_coneAxis, corner).GetLength() / DotProduct3D(out_coneAxis, corner);
+		out_tanHalfAngle = (tanAngle > out_tanHalfAngle) ? tanAngle : out_tanHalfAngle;
+	}
+	out_tanHalfAngle *= SDF_CONE_ANGLE_SLACK;
+}
+
+float SdfCpuView::GetDepth(Vec3 const& worldPos) const
+{
+	float viewZ = DotProduct3D(worldPos - m_position, m_forward);
+	return (m_far / (m_far - m_near)) * (1.f - m_near / viewZ);
+}
+
+float SdfCpuView::GetViewZ(float depth) const
+{
+	return m_near / (1.f - depth * (m_far - m_near) / m_far);
+}
+
+//-----------------------------------------------------------------------------------------------
+void SdfCpuImage::Resize(IntVec2 const& dimensions)
+{
+	m_dimensions = dimensions;
+	m_colors.assign((size_t)dimensions.x * dimensions.y, Vec3());
+	m_depths.assign((size_t)dimensions.x * dimensions.y, 0.f);
+	m_stepCounts.assign((size_t)dimensions.x * dimensions.y, 0);
+	m_sdfMapCounts.assign((size_t)dimensions.x * dimensions.y, 0);
+	m_materialCounts.assign((size_t)dimensions.x * dimensions.y, 0);
+}
+
+static unsigned char QuantizeUnorm8(float value)
+{
+	return (unsigned char)(Saturate(value) * 255.f + 0.5f);
+}
+
+bool SdfCpuImage::WriteColorPPM(std::string const& filePath) const
+{
+	FILE* file = fopen(filePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "P6\n%d %d\n255\n", m_dimensions.x, m_dimensions.y);
+	std::vector<unsigned char> bytes;
+	bytes.reserve(m_colors.size() * 3);
+	for (Vec3 const& color : m_colors)
+	{
+		bytes.push_back(QuantizeUnorm8(color.x));
+		bytes.push_back(QuantizeUnorm8(color.y));
+		bytes.push_back(QuantizeUnorm8(color.z));
+	}
+	size_t numWritten = fwrite(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+	return numWritten == bytes.size();
+}
+
+bool SdfCpuImage::WriteDepthPFM(std::string const& filePath) const
+{
+	FILE* file = fopen(filePath.c_str(), "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	// PFM stores rows bottom to top, negative scale means little endian
+	fprintf(file, "Pf\n%d %d\n-1.0\n", m_dimensions.x, m_dimensions.y);
+	bool succeeded = true;
+	for (int y = m_dimensions.y - 1; y >= 0; --y)
+	{
+		size_t numWritten = fwrite(&m_depths[(size_t)y * m_dimensions.x], sizeof(float), m_dimensions.x, file);
+		succeeded = succeeded && (numWritten == (size_t)m_dimensions.x);
+	}
+	fclose(file);
+	return succeeded;
+}
+
+bool SdfCpuImage::ReadColorPPM(std::string const& filePath)
+{
+	FILE* file = fopen(filePath.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	int width = 0;
+	int height = 0;
+	int maxValue = 0;
+	if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) != 3 || maxValue != 255 || fgetc(file) == EOF)
+	{
+		fclose(file);
+		return false;
+	}
+
+	std::vector<unsigned char> bytes((size_t)width * height * 3);
+	size_t numRead = fread(bytes.data(), 1, bytes.size(), file);
+	fclose(file);
+	if (numRead != bytes.size())
+	{
+		return false;
+	}
+
+	m_dimensions = IntVec2(width, height);
+	m_colors.resize((size_t)width * height);
+	for (size_t i = 0; i < m_colors.size(); ++i)
+	{
+		m_colors[i] = Vec3(bytes[i * 3 + 0] / 255.f, bytes[i * 3 + 1] / 255.f, bytes[i * 3 + 2] / 255.f);
+	}
+	return true;
+}
+
+bool SdfCpuImage::ReadDepthPFM(std::string const& filePath)
+{
+	FILE* file = fopen(filePath.c_str(), "rb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	int width = 0;
+	int height = 0;
+	float scale = 0.f;
+	if (fscanf(file, "Pf %d %d %f", &width, &height, &scale) != 3 || scale >= 0.f || fgetc(file) == EOF)
+	{
+		fclose(file);
+		return false;
+	}
+
+	m_depths.resize((size_t)width * height);
+	bool succeeded = true;
+	for (int y = height - 1; y >= 0; --y)
+	{
+		size_t numRead = fread(&m_depths[(size_t)y * width], sizeof(float), width, file);
+		succeeded = succeeded && (numRead == (size_t)width);
+	}
+	fclose(file);
+
+	m_dimensions = IntVec2(width, height);
+	return succeeded;
+}
+
+SdfImageDiff CompareSdfImages(SdfCpuImage const& a, SdfCpuImage const& b, float colorTolerance /*= 2.f*/, float depthTolerance /*= 1e-4f*/)
+{
+	SdfImageDiff diff;
+	if (a.m_dimensions != b.m_dimensions)
+	{
+		diff.m_numPixelsOverTolerance = a.m_dimensions.x * a.m_dimensions.y;
+		diff.m_maxColorError = 255.f;
+		return diff;
+	}
+
+	int numPixels = a.m_dimensions.x * a.m_dimensions.y;
+	double totalColorError = 0.0;
+	for (int i = 0; i < numPixels; ++i)
+	{
+		float colorError = 0.f;
+		if (!a.m_colors.empty() && !b.m_colors.empty())
+		{
+			float errorR = fabsf((float)QuantizeUnorm8(a.m_colors[i].x) - (float)QuantizeUnorm8(b.m_colors[i].x));
+			float errorG = fabsf((float)QuantizeUnorm8(a.m_colors[i].y) - (float)QuantizeUnorm8(b.m_colors[i].y));
+			float errorB = fabsf((float)QuantizeUnorm8(a.m_colors[i].z) - (float)QuantizeUnorm8(b.m_colors[i].z));
+			colorError = fmaxf(errorR, fmaxf(errorG, errorB));
+		}
+
+		float depthError = 0.f;
+		if (!a.m_depths.empty() && !b.m_depths.empty())
+		{
+			depthError = fabsf(a.m_depths[i] - b.m_depths[i]);
+		}
+
+		totalColorError += colorError;
+		diff.m_maxColorError = fmaxf(diff.m_maxColorError, colorError);
+		diff.m_maxDepthError = fmaxf(diff.m_maxDepthError, depthError);
+		if (colorError > colorTolerance || depthError > depthTolerance)
+		{
+			++diff.m_numPixelsOverTolerance;
+		}
+	}
+	diff.m_meanColorError = (numPixels > 0) ? (float)(totalColorError / numPixels) : 0.f;
+	return diff;
+}
+
+//-----------------------------------------------------------------------------------------------
+void SdfCpuRayCounters::Add(SdfCpuRayCounters const& other)
+{
+	m_numSteps += other.m_numSteps;
+	m_numSdfEvaluations += other.m_numSdfEvaluations;
+	m_numSdfMapCalls += other.m_numSdfMapCalls;
+	m_numMaterialEvaluations += other.m_numMaterialEvaluations;
+	m_numMaterialCandidates += other.m_numMaterialCandidates;
+	m_numShapesCulled += other.m_numShapesCulled;
+	m_numBvhNodesVisited += other.m_numBvhNodesVisited;
+	m_numBrickMapSteps += other.m_numBrickMapSteps;
+	m_numConeSteps += other.m_numConeSteps;
+	m_numTemporalStarts += other.m_numTemporalStarts;
+	m_numTemporalFallbacks += other.m_numTemporalFallbacks;
+	m_numRelaxationFallbacks += other.m_numRelaxationFallbacks;
+}
+
+double SdfCpuFrameStats::GetRaysPerSecond() const
+{
+	return (m_milliseconds > 0.0) ? (double)m_numRays / (m_milliseconds * 0.001) : 0.0;
+}
+
+SdfCpuFrameStats RunSdfCpuTiles(IntVec2 const& dimensions, JobPool* jobPool, std::function<void(IntVec2 const& tileCoords, SdfCpuRayCounters& counters)> const& tileFunc)
+{
+	int numTilesX = (dimensions.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE;
+	int numTilesY = (dimensions.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE;
+	int numTiles = numTilesX * numTilesY;
+
+	std::vector<SdfCpuRayCounters> tileCounters(numTiles);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto runTile = [&](int tileIndex)
+	{
+		tileFunc(IntVec2(tileIndex % numTilesX, tileIndex / numTilesX), tileCounters[tileIndex]);
+	};
+
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numTiles, runTile);
+	}
+	else
+	{
+		for (int tileIndex = 0; tileIndex < numTiles; ++tileIndex)
+		{
+			runTile(tileIndex);
+		}
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+
+	SdfCpuFrameStats stats;
+	stats.m_numRays = dimensions.x * dimensions.y;
+	stats.m_milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	for (SdfCpuRayCounters const& counters : tileCounters)
+	{
+		stats.m_counters.Add(counters);
+	}
+	return stats;
+}
+
+SdfCpuFrameStats RunSdfCpuTileList(IntVec2 const& dimensions, std::vector<uint32_t> const& tileList, JobPool* jobPool,
+	std::function<void(IntVec2 const& tileCoords, SdfCpuRayCounters& counters)> const& tileFunc)
+{
+	int numTiles = (int)tileList.size();
+	std::vector<SdfCpuRayCounters> tileCounters(numTiles);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto runTile = [&](int slot)
+	{
+		tileFunc(SdfTileClassification::UnpackTileCoords(tileList[slot]), tileCounters[slot]);
+	};
+
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numTiles, runTile);
+	}
+	else
+	{
+		for (int slot = 0; slot < numTiles; ++slot)
+		{
+			runTile(slot);
+		}
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+
+	SdfCpuFrameStats stats;
+	stats.m_milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	for (int slot = 0; slot < numTiles; ++slot)
+	{
+		IntVec2 tileCoords = SdfTileClassification::UnpackTileCoords(tileList[slot]);
+		stats.m_numRays += std::min(SDF_TILE_SIZE, dimensions.x - tileCoords.x * SDF_TILE_SIZE) * std::min(SDF_TILE_SIZE, dimensions.y - tileCoords.y * SDF_TILE_SIZE);
+		stats.m_counters.Add(tileCounters[slot]);
+	}
+	return stats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+float SdSphere(Vec3 const& p, Vec3 const& c, float r)
+{
+	return (p - c).GetLength() - r;
+}
+
+float SminCubic(float a, float b, float k)
+{
+	k *= 6.f;
+	float h = fmaxf(k - fabsf(a - b), 0.f) / k;
+	return fminf(a, b) - h * h * h * k * (1.f / 6.f);
+}
+
+float SdfValueFromGeometry(Vec3 const& p, Vec4 const& geometry)
+{
+	// Sphere
+	return SdSphere(p, Vec3(geometry.x, geometry.y, geometry.z), geometry.w);
+}
+
+SdfDistanceGradient SdSphereGradient(Vec3 const& p, Vec3 const& c, float r)
+{
+	Vec3 offset = p - c;
+	float length = offset.GetLength();
+	SdfDistanceGradient result;
+	result.m_distance = length - r;
+	result.m_gradient = (length > 0.f) ? offset / length : Vec3();
+	return result;
+}
+
+SdfDistanceGradient SminCubicGradient(SdfDistanceGradient const& a, SdfDistanceGradient const& b, float k)
+{
+	// d/dx [min(a,b) - h^3 k/6] with h = (k - |a-b|) / k: the h^3 term adds h^2/2 * sign(a-b) * (a' - b').
+	// At a == b this gives the mean of both gradients, the limit from either side.
+	k *= 6.f;
+	float diff = a.m_distance - b.m_distance;
+	float h = fmaxf(k - fabsf(diff), 0.f) / k;
+	SdfDistanceGradient result;
+	result.m_distance = fminf(a.m_distance, b.m_distance) - h * h * h * k * (1.f / 6.f);
+	result.m_gradient = (a.m_distance < b.m_distance) ? a.m_gradient : b.m_gradient;
+	result.m_gradient += (a.m_gradient - b.m_gradient) * (0.5f * h * h * ((diff >= 0.f) ? 1.f : -1.f));
+	return result;
+}
+
+SdfDistanceGradient SdfGradientFromGeometry(Vec3 const& p, Vec4 const& geometry)
+{
+	// Sphere; a shape type without an analytic gradient returns a zero one, and SdfNormal falls back to SdfNormalTetra
+	return SdSphereGradient(p, Vec3(geometry.x, geometry.y, geometry.z), geometry.w);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfCpuRayMarcher::SetScene(std::vector<SdfShape> const& shapes, SdfRayMarchingConstants const& constants, SdfBvh const* prebuiltBvh /*= nullptr*/)
+{
+	m_constants = constants;
+	if (m_constants.useBvh && prebuiltBvh && prebuiltBvh->GetNumShapes() == (int)shapes.size())
+	{
+		m_bvh = *prebuiltBvh;
+		m_streams.Clear();
+		m_streams.Reserve((int)shapes.size());
+		for (uint32_t shapeIndex : m_bvh.GetShapeOrder())
+		{
+			m_streams.AddShape(shapes[shapeIndex]);
+		}
+	}
+	else if (m_constants.useBvh)
+	{
+		m_bvh.UpdateShapeStreams(shapes, m_constants.toleranceK, m_constants.halfPrecisionGeometry != 0, false, m_streams);
+	}
+	else
+	{
+		m_bvh.Clear();
+		m_streams.SetShapes(shapes);
+	}
+	m_constants.numOfShapes = m_streams.GetNumShapes();
+	m_constants.numOfBvhNodes = (int)m_bvh.GetNodes().size();
+}
+
+void SdfCpuRayMarcher::SetTopKMaterials(int topK)
+{
+	m_topKMaterials = std::clamp(topK, 1, SDF_TOPK_MAX_MATERIALS);
+}
+
+float SdfCpuRayMarcher::SdfMap(Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	if (counters)
+	{
+		++counters->m_numSdfMapCalls;
+	}
+	if (UseCsgProgram())
+	{
+		return EvaluateSdfCsgProgram(m_csgProgram->m_instructions, p, nullptr, &m_csgProgram->m_gridSamples);
+	}
+	if (shapeList)
+	{
+		return SdfMapList(p, *shapeList, counters);
+	}
+	if (m_constants.useBvh && m_constants.numOfBvhNodes > 0)
+	{
+		return SdfMapBvh(p, counters);
+	}
+	return SdfMapAll(p, counters);
+}
+
+float SdfCpuRayMarcher::SdfMapBvh(Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/) const
+{
+	std::vector<SdfBvhNode> const& nodes = m_bvh.GetNodes();
+	const float toleranceK = m_constants.toleranceK;
+	const bool isHalfPrecision = IsHalfPrecisionGeometry();
+
+	float res = SDF_INFINITY_DIST;
+	uint32_t stack[SDF_BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+
+	int numNodesVisited = 0;
+	int numEvaluations = 0;
+	while (stackSize > 0)
+	{
+		SdfBvhNode const& node = nodes[stack[--stackSize]];
+		++numNodesVisited;
+
+		// Bounds are inflated by 6k: nothing inside can change res. Outside the bounds every d > 6k,
+		// which is enough when p is already inside a shape (res <= 0).
+		float distSquared = node.GetDistanceSquared(p);
+		if (distSquared > 0.f && (res <= 0.f || distSquared >= res * res))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			for (uint32_t i = node.m_leftOrFirst; i < node.m_leftOrFirst + node.m_count; ++i)
+			{
+				res = SminCubic(res, SdfValueFromGeometry(p, m_streams.GetGeometry((int)i, isHalfPrecision)), toleranceK);
+			}
+			numEvaluations += (int)node.m_count;
+			continue;
+		}
+
+		// Left first, so leaves are visited in stream order and res is bit-identical to SdfMapAll.
+		// sminCubic is not associative, a nearest-first order would change the blend.
+		stack[stackSize++] = node.m_leftOrFirst + 1;
+		stack[stackSize++] = node.m_leftOrFirst;
+	}
+
+	if (counters)
+	{
+		counters->m_numSdfEvaluations += numEvaluations;
+		counters->m_numBvhNodesVisited += numNodesVisited;
+	}
+	return res;
+}
+
+float SdfCpuRayMarcher::SdfMapList(Vec3 const& p, SdfShapeList const& shapeList, SdfCpuRayCounters* counters /*= nullptr*/) const
+{
+	const float toleranceK = m_constants.toleranceK;
+	const bool isHalfPrecision = IsHalfPrecisionGeometry();
+
+	float res = SDF_INFINITY_DIST;
+	for (int i = 0; i < shapeList.m_count; ++i)
+	{
+		res = SminCubic(res, SdfValueFromGeometry(p, m_streams.GetGeometry((int)shapeList.m_indices[i], isHalfPrecision)), toleranceK);
+	}
+
+	if (counters)
+	{
+		counters->m_numSdfEvaluations += shapeList.m_count;
+	}
+	return res;
+}
+
+float SdfCpuRayMarcher::SdfMapAll(Vec3 const& p, SdfCpuRayCounters* counters) const
+{
+	const int numOfShapes = m_constants.numOfShapes;
+	const float toleranceK = m_constants.toleranceK;
+
+	float res = SDF_INFINITY_DIST;
+	if (m_constants.halfPrecisionGeometry)
+	{
+		for (int i = 0; i < numOfShapes; ++i)
+		{
+			res = SminCubic(res, SdfValueFromGeometry(p, m_streams.GetGeometry(i, true)), toleranceK);
+		}
+	}
+	else
+	{
+		for (int i = 0; i < numOfShapes; ++i)
+		{
+			res = SminCubic(res, SdfValueFromGeometry(p, m_streams.m_geometry[i].m_data0), toleranceK);
+		}
+	}
+
+	if (counters)
+	{
+		counters->m_numSdfEvaluations += numOfShapes;
+	}
+	return res;
+}
+
+Vec3 SdfCpuRayMarcher::SdfNormalTetra(Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	constexpr float h = 0.0001f;
+	Vec3 const kxyy = Vec3(1.f, -1.f, -1.f);
+	Vec3 const kyyx = Vec3(-1.f, -1.f, 1.f);
+	Vec3 const kyxy = Vec3(-1.f, 1.f, -1.f);
+	Vec3 const kxxx = Vec3(1.f, 1.f, 1.f);
+
+	Vec3 gradient = kxyy * SdfMap(p + kxyy * h, counters, shapeList) +
+		kyyx * SdfMap(p + kyyx * h, counters, shapeList) +
+		kyxy * SdfMap(p + kyxy * h, counters, shapeList) +
+		kxxx * SdfMap(p + kxxx * h, counters, shapeList);
+	return gradient.GetNormalized();
+}
+
+SdfDistanceGradient SdfCpuRayMarcher::SdfMapGradient(Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	const float toleranceK = m_constants.toleranceK;
+	const bool isHalfPrecision = IsHalfPrecisionGeometry();
+
+	if (counters)
+	{
+		++counters->m_numSdfMapCalls;
+	}
+
+	SdfDistanceGradient res;
+	int numEvaluations = 0;
+	if (shapeList)
+	{
+		for (int i = 0; i < shapeList->m_count; ++i)
+		{
+			res = SminCubicGradient(res, SdfGradientFromGeometry(p, m_streams.GetGeometry((int)shapeList->m_indices[i], isHalfPrecision)), toleranceK);
+		}
+		numEvaluations = shapeList->m_count;
+	}
+	else if (m_constants.useBvh && m_constants.numOfBvhNodes > 0)
+	{
+		// Same culling as SdfMapBvh: a skipped shape has h = 0 in SminCubicGradient, so it changes neither value nor gradient
+		std::vector<SdfBvhNode> const& nodes = m_bvh.GetNodes();
+		uint32_t stack[SDF_BVH_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			SdfBvhNode const& node = nodes[stack[--stackSize]];
+			float distSquared = node.GetDistanceSquared(p);
+			if (distSquared > 0.f && (res.m_distance <= 0.f || distSquared >= res.m_distance * res.m_distance))
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = node.m_leftOrFirst; i < node.m_leftOrFirst + node.m_count; ++i)
+				{
+					res = SminCubicGradient(res, SdfGradientFromGeometry(p, m_streams.GetGeometry((int)i, isHalfPrecision)), toleranceK);
+				}
+				numEvaluations += (int)node.m_count;
+				continue;
+			}
+			stack[stackSize++] = node.m_leftOrFirst + 1;
+			stack[stackSize++] = node.m_leftOrFirst;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < m_constants.numOfShapes; ++i)
+		{
+			res = SminCubicGradient(res, SdfGradientFromGeometry(p, m_streams.GetGeometry(i, isHalfPrecision)), toleranceK);
+		}
+		numEvaluations = m_constants.numOfShapes;
+	}
+
+	if (counters)
+	{
+		counters->m_numSdfEvaluations += numEvaluations;
+	}
+	return res;
+}
+
+Vec3 SdfCpuRayMarcher::SdfNormal(Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	if (m_constants.useAnalyticNormals && !UseCsgProgram())
+	{
+		// Zero at a sphere center, or where opposite blends cancel: no direction to normalize
+		Vec3 gradient = SdfMapGradient(p, counters, shapeList).m_gradient;
+		if (gradient.GetLengthSquared() > 1e-12f)
+		{
+			return gradient.GetNormalized();
+		}
+	}
+	return SdfNormalTetra(p, counters, shapeList);
+}
+
+template <typename EMIT_FUNC>
+void SdfCpuRayMarcher::VisitSurfaceShapes(Vec3 const& p, SdfCpuRayCounters* counters, SdfShapeList const* shapeList, EMIT_FUNC const& emitShape) const
+{
+	const int numOfShapes = m_constants.numOfShapes;
+	const float toleranceK = m_constants.toleranceK;
+
+	float threshold = toleranceK * 3.f;
+	const bool isHalfPrecision = IsHalfPrecisionGeometry();
+
+	// Top-K: gather the weights first, whenever the candidates fill up keep the K heaviest, and sample only those
+	const bool useTopK = (m_constants.useTopKMaterials != 0);
+	float candidateWeights[SDF_TOPK_CANDIDATES];
+	int candidateShapes[SDF_TOPK_CANDIDATES];
+	int numCandidates = 0;
+	auto reduceCandidates = [&]()
+	{
+		int topIndices[SDF_TOPK_MAX_MATERIALS];
+		for (int j = numCandidates; j < SDF_TOPK_CANDIDATES; ++j)
+		{
+			candidateWeights[j] = -1.f;
+		}
+		GetTopKCandidateIndices(m_topKMaterials, candidateWeights, topIndices);
+		float topWeights[SDF_TOPK_MAX_MATERIALS];
+		int topShapes[SDF_TOPK_MAX_MATERIALS];
+		for (int j = 0; j < m_topKMaterials; ++j)
+		{
+			topWeights[j] = candidateWeights[topIndices[j]];
+			topShapes[j] = candidateShapes[topIndices[j]];
+		}
+		numCandidates = 0;
+		for (int j = 0; j < m_topKMaterials; ++j)
+		{
+			if (topWeights[j] >= 0.f)
+			{
+				candidateWeights[numCandidates] = topWeights[j];
+				candidateShapes[numCandidates] = topShapes[j];
+				++numCandidates;
+			}
+		}
+	};
+
+	auto accumulateShape = [&](int i)
+	{
+		float d = SdfValueFromGeometry(p, m_streams.GetGeometry(i, isHalfPrecision));
+
+		if (d > threshold)
+		{
+			return;
+		}
+
+		if (counters)
+		{
+			++counters->m_numMaterialCandidates;
+		}
+		if (!useTopK)
+		{
+			emitShape(i, fmaxf(0.f, threshold - d));
+			return;
+		}
+		if (numCandidates == SDF_TOPK_CANDIDATES)
+		{
+			reduceCandidates();
+		}
+		candidateWeights[numCandidates] = threshold - d;
+		candidateShapes[numCandidates] = i;
+		++numCandidates;
+	};
+
+	if (shapeList)
+	{
+		// Tiles are binned with a 6k inflation, so every shape within the 3k threshold is in the list
+		for (int i = 0; i < shapeList->m_count; ++i)
+		{
+			accumulateShape((int)shapeList->m_indices[i]);
+		}
+	}
+	else if (m_constants.useBvh && m_constants.numOfBvhNodes > 0)
+	{
+		// threshold (3k) is inside the 6k inflation, so only nodes containing p can hold a weighted shape
+		std::vector<SdfBvhNode> const& nodes = m_bvh.GetNodes();
+		uint32_t stack[SDF_BVH_STACK_SIZE];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			SdfBvhNode const& node = nodes[stack[--stackSize]];
+			if (node.GetDistanceSquared(p) > 0.f)
+			{
+				continue;
+			}
+			if (node.IsLeaf())
+			{
+				for (uint32_t i = node.m_leftOrFirst; i < node.m_leftOrFirst + node.m_count; ++i)
+				{
+					accumulateShape((int)i);
+				}
+				continue;
+			}
+			stack[stackSize++] = node.m_leftOrFirst + 1;
+			stack[stackSize++] = node.m_leftOrFirst;
+		}
+	}
+	else
+	{
+		for (int i = 0; i < numOfShapes; ++i)
+		{
+			accumulateShape(i);
+		}
+	}
+
+	if (useTopK && numCandidates > 0)
+	{
+		// Shares of the K kept weights, the final divide renormalizes over what is left after the cut
+		if (numCandidates > m_topKMaterials)
+		{
+			reduceCandidates();
+		}
+		float topWeightSum = 0.f;
+		for (int j = 0; j < numCandidates; ++j)
+		{
+			topWeightSum += candidateWeights[j];
+		}
+		for (int j = 0; j < numCandidates; ++j)
+		{
+			if (candidateWeights[j] >= m_constants.topKMinWeight * topWeightSum)
+			{
+				emitShape(candidateShapes[j], candidateWeights[j]);
+			}
+		}
+	}
+}
+
+void SdfCpuRayMarcher::AccumulateSurfaceData(SdfSurfaceDataSum& sum, int shapeIndex, Vec3 const& p, Vec3 const& worldNormal, float w, SdfCpuRayCounters* counters) const
+{
+	const float uvScale = m_constants.triplanarUVScale;
+	const float sharpness = m_constants.triplanarBlendSharpness;
+
+	// Cold data is only touched for the few shapes close to the hit
+	if (counters)
+	{
+		++counters->m_numMaterialEvaluations;
+	}
+	SdfMaterial const defaultMaterial;
+	uint16_t materialID = m_streams.m_shapeMaterials[shapeIndex].m_materialID;
+	SdfMaterial const& material = (materialID < m_materials.size()) ? m_materials[materialID] : defaultMaterial;
+
+	SdfCpuTexture const* albedoTexture = m_textureTable ? m_textureTable->Find(material.m_triAlbedoTexID) : nullptr;
+	SdfCpuTexture const* metalicRoughnessTexture = m_textureTable ? m_textureTable->Find(material.m_triMRTexID) : nullptr;
+	SdfCpuTexture const* normalTexture = m_textureTable ? m_textureTable->Find(material.m_triNormalTexID) : nullptr;
+	SdfCpuTexture const* occlusionTexture = m_textureTable ? m_textureTable->Find(material.m_triOcclusionTexID) : nullptr;
+	SdfCpuTexture const* emissiveTexture = m_textureTable ? m_textureTable->Find(material.m_triEmissiveTexID) : nullptr;
+
+	float shapeColorFloats[4];
+	m_streams.GetColor(shapeIndex).GetAsFloats(shapeColorFloats);
+	Vec4 shapeColor = Vec4(shapeColorFloats[0], shapeColorFloats[1], shapeColorFloats[2], shapeColorFloats[3]);
+	Vec4 albedoTexel = SampleTriplanar(p, worldNormal, uvScale, sharpness, albedoTexture, shapeColor);
+	if (albedoTexel.w < 0.01f)
+	{
+		return;
+	}
+
+	Vec4 metalicRoughnessTexel = SampleTriplanar(p, worldNormal, uvScale, sharpness, metalicRoughnessTexture, Vec4(1.f, 0.5f, 0.f, 1.f));
+	float occlusion = SampleTriplanar(p, worldNormal, uvScale, sharpness, occlusionTexture, Vec4(1.f, 0.5f, 0.f, 1.f)).x;
+	Vec4 emissiveTexel = SampleTriplanar(p, worldNormal, uvScale, sharpness, emissiveTexture, Vec4(0.f, 0.f, 0.f, 1.f));
+
+	Vec3 pixelNormalWorldSpace = SampleTriplanarNormal(p, worldNormal, uvScale, sharpness, normalTexture, Vec4(0.5f, 0.5f, 1.f, 1.f));
+
+	sum.m_weight += w;
+
+	sum.m_albedo += Vec3(albedoTexel.x, albedoTexel.y, albedoTexel.z) * w;
+	sum.m_normal += pixelNormalWorldSpace * w;
+	sum.m_metallic += w * metalicRoughnessTexel.z;
+	sum.m_roughness += w * metalicRoughnessTexel.y;
+	sum.m_emission += Vec3(emissiveTexel.x, emissiveTexel.y, emissiveTexel.z) * w;
+	sum.m_ao += w * occlusion;
+}
+
+SdfSurfaceData SdfCpuRayMarcher::ResolveSurfaceData(SdfSurfaceDataSum const& sum)
+{
+	SdfSurfaceData surf;
+	if (sum.m_weight > 0.f)
+	{
+		surf.m_albedo = sum.m_albedo / sum.m_weight;
+		surf.m_normal = sum.m_normal.GetNormalized();
+		surf.m_metallic = sum.m_metallic / sum.m_weight;
+		surf.m_roughness = sum.m_roughness / sum.m_weight;
+		surf.m_emission = sum.m_emission / sum.m_weight;
+		surf.m_ao = sum.m_ao / sum.m_weight;
+	}
+	return surf;
+}
+
+SdfSurfaceData SdfCpuRayMarcher::GetWeightedSurfaceData(Vec3 const& p, Vec3 const& worldNormal, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	SdfSurfaceDataSum sum;
+	VisitSurfaceShapes(p, counters, shapeList, [&](int shapeIndex, float weight)
+	{
+		AccumulateSurfaceData(sum, shapeIndex, p, worldNormal, weight, counters);
+	});
+	return ResolveSurfaceData(sum);
+}
+
+int SdfCpuRayMarcher::GetSurfaceShapes(Vec3 const& p, uint32_t out_shapes[], int maxShapes, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	int numShapes = 0;
+	VisitSurfaceShapes(p, counters, shapeList, [&](int shapeIndex, float /*weight*/)
+	{
+		if (numShapes < maxShapes)
+		{
+			out_shapes[numShapes] = (uint32_t)shapeIndex;
+		}
+		++numShapes;
+	});
+	return (numShapes <= maxShapes) ? numShapes : -1;
+}
+
+SdfSurfaceData SdfCpuRayMarcher::GetGBufferSurfaceData(SdfGBufferTexel const& texel, Vec3 const& p, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	if (texel.IsOverflow())
+	{
+		return GetWeightedSurfaceData(p, texel.m_normal, counters, shapeList);
+	}
+
+	// Same p and same geometry, so the same weights the gather saw
+	float threshold = m_constants.toleranceK * 3.f;
+	const bool isHalfPrecision = IsHalfPrecisionGeometry();
+	SdfSurfaceDataSum sum;
+	for (uint32_t shapeIndex : texel.m_shapes)
+	{
+		if (shapeIndex == SDF_GBUFFER_NO_SHAPE)
+		{
+			break;
+		}
+		float d = SdfValueFromGeometry(p, m_streams.GetGeometry((int)shapeIndex, isHalfPrecision));
+		AccumulateSurfaceData(sum, (int)shapeIndex, p, texel.m_normal, fmaxf(0.f, threshold - d), counters);
+	}
+	return ResolveSurfaceData(sum);
+}
+
+Vec3 SdfCpuRayMarcher::ShadeSurface(SdfSurfaceData const& surf, Vec3 const& worldPos, Vec3 const& cameraWorldPos) const
+{
+	Vec3 directLighting = CalcTotalPBRLight(m_lightConstants, surf, worldPos, cameraWorldPos);
+
+	Vec3 ambient = Vec3(0.02f, 0.02f, 0.02f) * surf.m_albedo * surf.m_ao;
+
+	Vec3 color = ambient + directLighting + surf.m_emission;
+	color = ACESFilm(color);
+	color = PowVec3(color, 1.f / 2.2f); // Gamma correction
+
+	if (m_debugInt == 1)
+	{
+		color = surf.m_albedo;
+	}
+	else if (m_debugInt == 2)
+	{
+		color = EncodeXYZToRGB(surf.m_normal);
+	}
+	else if (m_debugInt == 3)
+	{
+		color = Vec3(0.f, surf.m_roughness, surf.m_metallic);
+	}
+	else if (m_debugInt == 4)
+	{
+		color = Vec3(surf.m_ao, surf.m_ao, surf.m_ao);
+	}
+	return color;
+}
+
+Vec3 SdfCpuRayMarcher::ShadeHit(Vec3 const& hitPos, Vec3 const& cameraWorldPos, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	Vec3 N = SdfNormal(hitPos, counters, shapeList);
+	SdfSurfaceData surf = GetWeightedSurfaceData(hitPos, N, counters, shapeList);
+	return ShadeSurface(surf, hitPos, cameraWorldPos);
+}
+
+Vec4 SdfCpuRayMarcher::RayMarch(Vec3 const& rayStartPos, Vec3 const& rayFwdNormal, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/, float startDistance /*= 0.f*/,
+	bool shadeHit /*= true*/) const
+{
+	const int maxSteps = m_constants.maxSteps;
+	const float minHitDistance = m_constants.minHitDistance;
+	const float maxTraceDistance = m_constants.maxTraceDistance;
+
+	const Vec3 missingColor = GetMissingColor();
+	const bool useBrickMap = (m_constants.useBrickMap != 0) && m_brickMap && !UseCsgProgram(); // baked from the shapes, not the program
+
+	// Enhanced sphere tracing (Keinert et al. 2014) when useOverRelaxation is set, plain when omega is 1
+	const float relaxedOmega = m_constants.useOverRelaxation ? m_constants.overRelaxationOmega : 1.f;
+	float omega = relaxedOmega;
+	float previousDist = 0.f;
+	float stepLength = 0.f;
+	bool hasFallenBack = false;
+
+	float distTraveled = startDistance;
+	for (int step = 0; step < maxSteps; ++step)
+	{
+		if (counters)
+		{
+			++counters->m_numSteps;
+		}
+
+		Vec3 currPos = rayStartPos + rayFwdNormal * distTraveled;
+
+		// Far from surfaces the cached bound is a safe step, the narrow band needs the exact field
+		float distToClosest = useBrickMap ? m_brickMap->GetLowerBound(currPos) : 0.f;
+		if (distToClosest > SDF_BRICK_NARROW_BAND)
+		{
+			if (counters)
+			{
+				++counters->m_numBrickMapSteps;
+			}
+		}
+		else
+		{
+			distToClosest = SdfMap(currPos, counters, shapeList);
+		}
+
+		// Over-relaxed steps are safe while the empty spheres of consecutive points overlap. Once they do not,
+		// step back inside the previous sphere (omega * (2 - omega) <= 1 of its radius) and take plain steps
+		// until the distance grows again, when the ray is leaving the surface it came close to.
+		if (omega > 1.f && fabsf(distToClosest) + previousDist < stepLength)
+		{
+			stepLength -= omega * stepLength;
+			omega = 1.f;
+			distTraveled += stepLength;
+			if (counters && !hasFallenBack)
+			{
+				++counters->m_numRelaxationFallbacks;
+			}
+			hasFallenBack = true;
+			continue;
+		}
+		if (fabsf(distToClosest) > previousDist)
+		{
+			omega = relaxedOmega;
+		}
+		previousDist = fabsf(distToClosest);
+
+		// Hit
+		if (distToClosest < minHitDistance)
+		{
+			Vec3 color = shadeHit ? ShadeHit(currPos, rayStartPos, counters, shapeList) : Vec3();
+			return Vec4(color.x, color.y, color.z, distTraveled);
+		}
+
+		// Miss
+		if (distToClosest > maxTraceDistance)
+		{
+			return Vec4(missingColor.x, missingColor.y, missingColor.z, SDF_INFINITY_DIST);
+		}
+		stepLength = distToClosest * omega;
+		distTraveled += stepLength;
+	}
+
+	// Miss
+	return Vec4(missingColor.x, missingColor.y, missingColor.z, SDF_INFINITY_DIST);
+}
+
+float SdfCpuRayMarcher::ConeMarch(Vec3 const& rayStartPos, Vec3 const& coneAxis, float tanHalfAngle, SdfCpuRayCounters* counters /*= nullptr*/) const
+{
+	const int maxSteps = m_constants.maxSteps;
+	const float minHitDistance = m_constants.minHitDistance;
+	const float maxTraceDistance = m_constants.maxTraceDistance;
+
+	// The field is 1-Lipschitz, so no point within dist - minHitDistance of currPos can be a hit. The cone section
+	// at t + advance stays inside that ball while advance * (1 + tan) <= dist - minHitDistance - t * tan.
+	// The full loop is used even with tile lists: they only drop shapes, which can only raise the field.
+	float t = 0.f;
+	for (int step = 0; step < maxSteps; ++step)
+	{
+		if (counters)
+		{
+			++counters->m_numConeSteps;
+		}
+
+		Vec3 currPos = rayStartPos + coneAxis * t;
+		float dist = SdfMap(currPos, counters) - minHitDistance;
+		float advance = (dist - t * tanHalfAngle) / (1.f + tanHalfAngle);
+		if (advance < minHitDistance)
+		{
+			break;
+		}
+		t += advance;
+
+		if (dist > maxTraceDistance)
+		{
+			break;
+		}
+	}
+	return t;
+}
+
+SdfCpuFrameStats SdfCpuRayMarcher::RenderConeDepth(SdfCpuView const& view, IntVec2 const& dimensions, std::vector<float>& out_startDistances, JobPool* jobPool) const
+{
+	IntVec2 coneDimensions = GetConeDepthDimensions(dimensions);
+	out_startDistances.assign((size_t)coneDimensions.x * coneDimensions.y, 0.f);
+
+	SdfCpuFrameStats stats = RunSdfCpuTiles(coneDimensions, jobPool, [&](IntVec2 const& tileCoords, SdfCpuRayCounters& counters)
+	{
+		int startX = tileCoords.x * SDF_TILE_SIZE;
+		int startY = tileCoords.y * SDF_TILE_SIZE;
+		int endX = (startX + SDF_TILE_SIZE < coneDimensions.x) ? startX + SDF_TILE_SIZE : coneDimensions.x;
+		int endY = (startY + SDF_TILE_SIZE < coneDimensions.y) ? startY + SDF_TILE_SIZE : coneDimensions.y;
+		for (int y = startY; y < endY; ++y)
+		{
+			for (int x = startX; x < endX; ++x)
+			{
+				Vec3 coneAxis;
+				float tanHalfAngle = 0.f;
+				view.GetConeRay(IntVec2(x, y), dimensions, coneAxis, tanHalfAngle);
+				out_startDistances[y * coneDimensions.x + x] = ConeMarch(view.m_position, coneAxis, tanHalfAngle, &counters);
+			}
+		}
+	});
+	return stats;
+}
+
+IntVec2 SdfCpuRayMarcher::GetConeDepthDimensions(IntVec2 const& dimensions)
+{
+	return IntVec2((dimensions.x + SDF_CONE_PREPASS_FACTOR - 1) / SDF_CONE_PREPASS_FACTOR, (dimensions.y + SDF_CONE_PREPASS_FACTOR - 1) / SDF_CONE_PREPASS_FACTOR);
+}
+
+float SdfCpuRayMarcher::ValidateTemporalStart(Vec3 const& rayStartPos, Vec3 const& rayFwdNormal, float safeStartDistance, float hintDistance, SdfCpuRayCounters* counters /*= nullptr*/, SdfShapeList const* shapeList /*= nullptr*/) const
+{
+	if (hintDistance <= safeStartDistance)
+	{
+		return safeStartDistance;
+	}
+
+	// A surface that came in front of the old one leaves the hint on or inside it
+	bool isValid = (SdfMap(rayStartPos + rayFwdNormal * hintDistance, counters, shapeList) >= m_constants.minHitDistance);
+	if (counters)
+	{
+		++(isValid ? counters->m_numTemporalStarts : counters->m_numTemporalFallbacks);
+	}
+	return isValid ? hintDistance : safeStartDistance;
+}
+
+SdfCpuFrameStats SdfCpuRayMarcher::RenderFrame(SdfCpuView const& view, IntVec2 const& dimensions, SdfCpuImage& out_image, JobPool* jobPool, SdfDeferredShadingStats* out_deferredStats /*= nullptr*/) const
+{
+	if (out_image.m_dimensions != dimensions)
+	{
+		out_image.Resize(dimensions);
+	}
+
+	// The pre-passes are part of the frame, same as on the GPU
+	double prepassMilliseconds = 0.0;
+	SdfCpuRayCounters prepassCounters;
+
+	SdfTileBinning binning;
+	if (m_constants.useTileBinning)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		binning.Build(view, dimensions, m_streams, IsHalfPrecisionGeometry(), m_constants.toleranceK);
+		prepassMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	SdfTileClassification classification;
+	if (m_constants.useTileClassification)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		classification.Classify(view, dimensions, m_streams, IsHalfPrecisionGeometry(), m_constants);
+		prepassMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	std::vector<float> coneStartDistances;
+	if (m_constants.useConeDepthPrepass)
+	{
+		SdfCpuFrameStats coneStats = RenderConeDepth(view, dimensions, coneStartDistances, jobPool);
+		prepassMilliseconds += coneStats.m_milliseconds;
+		prepassCounters.Add(coneStats.m_counters);
+	}
+
+	bool useTemporalReprojection = m_constants.useTemporalReprojection && m_temporalHistory;
+	SdfTemporalReprojection temporalReprojection;
+	if (useTemporalReprojection)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		temporalReprojection.Build(*m_temporalHistory, view, dimensions);
+		prepassMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	const bool useDeferredShading = (m_constants.useDeferredShading != 0);
+	std::vector<SdfGBufferTexel> gbuffer;
+	if (useDeferredShading)
+	{
+		gbuffer.resize((size_t)dimensions.x * dimensions.y);
+	}
+
+	SdfCpuFrameStats stats = RunSdfCpuTiles(dimensions, jobPool, [&](IntVec2 const& tileCoords, SdfCpuRayCounters& counters)
+	{
+		if (m_constants.useTileClassification && !classification.IsTileOccupied(tileCoords))
+		{
+			FillBackgroundTile(view, tileCoords, out_image, useDeferredShading ? &gbuffer : nullptr);
+			return;
+		}
+
+		SdfShapeList shapeList;
+		if (m_constants.useTileBinning)
+		{
+			shapeList = binning.GetTileShapes(tileCoords);
+		}
+		RenderTile(view, tileCoords, out_image, counters, m_constants.useTileBinning ? &shapeList : nullptr,
+			m_constants.useConeDepthPrepass ? &coneStartDistances : nullptr, useTemporalReprojection ? &temporalReprojection : nullptr,
+			useDeferredShading ? &gbuffer : nullptr);
+	});
+	stats.m_milliseconds += prepassMilliseconds;
+	stats.m_counters.Add(prepassCounters);
+
+	if (!useDeferredShading)
+	{
+		return stats;
+	}
+
+	// Shading pass: the hits grouped by material set, SDF_TILE_SIZE^2 of them per job like a thread group
+	auto startTime = std::chrono::steady_clock::now();
+
+	// Coarse shading: the pixels on their block's surface are left out of the sort
+	const bool useShadingRate = (m_constants.shadingRate > 1);
+	std::vector<int> shadingSources;
+	if (useShadingRate)
+	{
+		shadingSources.resize(gbuffer.size());
+		for (int pixelIndex = 0; pixelIndex < (int)gbuffer.size(); ++pixelIndex)
+		{
+			shadingSources[pixelIndex] = GetSdfShadingSource(gbuffer, dimensions, pixelIndex, m_constants);
+		}
+	}
+
+	std::vector<int> shadePixels;
+	int binCounts[SDF_SHADE_BINS];
+	SortSdfShadePixels(gbuffer, m_streams, shadePixels, binCounts, useShadingRate ? &shadingSources : nullptr);
+
+	const int groupSize = SDF_TILE_SIZE * SDF_TILE_SIZE;
+	int numHits = (int)shadePixels.size();
+	int numGroups = (numHits + groupSize - 1) / groupSize;
+	std::vector<SdfCpuRayCounters> groupCounters(numGroups);
+	auto shadeGroup = [&](int groupIndex)
+	{
+		SdfCpuRayCounters& counters = groupCounters[groupIndex];
+		int endSlot = std::min((groupIndex + 1) * groupSize, numHits);
+		for (int slot = groupIndex * groupSize; slot < endSlot; ++slot)
+		{
+			int pixelIndex = shadePixels[slot];
+			int x = pixelIndex % dimensions.x;
+			int y = pixelIndex / dimensions.x;
+			SdfGBufferTexel const& texel = gbuffer[pixelIndex];
+
+			SdfShapeList shapeList;
+			if (m_constants.useTileBinning)
+			{
+				shapeList = binning.GetTileShapes(IntVec2(x / SDF_TILE_SIZE, y / SDF_TILE_SIZE));
+			}
+
+			// Same point the march stopped at
+			Vec3 rayStartPos = view.m_position;
+			Vec3 hitPos = rayStartPos + view.GetRayDirection(x, y, dimensions) * texel.m_distance;
+
+			int64_t numMaterialEvaluationsBefore = counters.m_numMaterialEvaluations;
+			SdfSurfaceData surf = GetGBufferSurfaceData(texel, hitPos, &counters, m_constants.useTileBinning ? &shapeList : nullptr);
+			int numMaterialEvaluations = (int)(counters.m_numMaterialEvaluations - numMaterialEvaluationsBefore);
+			out_image.m_materialCounts[pixelIndex] = numMaterialEvaluations;
+
+			if (m_debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+			{
+				out_image.m_colors[pixelIndex] = GetSdfCostHeatmapColor(numMaterialEvaluations, SDF_COST_HEATMAP_MAX_MATERIALS);
+			}
+			else if (m_debugInt != SDF_COST_HEATMAP_STEPS && m_debugInt != SDF_COST_HEATMAP_SDF_MAP_CALLS)
+			{
+				out_image.m_colors[pixelIndex] = ShadeSurface(surf, hitPos, rayStartPos);
+			}
+		}
+	};
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numGroups, shadeGroup);
+	}
+	else
+	{
+		for (int groupIndex = 0; groupIndex < numGroups; ++groupIndex)
+		{
+			shadeGroup(groupIndex);
+		}
+	}
+
+	// SDF_PREPASS_SHADE_RESOLVE: the block's shaded color, or no material cost in its heatmap; the march's heatmaps stay
+	int numReusedPixels = 0;
+	if (useShadingRate)
+	{
+		for (int pixelIndex = 0; pixelIndex < (int)gbuffer.size(); ++pixelIndex)
+		{
+			int sourceIndex = shadingSources[pixelIndex];
+			if (sourceIndex == pixelIndex)
+			{
+				continue;
+			}
+			++numReusedPixels;
+			if (m_debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+			{
+				out_image.m_colors[pixelIndex] = GetSdfCostHeatmapColor(0, SDF_COST_HEATMAP_MAX_MATERIALS);
+			}
+			else if (m_debugInt != SDF_COST_HEATMAP_STEPS && m_debugInt != SDF_COST_HEATMAP_SDF_MAP_CALLS)
+			{
+				out_image.m_colors[pixelIndex] = out_image.m_colors[sourceIndex];
+			}
+		}
+	}
+
+	SdfCpuFrameStats shadeStats;
+	shadeStats.m_numRays = numHits;
+	shadeStats.m_milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	for (SdfCpuRayCounters const& counters : groupCounters)
+	{
+		shadeStats.m_counters.Add(counters);
+	}
+
+	if (out_deferredStats)
+	{
+		out_deferredStats->m_marchStats = stats;
+		out_deferredStats->m_shadeStats = shadeStats;
+		out_deferredStats->m_numShadeBinsUsed = 0;
+		for (int bin = 0; bin < SDF_SHADE_BINS; ++bin)
+		{
+			out_deferredStats->m_numShadeBinsUsed += (binCounts[bin] > 0) ? 1 : 0;
+		}
+		out_deferredStats->m_numOverflowPixels = binCounts[0];
+		out_deferredStats->m_numReusedPixels = numReusedPixels;
+	}
+
+	stats.m_milliseconds += shadeStats.m_milliseconds;
+	stats.m_counters.Add(shadeStats.m_counters);
+	return stats;
+}
+
+SdfCpuFrameStats SdfCpuRayMarcher::RenderTiles(SdfCpuView const& view, std::vector<uint32_t> const& tileList, int numMarchTiles, SdfCpuImage& inout_image, JobPool* jobPool) const
+{
+	IntVec2 const& dimensions = inout_image.m_dimensions;
+	double prepassMilliseconds = 0.0;
+	SdfCpuRayCounters prepassCounters;
+
+	SdfTileBinning binning;
+	if (m_constants.useTileBinning)
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		binning.Build(view, dimensions, m_streams, IsHalfPrecisionGeometry(), m_constants.toleranceK);
+		prepassMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+	}
+
+	// Still the whole pre-pass, a cone spans more than one tile
+	std::vector<float> coneStartDistances;
+	if (m_constants.useConeDepthPrepass)
+	{
+		SdfCpuFrameStats coneStats = RenderConeDepth(view, dimensions, coneStartDistances, jobPool);
+		prepassMilliseconds += coneStats.m_milliseconds;
+		prepassCounters.Add(coneStats.m_counters);
+	}
+
+	int numTilesX = (dimensions.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE;
+	int numTilesY = (dimensions.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE;
+	std::vector<uint8_t> isFillTile(numTilesX * numTilesY, 0);
+	for (int slot = numMarchTiles; slot < (int)tileList.size(); ++slot)
+	{
+		IntVec2 tileCoords = SdfTileClassification::UnpackTileCoords(tileList[slot]);
+		isFillTile[tileCoords.y * numTilesX + tileCoords.x] = 1;
+	}
+
+	SdfCpuFrameStats stats = RunSdfCpuTileList(dimensions, tileList, jobPool, [&](IntVec2 const& tileCoords, SdfCpuRayCounters& counters)
+	{
+		if (isFillTile[tileCoords.y * numTilesX + tileCoords.x])
+		{
+			FillBackgroundTile(view, tileCoords, inout_image, nullptr);
+			return;
+		}
+
+		SdfShapeList shapeList;
+		if (m_constants.useTileBinning)
+		{
+			shapeList = binning.GetTileShapes(tileCoords);
+		}
+		RenderTile(view, tileCoords, inout_image, counters, m_constants.useTileBinning ? &shapeList : nullptr,
+			m_constants.useConeDepthPrepass ? &coneStartDistances : nullptr, nullptr, nullptr);
+	});
+	stats.m_milliseconds += prepassMilliseconds;
+	stats.m_counters.Add(prepassCounters);
+	return stats;
+}
+
+void SdfCpuRayMarcher::FillBackgroundTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, std::vector<SdfGBufferTexel>* out_gbuffer) const
+{
+	IntVec2 const& dimensions = out_image.m_dimensions;
+	int startX = tileCoords.x * SDF_TILE_SIZE;
+	int startY = tileCoords.y * SDF_TILE_SIZE;
+	int endX = (startX + SDF_TILE_SIZE < dimensions.x) ? startX + SDF_TILE_SIZE : dimensions.x;
+	int endY = (startY + SDF_TILE_SIZE < dimensions.y) ? startY + SDF_TILE_SIZE : dimensions.y;
+
+	// A zero cost is the cold end of every heatmap
+	Vec3 color = GetMissingColor();
+	if (m_debugInt == SDF_COST_HEATMAP_STEPS || m_debugInt == SDF_COST_HEATMAP_SDF_MAP_CALLS || m_debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+	{
+		color = GetSdfCostHeatmapColor(0, (m_debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS) ? SDF_COST_HEATMAP_MAX_MATERIALS : m_constants.maxSteps);
+	}
+
+	for (int y = startY; y < endY; ++y)
+	{
+		for (int x = startX; x < endX; ++x)
+		{
+			int pixelIndex = y * dimensions.x + x;
+			if (out_gbuffer)
+			{
+				(*out_gbuffer)[pixelIndex] = SdfGBufferTexel();
+			}
+			out_image.m_stepCounts[pixelIndex] = 0;
+			out_image.m_sdfMapCounts[pixelIndex] = 0;
+			out_image.m_materialCounts[pixelIndex] = 0;
+			out_image.m_colors[pixelIndex] = color;
+			out_image.m_depths[pixelIndex] = view.GetDepth(view.m_position + view.GetRayDirection(x, y, dimensions) * SDF_INFINITY_DIST);
+		}
+	}
+}
+
+void SdfCpuRayMarcher::RenderTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, SdfCpuRayCounters& counters, SdfShapeList const* shapeList, std::vector<float> const* coneStartDistances,
+	SdfTemporalReprojection const* temporalReprojection, std::vector<SdfGBufferTexel>* out_gbuffer) const
+{
+	IntVec2 const& dimensions = out_image.m_dimensions;
+	int numConesX = GetConeDepthDimensions(dimensions).x;
+	int startX = tileCoords.x * SDF_TILE_SIZE;
+	int startY = tileCoords.y * SDF_TILE_SIZE;
+	int endX = (startX + SDF_TILE_SIZE < dimensions.x) ? startX + SDF_TILE_SIZE : dimensions.x;
+	int endY = (startY + SDF_TILE_SIZE < dimensions.y) ? startY + SDF_TILE_SIZE : dimensions.y;
+
+	for (int y = startY; y < endY; ++y)
+	{
+		for (int x = startX; x < endX; ++x)
+		{
+			Vec3 rayStartPos = view.m_position;
+			Vec3 rayFwdNormal = view.GetRayDirection(x, y, dimensions);
+
+			SdfCpuRayCounters countersBefore = counters;
+			float startDistance = 0.f;
+			if (coneStartDistances)
+			{
+				startDistance = (*coneStartDistances)[(y / SDF_CONE_PREPASS_FACTOR) * numConesX + x / SDF_CONE_PREPASS_FACTOR];
+			}
+			if (temporalReprojection)
+			{
+				float hintDistance = temporalReprojection->GetHintDistance(IntVec2(x, y));
+				startDistance = ValidateTemporalStart(rayStartPos, rayFwdNormal, startDistance, hintDistance, &counters, shapeList);
+			}
+
+			Vec4 marchRes = RayMarch(rayStartPos, rayFwdNormal, &counters, shapeList, startDistance, out_gbuffer == nullptr);
+
+			int pixelIndex = y * dimensions.x + x;
+			if (out_gbuffer)
+			{
+				// Deferred: the normal and the shapes to blend now, the materials in the shading pass
+				SdfGBufferTexel& texel = (*out_gbuffer)[pixelIndex];
+				texel = SdfGBufferTexel();
+				texel.m_distance = marchRes.w;
+				if (texel.IsHit())
+				{
+					Vec3 hitPos = rayStartPos + rayFwdNormal * marchRes.w;
+					texel.m_normal = SdfNormal(hitPos, &counters, shapeList);
+					if (GetSurfaceShapes(hitPos, texel.m_shapes, SDF_GBUFFER_MAX_SHAPES, &counters, shapeList) < 0)
+					{
+						texel.m_shapes[0] = SDF_GBUFFER_OVERFLOW;
+						for (int j = 1; j < SDF_GBUFFER_MAX_SHAPES; ++j)
+						{
+							texel.m_shapes[j] = SDF_GBUFFER_NO_SHAPE;
+						}
+					}
+				}
+			}
+			int numSteps = (int)(counters.m_numSteps - countersBefore.m_numSteps);
+			int numSdfMapCalls = (int)(counters.m_numSdfMapCalls - countersBefore.m_numSdfMapCalls);
+			int numMaterialEvaluations = (int)(counters.m_numMaterialEvaluations - countersBefore.m_numMaterialEvaluations);
+			out_image.m_stepCounts[pixelIndex] = numSteps;
+			out_image.m_sdfMapCounts[pixelIndex] = numSdfMapCalls;
+			out_image.m_materialCounts[pixelIndex] = numMaterialEvaluations;
+			out_image.m_colors[pixelIndex] = Vec3(marchRes.x, marchRes.y, marchRes.z);
+
+			// Cost heatmaps replace every pixel, same as ComputeMain
+			if (m_debugInt == SDF_COST_HEATMAP_STEPS)
+			{
+				out_image.m_colors[pixelIndex] = GetSdfCostHeatmapColor(numSteps, m_constants.maxSteps);
+			}
+			else if (m_debugInt == SDF_COST_HEATMAP_SDF_MAP_CALLS)
+			{
+				out_image.m_colors[pixelIndex] = GetSdfCostHeatmapColor(numSdfMapCalls, m_constants.maxSteps);
+			}
+			else if (m_debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+			{
+				out_image.m_colors[pixelIndex] = GetSdfCostHeatmapColor(numMaterialEvaluations, SDF_COST_HEATMAP_MAX_MATERIALS);
+			}
+			out_image.m_depths[pixelIndex] = view.GetDepth(rayStartPos + rayFwdNormal * marchRes.w);
+		}
+	}
+}
@@ -0,0 +1,297 @@
+#pragma once
+#include "Game/SdfBvh.hpp"
+#include "Game/SdfCommon.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/Vec2.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+#include "Engine/Renderer/RendererCommon.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+CPU reference of SdfRayMarching.hlsl.
+Every function here mirrors the HLSL function of the same name line by line, so keep both sides
+in sync when the shader math changes. Used for headless benchmarks and golden images.
+*/
+
+class JobPool;
+class SdfBrickMap;
+class SdfTemporalReprojection;
+struct SdfCsgProgram;
+struct SdfDeferredShadingStats;
+struct SdfGBufferTexel;
+struct SdfTemporalHistory;
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_TILE_SIZE = 8; // THREADS_PER_GROUP_SIZE in SdfRayMarching.hlsl
+constexpr float SDF_INFINITY_DIST = 1e35f;
+constexpr int SDF_CONE_PREPASS_FACTOR = 4; // SDF_CONE_PREPASS_FACTOR in SdfRayMarching.hlsl, full-res pixels per cone per axis
+constexpr float SDF_CONE_ANGLE_SLACK = 1.01f; // widens every cone a little against rounding
+constexpr int SDF_TOPK_MATERIALS = 4; // SDF_TOPK_MATERIALS in SdfRayMarching.hlsl, the shader's compile-time K
+constexpr int SDF_TOPK_MAX_MATERIALS = 4; // largest K the CPU side is specialized for
+constexpr int SDF_TOPK_CANDIDATES = 16; // SDF_TOPK_CANDIDATES in SdfRayMarching.hlsl, reduced to K whenever it fills up
+constexpr int SDF_TRIPLANAR_FETCHES_PER_MATERIAL = 15; // 5 textures, 3 planes each
+
+
+//-----------------------------------------------------------------------------------------------
+// Notes: same as SurfaceData in Lighting.hlsli
+struct SdfSurfaceData
+{
+	Vec3 m_albedo = Vec3(1.f, 1.f, 1.f);
+	Vec3 m_normal = Vec3(0.f, 0.f, 1.f);
+	float m_metallic = 0.f;
+	float m_roughness = 1.f;
+	Vec3 m_emission = Vec3(0.f, 0.f, 0.f);
+	float m_ao = 1.f;
+};
+
+
+// Weighted sums of the sampled materials, SdfSurfaceData once divided by the weight sum
+struct SdfSurfaceDataSum
+{
+	Vec3 m_albedo;
+	Vec3 m_normal;
+	float m_metallic = 0.f;
+	float m_roughness = 0.f;
+	Vec3 m_emission;
+	float m_ao = 0.f;
+	float m_weight = 0.f;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Stand-in for a Texture2D sampled with s_linearWrap
+struct SdfCpuTexture
+{
+	int m_width = 0;
+	int m_height = 0;
+	std::vector<Vec4> m_texels;
+
+	Vec4 SampleLinearWrap(Vec2 const& uv) const;
+};
+
+
+// Stand-in for ResourceDescriptorHeap: SRV index -> CPU texture.
+// Unregistered indices sample like the engine default textures, except albedo which uses the shape color.
+struct SdfCpuTextureTable
+{
+	std::map<uint32_t, SdfCpuTexture const*> m_textures;
+
+	SdfCpuTexture const* Find(uint32_t srvIndex) const;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Replaces CameraConstants. Rays are generated the same way ComputeMain does it (uv = pixel / size).
+struct SdfCpuView
+{
+	Vec3 m_position;
+	Vec3 m_forward = Vec3(1.f, 0.f, 0.f);
+	Vec3 m_left = Vec3(0.f, 1.f, 0.f);
+	Vec3 m_up = Vec3(0.f, 0.f, 1.f);
+
+	float m_fovDegrees = 60.f; // vertical, same as SpectatorCamera
+	float m_aspect = 2.f;
+	float m_near = 0.1f;
+	float m_far = 100.f;
+
+	Vec3 GetRayDirection(int pixelX, int pixelY, IntVec2 const& dimensions) const;
+	// Cone holding the rays of every full-res pixel in the SDF_CONE_PREPASS_FACTOR block of conePixel
+	void GetConeRay(IntVec2 const& conePixel, IntVec2 const& dimensions, Vec3& out_coneAxis, float& out_tanHalfAngle) const;
+	float GetDepth(Vec3 const& worldPos) const; // clip z / w, DirectX convention
+	float GetViewZ(float depth) const; // inverse of GetDepth, distance along m_forward
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfCpuImage
+{
+	IntVec2 m_dimensions;
+	std::vector<Vec3> m_colors;
+	std::vector<float> m_depths;
+	std::vector<int> m_stepCounts; // RayMarch steps of each pixel
+	std::vector<int> m_sdfMapCounts; // SdfMap calls of each pixel, the temporal start check and the normal included
+	std::vector<int> m_materialCounts; // material evaluations of each pixel, see SdfCostCounters.hpp
+
+	void Resize(IntVec2 const& dimensions);
+
+	bool WriteColorPPM(std::string const& filePath) const; // 8-bit binary P6
+	bool WriteDepthPFM(std::string const& filePath) const; // 32-bit float Pf
+	bool ReadColorPPM(std::string const& filePath);
+	bool ReadDepthPFM(std::string const& filePath);
+};
+
+
+struct SdfImageDiff
+{
+	float m_maxColorError = 0.f; // in 0-255 units
+	float m_meanColorError = 0.f;
+	float m_maxDepthError = 0.f;
+	int m_numPixelsOverTolerance = 0;
+};
+
+// Colors are compared after 8-bit quantization, the same precision the PPM golden stores
+SdfImageDiff CompareSdfImages(SdfCpuImage const& a, SdfCpuImage const& b, float colorTolerance = 2.f, float depthTolerance = 1e-4f);
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfCpuRayCounters
+{
+	int64_t m_numSteps = 0;
+	int64_t m_numSdfEvaluations = 0; // shape distance evaluations, the inner loop of SdfMap
+	int64_t m_numSdfMapCalls = 0;
+	int64_t m_numMaterialEvaluations = 0; // shapes whose material GetWeightedSurfaceData sampled
+	int64_t m_numMaterialCandidates = 0; // shapes within the blend threshold, what full blending samples
+	int64_t m_numShapesCulled = 0; // shape evaluations proven unnecessary and skipped
+	int64_t m_numBvhNodesVisited = 0;
+	int64_t m_numBrickMapSteps = 0; // steps taken on the brick map bound instead of SdfMap
+	int64_t m_numConeSteps = 0; // steps of the cone depth pre-pass, not in m_numSteps
+	int64_t m_numTemporalStarts = 0; // rays started at their reprojected previous-frame distance
+	int64_t m_numTemporalFallbacks = 0; // rays whose reprojected start failed validation
+	int64_t m_numRelaxationFallbacks = 0; // over-relaxed rays that stepped back to plain steps at least once
+
+	void Add(SdfCpuRayCounters const& other);
+};
+
+
+struct SdfCpuFrameStats
+{
+	int m_numRays = 0;
+	double m_milliseconds = 0.0;
+	SdfCpuRayCounters m_counters;
+
+	double GetRaysPerSecond() const;
+};
+
+
+// Runs tileFunc for every SDF_TILE_SIZE x SDF_TILE_SIZE tile of the frame (on the pool when given) and times it
+SdfCpuFrameStats RunSdfCpuTiles(IntVec2 const& dimensions, JobPool* jobPool, std::function<void(IntVec2 const& tileCoords, SdfCpuRayCounters& counters)> const& tileFunc);
+// Same over the listed tiles only (x | y << 16, see SdfTileClassification.hpp), the rays counted are theirs
+SdfCpuFrameStats RunSdfCpuTileList(IntVec2 const& dimensions, std::vector<uint32_t> const& tileList, JobPool* jobPool,
+	std::function<void(IntVec2 const& tileCoords, SdfCpuRayCounters& counters)> const& tileFunc);
+
+
+// Subset of the shape streams, ascending so smin runs in stream order. Replaces the BVH / full loop when given.
+struct SdfShapeList
+{
+	uint32_t const* m_indices = nullptr;
+	int m_count = 0;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+float SdSphere(Vec3 const& p, Vec3 const& c, float r);
+float SminCubic(float a, float b, float k);
+float SdfValueFromGeometry(Vec3 const& p, Vec4 const& geometry); // geometry: center.xyz + radius
+
+// Forward-mode dual number: a distance and its gradient, carried together through the smooth union
+struct SdfDistanceGradient
+{
+	float m_distance = SDF_INFINITY_DIST;
+	Vec3 m_gradient;
+};
+SdfDistanceGradient SdSphereGradient(Vec3 const& p, Vec3 const& c, float r); // zero gradient at the center
+SdfDistanceGradient SminCubicGradient(SdfDistanceGradient const& a, SdfDistanceGradient const& b, float k); // same distance as SminCubic
+SdfDistanceGradient SdfGradientFromGeometry(Vec3 const& p, Vec4 const& geometry);
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfCpuRayMarcher
+{
+public:
+	// Builds a BVH when constants.useBvh is set, unless the caller's one is given (to match the GPU shape order)
+	void SetScene(std::vector<SdfShape> const& shapes, SdfRayMarchingConstants const& constants, SdfBvh const* prebuiltBvh = nullptr);
+	void SetMaterials(std::vector<SdfMaterial> const& materials) { m_materials = materials; } // out of range IDs use a default material
+	void SetLightConstants(LightConstants const& lightConstants) { m_lightConstants = lightConstants; }
+	void SetTextureTable(SdfCpuTextureTable const* textureTable) { m_textureTable = textureTable; }
+	void SetDebugInt(int debugInt) { m_debugInt = debugInt; }
+	void SetBrickMap(SdfBrickMap const* brickMap) { m_brickMap = brickMap; } // used when constants.useBrickMap is set, baked from this scene
+	void SetTemporalHistory(SdfTemporalHistory const* history) { m_temporalHistory = history; } // used when constants.useTemporalReprojection is set, null on the first frame
+	void SetTopKMaterials(int topK); // K of constants.useTopKMaterials, 1 to SDF_TOPK_MAX_MATERIALS; the shader has it compiled in
+	void SetCsgProgram(SdfCsgProgram const* program) { m_csgProgram = program; } // used when constants.useCsgProgram is set, see SdfCsg.hpp
+
+	SdfShapeStreams const& GetShapeStreams() const { return m_streams; }
+	SdfBvh const& GetBvh() const { return m_bvh; }
+	bool IsHalfPrecisionGeometry() const { return m_constants.halfPrecisionGeometry != 0; }
+	bool UseCsgProgram() const { return m_constants.useCsgProgram != 0 && m_csgProgram; }
+	SdfRayMarchingConstants const& GetConstants() const { return m_constants; }
+
+	// shapeList: the tile's binned shapes (see SdfTileBinning), null for the whole scene; a CSG program ignores it
+	float SdfMap(Vec3 const& p, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	float SdfMapBvh(Vec3 const& p, SdfCpuRayCounters* counters = nullptr) const;
+	float SdfMapList(Vec3 const& p, SdfShapeList const& shapeList, SdfCpuRayCounters* counters = nullptr) const;
+	Vec3 SdfNormalTetra(Vec3 const& p, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	// SdfMap and its gradient in the same pass, visiting the same shapes in the same order
+	SdfDistanceGradient SdfMapGradient(Vec3 const& p, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	// SdfMapGradient when constants.useAnalyticNormals is set and the gradient is usable, SdfNormalTetra otherwise (always for a CSG program)
+	Vec3 SdfNormal(Vec3 const& p, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	// Blends every shape within 3k, or only the K heaviest when constants.useTopKMaterials is set
+	SdfSurfaceData GetWeightedSurfaceData(Vec3 const& p, Vec3 const& worldNormal, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	// The shapes GetWeightedSurfaceData would sample at p, in its order; -1 when there are more than out_shapes holds
+	int GetSurfaceShapes(Vec3 const& p, uint32_t out_shapes[], int maxShapes, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	// GetWeightedSurfaceData from a G-buffer texel: the weights again from p, the full gather for an overflow texel
+	SdfSurfaceData GetGBufferSurfaceData(SdfGBufferTexel const& texel, Vec3 const& p, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+	void AccumulateSurfaceData(SdfSurfaceDataSum& sum, int shapeIndex, Vec3 const& p, Vec3 const& worldNormal, float weight, SdfCpuRayCounters* counters) const; // samples the shape's material
+	static SdfSurfaceData ResolveSurfaceData(SdfSurfaceDataSum const& sum);
+	Vec3 ShadeSurface(SdfSurfaceData const& surf, Vec3 const& worldPos, Vec3 const& cameraWorldPos) const; // lighting, tone mapping and debug views
+	Vec3 ShadeHit(Vec3 const& hitPos, Vec3 const& cameraWorldPos, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const; // normal + material + ShadeSurface
+	static Vec3 GetMissingColor() { return Vec3(0.2f, 0.2f, 0.2f); }
+
+	// startDistance: where the march begins, every point before it is known to be empty
+	// shadeHit: false for the deferred march, a hit returns a black color and leaves the shading to the caller
+	Vec4 RayMarch(Vec3 const& rayStartPos, Vec3 const& rayFwdNormal, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr, float startDistance = 0.f,
+		bool shadeHit = true) const; // xyz: color w: distance
+	// Distance along the axis that no ray inside the cone can hit a surface before
+	float ConeMarch(Vec3 const& rayStartPos, Vec3 const& coneAxis, float tanHalfAngle, SdfCpuRayCounters* counters = nullptr) const;
+	// Low-res pre-pass: one ConeMarch per SDF_CONE_PREPASS_FACTOR block, row major
+	SdfCpuFrameStats RenderConeDepth(SdfCpuView const& view, IntVec2 const& dimensions, std::vector<float>& out_startDistances, JobPool* jobPool) const;
+	static IntVec2 GetConeDepthDimensions(IntVec2 const& dimensions);
+	// hintDistance when it is past safeStartDistance and its point is not on or inside a surface, safeStartDistance otherwise
+	float ValidateTemporalStart(Vec3 const& rayStartPos, Vec3 const& rayFwdNormal, float safeStartDistance, float hintDistance, SdfCpuRayCounters* counters = nullptr, SdfShapeList const* shapeList = nullptr) const;
+
+	// Splits the frame into SDF_TILE_SIZE tiles and marches them on the pool (or inline when pool is null).
+	// Bins the shapes per tile first when constants.useTileBinning is set,
+	// runs the cone depth pre-pass first when constants.useConeDepthPrepass is set,
+	// and reprojects the temporal history first when constants.useTemporalReprojection is set.
+	// With constants.useTileClassification only the tiles some shape can reach are marched, the others are filled
+	// with what a missed ray writes (see SdfTileClassification.hpp); the image is the same.
+	// With constants.useDeferredShading the tiles only march into a G-buffer, and the hits are shaded after,
+	// sorted by material set (see SdfDeferredShading.hpp); the image is the same. A constants.shadingRate over 1
+	// then shades one pixel per block of a smooth surface and copies it to the others.
+	// The debug int picks the surface views of ShadeSurface or the cost heatmaps of SdfCostCounters.hpp.
+	// out_deferredStats: the march and shading passes apart, filled when constants.useDeferredShading is set
+	SdfCpuFrameStats RenderFrame(SdfCpuView const& view, IntVec2 const& dimensions, SdfCpuImage& out_image, JobPool* jobPool, SdfDeferredShadingStats* out_deferredStats = nullptr) const;
+	// Incremental re-render (see SdfDirtyTiles.hpp): marches only the listed tiles into inout_image, which holds the
+	// previous frame, and fills the listed ones from numMarchTiles on like background tiles. Always the fused march, with
+	// the tile binning and the cone depth pre-pass when set, without temporal reprojection; the tiles come out as
+	// RenderFrame writes them with those settings.
+	SdfCpuFrameStats RenderTiles(SdfCpuView const& view, std::vector<uint32_t> const& tileList, int numMarchTiles, SdfCpuImage& inout_image, JobPool* jobPool) const;
+
+private:
+	float SdfMapAll(Vec3 const& p, SdfCpuRayCounters* counters) const;
+	// Calls emitShape(shapeIndex, weight) for every shape GetWeightedSurfaceData samples, in its order
+	template <typename EMIT_FUNC>
+	void VisitSurfaceShapes(Vec3 const& p, SdfCpuRayCounters* counters, SdfShapeList const* shapeList, EMIT_FUNC const& emitShape) const;
+	// out_gbuffer: null for the fused path, which shades in the march
+	void RenderTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, SdfCpuRayCounters& counters, SdfShapeList const* shapeList, std::vector<float> const* coneStartDistances,
+		SdfTemporalReprojection const* temporalReprojection, std::vector<SdfGBufferTexel>* out_gbuffer) const;
+	// BackgroundFillPass: the miss color, infinite distance and no cost for every pixel of the tile
+	void FillBackgroundTile(SdfCpuView const& view, IntVec2 const& tileCoords, SdfCpuImage& out_image, std::vector<SdfGBufferTexel>* out_gbuffer) const;
+
+private:
+	SdfShapeStreams m_streams; // in BVH leaf order when useBvh is set
+	SdfBvh m_bvh;
+	std::vector<SdfMaterial> m_materials;
+	SdfRayMarchingConstants m_constants;
+	LightConstants m_lightConstants;
+	SdfCpuTextureTable const* m_textureTable = nullptr;
+	int m_debugInt = 0;
+	SdfBrickMap const* m_brickMap = nullptr;
+	SdfTemporalHistory const* m_temporalHistory = nullptr;
+	int m_topKMaterials = SDF_TOPK_MATERIALS;
+	SdfCsgProgram const* m_csgProgram = nullptr;
+};
@@ -0,0 +1,631 @@
+#include "Game/SdfCsg.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Game/SdfMeshBaker.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+// Bounds are padded so that float rounding in a primitive never puts it below its own bound: the skips must be
+// exact, not just close
+static constexpr float BOUND_PADDING = 1e-3f;
+
+static float GetDistanceToBounds(Vec3 const& p, Vec3 const& boundsMin, Vec3 const& boundsMax)
+{
+	float dx = std::max(std::max(boundsMin.x - p.x, p.x - boundsMax.x), 0.f);
+	float dy = std::max(std::max(boundsMin.y - p.y, p.y - boundsMax.y), 0.f);
+	float dz = std::max(std::max(boundsMin.z - p.z, p.z - boundsMax.z), 0.f);
+	return sqrtf(dx * dx + dy * dy + dz * dz);
+}
+
+// Local axes as the rows of the rotation, same as sdOrientedBox in SdfRayMarching.hlsl
+static float SdOrientedBox(Vec3 const& p, Vec3 const& center, Vec3 const& iAxis, Vec3 const& jAxis, Vec3 const& kAxis, Vec3 const& halfExtents)
+{
+	Vec3 d = p - center;
+	float qx = fabsf(DotProduct3D(d, iAxis)) - halfExtents.x;
+	float qy = fabsf(DotProduct3D(d, jAxis)) - halfExtents.y;
+	float qz = fabsf(DotProduct3D(d, kAxis)) - halfExtents.z;
+	float outside = Vec3(std::max(qx, 0.f), std::max(qy, 0.f), std::max(qz, 0.f)).GetLength();
+	return outside + std::min(std::max(qx, std::max(qy, qz)), 0.f);
+}
+
+// Same as sdBakedGrid in SdfRayMarching.hlsl and SdfBakedGrid::Sample, with samples in voxel units along the local axes
+static float SdBakedGrid(Vec3 const& p, SdfCsgInstruction const& instruction, std::vector<float> const& gridSamples)
+{
+	float voxelSize = instruction.m_data0.w;
+	Vec3 iAxis(instruction.m_data1.x, instruction.m_data1.y, instruction.m_data1.z);
+	Vec3 jAxis(instruction.m_data2.x, instruction.m_data2.y, instruction.m_data2.z);
+	Vec3 d = p - Vec3(instruction.m_data0.x, instruction.m_data0.y, instruction.m_data0.z);
+	Vec3 coords = Vec3(DotProduct3D(d, iAxis), DotProduct3D(d, jAxis), DotProduct3D(d, CrossProduct3D(iAxis, jAxis))) / voxelSize;
+	int numX = (int)instruction.m_data1.w;
+	int numY = (int)instruction.m_data2.w;
+	int numZ = (int)instruction.m_param;
+	Vec3 clamped(GetClamped(coords.x, 0.f, (float)(numX - 1)), GetClamped(coords.y, 0.f, (float)(numY - 1)), GetClamped(coords.z, 0.f, (float)(numZ - 1)));
+	float outside = (coords - clamped).GetLength();
+	int x = std::min((int)clamped.x, numX - 2);
+	int y = std::min((int)clamped.y, numY - 2);
+	int z = std::min((int)clamped.z, numZ - 2);
+	float fx = clamped.x - (float)x;
+	float fy = clamped.y - (float)y;
+	float fz = clamped.z - (float)z;
+
+	float const* samples = &gridSamples[instruction.m_skip + ((size_t)z * numY + y) * numX + x];
+	size_t rowStride = (size_t)numX;
+	size_t sliceStride = (size_t)numX * numY;
+	float s00 = samples[0] + (samples[1] - samples[0]) * fx;
+	float s10 = samples[rowStride] + (samples[rowStride + 1] - samples[rowStride]) * fx;
+	float s01 = samples[sliceStride] + (samples[sliceStride + 1] - samples[sliceStride]) * fx;
+	float s11 = samples[sliceStride + rowStride] + (samples[sliceStride + rowStride + 1] - samples[sliceStride + rowStride]) * fx;
+	float s0 = s00 + (s10 - s00) * fy;
+	float s1 = s01 + (s11 - s01) * fy;
+	return (s0 + (s1 - s0) * fz + outside) * voxelSize;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vec3 SdfCsgTransform::TransformPosition(Vec3 const& localPos) const
+{
+	return m_translation + TransformDirection(localPos) * m_scale;
+}
+
+Vec3 SdfCsgTransform::TransformDirection(Vec3 const& localDir) const
+{
+	return m_iBasis * localDir.x + m_jBasis * localDir.y + m_kBasis * localDir.z;
+}
+
+Vec3 SdfCsgTransform::InverseTransformPosition(Vec3 const& parentPos) const
+{
+	Vec3 d = (parentPos - m_translation) / m_scale;
+	return Vec3(DotProduct3D(d, m_iBasis), DotProduct3D(d, m_jBasis), DotProduct3D(d, m_kBasis));
+}
+
+SdfCsgTransform SdfCsgTransform::Compose(SdfCsgTransform const& child) const
+{
+	SdfCsgTransform result;
+	result.m_translation = TransformPosition(child.m_translation);
+	result.m_iBasis = TransformDirection(child.m_iBasis);
+	result.m_jBasis = TransformDirection(child.m_jBasis);
+	result.m_kBasis = TransformDirection(child.m_kBasis);
+	result.m_scale = m_scale * child.m_scale;
+	return result;
+}
+
+SdfCsgTransform SdfCsgTransform::MakeFromAxisAngle(Vec3 const& axis, float degrees, Vec3 const& translation, float scale /*= 1.f*/)
+{
+	// Rodrigues: v cos + (a x v) sin + a (a . v)(1 - cos)
+	Vec3 a = axis.GetNormalized();
+	float c = CosDegrees(degrees);
+	float s = SinDegrees(degrees);
+	auto rotate = [&](Vec3 const& v) { return v * c + CrossProduct3D(a, v) * s + a * (DotProduct3D(a, v) * (1.f - c)); };
+
+	SdfCsgTransform result;
+	result.m_translation = translation;
+	result.m_iBasis = rotate(Vec3(1.f, 0.f, 0.f));
+	result.m_jBasis = rotate(Vec3(0.f, 1.f, 0.f));
+	result.m_kBasis = rotate(Vec3(0.f, 0.f, 1.f));
+	result.m_scale = scale;
+	return result;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+int SdfCsgTree::AddNode(SdfCsgNode const& node)
+{
+	m_nodes.push_back(node);
+	return (int)m_nodes.size() - 1;
+}
+
+int SdfCsgTree::AddSphere(Vec3 const& center, float radius)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::SPHERE;
+	node.m_center = center;
+	node.m_halfExtents = Vec3(radius, radius, radius);
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddBox(Vec3 const& center, Vec3 const& halfExtents)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::BOX;
+	node.m_center = center;
+	node.m_halfExtents = halfExtents;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddBakedGrid(SdfBakedGrid const* grid, Vec3 const& position, float scale /*= 1.f*/)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::BAKED_GRID;
+	node.m_center = position;
+	node.m_halfExtents = Vec3(scale, scale, scale);
+	node.m_grid = grid;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddUnion(int childA, int childB)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::UNION;
+	node.m_childA = childA;
+	node.m_childB = childB;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddSmoothUnion(int childA, int childB, float smoothK)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::SMOOTH_UNION;
+	node.m_childA = childA;
+	node.m_childB = childB;
+	node.m_smoothK = smoothK;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddSubtraction(int childA, int childB)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::SUBTRACTION;
+	node.m_childA = childA;
+	node.m_childB = childB;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddIntersection(int childA, int childB)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::INTERSECTION;
+	node.m_childA = childA;
+	node.m_childB = childB;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddTransform(int child, SdfCsgTransform const& transform)
+{
+	SdfCsgNode node;
+	node.m_type = SdfCsgNodeType::TRANSFORM;
+	node.m_childA = child;
+	node.m_transform = transform;
+	return AddNode(node);
+}
+
+int SdfCsgTree::AddShapes(std::vector<SdfShape> const& shapes, float smoothK, std::vector<SdfBakedGrid> const* grids /*= nullptr*/)
+{
+	// Pairwise rounds keep the depth, and the stack the program needs, at log2 of the count
+	std::vector<int> level;
+	level.reserve(shapes.size());
+	for (SdfShape const& shape : shapes)
+	{
+		Vec3 position(shape.m_data0.x, shape.m_data0.y, shape.m_data0.z);
+		if (shape.m_type != SdfShape::SDF_BAKED_GRID)
+		{
+			level.push_back(AddSphere(position, shape.m_data0.w));
+		}
+		else if (grids && shape.m_gridIndex < grids->size() && !(*grids)[shape.m_gridIndex].IsEmpty())
+		{
+			level.push_back(AddBakedGrid(&(*grids)[shape.m_gridIndex], position, shape.m_data0.w));
+		}
+	}
+	while (level.size() > 1)
+	{
+		std::vector<int> nextLevel;
+		nextLevel.reserve((level.size() + 1) / 2);
+		for (size_t i = 0; i + 1 < level.size(); i += 2)
+		{
+			nextLevel.push_back(AddSmoothUnion(level[i], level[i + 1], smoothK));
+		}
+		if (level.size() % 2 == 1)
+		{
+			nextLevel.push_back(level.back());
+		}
+		level.swap(nextLevel);
+	}
+	return level.empty() ? SDF_CSG_NO_NODE : level[0];
+}
+
+float SdfCsgTree::Evaluate(int rootNode, Vec3 const& p) const
+{
+	SdfCsgNode const& node = m_nodes[rootNode];
+	switch (node.m_type)
+	{
+	case SdfCsgNodeType::SPHERE:
+		return SdSphere(p, node.m_center, node.m_halfExtents.x);
+	case SdfCsgNodeType::BOX:
+		return SdOrientedBox(p, node.m_center, Vec3(1.f, 0.f, 0.f), Vec3(0.f, 1.f, 0.f), Vec3(0.f, 0.f, 1.f), node.m_halfExtents);
+	case SdfCsgNodeType::UNION:
+		return std::min(Evaluate(node.m_childA, p), Evaluate(node.m_childB, p));
+	case SdfCsgNodeType::SMOOTH_UNION:
+	{
+		float a = Evaluate(node.m_childA, p);
+		float b = Evaluate(node.m_childB, p);
+		return (node.m_smoothK > 0.f) ? SminCubic(a, b, node.m_smoothK) : std::min(a, b);
+	}
+	case SdfCsgNodeType::SUBTRACTION:
+		return std::max(Evaluate(node.m_childA, p), -Evaluate(node.m_childB, p));
+	case SdfCsgNodeType::INTERSECTION:
+		return std::max(Evaluate(node.m_childA, p), Evaluate(node.m_childB, p));
+	case SdfCsgNodeType::TRANSFORM:
+		return Evaluate(node.m_childA, node.m_transform.InverseTransformPosition(p)) * node.m_transform.m_scale;
+	case SdfCsgNodeType::BAKED_GRID:
+		return node.m_grid->Sample((p - node.m_center) / node.m_halfExtents.x) * node.m_halfExtents.x;
+	}
+	return SDF_INFINITY_DIST;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+// The tree flattened to world space: transforms baked in, folded nodes gone, shared nodes expanded per use.
+// Bounds hold the solid, its field is at least distance(p, bounds) - m_lowering.
+struct SdfCsgFlatNode
+{
+	uint32_t m_op = SDF_CSG_OP_SPHERE;
+	int m_first = SDF_CSG_NO_NODE; // operators, in emission order
+	int m_second = SDF_CSG_NO_NODE;
+	SdfCsgInstruction m_instruction; // primitives; m_param of operators
+	Vec3 m_boundsMin;
+	Vec3 m_boundsMax;
+	float m_lowering = 0.f;
+	bool m_isEmpty = false; // no point inside: a disjoint intersection, or anything made only of one
+	bool m_hasSkip = false; // a SKIP_IF_FAR guards m_second
+	int m_numInstructions = 1;
+	int m_stackDepth = 1;
+};
+
+class SdfCsgCompiler
+{
+public:
+	SdfCsgCompiler(SdfCsgTree const& tree, SdfCsgCompileOptions const& options) : m_tree(tree), m_options(options) {}
+
+	int Flatten(int treeNode, SdfCsgTransform const& transform, bool isSignOnly);
+	void Emit(int flatNode, std::vector<SdfCsgInstruction>& out_instructions) const;
+	SdfCsgFlatNode const& GetNode(int flatNode) const { return m_nodes[flatNode]; }
+	int GetNumVisitedNodes() const { return m_numVisitedNodes; }
+	std::vector<SdfBakedGrid const*> const& GetGrids() const { return m_grids; }
+
+private:
+	int AddPrimitive(SdfCsgInstruction const& instruction, Vec3 const& boundsMin, Vec3 const& boundsMax);
+	int AddOperator(uint32_t op, int childA, int childB, float smoothK);
+	bool AreDisjoint(int flatA, int flatB) const;
+
+private:
+	SdfCsgTree const& m_tree;
+	SdfCsgCompileOptions m_options;
+	std::vector<SdfCsgFlatNode> m_nodes;
+	std::vector<SdfBakedGrid const*> m_grids; // GRID instructions hold an index in here until their samples are placed
+	int m_numVisitedNodes = 0;
+};
+
+int SdfCsgCompiler::AddPrimitive(SdfCsgInstruction const& instruction, Vec3 const& boundsMin, Vec3 const& boundsMax)
+{
+	SdfCsgFlatNode node;
+	node.m_op = instruction.m_op;
+	node.m_instruction = instruction;
+	node.m_boundsMin = boundsMin - Vec3(BOUND_PADDING, BOUND_PADDING, BOUND_PADDING);
+	node.m_boundsMax = boundsMax + Vec3(BOUND_PADDING, BOUND_PADDING, BOUND_PADDING);
+	m_nodes.push_back(node);
+	return (int)m_nodes.size() - 1;
+}
+
+bool SdfCsgCompiler::AreDisjoint(int flatA, int flatB) const
+{
+	SdfCsgFlatNode const& a = m_nodes[flatA];
+	SdfCsgFlatNode const& b = m_nodes[flatB];
+	float gap = a.m_lowering + b.m_lowering; // the solids reach that far out of their bounds
+	return a.m_boundsMin.x > b.m_boundsMax.x + gap || b.m_boundsMin.x > a.m_boundsMax.x + gap ||
+		a.m_boundsMin.y > b.m_boundsMax.y + gap || b.m_boundsMin.y > a.m_boundsMax.y + gap ||
+		a.m_boundsMin.z > b.m_boundsMax.z + gap || b.m_boundsMin.z > a.m_boundsMax.z + gap;
+}
+
+int SdfCsgCompiler::AddOperator(uint32_t op, int childA, int childB, float smoothK)
+{
+	SdfCsgFlatNode const& a = m_nodes[childA];
+	SdfCsgFlatNode const& b = m_nodes[childB];
+
+	SdfCsgFlatNode node;
+	node.m_op = op;
+	node.m_first = childA;
+	node.m_second = childB;
+	node.m_instruction.m_op = op;
+	node.m_instruction.m_param = smoothK;
+	if (op == SDF_CSG_OP_SUBTRACTION)
+	{
+		// max(a, -b) >= a
+		node.m_boundsMin = a.m_boundsMin;
+		node.m_boundsMax = a.m_boundsMax;
+		node.m_lowering = a.m_lowering;
+		node.m_isEmpty = a.m_isEmpty;
+	}
+	else if (op == SDF_CSG_OP_INTERSECTION)
+	{
+		// max(a, b) is above both bounds, keep the tighter one
+		Vec3 extentsA = a.m_boundsMax - a.m_boundsMin;
+		Vec3 extentsB = b.m_boundsMax - b.m_boundsMin;
+		SdfCsgFlatNode const& tighter = (extentsA.x * extentsA.y * extentsA.z <= extentsB.x * extentsB.y * extentsB.z) ? a : b;
+		node.m_boundsMin = tighter.m_boundsMin;
+		node.m_boundsMax = tighter.m_boundsMax;
+		node.m_lowering = tighter.m_lowering;
+		node.m_isEmpty = a.m_isEmpty || b.m_isEmpty || AreDisjoint(childA, childB);
+	}
+	else
+	{
+		// sminCubic(a, b, k) >= min(a, b) - k
+		node.m_boundsMin = Vec3(std::min(a.m_boundsMin.x, b.m_boundsMin.x), std::min(a.m_boundsMin.y, b.m_boundsMin.y), std::min(a.m_boundsMin.z, b.m_boundsMin.z));
+		node.m_boundsMax = Vec3(std::max(a.m_boundsMax.x, b.m_boundsMax.x), std::max(a.m_boundsMax.y, b.m_boundsMax.y), std::max(a.m_boundsMax.z, b.m_boundsMax.z));
+		node.m_lowering = std::max(a.m_lowering, b.m_lowering) + ((op == SDF_CSG_OP_SMOOTH_UNION) ? smoothK : 0.f);
+		node.m_isEmpty = a.m_isEmpty && b.m_isEmpty && (op == SDF_CSG_OP_UNION);
+	}
+
+	// Sethi-Ullman: the operand needing the deeper stack goes first, it is the only one evaluated on an empty stack.
+	// On a tie the larger one goes second, where a skip can drop it.
+	bool isCommutative = (op != SDF_CSG_OP_SUBTRACTION);
+	bool isSwapped = isCommutative && (b.m_stackDepth > a.m_stackDepth || (b.m_stackDepth == a.m_stackDepth && a.m_numInstructions > b.m_numInstructions));
+	if (isSwapped)
+	{
+		std::swap(node.m_first, node.m_second);
+	}
+	SdfCsgFlatNode const& first = m_nodes[node.m_first];
+	SdfCsgFlatNode const& second = m_nodes[node.m_second];
+	node.m_stackDepth = std::max(first.m_stackDepth, second.m_stackDepth + 1);
+	node.m_hasSkip = m_options.m_useBoundPruning && (op != SDF_CSG_OP_INTERSECTION) && second.m_numInstructions >= m_options.m_minPrunedInstructions;
+	node.m_numInstructions = first.m_numInstructions + second.m_numInstructions + 1 + (node.m_hasSkip ? 1 : 0);
+
+	m_nodes.push_back(node);
+	return (int)m_nodes.size() - 1;
+}
+
+// isSignOnly: no smooth union above, only the sign of this node's field can reach the root
+int SdfCsgCompiler::Flatten(int treeNode, SdfCsgTransform const& transform, bool isSignOnly)
+{
+	++m_numVisitedNodes;
+	SdfCsgNode const& node = m_tree.GetNode(treeNode);
+	switch (node.m_type)
+	{
+	case SdfCsgNodeType::SPHERE:
+	{
+		float radius = node.m_halfExtents.x * transform.m_scale;
+		Vec3 center = transform.TransformPosition(node.m_center);
+		SdfCsgInstruction instruction;
+		instruction.m_op = SDF_CSG_OP_SPHERE;
+		instruction.m_data0 = Vec4(center.x, center.y, center.z, radius);
+		return AddPrimitive(instruction, center - Vec3(radius, radius, radius), center + Vec3(radius, radius, radius));
+	}
+	case SdfCsgNodeType::BOX:
+	{
+		Vec3 center = transform.TransformPosition(node.m_center);
+		Vec3 halfExtents = node.m_halfExtents * transform.m_scale;
+		Vec3 iAxis = transform.m_iBasis;
+		Vec3 jAxis = transform.m_jBasis;
+		Vec3 kAxis = transform.m_kBasis;
+		SdfCsgInstruction instruction;
+		instruction.m_op = SDF_CSG_OP_BOX;
+		instruction.m_data0 = Vec4(center.x, center.y, center.z, halfExtents.z);
+		instruction.m_data1 = Vec4(iAxis.x, iAxis.y, iAxis.z, halfExtents.x);
+		instruction.m_data2 = Vec4(jAxis.x, jAxis.y, jAxis.z, halfExtents.y);
+
+		// World AABB of the oriented box
+		Vec3 reach(fabsf(iAxis.x) * halfExtents.x + fabsf(jAxis.x) * halfExtents.y + fabsf(kAxis.x) * halfExtents.z,
+			fabsf(iAxis.y) * halfExtents.x + fabsf(jAxis.y) * halfExtents.y + fabsf(kAxis.y) * halfExtents.z,
+			fabsf(iAxis.z) * halfExtents.x + fabsf(jAxis.z) * halfExtents.y + fabsf(kAxis.z) * halfExtents.z);
+		return AddPrimitive(instruction, center - reach, center + reach);
+	}
+	case SdfCsgNodeType::BAKED_GRID:
+	{
+		SdfBakedGrid const& grid = *node.m_grid;
+		float scale = node.m_halfExtents.x * transform.m_scale;
+		Vec3 origin = transform.TransformPosition(node.m_center + grid.m_origin * node.m_halfExtents.x);
+		Vec3 iAxis = transform.m_iBasis;
+		Vec3 jAxis = transform.m_jBasis;
+		Vec3 kAxis = transform.m_kBasis;
+		size_t gridIndex = std::find(m_grids.begin(), m_grids.end(), node.m_grid) - m_grids.begin();
+		if (gridIndex == m_grids.size())
+		{
+			m_grids.push_back(node.m_grid);
+		}
+		SdfCsgInstruction instruction;
+		instruction.m_op = SDF_CSG_OP_GRID;
+		instruction.m_skip = (uint32_t)gridIndex;
+		instruction.m_param = (float)grid.m_numSamplesZ;
+		instruction.m_data0 = Vec4(origin.x, origin.y, origin.z, grid.m_voxelSize * scale);
+		instruction.m_data1 = Vec4(iAxis.x, iAxis.y, iAxis.z, (float)grid.m_numSamplesX);
+		instruction.m_data2 = Vec4(jAxis.x, jAxis.y, jAxis.z, (float)grid.m_numSamplesY);
+
+		// World AABB of the oriented grid box, from its first sample
+		Vec3 extents = (grid.GetBoundsMax() - grid.m_origin) * scale;
+		Vec3 boundsMin = origin;
+		Vec3 boundsMax = origin;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			Vec3 edge = ((axis == 0) ? iAxis * extents.x : ((axis == 1) ? jAxis * extents.y : kAxis * extents.z));
+			boundsMin += Vec3(std::min(edge.x, 0.f), std::min(edge.y, 0.f), std::min(edge.z, 0.f));
+			boundsMax += Vec3(std::max(edge.x, 0.f), std::max(edge.y, 0.f), std::max(edge.z, 0.f));
+		}
+		return AddPrimitive(instruction, boundsMin, boundsMax);
+	}
+	case SdfCsgNodeType::TRANSFORM:
+		return Flatten(node.m_childA, transform.Compose(node.m_transform), isSignOnly);
+	default:
+		break;
+	}
+
+	// A smooth union blends values, folding below it would move the surface
+	bool isChildSignOnly = isSignOnly && (node.m_type != SdfCsgNodeType::SMOOTH_UNION);
+	int childA = Flatten(node.m_childA, transform, isChildSignOnly);
+	int childB = Flatten(node.m_childB, transform, isChildSignOnly);
+	const bool foldConstants = m_options.m_foldConstants && isSignOnly;
+	switch (node.m_type)
+	{
+	case SdfCsgNodeType::UNION:
+		// min(x, empty) has the sign of x
+		if (foldConstants && m_nodes[childA].m_isEmpty != m_nodes[childB].m_isEmpty)
+		{
+			return m_nodes[childA].m_isEmpty ? childB : childA;
+		}
+		return AddOperator(SDF_CSG_OP_UNION, childA, childB, 0.f);
+	case SdfCsgNodeType::SMOOTH_UNION:
+		// sminCubic divides by k, with no blend it is a plain union whether folding or not
+		if (node.m_smoothK * transform.m_scale <= 0.f)
+		{
+			return AddOperator(SDF_CSG_OP_UNION, childA, childB, 0.f);
+		}
+		return AddOperator(SDF_CSG_OP_SMOOTH_UNION, childA, childB, node.m_smoothK * transform.m_scale);
+	case SdfCsgNodeType::SUBTRACTION:
+		// Nothing to cut away: max(a, -b) and a have the same sign everywhere
+		if (foldConstants && !m_nodes[childA].m_isEmpty && (m_nodes[childB].m_isEmpty || AreDisjoint(childA, childB)))
+		{
+			return childA;
+		}
+		return AddOperator(SDF_CSG_OP_SUBTRACTION, childA, childB, 0.f);
+	case SdfCsgNodeType::INTERSECTION:
+		return AddOperator(SDF_CSG_OP_INTERSECTION, childA, childB, 0.f);
+	default:
+		break;
+	}
+	return childA;
+}
+
+void SdfCsgCompiler::Emit(int flatNode, std::vector<SdfCsgInstruction>& out_instructions) const
+{
+	SdfCsgFlatNode const& node = m_nodes[flatNode];
+	if (node.m_first == SDF_CSG_NO_NODE)
+	{
+		out_instructions.push_back(node.m_instruction);
+		return;
+	}
+
+	Emit(node.m_first, out_instructions);
+	if (node.m_hasSkip)
+	{
+		SdfCsgFlatNode const& second = m_nodes[node.m_second];
+		SdfCsgInstruction skip;
+		skip.m_op = SDF_CSG_OP_SKIP_IF_FAR;
+		skip.m_skip = (uint32_t)second.m_numInstructions + 1;
+		skip.m_param = (node.m_op == SDF_CSG_OP_SMOOTH_UNION) ? node.m_instruction.m_param * 6.f : 0.f; // past the blend width
+		skip.m_data0 = Vec4(second.m_boundsMin.x, second.m_boundsMin.y, second.m_boundsMin.z, second.m_lowering);
+		skip.m_data1 = Vec4(second.m_boundsMax.x, second.m_boundsMax.y, second.m_boundsMax.z, (node.m_op == SDF_CSG_OP_SUBTRACTION) ? -1.f : 1.f);
+		out_instructions.push_back(skip);
+	}
+	Emit(node.m_second, out_instructions);
+	out_instructions.push_back(node.m_instruction);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool CompileSdfCsg(SdfCsgTree const& tree, int rootNode, SdfCsgCompileOptions const& options, SdfCsgProgram& out_program)
+{
+	out_program = SdfCsgProgram();
+	if (rootNode < 0 || rootNode >= tree.GetNumNodes())
+	{
+		return false;
+	}
+
+	SdfCsgCompiler compiler(tree, options);
+	int root = compiler.Flatten(rootNode, SdfCsgTransform(), true);
+	if (compiler.GetNode(root).m_stackDepth > SDF_CSG_STACK_SIZE)
+	{
+		return false;
+	}
+
+	out_program.m_instructions.reserve(compiler.GetNode(root).m_numInstructions);
+	compiler.Emit(root, out_program.m_instructions);
+
+	// Grid samples in order of first use, rescaled to voxels so the instruction's voxel size scales them back
+	std::vector<uint32_t> sampleOffsets;
+	for (SdfBakedGrid const* grid : compiler.GetGrids())
+	{
+		sampleOffsets.push_back((uint32_t)out_program.m_gridSamples.size());
+		for (float sample : grid->m_samples)
+		{
+			out_program.m_gridSamples.push_back(sample / grid->m_voxelSize);
+		}
+	}
+	for (SdfCsgInstruction& instruction : out_program.m_instructions)
+	{
+		if (instruction.m_op == SDF_CSG_OP_GRID)
+		{
+			instruction.m_skip = sampleOffsets[instruction.m_skip];
+		}
+	}
+	out_program.m_maxStackDepth = compiler.GetNode(root).m_stackDepth;
+	out_program.m_numTreeNodes = compiler.GetNumVisitedNodes();
+	for (SdfCsgInstruction const& instruction : out_program.m_instructions)
+	{
+		if (instruction.m_op == SDF_CSG_OP_SKIP_IF_FAR)
+		{
+			++out_program.m_numSkipInstructions;
+		}
+	}
+	out_program.m_numFoldedNodes = out_program.m_numTreeNodes - (out_program.GetNumInstructions() - out_program.m_numSkipInstructions);
+	return true;
+}
+
+float EvaluateSdfCsgProgram(std::vector<SdfCsgInstruction> const& instructions, Vec3 const& p, SdfCsgCounters* counters /*= nullptr*/,
+	std::vector<float> const* gridSamples /*= nullptr*/)
+{
+	float stack[SDF_CSG_STACK_SIZE];
+	int top = -1;
+	const int numInstructions = (int)instructions.size();
+	int numExecuted = 0;
+	int numSkips = 0;
+	for (int i = 0; i < numInstructions; ++i)
+	{
+		SdfCsgInstruction const& instruction = instructions[i];
+		++numExecuted;
+		switch (instruction.m_op)
+		{
+		case SDF_CSG_OP_SPHERE:
+			stack[++top] = SdSphere(p, Vec3(instruction.m_data0.x, instruction.m_data0.y, instruction.m_data0.z), instruction.m_data0.w);
+			break;
+		case SDF_CSG_OP_BOX:
+		{
+			Vec3 iAxis(instruction.m_data1.x, instruction.m_data1.y, instruction.m_data1.z);
+			Vec3 jAxis(instruction.m_data2.x, instruction.m_data2.y, instruction.m_data2.z);
+			stack[++top] = SdOrientedBox(p, Vec3(instruction.m_data0.x, instruction.m_data0.y, instruction.m_data0.z), iAxis, jAxis, CrossProduct3D(iAxis, jAxis),
+				Vec3(instruction.m_data1.w, instruction.m_data2.w, instruction.m_data0.w));
+			break;
+		}
+		case SDF_CSG_OP_GRID:
+			stack[++top] = gridSamples ? SdBakedGrid(p, instruction, *gridSamples) : SDF_INFINITY_DIST;
+			break;
+		case SDF_CSG_OP_UNION:
+			--top;
+			stack[top] = std::min(stack[top], stack[top + 1]);
+			break;
+		case SDF_CSG_OP_SMOOTH_UNION:
+			--top;
+			stack[top] = SminCubic(stack[top], stack[top + 1], instruction.m_param);
+			break;
+		case SDF_CSG_OP_SUBTRACTION:
+			--top;
+			stack[top] = std::max(stack[top], -stack[top + 1]);
+			break;
+		case SDF_CSG_OP_INTERSECTION:
+			--top;
+			stack[top] = std::max(stack[top], stack[top + 1]);
+			break;
+		case SDF_CSG_OP_SKIP_IF_FAR:
+		{
+			Vec3 boundsMin(instruction.m_data0.x, instruction.m_data0.y, instruction.m_data0.z);
+			Vec3 boundsMax(instruction.m_data1.x, instruction.m_data1.y, instruction.m_data1.z);
+			// Inside the bound the operand can be as negative as the solid is deep, there is no bound to skip on
+			float distance = GetDistanceToBounds(p, boundsMin, boundsMax);
+			if (distance > 0.f && distance - instruction.m_data0.w >= instruction.m_data1.w * stack[top] + instruction.m_param)
+			{
+				i += (int)instruction.m_skip;
+				++numSkips;
+			}
+			break;
+		}
+		default:
+			break;
+		}
+	}
+
+	if (counters)
+	{
+		counters->m_numInstructions += numExecuted;
+		counters->m_numSkips += numSkips;
+	}
+	return (top >= 0) ? stack[0] : SDF_INFINITY_DIST;
+}
@@ -0,0 +1,170 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+struct SdfBakedGrid;
+
+/*
+CSG scene graph compiled to a flat, stack-based SDF program, run by SdfMapCsg in SdfRayMarching.hlsl and by
+EvaluateSdfCsgProgram on the CPU.
+
+SdfCsgTree is the authoring side: spheres, boxes and baked meshes (SdfBakedGrid, SdfMeshBaker.hpp) combined with
+union, smooth union, subtraction and intersection, under rigid transforms with a uniform scale. CompileSdfCsg turns
+it into post-order instructions:
+	- transforms are composed and baked into the primitives, so the program has no transform instruction
+	- smooth unions with no blend width become plain unions
+	- a subtrahend whose bound misses the solid it cuts is dropped, and so is an intersection whose children's
+	  bounds are disjoint when it sits under a union or a subtraction (it has no surface)
+	- children of min / max operators are ordered to keep the stack shallow (Sethi-Ullman)
+Folding changes values but never the sign, and the folded field still bounds the distance to the surface, so it
+is only done where nothing but the sign reaches the root: not below a smooth union, which blends values.
+Bounding-volume pruning happens at run time but is decided at compile time: before the second operand B of
+a union, smooth union or subtraction the compiler emits a SKIP_IF_FAR with B's bound, and when p is outside it and
+	distance(p, bound) - lowering >= top + 6k         (union, and smooth union of width k)
+	distance(p, bound) - lowering >= -top             (subtraction)
+B cannot change the value on top of the stack, so B and its operator are skipped. lowering is how far the smooth
+unions inside B can pull it below its primitives. The result is exactly that of the unpruned program.
+A baked grid's samples go to SdfCsgProgram::m_gridSamples in voxel units, once per grid however often it is used,
+and its instruction points at them. Past the grid box it measures to the box and adds the nearest boundary sample,
+which is positive, so the box bounds it like a primitive.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_CSG_STACK_SIZE = 32; // SDF_CSG_STACK_SIZE in SdfRayMarching.hlsl, CompileSdfCsg fails above it
+constexpr int SDF_CSG_NO_NODE = -1;
+
+// Instruction opcodes, same as SDF_CSG_OP_* in SdfRayMarching.hlsl
+constexpr uint32_t SDF_CSG_OP_SPHERE = 0; // push; data0: center.xyz + radius
+constexpr uint32_t SDF_CSG_OP_BOX = 1; // push; data0: center.xyz + half z, data1: x axis + half x, data2: y axis + half y
+constexpr uint32_t SDF_CSG_OP_UNION = 2; // pop b, a; push min(a, b)
+constexpr uint32_t SDF_CSG_OP_SMOOTH_UNION = 3; // pop b, a; push sminCubic(a, b, param)
+constexpr uint32_t SDF_CSG_OP_SUBTRACTION = 4; // pop b, a; push max(a, -b)
+constexpr uint32_t SDF_CSG_OP_INTERSECTION = 5; // pop b, a; push max(a, b)
+constexpr uint32_t SDF_CSG_OP_SKIP_IF_FAR = 6; // data0: bound min + lowering, data1: bound max + sign of top, param: 6k or 0; skips m_skip
+constexpr uint32_t SDF_CSG_OP_GRID = 7; // push; data0: first sample.xyz + voxel size, data1: x axis + samples x, data2: y axis + samples y, param: samples z, skip: sample offset
+
+
+// Notes: must be same as the struct in hlsl, 64 bytes
+struct SdfCsgInstruction
+{
+	uint32_t m_op = SDF_CSG_OP_SPHERE;
+	uint32_t m_skip = 0; // SKIP_IF_FAR: instructions after this one to jump over, GRID: first of its samples
+	float m_param = 0.f;
+	float m_padding = 0.f;
+	Vec4 m_data0;
+	Vec4 m_data1;
+	Vec4 m_data2;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Local to parent: parent = m_translation + m_scale * (x * m_iBasis + y * m_jBasis + z * m_kBasis)
+struct SdfCsgTransform
+{
+	Vec3 m_translation;
+	Vec3 m_iBasis = Vec3(1.f, 0.f, 0.f);
+	Vec3 m_jBasis = Vec3(0.f, 1.f, 0.f);
+	Vec3 m_kBasis = Vec3(0.f, 0.f, 1.f);
+	float m_scale = 1.f; // uniform, so distances scale with it
+
+	Vec3 TransformPosition(Vec3 const& localPos) const;
+	Vec3 TransformDirection(Vec3 const& localDir) const; // rotation only
+	Vec3 InverseTransformPosition(Vec3 const& parentPos) const;
+	SdfCsgTransform Compose(SdfCsgTransform const& child) const; // this * child
+
+	static SdfCsgTransform MakeFromAxisAngle(Vec3 const& axis, float degrees, Vec3 const& translation, float scale = 1.f);
+};
+
+
+enum class SdfCsgNodeType : uint8_t
+{
+	SPHERE,
+	BOX,
+	UNION,
+	SMOOTH_UNION,
+	SUBTRACTION, // a minus b
+	INTERSECTION,
+	TRANSFORM,
+	BAKED_GRID,
+};
+
+struct SdfCsgNode
+{
+	SdfCsgNodeType m_type = SdfCsgNodeType::SPHERE;
+	int m_childA = SDF_CSG_NO_NODE; // also the child of a transform
+	int m_childB = SDF_CSG_NO_NODE;
+	Vec3 m_center; // primitives; where a baked grid puts the mesh origin
+	Vec3 m_halfExtents; // box; x is the radius of a sphere, or the scale of a baked grid
+	SdfBakedGrid const* m_grid = nullptr; // baked grid, not owned
+	float m_smoothK = 0.f; // smooth union blend width, same meaning as toleranceK
+	SdfCsgTransform m_transform;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Nodes are only ever added, an index stays valid until Clear. A node may be shared by several parents.
+class SdfCsgTree
+{
+public:
+	int AddSphere(Vec3 const& center, float radius);
+	int AddBox(Vec3 const& center, Vec3 const& halfExtents);
+	int AddBakedGrid(SdfBakedGrid const* grid, Vec3 const& position, float scale = 1.f); // grid is not copied, it must outlive the tree
+	int AddUnion(int childA, int childB);
+	int AddSmoothUnion(int childA, int childB, float smoothK);
+	int AddSubtraction(int childA, int childB); // childA minus childB
+	int AddIntersection(int childA, int childB);
+	int AddTransform(int child, SdfCsgTransform const& transform);
+	// Balanced smooth union of the shapes, SDF_CSG_NO_NODE when empty. Baked grid shapes index grids, and are left out without them.
+	int AddShapes(std::vector<SdfShape> const& shapes, float smoothK, std::vector<SdfBakedGrid> const* grids = nullptr);
+	void Clear() { m_nodes.clear(); }
+
+	int GetNumNodes() const { return (int)m_nodes.size(); }
+	SdfCsgNode const& GetNode(int nodeIndex) const { return m_nodes[nodeIndex]; }
+
+	// Recursive reference evaluation, transforms applied to p on the way down
+	float Evaluate(int rootNode, Vec3 const& p) const;
+
+private:
+	int AddNode(SdfCsgNode const& node);
+
+private:
+	std::vector<SdfCsgNode> m_nodes;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfCsgCompileOptions
+{
+	bool m_foldConstants = true;
+	bool m_useBoundPruning = true;
+	int m_minPrunedInstructions = 3; // smaller subtrees cost about as much as their bound check
+};
+
+struct SdfCsgProgram
+{
+	std::vector<SdfCsgInstruction> m_instructions;
+	std::vector<float> m_gridSamples; // every baked grid in the program, in voxel units
+	int m_maxStackDepth = 0;
+	int m_numTreeNodes = 0; // reachable from the root, transforms included
+	int m_numFoldedNodes = 0; // tree nodes with no instruction of their own
+	int m_numSkipInstructions = 0;
+
+	int GetNumInstructions() const { return (int)m_instructions.size(); }
+};
+
+struct SdfCsgCounters
+{
+	int64_t m_numInstructions = 0; // executed, SKIP_IF_FAR included
+	int64_t m_numSkips = 0; // SKIP_IF_FAR taken
+};
+
+// False when the program would need more than SDF_CSG_STACK_SIZE entries (out_program is then empty)
+bool CompileSdfCsg(SdfCsgTree const& tree, int rootNode, SdfCsgCompileOptions const& options, SdfCsgProgram& out_program);
+
+// Same as SdfMapCsg in SdfRayMarching.hlsl. gridSamples: SdfCsgProgram::m_gridSamples, only read by GRID instructions
+float EvaluateSdfCsgProgram(std::vector<SdfCsgInstruction> const& instructions, Vec3 const& p, SdfCsgCounters* counters = nullptr,
+	std::vector<float> const* gridSamples = nullptr);
@@ -0,0 +1,91 @@
+#include "Game/SdfDeferredShading.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+uint32_t GetSdfShadeBin(SdfGBufferTexel const& texel, SdfShapeStreams const& streams)
+{
+	if (texel.IsOverflow())
+	{
+		return 0;
+	}
+
+	// A sum of per-material hashes, +1 so a material blended with itself is a set of its own
+	uint32_t hash = 0;
+	for (uint32_t shapeIndex : texel.m_shapes)
+	{
+		if (shapeIndex != SDF_GBUFFER_NO_SHAPE)
+		{
+			hash += (uint32_t)streams.m_shapeMaterials[shapeIndex].m_materialID * 2654435761u + 1u;
+		}
+	}
+	return 1u + hash % (uint32_t)(SDF_SHADE_BINS - 1);
+}
+
+int GetSdfShadingSource(std::vector<SdfGBufferTexel> const& gbuffer, IntVec2 const& dimensions, int pixelIndex, SdfRayMarchingConstants const& constants)
+{
+	int rate = constants.shadingRate;
+	if (rate <= 1)
+	{
+		return pixelIndex;
+	}
+	int x = pixelIndex % dimensions.x;
+	int y = pixelIndex / dimensions.x;
+	int anchorIndex = (y / rate) * rate * dimensions.x + (x / rate) * rate;
+	if (anchorIndex == pixelIndex)
+	{
+		return pixelIndex;
+	}
+
+	SdfGBufferTexel const& anchor = gbuffer[anchorIndex];
+	SdfGBufferTexel const& texel = gbuffer[pixelIndex];
+	if (!anchor.IsHit() || !texel.IsHit())
+	{
+		return pixelIndex;
+	}
+	bool isSameSurface = (fabsf(texel.m_distance - anchor.m_distance) <= constants.shadingDepthTolerance * anchor.m_distance) &&
+		(DotProduct3D(texel.m_normal, anchor.m_normal) >= constants.shadingNormalThreshold);
+	return isSameSurface ? anchorIndex : pixelIndex;
+}
+
+void SortSdfShadePixels(std::vector<SdfGBufferTexel> const& gbuffer, SdfShapeStreams const& streams, std::vector<int>& out_pixels,
+	int out_binCounts[SDF_SHADE_BINS], std::vector<int> const* shadingSources /*= nullptr*/)
+{
+	auto isShaded = [&](size_t pixelIndex)
+	{
+		return gbuffer[pixelIndex].IsHit() && (!shadingSources || (*shadingSources)[pixelIndex] == (int)pixelIndex);
+	};
+
+	std::vector<uint32_t> pixelBins(gbuffer.size(), 0);
+	for (int bin = 0; bin < SDF_SHADE_BINS; ++bin)
+	{
+		out_binCounts[bin] = 0;
+	}
+	for (size_t pixelIndex = 0; pixelIndex < gbuffer.size(); ++pixelIndex)
+	{
+		if (isShaded(pixelIndex))
+		{
+			pixelBins[pixelIndex] = GetSdfShadeBin(gbuffer[pixelIndex], streams);
+			++out_binCounts[pixelBins[pixelIndex]];
+		}
+	}
+
+	int binCursors[SDF_SHADE_BINS];
+	int numHits = 0;
+	for (int bin = 0; bin < SDF_SHADE_BINS; ++bin)
+	{
+		binCursors[bin] = numHits;
+		numHits += out_binCounts[bin];
+	}
+
+	out_pixels.resize(numHits);
+	for (size_t pixelIndex = 0; pixelIndex < gbuffer.size(); ++pixelIndex)
+	{
+		if (isShaded(pixelIndex))
+		{
+			out_pixels[binCursors[pixelBins[pixelIndex]]++] = (int)pixelIndex;
+		}
+	}
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+Deferred path of the march (useDeferredShading). The march pass stops at the hit and writes a G-buffer texel: the hit
+distance, the normal and the shapes GetWeightedSurfaceData would blend there, in blend order. Their weights are not
+stored, the shading pass gets them back exactly from the distance to each shape. Hit pixels are then counted per
+shade bin, a hash of the material set, and scattered into a list grouped by bin, which the shading pass walks in
+order, so each wave samples the same few material textures. Shading no longer depends on how far the ray went.
+A texel with more shapes than it holds is marked SDF_GBUFFER_OVERFLOW and gathered again when shaded.
+With a shadingRate of 2 or 4 only the first pixel of each block of shadingRate^2 is shaded, along with the pixels
+that are not on its surface: a relative depth step over shadingDepthTolerance or a normal turned past
+shadingNormalThreshold is an edge. The other pixels copy the first one's color, so the materials and lights are
+evaluated up to 16 times less on smooth surfaces while silhouettes and creases stay per pixel.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_GBUFFER_MAX_SHAPES = 4; // SDF_GBUFFER_MAX_SHAPES in SdfRayMarching.hlsl
+constexpr uint32_t SDF_GBUFFER_NO_SHAPE = 0xFFFFFFFF; // past the last shape of a texel
+constexpr uint32_t SDF_GBUFFER_OVERFLOW = 0xFFFFFFFE; // in the first shape slot
+constexpr int SDF_SHADE_BINS = 64; // SDF_SHADE_BINS in SdfRayMarching.hlsl, bin 0 holds the overflow texels
+constexpr int SDF_SHADING_RATE_MAX = 4; // shadingRate: 1, 2 or 4, a block never straddles two thread group tiles
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfGBufferTexel
+{
+	Vec3 m_normal;
+	float m_distance = SDF_INFINITY_DIST; // along the ray, SDF_INFINITY_DIST for a miss
+	uint32_t m_shapes[SDF_GBUFFER_MAX_SHAPES] = { SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE };
+
+	bool IsHit() const { return m_distance < SDF_INFINITY_DIST; }
+	bool IsOverflow() const { return m_shapes[0] == SDF_GBUFFER_OVERFLOW; }
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfDeferredShadingStats
+{
+	SdfCpuFrameStats m_marchStats; // pre-passes and the march into the G-buffer
+	SdfCpuFrameStats m_shadeStats; // sort and shading, m_numRays is the hit pixels shaded
+	int m_numShadeBinsUsed = 0;
+	int m_numOverflowPixels = 0;
+	int m_numReusedPixels = 0; // hits that copied their block's shading instead of running it
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Same as GetShadeBin in SdfRayMarching.hlsl: the order of the shapes does not matter, only their materials
+uint32_t GetSdfShadeBin(SdfGBufferTexel const& texel, SdfShapeStreams const& streams);
+
+// Same as GetShadingSource in SdfRayMarching.hlsl: the pixel whose shading this one uses, itself unless shadingRate
+// is over 1 and both it and the first pixel of its block are hits on the same smooth surface
+int GetSdfShadingSource(std::vector<SdfGBufferTexel> const& gbuffer, IntVec2 const& dimensions, int pixelIndex, SdfRayMarchingConstants const& constants);
+
+// Counting sort of the hit pixels by bin, same as the count / prefix / scatter passes of SdfRayMarching.hlsl.
+// out_pixels: pixel indices grouped by bin, row major inside a bin (the GPU order inside a bin is arbitrary)
+// shadingSources: GetSdfShadingSource per pixel, the pixels reusing another one's shading are left out; null for all hits
+void SortSdfShadePixels(std::vector<SdfGBufferTexel> const& gbuffer, SdfShapeStreams const& streams, std::vector<int>& out_pixels,
+	int out_binCounts[SDF_SHADE_BINS], std::vector<int> const* shadingSources = nullptr);
@@ -0,0 +1,187 @@
+#include "Game/SdfDirtyTiles.hpp"
+#include "Game/SdfTileBinning.hpp"
+#include "Game/SdfTileClassification.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+static bool AreSdfShapesEqual(SdfShape const& a, SdfShape const& b)
+{
+	// Field by field, the struct has padding
+	return a.m_type == b.m_type && a.m_materialID == b.m_materialID && a.m_gridIndex == b.m_gridIndex &&
+		a.m_color.r == b.m_color.r && a.m_color.g == b.m_color.g && a.m_color.b == b.m_color.b && a.m_color.a == b.m_color.a &&
+		memcmp(&a.m_data0, &b.m_data0, sizeof(Vec4)) == 0;
+}
+
+// Same decode as SdfShapeStreams::GetGeometry
+static Vec4 GetSdfShapeGeometry(SdfShape const& shape, bool isHalfPrecision)
+{
+	Vec4 const& data0 = shape.m_data0;
+	if (isHalfPrecision)
+	{
+		return Vec4(HalfToFloat(FloatToHalf(data0.x)), HalfToFloat(FloatToHalf(data0.y)), HalfToFloat(FloatToHalf(data0.z)), HalfToFloat(FloatToHalf(data0.w)));
+	}
+	return data0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfDirtyTiles::Update(SdfCpuView const& view, IntVec2 const& dimensions, std::vector<SdfShape> const& shapes, std::vector<uint32_t> const* streamOrder,
+	SdfRayMarchingConstants const& constants, LightConstants const& lightConstants, int debugInt, SdfTileClassification const* classification /*= nullptr*/)
+{
+	SdfRayMarchingConstants settings = GetImageSettings(constants);
+	bool isSameOrder = streamOrder ? (*streamOrder == m_streamOrder) : m_streamOrder.empty();
+	bool isSameImage = m_hasFrame && isSameOrder && (dimensions == m_dimensions) && (debugInt == m_debugInt) &&
+		(memcmp(&view, &m_view, sizeof(SdfCpuView)) == 0) &&
+		(memcmp(&settings, &m_settings, sizeof(SdfRayMarchingConstants)) == 0) &&
+		(memcmp(&lightConstants, &m_lightConstants, sizeof(LightConstants)) == 0);
+
+	m_numTiles = IntVec2((dimensions.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE, (dimensions.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE);
+	m_isTileDirty.assign(m_numTiles.x * m_numTiles.y, 0);
+	m_tileList.clear();
+	m_numMarchTiles = 0;
+	m_numMovedShapes = 0;
+
+	// Old bounds from the old geometry, new ones from the new: the view is the same either way
+	bool isHalf = (constants.halfPrecisionGeometry != 0);
+	int numShapes = (int)shapes.size();
+	int numOldShapes = (int)m_shapes.size();
+	if (isSameImage)
+	{
+		for (int shapeIndex = 0; shapeIndex < std::max(numShapes, numOldShapes); ++shapeIndex)
+		{
+			bool isNew = (shapeIndex < numShapes);
+			bool isOld = (shapeIndex < numOldShapes);
+			if (isNew && isOld && AreSdfShapesEqual(shapes[shapeIndex], m_shapes[shapeIndex]))
+			{
+				continue;
+			}
+			++m_numMovedShapes;
+			if (isOld)
+			{
+				MarkShape(view, dimensions, m_geometry[shapeIndex], constants);
+			}
+			if (isNew)
+			{
+				MarkShape(view, dimensions, GetSdfShapeGeometry(shapes[shapeIndex], isHalf), constants);
+			}
+		}
+	}
+
+	m_hasFrame = true;
+	m_view = view;
+	m_dimensions = dimensions;
+	m_settings = settings;
+	m_lightConstants = lightConstants;
+	m_debugInt = debugInt;
+	m_shapes = shapes;
+	if (streamOrder)
+	{
+		m_streamOrder = *streamOrder;
+	}
+	else
+	{
+		m_streamOrder.clear();
+	}
+	m_geometry.resize(numShapes);
+	for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+	{
+		m_geometry[shapeIndex] = GetSdfShapeGeometry(shapes[shapeIndex], isHalf);
+	}
+
+	// The deferred passes sort and shade every hit of the G-buffer
+	bool isPartialAllowed = !constants.useDeferredShading;
+	if (!isSameImage || (!isPartialAllowed && std::find(m_isTileDirty.begin(), m_isTileDirty.end(), (uint8_t)1) != m_isTileDirty.end()))
+	{
+		m_isTileDirty.assign(m_isTileDirty.size(), 0);
+		m_state = SdfDirtyState::FULL;
+		m_numMarchedPixels = dimensions.x * dimensions.y;
+		m_numDirtyPixels = m_numMarchedPixels;
+		return;
+	}
+
+	// Row order, the march tiles first
+	m_numMarchedPixels = 0;
+	m_numDirtyPixels = 0;
+	int numTiles = m_numTiles.x * m_numTiles.y;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		bool isMarchPass = (pass == 0);
+		for (int tileIndex = 0; tileIndex < numTiles; ++tileIndex)
+		{
+			IntVec2 tileCoords(tileIndex % m_numTiles.x, tileIndex / m_numTiles.x);
+			bool isMarched = (classification == nullptr) || classification->IsTileOccupied(tileCoords);
+			if (!m_isTileDirty[tileIndex] || isMarched != isMarchPass)
+			{
+				continue;
+			}
+			m_tileList.push_back(SdfTileClassification::PackTileCoords(tileCoords));
+			int numTilePixels = GetNumTilePixels(tileCoords);
+			m_numDirtyPixels += numTilePixels;
+			if (isMarchPass)
+			{
+				++m_numMarchTiles;
+				m_numMarchedPixels += numTilePixels;
+			}
+		}
+	}
+	m_state = m_tileList.empty() ? SdfDirtyState::CLEAN : SdfDirtyState::PARTIAL;
+}
+
+SdfRayMarchingConstants SdfDirtyTiles::GetImageSettings(SdfRayMarchingConstants const& constants)
+{
+	SdfRayMarchingConstants settings = constants;
+	settings.numOfShapes = 0;
+	settings.screenWidth = 0;
+	settings.screenHeight = 0;
+	settings.numOfBvhNodes = 0;
+	settings.numOfTilesX = 0;
+	settings.brickGridSize = 0;
+	settings.brickOdometer = 0.f;
+	settings.brickBlendLowering = 0.f;
+	settings.brickMapOrigin = Vec3();
+	settings.shapeBoundsMin = Vec3();
+	settings.shapeBoundsMax = Vec3();
+	settings.hasTemporalHistory = 0;
+	settings.temporalMaxShapeMove = 0.f;
+	settings.cameraForward = Vec3();
+	settings.tanHalfFovX = 0.f;
+	settings.cameraLeft = Vec3();
+	settings.tanHalfFovY = 0.f;
+	settings.cameraUp = Vec3();
+	settings.prevCameraPosition = Vec3();
+	settings.prevCameraNear = 0.f;
+	settings.prevCameraForward = Vec3();
+	settings.prevCameraFar = 0.f;
+	settings.prevCameraLeft = Vec3();
+	settings.prevTanHalfFovX = 0.f;
+	settings.prevCameraUp = Vec3();
+	settings.prevTanHalfFovY = 0.f;
+	settings.numCsgInstructions = 0;
+	settings.numOccupiedTiles = 0;
+	settings.numBackgroundTiles = 0;
+	return settings;
+}
+
+void SdfDirtyTiles::MarkShape(SdfCpuView const& view, IntVec2 const& dimensions, Vec4 const& geometry, SdfRayMarchingConstants const& constants)
+{
+	IntVec2 pixelMin;
+	IntVec2 pixelMax;
+	if (!SdfTileBinning::GetSpherePixelRect(view, dimensions, Vec3(geometry.x, geometry.y, geometry.z), SdfTileClassification::GetHitRadius(geometry.w, constants), pixelMin, pixelMax))
+	{
+		return;
+	}
+	for (int tileY = pixelMin.y / SDF_TILE_SIZE; tileY <= pixelMax.y / SDF_TILE_SIZE; ++tileY)
+	{
+		uint8_t* rowTiles = &m_isTileDirty[tileY * m_numTiles.x];
+		std::fill(rowTiles + pixelMin.x / SDF_TILE_SIZE, rowTiles + pixelMax.x / SDF_TILE_SIZE + 1, (uint8_t)1);
+	}
+}
+
+int SdfDirtyTiles::GetNumTilePixels(IntVec2 const& tileCoords) const
+{
+	int width = std::min(SDF_TILE_SIZE, m_dimensions.x - tileCoords.x * SDF_TILE_SIZE);
+	int height = std::min(SDF_TILE_SIZE, m_dimensions.y - tileCoords.y * SDF_TILE_SIZE);
+	return width * height;
+}
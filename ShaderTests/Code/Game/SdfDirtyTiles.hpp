@@ -0,0 +1,94 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/IntVec2.hpp"
+#include "Engine/Math/Vec4.hpp"
+#include "Engine/Renderer/RendererCommon.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class SdfTileClassification;
+
+/*
+Change detection for the ray-marched image, so a frame only re-marches what changed since the one before (incremental
+re-render). A frame is what the march reads: the view, the render dimensions, the settings of the constants, the lights,
+the debug view, every shape and the order the streams blend them in. Against the last frame it is
+	CLEAN    nothing changed: the output texture still holds the image and the dispatch is skipped
+	PARTIAL  only shapes changed: the tiles their old and new projected bounds touch are marched into the texture again
+	FULL     anything else changed, or Invalidate was called (a recreated texture, a pass that is not described here)
+A new stream order is FULL too, whatever moved: sminCubic is not associative, so a BVH rebuild changes the field wherever
+shapes blend. A refit keeps the order, and SdfMapBvh blends in it, so only a rebuild counts. PARTIAL also needs the march
+to be the last pass writing a pixel: with deferred shading, whose passes cover the whole screen, a frame with dirty
+tiles is FULL.
+The bounds are SdfTileClassification's, the sphere inflated by 6k + minHitDistance + margin: a ray that never comes that
+close to a shape hits the same surface with or without it, and blends none of its material. Away from them a moved
+shape can still change how a ray steps towards what it hits, so such a pixel may differ from a full render by the
+march tolerance, never by what it shows.
+Shapes are matched by scene index, a shape added or removed is dirty where it is. The constants' fields that follow from
+the shapes, the view or the tile lists (counts, brick map bounds, temporal history, camera basis) are not settings.
+The tile list is laid out like SdfTileClassification's: with a classification given, the dirty occupied tiles first
+and the dirty background tiles after them, for the fill; without one every dirty tile is marched.
+*/
+
+//-----------------------------------------------------------------------------------------------
+enum class SdfDirtyState : uint8_t
+{
+	CLEAN,
+	PARTIAL,
+	FULL,
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfDirtyTiles
+{
+public:
+	// shapes: scene order. streamOrder: the scene index of each stream slot (SdfBvh::GetShapeOrder), null for scene order.
+	// classification: the frame's own, null when the march covers every tile.
+	void Update(SdfCpuView const& view, IntVec2 const& dimensions, std::vector<SdfShape> const& shapes, std::vector<uint32_t> const* streamOrder,
+		SdfRayMarchingConstants const& constants, LightConstants const& lightConstants, int debugInt, SdfTileClassification const* classification = nullptr);
+	void Invalidate() { m_hasFrame = false; } // the next Update is FULL
+
+	SdfDirtyState GetState() const { return m_state; }
+	IntVec2 GetNumTiles() const { return m_numTiles; }
+	int GetNumDirtyTiles() const { return (int)m_tileList.size(); } // PARTIAL only, FULL marks no tile
+	bool IsTileDirty(IntVec2 const& tileCoords) const { return m_isTileDirty[tileCoords.y * m_numTiles.x + tileCoords.x] != 0; }
+	int GetNumMovedShapes() const { return m_numMovedShapes; } // changed, added or removed since the last frame
+
+	// x | y << 16 per dirty tile, the ones to march first
+	std::vector<uint32_t> const& GetTileList() const { return m_tileList; }
+	int GetNumMarchTiles() const { return m_numMarchTiles; }
+	int GetNumFillTiles() const { return (int)m_tileList.size() - m_numMarchTiles; }
+
+	// Pixels this frame marches: every one when FULL, the march tiles' when PARTIAL, none when CLEAN
+	int GetNumMarchedPixels() const { return m_numMarchedPixels; }
+	int GetNumDirtyPixels() const { return m_numDirtyPixels; } // the fill tiles' included
+
+	// constants without the fields that follow from the shapes, the view or the tile lists
+	static SdfRayMarchingConstants GetImageSettings(SdfRayMarchingConstants const& constants);
+
+private:
+	void MarkShape(SdfCpuView const& view, IntVec2 const& dimensions, Vec4 const& geometry, SdfRayMarchingConstants const& constants);
+	int GetNumTilePixels(IntVec2 const& tileCoords) const;
+
+private:
+	bool m_hasFrame = false;
+	SdfCpuView m_view;
+	IntVec2 m_dimensions;
+	SdfRayMarchingConstants m_settings;
+	LightConstants m_lightConstants;
+	int m_debugInt = 0;
+	std::vector<SdfShape> m_shapes;
+	std::vector<uint32_t> m_streamOrder; // empty for scene order
+	std::vector<Vec4> m_geometry; // decoded as the shader reads it, what the old bounds come from
+
+	SdfDirtyState m_state = SdfDirtyState::FULL;
+	IntVec2 m_numTiles;
+	std::vector<uint8_t> m_isTileDirty;
+	std::vector<uint32_t> m_tileList;
+	int m_numMarchTiles = 0;
+	int m_numMovedShapes = 0;
+	int m_numMarchedPixels = 0;
+	int m_numDirtyPixels = 0;
+};
@@ -0,0 +1,78 @@
+#include "Game/SdfDynamicResolution.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfDynamicResolution::Reset()
+{
+	m_scale = SDF_DYNAMIC_RESOLUTION_MAX_SCALE;
+	m_bucket = SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS - 1;
+	m_smoothedMilliseconds = 0.f;
+	m_framesAtBucket = 0;
+	m_numBucketChanges = 0;
+}
+
+void SdfDynamicResolution::Update(float frameMilliseconds)
+{
+	if (frameMilliseconds <= 0.f)
+	{
+		return;
+	}
+
+	// The first frame after a bucket change starts the average over, the old size's timings no longer apply
+	bool isFreshBucket = (m_framesAtBucket == 0);
+	m_smoothedMilliseconds = (m_smoothedMilliseconds <= 0.f || isFreshBucket) ? frameMilliseconds
+		: m_smoothedMilliseconds + m_config.m_smoothing * (frameMilliseconds - m_smoothedMilliseconds);
+	++m_framesAtBucket;
+
+	float error = m_smoothedMilliseconds / m_config.m_budgetMilliseconds - 1.f;
+	if (fabsf(error) > m_config.m_deadBand)
+	{
+		float budgetScale = GetBucketScale() * sqrtf(m_config.m_budgetMilliseconds / m_smoothedMilliseconds);
+		m_scale += m_config.m_gain * (budgetScale - m_scale);
+		m_scale = std::clamp(m_scale, SDF_DYNAMIC_RESOLUTION_MIN_SCALE, SDF_DYNAMIC_RESOLUTION_MAX_SCALE);
+	}
+
+	int bucket = m_bucket;
+	if (m_scale < GetBucketScale(m_bucket))
+	{
+		bucket = GetBucketForScale(m_scale);
+	}
+	else if (m_bucket + 1 < SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS && m_framesAtBucket >= m_config.m_minFramesBetweenUps)
+	{
+		// One bucket at a time; the top one only needs the scale to reach it
+		float upScale = std::min(GetBucketScale(m_bucket + 1) + m_config.m_upHeadroom, SDF_DYNAMIC_RESOLUTION_MAX_SCALE);
+		if (m_scale >= upScale)
+		{
+			bucket = m_bucket + 1;
+		}
+	}
+
+	if (bucket != m_bucket)
+	{
+		m_bucket = bucket;
+		m_framesAtBucket = 0;
+		++m_numBucketChanges;
+	}
+}
+
+float SdfDynamicResolution::GetBucketScale(int bucket)
+{
+	float step = (SDF_DYNAMIC_RESOLUTION_MAX_SCALE - SDF_DYNAMIC_RESOLUTION_MIN_SCALE) / (float)(SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS - 1);
+	return SDF_DYNAMIC_RESOLUTION_MIN_SCALE + step * (float)bucket;
+}
+
+int SdfDynamicResolution::GetBucketForScale(float scale)
+{
+	float step = (SDF_DYNAMIC_RESOLUTION_MAX_SCALE - SDF_DYNAMIC_RESOLUTION_MIN_SCALE) / (float)(SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS - 1);
+	int bucket = (int)floorf((scale - SDF_DYNAMIC_RESOLUTION_MIN_SCALE) / step + 1e-4f);
+	return std::clamp(bucket, 0, SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS - 1);
+}
+
+IntVec2 SdfDynamicResolution::GetBucketDimensions(int bucket, IntVec2 const& fullDimensions)
+{
+	float scale = GetBucketScale(bucket);
+	return IntVec2(std::max((int)((float)fullDimensions.x * scale + 0.5f), 1), std::max((int)((float)fullDimensions.y * scale + 0.5f), 1));
+}
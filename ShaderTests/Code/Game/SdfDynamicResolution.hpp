@@ -0,0 +1,58 @@
+#pragma once
+#include "Engine/Math/IntVec2.hpp"
+
+/*
+Frame-time feedback for the ray-march resolution. The march costs about the same per pixel, so the frame time
+is modelled as proportional to scale^2: the scale that meets the budget is  scale * sqrt(budget / frameTime).
+The continuous scale moves part of the way there every frame, on smoothed timings and with a dead band around the
+budget, and the render size only follows it in SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS steps. Going down a bucket is
+immediate, going up needs the scale to clear the next bucket by m_upHeadroom and m_minFramesBetweenUps frames at
+the current one, so noise around a bucket edge does not make the size flicker.
+Only timings in, bucket out: benchmarks drive it with synthetic frame times.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr float SDF_DYNAMIC_RESOLUTION_MIN_SCALE = 0.5f;
+constexpr float SDF_DYNAMIC_RESOLUTION_MAX_SCALE = 1.f;
+constexpr int SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS = 5; // 0.5, 0.625, 0.75, 0.875, 1
+
+
+struct SdfDynamicResolutionConfig
+{
+	float m_budgetMilliseconds = 16.f;
+	float m_gain = 0.25f; // share of the way to the budget scale per frame
+	float m_smoothing = 0.2f; // exponential moving average weight of the newest frame time
+	float m_deadBand = 0.05f; // relative frame time error that is left alone, so a vsync-locked frame does not drift
+	float m_upHeadroom = 0.03f; // scale above the next bucket before going up, one bucket at a time
+	int m_minFramesBetweenUps = 30;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfDynamicResolution
+{
+public:
+	void SetConfig(SdfDynamicResolutionConfig const& config) { m_config = config; }
+	SdfDynamicResolutionConfig const& GetConfig() const { return m_config; }
+
+	void Reset(); // back to full resolution, forgets the timings
+	void Update(float frameMilliseconds); // frameMilliseconds: the last frame, rendered at the current bucket
+
+	float GetScale() const { return m_scale; } // continuous target of the controller
+	int GetBucket() const { return m_bucket; }
+	float GetBucketScale() const { return GetBucketScale(m_bucket); }
+	float GetSmoothedMilliseconds() const { return m_smoothedMilliseconds; }
+	int GetNumBucketChanges() const { return m_numBucketChanges; }
+
+	static float GetBucketScale(int bucket);
+	static int GetBucketForScale(float scale); // the largest bucket at or below scale
+	static IntVec2 GetBucketDimensions(int bucket, IntVec2 const& fullDimensions);
+
+private:
+	SdfDynamicResolutionConfig m_config;
+	float m_scale = SDF_DYNAMIC_RESOLUTION_MAX_SCALE;
+	int m_bucket = SDF_DYNAMIC_RESOLUTION_NUM_BUCKETS - 1;
+	float m_smoothedMilliseconds = 0.f; // 0 before the first frame
+	int m_framesAtBucket = 0;
+	int m_numBucketChanges = 0;
+};
@@ -0,0 +1,670 @@
+#include "Game/SdfMeshBaker.hpp"
+#include "Game/JobPool.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int MAX_TRIANGLE_BVH_DEPTH = 64;
+static constexpr float FOUR_PI = 12.566370614f;
+
+
+static void RunBakeJobs(int numItems, JobPool* jobPool, std::function<void(int itemIndex)> const& job)
+{
+	if (jobPool)
+	{
+		jobPool->ParallelFor(numItems, job);
+		return;
+	}
+	for (int itemIndex = 0; itemIndex < numItems; ++itemIndex)
+	{
+		job(itemIndex);
+	}
+}
+
+static double GetMillisecondsSince(std::chrono::steady_clock::time_point startTime)
+{
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+static float GetComponent(Vec3 const& v, int axis)
+{
+	return (axis == 0) ? v.x : ((axis == 1) ? v.y : v.z);
+}
+
+static float GetDistanceSquaredToBox(Vec3 const& p, Vec3 const& boxMins, Vec3 const& boxMaxs)
+{
+	float dx = fmaxf(fmaxf(boxMins.x - p.x, p.x - boxMaxs.x), 0.f);
+	float dy = fmaxf(fmaxf(boxMins.y - p.y, p.y - boxMaxs.y), 0.f);
+	float dz = fmaxf(fmaxf(boxMins.z - p.z, p.z - boxMaxs.z), 0.f);
+	return dx * dx + dy * dy + dz * dz;
+}
+
+// Real-Time Collision Detection 5.1.5, by the Voronoi region of p
+static Vec3 GetClosestPointOnTriangle(Vec3 const& p, Vec3 const& a, Vec3 const& b, Vec3 const& c)
+{
+	Vec3 ab = b - a;
+	Vec3 ac = c - a;
+	Vec3 ap = p - a;
+	float d1 = DotProduct3D(ab, ap);
+	float d2 = DotProduct3D(ac, ap);
+	if (d1 <= 0.f && d2 <= 0.f)
+	{
+		return a;
+	}
+	Vec3 bp = p - b;
+	float d3 = DotProduct3D(ab, bp);
+	float d4 = DotProduct3D(ac, bp);
+	if (d3 >= 0.f && d4 <= d3)
+	{
+		return b;
+	}
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.f && d1 >= 0.f && d3 <= 0.f)
+	{
+		return a + ab * (d1 / (d1 - d3));
+	}
+	Vec3 cp = p - c;
+	float d5 = DotProduct3D(ab, cp);
+	float d6 = DotProduct3D(ac, cp);
+	if (d6 >= 0.f && d5 <= d6)
+	{
+		return c;
+	}
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.f && d2 >= 0.f && d6 <= 0.f)
+	{
+		return a + ac * (d2 / (d2 - d6));
+	}
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.f && (d4 - d3) >= 0.f && (d5 - d6) >= 0.f)
+	{
+		return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+	}
+	float area = va + vb + vc;
+	if (area <= 0.f)
+	{
+		return a; // degenerate, the edges above caught every other case
+	}
+	return a + ab * (vb / area) + ac * (vc / area);
+}
+
+// Sign of cross(p, q) for a point at the origin, as if it sat a hair off the line when exactly on it: moved by
+// epsilon * (1, delta), which decides by the edge direction. Both triangles of an edge see the same moved point, and
+// the product is always taken in the same corner order so a fused multiply-add rounds it the same for both.
+static float GetEdgeFunction(float pu, float pv, float qu, float qv)
+{
+	if (pu > qu || (pu == qu && pv > qv))
+	{
+		return -GetEdgeFunction(qu, qv, pu, pv);
+	}
+	float edgeFunction = pu * qv - pv * qu;
+	if (edgeFunction != 0.f)
+	{
+		return edgeFunction;
+	}
+	if (qv - pv != 0.f)
+	{
+		return -(qv - pv);
+	}
+	return qu - pu;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+Vec3 SdfBakedGrid::GetBoundsMax() const
+{
+	return m_origin + Vec3((float)(m_numSamplesX - 1), (float)(m_numSamplesY - 1), (float)(m_numSamplesZ - 1)) * m_voxelSize;
+}
+
+float SdfBakedGrid::Sample(Vec3 const& p) const
+{
+	Vec3 voxelCoords = (p - m_origin) / m_voxelSize;
+	Vec3 clamped(GetClamped(voxelCoords.x, 0.f, (float)(m_numSamplesX - 1)), GetClamped(voxelCoords.y, 0.f, (float)(m_numSamplesY - 1)),
+		GetClamped(voxelCoords.z, 0.f, (float)(m_numSamplesZ - 1)));
+	float outside = (voxelCoords - clamped).GetLength();
+	int x = std::min((int)clamped.x, m_numSamplesX - 2);
+	int y = std::min((int)clamped.y, m_numSamplesY - 2);
+	int z = std::min((int)clamped.z, m_numSamplesZ - 2);
+	float fx = clamped.x - (float)x;
+	float fy = clamped.y - (float)y;
+	float fz = clamped.z - (float)z;
+
+	float s00 = GetSample(x, y, z) + (GetSample(x + 1, y, z) - GetSample(x, y, z)) * fx;
+	float s10 = GetSample(x, y + 1, z) + (GetSample(x + 1, y + 1, z) - GetSample(x, y + 1, z)) * fx;
+	float s01 = GetSample(x, y, z + 1) + (GetSample(x + 1, y, z + 1) - GetSample(x, y, z + 1)) * fx;
+	float s11 = GetSample(x, y + 1, z + 1) + (GetSample(x + 1, y + 1, z + 1) - GetSample(x, y + 1, z + 1)) * fx;
+	float s0 = s00 + (s10 - s00) * fy;
+	float s1 = s01 + (s11 - s01) * fy;
+	return s0 + (s1 - s0) * fz + outside * m_voxelSize;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfTriangleBvh::Build(std::vector<Vec3> const& positions, std::vector<unsigned int> const& indices)
+{
+	int numTriangles = (int)(indices.size() / 3);
+	std::vector<Vec3> corners(numTriangles * 3);
+	std::vector<Vec3> centroids(numTriangles);
+	for (int triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			corners[triangle * 3 + corner] = positions[indices[triangle * 3 + corner]];
+		}
+		centroids[triangle] = (corners[triangle * 3] + corners[triangle * 3 + 1] + corners[triangle * 3 + 2]) * (1.f / 3.f);
+	}
+
+	m_nodes.clear();
+	m_triangleIds.resize(numTriangles);
+	for (int triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		m_triangleIds[triangle] = triangle;
+	}
+	if (numTriangles > 0)
+	{
+		m_nodes.reserve(2 * (numTriangles / SDF_TRIANGLE_BVH_LEAF_SIZE + 1));
+		BuildNode(0, numTriangles, corners, centroids);
+	}
+
+	m_vertices.resize(numTriangles * 3);
+	for (int triangle = 0; triangle < numTriangles; ++triangle)
+	{
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			m_vertices[triangle * 3 + corner] = corners[m_triangleIds[triangle] * 3 + corner];
+		}
+	}
+}
+
+int SdfTriangleBvh::BuildNode(int first, int count, std::vector<Vec3> const& corners, std::vector<Vec3> const& centroids)
+{
+	int nodeIndex = (int)m_nodes.size();
+	m_nodes.push_back(SdfTriangleBvhNode());
+
+	Vec3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX);
+	Vec3 boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	Vec3 centroidMin = boundsMin;
+	Vec3 centroidMax = boundsMax;
+	for (int i = first; i < first + count; ++i)
+	{
+		int triangleId = m_triangleIds[i];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			Vec3 const& position = corners[triangleId * 3 + corner];
+			boundsMin = Vec3(fminf(boundsMin.x, position.x), fminf(boundsMin.y, position.y), fminf(boundsMin.z, position.z));
+			boundsMax = Vec3(fmaxf(boundsMax.x, position.x), fmaxf(boundsMax.y, position.y), fmaxf(boundsMax.z, position.z));
+		}
+		Vec3 const& centroid = centroids[triangleId];
+		centroidMin = Vec3(fminf(centroidMin.x, centroid.x), fminf(centroidMin.y, centroid.y), fminf(centroidMin.z, centroid.z));
+		centroidMax = Vec3(fmaxf(centroidMax.x, centroid.x), fmaxf(centroidMax.y, centroid.y), fmaxf(centroidMax.z, centroid.z));
+	}
+	m_nodes[nodeIndex].m_boundsMin = boundsMin;
+	m_nodes[nodeIndex].m_boundsMax = boundsMax;
+	if (count <= SDF_TRIANGLE_BVH_LEAF_SIZE)
+	{
+		m_nodes[nodeIndex].m_first = first;
+		m_nodes[nodeIndex].m_numTriangles = count;
+		return nodeIndex;
+	}
+
+	// Median split of the centroids on their widest axis, the depth stays at log2 of the count
+	Vec3 centroidExtents = centroidMax - centroidMin;
+	int axis = (centroidExtents.x >= centroidExtents.y && centroidExtents.x >= centroidExtents.z) ? 0 : ((centroidExtents.y >= centroidExtents.z) ? 1 : 2);
+	int middle = first + count / 2;
+	std::nth_element(m_triangleIds.begin() + first, m_triangleIds.begin() + middle, m_triangleIds.begin() + first + count, [&](int a, int b)
+	{
+		return GetComponent(centroids[a], axis) < GetComponent(centroids[b], axis);
+	});
+	BuildNode(first, middle - first, corners, centroids);
+	int secondChild = BuildNode(middle, first + count - middle, corners, centroids);
+	m_nodes[nodeIndex].m_first = secondChild;
+	return nodeIndex;
+}
+
+float SdfTriangleBvh::FindClosestTriangle(Vec3 const& p, int& out_triangle, float maxDistance, int64_t* numTriangleTests /*= nullptr*/) const
+{
+	out_triangle = -1;
+	if (m_nodes.empty())
+	{
+		return maxDistance;
+	}
+
+	float bestDistance = maxDistance;
+	float bestDistanceSquared = maxDistance * maxDistance;
+	int64_t numTests = 0;
+	int stack[MAX_TRIANGLE_BVH_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		int nodeIndex = stack[--top];
+		SdfTriangleBvhNode const& node = m_nodes[nodeIndex];
+		if (GetDistanceSquaredToBox(p, node.m_boundsMin, node.m_boundsMax) >= bestDistanceSquared)
+		{
+			continue;
+		}
+		if (node.m_numTriangles > 0)
+		{
+			for (int triangle = node.m_first; triangle < node.m_first + node.m_numTriangles; ++triangle)
+			{
+				float distance = GetDistanceToTriangle(p, triangle);
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					bestDistanceSquared = distance * distance;
+					out_triangle = triangle;
+				}
+			}
+			numTests += node.m_numTriangles;
+			continue;
+		}
+
+		// Nearer child on top
+		int firstChild = nodeIndex + 1;
+		int secondChild = node.m_first;
+		float firstDistanceSquared = GetDistanceSquaredToBox(p, m_nodes[firstChild].m_boundsMin, m_nodes[firstChild].m_boundsMax);
+		float secondDistanceSquared = GetDistanceSquaredToBox(p, m_nodes[secondChild].m_boundsMin, m_nodes[secondChild].m_boundsMax);
+		if (firstDistanceSquared < secondDistanceSquared)
+		{
+			std::swap(firstChild, secondChild);
+			std::swap(firstDistanceSquared, secondDistanceSquared);
+		}
+		if (firstDistanceSquared < bestDistanceSquared)
+		{
+			stack[top++] = firstChild;
+		}
+		if (secondDistanceSquared < bestDistanceSquared)
+		{
+			stack[top++] = secondChild;
+		}
+	}
+
+	if (numTriangleTests)
+	{
+		*numTriangleTests += numTests;
+	}
+	return bestDistance;
+}
+
+float SdfTriangleBvh::GetDistanceToTriangle(Vec3 const& p, int triangle) const
+{
+	Vec3 const* corners = &m_vertices[triangle * 3];
+	return (p - GetClosestPointOnTriangle(p, corners[0], corners[1], corners[2])).GetLength();
+}
+
+void SdfTriangleBvh::GetTriangleBounds(int triangle, Vec3& out_mins, Vec3& out_maxs) const
+{
+	Vec3 const* corners = &m_vertices[triangle * 3];
+	out_mins = Vec3(fminf(fminf(corners[0].x, corners[1].x), corners[2].x), fminf(fminf(corners[0].y, corners[1].y), corners[2].y), fminf(fminf(corners[0].z, corners[1].z), corners[2].z));
+	out_maxs = Vec3(fmaxf(fmaxf(corners[0].x, corners[1].x), corners[2].x), fmaxf(fmaxf(corners[0].y, corners[1].y), corners[2].y), fmaxf(fmaxf(corners[0].z, corners[1].z), corners[2].z));
+}
+
+void SdfTriangleBvh::FindLineCrossings(int axis, float u, float v, std::vector<float>& out_crossings) const
+{
+	out_crossings.clear();
+	if (m_nodes.empty())
+	{
+		return;
+	}
+	int uAxis = (axis + 1) % 3;
+	int vAxis = (axis + 2) % 3;
+
+	int stack[MAX_TRIANGLE_BVH_DEPTH];
+	int top = 0;
+	stack[top++] = 0;
+	while (top > 0)
+	{
+		int nodeIndex = stack[--top];
+		SdfTriangleBvhNode const& node = m_nodes[nodeIndex];
+		if (u < GetComponent(node.m_boundsMin, uAxis) || u > GetComponent(node.m_boundsMax, uAxis) ||
+			v < GetComponent(node.m_boundsMin, vAxis) || v > GetComponent(node.m_boundsMax, vAxis))
+		{
+			continue;
+		}
+		if (node.m_numTriangles == 0)
+		{
+			stack[top++] = node.m_first;
+			stack[top++] = nodeIndex + 1;
+			continue;
+		}
+
+		for (int triangle = node.m_first; triangle < node.m_first + node.m_numTriangles; ++triangle)
+		{
+			// Corners relative to the line, projected along axis
+			Vec3 const* corners = &m_vertices[triangle * 3];
+			float au = GetComponent(corners[0], uAxis) - u;
+			float av = GetComponent(corners[0], vAxis) - v;
+			float bu = GetComponent(corners[1], uAxis) - u;
+			float bv = GetComponent(corners[1], vAxis) - v;
+			float cu = GetComponent(corners[2], uAxis) - u;
+			float cv = GetComponent(corners[2], vAxis) - v;
+			float area = (bu - au) * (cv - av) - (bv - av) * (cu - au);
+			if (area == 0.f)
+			{
+				continue; // edge-on, the line grazes it
+			}
+			float weightA = GetEdgeFunction(bu, bv, cu, cv);
+			float weightB = GetEdgeFunction(cu, cv, au, av);
+			float weightC = GetEdgeFunction(au, av, bu, bv);
+			bool isInside = (weightA > 0.f && weightB > 0.f && weightC > 0.f) || (weightA < 0.f && weightB < 0.f && weightC < 0.f);
+			if (!isInside)
+			{
+				continue;
+			}
+			float sum = weightA + weightB + weightC;
+			out_crossings.push_back((weightA * GetComponent(corners[0], axis) + weightB * GetComponent(corners[1], axis) + weightC * GetComponent(corners[2], axis)) / sum);
+		}
+	}
+}
+
+float SdfTriangleBvh::GetWindingNumber(Vec3 const& p) const
+{
+	// Solid angle of each triangle seen from p, Van Oosterom and Strackee
+	float solidAngle = 0.f;
+	for (int triangle = 0; triangle < GetNumTriangles(); ++triangle)
+	{
+		Vec3 a = m_vertices[triangle * 3] - p;
+		Vec3 b = m_vertices[triangle * 3 + 1] - p;
+		Vec3 c = m_vertices[triangle * 3 + 2] - p;
+		float lengthA = a.GetLength();
+		float lengthB = b.GetLength();
+		float lengthC = c.GetLength();
+		float determinant = DotProduct3D(a, CrossProduct3D(b, c));
+		float divisor = lengthA * lengthB * lengthC + DotProduct3D(a, b) * lengthC + DotProduct3D(b, c) * lengthA + DotProduct3D(c, a) * lengthB;
+		solidAngle += 2.f * atan2f(determinant, divisor);
+	}
+	return fabsf(solidAngle) / FOUR_PI;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+static void BakeExactDistances(SdfTriangleBvh const& bvh, SdfBakedGrid& grid, JobPool* jobPool, std::atomic<int64_t>& numTriangleTests)
+{
+	// Along a row each sample is within a voxel of the previous one's closest triangle
+	int numRows = grid.m_numSamplesY * grid.m_numSamplesZ;
+	RunBakeJobs(numRows, jobPool, [&](int row)
+	{
+		int y = row % grid.m_numSamplesY;
+		int z = row / grid.m_numSamplesY;
+		float* rowSamples = &grid.m_samples[(size_t)row * grid.m_numSamplesX];
+		int64_t numTests = 0;
+		float previousDistance = FLT_MAX;
+		for (int x = 0; x < grid.m_numSamplesX; ++x)
+		{
+			Vec3 p = grid.m_origin + Vec3((float)x, (float)y, (float)z) * grid.m_voxelSize;
+			float maxDistance = (previousDistance < FLT_MAX) ? previousDistance + grid.m_voxelSize * 1.001f : FLT_MAX;
+			int triangle = -1;
+			float distance = bvh.FindClosestTriangle(p, triangle, maxDistance, &numTests);
+			if (triangle < 0)
+			{
+				distance = bvh.FindClosestTriangle(p, triangle, FLT_MAX, &numTests);
+			}
+			rowSamples[x] = distance;
+			previousDistance = distance;
+		}
+		numTriangleTests += numTests;
+	});
+}
+
+static void BakeJumpFloodDistances(SdfTriangleBvh const& bvh, SdfBakedGrid& grid, JobPool* jobPool, std::atomic<int64_t>& numTriangleTests)
+{
+	int numX = grid.m_numSamplesX;
+	int numY = grid.m_numSamplesY;
+	int numZ = grid.m_numSamplesZ;
+	size_t numSamples = grid.m_samples.size();
+	std::vector<int> triangles(numSamples, -1);
+	std::vector<float> distances(numSamples, FLT_MAX);
+
+	// Seeds: the samples of the voxels each triangle passes through, binned by slice so slices write in parallel
+	std::vector<std::vector<int>> sliceTriangles(numZ);
+	std::vector<int> triangleRanges(bvh.GetNumTriangles() * 6);
+	for (int triangle = 0; triangle < bvh.GetNumTriangles(); ++triangle)
+	{
+		Vec3 mins;
+		Vec3 maxs;
+		bvh.GetTriangleBounds(triangle, mins, maxs);
+		Vec3 minCoords = (mins - grid.m_origin) / grid.m_voxelSize;
+		Vec3 maxCoords = (maxs - grid.m_origin) / grid.m_voxelSize;
+		int* range = &triangleRanges[triangle * 6];
+		range[0] = std::max((int)floorf(minCoords.x), 0);
+		range[1] = std::max((int)floorf(minCoords.y), 0);
+		range[2] = std::max((int)floorf(minCoords.z), 0);
+		range[3] = std::min((int)floorf(maxCoords.x) + 1, numX - 1);
+		range[4] = std::min((int)floorf(maxCoords.y) + 1, numY - 1);
+		range[5] = std::min((int)floorf(maxCoords.z) + 1, numZ - 1);
+		for (int z = range[2]; z <= range[5]; ++z)
+		{
+			sliceTriangles[z].push_back(triangle);
+		}
+	}
+	RunBakeJobs(numZ, jobPool, [&](int z)
+	{
+		int64_t numTests = 0;
+		for (int triangle : sliceTriangles[z])
+		{
+			int const* range = &triangleRanges[triangle * 6];
+			for (int y = range[1]; y <= range[4]; ++y)
+			{
+				for (int x = range[0]; x <= range[3]; ++x)
+				{
+					size_t sampleIndex = ((size_t)z * numY + y) * numX + x;
+					float distance = bvh.GetDistanceToTriangle(grid.m_origin + Vec3((float)x, (float)y, (float)z) * grid.m_voxelSize, triangle);
+					if (distance < distances[sampleIndex])
+					{
+						distances[sampleIndex] = distance;
+						triangles[sampleIndex] = triangle;
+					}
+				}
+			}
+			numTests += (range[3] - range[0] + 1) * (range[4] - range[1] + 1);
+		}
+		numTriangleTests += numTests;
+	});
+
+	// Jump flooding: steps of half the grid down to 1, each sample trying the triangles of its 26 neighbours at step
+	int maxDimension = std::max(std::max(numX, numY), numZ);
+	int step = 1;
+	while (step * 2 < maxDimension)
+	{
+		step *= 2;
+	}
+	std::vector<int> nextTriangles(numSamples);
+	std::vector<float> nextDistances(numSamples);
+	for (; step >= 1; step /= 2)
+	{
+		RunBakeJobs(numZ, jobPool, [&](int z)
+		{
+			int64_t numTests = 0;
+			for (int y = 0; y < numY; ++y)
+			{
+				for (int x = 0; x < numX; ++x)
+				{
+					size_t sampleIndex = ((size_t)z * numY + y) * numX + x;
+					int bestTriangle = triangles[sampleIndex];
+					float bestDistance = distances[sampleIndex];
+					Vec3 p = grid.m_origin + Vec3((float)x, (float)y, (float)z) * grid.m_voxelSize;
+					for (int dz = -step; dz <= step; dz += step)
+					{
+						int nz = z + dz;
+						if (nz < 0 || nz >= numZ)
+						{
+							continue;
+						}
+						for (int dy = -step; dy <= step; dy += step)
+						{
+							int ny = y + dy;
+							if (ny < 0 || ny >= numY)
+							{
+								continue;
+							}
+							for (int dx = -step; dx <= step; dx += step)
+							{
+								int nx = x + dx;
+								if (nx < 0 || nx >= numX)
+								{
+									continue;
+								}
+								int triangle = triangles[((size_t)nz * numY + ny) * numX + nx];
+								if (triangle < 0 || triangle == bestTriangle)
+								{
+									continue;
+								}
+								float distance = bvh.GetDistanceToTriangle(p, triangle);
+								++numTests;
+								if (distance < bestDistance)
+								{
+									bestDistance = distance;
+									bestTriangle = triangle;
+								}
+							}
+						}
+					}
+					nextTriangles[sampleIndex] = bestTriangle;
+					nextDistances[sampleIndex] = bestDistance;
+				}
+			}
+			numTriangleTests += numTests;
+		});
+		triangles.swap(nextTriangles);
+		distances.swap(nextDistances);
+	}
+	grid.m_samples.swap(distances);
+}
+
+static void BakeRayParitySigns(SdfTriangleBvh const& bvh, SdfBakedGrid& grid, JobPool* jobPool)
+{
+	// A sample is inside when the lines along at least two of the axes cross the mesh an odd number of times before it
+	int numSamples[3] = { grid.m_numSamplesX, grid.m_numSamplesY, grid.m_numSamplesZ };
+	float origin[3] = { grid.m_origin.x, grid.m_origin.y, grid.m_origin.z };
+	std::vector<uint8_t> insideVotes(grid.m_samples.size(), 0);
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		int uAxis = (axis + 1) % 3;
+		int vAxis = (axis + 2) % 3;
+		int numLines = numSamples[uAxis] * numSamples[vAxis];
+		RunBakeJobs(numLines, jobPool, [&](int line)
+		{
+			int coords[3];
+			coords[uAxis] = line % numSamples[uAxis];
+			coords[vAxis] = line / numSamples[uAxis];
+			float u = origin[uAxis] + (float)coords[uAxis] * grid.m_voxelSize;
+			float v = origin[vAxis] + (float)coords[vAxis] * grid.m_voxelSize;
+			std::vector<float> crossings;
+			bvh.FindLineCrossings(axis, u, v, crossings);
+			std::sort(crossings.begin(), crossings.end());
+
+			size_t numCrossed = 0;
+			for (int i = 0; i < numSamples[axis]; ++i)
+			{
+				coords[axis] = i;
+				float position = origin[axis] + (float)i * grid.m_voxelSize;
+				while (numCrossed < crossings.size() && crossings[numCrossed] < position)
+				{
+					++numCrossed;
+				}
+				if (numCrossed % 2 == 1)
+				{
+					++insideVotes[((size_t)coords[2] * numSamples[1] + coords[1]) * numSamples[0] + coords[0]];
+				}
+			}
+		});
+	}
+	for (size_t sampleIndex = 0; sampleIndex < grid.m_samples.size(); ++sampleIndex)
+	{
+		if (insideVotes[sampleIndex] >= 2)
+		{
+			grid.m_samples[sampleIndex] = -grid.m_samples[sampleIndex];
+		}
+	}
+}
+
+static void BakeWindingNumberSigns(SdfTriangleBvh const& bvh, SdfBakedGrid& grid, JobPool* jobPool)
+{
+	RunBakeJobs(grid.m_numSamplesZ, jobPool, [&](int z)
+	{
+		for (int y = 0; y < grid.m_numSamplesY; ++y)
+		{
+			for (int x = 0; x < grid.m_numSamplesX; ++x)
+			{
+				if (bvh.GetWindingNumber(grid.m_origin + Vec3((float)x, (float)y, (float)z) * grid.m_voxelSize) > 0.5f)
+				{
+					float& sample = grid.m_samples[((size_t)z * grid.m_numSamplesY + y) * grid.m_numSamplesX + x];
+					sample = -sample;
+				}
+			}
+		}
+	});
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool BakeSdfMesh(std::vector<Vec3> const& positions, std::vector<unsigned int> const& indices, SdfBakeOptions const& options, JobPool* jobPool,
+	SdfBakedGrid& out_grid, SdfBakeStats* out_stats /*= nullptr*/)
+{
+	auto startTime = std::chrono::steady_clock::now();
+	out_grid = SdfBakedGrid();
+	int numInnerVoxels = options.m_resolution - 1 - 2 * SDF_BAKE_PADDING_VOXELS;
+	if (indices.size() < 3 || numInnerVoxels < 1)
+	{
+		return false;
+	}
+
+	SdfTriangleBvh bvh;
+	bvh.Build(positions, indices);
+	double bvhMilliseconds = GetMillisecondsSince(startTime);
+
+	Vec3 boundsMin = bvh.GetBoundsMin();
+	Vec3 extents = bvh.GetBoundsMax() - boundsMin;
+	float maxExtent = fmaxf(fmaxf(extents.x, extents.y), extents.z);
+	if (maxExtent <= 0.f)
+	{
+		return false;
+	}
+	out_grid.m_voxelSize = maxExtent / (float)numInnerVoxels;
+	out_grid.m_origin = boundsMin - Vec3(1.f, 1.f, 1.f) * ((float)SDF_BAKE_PADDING_VOXELS * out_grid.m_voxelSize);
+	out_grid.m_numSamplesX = (int)ceilf(extents.x / out_grid.m_voxelSize) + 1 + 2 * SDF_BAKE_PADDING_VOXELS;
+	out_grid.m_numSamplesY = (int)ceilf(extents.y / out_grid.m_voxelSize) + 1 + 2 * SDF_BAKE_PADDING_VOXELS;
+	out_grid.m_numSamplesZ = (int)ceilf(extents.z / out_grid.m_voxelSize) + 1 + 2 * SDF_BAKE_PADDING_VOXELS;
+	out_grid.m_samples.resize((size_t)out_grid.m_numSamplesX * out_grid.m_numSamplesY * out_grid.m_numSamplesZ);
+
+	auto distanceStartTime = std::chrono::steady_clock::now();
+	std::atomic<int64_t> numTriangleTests(0);
+	if (options.m_distanceMode == SdfBakeDistanceMode::JUMP_FLOOD)
+	{
+		BakeJumpFloodDistances(bvh, out_grid, jobPool, numTriangleTests);
+	}
+	else
+	{
+		BakeExactDistances(bvh, out_grid, jobPool, numTriangleTests);
+	}
+	double distanceMilliseconds = GetMillisecondsSince(distanceStartTime);
+
+	auto signStartTime = std::chrono::steady_clock::now();
+	if (options.m_signMode == SdfBakeSignMode::WINDING_NUMBER)
+	{
+		BakeWindingNumberSigns(bvh, out_grid, jobPool);
+	}
+	else
+	{
+		BakeRayParitySigns(bvh, out_grid, jobPool);
+	}
+
+	if (out_stats)
+	{
+		out_stats->m_numTriangles = bvh.GetNumTriangles();
+		out_stats->m_numSamples = (int)out_grid.m_samples.size();
+		out_stats->m_numTriangleTests = numTriangleTests;
+		out_stats->m_bvhMilliseconds = bvhMilliseconds;
+		out_stats->m_distanceMilliseconds = distanceMilliseconds;
+		out_stats->m_signMilliseconds = GetMillisecondsSince(signStartTime);
+		out_stats->m_totalMilliseconds = GetMillisecondsSince(startTime);
+	}
+	return true;
+}
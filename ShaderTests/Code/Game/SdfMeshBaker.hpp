@@ -0,0 +1,129 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+/*
+Triangle meshes baked into a grid of signed distances, so the test models of GamePBR and GameTriplanarMapping can be
+placed in the SDF scene: SdfShape::SDF_BAKED_GRID, drawn through the CSG program (SDF_CSG_OP_GRID).
+Distances come from SdfTriangleBvh, a BVH over the triangles queried for the closest one. EXACT queries it at every
+sample, the previous sample of the row bounding the search. JUMP_FLOOD only computes the samples next to a triangle,
+then hands the closest triangles on to the samples 2^n, ..., 2, 1 voxels away: each sample then measures the
+distance to the best triangle its neighbours know of, exact or slightly above it.
+The sign comes from either:
+	RAY_PARITY      crossings of the grid lines along x, y and z, the majority of the three, for closed meshes
+	WINDING_NUMBER  the generalized winding number, the solid angle of every triangle, for meshes with holes
+	                (every triangle at every sample, slow past 64^3)
+Rows and slices run over a JobPool. The grid extends SDF_BAKE_PADDING_VOXELS past the mesh, so its boundary samples
+are all positive.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_BAKE_PADDING_VOXELS = 2;
+constexpr int SDF_TRIANGLE_BVH_LEAF_SIZE = 4;
+
+
+enum class SdfBakeSignMode : uint8_t
+{
+	RAY_PARITY,
+	WINDING_NUMBER,
+};
+
+enum class SdfBakeDistanceMode : uint8_t
+{
+	EXACT,
+	JUMP_FLOOD,
+};
+
+struct SdfBakeOptions
+{
+	int m_resolution = 64; // samples along the longest side of the mesh bounds, padding included
+	SdfBakeSignMode m_signMode = SdfBakeSignMode::RAY_PARITY;
+	SdfBakeDistanceMode m_distanceMode = SdfBakeDistanceMode::EXACT;
+};
+
+struct SdfBakeStats
+{
+	int m_numTriangles = 0;
+	int m_numSamples = 0;
+	int64_t m_numTriangleTests = 0; // point-triangle distances
+	double m_bvhMilliseconds = 0.0;
+	double m_distanceMilliseconds = 0.0;
+	double m_signMilliseconds = 0.0;
+	double m_totalMilliseconds = 0.0;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// Signed distances at the corners of cubic voxels, in mesh units, negative inside
+struct SdfBakedGrid
+{
+	Vec3 m_origin; // the first sample
+	float m_voxelSize = 0.f;
+	int m_numSamplesX = 0;
+	int m_numSamplesY = 0;
+	int m_numSamplesZ = 0;
+	std::vector<float> m_samples; // x fastest
+
+	bool IsEmpty() const { return m_samples.empty(); }
+	Vec3 GetBoundsMax() const;
+	float GetSample(int x, int y, int z) const { return m_samples[((size_t)z * m_numSamplesY + y) * m_numSamplesX + x]; }
+
+	// Trilinear inside the grid. Outside it, the distance to the grid box plus the value at the nearest point of it,
+	// same as SDF_CSG_OP_GRID
+	float Sample(Vec3 const& p) const;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfTriangleBvhNode
+{
+	Vec3 m_boundsMin;
+	int m_first = 0; // leaves: first triangle, inner nodes: second child (the first one follows the node)
+	Vec3 m_boundsMax;
+	int m_numTriangles = 0; // 0 for inner nodes
+};
+
+
+class SdfTriangleBvh
+{
+public:
+	// indices: three per triangle. Triangles are stored again in leaf order.
+	void Build(std::vector<Vec3> const& positions, std::vector<unsigned int> const& indices);
+
+	int GetNumTriangles() const { return (int)m_triangleIds.size(); }
+	bool IsEmpty() const { return m_nodes.empty(); }
+	Vec3 const& GetBoundsMin() const { return m_nodes[0].m_boundsMin; }
+	Vec3 const& GetBoundsMax() const { return m_nodes[0].m_boundsMax; }
+	std::vector<SdfTriangleBvhNode> const& GetNodes() const { return m_nodes; }
+
+	// Distance to the closest triangle nearer than maxDistance, out_triangle: its leaf-order index, or -1 past maxDistance
+	float FindClosestTriangle(Vec3 const& p, int& out_triangle, float maxDistance, int64_t* numTriangleTests = nullptr) const;
+	float GetDistanceToTriangle(Vec3 const& p, int triangle) const;
+	int GetTriangleId(int triangle) const { return m_triangleIds[triangle]; } // index in the mesh
+	void GetTriangleBounds(int triangle, Vec3& out_mins, Vec3& out_maxs) const;
+
+	// Coordinates along axis where the line through (u, v) on the other two axes (axis + 1, axis + 2) crosses a
+	// triangle. A line through a shared edge crosses exactly one of its triangles.
+	void FindLineCrossings(int axis, float u, float v, std::vector<float>& out_crossings) const;
+
+	// Generalized winding number at p: about 1 inside a closed mesh, 0 outside, either orientation gives the sign
+	float GetWindingNumber(Vec3 const& p) const;
+
+private:
+	int BuildNode(int first, int count, std::vector<Vec3> const& corners, std::vector<Vec3> const& centroids);
+
+private:
+	std::vector<SdfTriangleBvhNode> m_nodes;
+	std::vector<Vec3> m_vertices; // three per triangle, leaf order
+	std::vector<int> m_triangleIds;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+// False when the mesh has no triangle or the resolution leaves no room inside the padding
+bool BakeSdfMesh(std::vector<Vec3> const& positions, std::vector<unsigned int> const& indices, SdfBakeOptions const& options, JobPool* jobPool,
+	SdfBakedGrid& out_grid, SdfBakeStats* out_stats = nullptr);
@@ -0,0 +1,537 @@
+#include "Game/SdfSceneQuery.hpp"
+#include "Game/JobPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr float NORMAL_OFFSET = 0.0001f; // h of SdfNormalTetra
+static constexpr int MORTON_BITS = 10; // per axis
+
+// The tetrahedron of SdfNormalTetra, in its order
+static Vec3 const NORMAL_TAPS[4] = { Vec3(1.f, -1.f, -1.f), Vec3(-1.f, -1.f, 1.f), Vec3(-1.f, 1.f, -1.f), Vec3(1.f, 1.f, 1.f) };
+
+
+//-----------------------------------------------------------------------------------------------
+static SimdFloat MakeLaneMask(int laneBits)
+{
+	alignas(32) float lanes[SDF_SIMD_WIDTH];
+	for (int lane = 0; lane < SDF_SIMD_WIDTH; ++lane)
+	{
+		lanes[lane] = ((laneBits >> lane) & 1) ? 1.f : 0.f;
+	}
+	return SimdGreater(SimdLoad(lanes), SimdSet1(0.5f));
+}
+
+static uint32_t SpreadMortonBits(uint32_t value)
+{
+	value = (value | (value << 16)) & 0x030000FFu;
+	value = (value | (value << 8)) & 0x0300F00Fu;
+	value = (value | (value << 4)) & 0x030C30C3u;
+	value = (value | (value << 2)) & 0x09249249u;
+	return value;
+}
+
+// Query indices along a Morton curve through the bounds of the points, so packets gather neighbours
+static void SortQueriesByPosition(std::vector<Vec3> const& positions, std::vector<uint32_t>& out_order)
+{
+	Vec3 boundsMin = positions.empty() ? Vec3() : positions[0];
+	Vec3 boundsMax = boundsMin;
+	for (Vec3 const& position : positions)
+	{
+		boundsMin = Vec3(fminf(boundsMin.x, position.x), fminf(boundsMin.y, position.y), fminf(boundsMin.z, position.z));
+		boundsMax = Vec3(fmaxf(boundsMax.x, position.x), fmaxf(boundsMax.y, position.y), fmaxf(boundsMax.z, position.z));
+	}
+	Vec3 extent = boundsMax - boundsMin;
+	float cellsPerUnit = (float)((1 << MORTON_BITS) - 1) / fmaxf(fmaxf(fmaxf(extent.x, extent.y), extent.z), 1e-6f);
+
+	std::vector<uint64_t> keys(positions.size());
+	for (size_t index = 0; index < positions.size(); ++index)
+	{
+		Vec3 cell = (positions[index] - boundsMin) * cellsPerUnit;
+		uint32_t code = SpreadMortonBits((uint32_t)cell.x) | (SpreadMortonBits((uint32_t)cell.y) << 1) | (SpreadMortonBits((uint32_t)cell.z) << 2);
+		keys[index] = ((uint64_t)code << 32) | (uint64_t)index;
+	}
+	std::sort(keys.begin(), keys.end());
+
+	out_order.resize(positions.size());
+	for (size_t index = 0; index < positions.size(); ++index)
+	{
+		out_order[index] = (uint32_t)keys[index];
+	}
+}
+
+// Cuts the batch into SDF_QUERY_JOB_SIZE jobs on the pool (or inline when pool is null) and times it
+static SdfSceneQueryStats RunQueryJobs(int numQueries, JobPool* jobPool, std::function<void(int beginIndex, int endIndex, SdfSceneQueryStats& stats)> const& jobFunc)
+{
+	int numJobs = (numQueries + SDF_QUERY_JOB_SIZE - 1) / SDF_QUERY_JOB_SIZE;
+	std::vector<SdfSceneQueryStats> jobStats(numJobs);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	auto runJob = [&](int jobIndex)
+	{
+		int beginIndex = jobIndex * SDF_QUERY_JOB_SIZE;
+		int endIndex = (beginIndex + SDF_QUERY_JOB_SIZE < numQueries) ? beginIndex + SDF_QUERY_JOB_SIZE : numQueries;
+		jobFunc(beginIndex, endIndex, jobStats[jobIndex]);
+	};
+
+	if (jobPool && numJobs > 1)
+	{
+		jobPool->ParallelFor(numJobs, runJob);
+	}
+	else
+	{
+		for (int jobIndex = 0; jobIndex < numJobs; ++jobIndex)
+		{
+			runJob(jobIndex);
+		}
+	}
+
+	auto endTime = std::chrono::steady_clock::now();
+
+	SdfSceneQueryStats stats;
+	for (SdfSceneQueryStats const& job : jobStats)
+	{
+		stats.Add(job);
+	}
+	stats.m_numQueries = numQueries;
+	stats.m_milliseconds = std::chrono::duration<double, std::milli>(endTime - startTime).count();
+	return stats;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfSceneQueryStats::Add(SdfSceneQueryStats const& other)
+{
+	m_numQueries += other.m_numQueries;
+	m_milliseconds += other.m_milliseconds;
+	m_numPacketMaps += other.m_numPacketMaps;
+	m_numNodesVisited += other.m_numNodesVisited;
+	m_numShapeEvaluations += other.m_numShapeEvaluations;
+	m_numRaySteps += other.m_numRaySteps;
+}
+
+double SdfSceneQueryStats::GetQueriesPerSecond() const
+{
+	return (m_milliseconds > 0.0) ? (double)m_numQueries / (m_milliseconds * 0.001) : 0.0;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfSceneQuery::SetScene(std::vector<SdfShape> const& shapes, SdfRayMarchingConstants const& constants, SdfBvh const* prebuiltBvh /*= nullptr*/)
+{
+	SdfRayMarchingConstants queryConstants = constants;
+	queryConstants.useBvh = 1;
+	queryConstants.useCsgProgram = 0;
+	queryConstants.useBrickMap = 0;
+	m_scene.SetScene(shapes, queryConstants, prebuiltBvh);
+
+	SdfShapeStreams const& streams = m_scene.GetShapeStreams();
+	const bool isHalfPrecision = m_scene.IsHalfPrecisionGeometry();
+	int numShapes = streams.GetNumShapes();
+	m_centerX.resize(numShapes);
+	m_centerY.resize(numShapes);
+	m_centerZ.resize(numShapes);
+	m_radius.resize(numShapes);
+	for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+	{
+		Vec4 geometry = streams.GetGeometry(shapeIndex, isHalfPrecision);
+		m_centerX[shapeIndex] = geometry.x;
+		m_centerY[shapeIndex] = geometry.y;
+		m_centerZ[shapeIndex] = geometry.z;
+		m_radius[shapeIndex] = geometry.w;
+	}
+}
+
+SdfSceneQueryStats SdfSceneQuery::Raycast(std::vector<SdfRayQuery> const& queries, std::vector<SdfRayQueryHit>& out_hits, JobPool* jobPool /*= nullptr*/) const
+{
+	out_hits.resize(queries.size());
+	return RunQueryJobs((int)queries.size(), jobPool, [&](int beginIndex, int endIndex, SdfSceneQueryStats& stats)
+	{
+		for (int index = beginIndex; index < endIndex; index += SDF_SIMD_WIDTH)
+		{
+			int numQueries = (endIndex - index < SDF_SIMD_WIDTH) ? endIndex - index : SDF_SIMD_WIDTH;
+			RaycastPacket(&queries[index], numQueries, &out_hits[index], stats);
+		}
+	});
+}
+
+SdfSceneQueryStats SdfSceneQuery::FindClosestPoints(std::vector<Vec3> const& points, std::vector<SdfClosestPointResult>& out_results, JobPool* jobPool /*= nullptr*/) const
+{
+	auto sortStart = std::chrono::steady_clock::now();
+	std::vector<uint32_t> order;
+	SortQueriesByPosition(points, order);
+	double sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sortStart).count();
+
+	out_results.resize(points.size());
+	SdfSceneQueryStats stats = RunQueryJobs((int)points.size(), jobPool, [&](int beginIndex, int endIndex, SdfSceneQueryStats& jobStats)
+	{
+		for (int index = beginIndex; index < endIndex; index += SDF_SIMD_WIDTH)
+		{
+			int numQueries = (endIndex - index < SDF_SIMD_WIDTH) ? endIndex - index : SDF_SIMD_WIDTH;
+			ClosestPointPacket(points, &order[index], numQueries, out_results, jobStats);
+		}
+	});
+	stats.m_milliseconds += sortMilliseconds;
+	return stats;
+}
+
+SdfSceneQueryStats SdfSceneQuery::Overlap(std::vector<SdfOverlapQuery> const& queries, std::vector<SdfOverlapResult>& out_results, JobPool* jobPool /*= nullptr*/) const
+{
+	auto sortStart = std::chrono::steady_clock::now();
+	std::vector<Vec3> centers(queries.size());
+	for (size_t index = 0; index < queries.size(); ++index)
+	{
+		centers[index] = queries[index].m_center;
+	}
+	std::vector<uint32_t> order;
+	SortQueriesByPosition(centers, order);
+	double sortMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - sortStart).count();
+
+	out_results.resize(queries.size());
+	SdfSceneQueryStats stats = RunQueryJobs((int)queries.size(), jobPool, [&](int beginIndex, int endIndex, SdfSceneQueryStats& jobStats)
+	{
+		for (int index = beginIndex; index < endIndex; index += SDF_SIMD_WIDTH)
+		{
+			int numQueries = (endIndex - index < SDF_SIMD_WIDTH) ? endIndex - index : SDF_SIMD_WIDTH;
+			OverlapPacket(queries, &order[index], numQueries, out_results, jobStats);
+		}
+	});
+	stats.m_milliseconds += sortMilliseconds;
+	return stats;
+}
+
+int SdfSceneQuery::FindNearestShape(Vec3 const& p) const
+{
+	std::vector<SdfBvhNode> const& nodes = m_scene.GetBvh().GetNodes();
+	if (nodes.empty())
+	{
+		return -1;
+	}
+
+	float nearestDistance = SDF_INFINITY_DIST;
+	int nearestSlot = -1;
+	uint32_t stack[SDF_BVH_STACK_SIZE];
+	int stackSize = 0;
+	stack[stackSize++] = 0;
+	while (stackSize > 0)
+	{
+		SdfBvhNode const& node = nodes[stack[--stackSize]];
+
+		// Same bound as SdfMapBvh: every shape of the node is farther than its inflated box
+		float distSquared = node.GetDistanceSquared(p);
+		if (distSquared > 0.f && (nearestDistance <= 0.f || distSquared >= nearestDistance * nearestDistance))
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			for (uint32_t slot = node.m_leftOrFirst; slot < node.m_leftOrFirst + node.m_count; ++slot)
+			{
+				float distance = SdSphere(p, Vec3(m_centerX[slot], m_centerY[slot], m_centerZ[slot]), m_radius[slot]);
+				if (distance < nearestDistance)
+				{
+					nearestDistance = distance;
+					nearestSlot = (int)slot;
+				}
+			}
+			continue;
+		}
+		stack[stackSize++] = node.m_leftOrFirst + 1;
+		stack[stackSize++] = node.m_leftOrFirst;
+	}
+	return (nearestSlot >= 0) ? (int)m_scene.GetBvh().GetShapeOrder()[nearestSlot] : -1;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfSceneQuery::MapPacket(float const* positionX, float const* positionY, float const* positionZ, SimdFloat const& laneMask, float* out_distances, SdfSceneQueryStats& stats) const
+{
+	std::vector<SdfBvhNode> const& nodes = m_scene.GetBvh().GetNodes();
+	const float toleranceK = m_scene.GetConstants().toleranceK;
+	const SimdFloat zero = SimdSet1(0.f);
+
+	SimdFloat x = SimdLoad(positionX);
+	SimdFloat y = SimdLoad(positionY);
+	SimdFloat z = SimdLoad(positionZ);
+	SimdFloat res = SimdSet1(SDF_INFINITY_DIST);
+	++stats.m_numPacketMaps;
+
+	uint32_t stack[SDF_BVH_STACK_SIZE];
+	SimdFloat stackMasks[SDF_BVH_STACK_SIZE];
+	int stackSize = 0;
+	if (!nodes.empty())
+	{
+		stack[stackSize] = 0;
+		stackMasks[stackSize++] = laneMask;
+	}
+
+	while (stackSize > 0)
+	{
+		--stackSize;
+		SdfBvhNode const& node = nodes[stack[stackSize]];
+		SimdFloat nodeMask = stackMasks[stackSize];
+		++stats.m_numNodesVisited;
+
+		// The cull of SdfMapBvh lane by lane: a lane enters the node when it is inside the bounds, or when res is
+		// positive and the bounds are nearer than it
+		SimdFloat dx = SimdMax(SimdMax(SimdSet1(node.m_boundsMin.x) - x, x - SimdSet1(node.m_boundsMax.x)), zero);
+		SimdFloat dy = SimdMax(SimdMax(SimdSet1(node.m_boundsMin.y) - y, y - SimdSet1(node.m_boundsMax.y)), zero);
+		SimdFloat dz = SimdMax(SimdMax(SimdSet1(node.m_boundsMin.z) - z, z - SimdSet1(node.m_boundsMax.z)), zero);
+		SimdFloat distSquared = dx * dx + dy * dy + dz * dz;
+		SimdFloat isNear = SimdAnd(SimdGreater(res, zero), SimdLess(distSquared, res * res));
+		SimdFloat enterMask = SimdOr(SimdAndNot(SimdGreater(distSquared, zero), nodeMask), SimdAnd(nodeMask, isNear));
+		if (SimdMoveMask(enterMask) == 0)
+		{
+			continue;
+		}
+
+		if (node.IsLeaf())
+		{
+			for (uint32_t slot = node.m_leftOrFirst; slot < node.m_leftOrFirst + node.m_count; ++slot)
+			{
+				SimdFloat offsetX = x - SimdSet1(m_centerX[slot]);
+				SimdFloat offsetY = y - SimdSet1(m_centerY[slot]);
+				SimdFloat offsetZ = z - SimdSet1(m_centerZ[slot]);
+				SimdFloat d = SimdSqrt(offsetX * offsetX + offsetY * offsetY + offsetZ * offsetZ) - SimdSet1(m_radius[slot]);
+				res = SimdSelect(enterMask, SimdSminCubic(res, d, toleranceK), res);
+			}
+			stats.m_numShapeEvaluations += node.m_count;
+			continue;
+		}
+
+		// Left first, the stream order SdfMapBvh blends in
+		stack[stackSize] = node.m_leftOrFirst + 1;
+		stackMasks[stackSize++] = enterMask;
+		stack[stackSize] = node.m_leftOrFirst;
+		stackMasks[stackSize++] = enterMask;
+	}
+
+	SimdStore(out_distances, res);
+}
+
+void SdfSceneQuery::NormalPacket(float const* positionX, float const* positionY, float const* positionZ, SimdFloat const& laneMask, Vec3* out_normals, SdfSceneQueryStats& stats,
+	float* out_gradientLengths /*= nullptr*/) const
+{
+	alignas(32) float tapDistances[4][SDF_SIMD_WIDTH];
+	for (int tap = 0; tap < 4; ++tap)
+	{
+		Vec3 offset = NORMAL_TAPS[tap] * NORMAL_OFFSET;
+		alignas(32) float tapX[SDF_SIMD_WIDTH];
+		alignas(32) float tapY[SDF_SIMD_WIDTH];
+		alignas(32) float tapZ[SDF_SIMD_WIDTH];
+		SimdStore(tapX, SimdLoad(positionX) + SimdSet1(offset.x));
+		SimdStore(tapY, SimdLoad(positionY) + SimdSet1(offset.y));
+		SimdStore(tapZ, SimdLoad(positionZ) + SimdSet1(offset.z));
+		MapPacket(tapX, tapY, tapZ, laneMask, tapDistances[tap], stats);
+	}
+
+	// Summed in the order of SdfNormalTetra
+	for (int lane = 0; lane < SDF_SIMD_WIDTH; ++lane)
+	{
+		Vec3 gradient = NORMAL_TAPS[0] * tapDistances[0][lane] + NORMAL_TAPS[1] * tapDistances[1][lane] + NORMAL_TAPS[2] * tapDistances[2][lane] +
+			NORMAL_TAPS[3] * tapDistances[3][lane];
+		out_normals[lane] = gradient.GetNormalized();
+		if (out_gradientLengths)
+		{
+			// The taps sum to 4h times the gradient
+			out_gradientLengths[lane] = gradient.GetLength() / (4.f * NORMAL_OFFSET);
+		}
+	}
+}
+
+void SdfSceneQuery::RaycastPacket(SdfRayQuery const* queries, int numQueries, SdfRayQueryHit* out_hits, SdfSceneQueryStats& stats) const
+{
+	SdfRayMarchingConstants const& constants = m_scene.GetConstants();
+	const int maxSteps = constants.maxSteps;
+	const float minHitDistance = constants.minHitDistance;
+	const float maxTraceDistance = constants.maxTraceDistance;
+
+	alignas(32) float positionX[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionY[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionZ[SDF_SIMD_WIDTH] = {};
+	alignas(32) float distances[SDF_SIMD_WIDTH];
+	float distTraveled[SDF_SIMD_WIDTH] = {};
+	int activeBits = (1 << numQueries) - 1;
+	int hitBits = 0;
+
+	for (int query = 0; query < numQueries; ++query)
+	{
+		out_hits[query] = SdfRayQueryHit();
+	}
+
+	for (int step = 0; step < maxSteps && activeBits != 0; ++step)
+	{
+		for (int lane = 0; lane < numQueries; ++lane)
+		{
+			if ((activeBits >> lane) & 1)
+			{
+				Vec3 currPos = queries[lane].m_origin + queries[lane].m_direction * distTraveled[lane];
+				positionX[lane] = currPos.x;
+				positionY[lane] = currPos.y;
+				positionZ[lane] = currPos.z;
+				++stats.m_numRaySteps;
+			}
+		}
+
+		MapPacket(positionX, positionY, positionZ, MakeLaneMask(activeBits), distances, stats);
+
+		// Retire lanes independently, same tests as RayMarch
+		for (int lane = 0; lane < numQueries; ++lane)
+		{
+			if (((activeBits >> lane) & 1) == 0)
+			{
+				continue;
+			}
+
+			float distToClosest = distances[lane];
+			if (distToClosest < minHitDistance)
+			{
+				out_hits[lane].m_distance = distTraveled[lane];
+				out_hits[lane].m_position = Vec3(positionX[lane], positionY[lane], positionZ[lane]);
+				hitBits |= 1 << lane;
+				activeBits &= ~(1 << lane);
+			}
+			else if (distToClosest > maxTraceDistance)
+			{
+				activeBits &= ~(1 << lane);
+			}
+			else
+			{
+				distTraveled[lane] += distToClosest;
+				if (distTraveled[lane] > queries[lane].m_maxDistance)
+				{
+					activeBits &= ~(1 << lane);
+				}
+			}
+		}
+	}
+
+	if (hitBits == 0)
+	{
+		return;
+	}
+
+	// The hit lanes still hold their hit positions
+	Vec3 normals[SDF_SIMD_WIDTH];
+	NormalPacket(positionX, positionY, positionZ, MakeLaneMask(hitBits), normals, stats);
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		if ((hitBits >> lane) & 1)
+		{
+			out_hits[lane].m_normal = normals[lane];
+			out_hits[lane].m_shapeIndex = FindNearestShape(out_hits[lane].m_position);
+		}
+	}
+}
+
+void SdfSceneQuery::ClosestPointPacket(std::vector<Vec3> const& points, uint32_t const* queryIndices, int numQueries, std::vector<SdfClosestPointResult>& out_results,
+	SdfSceneQueryStats& stats) const
+{
+	const float minHitDistance = m_scene.GetConstants().minHitDistance;
+
+	alignas(32) float positionX[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionY[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionZ[SDF_SIMD_WIDTH] = {};
+	alignas(32) float distances[SDF_SIMD_WIDTH];
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		Vec3 const& point = points[queryIndices[lane]];
+		positionX[lane] = point.x;
+		positionY[lane] = point.y;
+		positionZ[lane] = point.z;
+	}
+
+	int queryBits = (1 << numQueries) - 1;
+	MapPacket(positionX, positionY, positionZ, MakeLaneMask(queryBits), distances, stats);
+
+	// No shapes, no surface
+	int validBits = 0;
+	float queryDistances[SDF_SIMD_WIDTH];
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		queryDistances[lane] = distances[lane];
+		if (distances[lane] < SDF_INFINITY_DIST)
+		{
+			validBits |= 1 << lane;
+		}
+	}
+
+	// Newton steps onto the surface: the blend is not an exact distance, its gradient is shorter than 1
+	Vec3 normals[SDF_SIMD_WIDTH];
+	float gradientLengths[SDF_SIMD_WIDTH];
+	int activeBits = validBits;
+	for (int step = 0; step < SDF_QUERY_PROJECTION_STEPS; ++step)
+	{
+		for (int lane = 0; lane < numQueries; ++lane)
+		{
+			if (fabsf(distances[lane]) < minHitDistance)
+			{
+				activeBits &= ~(1 << lane);
+			}
+		}
+		if (activeBits == 0)
+		{
+			break;
+		}
+
+		NormalPacket(positionX, positionY, positionZ, MakeLaneMask(activeBits), normals, stats, gradientLengths);
+		for (int lane = 0; lane < numQueries; ++lane)
+		{
+			if ((activeBits >> lane) & 1)
+			{
+				float stepLength = distances[lane] / fmaxf(gradientLengths[lane], SDF_QUERY_MIN_GRADIENT_LENGTH);
+				positionX[lane] -= normals[lane].x * stepLength;
+				positionY[lane] -= normals[lane].y * stepLength;
+				positionZ[lane] -= normals[lane].z * stepLength;
+			}
+		}
+		MapPacket(positionX, positionY, positionZ, MakeLaneMask(activeBits), distances, stats);
+	}
+
+	if (validBits != 0)
+	{
+		NormalPacket(positionX, positionY, positionZ, MakeLaneMask(validBits), normals, stats);
+	}
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		SdfClosestPointResult& result = out_results[queryIndices[lane]];
+		result = SdfClosestPointResult();
+		result.m_distance = queryDistances[lane];
+		if ((validBits >> lane) & 1)
+		{
+			result.m_closestPoint = Vec3(positionX[lane], positionY[lane], positionZ[lane]);
+			result.m_normal = normals[lane];
+			result.m_shapeIndex = FindNearestShape(result.m_closestPoint);
+		}
+	}
+}
+
+void SdfSceneQuery::OverlapPacket(std::vector<SdfOverlapQuery> const& queries, uint32_t const* queryIndices, int numQueries, std::vector<SdfOverlapResult>& out_results,
+	SdfSceneQueryStats& stats) const
+{
+	alignas(32) float positionX[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionY[SDF_SIMD_WIDTH] = {};
+	alignas(32) float positionZ[SDF_SIMD_WIDTH] = {};
+	alignas(32) float distances[SDF_SIMD_WIDTH];
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		Vec3 const& center = queries[queryIndices[lane]].m_center;
+		positionX[lane] = center.x;
+		positionY[lane] = center.y;
+		positionZ[lane] = center.z;
+	}
+
+	MapPacket(positionX, positionY, positionZ, MakeLaneMask((1 << numQueries) - 1), distances, stats);
+	for (int lane = 0; lane < numQueries; ++lane)
+	{
+		SdfOverlapResult& result = out_results[queryIndices[lane]];
+		result.m_distance = distances[lane];
+		result.m_isOverlapping = (distances[lane] < queries[queryIndices[lane]].m_radius);
+	}
+}
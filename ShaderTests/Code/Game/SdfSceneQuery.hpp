@@ -0,0 +1,127 @@
+#pragma once
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Game/SdfSimd.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+/*
+Batched CPU queries against the SDF spheres, for gameplay and tools: raycasts (picking), closest surface points and
+sphere overlaps (spawning without overlaps). The field is SdfCpuRayMarcher::SdfMap over the shape streams, the
+sminCubic blend included, through its BVH: culled nodes are the ones SdfMapBvh skips, so every lane evaluates the
+same shapes in the same order and gets the same distance as the scalar call.
+A batch is cut into jobs of SDF_QUERY_JOB_SIZE queries over a JobPool, a job into packets of SDF_SIMD_WIDTH queries
+that walk the BVH together: a node is entered when one lane needs it, and only those lanes take its shapes. Points
+are first sorted along a Morton curve so a packet holds neighbours; rays are packed in the order given, which for a
+pixel grid is already coherent.
+	Raycast            sphere tracing as in RayMarch (no over-relaxation, no brick map), the normal from SdfNormalTetra
+	FindClosestPoints  SdfMap at the point, then Newton steps onto the surface (-d / |gradient| along the normal, the
+	                   gradient at least SDF_QUERY_MIN_GRADIENT_LENGTH) until |d| is below minHitDistance, at most
+	                   SDF_QUERY_PROJECTION_STEPS times
+	Overlap            the sphere overlaps a surface when SdfMap at its center is below its radius
+A CSG program is not queried, the scene is the shapes as given. The BVH is built here unless the scene's own is
+passed, and without the GPU's BVH order the blend order differs from the shader by rounding only.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_QUERY_JOB_SIZE = 256; // queries per job, a multiple of SDF_SIMD_WIDTH
+constexpr int SDF_QUERY_PROJECTION_STEPS = 8;
+constexpr float SDF_QUERY_MIN_GRADIENT_LENGTH = 0.5f; // deep inside a blend the gradient vanishes, no step is longer than 2d
+
+
+struct SdfRayQuery
+{
+	Vec3 m_origin;
+	Vec3 m_direction = Vec3(1.f, 0.f, 0.f); // normalized
+	float m_maxDistance = SDF_INFINITY_DIST; // on top of the scene's maxTraceDistance
+};
+
+struct SdfRayQueryHit
+{
+	float m_distance = SDF_INFINITY_DIST; // along the ray, SDF_INFINITY_DIST on a miss
+	Vec3 m_position;
+	Vec3 m_normal;
+	int m_shapeIndex = -1; // scene index of the nearest shape
+
+	bool IsHit() const { return m_distance < SDF_INFINITY_DIST; }
+};
+
+struct SdfClosestPointResult
+{
+	float m_distance = SDF_INFINITY_DIST; // SdfMap at the query point, negative inside
+	Vec3 m_closestPoint;
+	Vec3 m_normal; // at the closest point
+	int m_shapeIndex = -1;
+};
+
+struct SdfOverlapQuery
+{
+	Vec3 m_center;
+	float m_radius = 0.f;
+};
+
+struct SdfOverlapResult
+{
+	float m_distance = SDF_INFINITY_DIST; // SdfMap at the center
+	bool m_isOverlapping = false;
+};
+
+
+struct SdfSceneQueryStats
+{
+	int m_numQueries = 0;
+	double m_milliseconds = 0.0;
+	int64_t m_numPacketMaps = 0; // SdfMap for a whole packet
+	int64_t m_numNodesVisited = 0;
+	int64_t m_numShapeEvaluations = 0; // one per shape per packet, SDF_SIMD_WIDTH lanes at a time
+	int64_t m_numRaySteps = 0;
+
+	void Add(SdfSceneQueryStats const& other);
+	double GetQueriesPerSecond() const;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfSceneQuery
+{
+public:
+	// constants: toleranceK, half precision geometry and the march limits; the BVH is always used
+	void SetScene(std::vector<SdfShape> const& shapes, SdfRayMarchingConstants const& constants, SdfBvh const* prebuiltBvh = nullptr);
+
+	int GetNumShapes() const { return (int)m_radius.size(); }
+	SdfCpuRayMarcher const& GetScene() const { return m_scene; } // the scalar reference
+
+	// out_*: resized to the query count, in query order
+	SdfSceneQueryStats Raycast(std::vector<SdfRayQuery> const& queries, std::vector<SdfRayQueryHit>& out_hits, JobPool* jobPool = nullptr) const;
+	SdfSceneQueryStats FindClosestPoints(std::vector<Vec3> const& points, std::vector<SdfClosestPointResult>& out_results, JobPool* jobPool = nullptr) const;
+	SdfSceneQueryStats Overlap(std::vector<SdfOverlapQuery> const& queries, std::vector<SdfOverlapResult>& out_results, JobPool* jobPool = nullptr) const;
+
+	// Scene index of the shape with the smallest distance at p, -1 without shapes
+	int FindNearestShape(Vec3 const& p) const;
+
+private:
+	// SdfMapBvh for every lane of laneMask, out_distances: SDF_SIMD_WIDTH floats
+	void MapPacket(float const* positionX, float const* positionY, float const* positionZ, SimdFloat const& laneMask, float* out_distances, SdfSceneQueryStats& stats) const;
+	// SdfNormalTetra for every lane of laneMask, out_gradientLengths: the length of the gradient it normalized
+	void NormalPacket(float const* positionX, float const* positionY, float const* positionZ, SimdFloat const& laneMask, Vec3* out_normals, SdfSceneQueryStats& stats,
+		float* out_gradientLengths = nullptr) const;
+
+	// Rays are packed in the order given, closest points and overlaps through queryIndices
+	void RaycastPacket(SdfRayQuery const* queries, int numQueries, SdfRayQueryHit* out_hits, SdfSceneQueryStats& stats) const;
+	void ClosestPointPacket(std::vector<Vec3> const& points, uint32_t const* queryIndices, int numQueries, std::vector<SdfClosestPointResult>& out_results,
+		SdfSceneQueryStats& stats) const;
+	void OverlapPacket(std::vector<SdfOverlapQuery> const& queries, uint32_t const* queryIndices, int numQueries, std::vector<SdfOverlapResult>& out_results,
+		SdfSceneQueryStats& stats) const;
+
+private:
+	SdfCpuRayMarcher m_scene;
+
+	// Geometry stream as SoA in leaf order, so one shape broadcasts against a packet
+	std::vector<float> m_centerX;
+	std::vector<float> m_centerY;
+	std::vector<float> m_centerZ;
+	std::vector<float> m_radius;
+};
@@ -0,0 +1,352 @@
+#include "Game/SdfShapeSimulation.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfSimd.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+static_assert(SDF_SIMULATION_CHUNK_SIZE % SDF_SIMD_WIDTH == 0, "a chunk must end on a full SIMD group");
+
+
+// Same as GameRayMarching's old per-sphere bounce: clamp into the box, and point the velocity back in when outside
+static void BounceScalar(float& position, float& velocity)
+{
+	if (position > ACTIVITY_BOX_RADIUS)
+	{
+		position = ACTIVITY_BOX_RADIUS;
+		velocity = -fabsf(velocity);
+	}
+	else if (position < -ACTIVITY_BOX_RADIUS)
+	{
+		position = -ACTIVITY_BOX_RADIUS;
+		velocity = fabsf(velocity);
+	}
+}
+
+// A chunk is a few hundred microseconds of work at most, not worth waking the pool for one
+static void RunChunkJobs(int numChunks, JobPool* jobPool, std::function<void(int chunkIndex)> const& job)
+{
+	if (jobPool && numChunks > 1)
+	{
+		jobPool->ParallelFor(numChunks, job);
+		return;
+	}
+	for (int chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
+	{
+		job(chunkIndex);
+	}
+}
+
+static void BounceSimd(SimdFloat& position, SimdFloat& velocity)
+{
+	SimdFloat wall = SimdSet1(ACTIVITY_BOX_RADIUS);
+	SimdFloat negativeWall = SimdSet1(-ACTIVITY_BOX_RADIUS);
+	SimdFloat speed = SimdAbs(velocity);
+	SimdFloat isOver = SimdGreater(position, wall);
+	SimdFloat isUnder = SimdLess(position, negativeWall);
+	velocity = SimdSelect(isOver, SimdSet1(0.f) - speed, SimdSelect(isUnder, speed, velocity));
+	position = SimdMin(SimdMax(position, negativeWall), wall);
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfShapeSimulation::Clear()
+{
+	m_positionX.clear();
+	m_positionY.clear();
+	m_positionZ.clear();
+	m_velocityX.clear();
+	m_velocityY.clear();
+	m_velocityZ.clear();
+	m_radius.clear();
+	m_materials.clear();
+}
+
+void SdfShapeSimulation::Reserve(int numShapes)
+{
+	m_positionX.reserve(numShapes);
+	m_positionY.reserve(numShapes);
+	m_positionZ.reserve(numShapes);
+	m_velocityX.reserve(numShapes);
+	m_velocityY.reserve(numShapes);
+	m_velocityZ.reserve(numShapes);
+	m_radius.reserve(numShapes);
+	m_materials.reserve(numShapes);
+}
+
+int SdfShapeSimulation::AddSphere(Vec3 const& position, Vec3 const& velocity, float radius, Rgba8 const& color /*= Rgba8::OPAQUE_WHITE*/, uint16_t materialID /*= 0*/)
+{
+	m_positionX.push_back(position.x);
+	m_positionY.push_back(position.y);
+	m_positionZ.push_back(position.z);
+	m_velocityX.push_back(velocity.x);
+	m_velocityY.push_back(velocity.y);
+	m_velocityZ.push_back(velocity.z);
+	m_radius.push_back(radius);
+
+	// Same packing as SdfShapeStreams::AddShape
+	SdfShapeMaterial material;
+	material.m_type = SdfShape::SDF_SPHERE;
+	material.m_materialID = materialID;
+	material.m_color = (uint32_t)color.r | ((uint32_t)color.g << 8) | ((uint32_t)color.b << 16) | ((uint32_t)color.a << 24);
+	m_materials.push_back(material);
+
+	return GetNumShapes() - 1;
+}
+
+SdfShape SdfShapeSimulation::GetShape(int shapeIndex) const
+{
+	uint32_t color = m_materials[shapeIndex].m_color;
+	Rgba8 rgba((unsigned char)(color & 0xFF), (unsigned char)((color >> 8) & 0xFF), (unsigned char)((color >> 16) & 0xFF), (unsigned char)(color >> 24));
+	return SdfShape::MakeSphere(GetPosition(shapeIndex), m_radius[shapeIndex], rgba, m_materials[shapeIndex].m_materialID);
+}
+
+void SdfShapeSimulation::GetShapes(std::vector<SdfShape>& out_shapes) const
+{
+	int numShapes = GetNumShapes();
+	out_shapes.resize(numShapes);
+	for (int i = 0; i < numShapes; ++i)
+	{
+		out_shapes[i] = GetShape(i);
+	}
+}
+
+float SdfShapeSimulation::Update(float deltaSeconds, JobPool* jobPool /*= nullptr*/, SdfShapeStreams* out_streams /*= nullptr*/, bool isHalfPrecision /*= false*/,
+	bool writeMaterials /*= true*/)
+{
+	int numShapes = GetNumShapes();
+	if (out_streams)
+	{
+		out_streams->m_geometry.resize(numShapes);
+		out_streams->m_geometryHalf.resize(isHalfPrecision ? numShapes : 0);
+		out_streams->m_shapeMaterials.resize(numShapes);
+	}
+
+	// Without collisions the streams are written in the same pass as the move
+	int numChunks = (numShapes + SDF_SIMULATION_CHUNK_SIZE - 1) / SDF_SIMULATION_CHUNK_SIZE;
+	m_chunkMaxSpeedSquared.assign(numChunks, 0.f);
+	SdfShapeStreams* moveStreams = m_isCollisionEnabled ? nullptr : out_streams;
+	RunChunkJobs(numChunks, jobPool, [&](int chunkIndex)
+	{
+		int beginIndex = chunkIndex * SDF_SIMULATION_CHUNK_SIZE;
+		int endIndex = std::min(beginIndex + SDF_SIMULATION_CHUNK_SIZE, numShapes);
+		UpdateRange(beginIndex, endIndex, deltaSeconds, moveStreams, isHalfPrecision, writeMaterials, m_chunkMaxSpeedSquared[chunkIndex]);
+	});
+
+	float maxSpeedSquared = 0.f;
+	for (float chunkMaxSpeedSquared : m_chunkMaxSpeedSquared)
+	{
+		maxSpeedSquared = std::max(maxSpeedSquared, chunkMaxSpeedSquared);
+	}
+	float maxMove = sqrtf(maxSpeedSquared) * deltaSeconds;
+
+	m_numContacts = 0;
+	if (!m_isCollisionEnabled)
+	{
+		m_grid.Clear();
+		return maxMove;
+	}
+
+	m_grid.Build(m_positionX.data(), m_positionY.data(), m_positionZ.data(), m_radius.data(), numShapes, 0.f, jobPool);
+	m_resolvedPositionX.resize(numShapes);
+	m_resolvedPositionY.resize(numShapes);
+	m_resolvedPositionZ.resize(numShapes);
+	m_resolvedVelocityX.resize(numShapes);
+	m_resolvedVelocityY.resize(numShapes);
+	m_resolvedVelocityZ.resize(numShapes);
+	m_chunkNumContacts.assign(numChunks, 0);
+	m_chunkMaxPush.assign(numChunks, 0.f);
+	RunChunkJobs(numChunks, jobPool, [&](int chunkIndex)
+	{
+		// In grid order: consecutive shapes share most of their cells
+		int beginSlot = chunkIndex * SDF_SIMULATION_CHUNK_SIZE;
+		int endSlot = std::min(beginSlot + SDF_SIMULATION_CHUNK_SIZE, numShapes);
+		ResolveCollisionRange(beginSlot, endSlot, m_chunkNumContacts[chunkIndex], m_chunkMaxPush[chunkIndex]);
+	});
+	m_positionX.swap(m_resolvedPositionX);
+	m_positionY.swap(m_resolvedPositionY);
+	m_positionZ.swap(m_resolvedPositionZ);
+	m_velocityX.swap(m_resolvedVelocityX);
+	m_velocityY.swap(m_resolvedVelocityY);
+	m_velocityZ.swap(m_resolvedVelocityZ);
+
+	float maxPush = 0.f;
+	for (int chunkIndex = 0; chunkIndex < numChunks; ++chunkIndex)
+	{
+		m_numContacts += m_chunkNumContacts[chunkIndex];
+		maxPush = std::max(maxPush, m_chunkMaxPush[chunkIndex]);
+	}
+
+	m_grid.Refit(m_positionX.data(), m_positionY.data(), m_positionZ.data(), m_radius.data(), jobPool);
+	if (out_streams)
+	{
+		RunChunkJobs(numChunks, jobPool, [&](int chunkIndex)
+		{
+			int beginIndex = chunkIndex * SDF_SIMULATION_CHUNK_SIZE;
+			int endIndex = std::min(beginIndex + SDF_SIMULATION_CHUNK_SIZE, numShapes);
+			WriteStreamsRange(beginIndex, endIndex, *out_streams, isHalfPrecision, writeMaterials);
+		});
+	}
+	return maxMove + maxPush;
+}
+
+void SdfShapeSimulation::UpdateRange(int beginIndex, int endIndex, float deltaSeconds, SdfShapeStreams* out_streams, bool isHalfPrecision, bool writeMaterials,
+	float& out_maxSpeedSquared)
+{
+	float* positions[3] = { m_positionX.data(), m_positionY.data(), m_positionZ.data() };
+	float* velocities[3] = { m_velocityX.data(), m_velocityY.data(), m_velocityZ.data() };
+
+	// Full SIMD groups, then the last few shapes of the last chunk one at a time with the same operations
+	SimdFloat delta = SimdSet1(deltaSeconds);
+	SimdFloat maxSpeedSquared = SimdSet1(0.f);
+	int i = beginIndex;
+	for (; i + SDF_SIMD_WIDTH <= endIndex; i += SDF_SIMD_WIDTH)
+	{
+		SimdFloat speedSquared = SimdSet1(0.f);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			SimdFloat position = SimdLoad(positions[axis] + i);
+			SimdFloat velocity = SimdLoad(velocities[axis] + i);
+			speedSquared = speedSquared + velocity * velocity;
+			position = position + delta * velocity;
+			BounceSimd(position, velocity);
+			SimdStore(positions[axis] + i, position);
+			SimdStore(velocities[axis] + i, velocity);
+		}
+		maxSpeedSquared = SimdMax(maxSpeedSquared, speedSquared);
+	}
+
+	float laneMaxSpeedSquared[SDF_SIMD_WIDTH];
+	SimdStore(laneMaxSpeedSquared, maxSpeedSquared);
+	out_maxSpeedSquared = 0.f;
+	for (float laneValue : laneMaxSpeedSquared)
+	{
+		out_maxSpeedSquared = std::max(out_maxSpeedSquared, laneValue);
+	}
+
+	for (; i < endIndex; ++i)
+	{
+		float speedSquared = 0.f;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			speedSquared += velocities[axis][i] * velocities[axis][i];
+			positions[axis][i] += deltaSeconds * velocities[axis][i];
+			BounceScalar(positions[axis][i], velocities[axis][i]);
+		}
+		out_maxSpeedSquared = std::max(out_maxSpeedSquared, speedSquared);
+	}
+
+	// Right after the move, while the chunk is still in cache
+	if (out_streams)
+	{
+		WriteStreamsRange(beginIndex, endIndex, *out_streams, isHalfPrecision, writeMaterials);
+	}
+}
+
+void SdfShapeSimulation::ResolveCollisionRange(int beginSlot, int endSlot, int& out_numContacts, float& out_maxPush)
+{
+	std::vector<uint32_t> const& shapeOrder = m_grid.GetShapeOrder();
+	std::vector<Vec4> const& sortedGeometry = m_grid.GetSortedGeometry();
+	out_numContacts = 0;
+	out_maxPush = 0.f;
+	for (int shapeSlot = beginSlot; shapeSlot < endSlot; ++shapeSlot)
+	{
+		int shapeIndex = (int)shapeOrder[shapeSlot];
+		Vec4 const& geometry = sortedGeometry[shapeSlot];
+		Vec3 position(geometry.x, geometry.y, geometry.z);
+		Vec3 velocity = GetVelocity(shapeIndex);
+		float radius = geometry.w;
+		float mass = radius * radius * radius;
+
+		Vec3 push;
+		Vec3 velocityChange;
+		m_grid.ForEachCandidate(position, radius, [&](uint32_t slot)
+		{
+			int otherIndex = (int)shapeOrder[slot];
+			Vec4 const& other = sortedGeometry[slot];
+			Vec3 offset = position - Vec3(other.x, other.y, other.z);
+			float contactDistance = radius + other.w;
+			float distanceSquared = offset.GetLengthSquared();
+			if (otherIndex == shapeIndex || distanceSquared >= contactDistance * contactDistance)
+			{
+				return;
+			}
+
+			// Same centers: apart along x, in opposite directions for the two of them
+			float distance = sqrtf(distanceSquared);
+			Vec3 normal = (distance > 0.f) ? offset / distance : Vec3((shapeIndex < otherIndex) ? 1.f : -1.f, 0.f, 0.f);
+			float otherMass = other.w * other.w * other.w;
+			float share = otherMass / (mass + otherMass); // of the overlap and of the momentum exchange
+
+			push += normal * ((contactDistance - distance) * share);
+			float approachSpeed = DotProduct3D(velocity - GetVelocity(otherIndex), normal);
+			if (approachSpeed < 0.f)
+			{
+				velocityChange -= normal * (2.f * share * approachSpeed);
+			}
+			++out_numContacts;
+		});
+
+		float resolved[2][3] = { { position.x + push.x, position.y + push.y, position.z + push.z },
+			{ velocity.x + velocityChange.x, velocity.y + velocityChange.y, velocity.z + velocityChange.z } };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			BounceScalar(resolved[0][axis], resolved[1][axis]);
+		}
+		m_resolvedPositionX[shapeIndex] = resolved[0][0];
+		m_resolvedPositionY[shapeIndex] = resolved[0][1];
+		m_resolvedPositionZ[shapeIndex] = resolved[0][2];
+		m_resolvedVelocityX[shapeIndex] = resolved[1][0];
+		m_resolvedVelocityY[shapeIndex] = resolved[1][1];
+		m_resolvedVelocityZ[shapeIndex] = resolved[1][2];
+		out_maxPush = std::max(out_maxPush, push.GetLength());
+	}
+}
+
+void SdfShapeSimulation::WriteStreamsRange(int beginIndex, int endIndex, SdfShapeStreams& out_streams, bool isHalfPrecision, bool writeMaterials) const
+{
+	SdfShapeGeometry* geometry = out_streams.m_geometry.data();
+	for (int shapeIndex = beginIndex; shapeIndex < endIndex; ++shapeIndex)
+	{
+		geometry[shapeIndex].m_data0 = Vec4(m_positionX[shapeIndex], m_positionY[shapeIndex], m_positionZ[shapeIndex], m_radius[shapeIndex]);
+	}
+	if (isHalfPrecision)
+	{
+		SdfShapeGeometryHalf* geometryHalf = out_streams.m_geometryHalf.data();
+		int shapeIndex = beginIndex;
+#if defined(SDF_SIMD_AVX2)
+		// AVX2 hardware has F16C, and its round to nearest even gives the same bits as FloatToHalf
+		for (; shapeIndex + SDF_SIMD_WIDTH <= endIndex; shapeIndex += SDF_SIMD_WIDTH)
+		{
+			uint16_t halves[4][SDF_SIMD_WIDTH];
+			float const* sources[4] = { m_positionX.data(), m_positionY.data(), m_positionZ.data(), m_radius.data() };
+			for (int component = 0; component < 4; ++component)
+			{
+				__m128i packed = _mm256_cvtps_ph(_mm256_loadu_ps(sources[component] + shapeIndex), _MM_FROUND_TO_NEAREST_INT);
+				_mm_storeu_si128((__m128i*)halves[component], packed);
+			}
+			for (int lane = 0; lane < SDF_SIMD_WIDTH; ++lane)
+			{
+				for (int component = 0; component < 4; ++component)
+				{
+					geometryHalf[shapeIndex + lane].m_data0[component] = halves[component][lane];
+				}
+			}
+		}
+#endif
+		for (; shapeIndex < endIndex; ++shapeIndex)
+		{
+			geometryHalf[shapeIndex].m_data0[0] = FloatToHalf(m_positionX[shapeIndex]);
+			geometryHalf[shapeIndex].m_data0[1] = FloatToHalf(m_positionY[shapeIndex]);
+			geometryHalf[shapeIndex].m_data0[2] = FloatToHalf(m_positionZ[shapeIndex]);
+			geometryHalf[shapeIndex].m_data0[3] = FloatToHalf(m_radius[shapeIndex]);
+		}
+	}
+	if (writeMaterials)
+	{
+		std::copy(m_materials.begin() + beginIndex, m_materials.begin() + endIndex, out_streams.m_shapeMaterials.begin() + beginIndex);
+	}
+}
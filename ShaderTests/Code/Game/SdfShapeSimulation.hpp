@@ -0,0 +1,85 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfSpatialGrid.hpp"
+#include "Engine/Core/Rgba8.hpp"
+#include "Engine/Math/Vec3.hpp"
+
+#include <vector>
+
+class JobPool;
+
+/*
+The moving spheres of GameRayMarching, stored as structure of arrays: one array per position / velocity axis and
+one for the radii, so a step streams exactly the floats it integrates, SDF_SIMD_WIDTH shapes at a time. Bouncing
+off the activity box is a clamp and a select instead of six branches per shape. The colors and material ids never
+change and are kept in their upload layout, SdfShapeMaterial.
+Update works in chunks of SDF_SIMULATION_CHUNK_SIZE shapes over a JobPool, and each chunk writes its slice of the
+shape streams right after moving it, while it is still in cache: no SdfShape copy in between.
+With collisions enabled the move is followed by a sphere-sphere pass, SdfSpatialGrid as its broadphase. Overlapping
+spheres are pushed apart and bounce elastically, masses going with the volume. Every shape resolves its own contacts
+from the state after the move (a Jacobi step), so no two jobs write the same shape and the result does not depend
+on the thread count. Deep overlaps may take a few frames to separate.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_SIMULATION_CHUNK_SIZE = 16384; // shapes per job, a multiple of SDF_SIMD_WIDTH
+
+
+class SdfShapeSimulation
+{
+public:
+	void Clear();
+	void Reserve(int numShapes);
+	int AddSphere(Vec3 const& position, Vec3 const& velocity, float radius, Rgba8 const& color = Rgba8::OPAQUE_WHITE, uint16_t materialID = 0);
+
+	int GetNumShapes() const { return (int)m_radius.size(); }
+	Vec3 GetPosition(int shapeIndex) const { return Vec3(m_positionX[shapeIndex], m_positionY[shapeIndex], m_positionZ[shapeIndex]); }
+	Vec3 GetVelocity(int shapeIndex) const { return Vec3(m_velocityX[shapeIndex], m_velocityY[shapeIndex], m_velocityZ[shapeIndex]); }
+	float GetRadius(int shapeIndex) const { return m_radius[shapeIndex]; }
+	SdfShape GetShape(int shapeIndex) const;
+	void GetShapes(std::vector<SdfShape>& out_shapes) const; // in shape index order, for the BVH and the CSG tree
+
+	// Moves every shape by deltaSeconds and bounces it off the activity box walls. Returns how far the fastest shape
+	// moved, bounces only flip the velocity. out_streams: rewritten in shape index order, the float16 geometry stream
+	// only when isHalfPrecision is set (it is left empty otherwise, only the selected stream is uploaded).
+	// writeMaterials: false when out_streams already holds these materials in shape index order, they only change
+	// with AddSphere and Clear
+	// With collisions the returned move also covers the push out of the overlaps.
+	float Update(float deltaSeconds, JobPool* jobPool = nullptr, SdfShapeStreams* out_streams = nullptr, bool isHalfPrecision = false, bool writeMaterials = true);
+
+	void SetCollisionEnabled(bool isEnabled) { m_isCollisionEnabled = isEnabled; }
+	bool IsCollisionEnabled() const { return m_isCollisionEnabled; }
+	int GetNumContacts() const { return m_numContacts; } // last Update, a pair counts once for each of its shapes
+	// The broadphase of the last Update with collisions, refit to the final positions: SdfSpatialGrid::SdfMap is the
+	// current field. Empty without collisions.
+	SdfSpatialGrid const& GetGrid() const { return m_grid; }
+
+private:
+	void UpdateRange(int beginIndex, int endIndex, float deltaSeconds, SdfShapeStreams* out_streams, bool isHalfPrecision, bool writeMaterials, float& out_maxSpeedSquared);
+	void ResolveCollisionRange(int beginSlot, int endSlot, int& out_numContacts, float& out_maxPush);
+	void WriteStreamsRange(int beginIndex, int endIndex, SdfShapeStreams& out_streams, bool isHalfPrecision, bool writeMaterials) const;
+
+private:
+	std::vector<float> m_positionX;
+	std::vector<float> m_positionY;
+	std::vector<float> m_positionZ;
+	std::vector<float> m_velocityX;
+	std::vector<float> m_velocityY;
+	std::vector<float> m_velocityZ;
+	std::vector<float> m_radius;
+	std::vector<SdfShapeMaterial> m_materials; // cold, copied to the streams as is
+
+	std::vector<float> m_chunkMaxSpeedSquared; // one per chunk of the last Update
+
+	bool m_isCollisionEnabled = false;
+	int m_numContacts = 0;
+	SdfSpatialGrid m_grid;
+	std::vector<float> m_resolvedPositionX; // the collision pass writes here, then the arrays are swapped
+	std::vector<float> m_resolvedPositionY;
+	std::vector<float> m_resolvedPositionZ;
+	std::vector<float> m_resolvedVelocityX;
+	std::vector<float> m_resolvedVelocityY;
+	std::vector<float> m_resolvedVelocityZ;
+	std::vector<int> m_chunkNumContacts;
+	std::vector<float> m_chunkMaxPush;
+};
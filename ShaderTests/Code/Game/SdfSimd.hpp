@@ -0,0 +1,119 @@
+#pragma once
+
+//-----------------------------------------------------------------------------------------------
+// Thin float SIMD wrapper for the CPU SDF kernels.
+// AVX2 (8 lanes) when the compiler targets it (/arch:AVX2, -mavx2), SSE2 (4 lanes) on any x64,
+// plain C++ (4 lanes) everywhere else. Masks are full-width lanes, like the _mm_cmp* results.
+//-----------------------------------------------------------------------------------------------
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SDF_SIMD_AVX2
+constexpr int SDF_SIMD_WIDTH = 8;
+#elif defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+#include <emmintrin.h>
+#define SDF_SIMD_SSE2
+constexpr int SDF_SIMD_WIDTH = 4;
+#else
+#include <cmath>
+#include <cstring>
+#define SDF_SIMD_SCALAR
+constexpr int SDF_SIMD_WIDTH = 4;
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+#if defined(SDF_SIMD_AVX2)
+
+struct SimdFloat
+{
+	__m256 m_v;
+};
+
+inline SimdFloat SimdSet1(float value)							{ return { _mm256_set1_ps(value) }; }
+inline SimdFloat SimdLoad(float const* data)					{ return { _mm256_loadu_ps(data) }; }
+inline void SimdStore(float* data, SimdFloat a)					{ _mm256_storeu_ps(data, a.m_v); }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b)			{ return { _mm256_add_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b)			{ return { _mm256_sub_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b)			{ return { _mm256_mul_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b)			{ return { _mm256_div_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b)				{ return { _mm256_min_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b)				{ return { _mm256_max_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdSqrt(SimdFloat a)							{ return { _mm256_sqrt_ps(a.m_v) }; }
+inline SimdFloat SimdAbs(SimdFloat a)							{ return { _mm256_andnot_ps(_mm256_set1_ps(-0.f), a.m_v) }; }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b)				{ return { _mm256_cmp_ps(a.m_v, b.m_v, _CMP_LT_OQ) }; }
+inline SimdFloat SimdGreater(SimdFloat a, SimdFloat b)			{ return { _mm256_cmp_ps(a.m_v, b.m_v, _CMP_GT_OQ) }; }
+inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b)				{ return { _mm256_and_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdOr(SimdFloat a, SimdFloat b)				{ return { _mm256_or_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdAndNot(SimdFloat mask, SimdFloat a)		{ return { _mm256_andnot_ps(mask.m_v, a.m_v) }; } // ~mask & a
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return { _mm256_blendv_ps(b.m_v, a.m_v, mask.m_v) }; } // mask ? a : b
+inline int SimdMoveMask(SimdFloat mask)							{ return _mm256_movemask_ps(mask.m_v); }
+
+#elif defined(SDF_SIMD_SSE2)
+
+struct SimdFloat
+{
+	__m128 m_v;
+};
+
+inline SimdFloat SimdSet1(float value)							{ return { _mm_set1_ps(value) }; }
+inline SimdFloat SimdLoad(float const* data)					{ return { _mm_loadu_ps(data) }; }
+inline void SimdStore(float* data, SimdFloat a)					{ _mm_storeu_ps(data, a.m_v); }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b)			{ return { _mm_add_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b)			{ return { _mm_sub_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b)			{ return { _mm_mul_ps(a.m_v, b.m_v) }; }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b)			{ return { _mm_div_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b)				{ return { _mm_min_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b)				{ return { _mm_max_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdSqrt(SimdFloat a)							{ return { _mm_sqrt_ps(a.m_v) }; }
+inline SimdFloat SimdAbs(SimdFloat a)							{ return { _mm_andnot_ps(_mm_set1_ps(-0.f), a.m_v) }; }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b)				{ return { _mm_cmplt_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdGreater(SimdFloat a, SimdFloat b)			{ return { _mm_cmpgt_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b)				{ return { _mm_and_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdOr(SimdFloat a, SimdFloat b)				{ return { _mm_or_ps(a.m_v, b.m_v) }; }
+inline SimdFloat SimdAndNot(SimdFloat mask, SimdFloat a)		{ return { _mm_andnot_ps(mask.m_v, a.m_v) }; } // ~mask & a
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { return { _mm_or_ps(_mm_and_ps(mask.m_v, a.m_v), _mm_andnot_ps(mask.m_v, b.m_v)) }; } // mask ? a : b
+inline int SimdMoveMask(SimdFloat mask)							{ return _mm_movemask_ps(mask.m_v); }
+
+#else
+
+struct SimdFloat
+{
+	float m_v[SDF_SIMD_WIDTH];
+};
+
+#define SDF_SIMD_LANEWISE(expr) SimdFloat r; for (int i = 0; i < SDF_SIMD_WIDTH; ++i) { r.m_v[i] = (expr); } return r
+
+inline float SimdMaskBits(bool isSet)							{ unsigned int bits = isSet ? 0xFFFFFFFFu : 0u; float f; memcpy(&f, &bits, sizeof(f)); return f; }
+inline unsigned int SimdLaneBits(float f)						{ unsigned int bits; memcpy(&bits, &f, sizeof(bits)); return bits; }
+inline SimdFloat SimdSet1(float value)							{ SDF_SIMD_LANEWISE(value); }
+inline SimdFloat SimdLoad(float const* data)					{ SDF_SIMD_LANEWISE(data[i]); }
+inline void SimdStore(float* data, SimdFloat a)					{ for (int i = 0; i < SDF_SIMD_WIDTH; ++i) { data[i] = a.m_v[i]; } }
+inline SimdFloat operator+(SimdFloat a, SimdFloat b)			{ SDF_SIMD_LANEWISE(a.m_v[i] + b.m_v[i]); }
+inline SimdFloat operator-(SimdFloat a, SimdFloat b)			{ SDF_SIMD_LANEWISE(a.m_v[i] - b.m_v[i]); }
+inline SimdFloat operator*(SimdFloat a, SimdFloat b)			{ SDF_SIMD_LANEWISE(a.m_v[i] * b.m_v[i]); }
+inline SimdFloat operator/(SimdFloat a, SimdFloat b)			{ SDF_SIMD_LANEWISE(a.m_v[i] / b.m_v[i]); }
+inline SimdFloat SimdMin(SimdFloat a, SimdFloat b)				{ SDF_SIMD_LANEWISE(a.m_v[i] < b.m_v[i] ? a.m_v[i] : b.m_v[i]); }
+inline SimdFloat SimdMax(SimdFloat a, SimdFloat b)				{ SDF_SIMD_LANEWISE(a.m_v[i] > b.m_v[i] ? a.m_v[i] : b.m_v[i]); }
+inline SimdFloat SimdSqrt(SimdFloat a)							{ SDF_SIMD_LANEWISE(sqrtf(a.m_v[i])); }
+inline SimdFloat SimdAbs(SimdFloat a)							{ SDF_SIMD_LANEWISE(fabsf(a.m_v[i])); }
+inline SimdFloat SimdLess(SimdFloat a, SimdFloat b)				{ SDF_SIMD_LANEWISE(SimdMaskBits(a.m_v[i] < b.m_v[i])); }
+inline SimdFloat SimdGreater(SimdFloat a, SimdFloat b)			{ SDF_SIMD_LANEWISE(SimdMaskBits(a.m_v[i] > b.m_v[i])); }
+inline SimdFloat SimdAnd(SimdFloat a, SimdFloat b)				{ SDF_SIMD_LANEWISE(SimdMaskBits((SimdLaneBits(a.m_v[i]) & SimdLaneBits(b.m_v[i])) != 0u)); }
+inline SimdFloat SimdOr(SimdFloat a, SimdFloat b)				{ SDF_SIMD_LANEWISE(SimdMaskBits((SimdLaneBits(a.m_v[i]) | SimdLaneBits(b.m_v[i])) != 0u)); }
+inline SimdFloat SimdAndNot(SimdFloat mask, SimdFloat a)		{ SDF_SIMD_LANEWISE(SimdLaneBits(mask.m_v[i]) ? 0.f : a.m_v[i]); }
+inline SimdFloat SimdSelect(SimdFloat mask, SimdFloat a, SimdFloat b) { SDF_SIMD_LANEWISE(SimdLaneBits(mask.m_v[i]) ? a.m_v[i] : b.m_v[i]); }
+inline int SimdMoveMask(SimdFloat mask)							{ int bits = 0; for (int i = 0; i < SDF_SIMD_WIDTH; ++i) { bits |= (SimdLaneBits(mask.m_v[i]) >> 31) << i; } return bits; }
+
+#undef SDF_SIMD_LANEWISE
+
+#endif
+
+
+//-----------------------------------------------------------------------------------------------
+// sminCubic from SdfRayMarching.hlsl, same operation order as SminCubic so lanes match the scalar path
+inline SimdFloat SimdSminCubic(SimdFloat a, SimdFloat b, float k)
+{
+	float k6 = k * 6.f;
+	SimdFloat h = SimdMax(SimdSet1(k6) - SimdAbs(a - b), SimdSet1(0.f)) / SimdSet1(k6);
+	return SimdMin(a, b) - h * h * h * SimdSet1(k6) * SimdSet1(1.f / 6.f);
+}
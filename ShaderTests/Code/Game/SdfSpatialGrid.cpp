@@ -0,0 +1,280 @@
+#include "Game/SdfSpatialGrid.hpp"
+#include "Game/JobPool.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr int GRID_BLOCK_SIZE = 16384; // slots or cells per job outside of the build slices
+
+
+static void RunGridJobs(int numItems, JobPool* jobPool, std::function<void(int itemIndex)> const& job)
+{
+	if (jobPool && numItems > 1)
+	{
+		jobPool->ParallelFor(numItems, job);
+		return;
+	}
+	for (int itemIndex = 0; itemIndex < numItems; ++itemIndex)
+	{
+		job(itemIndex);
+	}
+}
+
+static int GetNumBlocks(int numItems)
+{
+	return (numItems + GRID_BLOCK_SIZE - 1) / GRID_BLOCK_SIZE;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfSpatialGrid::Build(float const* positionX, float const* positionY, float const* positionZ, float const* radius, int numShapes, float minCellSize /*= 0.f*/,
+	JobPool* jobPool /*= nullptr*/)
+{
+	Clear();
+	if (numShapes <= 0)
+	{
+		return;
+	}
+
+	// Bounds of the centers and the largest radius, per slice then reduced in slice order
+	int sliceSize = (numShapes + SDF_GRID_BUILD_SLICES - 1) / SDF_GRID_BUILD_SLICES;
+	float sliceMins[SDF_GRID_BUILD_SLICES][3];
+	float sliceMaxs[SDF_GRID_BUILD_SLICES][3];
+	float sliceMaxRadius[SDF_GRID_BUILD_SLICES];
+	RunGridJobs(SDF_GRID_BUILD_SLICES, jobPool, [&](int slice)
+	{
+		float const* positions[3] = { positionX, positionY, positionZ };
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			sliceMins[slice][axis] = FLT_MAX;
+			sliceMaxs[slice][axis] = -FLT_MAX;
+		}
+		sliceMaxRadius[slice] = 0.f;
+		int endIndex = std::min((slice + 1) * sliceSize, numShapes);
+		for (int shapeIndex = slice * sliceSize; shapeIndex < endIndex; ++shapeIndex)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				sliceMins[slice][axis] = std::min(sliceMins[slice][axis], positions[axis][shapeIndex]);
+				sliceMaxs[slice][axis] = std::max(sliceMaxs[slice][axis], positions[axis][shapeIndex]);
+			}
+			sliceMaxRadius[slice] = std::max(sliceMaxRadius[slice], radius[shapeIndex]);
+		}
+	});
+
+	float boundsMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+	float boundsMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+	for (int slice = 0; slice < SDF_GRID_BUILD_SLICES; ++slice)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			boundsMin[axis] = std::min(boundsMin[axis], sliceMins[slice][axis]);
+			boundsMax[axis] = std::max(boundsMax[axis], sliceMaxs[slice][axis]);
+		}
+		m_maxRadius = std::max(m_maxRadius, sliceMaxRadius[slice]);
+	}
+
+	// Cells at least minCellSize wide, grown until there are few enough of them
+	m_cellSize = (minCellSize > 0.f) ? minCellSize : 2.f * m_maxRadius;
+	float largestExtent = std::max(std::max(boundsMax[0] - boundsMin[0], boundsMax[1] - boundsMin[1]), boundsMax[2] - boundsMin[2]);
+	m_cellSize = std::max(m_cellSize, largestExtent * 1e-4f + 1e-6f);
+	int maxCells = std::min(numShapes, SDF_GRID_MAX_CELLS);
+	for (;;)
+	{
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			m_dimensions[axis] = (int)floorf((boundsMax[axis] - boundsMin[axis]) / m_cellSize) + 1;
+		}
+		if ((int64_t)m_dimensions[0] * m_dimensions[1] * m_dimensions[2] <= maxCells)
+		{
+			break;
+		}
+		m_cellSize *= 1.25f;
+	}
+	m_inverseCellSize = 1.f / m_cellSize;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		m_origin[axis] = boundsMin[axis];
+	}
+
+	// Counting sort: cell of every shape and per-slice cell counts
+	int numCells = GetNumCells();
+	m_shapeCells.resize(numShapes);
+	m_sliceCellCounts.resize((size_t)SDF_GRID_BUILD_SLICES * numCells);
+	RunGridJobs(SDF_GRID_BUILD_SLICES, jobPool, [&](int slice)
+	{
+		uint32_t* counts = m_sliceCellCounts.data() + (size_t)slice * numCells;
+		std::fill(counts, counts + numCells, 0u);
+		int endIndex = std::min((slice + 1) * sliceSize, numShapes);
+		for (int shapeIndex = slice * sliceSize; shapeIndex < endIndex; ++shapeIndex)
+		{
+			int cell = (GetCellCoord(positionZ[shapeIndex], 2) * m_dimensions[1] + GetCellCoord(positionY[shapeIndex], 1)) * m_dimensions[0] + GetCellCoord(positionX[shapeIndex], 0);
+			m_shapeCells[shapeIndex] = (uint32_t)cell;
+			++counts[cell];
+		}
+	});
+
+	// Cell sizes, then their starts, then where each slice's shapes of a cell go: slices in order inside of a cell
+	m_cellStarts.resize(numCells + 1);
+	RunGridJobs(GetNumBlocks(numCells), jobPool, [&](int block)
+	{
+		int endCell = std::min((block + 1) * GRID_BLOCK_SIZE, numCells);
+		for (int cell = block * GRID_BLOCK_SIZE; cell < endCell; ++cell)
+		{
+			uint32_t cellSize = 0;
+			for (int slice = 0; slice < SDF_GRID_BUILD_SLICES; ++slice)
+			{
+				cellSize += m_sliceCellCounts[(size_t)slice * numCells + cell];
+			}
+			m_cellStarts[cell] = cellSize;
+		}
+	});
+	uint32_t start = 0;
+	for (int cell = 0; cell < numCells; ++cell)
+	{
+		uint32_t cellSize = m_cellStarts[cell];
+		m_cellStarts[cell] = start;
+		start += cellSize;
+	}
+	m_cellStarts[numCells] = start;
+	RunGridJobs(GetNumBlocks(numCells), jobPool, [&](int block)
+	{
+		int endCell = std::min((block + 1) * GRID_BLOCK_SIZE, numCells);
+		for (int cell = block * GRID_BLOCK_SIZE; cell < endCell; ++cell)
+		{
+			uint32_t offset = m_cellStarts[cell];
+			for (int slice = 0; slice < SDF_GRID_BUILD_SLICES; ++slice)
+			{
+				uint32_t& count = m_sliceCellCounts[(size_t)slice * numCells + cell];
+				uint32_t sliceCount = count;
+				count = offset;
+				offset += sliceCount;
+			}
+		}
+	});
+
+	m_shapeOrder.resize(numShapes);
+	RunGridJobs(SDF_GRID_BUILD_SLICES, jobPool, [&](int slice)
+	{
+		uint32_t* offsets = m_sliceCellCounts.data() + (size_t)slice * numCells;
+		int endIndex = std::min((slice + 1) * sliceSize, numShapes);
+		for (int shapeIndex = slice * sliceSize; shapeIndex < endIndex; ++shapeIndex)
+		{
+			m_shapeOrder[offsets[m_shapeCells[shapeIndex]]++] = (uint32_t)shapeIndex;
+		}
+	});
+
+	m_sortedGeometry.resize(numShapes);
+	m_buildCenters.resize(numShapes);
+	RunGridJobs(GetNumBlocks(numShapes), jobPool, [&](int block)
+	{
+		int endSlot = std::min((block + 1) * GRID_BLOCK_SIZE, numShapes);
+		for (int slot = block * GRID_BLOCK_SIZE; slot < endSlot; ++slot)
+		{
+			uint32_t shapeIndex = m_shapeOrder[slot];
+			m_buildCenters[slot] = Vec3(positionX[shapeIndex], positionY[shapeIndex], positionZ[shapeIndex]);
+			m_sortedGeometry[slot] = Vec4(positionX[shapeIndex], positionY[shapeIndex], positionZ[shapeIndex], radius[shapeIndex]);
+		}
+	});
+}
+
+void SdfSpatialGrid::Refit(float const* positionX, float const* positionY, float const* positionZ, float const* radius, JobPool* jobPool /*= nullptr*/)
+{
+	int numShapes = GetNumShapes();
+	int numBlocks = GetNumBlocks(numShapes);
+	std::vector<float> blockMaxRadius(numBlocks, 0.f);
+	std::vector<float> blockMaxDrift(numBlocks, 0.f);
+	RunGridJobs(numBlocks, jobPool, [&](int block)
+	{
+		float maxDriftSquared = 0.f;
+		int endSlot = std::min((block + 1) * GRID_BLOCK_SIZE, numShapes);
+		for (int slot = block * GRID_BLOCK_SIZE; slot < endSlot; ++slot)
+		{
+			uint32_t shapeIndex = m_shapeOrder[slot];
+			Vec3 center(positionX[shapeIndex], positionY[shapeIndex], positionZ[shapeIndex]);
+			m_sortedGeometry[slot] = Vec4(center.x, center.y, center.z, radius[shapeIndex]);
+			maxDriftSquared = std::max(maxDriftSquared, (center - m_buildCenters[slot]).GetLengthSquared());
+			blockMaxRadius[block] = std::max(blockMaxRadius[block], radius[shapeIndex]);
+		}
+		blockMaxDrift[block] = sqrtf(maxDriftSquared);
+	});
+
+	m_maxRadius = 0.f;
+	m_maxDrift = 0.f;
+	for (int block = 0; block < numBlocks; ++block)
+	{
+		m_maxRadius = std::max(m_maxRadius, blockMaxRadius[block]);
+		m_maxDrift = std::max(m_maxDrift, blockMaxDrift[block]);
+	}
+}
+
+void SdfSpatialGrid::Clear()
+{
+	m_dimensions[0] = m_dimensions[1] = m_dimensions[2] = 0;
+	m_maxRadius = 0.f;
+	m_maxDrift = 0.f;
+	m_cellStarts.clear();
+	m_shapeOrder.clear();
+	m_sortedGeometry.clear();
+	m_buildCenters.clear();
+}
+
+float SdfSpatialGrid::SdfMap(Vec3 const& p, float toleranceK, int* out_numShapesVisited /*= nullptr*/) const
+{
+	// A shape at d >= res + 6k leaves the smin at res, and every shape left outside of the search radius is further than it
+	float influenceRadius = toleranceK * 6.f;
+	float searchRadius = m_cellSize;
+	float res = SDF_INFINITY_DIST;
+	int numShapesVisited = 0;
+	while (!m_shapeOrder.empty())
+	{
+		res = SDF_INFINITY_DIST;
+		ForEachCandidate(p, searchRadius, [&](uint32_t slot)
+		{
+			++numShapesVisited;
+			float distance = SdfValueFromGeometry(p, m_sortedGeometry[slot]);
+			if (distance < res + influenceRadius)
+			{
+				res = SminCubic(res, distance, toleranceK);
+			}
+		});
+
+		if (res + influenceRadius <= searchRadius || IsEveryCellWithin(p, searchRadius + m_maxRadius + m_maxDrift))
+		{
+			break;
+		}
+		// More shapes only lower res, so the next pass is the last one when res was found
+		searchRadius = (res < SDF_INFINITY_DIST) ? res + influenceRadius : 2.f * searchRadius;
+	}
+
+	if (out_numShapesVisited)
+	{
+		*out_numShapesVisited += numShapesVisited;
+	}
+	return res;
+}
+
+int SdfSpatialGrid::GetCellCoord(float position, int axis) const
+{
+	// Clamped as a float first, a query far outside of the grid would overflow the int
+	float coord = floorf((position - m_origin[axis]) * m_inverseCellSize);
+	return (int)std::clamp(coord, 0.f, (float)(m_dimensions[axis] - 1));
+}
+
+bool SdfSpatialGrid::IsEveryCellWithin(Vec3 const& p, float reach) const
+{
+	float position[3] = { p.x, p.y, p.z };
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		float gridMax = m_origin[axis] + (float)m_dimensions[axis] * m_cellSize;
+		if (position[axis] - reach > m_origin[axis] || position[axis] + reach < gridMax)
+		{
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include "Engine/Math/Vec3.hpp"
+#include "Engine/Math/Vec4.hpp"
+
+#include <cstdint>
+#include <vector>
+
+class JobPool;
+
+/*
+Uniform grid over the SDF spheres, rebuilt every frame: the broadphase of SdfShapeSimulation's sphere collisions,
+and a second acceleration structure for SDF queries next to SdfBvh.
+Every sphere goes into the one cell holding its center, so a cell is a contiguous range of the shapes sorted by
+cell (a counting sort). A sphere of radius r can only come within distance q of p when its center is within
+q + r of p, so a query walks the cells overlapped by p +- (q + max radius + max drift).
+The build splits the shapes into SDF_GRID_BUILD_SLICES slices whatever the thread count, and the slices scatter in
+order, so the shape order, and everything read from the grid in it, does not depend on the JobPool.
+Refit keeps the cells and only moves the geometry; the shapes may then be up to the max drift out of their cell.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_GRID_BUILD_SLICES = 8;
+constexpr int SDF_GRID_MAX_CELLS = 1 << 18; // the cell size grows past the requested one to stay below it, and below the shape count
+
+
+class SdfSpatialGrid
+{
+public:
+	// positions and radii in shape index order; minCellSize <= 0 picks twice the largest radius,
+	// the smallest cell that still only needs the 27 cells around a sphere for its contacts
+	void Build(float const* positionX, float const* positionY, float const* positionZ, float const* radius, int numShapes, float minCellSize = 0.f,
+		JobPool* jobPool = nullptr);
+	// Same shapes, same cells, new geometry
+	void Refit(float const* positionX, float const* positionY, float const* positionZ, float const* radius, JobPool* jobPool = nullptr);
+	void Clear();
+
+	int GetNumShapes() const { return (int)m_shapeOrder.size(); }
+	int GetNumCells() const { return m_dimensions[0] * m_dimensions[1] * m_dimensions[2]; }
+	float GetCellSize() const { return m_cellSize; }
+	float GetMaxRadius() const { return m_maxRadius; }
+	float GetMaxDrift() const { return m_maxDrift; }
+
+	// Slot i holds shape m_shapeOrder[i], its center.xyz + radius is GetSortedGeometry()[i]
+	std::vector<uint32_t> const& GetShapeOrder() const { return m_shapeOrder; }
+	std::vector<Vec4> const& GetSortedGeometry() const { return m_sortedGeometry; }
+
+	// Calls visitSlot(slot) for every shape whose sphere may come within queryRadius of p, a superset,
+	// in increasing slot order
+	template<typename T_VisitSlot>
+	void ForEachCandidate(Vec3 const& p, float queryRadius, T_VisitSlot const& visitSlot) const;
+
+	// smin of every shape, like SdfMap over the shapes in slot order: each pass gathers the shapes within a search
+	// radius, and a pass is only final when the result plus the blend width (6k) is inside it
+	float SdfMap(Vec3 const& p, float toleranceK, int* out_numShapesVisited = nullptr) const;
+
+private:
+	int GetCellCoord(float position, int axis) const;
+	bool IsEveryCellWithin(Vec3 const& p, float reach) const;
+
+private:
+	float m_origin[3] = { 0.f, 0.f, 0.f }; // min corner of cell 0
+	float m_cellSize = 1.f;
+	float m_inverseCellSize = 1.f;
+	int m_dimensions[3] = { 0, 0, 0 };
+	float m_maxRadius = 0.f;
+	float m_maxDrift = 0.f; // since the last Build, 0 right after it
+
+	std::vector<uint32_t> m_cellStarts; // per cell, plus the end of the last one
+	std::vector<uint32_t> m_shapeOrder;
+	std::vector<Vec4> m_sortedGeometry;
+	std::vector<Vec3> m_buildCenters; // slot order, the centers the cells were assigned from
+
+	// Build scratch
+	std::vector<uint32_t> m_shapeCells;
+	std::vector<uint32_t> m_sliceCellCounts; // SDF_GRID_BUILD_SLICES x cells, then the slices' scatter offsets
+};
+
+
+//-----------------------------------------------------------------------------------------------
+template<typename T_VisitSlot>
+void SdfSpatialGrid::ForEachCandidate(Vec3 const& p, float queryRadius, T_VisitSlot const& visitSlot) const
+{
+	if (m_shapeOrder.empty())
+	{
+		return;
+	}
+
+	float reach = queryRadius + m_maxRadius + m_maxDrift;
+	int minCell[3] = { GetCellCoord(p.x - reach, 0), GetCellCoord(p.y - reach, 1), GetCellCoord(p.z - reach, 2) };
+	int maxCell[3] = { GetCellCoord(p.x + reach, 0), GetCellCoord(p.y + reach, 1), GetCellCoord(p.z + reach, 2) };
+	for (int z = minCell[2]; z <= maxCell[2]; ++z)
+	{
+		for (int y = minCell[1]; y <= maxCell[1]; ++y)
+		{
+			// A row of cells is one contiguous slot range
+			int rowCell = (z * m_dimensions[1] + y) * m_dimensions[0];
+			uint32_t beginSlot = m_cellStarts[rowCell + minCell[0]];
+			uint32_t endSlot = m_cellStarts[rowCell + maxCell[0] + 1];
+			for (uint32_t slot = beginSlot; slot < endSlot; ++slot)
+			{
+				visitSlot(slot);
+			}
+		}
+	}
+}
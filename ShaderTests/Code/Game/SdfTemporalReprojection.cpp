@@ -0,0 +1,153 @@
+#include "Game/SdfTemporalReprojection.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfTemporalReprojection::Build(SdfTemporalHistory const& history, SdfCpuView const& view, IntVec2 const& dimensions)
+{
+	m_dimensions = dimensions;
+	m_splatDistances.assign((size_t)dimensions.x * dimensions.y, SDF_INFINITY_DIST);
+	m_maxShapeMove = history.m_maxShapeMove;
+	if (history.m_dimensions != dimensions || history.m_depths.size() != (size_t)dimensions.x * dimensions.y)
+	{
+		return;
+	}
+
+	// Same as TemporalScatterPass in SdfRayMarching.hlsl
+	float tanHalfFovY = TanDegrees(0.5f * view.m_fovDegrees);
+	float tanHalfFovX = tanHalfFovY * view.m_aspect;
+	for (int y = 0; y < dimensions.y; ++y)
+	{
+		for (int x = 0; x < dimensions.x; ++x)
+		{
+			float depth = history.m_depths[y * dimensions.x + x];
+			if (depth >= 1.f)
+			{
+				continue; // missed, or hit past the far plane
+			}
+
+			Vec3 previousDir = history.m_view.GetRayDirection(x, y, dimensions);
+			float viewZ = history.m_view.GetViewZ(depth);
+			Vec3 hitPos = history.m_view.m_position + previousDir * (viewZ / DotProduct3D(previousDir, history.m_view.m_forward));
+
+			Vec3 toHit = hitPos - view.m_position;
+			float z = DotProduct3D(toHit, view.m_forward);
+			if (z <= 0.f)
+			{
+				continue; // behind the new camera
+			}
+			float ndcX = -DotProduct3D(toHit, view.m_left) / (z * tanHalfFovX);
+			float ndcY = DotProduct3D(toHit, view.m_up) / (z * tanHalfFovY);
+			float pixelX = (ndcX + 1.f) * 0.5f * (float)dimensions.x;
+			float pixelY = (1.f - ndcY) * 0.5f * (float)dimensions.y;
+			if (pixelX < 0.f || pixelY < 0.f || pixelX >= (float)dimensions.x || pixelY >= (float)dimensions.y)
+			{
+				continue;
+			}
+
+			int splatX = (int)pixelX;
+			int splatY = (int)pixelY;
+			int radius = GetSplatRadius(z, m_maxShapeMove, tanHalfFovY, dimensions.y);
+			float distance = toHit.GetLength();
+			for (int neighborY = std::max(splatY - radius, 0); neighborY <= std::min(splatY + radius, dimensions.y - 1); ++neighborY)
+			{
+				for (int neighborX = std::max(splatX - radius, 0); neighborX <= std::min(splatX + radius, dimensions.x - 1); ++neighborX)
+				{
+					float& splatDistance = m_splatDistances[neighborY * dimensions.x + neighborX];
+					splatDistance = std::min(splatDistance, distance);
+				}
+			}
+		}
+	}
+}
+
+float SdfTemporalReprojection::GetHintDistance(IntVec2 const& pixelCoords) const
+{
+	if (m_splatDistances.empty())
+	{
+		return 0.f;
+	}
+
+	float splatDistance = m_splatDistances[pixelCoords.y * m_dimensions.x + pixelCoords.x];
+	if (splatDistance >= SDF_INFINITY_DIST)
+	{
+		return 0.f;
+	}
+	return GetStartFromSplat(splatDistance, m_maxShapeMove);
+}
+
+int SdfTemporalReprojection::GetNumPixelsWithHint() const
+{
+	return (int)std::count_if(m_splatDistances.begin(), m_splatDistances.end(), [](float splatDistance) { return splatDistance < SDF_INFINITY_DIST; });
+}
+
+int SdfTemporalReprojection::GetSplatRadius(float viewZ, float maxShapeMove, float tanHalfFovY, int screenHeight)
+{
+	// A move seen head-on from its nearest depth, in pixels of height 2 * tan / screenHeight at unit distance
+	float nearestZ = std::max(viewZ - maxShapeMove, 1e-3f);
+	float movePixels = maxShapeMove * (float)screenHeight / (2.f * tanHalfFovY * nearestZ);
+	return std::min(SDF_TEMPORAL_DILATION + (int)ceilf(movePixels), SDF_TEMPORAL_MAX_DILATION);
+}
+
+float SdfTemporalReprojection::GetStartFromSplat(float splatDistance, float maxShapeMove)
+{
+	float start = splatDistance * (1.f - SDF_TEMPORAL_DEPTH_SLACK) - maxShapeMove;
+	return (start > 0.f) ? start : 0.f;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+bool WriteSdfCameraPath(std::string const& filePath, std::vector<SdfCameraPathFrame> const& frames)
+{
+	FILE* file = fopen(filePath.c_str(), "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	fprintf(file, "# deltaSeconds position.xyz forward.xyz left.xyz up.xyz\n");
+	for (SdfCameraPathFrame const& frame : frames)
+	{
+		SdfCpuView const& view = frame.m_view;
+		fprintf(file, "%.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f %.6f\n", frame.m_deltaSeconds,
+			view.m_position.x, view.m_position.y, view.m_position.z, view.m_forward.x, view.m_forward.y, view.m_forward.z,
+			view.m_left.x, view.m_left.y, view.m_left.z, view.m_up.x, view.m_up.y, view.m_up.z);
+	}
+	fclose(file);
+	return true;
+}
+
+bool ReadSdfCameraPath(std::string const& filePath, std::vector<SdfCameraPathFrame>& out_frames)
+{
+	FILE* file = fopen(filePath.c_str(), "r");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	out_frames.clear();
+	char line[512];
+	while (fgets(line, sizeof(line), file))
+	{
+		if (line[0] == '#')
+		{
+			continue;
+		}
+
+		SdfCameraPathFrame frame;
+		SdfCpuView& view = frame.m_view;
+		int numRead = sscanf(line, "%f %f %f %f %f %f %f %f %f %f %f %f %f", &frame.m_deltaSeconds,
+			&view.m_position.x, &view.m_position.y, &view.m_position.z, &view.m_forward.x, &view.m_forward.y, &view.m_forward.z,
+			&view.m_left.x, &view.m_left.y, &view.m_left.z, &view.m_up.x, &view.m_up.y, &view.m_up.z);
+		if (numRead == 13)
+		{
+			out_frames.push_back(frame);
+		}
+	}
+	fclose(file);
+	return !out_frames.empty();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/IntVec2.hpp"
+
+#include <string>
+#include <vector>
+
+/*
+Start distances from the previous frame, run on the CPU reference and as two pre-pass dispatches on the GPU.
+Every hit pixel of last frame's depth is lifted back to its world point with last frame's view and scattered
+into the pixels of the new view, keeping the nearest distance per pixel. Each point also lands in the
+neighbouring pixels (SDF_TEMPORAL_DILATION) so parallax holes between splats do not leave a far hint, and
+further out by the screen size of the frame's largest shape move at its depth, up to SDF_TEMPORAL_MAX_DILATION:
+the leading edge of a moving shape covers pixels that only saw the background last frame.
+
+A ray starts before that distance by the largest shape move of the frame (the field is 1-Lipschitz in the
+shape positions, so no surface moved further) plus SDF_TEMPORAL_DEPTH_SLACK of the distance for depth
+precision and sub-pixel parallax. Pixels with no splat (disocclusions, sky, first frame) keep the safe start,
+and a disoccluded pixel next to its old occluder only gets the occluder's nearer distance.
+ValidateTemporalStart checks the hint: a start within minHitDistance of a surface means something came
+in front, and the ray falls back to the safe start.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr float SDF_TEMPORAL_DEPTH_SLACK = 0.005f; // SDF_TEMPORAL_DEPTH_SLACK in SdfRayMarching.hlsl
+constexpr int SDF_TEMPORAL_DILATION = 1; // SDF_TEMPORAL_DILATION in SdfRayMarching.hlsl, in pixels
+constexpr int SDF_TEMPORAL_MAX_DILATION = 4; // SDF_TEMPORAL_MAX_DILATION in SdfRayMarching.hlsl, in pixels
+
+
+// What is kept of the last frame
+struct SdfTemporalHistory
+{
+	SdfCpuView m_view;
+	IntVec2 m_dimensions;
+	std::vector<float> m_depths; // SdfCpuImage::m_depths
+	float m_maxShapeMove = 0.f; // largest shape move since, max speed * delta seconds
+};
+
+
+// A recorded camera: one frame per line, "deltaSeconds position forward left up" (13 floats)
+struct SdfCameraPathFrame
+{
+	float m_deltaSeconds = 0.f;
+	SdfCpuView m_view; // only the position and the basis are stored
+};
+
+bool WriteSdfCameraPath(std::string const& filePath, std::vector<SdfCameraPathFrame> const& frames);
+bool ReadSdfCameraPath(std::string const& filePath, std::vector<SdfCameraPathFrame>& out_frames);
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfTemporalReprojection
+{
+public:
+	// Empty hints when the history does not match the new frame size
+	void Build(SdfTemporalHistory const& history, SdfCpuView const& view, IntVec2 const& dimensions);
+
+	// Start for the pixel's ray, 0 when its block got no splat
+	float GetHintDistance(IntVec2 const& pixelCoords) const;
+	int GetNumPixelsWithHint() const;
+
+	// Hint distance minus the margin, never negative
+	static float GetStartFromSplat(float splatDistance, float maxShapeMove);
+	// Pixels a splat at viewZ reaches, so the shapes' moves are covered
+	static int GetSplatRadius(float viewZ, float maxShapeMove, float tanHalfFovY, int screenHeight);
+
+private:
+	IntVec2 m_dimensions;
+	std::vector<float> m_splatDistances; // nearest splat per pixel, SDF_INFINITY_DIST when none
+	float m_maxShapeMove = 0.f;
+};
@@ -0,0 +1,247 @@
+#include "Game/SdfTileBinning.hpp"
+#include "Engine/Math/MathUtils.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+
+//-----------------------------------------------------------------------------------------------
+static constexpr float HALF_PI = 1.57079632679f;
+static constexpr float UNBOUNDED_NDC = 1e30f;
+
+
+// Range of one ndc axis covered by the rays that can hit a circle, in the plane of that axis and the view forward.
+// lateral / depth: circle center along the axis / along forward. False when every ray of the view misses.
+static bool GetCircleNdcRange(float lateral, float depth, float radius, float tanHalfFov, float& out_min, float& out_max)
+{
+	float distSquared = lateral * lateral + depth * depth;
+	if (distSquared <= radius * radius)
+	{
+		// Camera inside the sphere
+		out_min = -UNBOUNDED_NDC;
+		out_max = UNBOUNDED_NDC;
+		return true;
+	}
+
+	// Every view ray points forward, at an angle in (-90, 90) degrees from it
+	float centerAngle = atan2f(lateral, depth);
+	float halfAngle = asinf(radius / sqrtf(distSquared));
+	float minAngle = centerAngle - halfAngle;
+	float maxAngle = centerAngle + halfAngle;
+	if (minAngle >= HALF_PI || maxAngle <= -HALF_PI)
+	{
+		return false;
+	}
+
+	out_min = (minAngle <= -HALF_PI) ? -UNBOUNDED_NDC : tanf(minAngle) / tanHalfFov;
+	out_max = (maxAngle >= HALF_PI) ? UNBOUNDED_NDC : tanf(maxAngle) / tanHalfFov;
+	return true;
+}
+
+static bool DoesRayHitSphere(Vec3 const& rayStart, Vec3 const& rayFwdNormal, Vec3 const& center, float radius)
+{
+	Vec3 toCenter = center - rayStart;
+	float t = DotProduct3D(toCenter, rayFwdNormal);
+	Vec3 closestOffset = (t > 0.f) ? toCenter - rayFwdNormal * t : toCenter;
+	return closestOffset.GetLengthSquared() <= radius * radius;
+}
+
+
+//-----------------------------------------------------------------------------------------------
+void SdfTileBinning::Build(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, float toleranceK)
+{
+	Resize(dimensions);
+
+	int numShapes = streams.GetNumShapes();
+	m_tileRectScratch.resize(2 * (size_t)numShapes);
+
+	// Count
+	for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+	{
+		Vec4 geometry = streams.GetGeometry(shapeIndex, isHalfPrecision);
+		IntVec2& tileMin = m_tileRectScratch[2 * shapeIndex];
+		IntVec2& tileMax = m_tileRectScratch[2 * shapeIndex + 1];
+
+		IntVec2 pixelMin;
+		IntVec2 pixelMax;
+		if (!GetSpherePixelRect(view, dimensions, Vec3(geometry.x, geometry.y, geometry.z), GetInflatedRadius(geometry.w, toleranceK), pixelMin, pixelMax))
+		{
+			tileMin = IntVec2(0, 0);
+			tileMax = IntVec2(-1, -1);
+			continue;
+		}
+
+		tileMin = IntVec2(pixelMin.x / SDF_TILE_SIZE, pixelMin.y / SDF_TILE_SIZE);
+		tileMax = IntVec2(pixelMax.x / SDF_TILE_SIZE, pixelMax.y / SDF_TILE_SIZE);
+		for (int tileY = tileMin.y; tileY <= tileMax.y; ++tileY)
+		{
+			for (int tileX = tileMin.x; tileX <= tileMax.x; ++tileX)
+			{
+				++m_tileRanges[tileY * m_numTiles.x + tileX].m_count;
+			}
+		}
+	}
+
+	// Prefix sum
+	uint32_t numIndices = 0;
+	for (SdfTileRange& range : m_tileRanges)
+	{
+		range.m_offset = numIndices;
+		numIndices += range.m_count;
+		range.m_count = 0;
+	}
+	m_shapeIndices.resize(numIndices);
+
+	// Fill, shapes in ascending order
+	for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+	{
+		IntVec2 const& tileMin = m_tileRectScratch[2 * shapeIndex];
+		IntVec2 const& tileMax = m_tileRectScratch[2 * shapeIndex + 1];
+		for (int tileY = tileMin.y; tileY <= tileMax.y; ++tileY)
+		{
+			for (int tileX = tileMin.x; tileX <= tileMax.x; ++tileX)
+			{
+				SdfTileRange& range = m_tileRanges[tileY * m_numTiles.x + tileX];
+				m_shapeIndices[range.m_offset + range.m_count] = (uint32_t)shapeIndex;
+				++range.m_count;
+			}
+		}
+	}
+}
+
+void SdfTileBinning::BuildBruteForce(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, float toleranceK)
+{
+	Resize(dimensions);
+
+	int numShapes = streams.GetNumShapes();
+	for (int tileY = 0; tileY < m_numTiles.y; ++tileY)
+	{
+		for (int tileX = 0; tileX < m_numTiles.x; ++tileX)
+		{
+			SdfTileRange& range = m_tileRanges[tileY * m_numTiles.x + tileX];
+			range.m_offset = (uint32_t)m_shapeIndices.size();
+
+			int startX = tileX * SDF_TILE_SIZE;
+			int startY = tileY * SDF_TILE_SIZE;
+			int endX = std::min(startX + SDF_TILE_SIZE, dimensions.x);
+			int endY = std::min(startY + SDF_TILE_SIZE, dimensions.y);
+
+			for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+			{
+				Vec4 geometry = streams.GetGeometry(shapeIndex, isHalfPrecision);
+				Vec3 center = Vec3(geometry.x, geometry.y, geometry.z);
+				float radius = GetInflatedRadius(geometry.w, toleranceK);
+
+				bool isHit = false;
+				for (int y = startY; y < endY && !isHit; ++y)
+				{
+					for (int x = startX; x < endX && !isHit; ++x)
+					{
+						isHit = DoesRayHitSphere(view.m_position, view.GetRayDirection(x, y, dimensions), center, radius);
+					}
+				}
+				if (isHit)
+				{
+					m_shapeIndices.push_back((uint32_t)shapeIndex);
+				}
+			}
+			range.m_count = (uint32_t)m_shapeIndices.size() - range.m_offset;
+		}
+	}
+}
+
+SdfShapeList SdfTileBinning::GetTileShapes(IntVec2 const& tileCoords) const
+{
+	SdfTileRange const& range = m_tileRanges[tileCoords.y * m_numTiles.x + tileCoords.x];
+
+	SdfShapeList shapeList;
+	shapeList.m_indices = m_shapeIndices.data() + range.m_offset;
+	shapeList.m_count = (int)range.m_count;
+	return shapeList;
+}
+
+SdfTileBinningStats SdfTileBinning::GetStats() const
+{
+	SdfTileBinningStats stats;
+	stats.m_numTiles = (int)m_tileRanges.size();
+	stats.m_numIndices = (int)m_shapeIndices.size();
+	for (SdfTileRange const& range : m_tileRanges)
+	{
+		stats.m_maxShapesPerTile = std::max(stats.m_maxShapesPerTile, (int)range.m_count);
+		if ((int)range.m_count > SDF_TILE_MAX_GROUPSHARED_SHAPES)
+		{
+			++stats.m_numTilesOverGroupShared;
+		}
+	}
+	stats.m_averageShapesPerTile = (stats.m_numTiles > 0) ? (double)stats.m_numIndices / (double)stats.m_numTiles : 0.0;
+	return stats;
+}
+
+int SdfTileBinning::CountMissingPairs(SdfTileBinning const& reference) const
+{
+	if (reference.m_numTiles != m_numTiles)
+	{
+		return (int)reference.m_shapeIndices.size();
+	}
+
+	int numMissing = 0;
+	for (size_t tileIndex = 0; tileIndex < m_tileRanges.size(); ++tileIndex)
+	{
+		SdfTileRange const& range = m_tileRanges[tileIndex];
+		SdfTileRange const& referenceRange = reference.m_tileRanges[tileIndex];
+
+		// Both lists are ascending
+		uint32_t i = 0;
+		for (uint32_t j = 0; j < referenceRange.m_count; ++j)
+		{
+			uint32_t shapeIndex = reference.m_shapeIndices[referenceRange.m_offset + j];
+			while (i < range.m_count && m_shapeIndices[range.m_offset + i] < shapeIndex)
+			{
+				++i;
+			}
+			if (i >= range.m_count || m_shapeIndices[range.m_offset + i] != shapeIndex)
+			{
+				++numMissing;
+			}
+		}
+	}
+	return numMissing;
+}
+
+bool SdfTileBinning::GetSpherePixelRect(SdfCpuView const& view, IntVec2 const& dimensions, Vec3 const& center, float radius, IntVec2& out_min, IntVec2& out_max)
+{
+	Vec3 toCenter = center - view.m_position;
+	float depth = DotProduct3D(toCenter, view.m_forward);
+	float right = -DotProduct3D(toCenter, view.m_left);
+	float up = DotProduct3D(toCenter, view.m_up);
+
+	float tanHalfFovY = TanDegrees(0.5f * view.m_fovDegrees);
+	float tanHalfFovX = tanHalfFovY * view.m_aspect;
+
+	// The rays hitting the sphere hit its silhouette circle in both axis planes, so the rect of the two ranges holds them all
+	float ndcMinX, ndcMaxX, ndcMinY, ndcMaxY;
+	if (!GetCircleNdcRange(right, depth, radius, tanHalfFovX, ndcMinX, ndcMaxX) ||
+		!GetCircleNdcRange(up, depth, radius, tanHalfFovY, ndcMinY, ndcMaxY))
+	{
+		return false;
+	}
+
+	// Inverse of GetRayDirection: ndcX = 2x / width - 1, ndcY = 1 - 2y / height. One pixel of slack for rounding.
+	float width = (float)dimensions.x;
+	float height = (float)dimensions.y;
+	float minX = floorf(GetClamped((ndcMinX + 1.f) * 0.5f * width, -2.f, width + 1.f)) - 1.f;
+	float maxX = ceilf(GetClamped((ndcMaxX + 1.f) * 0.5f * width, -2.f, width + 1.f)) + 1.f;
+	float minY = floorf(GetClamped((1.f - ndcMaxY) * 0.5f * height, -2.f, height + 1.f)) - 1.f;
+	float maxY = ceilf(GetClamped((1.f - ndcMinY) * 0.5f * height, -2.f, height + 1.f)) + 1.f;
+
+	out_min = IntVec2(std::max((int)minX, 0), std::max((int)minY, 0));
+	out_max = IntVec2(std::min((int)maxX, dimensions.x - 1), std::min((int)maxY, dimensions.y - 1));
+	return out_min.x <= out_max.x && out_min.y <= out_max.y;
+}
+
+void SdfTileBinning::Resize(IntVec2 const& dimensions)
+{
+	m_numTiles = IntVec2((dimensions.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE, (dimensions.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE);
+	m_tileRanges.assign((size_t)m_numTiles.x * m_numTiles.y, SdfTileRange());
+	m_shapeIndices.clear();
+}
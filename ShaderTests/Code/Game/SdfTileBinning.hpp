@@ -0,0 +1,68 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Engine/Math/IntVec2.hpp"
+
+#include <vector>
+
+/*
+Screen-tile shape binning, run on the CPU before the ray-march dispatch.
+Each shape's bounding sphere, inflated by the sminCubic blend width (toleranceK * 6) plus a small margin,
+is projected with the spectator view and the shape is appended to every SDF_TILE_SIZE tile its screen
+rect touches. A shape left out of a tile never comes within 6k of that tile's rays, so it cannot blend
+into any surface those rays hit. Lists keep the stream order, so smin runs in the same order as the full loop.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_TILE_MAX_GROUPSHARED_SHAPES = 512; // SDF_TILE_MAX_GROUPSHARED_SHAPES in SdfRayMarching.hlsl
+constexpr float SDF_TILE_BINNING_MARGIN = 0.01f; // covers minHitDistance and the SdfNormalTetra offsets
+
+
+// Notes: must be same as the uint2 in hlsl
+struct SdfTileRange
+{
+	uint32_t m_offset = 0; // into the shape index list
+	uint32_t m_count = 0;
+};
+
+
+struct SdfTileBinningStats
+{
+	int m_numTiles = 0;
+	int m_numIndices = 0;
+	double m_averageShapesPerTile = 0.0;
+	int m_maxShapesPerTile = 0;
+	int m_numTilesOverGroupShared = 0; // these tiles read their list from the global buffer
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfTileBinning
+{
+public:
+	void Build(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, float toleranceK);
+	// Reference for Build: marches nothing, but tests every pixel ray of every tile against every inflated sphere
+	void BuildBruteForce(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, float toleranceK);
+
+	IntVec2 GetNumTiles() const { return m_numTiles; }
+	std::vector<SdfTileRange> const& GetTileRanges() const { return m_tileRanges; }
+	std::vector<uint32_t> const& GetShapeIndices() const { return m_shapeIndices; }
+	SdfShapeList GetTileShapes(IntVec2 const& tileCoords) const;
+	SdfTileBinningStats GetStats() const;
+
+	// Number of (tile, shape) pairs of the reference that this binning is missing, must be 0
+	int CountMissingPairs(SdfTileBinning const& reference) const;
+
+	// Inclusive pixel rect of the rays that can hit the sphere, false when no ray can
+	static bool GetSpherePixelRect(SdfCpuView const& view, IntVec2 const& dimensions, Vec3 const& center, float radius, IntVec2& out_min, IntVec2& out_max);
+	static float GetInflatedRadius(float radius, float toleranceK) { return radius + toleranceK * 6.f + SDF_TILE_BINNING_MARGIN; }
+
+private:
+	void Resize(IntVec2 const& dimensions);
+
+private:
+	IntVec2 m_numTiles;
+	std::vector<SdfTileRange> m_tileRanges; // row major
+	std::vector<uint32_t> m_shapeIndices;
+	std::vector<IntVec2> m_tileRectScratch; // min / max tile per shape
+};
@@ -0,0 +1,57 @@
+#include "Game/SdfTileClassification.hpp"
+
+#include <algorithm>
+
+//-----------------------------------------------------------------------------------------------
+void SdfTileClassification::Classify(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, SdfRayMarchingConstants const& constants)
+{
+	m_numTiles = IntVec2((dimensions.x + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE, (dimensions.y + SDF_TILE_SIZE - 1) / SDF_TILE_SIZE);
+	int numTiles = m_numTiles.x * m_numTiles.y;
+	m_isTileOccupied.assign(numTiles, 0);
+
+	int numShapes = streams.GetNumShapes();
+	for (int shapeIndex = 0; shapeIndex < numShapes; ++shapeIndex)
+	{
+		// The decoded geometry, what the shader marches
+		Vec4 geometry = streams.GetGeometry(shapeIndex, isHalfPrecision);
+		IntVec2 pixelMin;
+		IntVec2 pixelMax;
+		if (!SdfTileBinning::GetSpherePixelRect(view, dimensions, Vec3(geometry.x, geometry.y, geometry.z), GetHitRadius(geometry.w, constants), pixelMin, pixelMax))
+		{
+			continue;
+		}
+		for (int tileY = pixelMin.y / SDF_TILE_SIZE; tileY <= pixelMax.y / SDF_TILE_SIZE; ++tileY)
+		{
+			uint8_t* rowTiles = &m_isTileOccupied[tileY * m_numTiles.x];
+			std::fill(rowTiles + pixelMin.x / SDF_TILE_SIZE, rowTiles + pixelMax.x / SDF_TILE_SIZE + 1, (uint8_t)1);
+		}
+	}
+
+	m_tileList.resize(numTiles);
+	m_numOccupiedTiles = 0;
+	for (uint8_t isOccupied : m_isTileOccupied)
+	{
+		m_numOccupiedTiles += isOccupied;
+	}
+	int occupiedSlot = 0;
+	int backgroundSlot = m_numOccupiedTiles;
+	for (int tileIndex = 0; tileIndex < numTiles; ++tileIndex)
+	{
+		int& slot = m_isTileOccupied[tileIndex] ? occupiedSlot : backgroundSlot;
+		m_tileList[slot++] = PackTileCoords(IntVec2(tileIndex % m_numTiles.x, tileIndex / m_numTiles.x));
+	}
+}
+
+float SdfTileClassification::GetSkippedFraction() const
+{
+	return m_tileList.empty() ? 0.f : (float)GetNumBackgroundTiles() / (float)m_tileList.size();
+}
+
+SdfDispatchArguments SdfTileClassification::GetListArguments(int numListedTiles)
+{
+	// The last row may be partial, its groups past the list return at once
+	SdfDispatchArguments arguments;
+	arguments.m_threadGroupCountX = (uint32_t)std::min(numListedTiles, SDF_TILE_LIST_ROW_GROUPS);
+	arguments.m_threadGroupCountY = (uint32_t)((numListedTiles + SDF_TILE_LIST_ROW_GROUPS - 1) / SDF_TILE_LIST_ROW_GROUPS);
+	return arguments;
+}
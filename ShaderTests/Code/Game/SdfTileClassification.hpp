@@ -0,0 +1,63 @@
+#pragma once
+#include "Game/SdfCommon.hpp"
+#include "Game/SdfCpuRayMarcher.hpp"
+#include "Game/SdfTileBinning.hpp"
+#include "Engine/Math/IntVec2.hpp"
+
+#include <cstdint>
+#include <vector>
+
+/*
+Screen-tile classification, run on the CPU before the ray-march dispatch: a tile is occupied when the projected
+bounds of some shape touch it, and only occupied tiles are marched. The others can only miss, and the
+BACKGROUND_FILL pass writes them what a missed ray writes, without a single SdfMap.
+A chain of cubic smooth unions can lower the field below the nearest sphere, but by less than its 6k blend width:
+once the running value is 6k under a shape's distance that shape no longer blends in. So a hit, where the field drops
+below minHitDistance, lies within radius + 6k + minHitDistance of a center, and the spheres are inflated by that, plus
+the binning margin. Brick maps, the BVH and CSG cuts never make the field lower than the blended spheres.
+The tile list holds the occupied tiles, then the background ones, each in row order, and the dispatch arguments
+wrap it into rows of SDF_TILE_LIST_ROW_GROUPS thread groups, under the 65535 groups per dimension of a dispatch.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_TILE_LIST_ROW_GROUPS = 256; // SDF_TILE_LIST_ROW_GROUPS in SdfRayMarching.hlsl
+
+
+// Same layout as D3D12_DISPATCH_ARGUMENTS
+struct SdfDispatchArguments
+{
+	uint32_t m_threadGroupCountX = 0;
+	uint32_t m_threadGroupCountY = 0;
+	uint32_t m_threadGroupCountZ = 1;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfTileClassification
+{
+public:
+	void Classify(SdfCpuView const& view, IntVec2 const& dimensions, SdfShapeStreams const& streams, bool isHalfPrecision, SdfRayMarchingConstants const& constants);
+
+	IntVec2 GetNumTiles() const { return m_numTiles; }
+	int GetNumOccupiedTiles() const { return m_numOccupiedTiles; }
+	int GetNumBackgroundTiles() const { return (int)m_tileList.size() - m_numOccupiedTiles; }
+	float GetSkippedFraction() const; // background tiles over all of them
+	bool IsTileOccupied(IntVec2 const& tileCoords) const { return m_isTileOccupied[tileCoords.y * m_numTiles.x + tileCoords.x] != 0; }
+
+	// x | y << 16 per tile, the occupied tiles first
+	std::vector<uint32_t> const& GetTileList() const { return m_tileList; }
+	// Thread groups of the march over the occupied tiles, and of the fill over the background ones
+	SdfDispatchArguments GetMarchArguments() const { return GetListArguments(m_numOccupiedTiles); }
+	SdfDispatchArguments GetFillArguments() const { return GetListArguments(GetNumBackgroundTiles()); }
+
+	static SdfDispatchArguments GetListArguments(int numListedTiles);
+	static float GetHitRadius(float radius, SdfRayMarchingConstants const& constants) { return radius + 6.f * constants.toleranceK + constants.minHitDistance + SDF_TILE_BINNING_MARGIN; }
+	static uint32_t PackTileCoords(IntVec2 const& tileCoords) { return (uint32_t)tileCoords.x | ((uint32_t)tileCoords.y << 16); }
+	static IntVec2 UnpackTileCoords(uint32_t packedTile) { return IntVec2((int)(packedTile & 0xFFFF), (int)(packedTile >> 16)); }
+
+private:
+	IntVec2 m_numTiles;
+	std::vector<uint8_t> m_isTileOccupied;
+	std::vector<uint32_t> m_tileList;
+	int m_numOccupiedTiles = 0;
+};
@@ -0,0 +1,120 @@
+#include "Game/SdfUploadRing.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+//-----------------------------------------------------------------------------------------------
+void SdfUploadRing::SetDevice(SdfUploadDevice* device, size_t stride)
+{
+	if (device != m_device)
+	{
+		Shutdown();
+		m_device = device;
+	}
+	if (stride != m_stride)
+	{
+		// Every slot is recreated with the new stride when it comes round, and gets the whole data then
+		m_stride = stride;
+		m_capacity = 0;
+		m_lastData.clear();
+		m_blockChangedFrames.clear();
+	}
+}
+
+void SdfUploadRing::Shutdown()
+{
+	for (int slot = 0; slot < SDF_UPLOAD_RING_SLOTS; ++slot)
+	{
+		if (m_slotCapacities[slot] > 0)
+		{
+			m_device->DestroySlotBuffer(slot);
+		}
+		m_slotCapacities[slot] = 0;
+		m_slotStrides[slot] = 0;
+		m_slotWrittenFrames[slot] = 0;
+	}
+	m_capacity = 0;
+	m_currentSlot = -1;
+	m_lastData.clear();
+	m_blockChangedFrames.clear();
+}
+
+int SdfUploadRing::Upload(void const* data, int numElements)
+{
+	size_t numBytes = (size_t)numElements * m_stride;
+	++m_frameIndex;
+	m_currentSlot = (int)(m_frameIndex % SDF_UPLOAD_RING_SLOTS);
+	++m_counters.m_numUploads;
+	m_counters.m_numBytesRequested += numBytes;
+
+	// Half again as much, so spawning a shape per frame only recreates the slots a logarithmic number of times
+	if (numElements > m_capacity)
+	{
+		m_capacity = std::max({ numElements, m_capacity + m_capacity / 2, SDF_UPLOAD_MIN_ELEMENTS });
+	}
+	FindChangedBlocks((uint8_t const*)data, numBytes);
+
+	int slot = m_currentSlot;
+	if (m_slotCapacities[slot] < numElements || m_slotStrides[slot] != m_stride)
+	{
+		if (m_slotCapacities[slot] > 0)
+		{
+			m_device->DestroySlotBuffer(slot);
+		}
+		m_device->CreateSlotBuffer(slot, m_stride, m_capacity);
+		m_slotCapacities[slot] = m_capacity;
+		m_slotStrides[slot] = m_stride;
+		m_slotWrittenFrames[slot] = 0;
+		++m_counters.m_numAllocations;
+	}
+
+	// Blocks changed since this slot was last written, adjacent ones merged
+	m_ranges.clear();
+	uint64_t writtenFrame = m_slotWrittenFrames[slot];
+	for (size_t block = 0; block < m_blockChangedFrames.size(); ++block)
+	{
+		if (m_blockChangedFrames[block] <= writtenFrame)
+		{
+			continue;
+		}
+		size_t byteOffset = block * SDF_UPLOAD_BLOCK_BYTES;
+		size_t blockBytes = std::min(SDF_UPLOAD_BLOCK_BYTES, numBytes - byteOffset);
+		if (!m_ranges.empty() && m_ranges.back().m_byteOffset + m_ranges.back().m_numBytes == byteOffset)
+		{
+			m_ranges.back().m_numBytes += blockBytes;
+			continue;
+		}
+		SdfUploadRange range;
+		range.m_byteOffset = byteOffset;
+		range.m_numBytes = blockBytes;
+		m_ranges.push_back(range);
+	}
+
+	if (!m_ranges.empty())
+	{
+		m_counters.m_numBytesUploaded += m_device->WriteSlotBuffer(slot, data, numBytes, m_ranges);
+		m_counters.m_numRanges += (int)m_ranges.size();
+	}
+	m_slotWrittenFrames[slot] = m_frameIndex;
+	return slot;
+}
+
+void SdfUploadRing::FindChangedBlocks(uint8_t const* data, size_t numBytes)
+{
+	// A block past the end of the last data, even partly, is new
+	size_t lastNumBytes = m_lastData.size();
+	size_t numBlocks = (numBytes + SDF_UPLOAD_BLOCK_BYTES - 1) / SDF_UPLOAD_BLOCK_BYTES;
+	m_blockChangedFrames.resize(numBlocks);
+	m_lastData.resize(numBytes);
+	for (size_t block = 0; block < numBlocks; ++block)
+	{
+		size_t byteOffset = block * SDF_UPLOAD_BLOCK_BYTES;
+		size_t blockBytes = std::min(SDF_UPLOAD_BLOCK_BYTES, numBytes - byteOffset);
+		bool isSame = (byteOffset + blockBytes <= lastNumBytes) && (memcmp(data + byteOffset, m_lastData.data() + byteOffset, blockBytes) == 0);
+		if (!isSame)
+		{
+			memcpy(m_lastData.data() + byteOffset, data + byteOffset, blockBytes);
+			m_blockChangedFrames[block] = m_frameIndex;
+		}
+	}
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+Per-frame upload of a dynamic structured buffer: one GPU buffer per frame in flight, so the CPU never writes the one
+the GPU may still be reading, each with room for more elements than uploaded. The capacity grows by half when the
+data outgrows it, and a slot is only recreated when it next comes round, so spawning one shape recreates nothing
+most frames and never touches a buffer in flight.
+Upload compares the data with the last frame's, in SDF_UPLOAD_BLOCK_BYTES blocks, and stamps each block with the
+frame it last changed. A slot written k frames ago only gets the blocks changed since, as a list of ranges.
+The buffers themselves belong to an SdfUploadDevice: the renderer in the game, a plain copy in the benchmark.
+*/
+
+//-----------------------------------------------------------------------------------------------
+constexpr int SDF_UPLOAD_RING_SLOTS = 3; // frames in flight
+constexpr size_t SDF_UPLOAD_BLOCK_BYTES = 1024; // delta granularity: 64 float32 or 128 float16 geometries
+constexpr int SDF_UPLOAD_MIN_ELEMENTS = 64; // smallest buffer, an empty structured buffer has no view
+
+
+//-----------------------------------------------------------------------------------------------
+struct SdfUploadRange
+{
+	size_t m_byteOffset = 0;
+	size_t m_numBytes = 0;
+};
+
+
+struct SdfUploadCounters
+{
+	int m_numUploads = 0;
+	int m_numAllocations = 0; // slot buffers created
+	uint64_t m_numBytesRequested = 0; // whole data of every upload
+	uint64_t m_numBytesUploaded = 0; // what the device sent
+	int m_numRanges = 0;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfUploadDevice
+{
+public:
+	virtual ~SdfUploadDevice() = default;
+
+	// (Re)creates the buffer of a ring slot with room for numElements, its old contents are gone
+	virtual void CreateSlotBuffer(int slot, size_t stride, int numElements) = 0;
+	virtual void DestroySlotBuffer(int slot) = 0;
+	// ranges: sorted, disjoint, within the numBytes of data. Returns the bytes it sent, at least those of the ranges
+	virtual size_t WriteSlotBuffer(int slot, void const* data, size_t numBytes, std::vector<SdfUploadRange> const& ranges) = 0;
+};
+
+
+//-----------------------------------------------------------------------------------------------
+class SdfUploadRing
+{
+public:
+	// A new stride drops every slot, they are recreated as they come round
+	void SetDevice(SdfUploadDevice* device, size_t stride);
+	void Shutdown(); // destroys the slot buffers, the device outlives them
+
+	// Makes data the contents of the next slot's buffer and returns that slot, to bind its view for this frame
+	int Upload(void const* data, int numElements);
+
+	int GetCurrentSlot() const { return m_currentSlot; }
+	int GetCapacity() const { return m_capacity; } // elements the slots grow to, the current one may still be smaller
+	size_t GetStride() const { return m_stride; }
+	SdfUploadCounters const& GetCounters() const { return m_counters; }
+	void ResetCounters() { m_counters = SdfUploadCounters(); }
+
+private:
+	void FindChangedBlocks(uint8_t const* data, size_t numBytes);
+
+private:
+	SdfUploadDevice* m_device = nullptr;
+	size_t m_stride = 0;
+	int m_capacity = 0;
+	int m_currentSlot = -1;
+	uint64_t m_frameIndex = 0;
+
+	int m_slotCapacities[SDF_UPLOAD_RING_SLOTS] = {}; // 0 when the slot has no buffer
+	size_t m_slotStrides[SDF_UPLOAD_RING_SLOTS] = {};
+	uint64_t m_slotWrittenFrames[SDF_UPLOAD_RING_SLOTS] = {}; // 0: never written since it was created
+
+	std::vector<uint8_t> m_lastData; // what the last Upload sent
+	std::vector<uint64_t> m_blockChangedFrames; // per SDF_UPLOAD_BLOCK_BYTES of data
+	std::vector<SdfUploadRange> m_ranges;
+	SdfUploadCounters m_counters;
+};
@@ -1,10 +1,15 @@
 #include "Common/Resources.hlsli"
 
+#define EDGE_DEPTH_TOLERANCE (0.05f) // relative change of 1 - depth (about near / viewZ) treated as a silhouette
+
 struct FullScreenQuadWithDepthResources
 {
     uint textureIndex;
     uint depthTexIndex;
     uint samplerIndex;
+    uint renderWidth;  // texels holding the image, from the top left. 0: all of them
+    uint renderHeight;
+    uint useEdgeAwareUpscale;
 };
 
 
@@ -40,14 +45,57 @@ v2p_t VertexMain(uint vertexID : SV_VertexID)
     return v2p;
 }
 
+// Bilinear over the 2x2 texels around the pixel, without the ones on the other side of a depth edge from the nearest texel.
+// Depth is taken from the nearest texel, so silhouettes stay sharp instead of blending foreground into background.
+float4 EdgeAwareUpscale(Texture2D<float4> tex, Texture2D<float> depthTex, float2 texelPos, int2 maxTexel, out float depth)
+{
+    int2 baseTexel = int2(floor(texelPos));
+    float2 f = texelPos - float2(baseTexel);
+    int2 nearestTexel = clamp(baseTexel + int2(round(f)), 0, maxTexel);
+    float nearestDepth = depthTex.Load(int3(nearestTexel, 0));
+
+    float4 colorSum = float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float weightSum = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        int2 offset = int2(i & 1, i >> 1);
+        int2 texel = clamp(baseTexel + offset, 0, maxTexel);
+        float tapDepth = depthTex.Load(int3(texel, 0));
+        float bilinear = (offset.x ? f.x : 1.0f - f.x) * (offset.y ? f.y : 1.0f - f.y);
+        bool isSameSurface = abs(tapDepth - nearestDepth) <= EDGE_DEPTH_TOLERANCE * (1.0f - nearestDepth);
+        float weight = isSameSurface ? bilinear : 0.0f;
+        colorSum += weight * tex.Load(int3(texel, 0));
+        weightSum += weight;
+    }
+
+    depth = nearestDepth;
+    return (weightSum > 0.0f) ? colorSum / weightSum : tex.Load(int3(nearestTexel, 0));
+}
+
 float4 PixelMain(v2p_t input, out float depth : SV_Depth) : SV_Target0
 {
     Texture2D<float4> tex = ResourceDescriptorHeap[renderResources.textureIndex];
     Texture2D<float> depthTex = ResourceDescriptorHeap[renderResources.depthTexIndex];
 	SamplerState samp = SamplerDescriptorHeap[renderResources.samplerIndex];
 
-	float4 color = tex.Sample(samp, input.uv);
+    // Dynamic resolution: the image only covers the top left of the textures
+    float2 uv = input.uv;
+    if (renderResources.renderWidth != 0)
+    {
+        uint2 texSize;
+        tex.GetDimensions(texSize.x, texSize.y);
+        float2 renderSize = float2(renderResources.renderWidth, renderResources.renderHeight);
+        if (renderResources.useEdgeAwareUpscale != 0)
+        {
+            float4 upscaled = EdgeAwareUpscale(tex, depthTex, input.uv * renderSize - 0.5f, int2(renderSize) - 1, depth);
+            clip(upscaled.a - 0.01f);
+            return upscaled;
+        }
+        uv = clamp(input.uv * renderSize, 0.5f, renderSize - 0.5f) / float2(texSize); // keep the filter inside the image
+    }
+
+	float4 color = tex.Sample(samp, uv);
 	clip(color.a - 0.01f);
-    depth = depthTex.Sample(samp, input.uv);
+    depth = depthTex.Sample(samp, uv);
 	return float4(color);
 }
\ No newline at end of file
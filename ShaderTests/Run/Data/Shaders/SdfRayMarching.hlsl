@@ -6,10 +6,67 @@
 #include "Common/StaticSampler.hlsli"
 #include "Common/TriplanarUtils.hlsli"
 #include "Common/ToneMapping.hlsli"
+#include "Common/Algorithm.hlsli"
 
 
 #define THREADS_PER_GROUP_SIZE (8)
+#define SDF_BVH_STACK_SIZE (32) // SDF_BVH_STACK_SIZE in SdfBvh.hpp
+#define SDF_TILE_MAX_GROUPSHARED_SHAPES (512) // SDF_TILE_MAX_GROUPSHARED_SHAPES in SdfTileBinning.hpp
+#define SDF_TILE_LIST_ROW_GROUPS (256) // SDF_TILE_LIST_ROW_GROUPS in SdfTileClassification.hpp
+#define SDF_BRICK_SIZE (8) // SDF_BRICK_SIZE in SdfBrickMap.hpp
+#define SDF_BRICK_VOXEL_SIZE (0.125f) // SDF_BRICK_VOXEL_SIZE in SdfBrickMap.hpp
+#define SDF_BRICK_NARROW_BAND (0.1f) // SDF_BRICK_NARROW_BAND in SdfBrickMap.hpp
+#define SDF_BRICK_EMPTY (0xFFFFFFFF)
+#define SDF_CONE_PREPASS_FACTOR (4) // SDF_CONE_PREPASS_FACTOR in SdfCpuRayMarcher.hpp
+#define SDF_CONE_ANGLE_SLACK (1.01f) // SDF_CONE_ANGLE_SLACK in SdfCpuRayMarcher.hpp
+#define SDF_TEMPORAL_DEPTH_SLACK (0.005f) // SDF_TEMPORAL_DEPTH_SLACK in SdfTemporalReprojection.hpp
+#define SDF_TEMPORAL_DILATION (1) // SDF_TEMPORAL_DILATION in SdfTemporalReprojection.hpp
+#define SDF_TEMPORAL_MAX_DILATION (4) // SDF_TEMPORAL_MAX_DILATION in SdfTemporalReprojection.hpp
+#define SDF_TEMPORAL_NO_SPLAT (0xFFFFFFFF)
+#define SDF_PREPASS_NONE (0) // SDF_PREPASS_* in SdfCommon.hpp
+#define SDF_PREPASS_CONE_DEPTH (1)
+#define SDF_PREPASS_TEMPORAL_CLEAR (2)
+#define SDF_PREPASS_TEMPORAL_SCATTER (3)
+#define SDF_PREPASS_COST_CLEAR (4)
+#define SDF_PREPASS_COST_REDUCE (5)
+#define SDF_PREPASS_SHADE_CLEAR (6)
+#define SDF_PREPASS_SHADE_PREFIX (7)
+#define SDF_PREPASS_SHADE_SCATTER (8)
+#define SDF_PREPASS_SHADE (9)
+#define SDF_PREPASS_BACKGROUND_FILL (10)
+#define SDF_PREPASS_SHADE_COUNT (11)
+#define SDF_PREPASS_SHADE_RESOLVE (12)
+#define SDF_COST_HISTOGRAM_BINS (32) // SDF_COST_* in SdfCostCounters.hpp
+#define SDF_COST_STATS_SIZE (64)
+#define SDF_COST_STAT_NUM_PIXELS (32)
+#define SDF_COST_STAT_NUM_STEPS (33)
+#define SDF_COST_STAT_NUM_SDF_MAP_CALLS (34)
+#define SDF_COST_STAT_NUM_MATERIAL_EVALUATIONS (35)
+#define SDF_COST_STAT_MAX_STEPS (36)
+#define SDF_COST_STAT_MAX_SDF_MAP_CALLS (37)
+#define SDF_COST_HEATMAP_STEPS (5)
+#define SDF_COST_HEATMAP_SDF_MAP_CALLS (6)
+#define SDF_COST_HEATMAP_MATERIAL_EVALUATIONS (7)
+#define SDF_COST_HEATMAP_MAX_MATERIALS (8)
+#ifndef SDF_TOPK_MATERIALS
+#define SDF_TOPK_MATERIALS (4) // SDF_TOPK_MATERIALS in SdfCpuRayMarcher.hpp, K of useTopKMaterials, compiled in
+#endif
+#define SDF_TOPK_CANDIDATES (16) // SDF_TOPK_CANDIDATES in SdfCpuRayMarcher.hpp
+#define SDF_GBUFFER_MAX_SHAPES (4) // SDF_GBUFFER_* in SdfDeferredShading.hpp
+#define SDF_GBUFFER_NO_SHAPE (0xFFFFFFFF)
+#define SDF_GBUFFER_OVERFLOW (0xFFFFFFFE)
+#define SDF_SHADE_BINS (64) // SDF_SHADE_BINS in SdfDeferredShading.hpp, bin 0 holds the overflow texels
+#define SDF_CSG_STACK_SIZE (32) // SDF_CSG_* in SdfCsg.hpp
+#define SDF_CSG_OP_SPHERE (0)
+#define SDF_CSG_OP_BOX (1)
+#define SDF_CSG_OP_UNION (2)
+#define SDF_CSG_OP_SMOOTH_UNION (3)
+#define SDF_CSG_OP_SUBTRACTION (4)
+#define SDF_CSG_OP_INTERSECTION (5)
+#define SDF_CSG_OP_SKIP_IF_FAR (6)
+#define SDF_CSG_OP_GRID (7)
 static const float INFINITY_DIST = 1e35f;
+static const float3 SDF_MISSING_COLOR = float3(0.2f, 0.2f, 0.2f); // SdfCpuRayMarcher::GetMissingColor
 
 
 struct SdfRayMarchingResources
@@ -20,10 +77,29 @@ struct SdfRayMarchingResources
     uint lightConstantsIndex;
     uint perFrameConstantsIndex;
 
-    uint inputSdfShapesIndex; // StructuredBuffer<SdfShape>
+    uint inputSdfGeometryIndex; // StructuredBuffer<float4> or StructuredBuffer<uint2> (half)
     uint outputTextureIndex;  // RWTexture2D<float4>
     uint outputDepthIndex;     
     uint rayMarchingConstantsIndex;
+    uint inputSdfShapeMaterialsIndex; // StructuredBuffer<uint2>
+    uint inputSdfMaterialsIndex;      // StructuredBuffer<SdfMaterial>
+    uint inputSdfBvhIndex;            // StructuredBuffer<SdfBvhNode>
+    uint inputTileRangesIndex;        // StructuredBuffer<uint2> x: offset y: count, per tile
+    uint inputTileShapeIndicesIndex;  // StructuredBuffer<uint>
+    uint inputBricksIndex;            // StructuredBuffer<SdfBrick>
+    uint inputBrickSamplesIndex;      // StructuredBuffer<float>
+    uint coneDepthIndex;              // RWTexture2D<float> quarter-res start distances
+    uint temporalStartIndex;          // RWTexture2D<uint> nearest reprojected distance per pixel, asuint
+    uint costCountersIndex;           // RWTexture2D<uint4> x: steps y: SdfMap calls z: material evaluations
+    uint costStatsIndex;              // RWTexture2D<uint> SDF_COST_STATS_SIZE x 1, step histogram + totals
+    uint gbufferIndex;                // RWTexture2D<float4> xyz: normal w: hit distance, INFINITY_DIST for a miss
+    uint gbufferShapesIndex;          // RWTexture2D<uint4> shapes to blend, SDF_GBUFFER_NO_SHAPE past the last
+    uint shadeBinsIndex;              // RWTexture2D<uint> SDF_SHADE_BINS x 2, row 0: counts row 1: offsets, scatter cursors
+    uint shadePixelsIndex;            // RWTexture2D<uint> x | y << 16 of the hit pixels, grouped by bin, slot i at (i % width, i / width)
+    uint inputCsgProgramIndex;        // StructuredBuffer<SdfCsgInstruction>
+    uint inputTileListIndex;          // StructuredBuffer<uint> x | y << 16, occupied tiles then background tiles
+    uint inputCsgGridSamplesIndex;    // StructuredBuffer<float> baked grid samples of the CSG program, in voxels
+    uint prePass;                     // SDF_PREPASS_*
 };
 
 
@@ -37,33 +113,138 @@ struct SdfRayMarchingConstants
 	int numOfShapes;
     int screenWidth;
     int screenHeight;
-    float padding;
+    int halfPrecisionGeometry; // geometry stream is uint2: f16 center.xyz + radius
 
     float triplanarUVScale;
 	float triplanarBlendSharpness;
-	float padding1;
-	float padding2;
+	int useBvh;
+	int numOfBvhNodes;
+
+    int useTileBinning;
+    int numOfTilesX;
+    int useConeDepthPrepass;
+    int padding1;
+
+    int useBrickMap;
+    int brickGridSize;
+    float brickOdometer;
+    float brickBlendLowering;
+
+    float3 brickMapOrigin;
+    float padding2;
+
+    float3 shapeBoundsMin;
+    float padding3;
+
+    float3 shapeBoundsMax;
+    float padding4;
+
+    int useTemporalReprojection;
+    int hasTemporalHistory; // outputDepthIndex still holds the previous frame, seen from the prevCamera below
+    float temporalMaxShapeMove;
+    float padding5;
+
+    float3 cameraForward;
+    float tanHalfFovX;
+    float3 cameraLeft;
+    float tanHalfFovY;
+    float3 cameraUp;
+    float padding6;
+
+    float3 prevCameraPosition;
+    float prevCameraNear;
+    float3 prevCameraForward;
+    float prevCameraFar;
+    float3 prevCameraLeft;
+    float prevTanHalfFovX;
+    float3 prevCameraUp;
+    float prevTanHalfFovY;
+
+    int useOverRelaxation;
+    float overRelaxationOmega;
+    int useCostCounters;
+    int costHistogramBinWidth;
+
+    int useTopKMaterials;
+    float topKMinWeight;
+    int useAnalyticNormals;
+    int useDeferredShading;
+
+    int useCsgProgram; // SdfMap runs the CSG program instead of blending the shapes, which only shade
+    int numCsgInstructions;
+    int useTileClassification; // the march only covers the occupied tiles of inputTileListIndex, BACKGROUND_FILL the rest
+    int numOccupiedTiles;
+
+    int numBackgroundTiles;
+    int shadingRate; // deferred only: one shading per block of shadingRate^2 pixels on the same surface, see GetShadingSource
+    float shadingDepthTolerance;
+    float shadingNormalThreshold;
 };
 
 
-struct SdfShape
+// Shape data is split in streams (SdfCommon.hpp):
+// geometry (hot):       float4 xyz: center w: radius, or uint2 of float16 when halfPrecisionGeometry
+// shape material (cold): uint2 x: type (low 16) | materialID (high 16) y: RGBA8 color
+// material table:        SdfMaterial, indexed by materialID
+// Bounds are sphere AABBs inflated by the sminCubic blend width (toleranceK * 6).
+// Shapes are uploaded in leaf order, a leaf is the range [leftOrFirst, leftOrFirst + count).
+struct SdfBvhNode
 {
-	int m_type;     // 0 sphere
-	int m_padding0;
-	int m_padding1;
-	uint m_triAlbedoTexID;
+    float3 boundsMin;
+    uint leftOrFirst; // interior: left child, right child is +1
+    float3 boundsMax;
+    uint count;       // 0 for interior nodes
+};
 
+struct SdfMaterial
+{
+	uint m_triAlbedoTexID;
     uint m_triMRTexID;
 	uint m_triNormalTexID;
 	uint m_triOcclusionTexID;
+
 	uint m_triEmissiveTexID;
+	uint m_padding0;
+	uint m_padding1;
+	uint m_padding2;
+};
+
+// Post-order CSG program (SdfCsg.hpp), see SDF_CSG_OP_* there for the operands of each op
+struct SdfCsgInstruction
+{
+    uint op;
+    uint skip;      // SKIP_IF_FAR: instructions after this one to jump over, GRID: first sample
+    float param;    // SMOOTH_UNION: k, SKIP_IF_FAR: blend width the bound must clear, GRID: samples along z
+    float padding;
+    float4 data0;
+    float4 data1;
+    float4 data2;
+};
 
-    float4 color;
-    float4 data0; // xyz: center w: radius
+// Brick map (SdfBrickMap.hpp): bricks x fastest, each either a coarse bound or (SDF_BRICK_SIZE + 1)^3 corner samples
+struct SdfBrick
+{
+    uint sampleOffset; // SDF_BRICK_EMPTY: coarse bound only
+    float coarseDistance;
+    float bakeOdometer;
+    float padding;
 };
 
 ConstantBuffer<SdfRayMarchingResources> renderResources : register(b0);
 
+// Shapes binned to this thread group's tile (SdfTileBinning.cpp), in stream order.
+// Lists longer than the groupshared array are read from the global buffer instead.
+groupshared uint gs_tileShapes[SDF_TILE_MAX_GROUPSHARED_SHAPES];
+static uint s_tileShapeOffset = 0;
+static uint s_tileShapeCount = 0;
+static bool s_isTileInGroupShared = false;
+static bool s_hasTileList = false; // the pre-passes run without one
+
+// This thread's cost, x: RayMarch steps y: SdfMap calls z: material evaluations (SdfCostCounters.hpp)
+static uint3 s_costCounts = uint3(0, 0, 0);
+groupshared uint gs_costStats[SDF_COST_STATS_SIZE];
+groupshared uint gs_shadeBins[SDF_SHADE_BINS];
+
 /*
 1. Masking: MaskA only process materialA and materialB, MaskB only processes materialB and material C
 2. Weight Thresholding: if weight < ? ignore the material
@@ -78,16 +259,41 @@ float sdSphere(float3 p, float3 c, float r)
 }
 
 
-float sdfValueFromShape(float3 p, SdfShape s)
+// Spheres only, other shape types get a geometry stream of their own
+float sdfValueFromShape(float3 p, float4 geometry)
 {
     // Sphere
-    if (s.m_type == 0)
+    return sdSphere(p, geometry.xyz, geometry.w);
+}
+
+float4 UnpackHalfGeometry(uint2 packed)
+{
+    return float4(f16tof32(packed.x), f16tof32(packed.x >> 16), f16tof32(packed.y), f16tof32(packed.y >> 16));
+}
+
+float4 LoadShapeGeometry(int i)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    if (sdfConstants.halfPrecisionGeometry != 0)
     {
-        return sdSphere(p, s.data0.xyz, s.data0.w);
+        StructuredBuffer<uint2> sdfGeometryHalf = ResourceDescriptorHeap[renderResources.inputSdfGeometryIndex];
+        return UnpackHalfGeometry(sdfGeometryHalf[i]);
     }
+    StructuredBuffer<float4> sdfGeometry = ResourceDescriptorHeap[renderResources.inputSdfGeometryIndex];
+    return sdfGeometry[i];
+}
 
+uint GetShapeMaterialID(int i)
+{
+    StructuredBuffer<uint2> sdfShapeMaterials = ResourceDescriptorHeap[renderResources.inputSdfShapeMaterialsIndex];
+    return sdfShapeMaterials[i].x >> 16;
+}
 
-    return INFINITY_DIST;
+float4 GetShapeColor(int i)
+{
+    StructuredBuffer<uint2> sdfShapeMaterials = ResourceDescriptorHeap[renderResources.inputSdfShapeMaterialsIndex];
+    uint c = sdfShapeMaterials[i].y;
+    return float4(c & 0xFF, (c >> 8) & 0xFF, (c >> 16) & 0xFF, c >> 24) / 255.f;
 }
 
 
@@ -109,26 +315,304 @@ float sminCubic(float a, float b, float k)
     return min(a,b) - h*h*h*k*(1.0/6.0);
 }
 
+// Forward-mode dual numbers, same as SdfDistanceGradient in SdfCpuRayMarcher.hpp: x is the distance, yzw its gradient
+float4 sdSphereGradient(float3 p, float3 c, float r)
+{
+    float3 offset = p - c;
+    float len = length(offset);
+    return float4(len - r, (len > 0.0f) ? offset / len : float3(0.0f, 0.0f, 0.0f));
+}
+
+// The h^3 term adds h^2/2 * sign(a-b) * (a' - b'), the mean of both gradients at a == b
+float4 sminCubicGradient(float4 a, float4 b, float k)
+{
+    k *= 6.0;
+    float diff = a.x - b.x;
+    float h = max( k-abs(diff), 0.0 )/k;
+    float3 gradient = ((a.x < b.x) ? a.yzw : b.yzw) + (a.yzw - b.yzw) * (0.5f * h * h * ((diff >= 0.0f) ? 1.0f : -1.0f));
+    return float4(min(a.x, b.x) - h*h*h*k*(1.0/6.0), gradient);
+}
+
+// A shape type without an analytic gradient returns a zero one, and SdfNormal falls back to SdfNormalTetra
+float4 sdfGradientFromShape(float3 p, float4 geometry)
+{
+    // Sphere
+    return sdSphereGradient(p, geometry.xyz, geometry.w);
+}
+
+// Box of halfExtents along the orthonormal iAxis, jAxis and their cross product
+float sdOrientedBox(float3 p, float3 center, float3 iAxis, float3 jAxis, float3 halfExtents)
+{
+    float3 d = p - center;
+    float3 q = abs(float3(dot(d, iAxis), dot(d, jAxis), dot(d, cross(iAxis, jAxis)))) - halfExtents;
+    return length(max(q, 0.0f)) + min(max(q.x, max(q.y, q.z)), 0.0f);
+}
+
+// Mesh baked to signed distances (SdfMeshBaker.hpp), trilinear inside the grid box; outside it, the distance to the
+// box plus the nearest boundary sample. data0: first sample + voxel size, data1 / data2: x / y axis + sample counts
+float sdBakedGrid(float3 p, SdfCsgInstruction instruction)
+{
+    StructuredBuffer<float> samples = ResourceDescriptorHeap[renderResources.inputCsgGridSamplesIndex];
+    float3 d = p - instruction.data0.xyz;
+    float3 coords = float3(dot(d, instruction.data1.xyz), dot(d, instruction.data2.xyz), dot(d, cross(instruction.data1.xyz, instruction.data2.xyz))) / instruction.data0.w;
+    int3 numSamples = int3(instruction.data1.w, instruction.data2.w, instruction.param);
+    float3 clamped = clamp(coords, 0.0f, float3(numSamples - 1));
+    float outside = length(coords - clamped);
+    int3 cell = min(int3(clamped), numSamples - 2);
+    float3 f = clamped - float3(cell);
+
+    uint rowStride = numSamples.x;
+    uint sliceStride = numSamples.x * numSamples.y;
+    uint first = instruction.skip + cell.z * sliceStride + cell.y * rowStride + cell.x;
+    float s00 = lerp(samples[first], samples[first + 1], f.x);
+    float s10 = lerp(samples[first + rowStride], samples[first + rowStride + 1], f.x);
+    float s01 = lerp(samples[first + sliceStride], samples[first + sliceStride + 1], f.x);
+    float s11 = lerp(samples[first + sliceStride + rowStride], samples[first + sliceStride + rowStride + 1], f.x);
+    return (lerp(lerp(s00, s10, f.y), lerp(s01, s11, f.y), f.z) + outside) * instruction.data0.w;
+}
+
+// Same as EvaluateSdfCsgProgram in SdfCsg.cpp: the scene as a stack program of primitives and CSG operators.
+// A SKIP_IF_FAR jumps over an operand, and its operator, that is too far from p to change the top of the stack.
+float SdfMapCsg(float3 p)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    StructuredBuffer<SdfCsgInstruction> program = ResourceDescriptorHeap[renderResources.inputCsgProgramIndex];
+
+    float stack[SDF_CSG_STACK_SIZE];
+    int top = -1;
+    for (int i = 0; i < sdfConstants.numCsgInstructions; ++i)
+    {
+        SdfCsgInstruction instruction = program[i];
+        if (instruction.op == SDF_CSG_OP_SPHERE)
+        {
+            stack[++top] = sdSphere(p, instruction.data0.xyz, instruction.data0.w);
+        }
+        else if (instruction.op == SDF_CSG_OP_BOX)
+        {
+            stack[++top] = sdOrientedBox(p, instruction.data0.xyz, instruction.data1.xyz, instruction.data2.xyz, float3(instruction.data1.w, instruction.data2.w, instruction.data0.w));
+        }
+        else if (instruction.op == SDF_CSG_OP_GRID)
+        {
+            stack[++top] = sdBakedGrid(p, instruction);
+        }
+        else if (instruction.op == SDF_CSG_OP_SKIP_IF_FAR)
+        {
+            float3 q = max(max(instruction.data0.xyz - p, p - instruction.data1.xyz), 0.0f);
+            float distance = length(q);
+            if (distance > 0.0f && distance - instruction.data0.w >= instruction.data1.w * stack[top] + instruction.param)
+            {
+                i += instruction.skip;
+            }
+        }
+        else
+        {
+            float b = stack[top--];
+            float a = stack[top];
+            if (instruction.op == SDF_CSG_OP_UNION)
+            {
+                stack[top] = min(a, b);
+            }
+            else if (instruction.op == SDF_CSG_OP_SMOOTH_UNION)
+            {
+                stack[top] = sminCubic(a, b, instruction.param);
+            }
+            else if (instruction.op == SDF_CSG_OP_SUBTRACTION)
+            {
+                stack[top] = max(a, -b);
+            }
+            else
+            {
+                stack[top] = max(a, b);
+            }
+        }
+    }
+    return (top >= 0) ? stack[0] : INFINITY_DIST;
+}
+
+bool UseCsgProgram()
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    return sdfConstants.useCsgProgram != 0;
+}
+
 //-------------------------------------------------------------------------------------------
-// TODO: not just union of sdfs, but also subtraction and intersection
 // Sample SDF value from input position
+float DistanceSquaredToBvhNode(float3 p, SdfBvhNode node)
+{
+    float3 q = max(max(node.boundsMin - p, p - node.boundsMax), 0.f);
+    return dot(q, q);
+}
+
+bool UseSdfBvh()
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    return sdfConstants.useBvh != 0 && sdfConstants.numOfBvhNodes > 0;
+}
+
+bool UseTileBinning()
+{
+    return s_hasTileList;
+}
+
+uint GetTileShapeIndex(uint j)
+{
+    if (s_isTileInGroupShared)
+    {
+        return gs_tileShapes[j];
+    }
+    StructuredBuffer<uint> tileShapeIndices = ResourceDescriptorHeap[renderResources.inputTileShapeIndicesIndex];
+    return tileShapeIndices[s_tileShapeOffset + j];
+}
+
+// Shapes left out of the tile stay more than 6k away from all of its rays, so surfaces and blends are unchanged
+float SdfMapTile(float3 p)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    const float toleranceK = sdfConstants.toleranceK;
+
+    float res = INFINITY_DIST;
+    for (uint j = 0; j < s_tileShapeCount; ++j)
+    {
+        res = sminCubic(res, sdfValueFromShape(p, LoadShapeGeometry(GetTileShapeIndex(j))), toleranceK);
+    }
+    return res;
+}
+
+// Same result as the loop over every shape: a node is skipped only when none of its shapes can change res.
+// Outside the inflated bounds every d > 6k, so skipping is also safe once p is inside a shape (res <= 0).
+float SdfMapBvh(float3 p)
+{
+    StructuredBuffer<SdfBvhNode> sdfBvh = ResourceDescriptorHeap[renderResources.inputSdfBvhIndex];
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    const float toleranceK = sdfConstants.toleranceK;
+
+    float res = INFINITY_DIST;
+    uint stack[SDF_BVH_STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+
+    while (stackSize > 0)
+    {
+        SdfBvhNode node = sdfBvh[stack[--stackSize]];
+
+        float distSquared = DistanceSquaredToBvhNode(p, node);
+        if (distSquared > 0.f && (res <= 0.f || distSquared >= res * res))
+        {
+            continue;
+        }
+
+        if (node.count > 0)
+        {
+            for (uint i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+            {
+                res = sminCubic(res, sdfValueFromShape(p, LoadShapeGeometry(i)), toleranceK);
+            }
+            continue;
+        }
+
+        // Left first keeps the stream order, sminCubic is not associative
+        stack[stackSize++] = node.leftOrFirst + 1;
+        stack[stackSize++] = node.leftOrFirst;
+    }
+    return res;
+}
+
 float SdfMap(float3 p)
 {
-    StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
+    s_costCounts.y += 1;
+    if (UseCsgProgram())
+    {
+        return SdfMapCsg(p);
+    }
+    if (UseTileBinning())
+    {
+        return SdfMapTile(p);
+    }
+    if (UseSdfBvh())
+    {
+        return SdfMapBvh(p);
+    }
+
     ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
     const int numOfShapes = sdfConstants.numOfShapes;
     const float toleranceK = sdfConstants.toleranceK;
 
     float res = INFINITY_DIST;
-    for (int i = 0; i < numOfShapes; ++i)
+    if (sdfConstants.halfPrecisionGeometry != 0)
+    {
+        StructuredBuffer<uint2> sdfGeometryHalf = ResourceDescriptorHeap[renderResources.inputSdfGeometryIndex];
+        for (int i = 0; i < numOfShapes; ++i)
+        {
+            res = sminCubic(res, sdfValueFromShape(p, UnpackHalfGeometry(sdfGeometryHalf[i])), toleranceK);
+        }
+    }
+    else
     {
-        res = sminCubic(res, sdfValueFromShape(p, sdfShapes[i]), toleranceK);
+        StructuredBuffer<float4> sdfGeometry = ResourceDescriptorHeap[renderResources.inputSdfGeometryIndex];
+        for (int i = 0; i < numOfShapes; ++i)
+        {
+            res = sminCubic(res, sdfValueFromShape(p, sdfGeometry[i]), toleranceK);
+        }
     }
     return res;
 }
 
 
+// SdfMap and its gradient in one pass over the same shapes in the same order: SdfMapTile, SdfMapBvh or all of them.
+// The BVH skips the same nodes, a skipped shape has h = 0 in sminCubicGradient and changes neither part.
+float4 SdfMapGradient(float3 p)
+{
+    s_costCounts.y += 1;
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    const float toleranceK = sdfConstants.toleranceK;
+
+    float4 res = float4(INFINITY_DIST, 0.0f, 0.0f, 0.0f);
+    if (UseTileBinning())
+    {
+        for (uint j = 0; j < s_tileShapeCount; ++j)
+        {
+            res = sminCubicGradient(res, sdfGradientFromShape(p, LoadShapeGeometry(GetTileShapeIndex(j))), toleranceK);
+        }
+    }
+    else if (UseSdfBvh())
+    {
+        StructuredBuffer<SdfBvhNode> sdfBvh = ResourceDescriptorHeap[renderResources.inputSdfBvhIndex];
+        uint stack[SDF_BVH_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            SdfBvhNode node = sdfBvh[stack[--stackSize]];
+            float distSquared = DistanceSquaredToBvhNode(p, node);
+            if (distSquared > 0.f && (res.x <= 0.f || distSquared >= res.x * res.x))
+            {
+                continue;
+            }
+            if (node.count > 0)
+            {
+                for (uint i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                {
+                    res = sminCubicGradient(res, sdfGradientFromShape(p, LoadShapeGeometry(i)), toleranceK);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < sdfConstants.numOfShapes; ++i)
+        {
+            res = sminCubicGradient(res, sdfGradientFromShape(p, LoadShapeGeometry(i)), toleranceK);
+        }
+    }
+    return res;
+}
+
 // https://iquilezles.org/articles/normalsSDF/
 // Tetrahedron technique
 float3 SdfNormalTetra(float3 p)
@@ -141,11 +625,26 @@ float3 SdfNormalTetra(float3 p)
                       k.xxx*SdfMap( p + k.xxx*h ) );
 }
 
+// One scene pass when useAnalyticNormals is set, the four of SdfNormalTetra when the gradient has no direction
+float3 SdfNormal(float3 p)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    if (sdfConstants.useAnalyticNormals != 0 && !UseCsgProgram())
+    {
+        float3 gradient = SdfMapGradient(p).yzw;
+        if (dot(gradient, gradient) > 1e-12f)
+        {
+            return normalize(gradient);
+        }
+    }
+    return SdfNormalTetra(p);
+}
+
 float3 GetWeightedColor(float3 p, float3 backgroundColor, float3 worldNormal)
 {
     // TODO: Input Normal To Sample from Triplanar Mapping
 
-    StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
+    StructuredBuffer<SdfMaterial> sdfMaterials = ResourceDescriptorHeap[renderResources.inputSdfMaterialsIndex];
     ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
     const int numOfShapes = sdfConstants.numOfShapes;
@@ -158,13 +657,14 @@ float3 GetWeightedColor(float3 p, float3 backgroundColor, float3 worldNormal)
 
     for (int i = 0; i < numOfShapes; ++i)
     {
-        float d = sdfValueFromShape(p, sdfShapes[i]);
+        float d = sdfValueFromShape(p, LoadShapeGeometry(i));
 
-        float3 c = sdfShapes[i].color.rgb;
+        float3 c = GetShapeColor(i).rgb;
+        SdfMaterial material = sdfMaterials[GetShapeMaterialID(i)];
 
-        if (sdfShapes[i].m_triAlbedoTexID != INVALID_INDEX)
+        if (material.m_triAlbedoTexID != INVALID_INDEX)
         {
-            Texture2D<float4> diffuseTexture = ResourceDescriptorHeap[sdfShapes[i].m_triAlbedoTexID];
+            Texture2D<float4> diffuseTexture = ResourceDescriptorHeap[material.m_triAlbedoTexID];
 
             c = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness, diffuseTexture, s_linearWrap).rgb;
         }
@@ -183,166 +683,479 @@ float3 GetWeightedColor(float3 p, float3 backgroundColor, float3 worldNormal)
         return backgroundColor; // or background color
 }
 
-SurfaceData GetWeightedSurfaceData(float3 p, float3 worldNormal)
+struct SurfaceDataSum
 {
-    StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
-    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
-
-    const int numOfShapes = sdfConstants.numOfShapes;
-    const float toleranceK = sdfConstants.toleranceK;
-
-    float threshold = toleranceK * 3.f;
-
-    float3 albedoSum = 0.f;
-    float3 normalSum = 0.f;
-    float metallicSum = 0.f;
-    float roughnessSum = 0.f;
-    float3 emissionSum = 0.f;
-    float AOSum = 0.f;
+    float3 albedoSum;
+    float3 normalSum;
+    float metallicSum;
+    float roughnessSum;
+    float3 emissionSum;
+    float AOSum;
+    float weightSum;
+};
 
-    float weightSum = 0.0f;
+// Weights of the shapes within threshold, reduced to the SDF_TOPK_MATERIALS heaviest whenever it fills up
+struct TopKCandidates
+{
+    float weights[SDF_TOPK_CANDIDATES];
+    uint shapes[SDF_TOPK_CANDIDATES];
+    uint count;
+};
 
-    SurfaceData surf = MakeDefaultSurfaceData();
+DEFINE_TOPN_INDICES_UNORDERED_FUNC(TopKCandidateIndices, SDF_TOPK_CANDIDATES, SDF_TOPK_MATERIALS)
 
-    for (int i = 0; i < numOfShapes; ++i)
+void ReduceTopKCandidates(inout TopKCandidates candidates)
+{
+    for (uint j = candidates.count; j < SDF_TOPK_CANDIDATES; ++j)
     {
-        float d = sdfValueFromShape(p, sdfShapes[i]);
+        candidates.weights[j] = -1.0f;
+    }
+    int topIndices[SDF_TOPK_MATERIALS];
+    TopKCandidateIndices(candidates.weights, topIndices);
 
-        if (d > threshold)
+    float topWeights[SDF_TOPK_MATERIALS];
+    uint topShapes[SDF_TOPK_MATERIALS];
+    [unroll]
+    for (int k = 0; k < SDF_TOPK_MATERIALS; ++k)
+    {
+        topWeights[k] = candidates.weights[topIndices[k]];
+        topShapes[k] = candidates.shapes[topIndices[k]];
+    }
+    candidates.count = 0;
+    [unroll]
+    for (int k = 0; k < SDF_TOPK_MATERIALS; ++k)
+    {
+        if (topWeights[k] >= 0.0f)
         {
-            continue;
+            candidates.weights[candidates.count] = topWeights[k];
+            candidates.shapes[candidates.count] = topShapes[k];
+            candidates.count += 1;
         }
+    }
+}
 
-        Texture2D<float4> albedoTexture = ResourceDescriptorHeap[sdfShapes[i].m_triAlbedoTexID];
-        Texture2D<float4> metalicRoughnessTexture = ResourceDescriptorHeap[sdfShapes[i].m_triMRTexID];
-        Texture2D<float4> normalTexture = ResourceDescriptorHeap[sdfShapes[i].m_triNormalTexID];
-        Texture2D<float4> occlusionTexture = ResourceDescriptorHeap[sdfShapes[i].m_triOcclusionTexID];
-        Texture2D<float4> emissiveTexture = ResourceDescriptorHeap[sdfShapes[i].m_triEmissiveTexID];
-	    SamplerState samp = s_linearWrap;
+void SampleShapeSurfaceData(inout SurfaceDataSum sum, int i, float3 p, float3 worldNormal, float w)
+{
+    StructuredBuffer<SdfMaterial> sdfMaterials = ResourceDescriptorHeap[renderResources.inputSdfMaterialsIndex];
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
-        float4 albedoTexel = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
-            albedoTexture, samp);
-        if (albedoTexel.a < 0.01f)
-        {
-            continue;
-        }
+    // Cold data is only fetched for the few shapes close to the hit
+    s_costCounts.z += 1;
+    SdfMaterial material = sdfMaterials[GetShapeMaterialID(i)];
 
-        float2 metalicRoughness = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
-            metalicRoughnessTexture, samp).bg;
-        float occlusion = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
-            occlusionTexture, samp).r;
-        float3 emissive = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
-            emissiveTexture, samp).rgb;
+    Texture2D<float4> albedoTexture = ResourceDescriptorHeap[material.m_triAlbedoTexID];
+    Texture2D<float4> metalicRoughnessTexture = ResourceDescriptorHeap[material.m_triMRTexID];
+    Texture2D<float4> normalTexture = ResourceDescriptorHeap[material.m_triNormalTexID];
+    Texture2D<float4> occlusionTexture = ResourceDescriptorHeap[material.m_triOcclusionTexID];
+    Texture2D<float4> emissiveTexture = ResourceDescriptorHeap[material.m_triEmissiveTexID];
+    SamplerState samp = s_linearWrap;
 
-        float3 pixelNormalWorldSpace = SampleTriplanarNormal(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
-            normalTexture, samp);
+    float4 albedoTexel = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
+        albedoTexture, samp);
+    if (albedoTexel.a < 0.01f)
+    {
+        return;
+    }
 
+    float2 metalicRoughness = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
+        metalicRoughnessTexture, samp).bg;
+    float occlusion = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
+        occlusionTexture, samp).r;
+    float3 emissive = SampleTriplanar(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
+        emissiveTexture, samp).rgb;
 
-        float w = max(0, threshold - d); // linear weight, maybe exp(-d/k)
-        weightSum += w;
+    float3 pixelNormalWorldSpace = SampleTriplanarNormal(p, worldNormal, sdfConstants.triplanarUVScale, sdfConstants.triplanarBlendSharpness,
+        normalTexture, samp);
 
-        albedoSum += w * albedoTexel.rgb;
-        normalSum += w * pixelNormalWorldSpace.xyz;
-        metallicSum += w * metalicRoughness.x;
-        roughnessSum += w * metalicRoughness.y;
-        emissionSum += w * emissive;
-        AOSum += w * occlusion;
-    }
 
-    if (weightSum > 0.0f)
-    {
-        surf.Albedo = albedoSum / weightSum;
-        surf.Normal = normalize(normalSum);
-        surf.Metallic = metallicSum / weightSum;
-        surf.Roughness = roughnessSum / weightSum;
-        surf.Emission = emissionSum / weightSum;
-        surf.AO = AOSum / weightSum;
-    }
+    sum.weightSum += w;
 
-    return surf;
+    sum.albedoSum += w * albedoTexel.rgb;
+    sum.normalSum += w * pixelNormalWorldSpace.xyz;
+    sum.metallicSum += w * metalicRoughness.x;
+    sum.roughnessSum += w * metalicRoughness.y;
+    sum.emissionSum += w * emissive;
+    sum.AOSum += w * occlusion;
 }
 
-
-
-// ray march
-// in: rayStartPos rayFwdNormal
-// out: color.rgb and distance (float4)
-float4 RayMarch(float3 rayStartPos, float3 rayFwdNormal)
+// Visits the shapes GetWeightedSurfaceData blends. The full blend samples each one as it is emitted, the deferred
+// march only gathers their indices into the G-buffer (isGatherOnly), same as SdfCpuRayMarcher::VisitSurfaceShapes.
+struct SurfaceShapeVisitor
 {
-    ConstantBuffer<LightConstants>      lightConstants = ResourceDescriptorHeap[renderResources.lightConstantsIndex];
-    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
-    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
-    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    SurfaceDataSum sum;
+    TopKCandidates candidates;
+    bool isGatherOnly;
+    uint4 shapes;
+    uint numShapes; // may pass SDF_GBUFFER_MAX_SHAPES, only the first ones are kept
+};
 
-    StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
+SurfaceShapeVisitor MakeSurfaceShapeVisitor(bool isGatherOnly)
+{
+    SurfaceShapeVisitor visitor;
+    visitor.sum = (SurfaceDataSum)0;
+    visitor.candidates.count = 0;
+    visitor.isGatherOnly = isGatherOnly;
+    visitor.shapes = uint4(SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE);
+    visitor.numShapes = 0;
+    return visitor;
+}
 
+void EmitSurfaceShape(inout SurfaceShapeVisitor visitor, int i, float3 p, float3 worldNormal, float w)
+{
+    if (!visitor.isGatherOnly)
+    {
+        SampleShapeSurfaceData(visitor.sum, i, p, worldNormal, w);
+        return;
+    }
+    if (visitor.numShapes < SDF_GBUFFER_MAX_SHAPES)
+    {
+        visitor.shapes[visitor.numShapes] = i;
+    }
+    visitor.numShapes += 1;
+}
 
-    const int maxSteps = sdfConstants.maxSteps;
-    const float minHitDistance = sdfConstants.minHitDistance;
-    const float maxTraceDistance = sdfConstants.maxTraceDistance;
+// Emits the shape right away, or only gathers its weight when useTopKMaterials is set
+void AccumulateShapeSurfaceData(inout SurfaceShapeVisitor visitor, int i, float3 p, float3 worldNormal, float threshold)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
-    const float3 missingColor = float3(0.2f, 0.2f, 0.2f);
+    float d = sdfValueFromShape(p, LoadShapeGeometry(i));
 
-    float distTraveled = 0.0f;
-    for (int step = 0; step < maxSteps; ++step)
+    if (d > threshold)
     {
-        float3 currPos = rayStartPos + distTraveled * rayFwdNormal;
+        return;
+    }
 
-        float distToClosest = SdfMap(currPos);
+    float w = max(0, threshold - d); // linear weight, maybe exp(-d/k)
+    if (sdfConstants.useTopKMaterials == 0)
+    {
+        EmitSurfaceShape(visitor, i, p, worldNormal, w);
+        return;
+    }
+    if (visitor.candidates.count == SDF_TOPK_CANDIDATES)
+    {
+        ReduceTopKCandidates(visitor.candidates);
+    }
+    visitor.candidates.weights[visitor.candidates.count] = w;
+    visitor.candidates.shapes[visitor.candidates.count] = i;
+    visitor.candidates.count += 1;
+}
 
-        // float3 diffuseColor;
-        // float distToClosest = SdfMapWithColor(currPos, diffuseColor);
+void VisitSurfaceShapes(inout SurfaceShapeVisitor visitor, float3 p, float3 worldNormal)
+{
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
-        // Hit
-        if (distToClosest < minHitDistance)
-        {
-            // Calculate Normal
-            float3 N = SdfNormalTetra(currPos);
+    const int numOfShapes = sdfConstants.numOfShapes;
+    const float toleranceK = sdfConstants.toleranceK;
 
-            /** Diffuse Lighting
-            // Calculate Diffuse color
-            float3 diffuseColor = GetWeightedColor(currPos, missingColor, N);
+    float threshold = toleranceK * 3.f;
 
-            // Shading
-            SurfaceData surf = MakeDefaultSurfaceData();
-            surf.Albedo = diffuseColor.rgb;
-            surf.Normal = normalize(N);
+    if (UseTileBinning())
+    {
+        // Tiles are binned with a 6k inflation, so every shape within the 3k threshold is in the list
+        for (uint j = 0; j < s_tileShapeCount; ++j)
+        {
+            AccumulateShapeSurfaceData(visitor, GetTileShapeIndex(j), p, worldNormal, threshold);
+        }
+    }
+    else if (UseSdfBvh())
+    {
+        // threshold (3k) is inside the 6k inflation, so only nodes containing p can hold a weighted shape
+        StructuredBuffer<SdfBvhNode> sdfBvh = ResourceDescriptorHeap[renderResources.inputSdfBvhIndex];
+        uint stack[SDF_BVH_STACK_SIZE];
+        int stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            SdfBvhNode node = sdfBvh[stack[--stackSize]];
+            if (DistanceSquaredToBvhNode(p, node) > 0.f)
+            {
+                continue;
+            }
+            if (node.count > 0)
+            {
+                for (uint i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+                {
+                    AccumulateShapeSurfaceData(visitor, i, p, worldNormal, threshold);
+                }
+                continue;
+            }
+            stack[stackSize++] = node.leftOrFirst + 1;
+            stack[stackSize++] = node.leftOrFirst;
+        }
+    }
+    else
+    {
+        for (int i = 0; i < numOfShapes; ++i)
+        {
+            AccumulateShapeSurfaceData(visitor, i, p, worldNormal, threshold);
+        }
+    }
 
-            float3 totalLight;
+    if (visitor.candidates.count > 0)
+    {
+        // Shares of the K kept weights, the divide in ResolveSurfaceData renormalizes over what is left after the cut
+        if (visitor.candidates.count > SDF_TOPK_MATERIALS)
+        {
+            ReduceTopKCandidates(visitor.candidates);
+        }
+        float topWeightSum = 0.0f;
+        for (uint j = 0; j < visitor.candidates.count; ++j)
+        {
+            topWeightSum += visitor.candidates.weights[j];
+        }
+        for (uint j = 0; j < visitor.candidates.count; ++j)
+        {
+            if (visitor.candidates.weights[j] >= sdfConstants.topKMinWeight * topWeightSum)
+            {
+                EmitSurfaceShape(visitor, visitor.candidates.shapes[j], p, worldNormal, visitor.candidates.weights[j]);
+            }
+        }
+    }
+}
 
-            CALC_TOTAL_DIFFUSE_LIGHT(totalLight, surf, currPos);
+SurfaceData ResolveSurfaceData(SurfaceDataSum sum)
+{
+    SurfaceData surf = MakeDefaultSurfaceData();
+    if (sum.weightSum > 0.0f)
+    {
+        surf.Albedo = sum.albedoSum / sum.weightSum;
+        surf.Normal = normalize(sum.normalSum);
+        surf.Metallic = sum.metallicSum / sum.weightSum;
+        surf.Roughness = sum.roughnessSum / sum.weightSum;
+        surf.Emission = sum.emissionSum / sum.weightSum;
+        surf.AO = sum.AOSum / sum.weightSum;
+    }
+    return surf;
+}
 
-            float3 color = saturate(totalLight);
-            */
-            SurfaceData surf = GetWeightedSurfaceData(currPos, N);
+SurfaceData GetWeightedSurfaceData(float3 p, float3 worldNormal)
+{
+    SurfaceShapeVisitor visitor = MakeSurfaceShapeVisitor(false);
+    VisitSurfaceShapes(visitor, p, worldNormal);
+    return ResolveSurfaceData(visitor.sum);
+}
 
-            float3 directLighting = float3(0.f, 0.f, 0.f); // Result
+// The shapes GetWeightedSurfaceData would sample at p, in its order, or SDF_GBUFFER_OVERFLOW when they do not fit
+uint4 GatherSurfaceShapes(float3 p)
+{
+    SurfaceShapeVisitor visitor = MakeSurfaceShapeVisitor(true);
+    VisitSurfaceShapes(visitor, p, float3(0.f, 0.f, 1.f));
+    if (visitor.numShapes > SDF_GBUFFER_MAX_SHAPES)
+    {
+        return uint4(SDF_GBUFFER_OVERFLOW, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE, SDF_GBUFFER_NO_SHAPE);
+    }
+    return visitor.shapes;
+}
 
-            CALC_TOTAL_PBR_LIGHT(directLighting, surf, currPos);
+// Same p and same geometry as the gather, so the weights come back exactly; overflow texels gather again
+SurfaceData GetGBufferSurfaceData(uint4 shapes, float3 p, float3 worldNormal)
+{
+    if (shapes.x == SDF_GBUFFER_OVERFLOW)
+    {
+        return GetWeightedSurfaceData(p, worldNormal);
+    }
 
-            float3 ambient = float3(0.02, 0.02, 0.02) * surf.Albedo.rgb * surf.AO;
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    float threshold = sdfConstants.toleranceK * 3.f;
 
-            float3 color = ambient + directLighting + surf.Emission; 
-            color = ACESFilm(color);
-            color = pow(color, 1.0/2.2); // Gamma correction
+    SurfaceDataSum sum = (SurfaceDataSum)0;
+    [unroll]
+    for (int k = 0; k < SDF_GBUFFER_MAX_SHAPES; ++k)
+    {
+        if (shapes[k] != SDF_GBUFFER_NO_SHAPE)
+        {
+            float d = sdfValueFromShape(p, LoadShapeGeometry(shapes[k]));
+            SampleShapeSurfaceData(sum, shapes[k], p, worldNormal, max(0, threshold - d));
+        }
+    }
+    return ResolveSurfaceData(sum);
+}
 
-            if (engineConstants.debugInt == 1)
-            {
-                color = surf.Albedo;
-            }
-            else if (engineConstants.debugInt == 2)
-            {
-                color = EncodeXYZToRGB(surf.Normal);
-            }
-            else if (engineConstants.debugInt == 3)
-            {
-                color = float3(0.f, surf.Roughness, surf.Metallic);
-            }
-            else if (engineConstants.debugInt == 4)
+// Material set of a G-buffer texel, same as GetSdfShadeBin in SdfDeferredShading.cpp
+uint GetShadeBin(uint4 shapes)
+{
+    if (shapes.x == SDF_GBUFFER_OVERFLOW)
+    {
+        return 0;
+    }
+
+    uint hash = 0;
+    [unroll]
+    for (int k = 0; k < SDF_GBUFFER_MAX_SHAPES; ++k)
+    {
+        if (shapes[k] != SDF_GBUFFER_NO_SHAPE)
+        {
+            hash += GetShapeMaterialID(shapes[k]) * 2654435761u + 1u;
+        }
+    }
+    return 1u + hash % (SDF_SHADE_BINS - 1);
+}
+
+// Lighting, tone mapping and the surface debug views, same as SdfCpuRayMarcher::ShadeSurface
+float3 ShadeSurface(SurfaceData surf, float3 worldPos)
+{
+    ConstantBuffer<LightConstants>      lightConstants = ResourceDescriptorHeap[renderResources.lightConstantsIndex];
+    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
+    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+
+    float3 directLighting = float3(0.f, 0.f, 0.f); // Result
+
+    CALC_TOTAL_PBR_LIGHT(directLighting, surf, worldPos);
+
+    float3 ambient = float3(0.02, 0.02, 0.02) * surf.Albedo.rgb * surf.AO;
+
+    float3 color = ambient + directLighting + surf.Emission; 
+    color = ACESFilm(color);
+    color = pow(color, 1.0/2.2); // Gamma correction
+
+    if (engineConstants.debugInt == 1)
+    {
+        color = surf.Albedo;
+    }
+    else if (engineConstants.debugInt == 2)
+    {
+        color = EncodeXYZToRGB(surf.Normal);
+    }
+    else if (engineConstants.debugInt == 3)
+    {
+        color = float3(0.f, surf.Roughness, surf.Metallic);
+    }
+    else if (engineConstants.debugInt == 4)
+    {
+        color = float3(surf.AO, surf.AO, surf.AO);
+    }
+    return color;
+}
+
+
+
+// ray march
+// in: rayStartPos rayFwdNormal
+// out: color.rgb and distance (float4)
+// Never above SdfMap, see SdfBrickMap::GetLowerBound
+float BrickMapLowerBound(float3 p)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    float3 toBox = max(max(sdfConstants.shapeBoundsMin - p, p - sdfConstants.shapeBoundsMax), 0.f);
+    float bound = length(toBox) - sdfConstants.brickBlendLowering;
+
+    const float brickExtent = SDF_BRICK_SIZE * SDF_BRICK_VOXEL_SIZE;
+    int3 brickCoords = (int3)floor((p - sdfConstants.brickMapOrigin) / brickExtent);
+    int gridSize = sdfConstants.brickGridSize;
+    if (any(brickCoords < 0) || any(brickCoords >= gridSize))
+    {
+        return bound;
+    }
+
+    StructuredBuffer<SdfBrick> bricks = ResourceDescriptorHeap[renderResources.inputBricksIndex];
+    SdfBrick brick = bricks[(brickCoords.z * gridSize + brickCoords.y) * gridSize + brickCoords.x];
+    float slack = sdfConstants.brickOdometer - brick.bakeOdometer;
+    if (brick.sampleOffset == SDF_BRICK_EMPTY)
+    {
+        return max(bound, brick.coarseDistance - slack);
+    }
+
+    // Voxel corners: F(p) >= F(corner) - |p - corner|, keep the best of the eight
+    StructuredBuffer<float> samples = ResourceDescriptorHeap[renderResources.inputBrickSamplesIndex];
+    float3 brickMins = sdfConstants.brickMapOrigin + (float3)brickCoords * brickExtent;
+    int3 voxel = clamp((int3)((p - brickMins) / SDF_BRICK_VOXEL_SIZE), 0, SDF_BRICK_SIZE - 1);
+    const uint samplesPerEdge = SDF_BRICK_SIZE + 1;
+
+    float sampledBound = -INFINITY_DIST;
+    for (uint corner = 0; corner < 8; ++corner)
+    {
+        uint3 c = (uint3)voxel + uint3(corner & 1, (corner >> 1) & 1, corner >> 2);
+        float3 cornerPos = brickMins + (float3)c * SDF_BRICK_VOXEL_SIZE;
+        float value = samples[brick.sampleOffset + (c.z * samplesPerEdge + c.y) * samplesPerEdge + c.x];
+        sampledBound = max(sampledBound, value - length(p - cornerPos));
+    }
+    return max(bound, sampledBound - slack);
+}
+
+// startDistance: where the march begins, every point before it is known to be empty
+// shadeHit: false for the deferred march, a hit returns black and its distance
+float4 RayMarch(float3 rayStartPos, float3 rayFwdNormal, float startDistance, bool shadeHit)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+
+    const int maxSteps = sdfConstants.maxSteps;
+    const float minHitDistance = sdfConstants.minHitDistance;
+    const float maxTraceDistance = sdfConstants.maxTraceDistance;
+
+    const float3 missingColor = SDF_MISSING_COLOR;
+    const bool useBrickMap = sdfConstants.useBrickMap != 0 && !UseCsgProgram(); // baked from the shapes, not the program
+
+    // Enhanced sphere tracing when useOverRelaxation is set, same as SdfCpuRayMarcher::RayMarch
+    const float relaxedOmega = (sdfConstants.useOverRelaxation != 0) ? sdfConstants.overRelaxationOmega : 1.0f;
+    float omega = relaxedOmega;
+    float previousDist = 0.0f;
+    float stepLength = 0.0f;
+
+    float distTraveled = startDistance;
+    for (int step = 0; step < maxSteps; ++step)
+    {
+        s_costCounts.x += 1;
+        float3 currPos = rayStartPos + distTraveled * rayFwdNormal;
+
+        // Far from surfaces the cached bound is a safe step, the narrow band needs the exact field
+        float distToClosest = useBrickMap ? BrickMapLowerBound(currPos) : 0.f;
+        if (distToClosest <= SDF_BRICK_NARROW_BAND)
+        {
+            distToClosest = SdfMap(currPos);
+        }
+
+        // Over-relaxed steps are safe while the empty spheres of consecutive points overlap. Once they do not,
+        // step back inside the previous sphere and take plain steps until the distance grows again.
+        if (omega > 1.0f && abs(distToClosest) + previousDist < stepLength)
+        {
+            stepLength -= omega * stepLength;
+            omega = 1.0f;
+            distTraveled += stepLength;
+            continue;
+        }
+        if (abs(distToClosest) > previousDist)
+        {
+            omega = relaxedOmega;
+        }
+        previousDist = abs(distToClosest);
+
+        // float3 diffuseColor;
+        // float distToClosest = SdfMapWithColor(currPos, diffuseColor);
+
+        // Hit
+        if (distToClosest < minHitDistance)
+        {
+            // The deferred march shades in ShadePass
+            if (!shadeHit)
             {
-                color = float3(surf.AO, surf.AO, surf.AO);
+                return float4(0.f, 0.f, 0.f, distTraveled);
             }
 
+            // Calculate Normal
+            float3 N = SdfNormal(currPos);
+
+            /** Diffuse Lighting
+            // Calculate Diffuse color
+            float3 diffuseColor = GetWeightedColor(currPos, missingColor, N);
+
+            // Shading
+            SurfaceData surf = MakeDefaultSurfaceData();
+            surf.Albedo = diffuseColor.rgb;
+            surf.Normal = normalize(N);
+
+            float3 totalLight;
+
+            CALC_TOTAL_DIFFUSE_LIGHT(totalLight, surf, currPos);
+
+            float3 color = saturate(totalLight);
+            */
+            SurfaceData surf = GetWeightedSurfaceData(currPos, N);
+
+            float3 color = ShadeSurface(surf, currPos);
+
             return float4(color, distTraveled); // return color + distance
         }
 
@@ -351,43 +1164,448 @@ float4 RayMarch(float3 rayStartPos, float3 rayFwdNormal)
         {
             return float4(missingColor, INFINITY_DIST); 
         }
-        distTraveled += distToClosest;
+        stepLength = distToClosest * omega;
+        distTraveled += stepLength;
     }
 
     // Miss
     return float4(missingColor, INFINITY_DIST); 
 }
 
-//-------------------------------------------------------------------------------------------
-[numthreads(THREADS_PER_GROUP_SIZE, THREADS_PER_GROUP_SIZE, 1)]
-void ComputeMain(int3 dispatchThreadID : SV_DispatchThreadID)
+// Distance along the axis that no ray inside the cone can hit a surface before, same as SdfCpuRayMarcher::ConeMarch.
+// The field is 1-Lipschitz, so no point within dist - minHitDistance of currPos can be a hit. The cone section
+// at t + advance stays inside that ball while advance * (1 + tan) <= dist - minHitDistance - t * tan.
+float ConeMarch(float3 rayStartPos, float3 coneAxis, float tanHalfAngle)
 {
-    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
-    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
-    ConstantBuffer<ModelConstants>      modelConstants = ResourceDescriptorHeap[renderResources.modelConstantsIndex];
-    ConstantBuffer<LightConstants>      lightConstants = ResourceDescriptorHeap[renderResources.lightConstantsIndex];
-    ConstantBuffer<PerFrameConstants>   perFrameConstants = ResourceDescriptorHeap[renderResources.perFrameConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
-    StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
-    RWTexture2D<float4> outputTex = ResourceDescriptorHeap[renderResources.outputTextureIndex];
-    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
-    
-    int2 pixelCoord = dispatchThreadID.xy;
-    int2 screenSize = int2(sdfConstants.screenWidth, sdfConstants.screenHeight);
-    if (any(pixelCoord >= screenSize))
-        return;
+    const int maxSteps = sdfConstants.maxSteps;
+    const float minHitDistance = sdfConstants.minHitDistance;
+    const float maxTraceDistance = sdfConstants.maxTraceDistance;
+
+    float t = 0.0f;
+    for (int step = 0; step < maxSteps; ++step)
+    {
+        float3 currPos = rayStartPos + t * coneAxis;
+        float dist = SdfMap(currPos) - minHitDistance;
+        float advance = (dist - t * tanHalfAngle) / (1.0f + tanHalfAngle);
+        if (advance < minHitDistance)
+        {
+            break;
+        }
+        t += advance;
+
+        if (dist > maxTraceDistance)
+        {
+            break;
+        }
+    }
+    return t;
+}
+
+// The ray through the top-left corner of the pixel on the far plane, same as SdfCpuView::GetRayDirection
+float3 GetPixelRayDirection(int2 pixelCoord, int2 screenSize)
+{
+    ConstantBuffer<CameraConstants> cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
 
     float2 uv = float2(pixelCoord) / float2(screenSize);
     float4 clipSpacePos = float4(uv.x * 2.0f - 1.0f, 1.0f - uv.y * 2.0f, 1.0f, 1.0f); // Near plane z = 0, Far Plane z = 1
     float4 worldSpacePos = mul(cameraConstants.clipToWorldTransform, clipSpacePos);
     worldSpacePos /= worldSpacePos.w;
 
+    return normalize(worldSpacePos.xyz - cameraConstants.cameraWorldPosition);
+}
+
+// Cone holding the rays of every full-res pixel in the SDF_CONE_PREPASS_FACTOR block, same as SdfCpuView::GetConeRay.
+// The widest corner bounds the block: the directions within an angle of the axis meet the far plane in a convex region.
+void GetConeRay(int2 conePixel, int2 screenSize, out float3 coneAxis, out float tanHalfAngle)
+{
+    int2 minPixel = conePixel * SDF_CONE_PREPASS_FACTOR;
+    int2 maxPixel = min(minPixel + SDF_CONE_PREPASS_FACTOR - 1, screenSize - 1);
+
+    float3 corners[4];
+    corners[0] = GetPixelRayDirection(minPixel, screenSize);
+    corners[1] = GetPixelRayDirection(int2(maxPixel.x, minPixel.y), screenSize);
+    corners[2] = GetPixelRayDirection(int2(minPixel.x, maxPixel.y), screenSize);
+    corners[3] = GetPixelRayDirection(maxPixel, screenSize);
+    coneAxis = normalize(corners[0] + corners[1] + corners[2] + corners[3]);
+
+    // tan from the cross product, 1 - cos^2 loses most of its bits for narrow cones
+    tanHalfAngle = 0.0f;
+    for (int i = 0; i < 4; ++i)
+    {
+        tanHalfAngle = max(tanHalfAngle, length(cross(coneAxis, corners[i])) / dot(coneAxis, corners[i]));
+    }
+    tanHalfAngle *= SDF_CONE_ANGLE_SLACK;
+}
+
+// Quarter-res pre-pass, one thread per cone
+void ConeDepthPass(int2 conePixel)
+{
+    ConstantBuffer<CameraConstants> cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    int2 screenSize = int2(sdfConstants.screenWidth, sdfConstants.screenHeight);
+    int2 coneSize = (screenSize + SDF_CONE_PREPASS_FACTOR - 1) / SDF_CONE_PREPASS_FACTOR;
+    if (any(conePixel >= coneSize))
+        return;
+
+    float3 coneAxis;
+    float tanHalfAngle;
+    GetConeRay(conePixel, screenSize, coneAxis, tanHalfAngle);
+
+    RWTexture2D<float> coneDepthTex = ResourceDescriptorHeap[renderResources.coneDepthIndex];
+    coneDepthTex[conePixel] = ConeMarch(cameraConstants.cameraWorldPosition, coneAxis, tanHalfAngle);
+}
+
+// Temporal reprojection, same as SdfTemporalReprojection and SdfCpuRayMarcher::ValidateTemporalStart.
+// Positive floats order like their bits, so InterlockedMin on asuint keeps the nearest splat.
+void TemporalClearPass(int2 pixelCoord)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    if (any(pixelCoord >= int2(sdfConstants.screenWidth, sdfConstants.screenHeight)))
+        return;
+
+    RWTexture2D<uint> temporalStartTex = ResourceDescriptorHeap[renderResources.temporalStartIndex];
+    temporalStartTex[pixelCoord] = SDF_TEMPORAL_NO_SPLAT;
+}
+
+// Pixels a splat at viewZ reaches so the shapes' moves are covered, same as SdfTemporalReprojection::GetSplatRadius
+int GetTemporalSplatRadius(float viewZ, float maxShapeMove, float tanHalfFovY, int screenHeight)
+{
+    float nearestZ = max(viewZ - maxShapeMove, 1e-3f);
+    float movePixels = maxShapeMove * float(screenHeight) / (2.0f * tanHalfFovY * nearestZ);
+    return min(SDF_TEMPORAL_DILATION + int(ceil(movePixels)), SDF_TEMPORAL_MAX_DILATION);
+}
+
+// Lifts the previous frame's hit back to world space and splats its distance from the new camera
+void TemporalScatterPass(int2 pixelCoord)
+{
+    ConstantBuffer<CameraConstants> cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    int2 screenSize = int2(sdfConstants.screenWidth, sdfConstants.screenHeight);
+    if (any(pixelCoord >= screenSize))
+        return;
+
+    RWTexture2D<float> prevDepthTex = ResourceDescriptorHeap[renderResources.outputDepthIndex];
+    float depth = prevDepthTex[pixelCoord];
+    if (depth >= 1.0f)
+        return; // missed, or hit past the far plane
+
+    float2 ndc = float2(float2(pixelCoord) / float2(screenSize)) * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f);
+    float3 prevDir = normalize(sdfConstants.prevCameraForward - sdfConstants.prevCameraLeft * (ndc.x * sdfConstants.prevTanHalfFovX)
+        + sdfConstants.prevCameraUp * (ndc.y * sdfConstants.prevTanHalfFovY));
+    float prevNear = sdfConstants.prevCameraNear;
+    float prevFar = sdfConstants.prevCameraFar;
+    float viewZ = prevNear / (1.0f - depth * (prevFar - prevNear) / prevFar);
+    float3 hitPos = sdfConstants.prevCameraPosition + prevDir * (viewZ / dot(prevDir, sdfConstants.prevCameraForward));
+
+    float3 toHit = hitPos - cameraConstants.cameraWorldPosition;
+    float z = dot(toHit, sdfConstants.cameraForward);
+    if (z <= 0.0f)
+        return; // behind the new camera
+
+    float ndcX = -dot(toHit, sdfConstants.cameraLeft) / (z * sdfConstants.tanHalfFovX);
+    float ndcY = dot(toHit, sdfConstants.cameraUp) / (z * sdfConstants.tanHalfFovY);
+    float2 splatPos = float2(ndcX + 1.0f, 1.0f - ndcY) * 0.5f * float2(screenSize);
+    if (any(splatPos < 0.0f) || any(splatPos >= float2(screenSize)))
+        return;
+
+    RWTexture2D<uint> temporalStartTex = ResourceDescriptorHeap[renderResources.temporalStartIndex];
+    int2 splatPixel = int2(splatPos);
+    uint distanceBits = asuint(length(toHit));
+    int radius = GetTemporalSplatRadius(z, sdfConstants.temporalMaxShapeMove, sdfConstants.tanHalfFovY, screenSize.y);
+    int2 minPixel = max(splatPixel - radius, 0);
+    int2 maxPixel = min(splatPixel + radius, screenSize - 1);
+    for (int y = minPixel.y; y <= maxPixel.y; ++y)
+    {
+        for (int x = minPixel.x; x <= maxPixel.x; ++x)
+        {
+            InterlockedMin(temporalStartTex[int2(x, y)], distanceBits);
+        }
+    }
+}
+
+// The nearest splat minus the largest shape move and the depth slack, or safeStartDistance when it fails validation
+float GetTemporalStartDistance(int2 pixelCoord, float3 rayStartPos, float3 rayFwdNormal, float safeStartDistance)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    RWTexture2D<uint> temporalStartTex = ResourceDescriptorHeap[renderResources.temporalStartIndex];
+
+    uint splatBits = temporalStartTex[pixelCoord];
+    if (splatBits == SDF_TEMPORAL_NO_SPLAT)
+        return safeStartDistance;
+
+    float hintDistance = max(asfloat(splatBits) * (1.0f - SDF_TEMPORAL_DEPTH_SLACK) - sdfConstants.temporalMaxShapeMove, 0.0f);
+    if (hintDistance <= safeStartDistance)
+        return safeStartDistance;
+
+    // A surface that came in front of the old one leaves the hint on or inside it
+    bool isValid = (SdfMap(rayStartPos + rayFwdNormal * hintDistance) >= sdfConstants.minHitDistance);
+    return isValid ? hintDistance : safeStartDistance;
+}
+
+// Blue to red, same as GetSdfCostHeatmapColor in SdfCostCounters.cpp
+float3 GetCostHeatmapColor(uint count, uint maxCount)
+{
+    float t = min(float(count) / float(max(maxCount, 1u)), 1.0f);
+    return saturate(1.5f - abs(4.0f * t - float3(3.0f, 2.0f, 1.0f)));
+}
+
+// Dispatched over SDF_COST_STATS_SIZE x 1
+void CostClearPass(int2 pixelCoord)
+{
+    if (pixelCoord.y != 0 || pixelCoord.x >= SDF_COST_STATS_SIZE)
+        return;
+
+    RWTexture2D<uint> costStatsTex = ResourceDescriptorHeap[renderResources.costStatsIndex];
+    costStatsTex[pixelCoord] = 0;
+}
+
+// Histogram and totals of the cost counters, same as SdfCostStats::AddPixel.
+// Each group reduces its 64 pixels in groupshared, then thread i adds entry i to the stats texture.
+void CostReducePass(int2 pixelCoord, uint groupIndex)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    gs_costStats[groupIndex] = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (all(pixelCoord < int2(sdfConstants.screenWidth, sdfConstants.screenHeight)))
+    {
+        RWTexture2D<uint4> costCountersTex = ResourceDescriptorHeap[renderResources.costCountersIndex];
+        uint3 counts = costCountersTex[pixelCoord].xyz;
+        uint bin = min(counts.x / uint(sdfConstants.costHistogramBinWidth), SDF_COST_HISTOGRAM_BINS - 1);
+        InterlockedAdd(gs_costStats[bin], 1);
+        InterlockedAdd(gs_costStats[SDF_COST_STAT_NUM_PIXELS], 1);
+        InterlockedAdd(gs_costStats[SDF_COST_STAT_NUM_STEPS], counts.x);
+        InterlockedAdd(gs_costStats[SDF_COST_STAT_NUM_SDF_MAP_CALLS], counts.y);
+        InterlockedAdd(gs_costStats[SDF_COST_STAT_NUM_MATERIAL_EVALUATIONS], counts.z);
+        InterlockedMax(gs_costStats[SDF_COST_STAT_MAX_STEPS], counts.x);
+        InterlockedMax(gs_costStats[SDF_COST_STAT_MAX_SDF_MAP_CALLS], counts.y);
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    uint value = gs_costStats[groupIndex];
+    if (value == 0)
+        return;
+
+    RWTexture2D<uint> costStatsTex = ResourceDescriptorHeap[renderResources.costStatsIndex];
+    if (groupIndex == SDF_COST_STAT_MAX_STEPS || groupIndex == SDF_COST_STAT_MAX_SDF_MAP_CALLS)
+    {
+        InterlockedMax(costStatsTex[int2(groupIndex, 0)], value);
+    }
+    else
+    {
+        InterlockedAdd(costStatsTex[int2(groupIndex, 0)], value);
+    }
+}
+
+// Deferred shading (SdfDeferredShading.hpp): the march writes the G-buffer and counts each hit into its bin,
+// then the prefix pass turns the counts into offsets, the scatter pass lists the hits by bin, and ShadePass shades
+// them in list order so a group mostly samples one material set.
+
+// Dispatched over SDF_SHADE_BINS x 2
+void ShadeClearPass(int2 pixelCoord)
+{
+    if (pixelCoord.x >= SDF_SHADE_BINS || pixelCoord.y >= 2)
+        return;
+
+    RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+    shadeBinsTex[pixelCoord] = 0;
+}
+
+// One group, a thread per bin. Exclusive prefix sum of the counts, same as SortSdfShadePixels
+void ShadePrefixPass(uint groupIndex)
+{
+    RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+
+    gs_shadeBins[groupIndex] = shadeBinsTex[int2(groupIndex, 0)];
+    GroupMemoryBarrierWithGroupSync();
+
+    if (groupIndex == 0)
+    {
+        uint offset = 0;
+        for (uint bin = 0; bin < SDF_SHADE_BINS; ++bin)
+        {
+            uint count = gs_shadeBins[bin];
+            gs_shadeBins[bin] = offset;
+            offset += count;
+        }
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    shadeBinsTex[int2(groupIndex, 1)] = gs_shadeBins[groupIndex];
+}
+
+// GetSdfShadingSource in SdfDeferredShading.cpp: the first pixel of the block when both are hits on the same smooth
+// surface, the pixel itself otherwise (always at a shadingRate of 1)
+int2 GetShadingSource(int2 pixelCoord)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    int rate = sdfConstants.shadingRate;
+    if (rate <= 1)
+        return pixelCoord;
+    int2 anchorCoord = (pixelCoord / rate) * rate;
+    if (all(anchorCoord == pixelCoord))
+        return pixelCoord;
+
+    RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+    float4 anchor = gbufferTex[anchorCoord];
+    float4 texel = gbufferTex[pixelCoord];
+    if (anchor.w >= INFINITY_DIST || texel.w >= INFINITY_DIST)
+        return pixelCoord;
+
+    bool isSameSurface = (abs(texel.w - anchor.w) <= sdfConstants.shadingDepthTolerance * anchor.w) &&
+        (dot(texel.xyz, anchor.xyz) >= sdfConstants.shadingNormalThreshold);
+    return isSameSurface ? anchorCoord : pixelCoord;
+}
+
+// With a shadingRate the march cannot tell which hits are shaded, their block may not be marched yet: counted here
+void ShadeCountPass(int2 pixelCoord)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    if (any(pixelCoord >= int2(sdfConstants.screenWidth, sdfConstants.screenHeight)))
+        return;
+
+    RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+    if (gbufferTex[pixelCoord].w >= INFINITY_DIST || any(GetShadingSource(pixelCoord) != pixelCoord))
+        return;
+
+    RWTexture2D<uint4> gbufferShapesTex = ResourceDescriptorHeap[renderResources.gbufferShapesIndex];
+    RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+    InterlockedAdd(shadeBinsTex[int2(GetShadeBin(gbufferShapesTex[pixelCoord]), 0)], 1);
+}
+
+// Each hit takes the next slot of its bin. Afterwards the last bin's cursor is the number of hits
+void ShadeScatterPass(int2 pixelCoord)
+{
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    if (any(pixelCoord >= int2(sdfConstants.screenWidth, sdfConstants.screenHeight)))
+        return;
+
+    RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+    if (gbufferTex[pixelCoord].w >= INFINITY_DIST || any(GetShadingSource(pixelCoord) != pixelCoord))
+        return;
+
+    RWTexture2D<uint4> gbufferShapesTex = ResourceDescriptorHeap[renderResources.gbufferShapesIndex];
+    RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+    RWTexture2D<uint> shadePixelsTex = ResourceDescriptorHeap[renderResources.shadePixelsIndex];
+
+    uint slot;
+    InterlockedAdd(shadeBinsTex[int2(GetShadeBin(gbufferShapesTex[pixelCoord]), 1)], 1, slot);
+    shadePixelsTex[int2(slot % sdfConstants.screenWidth, slot / sdfConstants.screenWidth)] = uint(pixelCoord.x) | (uint(pixelCoord.y) << 16);
+}
+
+// Dispatched over the screen, but each thread shades list slot (group * 64 + groupIndex), not its own pixel
+void ShadePass(uint3 groupID, uint groupIndex)
+{
+    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
+    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+
+    uint numGroupsX = (sdfConstants.screenWidth + THREADS_PER_GROUP_SIZE - 1) / THREADS_PER_GROUP_SIZE;
+    uint slot = (groupID.y * numGroupsX + groupID.x) * (THREADS_PER_GROUP_SIZE * THREADS_PER_GROUP_SIZE) + groupIndex;
+    if (slot >= shadeBinsTex[int2(SDF_SHADE_BINS - 1, 1)])
+        return;
+
+    RWTexture2D<uint> shadePixelsTex = ResourceDescriptorHeap[renderResources.shadePixelsIndex];
+    uint packedPixel = shadePixelsTex[int2(slot % sdfConstants.screenWidth, slot / sdfConstants.screenWidth)];
+    int2 pixelCoord = int2(packedPixel & 0xFFFF, packedPixel >> 16);
+
+    // The pixels of a group come from anywhere on screen, so each thread reads its own tile's list from the global buffer
+    if (sdfConstants.useTileBinning != 0)
+    {
+        StructuredBuffer<uint2> tileRanges = ResourceDescriptorHeap[renderResources.inputTileRangesIndex];
+        uint2 tileRange = tileRanges[(pixelCoord.y / THREADS_PER_GROUP_SIZE) * sdfConstants.numOfTilesX + pixelCoord.x / THREADS_PER_GROUP_SIZE];
+        s_tileShapeOffset = tileRange.x;
+        s_tileShapeCount = tileRange.y;
+        s_isTileInGroupShared = false;
+        s_hasTileList = true;
+    }
+
+    RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+    RWTexture2D<uint4> gbufferShapesTex = ResourceDescriptorHeap[renderResources.gbufferShapesIndex];
+    float4 normalAndDistance = gbufferTex[pixelCoord];
+
+    // Same point the march stopped at
     const float3 rayStartPos = cameraConstants.cameraWorldPosition;
-    const float3 rayFwdNormal = normalize(worldSpacePos.xyz - rayStartPos);
+    float3 hitPos = rayStartPos + normalAndDistance.w * GetPixelRayDirection(pixelCoord, int2(sdfConstants.screenWidth, sdfConstants.screenHeight));
+    SurfaceData surf = GetGBufferSurfaceData(gbufferShapesTex[pixelCoord], hitPos, normalAndDistance.xyz);
+
+    // The step and SdfMap heatmaps were written by the march
+    RWTexture2D<float4> outputTex = ResourceDescriptorHeap[renderResources.outputTextureIndex];
+    if (engineConstants.debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+    {
+        outputTex[pixelCoord] = float4(GetCostHeatmapColor(s_costCounts.z, SDF_COST_HEATMAP_MAX_MATERIALS), 1.f);
+    }
+    else if (engineConstants.debugInt != SDF_COST_HEATMAP_STEPS && engineConstants.debugInt != SDF_COST_HEATMAP_SDF_MAP_CALLS)
+    {
+        outputTex[pixelCoord] = float4(ShadeSurface(surf, hitPos), 1.f);
+    }
+    if (sdfConstants.useCostCounters != 0)
+    {
+        RWTexture2D<uint4> costCountersTex = ResourceDescriptorHeap[renderResources.costCountersIndex];
+        costCountersTex[pixelCoord] += uint4(0, 0, s_costCounts.z, 0);
+    }
+}
 
+// After ShadePass: the pixels on their block's surface take its shaded color. The step and SdfMap heatmaps were written
+// by the march, and these pixels evaluated no material
+void ShadeResolvePass(int2 pixelCoord)
+{
+    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants> sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+
+    if (any(pixelCoord >= int2(sdfConstants.screenWidth, sdfConstants.screenHeight)))
+        return;
+
+    int2 sourceCoord = GetShadingSource(pixelCoord);
+    if (all(sourceCoord == pixelCoord))
+        return;
+
+    RWTexture2D<float4> outputTex = ResourceDescriptorHeap[renderResources.outputTextureIndex];
+    if (engineConstants.debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+    {
+        outputTex[pixelCoord] = float4(GetCostHeatmapColor(0, SDF_COST_HEATMAP_MAX_MATERIALS), 1.f);
+    }
+    else if (engineConstants.debugInt != SDF_COST_HEATMAP_STEPS && engineConstants.debugInt != SDF_COST_HEATMAP_SDF_MAP_CALLS)
+    {
+        outputTex[pixelCoord] = outputTex[sourceCoord];
+    }
+}
 
-    float4 marchRes = RayMarch(rayStartPos, rayFwdNormal);
+//-------------------------------------------------------------------------------------------
+// Color, cost and depth of a pixel once its march is done
+void WriteMarchResult(int2 pixelCoord, float4 marchRes, float3 rayStartPos, float3 rayFwdNormal)
+{
+    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
+    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    RWTexture2D<float4> outputTex = ResourceDescriptorHeap[renderResources.outputTextureIndex];
 
+    // Cost heatmaps replace every pixel, same as SdfCpuRayMarcher::RenderTile; ShadePass redoes the material one for its hits
+    if (engineConstants.debugInt == SDF_COST_HEATMAP_STEPS)
+    {
+        marchRes.xyz = GetCostHeatmapColor(s_costCounts.x, sdfConstants.maxSteps);
+    }
+    else if (engineConstants.debugInt == SDF_COST_HEATMAP_SDF_MAP_CALLS)
+    {
+        marchRes.xyz = GetCostHeatmapColor(s_costCounts.y, sdfConstants.maxSteps);
+    }
+    else if (engineConstants.debugInt == SDF_COST_HEATMAP_MATERIAL_EVALUATIONS)
+    {
+        marchRes.xyz = GetCostHeatmapColor(s_costCounts.z, SDF_COST_HEATMAP_MAX_MATERIALS);
+    }
+    if (sdfConstants.useCostCounters != 0)
+    {
+        RWTexture2D<uint4> costCountersTex = ResourceDescriptorHeap[renderResources.costCountersIndex];
+        costCountersTex[pixelCoord] = uint4(s_costCounts, 0);
+    }
 
     outputTex[pixelCoord] = float4(marchRes.xyz, 1.f); // Opaque
     if (renderResources.outputDepthIndex != INVALID_INDEX)
@@ -405,6 +1623,189 @@ void ComputeMain(int3 dispatchThreadID : SV_DispatchThreadID)
     }
 }
 
+//-------------------------------------------------------------------------------------------
+// What a missed ray writes, for the pixels of a tile no shape can reach: SdfCpuRayMarcher::FillBackgroundTile
+void BackgroundFillPass(int2 pixelCoord)
+{
+    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    int2 screenSize = int2(sdfConstants.screenWidth, sdfConstants.screenHeight);
+    if (any(pixelCoord >= screenSize))
+        return;
+
+    if (sdfConstants.useDeferredShading != 0)
+    {
+        RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+        gbufferTex[pixelCoord] = float4(0.f, 0.f, 0.f, INFINITY_DIST);
+    }
+
+    const float3 rayStartPos = cameraConstants.cameraWorldPosition;
+    const float3 rayFwdNormal = GetPixelRayDirection(pixelCoord, screenSize);
+    s_costCounts = uint3(0, 0, 0);
+    WriteMarchResult(pixelCoord, float4(SDF_MISSING_COLOR, INFINITY_DIST), rayStartPos, rayFwdNormal);
+}
+
+//-------------------------------------------------------------------------------------------
+[numthreads(THREADS_PER_GROUP_SIZE, THREADS_PER_GROUP_SIZE, 1)]
+void ComputeMain(int3 dispatchThreadID : SV_DispatchThreadID, uint3 groupID : SV_GroupID, uint3 groupThreadID : SV_GroupThreadID, uint groupIndex : SV_GroupIndex)
+{
+    ConstantBuffer<EngineConstants>     engineConstants = ResourceDescriptorHeap[renderResources.engineConstantsIndex];
+    ConstantBuffer<CameraConstants>     cameraConstants = ResourceDescriptorHeap[renderResources.cameraConstantsIndex];
+    ConstantBuffer<ModelConstants>      modelConstants = ResourceDescriptorHeap[renderResources.modelConstantsIndex];
+    ConstantBuffer<LightConstants>      lightConstants = ResourceDescriptorHeap[renderResources.lightConstantsIndex];
+    ConstantBuffer<PerFrameConstants>   perFrameConstants = ResourceDescriptorHeap[renderResources.perFrameConstantsIndex];
+
+    RWTexture2D<float4> outputTex = ResourceDescriptorHeap[renderResources.outputTextureIndex];
+    ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
+    
+    // The whole dispatch is either one of the pre-passes or the full-res march
+    if (renderResources.prePass == SDF_PREPASS_CONE_DEPTH)
+    {
+        ConeDepthPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_TEMPORAL_CLEAR)
+    {
+        TemporalClearPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_TEMPORAL_SCATTER)
+    {
+        TemporalScatterPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_COST_CLEAR)
+    {
+        CostClearPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_COST_REDUCE)
+    {
+        CostReducePass(dispatchThreadID.xy, groupIndex);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE_CLEAR)
+    {
+        ShadeClearPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE_PREFIX)
+    {
+        ShadePrefixPass(groupIndex);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE_SCATTER)
+    {
+        ShadeScatterPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE)
+    {
+        ShadePass(groupID, groupIndex);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE_COUNT)
+    {
+        ShadeCountPass(dispatchThreadID.xy);
+        return;
+    }
+    if (renderResources.prePass == SDF_PREPASS_SHADE_RESOLVE)
+    {
+        ShadeResolvePass(dispatchThreadID.xy);
+        return;
+    }
+
+    // With tile classification a group is one tile of the list, the list wrapped into rows of SDF_TILE_LIST_ROW_GROUPS.
+    // The groups of the last row past the list return as a whole.
+    int2 tileCoord = int2(groupID.xy);
+    if (sdfConstants.useTileClassification != 0)
+    {
+        bool isBackgroundFill = (renderResources.prePass == SDF_PREPASS_BACKGROUND_FILL);
+        uint listSlot = groupID.y * SDF_TILE_LIST_ROW_GROUPS + groupID.x;
+        if (listSlot >= (uint)(isBackgroundFill ? sdfConstants.numBackgroundTiles : sdfConstants.numOccupiedTiles))
+            return;
+
+        StructuredBuffer<uint> tileList = ResourceDescriptorHeap[renderResources.inputTileListIndex];
+        uint packedTile = tileList[listSlot + (isBackgroundFill ? (uint)sdfConstants.numOccupiedTiles : 0)];
+        tileCoord = int2(packedTile & 0xFFFF, packedTile >> 16);
+    }
+    int2 pixelCoord = tileCoord * THREADS_PER_GROUP_SIZE + int2(groupThreadID.xy);
+    int2 screenSize = int2(sdfConstants.screenWidth, sdfConstants.screenHeight);
+
+    if (renderResources.prePass == SDF_PREPASS_BACKGROUND_FILL)
+    {
+        BackgroundFillPass(pixelCoord);
+        return;
+    }
+
+    // Every thread of the group helps load the tile list, before any of them can return.
+    // The dispatch may have more groups than tiles, those are skipped as a whole.
+    if (sdfConstants.useTileBinning != 0 && all(tileCoord * THREADS_PER_GROUP_SIZE < screenSize))
+    {
+        StructuredBuffer<uint2> tileRanges = ResourceDescriptorHeap[renderResources.inputTileRangesIndex];
+        uint2 tileRange = tileRanges[tileCoord.y * sdfConstants.numOfTilesX + tileCoord.x];
+        s_tileShapeOffset = tileRange.x;
+        s_tileShapeCount = tileRange.y;
+        s_isTileInGroupShared = (tileRange.y <= SDF_TILE_MAX_GROUPSHARED_SHAPES);
+        s_hasTileList = true;
+        if (s_isTileInGroupShared)
+        {
+            StructuredBuffer<uint> tileShapeIndices = ResourceDescriptorHeap[renderResources.inputTileShapeIndicesIndex];
+            for (uint j = groupIndex; j < s_tileShapeCount; j += THREADS_PER_GROUP_SIZE * THREADS_PER_GROUP_SIZE)
+            {
+                gs_tileShapes[j] = tileShapeIndices[s_tileShapeOffset + j];
+            }
+        }
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (any(pixelCoord >= screenSize))
+        return;
+
+    const float3 rayStartPos = cameraConstants.cameraWorldPosition;
+    const float3 rayFwdNormal = GetPixelRayDirection(pixelCoord, screenSize);
+
+    // Every ray of the block is inside the cone, so the cone's empty distance holds for it
+    float startDistance = 0.0f;
+    if (sdfConstants.useConeDepthPrepass != 0)
+    {
+        RWTexture2D<float> coneDepthTex = ResourceDescriptorHeap[renderResources.coneDepthIndex];
+        startDistance = coneDepthTex[pixelCoord / SDF_CONE_PREPASS_FACTOR];
+    }
+    if (sdfConstants.useTemporalReprojection != 0 && sdfConstants.hasTemporalHistory != 0)
+    {
+        startDistance = GetTemporalStartDistance(pixelCoord, rayStartPos, rayFwdNormal, startDistance);
+    }
+
+    const bool useDeferredShading = (sdfConstants.useDeferredShading != 0);
+    float4 marchRes = RayMarch(rayStartPos, rayFwdNormal, startDistance, !useDeferredShading);
+
+    // Deferred: the normal and the shapes to blend now, the materials in ShadePass
+    if (useDeferredShading)
+    {
+        RWTexture2D<float4> gbufferTex = ResourceDescriptorHeap[renderResources.gbufferIndex];
+        float4 normalAndDistance = float4(0.f, 0.f, 0.f, INFINITY_DIST);
+        if (marchRes.w < INFINITY_DIST)
+        {
+            float3 hitPos = rayStartPos + marchRes.w * rayFwdNormal;
+            normalAndDistance = float4(SdfNormal(hitPos), marchRes.w);
+
+            RWTexture2D<uint4> gbufferShapesTex = ResourceDescriptorHeap[renderResources.gbufferShapesIndex];
+            RWTexture2D<uint> shadeBinsTex = ResourceDescriptorHeap[renderResources.shadeBinsIndex];
+            uint4 shapes = GatherSurfaceShapes(hitPos);
+            gbufferShapesTex[pixelCoord] = shapes;
+            if (sdfConstants.shadingRate <= 1)
+            {
+                InterlockedAdd(shadeBinsTex[int2(GetShadeBin(shapes), 0)], 1);
+            }
+        }
+        gbufferTex[pixelCoord] = normalAndDistance;
+    }
+
+    WriteMarchResult(pixelCoord, marchRes, rayStartPos, rayFwdNormal);
+}
+
+
 
 // float2 sminCubicWithMixFactor(float a, float b, float k)
 // {
@@ -418,7 +1819,6 @@ void ComputeMain(int3 dispatchThreadID : SV_DispatchThreadID)
 
 // float SdfMapWithColor(float3 p, out float3 outColor)
 // {
-//     StructuredBuffer<SdfShape> sdfShapes = ResourceDescriptorHeap[renderResources.inputSdfShapesIndex];
 //     ConstantBuffer<SdfRayMarchingConstants>   sdfConstants = ResourceDescriptorHeap[renderResources.rayMarchingConstantsIndex];
 
 //     const int numOfShapes = sdfConstants.numOfShapes;
@@ -430,8 +1830,8 @@ void ComputeMain(int3 dispatchThreadID : SV_DispatchThreadID)
 
 //     for (int i = 0; i < numOfShapes; ++i)
 //     {
-//         float d = sdfValueFromShape(p, sdfShapes[i]);
-//         float3 c = sdfShapes[i].color.rgb;
+//         float d = sdfValueFromShape(p, LoadShapeGeometry(i));
+//         float3 c = GetShapeColor(i).rgb;
 
 //         if (first)
 //         {